@@ -91,6 +91,14 @@ class ArduinoHardware {
   
     int getBaud(){return baud_;}
 
+    // Used by NodeHandle_ to switch rates with the server; the flush waits for
+    // what has been written to go out at the old rate first.
+    void changeBaud(long baud){
+      iostream->flush();
+      baud_ = baud;
+      iostream->begin(baud_);
+    }
+
     void init(){
 #if defined(USE_USBCON)
       // Startup delay as a fail-safe to upload a new sketch
@@ -100,12 +108,19 @@ class ArduinoHardware {
     }
 
     int read(){return iostream->read();};
+    // Hand the whole frame over in one call, which the USB serial classes
+    // pack into as few packets as they can.
     void write(uint8_t* data, int length){
-      for(int i=0; i<length; i++)
-        iostream->write(data[i]);
+      iostream->write(data, length);
     }
 
+#if ARDUINO>=10600
+    // Used by NodeHandle_ when it has a TX queue, to write without blocking.
+    int availableForWrite(){return iostream->availableForWrite();}
+#endif
+
     unsigned long time(){return millis();}
+    unsigned long time_us(){return micros();}
 
   protected:
     SERIAL_CLASS* iostream;
@@ -38,16 +38,34 @@
 #include <Arduino.h>
 #if defined(ESP8266)
   #include <ESP8266WiFi.h>
+  #include <WiFiUdp.h>
 #elif defined(ESP32)
   #include <WiFi.h> // Using Espressif's WiFi.h
+  #include <WiFiUdp.h>
 #else
   #include <SPI.h>
   #include <Ethernet.h>
 #endif
 
+// Written frames are gathered here and sent together as spinOnce() returns, or
+// sooner if they fill it, so that a burst of messages costs one segment rather
+// than one each. Frames published outside spinOnce() wait for the next one.
+#ifndef ROSSERIAL_TCP_TX_BUFFER
+#define ROSSERIAL_TCP_TX_BUFFER 512
+#endif
+
+// While the server can't be reached, how long to wait between attempts to
+// connect, and, on the ESPs, how long each attempt may hold up spinOnce().
+#ifndef ROSSERIAL_TCP_RECONNECT_MS
+#define ROSSERIAL_TCP_RECONNECT_MS 1000
+#endif
+#ifndef ROSSERIAL_TCP_CONNECT_TIMEOUT_MS
+#define ROSSERIAL_TCP_CONNECT_TIMEOUT_MS 200
+#endif
+
 class ArduinoHardware {
 public:
-  ArduinoHardware()
+  ArduinoHardware() : tx_length_(0), last_attempt_(0)
   {
   }
 
@@ -72,25 +90,55 @@ public:
     {
       tcp_.stop();
     }
-    tcp_.connect(server_, serverPort_);
+    connect();
   }
 
   int read(){
-    if (tcp_.connected())
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  // Reads what has arrived a chunk at a time, rather than going down through
+  // the client and the TCP stack for each byte.
+  int read(uint8_t* data, int length)
+  {
+    if (!tcp_.connected())
     {
-        return tcp_.read();
+      reconnect();
+      return -1;
     }
-    else
+    int available = tcp_.available();
+    if (available <= 0)
     {
-      tcp_.stop();
-      tcp_.connect(server_, serverPort_);
+      return -1;
     }
-    return -1;
+    return tcp_.read(data, available < length ? available : length);
   }
 
   void write(const uint8_t* data, int length)
   {
-    tcp_.write(data, length);
+    if (tx_length_ + length > ROSSERIAL_TCP_TX_BUFFER)
+    {
+      flush();
+    }
+    if (length > ROSSERIAL_TCP_TX_BUFFER)
+    {
+      send(data, length);
+      return;
+    }
+    memcpy(tx_buffer_ + tx_length_, data, length);
+    tx_length_ += length;
+  }
+
+  // Sends the frames gathered since the last flush; NodeHandle_ calls this as
+  // each spinOnce() returns.
+  void flush()
+  {
+    if (tx_length_ > 0)
+    {
+      send(tx_buffer_, tx_length_);
+      tx_length_ = 0;
+    }
   }
 
   unsigned long time()
@@ -98,19 +146,103 @@ public:
     return millis();
   }
 
+  unsigned long time_us()
+  {
+    return micros();
+  }
+
   bool connected()
   {
     return tcp_.connected();
   }
 
+#if defined(ESP8266) or defined(ESP32)
+  // Takes the topics the server sends to a multicast group, once for all its
+  // clients, from the group; see ros/hardware_multicast.h.
+  void joinMulticast(const uint8_t* address, uint16_t port)
+  {
+    IPAddress group(address[0], address[1], address[2], address[3]);
+    udp_.stop();
+#if defined(ESP8266)
+    udp_.beginMulticast(WiFi.localIP(), group, port);
+#else
+    udp_.beginMulticast(group, port);
+#endif
+  }
+
+  int readMulticast(uint8_t* data, int length)
+  {
+    int size = udp_.parsePacket();
+    if (size <= 0)
+    {
+      return -1;
+    }
+    // One too long for the buffer is passed on cut short, and dropped for its
+    // length.
+    udp_.read(data, length);
+    return size;
+  }
+#endif
+
 protected:
+  void send(const uint8_t* data, int length)
+  {
+    if (tcp_.connected())
+    {
+      tcp_.write(data, length);
+    }
+  }
+
+  // Tries again once ROSSERIAL_TCP_RECONNECT_MS have passed since the last
+  // attempt, so that the loop keeps running while the server is away.
+  void reconnect()
+  {
+    if (millis() - last_attempt_ < ROSSERIAL_TCP_RECONNECT_MS)
+    {
+      return;
+    }
+    tcp_.stop();
+    tx_length_ = 0;
+#if defined(ESP8266) or defined(ESP32)
+    // With no network, wait for it to come back rather than trying at all.
+    if (WiFi.status() != WL_CONNECTED)
+    {
+      last_attempt_ = millis();
+      return;
+    }
+#endif
+    connect();
+  }
+
+  void connect()
+  {
+#if defined(ESP32)
+    tcp_.connect(server_, serverPort_, ROSSERIAL_TCP_CONNECT_TIMEOUT_MS);
+#elif defined(ESP8266)
+    tcp_.setTimeout(ROSSERIAL_TCP_CONNECT_TIMEOUT_MS);
+    tcp_.connect(server_, serverPort_);
+#else
+    tcp_.connect(server_, serverPort_);
+#endif
+    last_attempt_ = millis();
+#if defined(ESP8266) or defined(ESP32)
+    // Send each frame as soon as it's written, rather than holding small ones
+    // back until the last segment has been acked.
+    tcp_.setNoDelay(true);
+#endif
+  }
+
 #if defined(ESP8266) or defined(ESP32)
   WiFiClient tcp_;
+  WiFiUDP udp_;
 #else
   EthernetClient tcp_;
 #endif
   IPAddress server_;
   uint16_t serverPort_ = 11411;
+  uint8_t tx_buffer_[ROSSERIAL_TCP_TX_BUFFER];
+  int tx_length_;
+  unsigned long last_attempt_;
 };
 
 #endif
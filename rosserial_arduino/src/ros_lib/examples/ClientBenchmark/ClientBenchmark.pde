@@ -0,0 +1,113 @@
+/*
+ * rosserial Client Benchmark
+ *
+ * Measures what spinOnce() costs per byte received, and what publish() costs
+ * per message, for messages of the sizes rosrun rosserial_client
+ * client_benchmark sends. The driver streams std_msgs/UInt8MultiArray
+ * messages of a size to benchmark/downlink, then sends the size on
+ * benchmark/command; the sketch then publishes messages of that size on
+ * benchmark/uplink, timing each, and reports on benchmark/result:
+ *
+ *   [size, ticks per second, CPU Hz, bytes received, ticks spinning on them,
+ *    messages published, ticks publishing, most ticks for one publish]
+ *
+ * Ticks are from micros(), whose resolution is 4 us on 16 MHz AVRs.
+ */
+
+#define ROSSERIAL_LINK_STATS
+#include <ros.h>
+#include <std_msgs/UInt16.h>
+#include <std_msgs/UInt8MultiArray.h>
+#include <std_msgs/UInt32MultiArray.h>
+
+#define MAX_SIZE 128
+#define PUBLISH_COUNT 50
+
+ros::NodeHandle nh;
+
+uint8_t payload[MAX_SIZE];
+std_msgs::UInt8MultiArray uplink_msg;
+ros::Publisher uplink_pub("benchmark/uplink", &uplink_msg);
+
+uint32_t result[8];
+std_msgs::UInt32MultiArray result_msg;
+ros::Publisher result_pub("benchmark/result", &result_msg);
+
+uint16_t run_size = 0;
+bool run_pending = false;
+uint32_t spin_bytes = 0;
+uint32_t spin_ticks = 0;
+
+void commandCb(const std_msgs::UInt16& msg)
+{
+  run_size = msg.data < MAX_SIZE ? msg.data : MAX_SIZE;
+  run_pending = true;
+}
+
+void downlinkCb(const std_msgs::UInt8MultiArray& msg)
+{
+}
+
+ros::Subscriber<std_msgs::UInt16> command_sub("benchmark/command", commandCb);
+ros::Subscriber<std_msgs::UInt8MultiArray> downlink_sub("benchmark/downlink", downlinkCb);
+
+void run()
+{
+  uplink_msg.data = payload;
+  uplink_msg.data_length = run_size;
+  uint32_t total = 0, most = 0;
+  for (int i = 0; i < PUBLISH_COUNT; i++)
+  {
+    payload[0] = i;
+    uint32_t start = micros();
+    uplink_pub.publish(&uplink_msg);
+    uint32_t ticks = micros() - start;
+    total += ticks;
+    if (ticks > most)
+      most = ticks;
+  }
+
+  result[0] = run_size;
+  result[1] = 1000000UL;
+  result[2] = F_CPU;
+  result[3] = spin_bytes;
+  result[4] = spin_ticks;
+  result[5] = PUBLISH_COUNT;
+  result[6] = total;
+  result[7] = most;
+  result_msg.data = result;
+  result_msg.data_length = 8;
+  result_pub.publish(&result_msg);
+  spin_bytes = 0;
+  spin_ticks = 0;
+}
+
+void setup()
+{
+  nh.initNode();
+  nh.advertise(uplink_pub);
+  nh.advertise(result_pub);
+  nh.subscribe(command_sub);
+  nh.subscribe(downlink_sub);
+}
+
+void loop()
+{
+  /* only spins which took bytes in count towards the cost per byte */
+  uint32_t bytes = nh.getLinkStats().rx_bytes;
+  uint32_t start = micros();
+  nh.spinOnce();
+  uint32_t ticks = micros() - start;
+  bytes = nh.getLinkStats().rx_bytes - bytes;
+  if (bytes > 0)
+  {
+    spin_bytes += bytes;
+    spin_ticks += ticks;
+  }
+
+  if (run_pending)
+  {
+    run_pending = false;
+    run();
+  }
+}
@@ -0,0 +1,320 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_BONDED_HARDWARE_H_
+#define _ROS_BONDED_HARDWARE_H_
+
+#include <stdint.h>
+
+#include "ros/hardware_flush.h"
+
+/* The most bytes of the stream in one chunk, each way; the server's
+ * ~chunk_size must be no larger. */
+#ifndef BONDED_HARDWARE_CHUNK
+#define BONDED_HARDWARE_CHUNK 32
+#endif
+
+/* How many chunks can be held waiting for the ones before them. */
+#ifndef BONDED_HARDWARE_WINDOW
+#define BONDED_HARDWARE_WINDOW 8
+#endif
+
+/* How long a missing chunk is waited for before the ones after it are read
+ * without it, in milliseconds. */
+#ifndef BONDED_HARDWARE_GAP_MS
+#define BONDED_HARDWARE_GAP_MS 20
+#endif
+
+namespace ros
+{
+
+/* Hardware which stripes the stream across LINKS others, each of its own
+ * UART, for the server's bonded_serial_node, so a client gets their combined
+ * bandwidth. Each link is set up through link(i) before initNode(), as in
+ *   nh.getHardware()->link(1) = ArduinoHardware(&Serial2, 115200);
+ * and all of them run at the same baud rate.
+ *
+ * Written bytes go out in chunks of up to BONDED_HARDWARE_CHUNK, framed as
+ *   0xb5, sequence, length, bytes..., checksum
+ * on each link in turn, and received chunks are put back in order by their
+ * sequence numbers, as rosserial_server's BondedStream describes. A chunk
+ * which never arrives is skipped once every link has passed it, or after
+ * BONDED_HARDWARE_GAP_MS, and the frame it was part of fails its checksum.
+ * Costs BONDED_HARDWARE_WINDOW + LINKS chunks of RAM. */
+template<class Hardware, int LINKS = 2>
+class BondedHardware
+{
+public:
+  BondedHardware() :
+    next_link_(0), next_read_(0), expected_(0), position_(0), buffered_(0),
+    stale_(0), gap_started_(false), gap_sequence_(0), gap_start_(0), tx_sequence_(0)
+  {
+    for (int i = 0; i < BONDED_HARDWARE_WINDOW; i++)
+      slots_[i].filled = false;
+    for (int i = 0; i < LINKS; i++)
+    {
+      parsers_[i].state = HUNT;
+      parsers_[i].seen = false;
+    }
+  }
+
+  Hardware& link(int i)
+  {
+    return links_[i];
+  }
+
+  void init()
+  {
+    for (int i = 0; i < LINKS; i++)
+      links_[i].init();
+  }
+
+  int read()
+  {
+    for (;;)
+    {
+      Slot& slot = slots_[expected_ % BONDED_HARDWARE_WINDOW];
+      if (slot.filled)
+      {
+        uint8_t byte = slot.data[position_++];
+        if (position_ == slot.length)
+        {
+          slot.filled = false;
+          position_ = 0;
+          buffered_--;
+          expected_++;
+        }
+        return byte;
+      }
+      if (pump())
+        continue;
+      if (buffered_ == 0)
+        return -1;
+      if (allLinksPassed())
+      {
+        skipGap();
+        continue;
+      }
+      unsigned long now = links_[0].time();
+      if (!gap_started_ || gap_sequence_ != expected_)
+      {
+        gap_started_ = true;
+        gap_sequence_ = expected_;
+        gap_start_ = now;
+      }
+      else if (now - gap_start_ >= BONDED_HARDWARE_GAP_MS)
+      {
+        skipGap();
+        continue;
+      }
+      return -1;
+    }
+  }
+
+  void write(uint8_t* data, int length)
+  {
+    while (length > 0)
+    {
+      int n = length < BONDED_HARDWARE_CHUNK ? length : BONDED_HARDWARE_CHUNK;
+      uint8_t sum = tx_sequence_ + n;
+      tx_[0] = SYNC;
+      tx_[1] = tx_sequence_++;
+      tx_[2] = n;
+      for (int i = 0; i < n; i++)
+      {
+        tx_[3 + i] = data[i];
+        sum += data[i];
+      }
+      tx_[3 + n] = 255 - sum;
+      links_[next_link_].write(tx_, n + 4);
+      next_link_ = (next_link_ + 1) % LINKS;
+      data += n;
+      length -= n;
+    }
+  }
+
+  unsigned long time()
+  {
+    return links_[0].time();
+  }
+
+  void flush()
+  {
+    for (int i = 0; i < LINKS; i++)
+      HardwareFlush<Hardware>::flush(links_[i]);
+  }
+
+private:
+  enum { SYNC = 0xb5 };
+  enum ParseState { HUNT, SEQUENCE, LENGTH, PAYLOAD, CHECKSUM };
+
+  struct Parser
+  {
+    ParseState state;
+    uint8_t sequence;
+    uint8_t length;
+    uint8_t received;
+    uint8_t sum;
+    // The sequence number of the last chunk this link delivered.
+    bool seen;
+    uint8_t last_sequence;
+    uint8_t data[BONDED_HARDWARE_CHUNK];
+  };
+
+  struct Slot
+  {
+    bool filled;
+    uint8_t length;
+    uint8_t data[BONDED_HARDWARE_CHUNK];
+  };
+
+  /* Reads from each link in turn until one of them completes a chunk. */
+  bool pump()
+  {
+    for (int i = 0; i < LINKS; i++)
+    {
+      int index = next_read_;
+      next_read_ = (next_read_ + 1) % LINKS;
+      int c;
+      while ((c = links_[index].read()) >= 0)
+      {
+        if (parse(parsers_[index], c))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  bool parse(Parser& p, uint8_t byte)
+  {
+    switch (p.state)
+    {
+      case HUNT:
+        if (byte == SYNC)
+          p.state = SEQUENCE;
+        break;
+      case SEQUENCE:
+        p.sequence = byte;
+        p.sum = byte;
+        p.state = LENGTH;
+        break;
+      case LENGTH:
+        p.length = byte;
+        p.sum += byte;
+        p.received = 0;
+        p.state = (byte > 0 && byte <= BONDED_HARDWARE_CHUNK) ? PAYLOAD : HUNT;
+        break;
+      case PAYLOAD:
+        p.data[p.received++] = byte;
+        p.sum += byte;
+        if (p.received == p.length)
+          p.state = CHECKSUM;
+        break;
+      case CHECKSUM:
+        p.state = HUNT;
+        if (static_cast<uint8_t>(p.sum + byte) == 0xff)
+        {
+          p.seen = true;
+          p.last_sequence = p.sequence;
+          receiveChunk(p);
+          return true;
+        }
+        break;
+    }
+    return false;
+  }
+
+  /* Files a chunk in the window, treating a run of chunks from behind it, or
+   * one too far ahead, as the server having started its count again. */
+  void receiveChunk(const Parser& p)
+  {
+    int8_t ahead = static_cast<int8_t>(p.sequence - expected_);
+    if (ahead < 0 && ahead > -BONDED_HARDWARE_WINDOW && ++stale_ <= LINKS)
+      return;
+    if (ahead < 0 || ahead >= BONDED_HARDWARE_WINDOW)
+    {
+      for (int i = 0; i < BONDED_HARDWARE_WINDOW; i++)
+        slots_[i].filled = false;
+      buffered_ = 0;
+      position_ = 0;
+      expected_ = p.sequence;
+    }
+    stale_ = 0;
+    Slot& slot = slots_[p.sequence % BONDED_HARDWARE_WINDOW];
+    if (!slot.filled)
+      buffered_++;
+    slot.filled = true;
+    slot.length = p.length;
+    for (int i = 0; i < p.length; i++)
+      slot.data[i] = p.data[i];
+  }
+
+  /* Links deliver their chunks in order, so one which every link has gone
+   * past is never coming. */
+  bool allLinksPassed()
+  {
+    for (int i = 0; i < LINKS; i++)
+    {
+      if (!parsers_[i].seen || static_cast<int8_t>(parsers_[i].last_sequence - expected_) <= 0)
+        return false;
+    }
+    return true;
+  }
+
+  void skipGap()
+  {
+    while (!slots_[expected_ % BONDED_HARDWARE_WINDOW].filled)
+      expected_++;
+    gap_started_ = false;
+  }
+
+  Hardware links_[LINKS];
+  Parser parsers_[LINKS];
+  Slot slots_[BONDED_HARDWARE_WINDOW];
+  int next_link_;
+  int next_read_;
+  uint8_t expected_;
+  uint8_t position_;
+  uint8_t buffered_;
+  uint8_t stale_;
+  bool gap_started_;
+  uint8_t gap_sequence_;
+  unsigned long gap_start_;
+  uint8_t tx_sequence_;
+  uint8_t tx_[BONDED_HARDWARE_CHUNK + 4];
+};
+
+}
+
+#endif
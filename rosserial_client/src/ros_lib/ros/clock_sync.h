@@ -0,0 +1,214 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_CLOCK_SYNC_H_
+#define _ROS_CLOCK_SYNC_H_
+
+#include <stdint.h>
+
+#include "ros/time.h"
+
+namespace ros
+{
+
+/* Keeps the server's time from the answers to time requests, much as NTP
+ * does. Each answer is taken to give the server's time half way through its
+ * round trip, and of the last SAMPLES, the one with the shortest round trip,
+ * which was held up least on the way, steers the clock. The rate of the local
+ * clock against the server's is measured between such samples some way
+ * apart, and corrected for in between, so that the clock doesn't step at
+ * each sync. Local times are in microseconds, and must only go forwards. */
+template<int SAMPLES>
+class ClockSync
+{
+public:
+  /* The rate is measured between samples at least this far apart. */
+  enum { MIN_SKEW_BASELINE_US = 30000000 };
+  /* The most the local clock is taken to be off, in parts per billion. */
+  enum { MAX_SKEW_PPB = 1000000 };
+
+  ClockSync() : length_(0), next_(0), requested_us_(0), last_best_us_(0), rate_local_us_(0),
+    rate_remote_ns_(0), base_local_us_(0), base_remote_ns_(0), skew_ppb_(0), rtt_floor_us_(0),
+    synced_(false) {}
+
+  /* Notes when a time request went out. */
+  void requested(uint64_t local_us)
+  {
+    requested_us_ = local_us;
+  }
+
+  /* Takes the answer to the last request, holding the server's time, which
+   * came in at local time local_us. */
+  void answered(uint64_t local_us, const Time & remote)
+  {
+    Sample & sample = samples_[next_];
+    next_ = (next_ + 1) % SAMPLES;
+    if (length_ < SAMPLES)
+      length_++;
+    sample.rtt_us = (uint32_t)(local_us - requested_us_);
+    sample.local_us = local_us;
+    sample.remote_ns = toNs(remote) + sample.rtt_us * 500ULL;
+
+    const Sample * best = &samples_[bestIndex()];
+    if (!synced_)
+    {
+      base_local_us_ = best->local_us;
+      base_remote_ns_ = best->remote_ns;
+      rtt_floor_us_ = best->rtt_us;
+      synced_ = true;
+      return;
+    }
+    if (best->local_us == last_best_us_)
+      return;
+    last_best_us_ = best->local_us;
+
+    /* A sample whose round trip was much longer than the shortest seen says
+     * little, so the clock carries on at its rate instead; the shortest seen
+     * is let go of a little each time, in case the link has got slower. */
+    if (best->rtt_us > 2 * rtt_floor_us_ + 1000)
+    {
+      rtt_floor_us_ += rtt_floor_us_ / 8 + 1;
+      return;
+    }
+    if (best->rtt_us < rtt_floor_us_)
+      rtt_floor_us_ = best->rtt_us;
+
+    /* Move half way to the new sample, so that one whose round trip was
+     * lopsided pulls the clock only so far. */
+    int64_t error = (int64_t)(best->remote_ns - remoteNs(best->local_us));
+    base_remote_ns_ = remoteNs(best->local_us) + error / 2;
+    base_local_us_ = best->local_us;
+
+    /* Every so often, measure the rate between this sample and the one it
+     * was last measured at, and take a quarter of the difference from the
+     * rate so far, so that it settles on an average over several. */
+    int64_t baseline = (int64_t)(best->local_us - rate_local_us_);
+    if (rate_local_us_ == 0 || baseline >= MIN_SKEW_BASELINE_US)
+    {
+      if (rate_local_us_ != 0)
+      {
+        int64_t drift = (int64_t)(baseline * 1000 - (best->remote_ns - rate_remote_ns_));
+        int64_t skew = skew_ppb_ + (drift * 1000000 / baseline - skew_ppb_) / 4;
+        if (skew > MAX_SKEW_PPB)
+          skew = MAX_SKEW_PPB;
+        else if (skew < -MAX_SKEW_PPB)
+          skew = -MAX_SKEW_PPB;
+        skew_ppb_ = (int32_t) skew;
+      }
+      rate_local_us_ = best->local_us;
+      rate_remote_ns_ = best->remote_ns;
+    }
+  }
+
+  /* Sets the server's time at local time local_us, as from setNow(),
+   * forgetting the samples but not the rate. */
+  void set(uint64_t local_us, const Time & remote)
+  {
+    length_ = 0;
+    next_ = 0;
+    rate_local_us_ = 0;
+    base_local_us_ = local_us;
+    base_remote_ns_ = toNs(remote);
+    synced_ = false;
+  }
+
+  /* The server's time at local time local_us. */
+  Time remote(uint64_t local_us) const
+  {
+    uint64_t ns = remoteNs(local_us);
+    Time t;
+    t.sec = (uint32_t)(ns / 1000000000ULL);
+    t.nsec = (uint32_t)(ns % 1000000000ULL);
+    return t;
+  }
+
+  /* How much faster the local clock runs than the server's, in parts per
+   * billion, and the round trip of the sample the clock is set from. */
+  int32_t skewPpb() const
+  {
+    return skew_ppb_;
+  }
+
+  uint32_t roundTripUs() const
+  {
+    return synced_ ? samples_[bestIndex()].rtt_us : 0;
+  }
+
+private:
+  struct Sample
+  {
+    uint64_t local_us;
+    uint64_t remote_ns;
+    uint32_t rtt_us;
+  };
+
+  static uint64_t toNs(const Time & t)
+  {
+    return t.sec * 1000000000ULL + t.nsec;
+  }
+
+  uint64_t remoteNs(uint64_t local_us) const
+  {
+    int64_t elapsed = (int64_t)(local_us - base_local_us_);
+    return base_remote_ns_ + elapsed * 1000 - elapsed * skew_ppb_ / 1000000;
+  }
+
+  int bestIndex() const
+  {
+    int best = 0;
+    for (int i = 1; i < length_; i++)
+    {
+      if (samples_[i].rtt_us < samples_[best].rtt_us)
+        best = i;
+    }
+    return best;
+  }
+
+  Sample samples_[SAMPLES];
+  int length_;
+  int next_;
+  uint64_t requested_us_;
+  uint64_t last_best_us_;
+  uint64_t rate_local_us_;
+  uint64_t rate_remote_ns_;
+  uint64_t base_local_us_;
+  uint64_t base_remote_ns_;
+  int32_t skew_ppb_;
+  uint32_t rtt_floor_us_;
+  bool synced_;
+};
+
+}
+
+#endif
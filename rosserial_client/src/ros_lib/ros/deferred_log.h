@@ -0,0 +1,129 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_DEFERRED_LOG_H_
+#define _ROS_DEFERRED_LOG_H_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace ros
+{
+
+/*
+ * Packs a deferred log message into the body of a frame: its level, the
+ * 32-bit id of its format string, low byte first, then each argument as a
+ * tag and its value. Integers go as 'i' or 'u' and four bytes, floats as 'f'
+ * and four bytes, and strings as 's', a length byte and up to 255 bytes of
+ * string. Arguments which don't fit in what's left of the frame are dropped,
+ * along with any after them.
+ */
+class DeferredLog
+{
+public:
+  DeferredLog(uint8_t * buffer, int capacity, uint8_t level, uint32_t id)
+    : buffer_(buffer), capacity_(capacity), length_(0), full_(false)
+  {
+    buffer_[length_++] = level;
+    putBytes(id);
+  }
+
+  void put(char value)           { putInt('i', (int32_t) value); }
+  void put(signed char value)    { putInt('i', (int32_t) value); }
+  void put(short value)          { putInt('i', (int32_t) value); }
+  void put(int value)            { putInt('i', (int32_t) value); }
+  void put(long value)           { putInt('i', (int32_t) value); }
+  void put(bool value)           { putInt('u', (uint32_t) value); }
+  void put(unsigned char value)  { putInt('u', (uint32_t) value); }
+  void put(unsigned short value) { putInt('u', (uint32_t) value); }
+  void put(unsigned int value)   { putInt('u', (uint32_t) value); }
+  void put(unsigned long value)  { putInt('u', (uint32_t) value); }
+  void put(double value)         { put((float) value); }
+  void put(char * value)         { put((const char *) value); }
+
+  void put(float value)
+  {
+    union { float value; uint32_t bits; } u;
+    u.value = value;
+    putInt('f', u.bits);
+  }
+
+  void put(const char * value)
+  {
+    uint32_t n = strlen(value);
+    if (n > 255)
+      n = 255;
+    if (!reserve(2 + n))
+      return;
+    buffer_[length_++] = 's';
+    buffer_[length_++] = n;
+    memcpy(buffer_ + length_, value, n);
+    length_ += n;
+  }
+
+  int length() const
+  {
+    return length_;
+  }
+
+private:
+  void putInt(uint8_t tag, uint32_t value)
+  {
+    if (!reserve(5))
+      return;
+    buffer_[length_++] = tag;
+    putBytes(value);
+  }
+
+  void putBytes(uint32_t value)
+  {
+    for (int i = 0; i < 4; i++)
+      buffer_[length_++] = (value >> (8 * i)) & 0xff;
+  }
+
+  bool reserve(uint32_t n)
+  {
+    full_ = full_ || length_ + n > (uint32_t) capacity_;
+    return !full_;
+  }
+
+  uint8_t * buffer_;
+  int capacity_;
+  int length_;
+  bool full_;
+};
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_DELTA_ENCODER_H_
+#define _ROS_DELTA_ENCODER_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Encodes a message as the bytes in which it differs from a keyframe, an
+ * earlier message on the same topic, which suits messages that mostly repeat
+ * from one to the next. The encoding is a run of pairs of counts, each of
+ * bytes the same as the keyframe's and then of bytes which differ, up to 255,
+ * with the bytes which differ after the second. Bytes past the end of the
+ * keyframe all differ, and any past the last run are the keyframe's. */
+class DeltaEncoder
+{
+public:
+  /* Encodes n bytes from in against the length bytes of keyframe, into at
+   * most capacity bytes at out, returning the encoded length, or -1 if it
+   * won't fit. */
+  static int encode(const uint8_t * in, int n, const uint8_t * keyframe, int length,
+                    uint8_t * out, int capacity)
+  {
+    int o = 0;
+    int i = 0;
+    while (i < n)
+    {
+      int same = 0;
+      while (i < n && same < 255 && i < length && in[i] == keyframe[i])
+      {
+        i++;
+        same++;
+      }
+      if (i == n)
+        break;
+      /* a lone byte which is the same costs less to send than a new run */
+      int start = i;
+      while (i < n && i - start < 255 && (differs(in, keyframe, length, i) ||
+             (i + 1 < n && differs(in, keyframe, length, i + 1))))
+        i++;
+      int differ = i - start;
+      if (o + 2 + differ > capacity)
+        return -1;
+      out[o++] = (uint8_t) same;
+      out[o++] = (uint8_t) differ;
+      for (int j = start; j < i; j++)
+        out[o++] = in[j];
+    }
+    return o;
+  }
+
+private:
+  static bool differs(const uint8_t * in, const uint8_t * keyframe, int length, int i)
+  {
+    return i >= length || in[i] != keyframe[i];
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_FLASH_STRING_H_
+#define _ROS_FLASH_STRING_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * On AVR, string literals are copied from flash into RAM at start up, so that
+ * ordinary pointers can reach them. Libraries generated with make_library's
+ * flash_strings option, as rosserial_arduino's are, instead put each message's
+ * type and MD5 sum in flash with ROSSERIAL_PROGMEM, and define
+ * ROSSERIAL_FLASH_STRINGS to say that getType() and getMD5() then point
+ * there. Topic names can be kept there too, by giving them to publishers and
+ * subscribers with Arduino's F(). Elsewhere all of these stay in RAM, which
+ * is the only place there is to read them from.
+ */
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define ROSSERIAL_PROGMEM PROGMEM
+#else
+#define ROSSERIAL_PROGMEM
+#endif
+
+#if defined(ARDUINO)
+class __FlashStringHelper;
+#endif
+
+namespace ros
+{
+
+/* strlen(), memcpy() and reading one byte, of a string which is in flash if
+ * in_flash, as a ROSSERIAL_PROGMEM one is. */
+inline size_t stringLength(const char * s, bool in_flash)
+{
+#if defined(__AVR__)
+  if (in_flash)
+    return strlen_P(s);
+#endif
+  (void) in_flash;
+  return strlen(s);
+}
+
+inline void copyString(uint8_t * dest, const char * s, size_t n, bool in_flash)
+{
+#if defined(__AVR__)
+  if (in_flash)
+  {
+    memcpy_P(dest, s, n);
+    return;
+  }
+#endif
+  (void) in_flash;
+  memcpy(dest, s, n);
+}
+
+inline uint8_t stringByte(const char * s, bool in_flash)
+{
+#if defined(__AVR__)
+  if (in_flash)
+    return pgm_read_byte(s);
+#endif
+  (void) in_flash;
+  return *s;
+}
+
+}
+
+#endif
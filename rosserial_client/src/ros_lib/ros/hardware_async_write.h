@@ -0,0 +1,101 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_HARDWARE_ASYNC_WRITE_H_
+#define _ROS_HARDWARE_ASYNC_WRITE_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Detects whether a Hardware class has the optional
+ *   void writeAsync(uint8_t * data, int length)
+ *   bool writeDone()
+ * for hardware which sends straight from the caller's buffer, as DMA does,
+ * rather than copying it into a ring of its own or blocking until it is
+ * sent. writeAsync() starts sending the frame and returns; the buffer is left
+ * alone until writeDone() says every byte of it has gone. NodeHandle_ never
+ * starts a write, or writes any other way, before the last has finished. */
+template<class Hardware>
+class HasAsyncWrite
+{
+  typedef char yes[1];
+  typedef char no[2];
+
+  template<class U, void (U::*)(uint8_t *, int)> struct CheckWrite;
+  template<class U, bool (U::*)()> struct CheckDone;
+  template<class U> static yes& testWrite(CheckWrite<U, &U::writeAsync>*);
+  template<class U> static no& testWrite(...);
+  template<class U> static yes& testDone(CheckDone<U, &U::writeDone>*);
+  template<class U> static no& testDone(...);
+
+public:
+  enum { value = sizeof(testWrite<Hardware>(0)) == sizeof(yes) &&
+                 sizeof(testDone<Hardware>(0)) == sizeof(yes) };
+};
+
+/* Starts a write where the hardware can do them asynchronously, and
+ * otherwise writes synchronously, which is always done. */
+template<class Hardware, bool ASYNC = HasAsyncWrite<Hardware>::value>
+class HardwareAsyncWrite
+{
+public:
+  static void write(Hardware& hardware, uint8_t * data, int length)
+  {
+    hardware.write(data, length);
+  }
+  static bool done(Hardware&)
+  {
+    return true;
+  }
+};
+
+template<class Hardware>
+class HardwareAsyncWrite<Hardware, true>
+{
+public:
+  static void write(Hardware& hardware, uint8_t * data, int length)
+  {
+    hardware.writeAsync(data, length);
+  }
+  static bool done(Hardware& hardware)
+  {
+    return hardware.writeDone();
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_HARDWARE_CLOCK_H_
+#define _ROS_HARDWARE_CLOCK_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Detects whether a Hardware class has the optional microsecond clock,
+ *   unsigned long time_us()    or    uint32_t time_us()
+ * returning microseconds since some fixed point, and wrapping around at 2^32
+ * like a 32-bit counter. */
+template<class Hardware>
+class HasMicrosTime
+{
+  typedef char yes[1];
+  typedef char no[2];
+
+  template<class U, unsigned long (U::*)()> struct CheckLong;
+  template<class U, uint32_t (U::*)()> struct CheckUint32;
+  template<class U> static yes& test(CheckLong<U, &U::time_us>*, int);
+  template<class U> static yes& test(CheckUint32<U, &U::time_us>*, long);
+  template<class U> static no& test(...);
+
+public:
+  enum { value = sizeof(test<Hardware>(0, 0)) == sizeof(yes) };
+};
+
+/* The local clock NodeHandle_ keeps time by, in microseconds, carried on in
+ * 64 bits past where the hardware's counter wraps, so it must be read at
+ * least that often: every 71 minutes from time_us(), where the hardware has
+ * it, or every 49 days from its millisecond time() otherwise. */
+template<class Hardware, bool MICROS = HasMicrosTime<Hardware>::value>
+class HardwareClock
+{
+public:
+  HardwareClock() : us_(0), last_(0) {}
+
+  uint64_t micros(Hardware& hardware)
+  {
+    uint32_t ms = hardware.time();
+    us_ += (uint32_t)(ms - last_) * 1000ULL;
+    last_ = ms;
+    return us_;
+  }
+
+private:
+  uint64_t us_;
+  uint32_t last_;
+};
+
+template<class Hardware>
+class HardwareClock<Hardware, true>
+{
+public:
+  HardwareClock() : us_(0), last_(0) {}
+
+  uint64_t micros(Hardware& hardware)
+  {
+    uint32_t us = hardware.time_us();
+    us_ += (uint32_t)(us - last_);
+    last_ = us;
+    return us_;
+  }
+
+private:
+  uint64_t us_;
+  uint32_t last_;
+};
+
+}
+
+#endif
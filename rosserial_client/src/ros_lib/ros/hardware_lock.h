@@ -0,0 +1,102 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_HARDWARE_LOCK_H_
+#define _ROS_HARDWARE_LOCK_H_
+
+namespace ros
+{
+
+/* Detects whether a Hardware class has the optional
+ *   void lock()    and    void unlock()
+ * for when the NodeHandle is used from more than one task or thread, such as
+ * one running spinTask() and others publishing. The lock must be recursive:
+ * subscriber callbacks run with it held, and may publish. */
+template<class Hardware>
+class HasLock
+{
+  typedef char yes[1];
+  typedef char no[2];
+
+  template<class U, void (U::*)(), void (U::*)()> struct Check;
+  template<class U> static yes& test(Check<U, &U::lock, &U::unlock>*);
+  template<class U> static no& test(...);
+
+public:
+  enum { value = sizeof(test<Hardware>(0)) == sizeof(yes) };
+};
+
+/* Holds the hardware's lock for as long as it is in scope, where the hardware
+ * has one, and does nothing otherwise. */
+template<class Hardware, bool LOCK = HasLock<Hardware>::value>
+class HardwareLock
+{
+public:
+  explicit HardwareLock(Hardware&) {}
+
+  static void acquire(Hardware&) {}
+  static void release(Hardware&) {}
+};
+
+template<class Hardware>
+class HardwareLock<Hardware, true>
+{
+public:
+  explicit HardwareLock(Hardware& hardware) : hardware_(hardware)
+  {
+    hardware_.lock();
+  }
+
+  ~HardwareLock()
+  {
+    hardware_.unlock();
+  }
+
+  static void acquire(Hardware& hardware)
+  {
+    hardware.lock();
+  }
+
+  static void release(Hardware& hardware)
+  {
+    hardware.unlock();
+  }
+
+private:
+  Hardware& hardware_;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_HARDWARE_MULTICAST_H_
+#define _ROS_HARDWARE_MULTICAST_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Detects whether a Hardware class has the optional
+ *   void joinMulticast(const uint8_t * address, uint16_t port)
+ *   int readMulticast(uint8_t * data, int length)
+ * the first of which starts receiving the datagrams sent to the IPv4
+ * multicast group at address, four bytes, on port, and the second of which
+ * reads the next of them, whole, returning its length, or a value <= 0 if
+ * none has arrived. With them, NodeHandle_ takes the topics a server sends
+ * once to all its clients from the group, rather than each separately. */
+template<class Hardware>
+class HasMulticast
+{
+  typedef char yes[1];
+  typedef char no[2];
+
+  template<class U, int (U::*)(uint8_t*, int)> struct Check;
+  template<class U> static yes& test(Check<U, &U::readMulticast>*);
+  template<class U> static no& test(...);
+
+public:
+  enum { value = sizeof(test<Hardware>(0)) == sizeof(yes) };
+};
+
+/* Joins and reads the group where the hardware can, and does nothing
+ * otherwise. */
+template<class Hardware, bool MULTICAST = HasMulticast<Hardware>::value>
+class HardwareMulticast
+{
+public:
+  enum { supported = false };
+  static void join(Hardware&, const uint8_t*, uint16_t) {}
+  static int read(Hardware&, uint8_t*, int)
+  {
+    return -1;
+  }
+};
+
+template<class Hardware>
+class HardwareMulticast<Hardware, true>
+{
+public:
+  enum { supported = true };
+  static void join(Hardware& hardware, const uint8_t* address, uint16_t port)
+  {
+    hardware.joinMulticast(address, port);
+  }
+  static int read(Hardware& hardware, uint8_t* data, int length)
+  {
+    return hardware.readMulticast(data, length);
+  }
+};
+
+}
+
+#endif
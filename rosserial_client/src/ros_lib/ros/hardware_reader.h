@@ -0,0 +1,115 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_HARDWARE_READER_H_
+#define _ROS_HARDWARE_READER_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Detects whether a Hardware class has the optional bulk read method,
+ *   int read(uint8_t* data, int length)
+ * which reads up to length bytes and returns how many it read, or a
+ * value <= 0 if none were available. */
+template<class Hardware>
+class HasBulkRead
+{
+  typedef char yes[1];
+  typedef char no[2];
+
+  template<class U, int (U::*)(uint8_t*, int)> struct Check;
+  template<class U> static yes& test(Check<U, &U::read>*);
+  template<class U> static no& test(...);
+
+public:
+  enum { value = sizeof(test<Hardware>(0)) == sizeof(yes) };
+};
+
+/* Feeds received bytes to NodeHandle_::spinOnce one at a time. By default,
+ * this is just Hardware::read(), but for hardware with the bulk read, bytes
+ * are pulled in chunks of up to SIZE, so that a port where each read is a
+ * system call costs one call per chunk rather than one per byte. */
+template<class Hardware, bool BULK = HasBulkRead<Hardware>::value, int SIZE = 256>
+class HardwareReader
+{
+public:
+  int read(Hardware& hardware)
+  {
+    return hardware.read();
+  }
+
+  /* Whether bytes have been read from the hardware but not yet taken. */
+  bool buffered() const
+  {
+    return false;
+  }
+};
+
+template<class Hardware, int SIZE>
+class HardwareReader<Hardware, true, SIZE>
+{
+public:
+  HardwareReader() : length_(0), index_(0) {}
+
+  int read(Hardware& hardware)
+  {
+    if (index_ == length_)
+    {
+      index_ = 0;
+      length_ = hardware.read(buffer_, SIZE);
+      if (length_ <= 0)
+      {
+        length_ = 0;
+        return -1;
+      }
+    }
+    return buffer_[index_++];
+  }
+
+  bool buffered() const
+  {
+    return index_ < length_;
+  }
+
+private:
+  uint8_t buffer_[SIZE];
+  int length_;
+  int index_;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_LINK_STATS_H_
+#define _ROS_LINK_STATS_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* What NodeHandle_ has seen of the link since it started, or since its
+ * resetLinkStats(). Bytes are counted as frames are built and read, before
+ * any COBS framing. */
+struct LinkStats
+{
+  uint32_t rx_frames;        // frames received whole, with a good checksum
+  uint32_t rx_bytes;         // bytes read from the hardware
+  uint32_t tx_frames;        // frames written, or queued to be
+  uint32_t tx_bytes;
+  uint32_t checksum_errors;  // frames thrown away for a bad length or frame checksum
+  uint32_t timeouts;         // frames abandoned part way, after SERIAL_MSG_TIMEOUT
+  uint32_t overruns;         // frames too long for their buffer, or for a full TX queue
+  uint32_t unknown_topics;   // frames for a topic id nothing subscribes to
+  uint32_t lost;             // messages the server numbered which never arrived; see FEATURE2_SEQUENCE
+  uint32_t max_spin_us;      // longest spinOnce(), in microseconds
+
+  LinkStats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    rx_frames = rx_bytes = tx_frames = tx_bytes = 0;
+    checksum_errors = timeouts = overruns = unknown_topics = lost = 0;
+    max_spin_us = 0;
+  }
+};
+
+/*
+ * The counters NodeHandle_ keeps of the link, which are only kept if
+ * ROSSERIAL_LINK_STATS is defined; otherwise, counting compiles to nothing,
+ * and NodeHandle_ has no getLinkStats(). ros/link_stats_diagnostics.h turns
+ * them into a diagnostic status to publish.
+ */
+#ifdef ROSSERIAL_LINK_STATS
+class LinkCounters
+{
+public:
+  enum { ENABLED = 1 };
+
+  void rxByte() { stats_.rx_bytes++; }
+  void rxFrame() { stats_.rx_frames++; }
+  void txFrame(int bytes) { stats_.tx_frames++; stats_.tx_bytes += bytes; }
+  void checksumError() { stats_.checksum_errors++; }
+  void timeout() { stats_.timeouts++; }
+  void overrun() { stats_.overruns++; }
+  void unknownTopic() { stats_.unknown_topics++; }
+  void lost(uint8_t messages) { stats_.lost += messages; }
+  void spun(uint32_t us) { if (us > stats_.max_spin_us) stats_.max_spin_us = us; }
+
+  const LinkStats& stats() const { return stats_; }
+  void reset() { stats_.reset(); }
+
+private:
+  LinkStats stats_;
+};
+#else
+class LinkCounters
+{
+public:
+  enum { ENABLED = 0 };
+
+  void rxByte() {}
+  void rxFrame() {}
+  void txFrame(int) {}
+  void checksumError() {}
+  void timeout() {}
+  void overrun() {}
+  void unknownTopic() {}
+  void lost(uint8_t) {}
+  void spun(uint32_t) {}
+};
+#endif
+
+}
+
+#endif
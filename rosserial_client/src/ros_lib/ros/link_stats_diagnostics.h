@@ -0,0 +1,132 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_LINK_STATS_DIAGNOSTICS_H_
+#define _ROS_LINK_STATS_DIAGNOSTICS_H_
+
+#include <stdint.h>
+
+#include "diagnostic_msgs/DiagnosticStatus.h"
+#include "diagnostic_msgs/KeyValue.h"
+#include "ros/link_stats.h"
+
+namespace ros
+{
+
+/*
+ * Turns the client's link stats into a diagnostic status, to be published
+ * now and then in a diagnostic_msgs/DiagnosticArray on /diagnostics, where
+ * it shows next to the server's stats for the same link:
+ *
+ *   ros::LinkStatsDiagnostics link_diagnostics("arduino: link");
+ *   diagnostic_msgs::DiagnosticArray array;
+ *   ros::Publisher diagnostics_pub("/diagnostics", &array);
+ *   ...
+ *   array.status_length = 1;
+ *   array.status = &link_diagnostics.update(nh.getLinkStats());
+ *   diagnostics_pub.publish(&array);
+ *
+ * The status holds the numbers as strings it keeps itself, so is valid until
+ * the next update(). It warns of checksum errors, timeouts, overruns or lost
+ * messages since the update before.
+ */
+class LinkStatsDiagnostics
+{
+public:
+  explicit LinkStatsDiagnostics(const char * name) : last_errors_(0)
+  {
+    const char * keys[VALUES] = { "rx_frames", "rx_bytes", "tx_frames", "tx_bytes", "checksum_errors",
+                                  "timeouts", "overruns", "unknown_topics", "lost", "max_spin_us" };
+    for (int i = 0; i < VALUES; i++)
+    {
+      values_[i].key = keys[i];
+      values_[i].value = text_[i];
+    }
+    status_.name = name;
+    status_.hardware_id = "";
+    status_.values_length = VALUES;
+    status_.values = values_;
+  }
+
+  const diagnostic_msgs::DiagnosticStatus & update(const LinkStats & stats)
+  {
+    uint32_t numbers[VALUES] = { stats.rx_frames, stats.rx_bytes, stats.tx_frames, stats.tx_bytes,
+                                 stats.checksum_errors, stats.timeouts, stats.overruns,
+                                 stats.unknown_topics, stats.lost, stats.max_spin_us };
+    for (int i = 0; i < VALUES; i++)
+      format(numbers[i], text_[i]);
+
+    uint32_t errors = stats.checksum_errors + stats.timeouts + stats.overruns + stats.lost;
+    if (errors != last_errors_)
+    {
+      status_.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status_.message = "Link errors since the last report.";
+    }
+    else
+    {
+      status_.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status_.message = "OK";
+    }
+    last_errors_ = errors;
+    return status_;
+  }
+
+private:
+  enum { VALUES = 10 };
+
+  /* Writes n out in decimal, without pulling in printf. */
+  static void format(uint32_t n, char * text)
+  {
+    char digits[10];
+    int length = 0;
+    do
+    {
+      digits[length++] = '0' + n % 10;
+      n /= 10;
+    }
+    while (n > 0);
+    for (int i = 0; i < length; i++)
+      text[i] = digits[length - 1 - i];
+    text[length] = '\0';
+  }
+
+  diagnostic_msgs::DiagnosticStatus status_;
+  diagnostic_msgs::KeyValue values_[VALUES];
+  char text_[VALUES][11];
+  uint32_t last_errors_;
+};
+
+}
+
+#endif
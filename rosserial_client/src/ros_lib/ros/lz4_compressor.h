@@ -0,0 +1,129 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_LZ4_COMPRESSOR_H_
+#define _ROS_LZ4_COMPRESSOR_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Compresses into the LZ4 block format, greedily, finding matches through a
+ * hash table of 1 << HASH_LOG positions, the only memory it needs besides
+ * the input and output. A smaller table finds fewer matches. Inputs must be
+ * under 64k. */
+template<int HASH_LOG>
+class Lz4Compressor
+{
+public:
+  /* Compresses n bytes from in into at most capacity bytes at out, returning
+   * the compressed length, or -1 if it won't fit. */
+  int compress(const uint8_t * in, int n, uint8_t * out, int capacity)
+  {
+    for (int i = 0; i < (1 << HASH_LOG); i++)
+      table_[i] = 0;
+
+    int o = 0;
+    int anchor = 0;
+    int i = 0;
+    /* as the format requires, the last match starts at least 12 bytes from
+     * the end, and ends at least 5 from it */
+    while (i + 12 <= n)
+    {
+      uint32_t sequence = read32(in + i);
+      uint32_t h = (uint32_t)(sequence * 2654435761UL) >> (32 - HASH_LOG);
+      int ref = table_[h];
+      table_[h] = (uint16_t) i;
+      if (ref >= i || read32(in + ref) != sequence)
+      {
+        i++;
+        continue;
+      }
+      int length = 4;
+      while (i + length < n - 5 && in[ref + length] == in[i + length])
+        length++;
+
+      int literals = i - anchor;
+      if (o + 1 + literals + literals / 255 + 1 + 2 + (length - 4) / 255 + 1 > capacity)
+        return -1;
+      uint8_t * token = out + o++;
+      *token = (uint8_t)(((literals < 15 ? literals : 15) << 4) | (length - 4 < 15 ? length - 4 : 15));
+      o = writeLength(out, o, literals);
+      for (int j = 0; j < literals; j++)
+        out[o++] = in[anchor + j];
+      out[o++] = (uint8_t)((i - ref) & 255);
+      out[o++] = (uint8_t)((i - ref) >> 8);
+      o = writeLength(out, o, length - 4);
+      i += length;
+      anchor = i;
+    }
+
+    int literals = n - anchor;
+    if (o + 1 + literals + literals / 255 + 1 > capacity)
+      return -1;
+    out[o++] = (uint8_t)((literals < 15 ? literals : 15) << 4);
+    o = writeLength(out, o, literals);
+    for (int j = 0; j < literals; j++)
+      out[o++] = in[anchor + j];
+    return o;
+  }
+
+private:
+  static uint32_t read32(const uint8_t * p)
+  {
+    return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+  }
+
+  /* Writes what's left of a length of 15 or more, after the 15 in the token. */
+  static int writeLength(uint8_t * out, int o, int length)
+  {
+    if (length < 15)
+      return o;
+    length -= 15;
+    while (length >= 255)
+    {
+      out[o++] = 255;
+      length -= 255;
+    }
+    out[o++] = (uint8_t) length;
+    return o;
+  }
+
+  uint16_t table_[1 << HASH_LOG];
+};
+
+}
+
+#endif
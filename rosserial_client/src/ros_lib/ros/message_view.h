@@ -0,0 +1,215 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_MESSAGE_VIEW_H_
+#define _ROS_MESSAGE_VIEW_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ros/msg.h"
+
+#if defined(ROSSERIAL_CHECK_VIEWS) && !defined(ROSSERIAL_VIEW_EXPIRED)
+#include <assert.h>
+#define ROSSERIAL_VIEW_EXPIRED() assert(!"message view used after its callback returned")
+#endif
+
+namespace ros
+{
+
+/*
+ * Views, and the strings read through them, point into NodeHandle's receive
+ * buffer, and are only valid until the subscriber callback they were handed
+ * to returns; after that the buffer is reused for the next message. Define
+ * ROSSERIAL_CHECK_VIEWS to have every read through a view check that it is
+ * still valid, and call ROSSERIAL_VIEW_EXPIRED() if not. This costs a few
+ * bytes per view and a comparison per read, so is meant for debug builds.
+ */
+#ifdef ROSSERIAL_CHECK_VIEWS
+/* Bumped by NodeHandle_ each time a subscriber callback returns, which
+ * expires every view created before then. */
+inline uint32_t& viewGeneration()
+{
+  static uint32_t generation = 0;
+  return generation;
+}
+#endif
+
+/* Tracks whether the receive buffer a view points into has been reused. */
+class ViewLifetime
+{
+public:
+#ifdef ROSSERIAL_CHECK_VIEWS
+  ViewLifetime() : generation_(viewGeneration()) {}
+
+  bool valid() const
+  {
+    return generation_ == viewGeneration();
+  }
+
+  void check() const
+  {
+    if (!valid())
+      ROSSERIAL_VIEW_EXPIRED();
+  }
+
+private:
+  uint32_t generation_;
+#else
+  bool valid() const
+  {
+    return true;
+  }
+
+  void check() const {}
+#endif
+};
+
+/* A string within a serialized message. It is not NUL-terminated, and
+ * points into the buffer the message was received in. */
+class StringView : public ViewLifetime
+{
+public:
+  StringView() : data_(0), length_(0) {}
+  StringView(const char * data, uint32_t length) : data_(data), length_(length) {}
+
+  const char * data() const
+  {
+    check();
+    return data_;
+  }
+
+  uint32_t length() const
+  {
+    return length_;
+  }
+
+  /* Copies the string into buffer, NUL-terminated and cut short if need be
+   * to fit within size bytes, for using it after the callback returns. */
+  void copy(char * buffer, uint32_t size) const
+  {
+    if (size == 0)
+      return;
+    uint32_t n = (length_ < size - 1) ? length_ : size - 1;
+    memcpy(buffer, data(), n);
+    buffer[n] = 0;
+  }
+
+private:
+  const char * data_;
+  uint32_t length_;
+};
+
+template<int BYTES> struct ViewBits {};
+template<> struct ViewBits<1> { typedef uint8_t type; };
+template<> struct ViewBits<2> { typedef uint16_t type; };
+template<> struct ViewBits<4> { typedef uint32_t type; };
+template<> struct ViewBits<8> { typedef uint64_t type; };
+
+/* Base for the View class generated inside each message, which reads the
+ * message's fields straight out of its serialized form, as they are
+ * asked for, instead of deserializing the whole thing up front. */
+class MessageView : public ViewLifetime
+{
+public:
+  explicit MessageView(const uint8_t * data) : data_(data) {}
+
+  const uint8_t * data() const
+  {
+    return data_;
+  }
+
+protected:
+  /* Reads a little-endian integer or float at offset. */
+  template<typename V>
+  V readValue(uint32_t offset) const
+  {
+    check();
+    typedef typename ViewBits<sizeof(V)>::type BitsT;
+    BitsT bits = 0;
+    for (size_t i = 0; i < sizeof(V); i++)
+      bits |= ((BitsT) data_[offset + i]) << (8 * i);
+    V value;
+    memcpy(&value, &bits, sizeof(V));
+    return value;
+  }
+
+  /* Reads a nested message, as a view which expires along with this one. */
+  template<typename ViewT>
+  ViewT readView(uint32_t offset) const
+  {
+    check();
+    return ViewT(data_ + offset);
+  }
+
+  StringView readString(uint32_t offset) const
+  {
+    return StringView((const char *)(data_ + offset + 4), readValue<uint32_t>(offset));
+  }
+
+  /* Reads a ros::Time or ros::Duration. */
+  template<typename T>
+  T readStamp(uint32_t offset) const
+  {
+    T stamp;
+    stamp.sec = readValue<uint32_t>(offset);
+    stamp.nsec = readValue<uint32_t>(offset + 4);
+    return stamp;
+  }
+
+  /* Reads a float field make_library was given a quantization for. */
+  template<typename T>
+  T readQuantized(uint32_t offset, double scale, double value_offset, int bytes) const
+  {
+    check();
+    T f;
+    Msg::deserializeQuantized(data_ + offset, &f, scale, value_offset, bytes);
+    return f;
+  }
+
+  float readAvrFloat64(uint32_t offset) const
+  {
+    check();
+    float f;
+    Msg::deserializeAvrFloat64(data_ + offset, &f);
+    return f;
+  }
+
+  const uint8_t * data_;
+};
+
+}
+
+#endif
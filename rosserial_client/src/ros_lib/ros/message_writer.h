@@ -0,0 +1,160 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_MESSAGE_WRITER_H_
+#define _ROS_MESSAGE_WRITER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ros/msg.h"
+
+namespace ros
+{
+
+/* Serializes a message field by field, straight into the buffer lent out
+ * by Publisher::loan(), so that large messages need not be held in RAM
+ * twice. Fields must be written in the order they appear in the message
+ * definition; a variable-length array is its length as a uint32_t followed
+ * by each element in turn. For example, for a sensor_msgs/LaserScan:
+ *
+ *   ros::MessageWriter w = pub.loan();
+ *   w.writeMessage(header);
+ *   w.write(angle_min);
+ *   ...
+ *   w.write(range_max);
+ *   w.write((uint32_t) NUM_RANGES);
+ *   for (int i = 0; i < NUM_RANGES; i++)
+ *     w.write(readRange(i));
+ *   w.write((uint32_t) 0);     // no intensities
+ *   pub.publish(w);
+ *
+ * Writes which would run past the end of the buffer are dropped and leave
+ * the writer !ok(), in which case publishing it fails. Until publish(), the
+ * buffer is kept from anything else sent on the same NodeHandle: that is
+ * sent from a second buffer where the hardware writes asynchronously, and is
+ * dropped otherwise, as is anything for the TX queue. */
+class MessageWriter
+{
+public:
+  MessageWriter() : data_(0), capacity_(0), length_(0), ok_(false) {}
+
+  MessageWriter(uint8_t * data, int capacity) :
+    data_(data), capacity_(capacity), length_(0), ok_(data != 0) {}
+
+  template<typename V>
+  void write(const V value)
+  {
+    if (reserve(sizeof(V)))
+    {
+      Msg::varToArr(data_ + length_, value);
+      length_ += sizeof(V);
+    }
+  }
+
+  void write(const float value)
+  {
+    union
+    {
+      float real;
+      uint32_t base;
+    } u;
+    u.real = value;
+    write(u.base);
+  }
+
+  void write(const bool value)
+  {
+    write((uint8_t) value);
+  }
+
+  void write(const char * value)
+  {
+    uint32_t length = strlen(value);
+    write(length);
+    if (reserve(length))
+    {
+      memcpy(data_ + length_, value, length);
+      length_ += length;
+    }
+  }
+
+  void write(char * value)
+  {
+    write((const char *) value);
+  }
+
+  /* Nested messages are serialized whole, so the caller must make sure
+   * this one fits in what is left of the buffer. */
+  void writeMessage(const Msg & msg)
+  {
+    if (ok_)
+      length_ += msg.serialize(data_ + length_);
+    if (length_ > capacity_)
+      ok_ = false;
+  }
+
+  bool ok() const
+  {
+    return ok_;
+  }
+
+  int length() const
+  {
+    return length_;
+  }
+
+  /* Whether the writer has a buffer on loan, which publishing it hands back. */
+  bool lent() const
+  {
+    return data_ != 0;
+  }
+
+private:
+  bool reserve(int length)
+  {
+    if (length_ + length > capacity_)
+      ok_ = false;
+    return ok_;
+  }
+
+  uint8_t * data_;
+  int capacity_;
+  int length_;
+  bool ok_;
+};
+
+}
+
+#endif
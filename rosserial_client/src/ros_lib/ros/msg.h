@@ -35,12 +35,46 @@
 #ifndef _ROS_MSG_H_
 #define _ROS_MSG_H_
 
+#include <math.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+
+#include "ros/flash_string.h"
+
+/* Generated messages copy arrays of integers and floats wholesale when the
+ * target stores them in the same little-endian byte order as the wire. */
+#ifndef ROSSERIAL_LITTLE_ENDIAN
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#define ROSSERIAL_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#elif defined(_WIN32)
+#define ROSSERIAL_LITTLE_ENDIAN 1
+#else
+#define ROSSERIAL_LITTLE_ENDIAN 0
+#endif
+#endif
+
+/* The shared serializers are only smaller than writing out each byte if
+ * they stay out of line. */
+#ifndef ROSSERIAL_NOINLINE
+#if defined(__GNUC__)
+#define ROSSERIAL_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define ROSSERIAL_NOINLINE __declspec(noinline)
+#else
+#define ROSSERIAL_NOINLINE
+#endif
+#endif
 
 namespace ros
 {
 
+/* The unsigned integer of a given number of bytes. */
+template<int BYTES> struct UnsignedOfSize;
+template<> struct UnsignedOfSize<2> { typedef uint16_t type; };
+template<> struct UnsignedOfSize<4> { typedef uint32_t type; };
+template<> struct UnsignedOfSize<8> { typedef uint64_t type; };
+
 /* Base Message Type */
 class Msg
 {
@@ -50,11 +84,24 @@ public:
   virtual const char * getType() = 0;
   virtual const char * getMD5() = 0;
 
+  /* The number of bytes serialize() will write, so that a message can be
+   * checked against a buffer before it is serialized into it. Generated
+   * messages also have SERIALIZED_SIZE, which is that length at compile time
+   * for types whose SERIALIZED_SIZE_FIXED is true. 0 if it isn't known. */
+  virtual uint32_t serializedLength() const
+  {
+    return 0;
+  }
+
   /**
    * @brief This tricky function handles promoting a 32bit float to a 64bit
    *        double, so that AVR can publish messages containing float64
    *        fields, despite AVV having no native support for double.
    *
+   * The float's sign, exponent and mantissa are moved into the two 32-bit
+   * words of the double, rather than a byte at a time, and without comparing
+   * floats, which AVR does in software.
+   *
    * @param[out] outbuffer pointer for buffer to serialize to.
    * @param[in] f value to serialize.
    *
@@ -63,29 +110,20 @@ public:
    */
   static int serializeAvrFloat64(unsigned char* outbuffer, const float f)
   {
-    const int32_t* val = (int32_t*) &f;
-    int32_t exp = ((*val >> 23) & 255);
-    if (exp != 0)
-    {
-      exp += 1023 - 127;
-    }
+    uint32_t val;
+    memcpy(&val, &f, sizeof(val));
 
-    int32_t sig = *val;
-    *(outbuffer++) = 0;
-    *(outbuffer++) = 0;
-    *(outbuffer++) = 0;
-    *(outbuffer++) = (sig << 5) & 0xff;
-    *(outbuffer++) = (sig >> 3) & 0xff;
-    *(outbuffer++) = (sig >> 11) & 0xff;
-    *(outbuffer++) = ((exp << 4) & 0xF0) | ((sig >> 19) & 0x0F);
-    *(outbuffer++) = (exp >> 4) & 0x7F;
-
-    // Mark negative bit as necessary.
-    if (f < 0)
-    {
-      *(outbuffer - 1) |= 0x80;
-    }
+    // Rebias the exponent, keeping zeroes, and infinities and NaNs.
+    uint32_t exp = (val >> 23) & 0xff;
+    if (exp == 0xff)
+      exp = 0x7ff;
+    else if (exp != 0)
+      exp += 1023 - 127;
 
+    uint32_t high = (val & 0x80000000UL) | (exp << 20) | ((val >> 3) & 0xfffff);
+    uint32_t low = val << 29;
+    writeWord(outbuffer, low);
+    writeWord(outbuffer + 4, high);
     return 8;
   }
 
@@ -94,6 +132,8 @@ public:
    *        32bit float, so that AVR can understand messages containing
    *        float64 fields, despite AVR having no native support for double.
    *
+   * Values too small for a float become zero, and ones too large infinity.
+   *
    * @param[in] inbuffer pointer for buffer to deserialize from.
    * @param[out] f pointer to place the deserialized value in.
    *
@@ -101,29 +141,166 @@ public:
    */
   static int deserializeAvrFloat64(const unsigned char* inbuffer, float* f)
   {
-    uint32_t* val = (uint32_t*)f;
-    inbuffer += 3;
-
-    // Copy truncated mantissa.
-    *val = ((uint32_t)(*(inbuffer++)) >> 5 & 0x07);
-    *val |= ((uint32_t)(*(inbuffer++)) & 0xff) << 3;
-    *val |= ((uint32_t)(*(inbuffer++)) & 0xff) << 11;
-    *val |= ((uint32_t)(*inbuffer) & 0x0f) << 19;
+    uint32_t low = readWord(inbuffer);
+    uint32_t high = readWord(inbuffer + 4);
 
-    // Copy truncated exponent.
-    uint32_t exp = ((uint32_t)(*(inbuffer++)) & 0xf0) >> 4;
-    exp |= ((uint32_t)(*inbuffer) & 0x7f) << 4;
-    if (exp != 0)
+    // Truncate the mantissa, and rebias the exponent.
+    uint32_t val = high & 0x80000000UL;
+    uint32_t mantissa = ((high & 0xfffff) << 3) | (low >> 29);
+    uint32_t exp = (high >> 20) & 0x7ff;
+    if (exp == 0x7ff)
     {
-      *val |= ((exp) - 1023 + 127) << 23;
+      // Keep NaNs NaN, even when all of their payload is in the bits dropped.
+      val |= 0x7f800000UL | mantissa;
+      if (mantissa == 0 && (low & 0x1fffffff) != 0)
+        val |= 1;
     }
+    else if (exp >= 1023 + 128)
+      val |= 0x7f800000UL;
+    else if (exp > 1023 - 127)
+      val |= ((exp - 1023 + 127) << 23) | mantissa;
 
-    // Copy negative sign.
-    *val |= ((uint32_t)(*(inbuffer++)) & 0x80) << 24;
-
+    memcpy(f, &val, sizeof(val));
     return 8;
   }
 
+  /**
+   * @brief Serializes an array of float64 from AVR floats, as
+   *        serializeAvrFloat64() does each one.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  static int serializeAvrFloat64Array(unsigned char* outbuffer, const float* f, uint32_t length)
+  {
+    for (uint32_t i = 0; i < length; i++)
+      serializeAvrFloat64(outbuffer + i * 8, f[i]);
+    return length * 8;
+  }
+
+  /**
+   * @brief Deserializes an array of float64 into AVR floats, as
+   *        deserializeAvrFloat64() does each one.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  static int deserializeAvrFloat64Array(const unsigned char* inbuffer, float* f, uint32_t length)
+  {
+    for (uint32_t i = 0; i < length; i++)
+      deserializeAvrFloat64(inbuffer + i * 8, f + i);
+    return length * 8;
+  }
+
+  /**
+   * @brief Serializes a float field which make_library was given a
+   *        quantization for, as fixed point: (f - offset) / scale, rounded to
+   *        a signed integer of bytes bytes, little endian, and clamped to
+   *        within its range. The least such integer stands for NaN.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  static int serializeQuantized(unsigned char* outbuffer, double f, double scale, double offset, int bytes)
+  {
+    int32_t max = (bytes >= 4) ? (int32_t) 0x7fffffffL : (int32_t) (((uint32_t) 1 << (8 * bytes - 1)) - 1);
+    int32_t q;
+    double scaled = (f - offset) / scale;
+    if (scaled != scaled)
+      q = -max - 1;
+    else if (scaled >= (double) max)
+      q = max;
+    else if (scaled <= (double) -max)
+      q = -max;
+    else
+      q = (int32_t) (scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+    for (int i = 0; i < bytes; i++)
+      outbuffer[i] = ((uint32_t) q >> (8 * i)) & 0xff;
+    return bytes;
+  }
+
+  /**
+   * @brief Deserializes a float field sent as serializeQuantized() sends it.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  template<typename T>
+  static int deserializeQuantized(const unsigned char* inbuffer, T* f, double scale, double offset, int bytes)
+  {
+    uint32_t bits = 0;
+    for (int i = 0; i < bytes; i++)
+      bits |= ((uint32_t) inbuffer[i]) << (8 * i);
+    /* sign extend, and take the least value for NaN */
+    uint32_t sign = (uint32_t) 1 << (8 * bytes - 1);
+    if (bytes < 4 && (bits & sign))
+      bits |= ~(sign - 1);
+    if (bits == ~(sign - 1))
+      *f = (T) NAN;
+    else
+      *f = (T) ((int32_t) bits * scale + offset);
+    return bytes;
+  }
+
+  /**
+   * @brief Serializes a field of 2, 4 or 8 bytes, as messages generated with
+   *        shared serializers do, through one out-of-line function for each
+   *        width rather than a sequence of shifts for each field; floats are
+   *        sent as the bits of the integer of the same size.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  template<typename V>
+  static int serializeValue(unsigned char* outbuffer, const V value)
+  {
+    typename UnsignedOfSize<sizeof(V)>::type bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeLittleEndian(outbuffer, bits);
+    return sizeof(V);
+  }
+
+  /**
+   * @brief Deserializes a field sent as serializeValue() sends it.
+   *
+   * @return number of bytes to advance the buffer pointer.
+   */
+  template<typename V>
+  static int deserializeValue(const unsigned char* inbuffer, V& value)
+  {
+    typename UnsignedOfSize<sizeof(V)>::type bits;
+    readLittleEndian(inbuffer, bits);
+    memcpy(&value, &bits, sizeof(value));
+    return sizeof(V);
+  }
+
+  static ROSSERIAL_NOINLINE void writeLittleEndian(unsigned char* buffer, uint16_t bits)
+  {
+    buffer[0] = bits & 0xff;
+    buffer[1] = (bits >> 8) & 0xff;
+  }
+
+  static ROSSERIAL_NOINLINE void writeLittleEndian(unsigned char* buffer, uint32_t bits)
+  {
+    writeWord(buffer, bits);
+  }
+
+  static ROSSERIAL_NOINLINE void writeLittleEndian(unsigned char* buffer, uint64_t bits)
+  {
+    writeWord(buffer, (uint32_t) bits);
+    writeWord(buffer + 4, (uint32_t) (bits >> 32));
+  }
+
+  static ROSSERIAL_NOINLINE void readLittleEndian(const unsigned char* buffer, uint16_t& bits)
+  {
+    bits = (uint16_t) (buffer[0] | (buffer[1] << 8));
+  }
+
+  static ROSSERIAL_NOINLINE void readLittleEndian(const unsigned char* buffer, uint32_t& bits)
+  {
+    bits = readWord(buffer);
+  }
+
+  static ROSSERIAL_NOINLINE void readLittleEndian(const unsigned char* buffer, uint64_t& bits)
+  {
+    bits = readWord(buffer) | ((uint64_t) readWord(buffer + 4) << 32);
+  }
+
   // Copy data from variable into a byte array
   template<typename A, typename V>
   static void varToArr(A arr, const V var)
@@ -141,6 +318,20 @@ public:
       var |= (arr[i] << (8 * i));
   }
 
+private:
+  static void writeWord(unsigned char* buffer, uint32_t word)
+  {
+    buffer[0] = word & 0xff;
+    buffer[1] = (word >> 8) & 0xff;
+    buffer[2] = (word >> 16) & 0xff;
+    buffer[3] = (word >> 24) & 0xff;
+  }
+
+  static uint32_t readWord(const unsigned char* buffer)
+  {
+    return (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8) |
+           ((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+  }
 };
 
 }  // namespace ros
@@ -43,6 +43,20 @@
 #include "rosserial_msgs/RequestParam.h"
 
 #include "ros/msg.h"
+#include "ros/message_view.h"
+#include "ros/hardware_async_write.h"
+#include "ros/hardware_baud.h"
+#include "ros/hardware_clock.h"
+#include "ros/hardware_flush.h"
+#include "ros/hardware_lock.h"
+#include "ros/hardware_multicast.h"
+#include "ros/hardware_reader.h"
+#include "ros/link_stats.h"
+#include "ros/tx_queue.h"
+#include "ros/lz4_compressor.h"
+#include "ros/delta_encoder.h"
+#include "ros/clock_sync.h"
+#include "ros/deferred_log.h"
 
 namespace ros
 {
@@ -51,8 +65,11 @@ class NodeHandleBase_
 {
 public:
   virtual int publish(int id, const Msg* msg) = 0;
+  virtual uint8_t* loan(int id, int* capacity) = 0;
+  virtual int publishLoan(int id, int length) = 0;
   virtual int spinOnce() = 0;
   virtual bool connected() = 0;
+  virtual uint64_t localMicros() = 0;
 };
 }
 
@@ -60,6 +77,7 @@ public:
 #include "ros/subscriber.h"
 #include "ros/service_server.h"
 #include "ros/service_client.h"
+#include "ros/static_subscribers.h"
 
 namespace ros
 {
@@ -69,6 +87,13 @@ const int SPIN_ERR = -1;
 const int SPIN_TIMEOUT = -2;
 
 const uint8_t SYNC_SECONDS  = 5;
+/*
+ * A client which hasn't been asked for its topics sends a time request with
+ * an empty body this often, in milliseconds, so that a server which doesn't
+ * know it has just come up can ask for them straight away, rather than when
+ * it gives up on the link. Older servers answer it with the time, as usual.
+ */
+const uint16_t SYNC_ANNOUNCE_MS = 500;
 const uint8_t MODE_FIRST_FF = 0;
 /*
  * The second sync byte is a protocol version. It's value is 0xff for the first
@@ -78,54 +103,329 @@ const uint8_t MODE_FIRST_FF = 0;
  * rosserial_arduino. It must be changed in both this file and in
  * rosserial_python/src/rosserial_python/SerialClient.py
  */
+/*
+ * A server which can take several messages in one frame says so with this bit
+ * in the body of its request for topics, which older servers send empty. Such a
+ * frame, on topic TopicInfo::ID_BATCH, carries a run of records, each being a
+ * 16-bit topic id, a 16-bit length and that many bytes of message, all little
+ * endian, under the frame's one checksum. Older clients ignore the body.
+ */
+const uint8_t FEATURE_BATCH       = 0x01;
+/*
+ * A server which can check frames with a CRC-16 says so with this bit. Frames
+ * which carry one are marked PROTOCOL_VER2_CRC16 in place of PROTOCOL_VER, and
+ * end in the CRC-16/CCITT-FALSE of their topic id and body, low byte first,
+ * rather than in the 8-bit checksum, which lets many burst errors through.
+ * The server answers in kind once it has had a CRC frame from the client.
+ */
+const uint8_t FEATURE_CRC16       = 0x02;
+/*
+ * A server which can take COBS framed frames says so with this bit. Such a
+ * frame is an ordinary one, COBS encoded so that it has no zero bytes in it,
+ * with a zero byte either side; a receiver which has lost its place then only
+ * has to wait for the next zero to find the start of a frame, rather than
+ * hunting for sync bytes which may also turn up in the middle of a message.
+ * Either end sends them only once it knows the other can take them, and takes
+ * either kind at any time.
+ */
+const uint8_t FEATURE_COBS        = 0x04;
+/*
+ * A server which can decompress messages says so with this bit. Publishers
+ * set to compress then say so with TopicInfo::FLAG_COMPRESSED, and the body of
+ * each frame on the topic is the 16-bit length of the message, then the
+ * message LZ4 compressed, or as it is if that would be no shorter.
+ */
+const uint8_t FEATURE_COMPRESSION = 0x08;
+/*
+ * A server which can remember the topics a client negotiated says so with this
+ * bit. The client then first sends a frame on TopicInfo::ID_TOPIC_FINGERPRINT
+ * holding a 32-bit hash of every TopicInfo it would send, low byte first, and
+ * a zero. The server answers with the same hash and a one if it has those
+ * topics from before, and has set them up again, in which case the client is
+ * done. Otherwise it answers with a zero, and the client sends its topics as
+ * usual, followed by the hash and a one, for the server to remember them by.
+ */
+const uint8_t FEATURE_TOPIC_FINGERPRINT = 0x10;
+/*
+ * A server which can look up several parameters at once says so with this
+ * bit. Such a request, on TopicInfo::ID_PARAMETER_BATCH, is a run of names,
+ * each a 32-bit length and that many bytes, and the answer, on the same
+ * topic, a RequestParamResponse for each name in turn, empty for any which
+ * the server doesn't have.
+ */
+const uint8_t FEATURE_PARAM_BATCH = 0x20;
+/*
+ * A server which can expand deferred log messages says so with this bit. Such
+ * a message, on TopicInfo::ID_LOG_DEFERRED, is packed by DeferredLog: the id
+ * of a format string, which the server looks up in the log dictionary that
+ * make_log_dictionary generates along with the ids, and the arguments to
+ * format it with there. Without this bit the client drops them.
+ */
+const uint8_t FEATURE_LOG_DEFERRED = 0x40;
+/*
+ * A server which can change the link's rate says so with this bit. Once the
+ * client has sent its topics, it offers the rates it can switch to, set with
+ * setBaudRates(), in a frame on TopicInfo::ID_BAUD: BAUD_OFFER, a count, and
+ * that many 32-bit rates. The server may answer with BAUD_SWITCH, the rate to
+ * switch to and the one to fall back to, then, at the new rate, a few frames
+ * of BAUD_PROBE, which the client sends back as they are. If they all come
+ * back intact, the server sends BAUD_CONFIRM; a client which hasn't had it
+ * BAUD_CONFIRM_MS after switching goes back to the fallback rate, and one
+ * which loses sync goes back to the rate it started at. All 32-bit values
+ * are little endian.
+ */
+const uint8_t FEATURE_BAUD        = 0x80;
+const uint8_t BAUD_OFFER          = 0;
+const uint8_t BAUD_SWITCH         = 1;
+const uint8_t BAUD_PROBE          = 2;
+const uint8_t BAUD_CONFIRM        = 3;
+const uint16_t BAUD_CONFIRM_MS    = 1000;
+/*
+ * Features past those eight go in a second byte of the request's body, which
+ * older servers leave off. A server which counts the messages lost on each
+ * topic says so with this bit there. Publishers and subscribers then say so
+ * with TopicInfo::FLAG_SEQUENCED, and every message on the topic, either way,
+ * starts with a byte numbering it, one more than the last and wrapping around,
+ * ahead of anything else in it, batched or not. Services aren't numbered.
+ */
+const uint8_t FEATURE2_SEQUENCE   = 0x01;
+/*
+ * A server which can rebuild messages from their differences says so with
+ * this bit, in the second byte. Publishers set to send deltas then say so
+ * with TopicInfo::FLAG_DELTA, and the body of each frame on the topic, after
+ * any sequence number, starts with a byte numbering the keyframe it goes
+ * with, DELTA_KEYFRAME_MASK of it. Without DELTA_ENCODED, the message follows
+ * as it is, and is the keyframe by that number; with it, the 16-bit length of
+ * the message follows, then the message as DeltaEncoder encodes it against
+ * that keyframe. The server drops deltas on a keyframe it doesn't have.
+ */
+const uint8_t FEATURE2_DELTA      = 0x02;
+const uint8_t DELTA_ENCODED       = 0x80;
+const uint8_t DELTA_KEYFRAME_MASK = 0x7f;
+/*
+ * A server which only publishes a topic on to subscribers pauses it while it
+ * has none, with a frame on TopicInfo::ID_TOPIC_PAUSE holding the topic's
+ * 16-bit id, little endian, and a one, and resumes it the same way with a
+ * zero. Publishing on a paused topic sends nothing. Every topic starts out
+ * resumed each time the server asks for them. Older clients ignore these.
+ */
+/*
+ * A server which sends some topics once to a multicast group, for all its
+ * clients at once, says so with this bit, in the second byte. Where the
+ * hardware can read from the group (see ros/hardware_multicast.h),
+ * subscribers then say so with TopicInfo::FLAG_MULTICAST, and for each topic
+ * the server sends from the group it answers with a frame on
+ * TopicInfo::ID_TOPIC_MULTICAST holding the topic's 16-bit id, the 16-bit id
+ * the topic has in the group, the group's four-byte IPv4 address and its
+ * 16-bit port, all little endian. Each datagram sent to the group is one
+ * plain frame, without sequence numbers, on the id the topic has there,
+ * MULTICAST_ID_BASE and up; nothing more is sent on the topic directly.
+ */
+const uint8_t FEATURE2_MULTICAST  = 0x04;
+const uint16_t MULTICAST_ID_BASE  = 0x8000;
+/*
+ * Whether getType() and getMD5() point into flash, as they do in libraries
+ * generated to keep them there; see ros/flash_string.h.
+ */
+#if defined(ROSSERIAL_FLASH_STRINGS)
+const bool MSG_STRINGS_IN_FLASH = true;
+#else
+const bool MSG_STRINGS_IN_FLASH = false;
+#endif
 const uint8_t MODE_PROTOCOL_VER   = 1;
 const uint8_t PROTOCOL_VER1       = 0xff; // through groovy
 const uint8_t PROTOCOL_VER2       = 0xfe; // in hydro
 const uint8_t PROTOCOL_VER        = PROTOCOL_VER2;
+const uint8_t PROTOCOL_VER2_CRC16 = 0xfd;
 const uint8_t MODE_SIZE_L         = 2;
 const uint8_t MODE_SIZE_H         = 3;
 const uint8_t MODE_SIZE_CHECKSUM  = 4;    // checksum for msg size received from size L and H
 const uint8_t MODE_TOPIC_L        = 5;    // waiting for topic id
 const uint8_t MODE_TOPIC_H        = 6;
 const uint8_t MODE_MESSAGE        = 7;
-const uint8_t MODE_MSG_CHECKSUM   = 8;    // checksum for msg and topic id
+const uint8_t MODE_MSG_CHECKSUM   = 8;    // checksum for msg and topic id, or low byte of CRC
+const uint8_t MODE_MSG_CRC_H      = 9;    // high byte of CRC for msg and topic id
+
+/* States of the COBS decoder, which sits in front of the frame state machine. */
+const uint8_t COBS_OFF            = 0;    // between plain frames
+const uint8_t COBS_FIRST_CODE     = 1;    // after a zero, waiting for a frame's first code byte
+const uint8_t COBS_FIRST_DATA     = 2;    // waiting for the first byte of a frame, 0xff
+const uint8_t COBS_DATA           = 3;    // in the rest of a frame
 
 
 const uint8_t SERIAL_MSG_TIMEOUT  = 20;   // 20 milliseconds to recieve all of message data
 
 using rosserial_msgs::TopicInfo;
 
+/* One parameter for NodeHandle_::getParams() to fetch: its name, and the
+ * caller's storage for length values of it, which get filled in straight
+ * from the server's answer. ok is set once they have been. */
+class Param
+{
+public:
+  enum Type { INTS, FLOATS, BOOLS, STRINGS };
+
+  Param(const char * name, int * values, int length = 1)
+    : name(name), type(INTS), values(values), length(length), ok(false) {}
+  Param(const char * name, float * values, int length = 1)
+    : name(name), type(FLOATS), values(values), length(length), ok(false) {}
+  Param(const char * name, bool * values, int length = 1)
+    : name(name), type(BOOLS), values(values), length(length), ok(false) {}
+  /* Each string is copied into the buffer it points to, which must be big
+   * enough for it. */
+  Param(const char * name, char ** values, int length = 1)
+    : name(name), type(STRINGS), values(values), length(length), ok(false) {}
+
+  const char * name;
+  Type type;
+  void * values;
+  int length;
+  bool ok;
+};
+
 /* Node Handle */
 template<class Hardware,
          int MAX_SUBSCRIBERS = 25,
          int MAX_PUBLISHERS = 25,
          int INPUT_SIZE = 512,
-         int OUTPUT_SIZE = 512>
+         int OUTPUT_SIZE = 512,
+         int TX_QUEUE_SLOTS = 0,
+         int RX_FRAME_SLOTS = 1,
+         int BATCH_SIZE = 0,
+         int COMPRESS_SIZE = 0,
+         int TIME_SYNC_SAMPLES = 0,
+         class StaticSubscribers = DynamicSubscribers>
 class NodeHandle_ : public NodeHandleBase_
 {
+public:
+  /* Adds a byte to a CRC-16/CCITT-FALSE, a nibble at a time, to keep the
+   * table small. */
+  static uint16_t crc16Update(uint16_t crc, uint8_t data)
+  {
+    static const uint16_t table[16] =
+    {
+      0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+      0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+    };
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data >> 4)];
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data & 0x0f)];
+    return crc;
+  }
+
 protected:
   Hardware hardware_;
+  HardwareReader<Hardware> hardware_reader_;
+
+  /* With TX_QUEUE_SLOTS > 0, frames on user topics are queued here and
+   * publish() returns without waiting for them to be written; spinOnce()
+   * sends them as the hardware has room. */
+  TxQueue<Hardware, TX_QUEUE_SLOTS, OUTPUT_SIZE> tx_queue_;
 
-  /* time used for syncing */
-  uint32_t rt_time;
+  /* local time the last time request went out, in microseconds */
+  uint64_t rt_time;
 
   /* used for computing current time */
   uint32_t sec_offset, nsec_offset;
 
+  /* With TIME_SYNC_SAMPLES > 0, the time is kept from the last that many
+   * syncs, by ClockSync, which also corrects for the local clock's drift,
+   * for timestamps consistent to well under a millisecond on hardware with
+   * time_us(). Otherwise, each sync sets it afresh. */
+  ClockSync<(TIME_SYNC_SAMPLES > 0) ? TIME_SYNC_SAMPLES : 1> clock_sync_;
+
+  /* the local clock, from the hardware's time_us() where it has one, so
+   * that stamps are to the microsecond */
+  HardwareClock<Hardware> clock_;
+
+  /* counts of what has crossed the link, with ROSSERIAL_LINK_STATS */
+  LinkCounters link_counters_;
+
   /* Spinonce maximum work timeout */
   uint32_t spin_timeout_;
 
-  uint8_t message_in[INPUT_SIZE];
-  uint8_t message_out[OUTPUT_SIZE];
-
+  /* Frames are received into one of RX_FRAME_SLOTS buffers, message_in
+   * being the one currently filling. With more than one, spinOnce() pulls in
+   * every complete frame the hardware has waiting, up to that many, before
+   * calling back subscribers with them, so that the hardware's own receive
+   * buffer only has to hold what arrives during one callback at a time.
+   * The first rx_pending_ slots hold frames, of which the first
+   * rx_dispatched_ have been handed to their subscribers. */
+  uint8_t rx_frames_[RX_FRAME_SLOTS][INPUT_SIZE];
+  int rx_topics_[RX_FRAME_SLOTS];
+  int rx_pending_;
+  int rx_dispatched_;
+  uint8_t * message_in;
+
+  /* Frames are built in message_out, which is one of TX_FRAMES buffers:
+   * two where the hardware writes asynchronously, so that the next frame can
+   * be built in one while the last is still being sent from the other. */
+  enum { TX_FRAMES = HasAsyncWrite<Hardware>::value ? 2 : 1 };
+  uint8_t tx_frames_[TX_FRAMES][OUTPUT_SIZE];
+  int tx_frame_;
+  uint8_t * message_out;
+
+  /* With BATCH_SIZE > 0, and a server that can take them, messages on user
+   * topics are gathered into a frame of up to that many bytes, which is sent
+   * when the next one won't fit, when any other frame is sent, and at the
+   * start and end of each spinOnce(). This saves the header and checksum of
+   * each message, and a hardware write for each, at the cost of holding
+   * messages back until the next spinOnce(). Batched messages don't go
+   * through the TX queue. */
+  uint8_t batch_[BATCH_SIZE > 0 ? BATCH_SIZE : 1];
+  int batch_length_;
+  bool batching_;
+
+  /* With COMPRESS_SIZE > 0, and a server that can decompress them, messages
+   * on publishers set to compress are serialized here, then compressed into
+   * their frame. This suits large, repetitive messages on slow links; it
+   * costs this buffer, the compressor's table, and time in publish().
+   * Compressed messages aren't batched. */
+  uint8_t compress_in_[COMPRESS_SIZE > 0 ? COMPRESS_SIZE : 1];
+  Lz4Compressor<(COMPRESS_SIZE > 0) ? 8 : 1> compressor_;
+  bool compressing_;
+
+  /* Where the hardware can read from a multicast group, each datagram from
+   * it is read whole into here, a frame and room to spare to tell one that
+   * is too long. */
+  uint8_t multicast_in_[HardwareMulticast<Hardware>::supported ? INPUT_SIZE + 8 : 1];
+
+  /* Slots are handed out in order and never freed, so only the first
+   * publishers_length_ and subscribers_length_ entries are ever in use. */
   Publisher * publishers[MAX_PUBLISHERS];
   Subscriber_ * subscribers[MAX_SUBSCRIBERS];
+  int publishers_length_;
+  int subscribers_length_;
+
+public:
+  /* The RAM, in bytes, taken by what the template's arguments size: frames
+   * received, frames sent with the TX queue and batch and compression
+   * buffers, and the tables of topics. sizeof(NodeHandle_) is the whole of
+   * it, these the parts worth trimming; all are constants, for checking a
+   * board's configuration against its budget at compile time:
+   *
+   *   static_assert(sizeof(ros::NodeHandle) <= 1024, "NodeHandle too big");
+   *   static_assert(ros::NodeHandle::FOOTPRINT_RX <= 300, "INPUT_SIZE too big");
+   */
+  enum
+  {
+    FOOTPRINT_RX = RX_FRAME_SLOTS * (INPUT_SIZE + sizeof(int)) + sizeof(HardwareReader<Hardware>) +
+                   (HardwareMulticast<Hardware>::supported ? INPUT_SIZE + 8 : 1),
+    FOOTPRINT_TX = TX_FRAMES * OUTPUT_SIZE + sizeof(TxQueue<Hardware, TX_QUEUE_SLOTS, OUTPUT_SIZE>) +
+                   (BATCH_SIZE > 0 ? BATCH_SIZE : 1) + (COMPRESS_SIZE > 0 ? COMPRESS_SIZE : 1) +
+                   sizeof(Lz4Compressor<(COMPRESS_SIZE > 0) ? 8 : 1>),
+    FOOTPRINT_TOPICS = (MAX_PUBLISHERS + MAX_SUBSCRIBERS) * sizeof(void *)
+  };
 
   /*
    * Setup Functions
    */
 public:
-  NodeHandle_() : configured_(false)
+  NodeHandle_() : rx_pending_(0), rx_dispatched_(0), message_in(rx_frames_[0]), tx_frame_(0), message_out(tx_frames_[0]),
+    batch_length_(0), batching_(false), compressing_(false),
+    publishers_length_(0), subscribers_length_(0), rx_crc16_(false), tx_crc16_(false), tx_cobs_(false),
+    configured_(false), fingerprinting_(false), param_batch_(false), log_deferred_(false),
+    baud_(false), baud_rates_(0), baud_rates_length_(0), baud_initial_(0), baud_pending_(false),
+    sequencing_(false), deltas_(false), multicast_(false), loan_frame_(0)
   {
 
     for (unsigned int i = 0; i < MAX_PUBLISHERS; i++)
@@ -134,11 +434,16 @@ public:
     for (unsigned int i = 0; i < MAX_SUBSCRIBERS; i++)
       subscribers[i] = 0;
 
-    for (unsigned int i = 0; i < INPUT_SIZE; i++)
-      message_in[i] = 0;
+    for (unsigned int j = 0; j < RX_FRAME_SLOTS; j++)
+      for (unsigned int i = 0; i < INPUT_SIZE; i++)
+        rx_frames_[j][i] = 0;
+
+    for (unsigned int j = 0; j < TX_FRAMES; j++)
+      for (unsigned int i = 0; i < OUTPUT_SIZE; i++)
+        tx_frames_[j][i] = 0;
 
-    for (unsigned int i = 0; i < OUTPUT_SIZE; i++)
-      message_out[i] = 0;
+    param_batch_pending_ = 0;
+    param_batch_count_ = 0;
 
     req_param_resp.ints_length = 0;
     req_param_resp.ints = NULL;
@@ -148,6 +453,12 @@ public:
     req_param_resp.ints = NULL;
 
     spin_timeout_ = 0;
+    sync_interval_ = SYNC_SECONDS * 500UL;
+    sync_timeout_ = SYNC_SECONDS * 2200UL;
+    last_sync_time = 0;
+    last_sync_receive_time = 0;
+    cobs_state_ = COBS_OFF;
+    cobs_ = false;
   }
 
   Hardware* getHardware()
@@ -163,6 +474,7 @@ public:
     bytes_ = 0;
     index_ = 0;
     topic_ = 0;
+    announceSoon();
   };
 
   /* Start a named port, which may be network server IP, initialize buffers */
@@ -173,6 +485,7 @@ public:
     bytes_ = 0;
     index_ = 0;
     topic_ = 0;
+    announceSoon();
   };
 
   /**
@@ -188,6 +501,42 @@ public:
      spin_timeout_ = timeout;
   }
 
+  /**
+   * @brief Sets how often, in milliseconds, the time is synced with the server
+   * once connected, and how long without an answer before the link is taken to
+   * be lost, and the client waits to be asked for its topics again. These are
+   * 2500 and 11000 by default; the timeout should allow for a few syncs.
+   */
+  void setSyncInterval(uint32_t interval, uint32_t timeout)
+  {
+    sync_interval_ = interval;
+    sync_timeout_ = timeout;
+  }
+
+  /**
+   * @brief Sends frames COBS framed, if the server can take them, so that
+   * it can find its place again straight away after losing a byte. This costs
+   * two or three bytes a frame, the more on longer ones. Frames sent this way
+   * don't go through the TX queue. COBS framed frames from the server are
+   * taken whether or not this is set.
+   */
+  void setCobsFraming(bool enable)
+  {
+    cobs_ = enable;
+  }
+
+  /**
+   * @brief Offers the server the given rates to switch the link to once
+   * synced, if it can, and the hardware has a changeBaud(); it picks the
+   * highest of them which it also has, and which carries a test burst
+   * intact. The rates are read from where they are, and must stay there.
+   */
+  void setBaudRates(const uint32_t * rates, int count)
+  {
+    baud_rates_ = rates;
+    baud_rates_length_ = count;
+  }
+
 protected:
   //State machine variables for spinOnce
   int mode_;
@@ -195,10 +544,59 @@ protected:
   int topic_;
   int index_;
   int checksum_;
+  uint16_t crc_;
+  uint8_t crc_low_;
+  bool rx_crc16_;
+
+  /* set once the server has offered to take frames with a CRC */
+  bool tx_crc16_;
+
+  uint8_t cobs_state_;
+  uint8_t cobs_code_;
+  uint8_t cobs_remaining_;
+  bool cobs_zero_;
+
+  /* asked for with setCobsFraming(), and used once the server offers it */
+  bool cobs_;
+  bool tx_cobs_;
 
   bool configured_;
 
+  /* set while waiting on the server's answer to the topic fingerprint */
+  bool fingerprinting_;
+
+  /* set once the server offers to look up several parameters at once */
+  bool param_batch_;
+
+  /* set once the server offers to expand deferred log messages */
+  bool log_deferred_;
+
+  /* set once the server offers to change the link's rate */
+  bool baud_;
+  const uint32_t * baud_rates_;
+  int baud_rates_length_;
+
+  /* the rate the link started at, once it has been switched from it, and
+   * the one to go back to unless the switch is confirmed by baud_deadline_ */
+  uint32_t baud_initial_;
+  uint32_t baud_fallback_;
+  bool baud_pending_;
+  uint32_t baud_deadline_;
+
+  /* set once the server offers to count the messages lost on each topic */
+  bool sequencing_;
+
+  /* set once the server offers to rebuild messages from deltas, for which
+   * messages are serialized into compress_in_ to be compared */
+  bool deltas_;
+
+  /* set once the server offers to send topics to a multicast group, where
+   * the hardware can read from one */
+  bool multicast_;
+
   /* used for syncing the time */
+  uint32_t sync_interval_;
+  uint32_t sync_timeout_;
   uint32_t last_sync_time;
   uint32_t last_sync_receive_time;
   uint32_t last_msg_timeout_time;
@@ -210,28 +608,169 @@ public:
 
 
   virtual int spinOnce()
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    return timedSpin(0);
+  }
+
+  /* As spinOnce(), but returns once max_frames frames have been taken in,
+   * leaving any more in the hardware for the next call, so that a busy link
+   * can't hold up the loop for long. The spin timeout is only checked as each
+   * frame ends, rather than for every byte. */
+  int spinOnce(int max_frames)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    return timedSpin(max_frames > 0 ? max_frames : 1);
+  }
+
+  /* How long, in milliseconds, spinOnce() can be left before it next has
+   * something of its own to do: syncing the time, announcing the client,
+   * timing out the server, a link rate switch or a half received frame, or
+   * writing out queued and batched frames, for which it is 0. Data arriving
+   * from the server needs a spin sooner. */
+  uint32_t timeToNextSpin()
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    if (tx_queue_.pending() || batch_length_ > 0 || hardware_reader_.buffered())
+      return 0;
+    uint32_t now = hardware_.time();
+    uint32_t wait;
+    if (configured_)
+    {
+      wait = timeUntilPast(last_sync_time + sync_interval_, now);
+      wait = minWait(wait, timeUntilPast(last_sync_receive_time + sync_timeout_, now));
+    }
+    else
+    {
+      wait = timeUntilPast(last_sync_time + SYNC_ANNOUNCE_MS, now);
+    }
+    if (baud_pending_)
+      wait = minWait(wait, timeUntilPast(baud_deadline_, now));
+    if (mode_ != MODE_FIRST_FF)
+      wait = minWait(wait, timeUntilPast(last_msg_timeout_time, now));
+    return wait;
+  }
+
+  /* Waits until there is data to read, spinOnce() has something of its own
+   * to do, or max_wait milliseconds have passed, whichever is first, in the
+   * hardware's
+   *   void waitForData(uint32_t timeout_ms)
+   * On a battery powered node, that can sleep the MCU until its RX interrupt
+   * or a timer wakes it, so that a loop of spinOnce() and waitForSpin() does
+   * no more work than the link needs, without leaving anything late. */
+  void waitForSpin(uint32_t max_wait = 0xffffffffUL)
+  {
+    uint32_t wait = minWait(timeToNextSpin(), max_wait);
+    if (wait > 0)
+      hardware_.waitForData(wait);
+  }
+
+  /* For an RTOS, the body of a task of its own which spins as data arrives,
+   * so that subscriber callbacks run at that task's priority, however slowly
+   * the application loops. The task waits in waitForSpin(); with period as
+   * the longest wait, frames other tasks queued meanwhile are still written
+   * while nothing arrives. Other tasks may publish meanwhile if the hardware
+   * has a lock, as in hardware_lock.h. */
+  void spinTask(uint32_t period = 10)
+  {
+    while (true)
+    {
+      waitForSpin(period);
+      spinOnce();
+    }
+  }
+
+#ifdef ROSSERIAL_LINK_STATS
+  /* What has crossed the link since the start, or the last resetLinkStats(). */
+  const LinkStats& getLinkStats() const
+  {
+    return link_counters_.stats();
+  }
+
+  void resetLinkStats()
+  {
+    link_counters_.reset();
+  }
+#endif
+
+protected:
+  /* The milliseconds from now until the hardware's time is past deadline,
+   * as spin() judges it, or 0 if it already is. */
+  static uint32_t timeUntilPast(uint32_t deadline, uint32_t now)
+  {
+    int32_t wait = (int32_t)(deadline - now) + 1;
+    return wait > 0 ? (uint32_t)wait : 0;
+  }
+
+  static uint32_t minWait(uint32_t a, uint32_t b)
+  {
+    return a < b ? a : b;
+  }
+
+  /* Spins and flushes the hardware, timing it all for the link stats. */
+  int timedSpin(int max_frames)
+  {
+    uint64_t start = LinkCounters::ENABLED ? localMicros() : 0;
+    int rv = spin(max_frames);
+    HardwareFlush<Hardware>::flush(hardware_);
+    if (LinkCounters::ENABLED)
+      link_counters_.spun((uint32_t)(localMicros() - start));
+    return rv;
+  }
+
+  /* Does the work of spinOnce(), taking in at most max_frames frames, or as
+   * many as have arrived if it is 0. */
+  int spin(int max_frames)
   {
     /* restart if timed out */
     uint32_t c_time = hardware_.time();
-    if ((c_time - last_sync_receive_time) > (SYNC_SECONDS * 2200))
+    localMicros();
+    if (configured_ && (c_time - last_sync_receive_time) > sync_timeout_)
     {
       configured_ = false;
+      restoreBaud();
+      announceSoon();
     }
-
-    /* reset if message has timed out */
-    if (mode_ != MODE_FIRST_FF)
+    if (baud_pending_ && (int32_t)(c_time - baud_deadline_) > 0)
     {
-      if (c_time > last_msg_timeout_time)
-      {
-        mode_ = MODE_FIRST_FF;
-      }
+      baud_pending_ = false;
+      waitForWrite();
+      HardwareBaud<Hardware>::change(hardware_, baud_fallback_);
     }
 
+    /* send what was published since the last spin */
+    flushBatch();
+
+    /* send whatever queued frames the hardware has room for */
+    waitForWrite();
+    tx_queue_.drain(hardware_);
+
+    /* where a callback spins, as ServiceClient::call() does, pass on the rest
+     * of the frames held by the spin that called it before receiving more */
+    dispatchHeld();
+
     /* while available buffer, read data */
+    int rv = SPIN_OK;
+    int frames = 0;
+    bool frame_ended = false;
     while (true)
     {
+      if (max_frames > 0)
+      {
+        if (frame_ended)
+        {
+          frame_ended = false;
+          if (++frames == max_frames)
+            break;
+          if (spin_timeout_ > 0 && (hardware_.time() - c_time) > spin_timeout_)
+          {
+            rv = SPIN_TIMEOUT;
+            break;
+          }
+        }
+      }
       // If a timeout has been specified, check how long spinOnce has been running.
-      if (spin_timeout_ > 0)
+      else if (spin_timeout_ > 0)
       {
         // If the maximum processing timeout has been exceeded, exit with error.
         // The next spinOnce can continue where it left off, or optionally
@@ -240,15 +779,35 @@ public:
         if ((hardware_.time() - c_time) > spin_timeout_)
         {
           // Exit the spin, processing timeout exceeded.
-          return SPIN_TIMEOUT;
+          rv = SPIN_TIMEOUT;
+          break;
         }
       }
-      int data = hardware_.read();
+      int data = hardware_reader_.read(hardware_);
       if (data < 0)
+      {
+        /* reset if message has timed out; this is only judged once all the
+         * bytes that have arrived are in, so that time spent in callbacks
+         * doesn't count against a frame that is waiting in the hardware */
+        if (mode_ != MODE_FIRST_FF && hardware_.time() > last_msg_timeout_time)
+        {
+          mode_ = MODE_FIRST_FF;
+          cobs_state_ = COBS_OFF;
+          link_counters_.timeout();
+        }
         break;
+      }
+      link_counters_.rxByte();
+      if (cobs_state_ != COBS_OFF || (data == 0 && mode_ == MODE_FIRST_FF))
+      {
+        data = cobsDecode(data);
+        if (data < 0)
+          continue;
+      }
       checksum_ += data;
       if (mode_ == MODE_MESSAGE)          /* message data being recieved */
       {
+        crc_ = crc16Update(crc_, data);
         message_in[index_++] = data;
         bytes_--;
         if (bytes_ == 0)                 /* is message complete? if so, checksum */
@@ -259,19 +818,21 @@ public:
         if (data == 0xff)
         {
           mode_++;
-          last_msg_timeout_time = c_time + SERIAL_MSG_TIMEOUT;
+          last_msg_timeout_time = hardware_.time() + SERIAL_MSG_TIMEOUT;
         }
         else if (hardware_.time() - c_time > (SYNC_SECONDS * 1000))
         {
           /* We have been stuck in spinOnce too long, return error */
           configured_ = false;
-          return SPIN_TIMEOUT;
+          rv = SPIN_TIMEOUT;
+          break;
         }
       }
       else if (mode_ == MODE_PROTOCOL_VER)
       {
-        if (data == PROTOCOL_VER)
+        if (data == PROTOCOL_VER || data == PROTOCOL_VER2_CRC16)
         {
+          rx_crc16_ = (data == PROTOCOL_VER2_CRC16);
           mode_++;
         }
         else
@@ -295,36 +856,73 @@ public:
       }
       else if (mode_ == MODE_SIZE_CHECKSUM)
       {
-        if ((checksum_ % 256) == 255)
+        if ((checksum_ % 256) == 255 && bytes_ <= INPUT_SIZE)
           mode_++;
         else
-          mode_ = MODE_FIRST_FF;          /* Abandon the frame if the msg len is wrong */
+        {
+          mode_ = MODE_FIRST_FF;          /* Abandon the frame if the msg len is wrong, or too long to fit */
+          if ((checksum_ % 256) == 255)
+            link_counters_.overrun();
+          else
+            link_counters_.checksumError();
+        }
       }
       else if (mode_ == MODE_TOPIC_L)     /* bottom half of topic id */
       {
         topic_ = data;
         mode_++;
         checksum_ = data;               /* first byte included in checksum */
+        crc_ = crc16Update(0xffff, data);
       }
       else if (mode_ == MODE_TOPIC_H)     /* top half of topic id */
       {
         topic_ += data << 8;
+        crc_ = crc16Update(crc_, data);
         mode_ = MODE_MESSAGE;
         if (bytes_ == 0)
           mode_ = MODE_MSG_CHECKSUM;
       }
-      else if (mode_ == MODE_MSG_CHECKSUM)    /* do checksum */
+      else if (mode_ == MODE_MSG_CHECKSUM && rx_crc16_)
+      {
+        crc_low_ = data;
+        mode_ = MODE_MSG_CRC_H;
+      }
+      else if (mode_ == MODE_MSG_CHECKSUM || mode_ == MODE_MSG_CRC_H)    /* do checksum */
       {
+        bool valid = rx_crc16_ ? (crc_low_ | (data << 8)) == crc_ : (checksum_ % 256) == 255;
         mode_ = MODE_FIRST_FF;
-        if ((checksum_ % 256) == 255)
+        frame_ended = true;
+        if (!valid)
+          link_counters_.checksumError();
+        else
         {
+          link_counters_.rxFrame();
           if (topic_ == TopicInfo::ID_PUBLISHER)
           {
+            batch_length_ = 0;
+            batching_ = BATCH_SIZE > 0 && index_ > 0 && (message_in[0] & FEATURE_BATCH);
+            tx_crc16_ = index_ > 0 && (message_in[0] & FEATURE_CRC16);
+            tx_cobs_ = cobs_ && index_ > 0 && (message_in[0] & FEATURE_COBS);
+            compressing_ = COMPRESS_SIZE > 0 && index_ > 0 && (message_in[0] & FEATURE_COMPRESSION);
+            fingerprinting_ = index_ > 0 && (message_in[0] & FEATURE_TOPIC_FINGERPRINT);
+            param_batch_ = index_ > 0 && (message_in[0] & FEATURE_PARAM_BATCH);
+            log_deferred_ = index_ > 0 && (message_in[0] & FEATURE_LOG_DEFERRED);
+            baud_ = index_ > 0 && (message_in[0] & FEATURE_BAUD);
+            sequencing_ = index_ > 1 && (message_in[1] & FEATURE2_SEQUENCE);
+            deltas_ = COMPRESS_SIZE > 0 && index_ > 1 && (message_in[1] & FEATURE2_DELTA);
+            multicast_ = HardwareMulticast<Hardware>::supported && index_ > 1 && (message_in[1] & FEATURE2_MULTICAST);
+            for (int i = 0; i < publishers_length_; i++)
+              publishers[i]->paused_ = false;
+            configured_ = false;
             requestSyncTime();
-            negotiateTopics();
+            if (fingerprinting_)
+              sendTopicFingerprint(0);
+            else
+              negotiateTopics();
             last_sync_time = c_time;
             last_sync_receive_time = c_time;
-            return SPIN_ERR;
+            rv = SPIN_ERR;
+            break;
           }
           else if (topic_ == TopicInfo::ID_TIME)
           {
@@ -339,25 +937,95 @@ public:
           {
             configured_ = false;
           }
+          else if (topic_ == TopicInfo::ID_PARAMETER_BATCH)
+          {
+            paramBatchAnswer(message_in, index_);
+          }
+          else if (topic_ == TopicInfo::ID_TOPIC_FINGERPRINT)
+          {
+            topicFingerprintAnswer(message_in, index_);
+          }
+          else if (topic_ == TopicInfo::ID_BAUD)
+          {
+            baudMessage(message_in, index_);
+          }
+          else if (topic_ == TopicInfo::ID_TOPIC_PAUSE)
+          {
+            pauseTopic(message_in, index_);
+          }
+          else if (topic_ == TopicInfo::ID_TOPIC_MULTICAST)
+          {
+            multicastTopic(message_in, index_);
+          }
+          else if (RX_FRAME_SLOTS > 1)
+          {
+            /* hold on to the frame, and receive the next into another slot */
+            rx_topics_[rx_pending_++] = topic_;
+            if (rx_pending_ == RX_FRAME_SLOTS)
+              break;
+            message_in = rx_frames_[rx_pending_];
+          }
           else
           {
-            if (subscribers[topic_ - 100])
-              subscribers[topic_ - 100]->callback(message_in);
+            dispatch(topic_, message_in);
           }
         }
       }
     }
 
-    /* occasionally sync time */
-    if (configured_ && ((c_time - last_sync_time) > (SYNC_SECONDS * 500)))
+    /* call back subscribers with the frames held for them, however the
+     * spin ended */
+    dispatchHeld();
+    if (rv != SPIN_OK)
+      return rv;
+
+    /* and with what has come from the multicast group */
+    if (multicast_ && configured_)
+      receiveMulticast();
+
+    /* occasionally sync time, or while unconfigured, say we're here */
+    if (configured_ && ((c_time - last_sync_time) > sync_interval_))
     {
       requestSyncTime();
       last_sync_time = c_time;
     }
+    else if (!configured_ && ((c_time - last_sync_time) > SYNC_ANNOUNCE_MS))
+    {
+      announce();
+      last_sync_time = c_time;
+    }
 
+    flushBatch();
     return SPIN_OK;
   }
 
+  /* Calls back subscribers with the frames held for them, in order, then
+   * frees their slots. A callback may itself spin; that spin carries on from
+   * the next frame, so each is dispatched once, and none is received over
+   * before it has been. A frame's bytes are only good until its callback
+   * spins, as with a single slot. */
+  void dispatchHeld()
+  {
+    while (rx_dispatched_ < rx_pending_)
+    {
+      int i = rx_dispatched_++;
+      dispatch(rx_topics_[i], rx_frames_[i]);
+    }
+    if (rx_pending_ > 0)
+    {
+      /* carry over the start of a frame which is still arriving */
+      if (mode_ == MODE_MESSAGE || mode_ == MODE_MSG_CHECKSUM || mode_ == MODE_MSG_CRC_H)
+      {
+        for (int i = 0; i < index_; i++)
+          rx_frames_[0][i] = message_in[i];
+      }
+      rx_pending_ = 0;
+      rx_dispatched_ = 0;
+      message_in = rx_frames_[0];
+    }
+  }
+
+public:
 
   /* Are we connected to the PC? */
   virtual bool connected()
@@ -373,37 +1041,84 @@ public:
   {
     std_msgs::Time t;
     publish(TopicInfo::ID_TIME, &t);
-    rt_time = hardware_.time();
+    rt_time = localMicros();
+    if (TIME_SYNC_SAMPLES > 0)
+      clock_sync_.requested(rt_time);
+  }
+
+  /* A time request with no body, which tells the server this client is
+   * waiting to be asked for its topics. */
+  void announce()
+  {
+    bool queued;
+    uint8_t * frame = beginFrame(TopicInfo::ID_TIME, queued);
+    if (frame != 0)
+      endFrame(frame, TopicInfo::ID_TIME, 0, queued);
+  }
+
+  /* Has the next spinOnce() announce the client, rather than waiting out
+   * SYNC_ANNOUNCE_MS first. */
+  void announceSoon()
+  {
+    last_sync_time = hardware_.time() - SYNC_ANNOUNCE_MS - 1;
   }
 
   void syncTime(uint8_t * data)
   {
     std_msgs::Time t;
-    uint32_t offset = hardware_.time() - rt_time;
-
     t.deserialize(data);
-    t.data.sec += offset / 1000;
-    t.data.nsec += (offset % 1000) * 1000000UL;
+    last_sync_receive_time = hardware_.time();
+    if (TIME_SYNC_SAMPLES > 0)
+    {
+      clock_sync_.answered(localMicros(), t.data);
+      return;
+    }
+
+    /* the server's time is from half way through the round trip */
+    uint32_t offset = (uint32_t)(localMicros() - rt_time) / 2;
+    t.data.sec += offset / 1000000UL;
+    t.data.nsec += (offset % 1000000UL) * 1000UL;
+    normalizeSecNSec(t.data.sec, t.data.nsec);
 
     this->setNow(t.data);
-    last_sync_receive_time = hardware_.time();
+  }
+
+  /* The local clock in microseconds, which spinOnce() keeps from missing a
+   * wrap of the hardware's counter. */
+  uint64_t localMicros()
+  {
+    return clock_.micros(hardware_);
+  }
+
+  /* How much faster the local clock is found to run than the server's, in
+   * parts per billion, with TIME_SYNC_SAMPLES > 0. */
+  int32_t getClockSkew() const
+  {
+    return clock_sync_.skewPpb();
   }
 
   Time now()
   {
-    uint32_t ms = hardware_.time();
+    if (TIME_SYNC_SAMPLES > 0)
+      return clock_sync_.remote(localMicros());
+    uint64_t us = localMicros();
     Time current_time;
-    current_time.sec = ms / 1000 + sec_offset;
-    current_time.nsec = (ms % 1000) * 1000000UL + nsec_offset;
+    current_time.sec = (uint32_t)(us / 1000000UL) + sec_offset;
+    current_time.nsec = (uint32_t)(us % 1000000UL) * 1000UL + nsec_offset;
     normalizeSecNSec(current_time.sec, current_time.nsec);
     return current_time;
   }
 
   void setNow(Time & new_now)
   {
-    uint32_t ms = hardware_.time();
-    sec_offset = new_now.sec - ms / 1000 - 1;
-    nsec_offset = new_now.nsec - (ms % 1000) * 1000000UL + 1000000000UL;
+    if (TIME_SYNC_SAMPLES > 0)
+    {
+      clock_sync_.set(localMicros(), new_now);
+      return;
+    }
+    uint64_t us = localMicros();
+    sec_offset = new_now.sec - (uint32_t)(us / 1000000UL) - 1;
+    nsec_offset = new_now.nsec - (uint32_t)(us % 1000000UL) * 1000UL + 1000000000UL;
     normalizeSecNSec(sec_offset, nsec_offset);
   }
 
@@ -414,33 +1129,20 @@ public:
   /* Register a new publisher */
   bool advertise(Publisher & p)
   {
-    for (int i = 0; i < MAX_PUBLISHERS; i++)
-    {
-      if (publishers[i] == 0) // empty slot
-      {
-        publishers[i] = &p;
-        p.id_ = i + 100 + MAX_SUBSCRIBERS;
-        p.nh_ = this;
-        return true;
-      }
-    }
-    return false;
+    if (publishers_length_ >= MAX_PUBLISHERS || p.getBufferSize() > (uint32_t)(OUTPUT_SIZE - 9))
+      return false;
+    publishers[publishers_length_] = &p;
+    p.id_ = publishers_length_ + 100 + MAX_SUBSCRIBERS;
+    p.nh_ = this;
+    publishers_length_++;
+    return true;
   }
 
   /* Register a new subscriber */
   template<typename SubscriberT>
   bool subscribe(SubscriberT& s)
   {
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++)
-    {
-      if (subscribers[i] == 0) // empty slot
-      {
-        subscribers[i] = static_cast<Subscriber_*>(&s);
-        s.id_ = i + 100;
-        return true;
-      }
-    }
-    return false;
+    return addSubscriber(s);
   }
 
   /* Register a new Service Server */
@@ -448,16 +1150,15 @@ public:
   bool advertiseService(ServiceServer<MReq, MRes, ObjT>& srv)
   {
     bool v = advertise(srv.pub);
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++)
-    {
-      if (subscribers[i] == 0) // empty slot
-      {
-        subscribers[i] = static_cast<Subscriber_*>(&srv);
-        srv.id_ = i + 100;
-        return v;
-      }
-    }
-    return false;
+    return addSubscriber(srv) && v;
+  }
+
+  /* Register a new Service Server which writes its responses in place */
+  template<typename MReq, typename MRes, typename ObjT>
+  bool advertiseService(InPlaceServiceServer<MReq, MRes, ObjT>& srv)
+  {
+    bool v = advertise(srv.pub);
+    return addSubscriber(srv) && v;
   }
 
   /* Register a new Service Client */
@@ -465,90 +1166,862 @@ public:
   bool serviceClient(ServiceClient<MReq, MRes>& srv)
   {
     bool v = advertise(srv.pub);
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+    return addSubscriber(srv) && v;
+  }
+
+  /* The INPUT_SIZE and OUTPUT_SIZE which would do for the topics registered
+   * so far, going by the buffer sizes they declare, to trim the template's
+   * arguments to; a topic which declares none needs the whole buffer. The
+   * output size leaves room for the CRC16 trailer. */
+  int requiredInputSize()
+  {
+    uint32_t size = 0;
+    for (int i = 0; i < subscribers_length_; i++)
     {
-      if (subscribers[i] == 0) // empty slot
-      {
-        subscribers[i] = static_cast<Subscriber_*>(&srv);
-        srv.id_ = i + 100;
-        return v;
-      }
+      uint32_t declared = subscribers[i]->getBufferSize();
+      uint32_t need = declared ? declared : INPUT_SIZE;
+      if (need > size)
+        size = need;
     }
-    return false;
+    return size;
   }
 
-  void negotiateTopics()
+  int requiredOutputSize()
   {
-    rosserial_msgs::TopicInfo ti;
-    int i;
-    for (i = 0; i < MAX_PUBLISHERS; i++)
+    uint32_t size = 0;
+    for (int i = 0; i < publishers_length_; i++)
     {
-      if (publishers[i] != 0) // non-empty slot
-      {
-        ti.topic_id = publishers[i]->id_;
-        ti.topic_name = (char *) publishers[i]->topic_;
-        ti.message_type = (char *) publishers[i]->msg_->getType();
-        ti.md5sum = (char *) publishers[i]->msg_->getMD5();
+      uint32_t declared = publishers[i]->getBufferSize();
+      uint32_t need = declared ? declared + 9 : OUTPUT_SIZE;
+      if (need > size)
+        size = need;
+    }
+    return size;
+  }
+
+  /* Fills in the TopicInfo for the i-th of the publishers then subscribers,
+   * and whether its topic name is in flash, returning the endpoint to send it
+   * on, or -1 once past the last. */
+  int topicInfo(int i, rosserial_msgs::TopicInfo & ti, bool & topic_in_flash)
+  {
+    if (i < publishers_length_)
+    {
+      topic_in_flash = publishers[i]->topic_in_flash_;
+      ti.topic_id = publishers[i]->id_;
+      ti.topic_name = (char *) publishers[i]->topic_;
+      ti.message_type = (char *) publishers[i]->msg_->getType();
+      ti.md5sum = (char *) publishers[i]->msg_->getMD5();
+      /* a batch of messages on the topic may make for a longer frame */
+      ti.buffer_size = publishers[i]->getBufferSize();
+      if (ti.buffer_size == 0)
         ti.buffer_size = OUTPUT_SIZE;
-        publish(publishers[i]->getEndpointType(), &ti);
-      }
+      if (batching_ && BATCH_SIZE > ti.buffer_size)
+        ti.buffer_size = BATCH_SIZE;
+      ti.flags = 0;
+      if (deltaTopic(publishers[i]->id_))
+        ti.flags = TopicInfo::FLAG_DELTA;
+      else if (compressedTopic(publishers[i]->id_))
+        ti.flags = TopicInfo::FLAG_COMPRESSED;
+      /* the first message after setting up is a keyframe */
+      publishers[i]->delta_length_ = 0;
+      publishers[i]->sequenced_ = sequencing_ && publishers[i]->getEndpointType() == TopicInfo::ID_PUBLISHER;
+      if (publishers[i]->sequenced_)
+        ti.flags |= TopicInfo::FLAG_SEQUENCED;
+      return publishers[i]->getEndpointType();
     }
-    for (i = 0; i < MAX_SUBSCRIBERS; i++)
+    i -= publishers_length_;
+    if (i < subscribers_length_)
     {
-      if (subscribers[i] != 0) // non-empty slot
-      {
-        ti.topic_id = subscribers[i]->id_;
-        ti.topic_name = (char *) subscribers[i]->topic_;
-        ti.message_type = (char *) subscribers[i]->getMsgType();
-        ti.md5sum = (char *) subscribers[i]->getMsgMD5();
-        ti.buffer_size = INPUT_SIZE;
-        publish(subscribers[i]->getEndpointType(), &ti);
-      }
+      topic_in_flash = subscribers[i]->topic_in_flash_;
+      ti.topic_id = subscribers[i]->id_;
+      ti.topic_name = (char *) subscribers[i]->topic_;
+      ti.message_type = (char *) subscribers[i]->getMsgType();
+      ti.md5sum = (char *) subscribers[i]->getMsgMD5();
+      subscribers[i]->sequenced_ = sequencing_ && subscribers[i]->getEndpointType() == TopicInfo::ID_SUBSCRIBER;
+      subscribers[i]->sequence_ = 0;
+      ti.buffer_size = subscribers[i]->getBufferSize();
+      if (ti.buffer_size == 0)
+        ti.buffer_size = subscribers[i]->sequenced_ ? INPUT_SIZE - 1 : INPUT_SIZE;
+      ti.flags = subscribers[i]->sequenced_ ? TopicInfo::FLAG_SEQUENCED : 0;
+      subscribers[i]->multicast_id_ = 0;
+      if (multicast_ && subscribers[i]->getEndpointType() == TopicInfo::ID_SUBSCRIBER)
+        ti.flags |= TopicInfo::FLAG_MULTICAST;
+      return subscribers[i]->getEndpointType();
     }
+    return -1;
+  }
+
+  void negotiateTopics()
+  {
+    rosserial_msgs::TopicInfo ti;
+    bool topic_in_flash;
+    int endpoint;
+    for (int i = 0; (endpoint = topicInfo(i, ti, topic_in_flash)) >= 0; i++)
+      publishTopicInfo(endpoint, ti, topic_in_flash);
     configured_ = true;
+    offerBaudRates();
   }
 
-  virtual int publish(int id, const Msg * msg)
+  /* Sends a TopicInfo as TopicInfo::serialize() would, but reading each of
+   * its strings from flash where it's kept there. */
+  void publishTopicInfo(int endpoint, const rosserial_msgs::TopicInfo & ti, bool topic_in_flash)
   {
-    if (id >= 100 && !configured_)
-      return 0;
+    bool queued;
+    uint8_t * frame = beginFrame(endpoint, queued);
+    if (frame == 0)
+      return;
+    uint8_t * body = frame + 7;
+    int l = 0;
+    body[l++] = ti.topic_id & 0xff;
+    body[l++] = ti.topic_id >> 8;
+    l += serializeString(body + l, ti.topic_name, topic_in_flash);
+    l += serializeString(body + l, ti.message_type, MSG_STRINGS_IN_FLASH);
+    l += serializeString(body + l, ti.md5sum, MSG_STRINGS_IN_FLASH);
+    for (int i = 0; i < 4; i++)
+      body[l++] = ((uint32_t) ti.buffer_size >> (8 * i)) & 0xff;
+    body[l++] = ti.flags;
+    endFrame(frame, endpoint, l, queued);
+  }
 
-    /* serialize message */
-    int l = msg->serialize(message_out + 7);
+  static int serializeString(uint8_t * out, const char * s, bool in_flash)
+  {
+    uint32_t n = stringLength(s, in_flash);
+    for (int i = 0; i < 4; i++)
+      out[i] = (n >> (8 * i)) & 0xff;
+    copyString(out + 4, s, n, in_flash);
+    return 4 + n;
+  }
 
-    /* setup the header */
-    message_out[0] = 0xff;
-    message_out[1] = PROTOCOL_VER;
-    message_out[2] = (uint8_t)((uint16_t)l & 255);
-    message_out[3] = (uint8_t)((uint16_t)l >> 8);
-    message_out[4] = 255 - ((message_out[2] + message_out[3]) % 256);
-    message_out[5] = (uint8_t)((int16_t)id & 255);
-    message_out[6] = (uint8_t)((int16_t)id >> 8);
-
-    /* calculate checksum */
-    int chk = 0;
-    for (int i = 5; i < l + 7; i++)
-      chk += message_out[i];
-    l += 7;
-    message_out[l++] = 255 - (chk % 256);
-
-    if (l <= OUTPUT_SIZE)
-    {
-      hardware_.write(message_out, l);
-      return l;
-    }
-    else
+  /* FNV-1a hash of every TopicInfo negotiateTopics() would send */
+  uint32_t topicFingerprint()
+  {
+    rosserial_msgs::TopicInfo ti;
+    uint32_t hash = 2166136261u;
+    bool topic_in_flash;
+    int endpoint;
+    for (int i = 0; (endpoint = topicInfo(i, ti, topic_in_flash)) >= 0; i++)
     {
-      logerror("Message from device dropped: message larger than buffer.");
-      return -1;
+      uint8_t fields[9] = { (uint8_t) endpoint, (uint8_t)(endpoint >> 8),
+                            (uint8_t) ti.topic_id, (uint8_t)(ti.topic_id >> 8),
+                            (uint8_t) ti.buffer_size, (uint8_t)(ti.buffer_size >> 8),
+                            (uint8_t)(ti.buffer_size >> 16), (uint8_t)(ti.buffer_size >> 24), ti.flags };
+      const char * strings[3] = { ti.topic_name, ti.message_type, ti.md5sum };
+      bool in_flash[3] = { topic_in_flash, MSG_STRINGS_IN_FLASH, MSG_STRINGS_IN_FLASH };
+      for (int j = 0; j < 9; j++)
+        hash = (hash ^ fields[j]) * 16777619u;
+      for (int j = 0; j < 3; j++)
+      {
+        /* each string with its terminator, so that they can't run together */
+        const char * c = strings[j];
+        uint8_t b;
+        do
+          hash = (hash ^ (b = stringByte(c++, in_flash[j]))) * 16777619u;
+        while (b);
+      }
     }
+    return hash;
+  }
+
+  void sendTopicFingerprint(uint8_t state)
+  {
+    bool queued;
+    uint8_t * frame = beginFrame(TopicInfo::ID_TOPIC_FINGERPRINT, queued);
+    if (frame == 0)
+      return;
+    uint32_t hash = topicFingerprint();
+    for (int i = 0; i < 4; i++)
+      frame[7 + i] = (hash >> (8 * i)) & 0xff;
+    frame[11] = state;
+    endFrame(frame, TopicInfo::ID_TOPIC_FINGERPRINT, 5, queued);
+  }
+
+  void topicFingerprintAnswer(const uint8_t * data, int length)
+  {
+    if (!fingerprinting_ || length < 5)
+      return;
+    fingerprinting_ = false;
+    uint32_t hash = data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+    if (data[4] == 1 && hash == topicFingerprint())
+    {
+      configured_ = true;
+      offerBaudRates();
+      return;
+    }
+    negotiateTopics();
+    sendTopicFingerprint(1);
   }
 
   /********************************************************************
-   * Logging
+   * Baud rate negotiation
    */
 
+  void offerBaudRates()
+  {
+    if (!baud_ || !HardwareBaud<Hardware>::supported || baud_rates_length_ == 0)
+      return;
+    bool queued;
+    uint8_t * frame = beginFrame(TopicInfo::ID_BAUD, queued);
+    if (frame == 0)
+      return;
+    int count = baud_rates_length_;
+    if (2 + 4 * count > OUTPUT_SIZE - frameOverhead())
+      count = (OUTPUT_SIZE - frameOverhead() - 2) / 4;
+    uint8_t * body = frame + 7;
+    body[0] = BAUD_OFFER;
+    body[1] = count;
+    for (int i = 0; i < count; i++)
+      for (int b = 0; b < 4; b++)
+        body[2 + 4 * i + b] = (baud_rates_[i] >> (8 * b)) & 0xff;
+    endFrame(frame, TopicInfo::ID_BAUD, 2 + 4 * count, queued);
+  }
+
+  void baudMessage(const uint8_t * data, int length)
+  {
+    if (length < 1)
+      return;
+    if (data[0] == BAUD_SWITCH && length >= 9)
+    {
+      /* whatever is waiting goes out at the old rate first */
+      waitForWrite();
+      tx_queue_.flush(hardware_);
+      HardwareFlush<Hardware>::flush(hardware_);
+      baud_fallback_ = read32(data + 5);
+      if (baud_initial_ == 0)
+        baud_initial_ = baud_fallback_;
+      HardwareBaud<Hardware>::change(hardware_, read32(data + 1));
+      baud_pending_ = true;
+      baud_deadline_ = hardware_.time() + BAUD_CONFIRM_MS;
+    }
+    else if (data[0] == BAUD_PROBE)
+    {
+      bool queued;
+      uint8_t * frame = beginFrame(TopicInfo::ID_BAUD, queued);
+      if (frame == 0)
+        return;
+      int l = length < OUTPUT_SIZE - frameOverhead() ? length : OUTPUT_SIZE - frameOverhead();
+      for (int i = 0; i < l; i++)
+        frame[7 + i] = data[i];
+      endFrame(frame, TopicInfo::ID_BAUD, l, queued);
+    }
+    else if (data[0] == BAUD_CONFIRM)
+    {
+      baud_pending_ = false;
+    }
+  }
+
+  void pauseTopic(const uint8_t * data, int length)
+  {
+    if (length < 3)
+      return;
+    unsigned int index = (data[0] | (data[1] << 8)) - 100 - MAX_SUBSCRIBERS;
+    if (index < (unsigned int) publishers_length_)
+      publishers[index]->paused_ = data[2];
+  }
+
+  /* Takes a subscriber's messages from the multicast group from now on. */
+  void multicastTopic(const uint8_t * data, int length)
+  {
+    if (length < 10)
+      return;
+    unsigned int index = (data[0] | (data[1] << 8)) - 100;
+    if (index >= (unsigned int) subscribers_length_)
+      return;
+    Subscriber_ * sub = subscribers[index];
+    sub->multicast_id_ = data[2] | (data[3] << 8);
+    sub->sequenced_ = false;
+    HardwareMulticast<Hardware>::join(hardware_, data + 4, data[8] | (data[9] << 8));
+  }
+
+  /* Calls back subscribers with the datagrams waiting from the multicast
+   * group, a few at a time so that a busy group can't hold up the loop. Each
+   * must be one whole frame with its checksums right; any other is dropped. */
+  void receiveMulticast()
+  {
+    for (int n = 0; n < 8; n++)
+    {
+      uint8_t * frame = multicast_in_;
+      int size = HardwareMulticast<Hardware>::read(hardware_, frame, (int) sizeof(multicast_in_));
+      if (size <= 0)
+        return;
+      uint16_t length = frame[2] | (frame[3] << 8);
+      if (size < 8 || frame[0] != 0xff || frame[1] != PROTOCOL_VER2 || length + 8 != size ||
+          length > INPUT_SIZE)
+      {
+        link_counters_.checksumError();
+        continue;
+      }
+      int sum = 0;
+      for (int i = 2; i < 5; i++)
+        sum += frame[i];
+      int body_sum = 0;
+      for (int i = 5; i < size; i++)
+        body_sum += frame[i];
+      if ((sum % 256) != 255 || (body_sum % 256) != 255)
+      {
+        link_counters_.checksumError();
+        continue;
+      }
+      link_counters_.rxFrame();
+      uint16_t multicast_id = frame[5] | (frame[6] << 8);
+      for (int i = 0; i < subscribers_length_; i++)
+      {
+        if (subscribers[i]->multicast_id_ == multicast_id && multicast_id != 0)
+        {
+          dispatch(subscribers[i]->id_, frame + 7);
+          break;
+        }
+      }
+    }
+  }
+
+  /* Goes back to the rate the link started at, on losing sync, as the
+   * server does when it gives up on the client. */
+  void restoreBaud()
+  {
+    if (baud_initial_ != 0)
+    {
+      waitForWrite();
+      HardwareBaud<Hardware>::change(hardware_, baud_initial_);
+    }
+    baud_initial_ = 0;
+    baud_pending_ = false;
+  }
+
+  virtual int publish(int id, const Msg * msg)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    if (id >= 100 && !configured_)
+      return 0;
+
+    if (deltaTopic(id))
+      return publishDelta(id, msg);
+
+    if (compressedTopic(id))
+      return publishCompressed(id, msg);
+
+    if (batching_ && id >= 100)
+      return addToBatch(id, msg);
+
+    if (!fits(msg, outputCapacity(id), id != TopicInfo::ID_LOG))
+      return -1;
+
+    bool queued;
+    uint8_t * frame = beginFrame(id, queued);
+    if (frame == 0)
+      return -1;      /* TX queue is full, drop the message */
+
+    /* serialize message */
+    int s = writeSequence(id, frame + 7);
+    int l = msg->serialize(frame + 7 + s);
+    return endFrame(frame, id, s + l, queued);
+  }
+
+  /* Lends out the payload area of the next frame on a topic, for a message
+   * to be serialized into in place and then sent with publishLoan(). Not for
+   * compressed or delta topics, whose messages can't be encoded in place. Where the
+   * hardware has a lock, it is held from a successful loan until the
+   * publishLoan() which follows. One loan may be out at a time, and its
+   * buffer or TX queue slot is kept from other frames until then. */
+  virtual uint8_t * loan(int id, int * capacity)
+  {
+    HardwareLock<Hardware>::acquire(hardware_);
+    *capacity = 0;
+    uint8_t * frame = 0;
+    if (!((id >= 100 && !configured_) || compressedTopic(id) || deltaTopic(id) || loan_frame_ != 0))
+      frame = beginFrame(id, loan_queued_);
+    if (frame == 0)
+    {
+      HardwareLock<Hardware>::release(hardware_);
+      return 0;
+    }
+    loan_frame_ = frame;
+    *capacity = outputCapacity(id);
+    return loan_frame_ + 7 + sequenceBytes(id);
+  }
+
+  /* Sends the frame from the last loan(), or abandons it if length < 0. */
+  virtual int publishLoan(int id, int length)
+  {
+    uint8_t * frame = loan_frame_;
+    if (frame == 0)
+      return -1;
+    loan_frame_ = 0;
+    int l = -1;
+    if (length >= 0)
+    {
+      int s = writeSequence(id, frame + 7);
+      l = endFrame(frame, id, s + length, loan_queued_);
+    }
+    else if (loan_queued_)
+    {
+      tx_queue_.release();
+    }
+    HardwareLock<Hardware>::release(hardware_);
+    return l;
+  }
+
 private:
+  void dispatch(int topic, uint8_t * data)
+  {
+    /* topic ids below 100 wrap around and fail the range check too */
+    unsigned int index = topic - 100;
+    if (index < (unsigned int) subscribers_length_)
+    {
+      Subscriber_ * sub = subscribers[index];
+      if (sub->sequenced_)
+      {
+        /* count the messages skipped over; one from a little way behind is
+         * late rather than the last of a wrap of lost ones, and let through */
+        uint8_t skipped = data[0] - sub->sequence_;
+        if (skipped < 256 - 32)
+        {
+          link_counters_.lost(skipped);
+          sub->sequence_ = data[0] + 1;
+        }
+        data++;
+      }
+      /* directly, if it is one of those known at compile time */
+      if (!StaticSubscribers::callback(sub, data))
+        sub->callback(data);
+#ifdef ROSSERIAL_CHECK_VIEWS
+      /* the frame's buffer is about to be reused, so views into it expire */
+      viewGeneration()++;
+#endif
+    }
+    else
+    {
+      link_counters_.unknownTopic();
+    }
+  }
+
+  /* Whether a message will fit in a buffer of capacity bytes, checked before
+   * it is serialized into one so that it can't run past the end. A log
+   * message which doesn't fit is only counted, as logging it would recurse. */
+  bool fits(const Msg * msg, int capacity, bool report = true)
+  {
+    if (msg->serializedLength() <= (uint32_t) capacity)
+      return true;
+    link_counters_.overrun();
+    if (report)
+      logerror("Message from device dropped: message larger than buffer.");
+    return false;
+  }
+
+  /* Appends a message to the batch, first sending the batch if the message
+   * won't fit in what's left of it, or on its own if it won't fit at all. The
+   * message is serialized into a free frame buffer, so that its length is
+   * known before it is copied in. */
+  int addToBatch(int id, const Msg * msg)
+  {
+    if (!fits(msg, outputCapacity(id)))
+      return -1;
+    uint8_t * frame = freeFrame();
+    if (frame == 0)
+    {
+      link_counters_.overrun();
+      return -1;
+    }
+    int l = writeSequence(id, frame + 7);
+    l += msg->serialize(frame + 7 + l);
+    if (batch_length_ + 4 + l > BATCH_SIZE - frameOverhead())
+    {
+      flushBatch();
+      if (4 + l > BATCH_SIZE - frameOverhead())
+        return endFrame(frame, id, l, false);
+    }
+    uint8_t * record = batch_ + 7 + batch_length_;
+    record[0] = (uint8_t)((int16_t)id & 255);
+    record[1] = (uint8_t)((int16_t)id >> 8);
+    record[2] = (uint8_t)((uint16_t)l & 255);
+    record[3] = (uint8_t)((uint16_t)l >> 8);
+    for (int i = 0; i < l; i++)
+      record[4 + i] = frame[7 + i];
+    batch_length_ += 4 + l;
+    return l + 4;
+  }
+
+  bool compressedTopic(int id)
+  {
+    return compressing_ && id >= 100 + MAX_SUBSCRIBERS &&
+           publishers[id - 100 - MAX_SUBSCRIBERS]->getCompression() && !deltaTopic(id);
+  }
+
+  bool deltaTopic(int id)
+  {
+    return deltas_ && id >= 100 + MAX_SUBSCRIBERS &&
+           publishers[id - 100 - MAX_SUBSCRIBERS]->getDeltaSize() > 0;
+  }
+
+  /* Sends a message on a delta topic: as it differs from the keyframe, if
+   * there is one, it isn't yet time for the next, and that's shorter, or
+   * otherwise whole, to be the next keyframe. */
+  int publishDelta(int id, const Msg * msg)
+  {
+    if (!fits(msg, COMPRESS_SIZE))
+      return -1;
+    int l = msg->serialize(compress_in_);
+    bool queued;
+    uint8_t * frame = beginFrame(id, queued);
+    if (frame == 0)
+      return -1;      /* TX queue is full, drop the message */
+
+    Publisher * p = publishers[id - 100 - MAX_SUBSCRIBERS];
+    int s = writeSequence(id, frame + 7);
+    uint8_t * body = frame + 7 + s;
+    int capacity = OUTPUT_SIZE - frameOverhead() - s - 1;
+    /* a delta has to fit, and be shorter than the whole message */
+    int limit = (capacity - 2 < l - 3) ? capacity - 2 : l - 3;
+    if (p->delta_length_ > 0 && p->delta_count_ < p->getDeltaInterval() && limit >= 0)
+    {
+      int n = DeltaEncoder::encode(compress_in_, l, p->getDeltaKeyframe(), p->delta_length_, body + 3, limit);
+      if (n >= 0)
+      {
+        p->delta_count_++;
+        body[0] = DELTA_ENCODED | p->delta_number_;
+        body[1] = (uint8_t)((uint16_t)l & 255);
+        body[2] = (uint8_t)((uint16_t)l >> 8);
+        return endFrame(frame, id, s + 3 + n, queued);
+      }
+    }
+
+    if (l > capacity)
+    {
+      if (queued)
+        tx_queue_.release();
+      link_counters_.overrun();
+      logerror("Message from device dropped: message larger than buffer.");
+      return -1;
+    }
+    p->delta_number_ = (p->delta_number_ + 1) & DELTA_KEYFRAME_MASK;
+    p->delta_count_ = 0;
+    p->delta_length_ = (l <= p->getDeltaSize()) ? l : 0;
+    body[0] = p->delta_number_;
+    for (int i = 0; i < l; i++)
+    {
+      body[1 + i] = compress_in_[i];
+      if (p->delta_length_ > 0)
+        p->getDeltaKeyframe()[i] = compress_in_[i];
+    }
+    return endFrame(frame, id, s + 1 + l, queued);
+  }
+
+  /* Sends a message on a compressed topic: its length, then the message
+   * compressed, or as it is if that's no shorter. */
+  int publishCompressed(int id, const Msg * msg)
+  {
+    if (!fits(msg, COMPRESS_SIZE))
+      return -1;
+    int l = msg->serialize(compress_in_);
+    bool queued;
+    uint8_t * frame = beginFrame(id, queued);
+    if (frame == 0)
+      return -1;      /* TX queue is full, drop the message */
+
+    int s = writeSequence(id, frame + 7);
+    uint8_t * body = frame + 7 + s;
+    body[0] = (uint8_t)((uint16_t)l & 255);
+    body[1] = (uint8_t)((uint16_t)l >> 8);
+    int capacity = OUTPUT_SIZE - frameOverhead() - s - 2;
+    int n = compressor_.compress(compress_in_, l, body + 2, capacity < l - 1 ? capacity : l - 1);
+    if (n < 0)
+    {
+      if (l > capacity)
+      {
+        if (queued)
+          tx_queue_.release();
+        link_counters_.overrun();
+        logerror("Message from device dropped: message larger than buffer.");
+        return -1;
+      }
+      for (int i = 0; i < l; i++)
+        body[2 + i] = compress_in_[i];
+      n = l;
+    }
+    return endFrame(frame, id, s + n + 2, queued);
+  }
+
+  /* Sends the messages batched so far, if any, behind anything queued. */
+  void flushBatch()
+  {
+    if (batch_length_ == 0)
+      return;
+    int l = batch_length_;
+    batch_length_ = 0;
+    waitForWrite();
+    tx_queue_.flush(hardware_);
+    endFrame(batch_, TopicInfo::ID_BATCH, l, false, BATCH_SIZE);
+  }
+
+  /* Picks the buffer to build a frame for this topic in. User topics go
+   * through the TX queue, if there is one; everything else is written
+   * synchronously, behind anything already queued. Returns 0 if there is
+   * no buffer free, as while a loan holds the only one. */
+  uint8_t * beginFrame(int id, bool & queued)
+  {
+    flushBatch();
+    queued = false;
+    if (tx_queue_.enabled() && !tx_cobs_)
+    {
+      if (id >= 100 + MAX_SUBSCRIBERS)
+      {
+        Publisher * p = publishers[id - 100 - MAX_SUBSCRIBERS];
+        queued = true;
+        uint8_t * frame = tx_queue_.acquire(id, p->getQueuePolicy() == QUEUE_OVERWRITE_LATEST);
+        if (frame == 0)
+          link_counters_.overrun();
+        return frame;
+      }
+      waitForWrite();
+      tx_queue_.flush(hardware_);
+    }
+    uint8_t * frame = freeFrame();
+    if (frame == 0)
+      link_counters_.overrun();
+    return frame;
+  }
+
+  /* The buffer a frame which isn't queued is built in: message_out, unless
+   * a loan has it, in which case the other buffer, once its write is done,
+   * to be written synchronously; with only the one buffer, there is none. */
+  uint8_t * freeFrame()
+  {
+    if (loan_frame_ != message_out)
+      return message_out;
+    if (TX_FRAMES == 1)
+      return 0;
+    waitForWrite();
+    return tx_frames_[(tx_frame_ + 1) % TX_FRAMES];
+  }
+
+  /* The largest message a topic may send: what fits in a frame beside its
+   * sequence number, or less if its publisher declares a smaller buffer size. */
+  int outputCapacity(int id)
+  {
+    int capacity = OUTPUT_SIZE - frameOverhead() - sequenceBytes(id);
+    if (id >= 100 + MAX_SUBSCRIBERS)
+    {
+      uint32_t declared = publishers[id - 100 - MAX_SUBSCRIBERS]->getBufferSize();
+      if (declared != 0 && declared < (uint32_t) capacity)
+        capacity = declared;
+    }
+    return capacity;
+  }
+
+  /* Bytes of sequence number ahead of each message a topic sends. */
+  int sequenceBytes(int id)
+  {
+    return (id >= 100 + MAX_SUBSCRIBERS && publishers[id - 100 - MAX_SUBSCRIBERS]->sequenced_) ? 1 : 0;
+  }
+
+  /* Numbers the next message on a topic, if the server counts them, returning
+   * the bytes that took. */
+  int writeSequence(int id, uint8_t * body)
+  {
+    if (sequenceBytes(id) == 0)
+      return 0;
+    body[0] = publishers[id - 100 - MAX_SUBSCRIBERS]->sequence_++;
+    return 1;
+  }
+
+  /* Bytes a frame adds to its message. */
+  int frameOverhead() const
+  {
+    return tx_crc16_ ? 9 : 8;
+  }
+
+  /* Fills in the header and checksum around l bytes of serialized message,
+   * and sends or queues the frame, of at most capacity bytes. */
+  int endFrame(uint8_t * frame, int id, int l, bool queued, int capacity = OUTPUT_SIZE)
+  {
+    /* setup the header */
+    frame[0] = 0xff;
+    frame[1] = tx_crc16_ ? PROTOCOL_VER2_CRC16 : PROTOCOL_VER;
+    frame[2] = (uint8_t)((uint16_t)l & 255);
+    frame[3] = (uint8_t)((uint16_t)l >> 8);
+    frame[4] = 255 - ((frame[2] + frame[3]) % 256);
+    frame[5] = (uint8_t)((int16_t)id & 255);
+    frame[6] = (uint8_t)((int16_t)id >> 8);
+
+    /* calculate checksum, or CRC */
+    if (tx_crc16_)
+    {
+      uint16_t crc = 0xffff;
+      for (int i = 5; i < l + 7; i++)
+        crc = crc16Update(crc, frame[i]);
+      l += 7;
+      frame[l++] = (uint8_t)(crc & 255);
+      frame[l++] = (uint8_t)(crc >> 8);
+    }
+    else
+    {
+      int chk = 0;
+      for (int i = 5; i < l + 7; i++)
+        chk += frame[i];
+      l += 7;
+      frame[l++] = 255 - (chk % 256);
+    }
+
+    if (l <= capacity)
+    {
+      link_counters_.txFrame(l);
+      if (queued)
+      {
+        tx_queue_.commit(l);
+        waitForWrite();
+        tx_queue_.drain(hardware_);
+      }
+      else
+      {
+        writeFrame(frame, l);
+      }
+      return l;
+    }
+    else
+    {
+      if (queued)
+        tx_queue_.release();
+      link_counters_.overrun();
+      logerror("Message from device dropped: message larger than buffer.");
+      return -1;
+    }
+  }
+
+  /* Writes a frame out, COBS framed if the server has agreed to it. The
+   * encoded frame is written a piece at a time from a small buffer, rather
+   * than needing another of the frame's size. */
+  void writeFrame(uint8_t * frame, int l)
+  {
+    waitForWrite();
+    if (!tx_cobs_ && frame == message_out && TX_FRAMES > 1)
+    {
+      /* send it from where it is, and build the next frame in the other */
+      HardwareAsyncWrite<Hardware>::write(hardware_, frame, l);
+      tx_frame_ = (tx_frame_ + 1) % TX_FRAMES;
+      message_out = tx_frames_[tx_frame_];
+      return;
+    }
+    if (!tx_cobs_)
+    {
+      hardware_.write(frame, l);
+      return;
+    }
+    uint8_t out[64];
+    int n = 0;
+    out[n++] = 0;
+    int i = 0;
+    while (true)
+    {
+      /* a block is a code byte, one more than the run of nonzero bytes
+       * which follows it, up to 254 of them; unless the block is full, it
+       * stands for a zero after the run */
+      int run = 0;
+      while (i + run < l && frame[i + run] != 0 && run < 254)
+        run++;
+      if (n == (int) sizeof(out))
+      {
+        hardware_.write(out, n);
+        n = 0;
+      }
+      out[n++] = run + 1;
+      for (int j = 0; j < run; j++)
+      {
+        if (n == (int) sizeof(out))
+        {
+          hardware_.write(out, n);
+          n = 0;
+        }
+        out[n++] = frame[i + j];
+      }
+      i += run;
+      if (i == l)
+        break;
+      if (run < 254)
+        i++;
+    }
+    if (n == (int) sizeof(out))
+    {
+      hardware_.write(out, n);
+      n = 0;
+    }
+    out[n++] = 0;
+    hardware_.write(out, n);
+  }
+
+  /* Waits for an asynchronous write to finish, before anything else is
+   * written, or the baud rate changed, behind it. */
+  void waitForWrite()
+  {
+    while (!HardwareAsyncWrite<Hardware>::done(hardware_))
+      ;
+  }
+
+  /* Takes a byte of a COBS framed frame, and returns the byte of the frame it
+   * stands for, or -1 if it stands for none. A frame found to be damaged is
+   * abandoned, and the decoder waits for the zero before the next. */
+  int cobsDecode(int data)
+  {
+    if (data == 0)
+    {
+      /* a zero ends one frame, and starts the next */
+      if (cobs_state_ == COBS_DATA)
+        mode_ = MODE_FIRST_FF;
+      cobs_state_ = COBS_FIRST_CODE;
+      return -1;
+    }
+    if (cobs_state_ == COBS_FIRST_CODE)
+    {
+      cobs_code_ = data;
+      cobs_remaining_ = data - 1;
+      cobs_zero_ = (data != 0xff);
+      cobs_state_ = (data > 1) ? COBS_FIRST_DATA : COBS_OFF;
+      return -1;
+    }
+    if (cobs_state_ == COBS_FIRST_DATA)
+    {
+      if (data != 0xff)
+      {
+        /* every frame starts with 0xff, so this is no COBS frame; it may
+         * be a plain one, whose 0xff was taken for a code byte */
+        cobs_state_ = COBS_OFF;
+        if (cobs_code_ == 0xff)
+        {
+          mode_ = MODE_PROTOCOL_VER;
+          last_msg_timeout_time = hardware_.time() + SERIAL_MSG_TIMEOUT;
+        }
+        return data;
+      }
+      cobs_state_ = COBS_DATA;
+    }
+    if (cobs_remaining_ == 0)
+    {
+      /* a code byte, which stands for the zero ending the last block */
+      bool zero = cobs_zero_;
+      cobs_remaining_ = data - 1;
+      cobs_zero_ = (data != 0xff);
+      return zero ? 0 : -1;
+    }
+    cobs_remaining_--;
+    return data;
+  }
+
+  template<typename SubscriberT>
+  bool addSubscriber(SubscriberT& s)
+  {
+    if (subscribers_length_ >= MAX_SUBSCRIBERS || s.getBufferSize() > (uint32_t) INPUT_SIZE)
+      return false;
+    subscribers[subscribers_length_] = static_cast<Subscriber_*>(&s);
+    s.id_ = subscribers_length_ + 100;
+    subscribers_length_++;
+    return true;
+  }
+
+  uint8_t * loan_frame_;
+  bool loan_queued_;
+
+  /********************************************************************
+   * Logging
+   */
+
   void log(char byte, const char * msg)
   {
     rosserial_msgs::Log l;
@@ -579,6 +2052,86 @@ public:
     log(rosserial_msgs::Log::FATAL, msg);
   }
 
+  /**
+   * @brief Logs the format string with the given id, from the header which
+   * make_log_dictionary generates, leaving the server to format it with the
+   * arguments, which may be any mix of integers, floats and strings. This
+   * saves both the formatting and the sending of the text, but the message
+   * is dropped by a server which doesn't have the dictionary to hand.
+   */
+  void logDeferred(char level, uint32_t id)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    bool queued;
+    uint8_t * frame = beginDeferredLog(queued);
+    if (frame == 0)
+      return;
+    DeferredLog l(frame + 7, OUTPUT_SIZE - frameOverhead(), level, id);
+    endFrame(frame, TopicInfo::ID_LOG_DEFERRED, l.length(), queued);
+  }
+  template<typename A>
+  void logDeferred(char level, uint32_t id, A a)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    bool queued;
+    uint8_t * frame = beginDeferredLog(queued);
+    if (frame == 0)
+      return;
+    DeferredLog l(frame + 7, OUTPUT_SIZE - frameOverhead(), level, id);
+    l.put(a);
+    endFrame(frame, TopicInfo::ID_LOG_DEFERRED, l.length(), queued);
+  }
+  template<typename A, typename B>
+  void logDeferred(char level, uint32_t id, A a, B b)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    bool queued;
+    uint8_t * frame = beginDeferredLog(queued);
+    if (frame == 0)
+      return;
+    DeferredLog l(frame + 7, OUTPUT_SIZE - frameOverhead(), level, id);
+    l.put(a);
+    l.put(b);
+    endFrame(frame, TopicInfo::ID_LOG_DEFERRED, l.length(), queued);
+  }
+  template<typename A, typename B, typename C>
+  void logDeferred(char level, uint32_t id, A a, B b, C c)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    bool queued;
+    uint8_t * frame = beginDeferredLog(queued);
+    if (frame == 0)
+      return;
+    DeferredLog l(frame + 7, OUTPUT_SIZE - frameOverhead(), level, id);
+    l.put(a);
+    l.put(b);
+    l.put(c);
+    endFrame(frame, TopicInfo::ID_LOG_DEFERRED, l.length(), queued);
+  }
+  template<typename A, typename B, typename C, typename D>
+  void logDeferred(char level, uint32_t id, A a, B b, C c, D d)
+  {
+    HardwareLock<Hardware> lock(hardware_);
+    bool queued;
+    uint8_t * frame = beginDeferredLog(queued);
+    if (frame == 0)
+      return;
+    DeferredLog l(frame + 7, OUTPUT_SIZE - frameOverhead(), level, id);
+    l.put(a);
+    l.put(b);
+    l.put(c);
+    l.put(d);
+    endFrame(frame, TopicInfo::ID_LOG_DEFERRED, l.length(), queued);
+  }
+
+private:
+  uint8_t * beginDeferredLog(bool & queued)
+  {
+    if (!log_deferred_)
+      return 0;
+    return beginFrame(TopicInfo::ID_LOG_DEFERRED, queued);
+  }
+
   /********************************************************************
    * Parameters
    */
@@ -587,6 +2140,10 @@ private:
   bool param_recieved;
   rosserial_msgs::RequestParamResponse req_param_resp;
 
+  /* the batch getParams() is waiting on */
+  Param * param_batch_pending_;
+  int param_batch_count_;
+
   bool requestParam(const char * name, int time_out =  1000)
   {
     param_recieved = false;
@@ -679,6 +2236,178 @@ public:
     }
     return false;
   }
+
+  /**
+   * @brief Fetches count parameters, in one round trip where the server can
+   * look them up together, or one at a time where it can't, returning true
+   * if every one was found with the type and length asked for. Each one's
+   * ok says whether it was. The names must fit in the output buffer, and
+   * the answer in the input buffer, so a long list may need splitting.
+   */
+  bool getParams(Param * params, int count, int timeout = 1000)
+  {
+    for (int i = 0; i < count; i++)
+      params[i].ok = false;
+    if (!param_batch_)
+      return getParamsSingly(params, count, timeout);
+
+    {
+      HardwareLock<Hardware> lock(hardware_);
+      bool queued;
+      uint8_t * frame = beginFrame(TopicInfo::ID_PARAMETER_BATCH, queued);
+      if (frame == 0)
+        return false;
+      int l = 0;
+      for (int i = 0; i < count; i++)
+      {
+        uint32_t n = strlen(params[i].name);
+        if (l + 4 + (int) n > OUTPUT_SIZE - frameOverhead())
+        {
+          logwarn("Failed to get params: names too long for one request");
+          return false;
+        }
+        for (int b = 0; b < 4; b++)
+          frame[7 + l++] = (n >> (8 * b)) & 0xff;
+        memcpy(frame + 7 + l, params[i].name, n);
+        l += n;
+      }
+
+      param_recieved = false;
+      param_batch_pending_ = params;
+      param_batch_count_ = count;
+      endFrame(frame, TopicInfo::ID_PARAMETER_BATCH, l, queued);
+    }
+    uint32_t end_time = hardware_.time() + timeout;
+    while (!param_recieved)
+    {
+      spinOnce();
+      if (hardware_.time() > end_time)
+      {
+        logwarn("Failed to get params: timeout expired");
+        break;
+      }
+    }
+    param_batch_pending_ = 0;
+
+    bool ok = param_recieved;
+    for (int i = 0; i < count; i++)
+      ok = ok && params[i].ok;
+    return ok;
+  }
+
+private:
+  bool getParamsSingly(Param * params, int count, int timeout)
+  {
+    bool ok = true;
+    for (int i = 0; i < count; i++)
+    {
+      Param & p = params[i];
+      if (p.type == Param::INTS)
+        p.ok = getParam(p.name, (int *) p.values, p.length, timeout);
+      else if (p.type == Param::FLOATS)
+        p.ok = getParam(p.name, (float *) p.values, p.length, timeout);
+      else if (p.type == Param::BOOLS)
+        p.ok = getParam(p.name, (bool *) p.values, p.length, timeout);
+      else
+        p.ok = getParam(p.name, (char **) p.values, p.length, timeout);
+      ok = ok && p.ok;
+    }
+    return ok;
+  }
+
+  static uint32_t read32(const uint8_t * data)
+  {
+    return data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+  }
+
+  /* Reads the count at the front of one of a RequestParamResponse's arrays
+   * of elements each at least size bytes, returning -1 if they can't all
+   * fit in what's left. */
+  static int32_t readCount(const uint8_t * data, int length, int & offset, int size)
+  {
+    if (length - offset < 4)
+      return -1;
+    uint32_t n = read32(data + offset);
+    offset += 4;
+    if (n > (uint32_t)(length - offset) / size)
+      return -1;
+    return n;
+  }
+
+  /* Reads one RequestParamResponse into p's storage, if it has the values
+   * p asks for, returning the bytes it took up, or -1 if it runs past the
+   * end of the answer. */
+  static int readParam(const uint8_t * data, int length, Param & p)
+  {
+    int offset = 0;
+    int32_t n = readCount(data, length, offset, 4);
+    if (n < 0)
+      return -1;
+    if ((p.type == Param::INTS || p.type == Param::BOOLS) && n == p.length)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        int32_t value = (int32_t) read32(data + offset + 4 * i);
+        if (p.type == Param::INTS)
+          ((int *) p.values)[i] = value;
+        else
+          ((bool *) p.values)[i] = value;
+      }
+      p.ok = true;
+    }
+    offset += 4 * n;
+
+    n = readCount(data, length, offset, 4);
+    if (n < 0)
+      return -1;
+    if (p.type == Param::FLOATS && n == p.length)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        union { uint32_t bits; float value; } u;
+        u.bits = read32(data + offset + 4 * i);
+        ((float *) p.values)[i] = u.value;
+      }
+      p.ok = true;
+    }
+    offset += 4 * n;
+
+    n = readCount(data, length, offset, 4);
+    if (n < 0)
+      return -1;
+    bool copy = p.type == Param::STRINGS && n == p.length;
+    for (int i = 0; i < n; i++)
+    {
+      int32_t chars = readCount(data, length, offset, 1);
+      if (chars < 0)
+        return -1;
+      if (copy)
+      {
+        char * out = ((char **) p.values)[i];
+        memcpy(out, data + offset, chars);
+        out[chars] = '\0';
+      }
+      offset += chars;
+    }
+    p.ok = p.ok || copy;
+    return offset;
+  }
+
+  /* Fills in the batch getParams() is waiting on from the server's answer. */
+  void paramBatchAnswer(const uint8_t * data, int length)
+  {
+    if (param_batch_pending_ == 0)
+      return;
+    int offset = 0;
+    for (int i = 0; i < param_batch_count_; i++)
+    {
+      int n = readParam(data + offset, length - offset, param_batch_pending_[i]);
+      if (n < 0)
+        break;
+      offset += n;
+    }
+    param_recieved = true;
+  }
 };
 
 }
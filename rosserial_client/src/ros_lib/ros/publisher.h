@@ -37,36 +37,183 @@
 
 #include "rosserial_msgs/TopicInfo.h"
 #include "ros/node_handle.h"
+#include "ros/message_writer.h"
 
 namespace ros
 {
 
+/* What publish() does with a new message when NodeHandle_ has a TX queue
+ * and the queue is full, or already holds one for the same topic. */
+const uint8_t QUEUE_DROP_NEWEST      = 0;   // queue it behind the others; drop it if there's no room
+const uint8_t QUEUE_OVERWRITE_LATEST = 1;   // replace the message that is still waiting
+
 /* Generic Publisher */
 class Publisher
 {
 public:
   Publisher(const char * topic_name, Msg * msg, int endpoint = rosserial_msgs::TopicInfo::ID_PUBLISHER) :
     topic_(topic_name),
+    topic_in_flash_(false),
+    msg_(msg),
+    paused_(false),
+    sequenced_(false),
+    sequence_(0),
+    delta_length_(0),
+    delta_number_(0),
+    delta_count_(0),
+    endpoint_(endpoint),
+    queue_policy_(QUEUE_DROP_NEWEST),
+    compress_(false),
+    buffer_size_(0),
+    delta_keyframe_(0),
+    delta_size_(0),
+    delta_interval_(0) {};
+#if defined(ARDUINO)
+  /* With the topic name in flash, as F("chatter") puts it. */
+  Publisher(const __FlashStringHelper * topic_name, Msg * msg, int endpoint = rosserial_msgs::TopicInfo::ID_PUBLISHER) :
+    topic_(reinterpret_cast<const char *>(topic_name)),
+    topic_in_flash_(true),
     msg_(msg),
-    endpoint_(endpoint) {};
+    paused_(false),
+    sequenced_(false),
+    sequence_(0),
+    delta_length_(0),
+    delta_number_(0),
+    delta_count_(0),
+    endpoint_(endpoint),
+    queue_policy_(QUEUE_DROP_NEWEST),
+    compress_(false),
+    buffer_size_(0),
+    delta_keyframe_(0),
+    delta_size_(0),
+    delta_interval_(0) {};
+#endif
 
+  /* Returns 0 without sending anything while the server has paused the
+   * topic, as it does when nothing on the ROS side subscribes to it. */
   int publish(const Msg * msg)
   {
+    if (paused_)
+      return 0;
     return nh_->publish(id_, msg);
   };
+
+  /* Lends out the buffer the next message will be sent from, to be filled
+   * in place and then passed to publish(). Not for use from callbacks. While
+   * the topic is paused, the writer is !ok() and publishing it returns 0. */
+  MessageWriter loan()
+  {
+    if (paused_)
+      return MessageWriter();
+    int capacity = 0;
+    uint8_t * data = nh_->loan(id_, &capacity);
+    return MessageWriter(data, capacity);
+  }
+  int publish(const MessageWriter & writer)
+  {
+    /* a writer without a loan, as when another was out, has none to hand
+     * back; one with a loan must, even if the topic was paused meanwhile */
+    if (!writer.lent())
+      return paused_ ? 0 : -1;
+    if (paused_ || !writer.ok())
+    {
+      nh_->publishLoan(id_, -1);
+      return paused_ ? 0 : -1;
+    }
+    return nh_->publishLoan(id_, writer.length());
+  }
   int getEndpointType()
   {
     return endpoint_;
   }
+  void setQueuePolicy(uint8_t policy)
+  {
+    queue_policy_ = policy;
+  }
+  uint8_t getQueuePolicy()
+  {
+    return queue_policy_;
+  }
+  /* Asks for messages to be sent compressed, if the NodeHandle has a
+   * COMPRESS_SIZE and the server can take them. Set before connecting. */
+  void setCompression(bool compress)
+  {
+    compress_ = compress;
+  }
+  bool getCompression()
+  {
+    return compress_;
+  }
+  /* Asks for messages to be sent as the bytes in which they differ from a
+   * keyframe, if the NodeHandle has a COMPRESS_SIZE and the server can take
+   * them, with every interval-th message sent whole to be the next keyframe.
+   * This suits messages which mostly repeat, such as states and statuses. The
+   * keyframe is kept in the size bytes at keyframe; larger messages are sent
+   * whole. Set before connecting. Messages sent this way aren't compressed. */
+  void setDelta(uint8_t * keyframe, int size, uint16_t interval)
+  {
+    delta_keyframe_ = keyframe;
+    delta_size_ = size;
+    delta_interval_ = interval;
+  }
+  int getDeltaSize()
+  {
+    return delta_keyframe_ ? delta_size_ : 0;
+  }
+  uint8_t * getDeltaKeyframe()
+  {
+    return delta_keyframe_;
+  }
+  uint16_t getDeltaInterval()
+  {
+    return delta_interval_;
+  }
+  /* Declares the largest message the topic sends, serialized, for the
+   * server to size its buffers to; larger ones are dropped. With 0, the
+   * default, it may be as large as the NodeHandle's OUTPUT_SIZE allows.
+   * Set before advertising. For a type whose SERIALIZED_SIZE_FIXED is true,
+   * its SERIALIZED_SIZE is the size to give. */
+  void setBufferSize(uint32_t size)
+  {
+    buffer_size_ = size;
+  }
+  uint32_t getBufferSize()
+  {
+    return buffer_size_;
+  }
+  /* Whether there is anyone to publish to, as far as the server has said;
+   * a message which takes work to put together can be skipped while not. */
+  bool isPaused()
+  {
+    return paused_;
+  }
 
   const char * topic_;
+  bool topic_in_flash_;
   Msg *msg_;
   // id_ and no_ are set by NodeHandle when we advertise
   int id_;
   NodeHandleBase_* nh_;
+  // set by NodeHandle as the server pauses and resumes the topic
+  bool paused_;
+  // set by NodeHandle when the server counts the messages lost on the topic,
+  // and the number of the next one sent
+  bool sequenced_;
+  uint8_t sequence_;
+  // kept by NodeHandle while sending deltas: the length of the keyframe, 0
+  // until there is one, its number, and the messages sent since
+  int delta_length_;
+  uint8_t delta_number_;
+  uint16_t delta_count_;
 
 private:
   int endpoint_;
+  uint8_t queue_policy_;
+  bool compress_;
+  uint32_t buffer_size_;
+  uint8_t * delta_keyframe_;
+  int delta_size_;
+  uint16_t delta_interval_;
 };
 
 }
@@ -43,32 +43,89 @@
 namespace ros
 {
 
+/* Results of ServiceClient::poll(). */
+enum
+{
+  CALL_IDLE,       /* no call made yet */
+  CALL_PENDING,    /* waiting on the response */
+  CALL_DONE,       /* the response has been filled in */
+  CALL_TIMED_OUT   /* none came in time, or the link went down meanwhile;
+                      a late response is ignored */
+};
+
 template<typename MReq , typename MRes>
 class ServiceClient : public Subscriber_
 {
 public:
+  typedef void(*CallbackT)(const MRes&);
+
   ServiceClient(const char* topic_name) :
     pub(topic_name, &req, rosserial_msgs::TopicInfo::ID_SERVICE_CLIENT + rosserial_msgs::TopicInfo::ID_PUBLISHER)
   {
     this->topic_ = topic_name;
-    this->waiting = true;
+    this->waiting = false;
+    this->ret = 0;
+    this->cb_ = 0;
+    this->state_ = CALL_IDLE;
   }
 
-  virtual void call(const MReq & request, MRes & response)
+  /* Sends the request and spins until the response has come, filling it in,
+   * or until timeout_ms has passed, if it isn't 0. */
+  virtual void call(const MReq & request, MRes & response, uint32_t timeout_ms = 0)
   {
-    if (!pub.nh_->connected()) return;
+    if (!callAsync(request, response, 0, timeout_ms)) return;
+    while (poll() == CALL_PENDING)
+      if (pub.nh_->spinOnce() < 0) break;
+    cancel();
+  }
+
+  /* Sends the request and returns straight away, so that the loop it is made
+   * from keeps running. The response is filled in, and callback, if given,
+   * called with it, from whichever later spinOnce() takes it in; poll() says
+   * whether it has. As with a subscriber's message, string fields of the
+   * response point into NodeHandle's receive buffer until the next spinOnce().
+   * With timeout_ms, poll() gives up on the call once that has passed. Returns
+   * false, sending nothing, when not connected or with a call still pending,
+   * as the two responses couldn't be told apart. */
+  bool callAsync(const MReq & request, MRes & response, CallbackT callback = 0, uint32_t timeout_ms = 0)
+  {
+    if (!pub.nh_->connected() || poll() == CALL_PENDING) return false;
     ret = &response;
+    cb_ = callback;
+    timeout_ms_ = timeout_ms;
+    started_us_ = pub.nh_->localMicros();
     waiting = true;
+    state_ = CALL_PENDING;
     pub.publish(&request);
-    while (waiting && pub.nh_->connected())
-      if (pub.nh_->spinOnce() < 0) break;
+    return true;
+  }
+
+  /* Where the last call has got to: one of the CALL_ values. */
+  int poll()
+  {
+    if (state_ == CALL_PENDING && (!pub.nh_->connected() || (timeout_ms_ > 0 &&
+        pub.nh_->localMicros() - started_us_ >= (uint64_t)timeout_ms_ * 1000)))
+      cancel();
+    return state_;
+  }
+
+  /* Gives up on a pending call, as if it had timed out. */
+  void cancel()
+  {
+    if (state_ != CALL_PENDING) return;
+    waiting = false;
+    state_ = CALL_TIMED_OUT;
   }
 
   // these refer to the subscriber
   virtual void callback(unsigned char *data)
   {
+    // A response with no call waiting on it is one which timed out.
+    if (!waiting) return;
     ret->deserialize(data);
     waiting = false;
+    state_ = CALL_DONE;
+    if (cb_) cb_(*ret);
   }
   virtual const char * getMsgType()
   {
@@ -88,8 +145,13 @@ public:
   MRes * ret;
   bool waiting;
   Publisher pub;
-};
 
+private:
+  CallbackT cb_;
+  int state_;
+  uint32_t timeout_ms_;
+  uint64_t started_us_;
+};
 }
 
 #endif
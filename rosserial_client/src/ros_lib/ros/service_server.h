@@ -39,6 +39,7 @@
 
 #include "ros/publisher.h"
 #include "ros/subscriber.h"
+#include "ros/message_writer.h"
 
 namespace ros
 {
@@ -125,6 +126,132 @@ private:
   CallbackT cb_;
 };
 
+
+/* Stands in for a message of type M where only its type and MD5 are needed,
+ * as a response Publisher's are when the topic is negotiated, so that no M
+ * has to be kept for the life of the service. */
+template<typename M>
+class MessageTypeOf : public Msg
+{
+public:
+  virtual int serialize(unsigned char *) const
+  {
+    return 0;
+  }
+  virtual int deserialize(unsigned char *)
+  {
+    return 0;
+  }
+  virtual const char * getType()
+  {
+    return M().getType();
+  }
+  virtual const char * getMD5()
+  {
+    return M().getMD5();
+  }
+};
+
+/* A ServiceServer whose callback serializes the response straight into the
+ * outgoing frame, through a MessageWriter as a Publisher's loan() hands out,
+ * rather than filling in an MRes to be serialized afterwards. For a
+ * service returning a uint8 status and a float64 value:
+ *
+ *   void cb(const Calibrate::Request & req, ros::MessageWriter & res)
+ *   {
+ *     res.write((uint8_t) calibrate(req.channel));
+ *     res.write(readValue(req.channel));
+ *   }
+ *   ros::InPlaceServiceServer<Calibrate::Request, Calibrate::Response> server("calibrate", &cb);
+ *
+ * The frame stays on loan while the callback runs, so what the callback
+ * publishes itself is held to the same terms as during any other loan; see
+ * MessageWriter. If the response doesn't fit, or the link can't take it,
+ * none is sent and the client's call times out. */
+template<typename MReq , typename MRes, typename ObjT = void>
+class InPlaceServiceServer : public Subscriber_
+{
+public:
+  typedef void(ObjT::*CallbackT)(const MReq&,  MessageWriter&);
+
+  InPlaceServiceServer(const char* topic_name, CallbackT cb, ObjT* obj) :
+    pub(topic_name, &resp_type, rosserial_msgs::TopicInfo::ID_SERVICE_SERVER + rosserial_msgs::TopicInfo::ID_PUBLISHER),
+    obj_(obj)
+  {
+    this->topic_ = topic_name;
+    this->cb_ = cb;
+  }
+
+  // these refer to the subscriber
+  virtual void callback(unsigned char *data)
+  {
+    req.deserialize(data);
+    MessageWriter resp = pub.loan();
+    (obj_->*cb_)(req, resp);
+    pub.publish(resp);
+  }
+  virtual const char * getMsgType()
+  {
+    return this->req.getType();
+  }
+  virtual const char * getMsgMD5()
+  {
+    return this->req.getMD5();
+  }
+  virtual int getEndpointType()
+  {
+    return rosserial_msgs::TopicInfo::ID_SERVICE_SERVER + rosserial_msgs::TopicInfo::ID_SUBSCRIBER;
+  }
+
+  MReq req;
+  MessageTypeOf<MRes> resp_type;
+  Publisher pub;
+private:
+  CallbackT cb_;
+  ObjT* obj_;
+};
+
+template<typename MReq , typename MRes>
+class InPlaceServiceServer<MReq, MRes, void> : public Subscriber_
+{
+public:
+  typedef void(*CallbackT)(const MReq&,  MessageWriter&);
+
+  InPlaceServiceServer(const char* topic_name, CallbackT cb) :
+    pub(topic_name, &resp_type, rosserial_msgs::TopicInfo::ID_SERVICE_SERVER + rosserial_msgs::TopicInfo::ID_PUBLISHER)
+  {
+    this->topic_ = topic_name;
+    this->cb_ = cb;
+  }
+
+  // these refer to the subscriber
+  virtual void callback(unsigned char *data)
+  {
+    req.deserialize(data);
+    MessageWriter resp = pub.loan();
+    cb_(req, resp);
+    pub.publish(resp);
+  }
+  virtual const char * getMsgType()
+  {
+    return this->req.getType();
+  }
+  virtual const char * getMsgMD5()
+  {
+    return this->req.getMD5();
+  }
+  virtual int getEndpointType()
+  {
+    return rosserial_msgs::TopicInfo::ID_SERVICE_SERVER + rosserial_msgs::TopicInfo::ID_SUBSCRIBER;
+  }
+
+  MReq req;
+  MessageTypeOf<MRes> resp_type;
+  Publisher pub;
+private:
+  CallbackT cb_;
+};
+
 }
 
 #endif
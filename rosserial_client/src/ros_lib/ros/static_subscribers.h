@@ -0,0 +1,93 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _ROS_STATIC_SUBSCRIBERS_H_
+#define _ROS_STATIC_SUBSCRIBERS_H_
+
+#include "ros/subscriber.h"
+
+namespace ros
+{
+
+/* The subscribers a NodeHandle_ calls back through Subscriber_'s vtable,
+ * which is all of them unless it is given a list of StaticSubscriber. */
+class DynamicSubscribers
+{
+public:
+  enum { COUNT = 0 };
+
+  static bool callback(Subscriber_ *, unsigned char *)
+  {
+    return false;
+  }
+};
+
+/* Subscribers known at compile time, as a list of each one's type and
+ * address, for a NodeHandle_ to call back directly rather than through
+ * Subscriber_'s vtable, and to have exactly as many subscriber slots as
+ * there are subscribers. They must be at namespace scope, and not static:
+ *
+ *   ros::Subscriber<std_msgs::UInt16> servo_sub("servo", &servo_cb);
+ *   ros::Subscriber<std_msgs::Empty> reset_sub("reset", &reset_cb);
+ *
+ *   typedef ros::StaticSubscriber<ros::Subscriber<std_msgs::UInt16>, &servo_sub,
+ *           ros::StaticSubscriber<ros::Subscriber<std_msgs::Empty>, &reset_sub> > Subscribers;
+ *   ros::NodeHandle_<ArduinoHardware, Subscribers::COUNT, 2, 150, 150,
+ *                    0, 1, 0, 0, 0, Subscribers> nh;
+ *
+ * Each is still subscribed with nh.subscribe(), in any order. Subscribers
+ * not on the list, such as service servers, take up slots of their own,
+ * and are called back through the vtable as usual. */
+template<class SubscriberT, SubscriberT * SUBSCRIBER, class Next = DynamicSubscribers>
+class StaticSubscriber
+{
+public:
+  enum { COUNT = 1 + Next::COUNT };
+
+  /* Calls back sub if it is on the list, returning whether it was. */
+  static bool callback(Subscriber_ * sub, unsigned char * data)
+  {
+    if (sub == static_cast<Subscriber_ *>(SUBSCRIBER))
+    {
+      SUBSCRIBER->SubscriberT::callback(data);
+      return true;
+    }
+    return Next::callback(sub, data);
+  }
+};
+
+}
+
+#endif
@@ -44,6 +44,8 @@ namespace ros
 class Subscriber_
 {
 public:
+  Subscriber_() : topic_in_flash_(false), sequenced_(false), sequence_(0), multicast_id_(0), buffer_size_(0) {}
+
   virtual void callback(unsigned char *data) = 0;
   virtual int getEndpointType() = 0;
 
@@ -53,9 +55,39 @@ public:
   virtual const char * getMsgType() = 0;
   virtual const char * getMsgMD5() = 0;
   const char * topic_;
+  bool topic_in_flash_;
+
+  // set by NodeHandle when the server numbers the messages on the topic, and
+  // the number of the next one expected
+  bool sequenced_;
+  uint8_t sequence_;
+
+  // set by NodeHandle to the id the server sends the topic on to its
+  // multicast group, or 0 while it sends it directly
+  uint16_t multicast_id_;
+
+  /* Declares the largest message the topic takes, serialized, so that the
+   * server can drop anything larger rather than send it. With 0, the default,
+   * it may be as large as the NodeHandle's INPUT_SIZE allows. Set before
+   * subscribing. For a type whose SERIALIZED_SIZE_FIXED is true,
+   * its SERIALIZED_SIZE is the size to give. */
+  void setBufferSize(uint32_t size)
+  {
+    buffer_size_ = size;
+  }
+  uint32_t getBufferSize()
+  {
+    return buffer_size_;
+  }
+
+private:
+  uint32_t buffer_size_;
 };
 
-/* Bound function subscriber. */
+/* Bound function subscriber. String fields of the message it passes to the
+ * callback point into NodeHandle's receive buffer, which deserialize()
+ * rewrites in place to NUL-terminate them; like views, they are only valid
+ * until the callback returns, and must be copied to be kept. */
 template<typename MsgT, typename ObjT = void>
 class Subscriber: public Subscriber_
 {
@@ -70,6 +102,17 @@ public:
   {
     topic_ = topic_name;
   };
+#if defined(ARDUINO)
+  /* With the topic name in flash, as F("chatter") puts it. */
+  Subscriber(const __FlashStringHelper * topic_name, CallbackT cb, ObjT* obj, int endpoint = rosserial_msgs::TopicInfo::ID_SUBSCRIBER) :
+    cb_(cb),
+    obj_(obj),
+    endpoint_(endpoint)
+  {
+    topic_ = reinterpret_cast<const char *>(topic_name);
+    topic_in_flash_ = true;
+  };
+#endif
 
   virtual void callback(unsigned char* data)
   {
@@ -110,6 +153,16 @@ public:
   {
     topic_ = topic_name;
   };
+#if defined(ARDUINO)
+  /* With the topic name in flash, as F("chatter") puts it. */
+  Subscriber(const __FlashStringHelper * topic_name, CallbackT cb, int endpoint = rosserial_msgs::TopicInfo::ID_SUBSCRIBER) :
+    cb_(cb),
+    endpoint_(endpoint)
+  {
+    topic_ = reinterpret_cast<const char *>(topic_name);
+    topic_in_flash_ = true;
+  };
+#endif
 
   virtual void callback(unsigned char* data)
   {
@@ -135,6 +188,89 @@ private:
   int endpoint_;
 };
 
+/* Subscriber which hands its callback a MsgT::View over the received bytes,
+ * rather than deserializing them into a message first. The view, and any
+ * strings read through it, point into NodeHandle's receive buffer, so are
+ * only valid until the callback returns. */
+template<typename MsgT, typename ObjT = void>
+class ViewSubscriber: public Subscriber_
+{
+public:
+  typedef typename MsgT::View ViewT;
+  typedef void(ObjT::*CallbackT)(const ViewT&);
+
+  ViewSubscriber(const char * topic_name, CallbackT cb, ObjT* obj, int endpoint = rosserial_msgs::TopicInfo::ID_SUBSCRIBER) :
+    cb_(cb),
+    obj_(obj),
+    endpoint_(endpoint)
+  {
+    topic_ = topic_name;
+  };
+
+  virtual void callback(unsigned char* data)
+  {
+    ViewT view(data);
+    (obj_->*cb_)(view);
+  }
+
+  virtual const char * getMsgType()
+  {
+    return ViewT(0).getType();
+  }
+  virtual const char * getMsgMD5()
+  {
+    return ViewT(0).getMD5();
+  }
+  virtual int getEndpointType()
+  {
+    return endpoint_;
+  }
+
+private:
+  CallbackT cb_;
+  ObjT* obj_;
+  int endpoint_;
+};
+
+/* Standalone function view subscriber. */
+template<typename MsgT>
+class ViewSubscriber<MsgT, void>: public Subscriber_
+{
+public:
+  typedef typename MsgT::View ViewT;
+  typedef void(*CallbackT)(const ViewT&);
+
+  ViewSubscriber(const char * topic_name, CallbackT cb, int endpoint = rosserial_msgs::TopicInfo::ID_SUBSCRIBER) :
+    cb_(cb),
+    endpoint_(endpoint)
+  {
+    topic_ = topic_name;
+  };
+
+  virtual void callback(unsigned char* data)
+  {
+    ViewT view(data);
+    this->cb_(view);
+  }
+
+  virtual const char * getMsgType()
+  {
+    return ViewT(0).getType();
+  }
+  virtual const char * getMsgMD5()
+  {
+    return ViewT(0).getMD5();
+  }
+  virtual int getEndpointType()
+  {
+    return endpoint_;
+  }
+
+private:
+  CallbackT cb_;
+  int endpoint_;
+};
+
 }
 
 #endif
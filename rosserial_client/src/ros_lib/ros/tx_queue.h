@@ -0,0 +1,168 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROS_TX_QUEUE_H_
+#define _ROS_TX_QUEUE_H_
+
+#include <stdint.h>
+
+namespace ros
+{
+
+/* Holds up to SLOTS outgoing frames of up to SLOT_SIZE bytes each, and
+ * writes them out a piece at a time, never more than the hardware reports
+ * it can accept without blocking. The hardware must provide
+ *   int availableForWrite()
+ * returning how many bytes can be written without blocking.
+ *
+ * Frames are added in two steps: acquire() hands out a slot to serialize
+ * into, and commit() queues it once its length is known. The slot is held
+ * until then, which may be for a whole loan, and no other is handed out. */
+template<class Hardware, int SLOTS, int SLOT_SIZE>
+class TxQueue
+{
+public:
+  TxQueue() : head_(0), count_(0), offset_(0), acquired_(-1) {}
+
+  /* Returns a slot to build a frame for topic id in, or 0 if the queue is
+   * full or a slot is already acquired. With overwrite set, a frame for the
+   * same topic which is still waiting is handed back to be replaced, rather
+   * than queueing another. */
+  uint8_t* acquire(int id, bool overwrite)
+  {
+    if (acquired_ != -1)
+      return 0;
+    if (overwrite)
+    {
+      // The head frame is skipped once it has started going out.
+      for (int i = (offset_ > 0) ? 1 : 0; i < count_; i++)
+      {
+        int slot = (head_ + i) % SLOTS;
+        if (ids_[slot] == id)
+        {
+          acquired_ = slot;
+          return frames_[slot];
+        }
+      }
+    }
+    if (count_ == SLOTS)
+      return 0;
+    acquired_ = (head_ + count_) % SLOTS;
+    ids_[acquired_] = id;
+    return frames_[acquired_];
+  }
+
+  /* Queues the frame built in the slot from the last acquire(). */
+  void commit(int length)
+  {
+    lengths_[acquired_] = length;
+    if (acquired_ == (head_ + count_) % SLOTS && count_ < SLOTS)
+      count_++;
+    acquired_ = -1;
+  }
+
+  /* Gives back the slot from the last acquire() without queueing it. */
+  void release()
+  {
+    acquired_ = -1;
+  }
+
+  /* Writes as much of the queue as the hardware can take right now. */
+  void drain(Hardware& hardware)
+  {
+    while (count_ > 0)
+    {
+      int room = hardware.availableForWrite();
+      if (room <= 0)
+        return;
+      int length = lengths_[head_] - offset_;
+      if (length > room)
+        length = room;
+      hardware.write(frames_[head_] + offset_, length);
+      offset_ += length;
+      if (offset_ == lengths_[head_])
+      {
+        head_ = (head_ + 1) % SLOTS;
+        count_--;
+        offset_ = 0;
+      }
+    }
+  }
+
+  /* Blocks until every queued frame has been written. */
+  void flush(Hardware& hardware)
+  {
+    while (count_ > 0)
+      drain(hardware);
+  }
+
+  bool enabled() const
+  {
+    return true;
+  }
+
+  /* Whether any frame is still waiting to be written. */
+  bool pending() const
+  {
+    return count_ > 0;
+  }
+
+private:
+  uint8_t frames_[SLOTS][SLOT_SIZE];
+  int ids_[SLOTS];
+  int lengths_[SLOTS];
+  int head_;
+  int count_;
+  int offset_;
+  int acquired_;
+};
+
+/* With no slots, there is no queue and nothing is stored; NodeHandle_
+ * writes each frame synchronously from its own buffer. */
+template<class Hardware, int SLOT_SIZE>
+class TxQueue<Hardware, 0, SLOT_SIZE>
+{
+public:
+  uint8_t* acquire(int, bool) { return 0; }
+  void commit(int) {}
+  void release() {}
+  void drain(Hardware&) {}
+  void flush(Hardware&) {}
+  bool enabled() const { return false; }
+  bool pending() const { return false; }
+};
+
+}
+
+#endif
@@ -58,6 +58,15 @@ public:
     publisher_.publish(&internal_msg);
   }
 
+  /* Sends count transforms together in one tfMessage, rather than a message
+   * each, for frames which are all updated at the same time. */
+  void sendTransforms(geometry_msgs::TransformStamped *transforms, uint32_t count)
+  {
+    internal_msg.transforms_length = count;
+    internal_msg.transforms = transforms;
+    publisher_.publish(&internal_msg);
+  }
+
 private:
   tf::tfMessage internal_msg;
   ros::Publisher publisher_;
@@ -47,6 +47,40 @@ import os, sys, re
 # for copying files
 import shutil
 
+# for generating packages in parallel
+import multiprocessing
+
+try:
+    from cStringIO import StringIO
+except ImportError:
+    from io import StringIO
+
+# fixed capacities for variable-length arrays, see load_array_capacities
+ARRAY_CAPACITIES = dict()
+
+# float fields sent as fixed point, see load_quantization
+QUANTIZATION = dict()
+
+# whether messages keep their type and MD5 sum in flash, see rosserial_generate
+FLASH_STRINGS = False
+
+# whether fields of several bytes go through the serializers shared in ros::Msg,
+# see rosserial_generate
+SHARED_SERIALIZERS = False
+
+# where make_package generates to, and which types, see rosserial_generate
+GENERATE_ROSPACK = None
+GENERATE_PATH = None
+GENERATE_WANTED = None
+
+# sizeof each C type fields are declared as
+C_TYPE_SIZES = {
+    'bool' : 1, 'int8_t' : 1, 'uint8_t' : 1,
+    'int16_t' : 2, 'uint16_t' : 2,
+    'int32_t' : 4, 'uint32_t' : 4, 'float' : 4,
+    'int64_t' : 8, 'uint64_t' : 8, 'double' : 8,
+}
+
 def type_to_var(ty):
     lookup = {
         1 : 'uint8_t',
@@ -84,7 +118,21 @@ class PrimitiveDataType:
     def make_declaration(self, f):
         f.write('      typedef %s _%s_type;\n      _%s_type %s;\n' % (self.type, self.name, self.name, self.name) )
 
+    def native(self):
+        """ Whether the field is converted as every byte of its C type, so that
+            it is stored exactly as on the wire on little-endian targets. Some
+            platforms' type maps convert fewer, as uint64 in 4 bytes. """
+        return C_TYPE_SIZES.get(self.type) == self.bytes
+
+    def wire_bytes(self):
+        """ The bytes the field takes in the message, which serialize() steps
+            over whatever the type map gives it to convert: sizeof its C type. """
+        return C_TYPE_SIZES.get(self.type, self.bytes)
+
     def serialize(self, f):
+        if SHARED_SERIALIZERS and self.bytes in (2, 4, 8) and self.native():
+            f.write('      offset += serializeValue(outbuffer + offset, this->%s);\n' % self.name)
+            return
         cn = self.name.replace("[","").replace("]","").split(".")[-1]
         if self.type != type_to_var(self.bytes):
             f.write('      union {\n')
@@ -100,6 +148,9 @@ class PrimitiveDataType:
         f.write('      offset += sizeof(this->%s);\n' % self.name)
 
     def deserialize(self, f):
+        if SHARED_SERIALIZERS and self.bytes in (2, 4, 8) and self.native():
+            f.write('      offset += deserializeValue(inbuffer + offset, this->%s);\n' % self.name)
+            return
         cn = self.name.replace("[","").replace("]","").split(".")[-1]
         if self.type != type_to_var(self.bytes):
             f.write('      union {\n')
@@ -116,6 +167,52 @@ class PrimitiveDataType:
                 f.write('      this->%s |= ((%s) (*(inbuffer + offset + %d))) << (8 * %d);\n' % (self.name,self.type,i+1,i+1) )
         f.write('      offset += sizeof(this->%s);\n' % self.name)
 
+    # Message views read each field straight from the serialized message. The
+    # view_* functions give the type a field is read as, expressions which read
+    # it and give its length on the wire when it starts at offset o, and its
+    # length if that is always the same.
+
+    def view_type(self):
+        return self.type
+
+    def view_read(self, o):
+        if self.type == 'bool':
+            return 'readValue<uint8_t>(%s) != 0' % o
+        return 'readValue<%s>(%s)' % (self.type, o)
+
+    def view_size(self, o):
+        return str(self.wire_bytes())
+
+    def view_fixed_size(self):
+        return self.wire_bytes()
+
+    def view_accessor(self, f):
+        f.write('      %s %s() const\n' % (self.view_type(), self.name))
+        f.write('      {\n')
+        f.write('        return %s;\n' % self.view_read('%s_offset()' % self.name))
+        f.write('      }\n')
+
+    def view_skip(self, f):
+        f.write('        offset += %s;\n' % self.view_size('offset'))
+
+    # The length a field serializes to: size_constant() and size_fixed() are C++
+    # constant expressions for the least it can be and whether it is always that,
+    # and length_expr() gives the length of a value of the field's type. Fields
+    # fixed here are added up into the start of serializedLength(), and the rest
+    # write how to add their length onto it.
+
+    def size_constant(self):
+        return str(self.view_fixed_size())
+
+    def size_fixed(self):
+        return 'true'
+
+    def length_expr(self, value):
+        return str(self.view_fixed_size())
+
+    def serialized_length(self, f):
+        f.write('      length += %s;\n' % self.length_expr('this->%s' % self.name))
+
 
 class MessageDataType(PrimitiveDataType):
     """ For when our data type is another message. """
@@ -129,6 +226,27 @@ class MessageDataType(PrimitiveDataType):
     def deserialize(self, f):
         f.write('      offset += this->%s.deserialize(inbuffer + offset);\n' % self.name)
 
+    def view_type(self):
+        return '%s::View' % self.type
+
+    def view_read(self, o):
+        return 'readView<%s::View>(%s)' % (self.type, o)
+
+    def view_size(self, o):
+        return 'readView<%s::View>(%s).serializedLength()' % (self.type, o)
+
+    def view_fixed_size(self):
+        return None
+
+    def size_constant(self):
+        return '%s::SERIALIZED_SIZE' % self.type
+
+    def size_fixed(self):
+        return '%s::SERIALIZED_SIZE_FIXED' % self.type
+
+    def length_expr(self, value):
+        return '%s.serializedLength()' % value
+
 
 class AVR_Float64DataType(PrimitiveDataType):
     """ AVR C/C++ has no native 64-bit support, we automatically convert to 32-bit float. """
@@ -145,6 +263,53 @@ class AVR_Float64DataType(PrimitiveDataType):
     def deserialize(self, f):
         f.write('      offset += deserializeAvrFloat64(inbuffer + offset, &(this->%s));\n' % self.name)
 
+    def view_type(self):
+        return 'float'
+
+    def view_read(self, o):
+        return 'readAvrFloat64(%s)' % o
+
+    def view_size(self, o):
+        return '8'
+
+    def view_fixed_size(self):
+        return 8
+
+
+class QuantizedDataType(PrimitiveDataType):
+    """ A float field sent as a fixed-point integer of fewer bytes; see
+        load_quantization. Made into a class per field by quantized_type. """
+
+    scale = 1.0
+    offset = 0.0
+    wire_bytes = 4
+
+    def _args(self):
+        return '%s, %s, %d' % (repr(float(self.scale)), repr(float(self.offset)), self.wire_bytes)
+
+    def serialize(self, f):
+        f.write('      offset += serializeQuantized(outbuffer + offset, this->%s, %s);\n' % (self.name, self._args()))
+
+    def deserialize(self, f):
+        f.write('      offset += deserializeQuantized(inbuffer + offset, &(this->%s), %s);\n' % (self.name, self._args()))
+
+    def view_read(self, o):
+        return 'readQuantized<%s>(%s, %s)' % (self.type, o, self._args())
+
+    def view_size(self, o):
+        return str(self.wire_bytes)
+
+    def view_fixed_size(self):
+        return self.wire_bytes
+
+def quantized_type(quantization):
+    """ The data type for a float field with the given quantization. """
+    class Quantized(QuantizedDataType):
+        scale = quantization['scale']
+        offset = quantization.get('offset', 0.0)
+        wire_bytes = quantization['bits'] // 8
+    return Quantized
+
 
 class StringDataType(PrimitiveDataType):
     """ Need to convert to signed char *. """
@@ -158,16 +323,22 @@ class StringDataType(PrimitiveDataType):
     def serialize(self, f):
         cn = self.name.replace("[","").replace("]","")
         f.write('      uint32_t length_%s = strlen(this->%s);\n' % (cn,self.name))
-        f.write('      varToArr(outbuffer + offset, length_%s);\n' % cn)
-        f.write('      offset += 4;\n')
+        if SHARED_SERIALIZERS:
+            f.write('      offset += serializeValue(outbuffer + offset, length_%s);\n' % cn)
+        else:
+            f.write('      varToArr(outbuffer + offset, length_%s);\n' % cn)
+            f.write('      offset += 4;\n')
         f.write('      memcpy(outbuffer + offset, this->%s, length_%s);\n' % (self.name,cn))
         f.write('      offset += length_%s;\n' % cn)
 
     def deserialize(self, f):
         cn = self.name.replace("[","").replace("]","")
         f.write('      uint32_t length_%s;\n' % cn)
-        f.write('      arrToVar(length_%s, (inbuffer + offset));\n' % cn)
-        f.write('      offset += 4;\n')
+        if SHARED_SERIALIZERS:
+            f.write('      offset += deserializeValue(inbuffer + offset, length_%s);\n' % cn)
+        else:
+            f.write('      arrToVar(length_%s, (inbuffer + offset));\n' % cn)
+            f.write('      offset += 4;\n')
         f.write('      for(unsigned int k= offset; k< offset+length_%s; ++k){\n'%cn) #shift for null character
         f.write('          inbuffer[k-1]=inbuffer[k];\n')
         f.write('      }\n')
@@ -175,6 +346,27 @@ class StringDataType(PrimitiveDataType):
         f.write('      this->%s = (char *)(inbuffer + offset-1);\n' % self.name)
         f.write('      offset += length_%s;\n' % cn)
 
+    def view_type(self):
+        return 'ros::StringView'
+
+    def view_read(self, o):
+        return 'readString(%s)' % o
+
+    def view_size(self, o):
+        return '4 + readValue<uint32_t>(%s)' % o
+
+    def view_fixed_size(self):
+        return None
+
+    def size_constant(self):
+        return '4'
+
+    def size_fixed(self):
+        return 'false'
+
+    def length_expr(self, value):
+        return '4 + strlen(%s)' % value
+
 
 class TimeDataType(PrimitiveDataType):
 
@@ -198,19 +390,33 @@ class TimeDataType(PrimitiveDataType):
         self.sec.deserialize(f)
         self.nsec.deserialize(f)
 
+    def view_read(self, o):
+        return 'readStamp<%s>(%s)' % (self.type, o)
+
+    def view_size(self, o):
+        return '8'
+
+    def view_fixed_size(self):
+        return 8
+
 
 class ArrayDataType(PrimitiveDataType):
 
-    def __init__(self, name, ty, bytes, cls, array_size=None):
+    def __init__(self, name, ty, bytes, cls, array_size=None, capacity=None):
         self.name = name
         self.type = ty
         self.bytes = bytes
         self.size = array_size
         self.cls = cls
+        self.capacity = capacity    # for variable-length arrays, keep at most this many
+                                    # elements in storage in the message, rather than on the heap
 
     def make_initializer(self, f, trailer):
         if self.size == None:
-            f.write('      %s_length(0), %s(NULL)%s\n' % (self.name, self.name, trailer))
+            if self.capacity:
+                f.write('      %s_length(0), %s(%s_storage)%s\n' % (self.name, self.name, self.name, trailer))
+            else:
+                f.write('      %s_length(0), %s(NULL)%s\n' % (self.name, self.name, trailer))
         else:
             f.write('      %s()%s\n' % (self.name, trailer))
 
@@ -220,55 +426,207 @@ class ArrayDataType(PrimitiveDataType):
             f.write('      typedef %s _%s_type;\n' % (self.type, self.name))
             f.write('      _%s_type st_%s;\n' % (self.name, self.name)) # static instance for copy
             f.write('      _%s_type * %s;\n' % (self.name, self.name))
+            if self.capacity:
+                f.write('      _%s_type %s_storage[%d];\n' % (self.name, self.name, self.capacity))
         else:
             f.write('      %s %s[%d];\n' % (self.type, self.name, self.size))
 
+    def is_bulk(self):
+        """ Arrays of plain integers and floats are laid out in memory exactly as
+            on the wire on little-endian targets, so can be copied wholesale. """
+        return self.cls is PrimitiveDataType and self.type != 'bool' and \
+            self.cls(self.name, self.type, self.bytes).native()
+
+    def write_copy(self, f, copy, write_loop, avr_copy=None):
+        """ Writes the wholesale copy, if this array can use one, guarded so that
+            big-endian targets fall back to the element by element loop. Arrays
+            of AVR float64 are converted by one call for the whole array. """
+        if self.cls is AVR_Float64DataType and avr_copy:
+            for line in avr_copy:
+                f.write('      %s\n' % line)
+            return
+        if not self.is_bulk():
+            write_loop()
+            return
+        f.write('#if ROSSERIAL_LITTLE_ENDIAN\n')
+        for line in copy:
+            f.write('      %s\n' % line)
+        f.write('#else\n')
+        write_loop()
+        f.write('#endif\n')
+
     def serialize(self, f):
         c = self.cls(self.name+"[i]", self.type, self.bytes)
         if self.size == None:
             # serialize length
-            f.write('      *(outbuffer + offset + 0) = (this->%s_length >> (8 * 0)) & 0xFF;\n' % self.name)
-            f.write('      *(outbuffer + offset + 1) = (this->%s_length >> (8 * 1)) & 0xFF;\n' % self.name)
-            f.write('      *(outbuffer + offset + 2) = (this->%s_length >> (8 * 2)) & 0xFF;\n' % self.name)
-            f.write('      *(outbuffer + offset + 3) = (this->%s_length >> (8 * 3)) & 0xFF;\n' % self.name)
-            f.write('      offset += sizeof(this->%s_length);\n' % self.name)
-            f.write('      for( uint32_t i = 0; i < %s_length; i++){\n' % self.name)
-            c.serialize(f)
-            f.write('      }\n')
+            if SHARED_SERIALIZERS:
+                f.write('      offset += serializeValue(outbuffer + offset, this->%s_length);\n' % self.name)
+            else:
+                f.write('      *(outbuffer + offset + 0) = (this->%s_length >> (8 * 0)) & 0xFF;\n' % self.name)
+                f.write('      *(outbuffer + offset + 1) = (this->%s_length >> (8 * 1)) & 0xFF;\n' % self.name)
+                f.write('      *(outbuffer + offset + 2) = (this->%s_length >> (8 * 2)) & 0xFF;\n' % self.name)
+                f.write('      *(outbuffer + offset + 3) = (this->%s_length >> (8 * 3)) & 0xFF;\n' % self.name)
+                f.write('      offset += sizeof(this->%s_length);\n' % self.name)
+            def write_loop():
+                f.write('      for( uint32_t i = 0; i < %s_length; i++){\n' % self.name)
+                c.serialize(f)
+                f.write('      }\n')
+            self.write_copy(f, ['memcpy(outbuffer + offset, this->%s, this->%s_length * sizeof(%s));' % (self.name, self.name, self.type),
+                                'offset += this->%s_length * sizeof(%s);' % (self.name, self.type)], write_loop,
+                            ['offset += serializeAvrFloat64Array(outbuffer + offset, this->%s, this->%s_length);' % (self.name, self.name)])
         else:
-            f.write('      for( uint32_t i = 0; i < %d; i++){\n' % (self.size) )
-            c.serialize(f)
-            f.write('      }\n')
+            def write_loop():
+                f.write('      for( uint32_t i = 0; i < %d; i++){\n' % (self.size) )
+                c.serialize(f)
+                f.write('      }\n')
+            self.write_copy(f, ['memcpy(outbuffer + offset, this->%s, sizeof(this->%s));' % (self.name, self.name),
+                                'offset += sizeof(this->%s);' % self.name], write_loop,
+                            ['offset += serializeAvrFloat64Array(outbuffer + offset, this->%s, %d);' % (self.name, self.size)])
 
     def deserialize(self, f):
         if self.size == None:
             c = self.cls("st_"+self.name, self.type, self.bytes)
             # deserialize length
-            f.write('      uint32_t %s_lengthT = ((uint32_t) (*(inbuffer + offset))); \n' % self.name)
-            f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 1))) << (8 * 1); \n' % self.name)
-            f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 2))) << (8 * 2); \n' % self.name)
-            f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 3))) << (8 * 3); \n' % self.name)
-            f.write('      offset += sizeof(this->%s_length);\n' % self.name)
+            if SHARED_SERIALIZERS:
+                f.write('      uint32_t %s_lengthT;\n' % self.name)
+                f.write('      offset += deserializeValue(inbuffer + offset, %s_lengthT);\n' % self.name)
+            else:
+                f.write('      uint32_t %s_lengthT = ((uint32_t) (*(inbuffer + offset))); \n' % self.name)
+                f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 1))) << (8 * 1); \n' % self.name)
+                f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 2))) << (8 * 2); \n' % self.name)
+                f.write('      %s_lengthT |= ((uint32_t) (*(inbuffer + offset + 3))) << (8 * 3); \n' % self.name)
+                f.write('      offset += sizeof(this->%s_length);\n' % self.name)
+            if self.capacity != None:
+                # elements beyond the capacity are still deserialized, to step over
+                # them, but then dropped
+                if self.capacity:
+                    f.write('      this->%s = this->%s_storage;\n' % (self.name, self.name))
+                f.write('      %s_length = (%s_lengthT < %d) ? %s_lengthT : %d;\n' % (self.name, self.name, self.capacity, self.name, self.capacity))
+                def write_loop():
+                    f.write('      for( uint32_t i = 0; i < %s_lengthT; i++){\n' % (self.name) )
+                    c.deserialize(f)
+                    if self.capacity:
+                        f.write('        if (i < %d)\n' % self.capacity)
+                        f.write('          memcpy( &(this->%s[i]), &(this->st_%s), sizeof(%s));\n' % (self.name, self.name, self.type))
+                    f.write('      }\n')
+                copy = ['offset += %s_lengthT * sizeof(%s);' % (self.name, self.type)]
+                avr_copy = ['offset += %s_lengthT * 8;' % self.name]
+                if self.capacity:
+                    copy.insert(0, 'memcpy(this->%s, inbuffer + offset, %s_length * sizeof(%s));' % (self.name, self.name, self.type))
+                    avr_copy.insert(0, 'deserializeAvrFloat64Array(inbuffer + offset, this->%s, %s_length);' % (self.name, self.name))
+                self.write_copy(f, copy, write_loop, avr_copy)
+                return
             f.write('      if(%s_lengthT > %s_length)\n' % (self.name, self.name))
             f.write('        this->%s = (%s*)realloc(this->%s, %s_lengthT * sizeof(%s));\n' % (self.name, self.type, self.name, self.name, self.type))
             f.write('      %s_length = %s_lengthT;\n' % (self.name, self.name))
             # copy to array
-            f.write('      for( uint32_t i = 0; i < %s_length; i++){\n' % (self.name) )
-            c.deserialize(f)
-            f.write('        memcpy( &(this->%s[i]), &(this->st_%s), sizeof(%s));\n' % (self.name, self.name, self.type))
-            f.write('      }\n')
+            def write_loop():
+                f.write('      for( uint32_t i = 0; i < %s_length; i++){\n' % (self.name) )
+                c.deserialize(f)
+                f.write('        memcpy( &(this->%s[i]), &(this->st_%s), sizeof(%s));\n' % (self.name, self.name, self.type))
+                f.write('      }\n')
+            self.write_copy(f, ['memcpy(this->%s, inbuffer + offset, %s_length * sizeof(%s));' % (self.name, self.name, self.type),
+                                'offset += %s_length * sizeof(%s);' % (self.name, self.type)], write_loop,
+                            ['offset += deserializeAvrFloat64Array(inbuffer + offset, this->%s, %s_length);' % (self.name, self.name)])
         else:
             c = self.cls(self.name+"[i]", self.type, self.bytes)
-            f.write('      for( uint32_t i = 0; i < %d; i++){\n' % (self.size) )
-            c.deserialize(f)
-            f.write('      }\n')
+            def write_loop():
+                f.write('      for( uint32_t i = 0; i < %d; i++){\n' % (self.size) )
+                c.deserialize(f)
+                f.write('      }\n')
+            self.write_copy(f, ['memcpy(this->%s, inbuffer + offset, sizeof(this->%s));' % (self.name, self.name),
+                                'offset += sizeof(this->%s);' % self.name], write_loop,
+                            ['offset += deserializeAvrFloat64Array(inbuffer + offset, this->%s, %d);' % (self.name, self.size)])
+
+    def view_accessor(self, f):
+        c = self.cls(self.name, self.type, self.bytes)
+        start = '%s_offset()' % self.name
+        f.write('      uint32_t %s_length() const\n' % self.name)
+        f.write('      {\n')
+        if self.size == None:
+            f.write('        return readValue<uint32_t>(%s);\n' % start)
+            start += ' + 4'
+        else:
+            f.write('        return %d;\n' % self.size)
+        f.write('      }\n')
+        f.write('      %s %s(uint32_t i) const\n' % (c.view_type(), self.name))
+        f.write('      {\n')
+        if c.view_fixed_size() != None:
+            f.write('        return %s;\n' % c.view_read('%s + i * %d' % (start, c.view_fixed_size())))
+        else:
+            # elements vary in length, so have to be stepped over one by one
+            f.write('        uint32_t offset = %s;\n' % start)
+            f.write('        for( uint32_t j = 0; j < i; j++)\n')
+            f.write('          offset += %s;\n' % c.view_size('offset'))
+            f.write('        return %s;\n' % c.view_read('offset'))
+        f.write('      }\n')
+
+    def view_skip(self, f):
+        c = self.cls(self.name, self.type, self.bytes)
+        if c.view_fixed_size() != None:
+            if self.size == None:
+                f.write('        offset += 4 + readValue<uint32_t>(offset) * %d;\n' % c.view_fixed_size())
+            else:
+                f.write('        offset += %d;\n' % (self.size * c.view_fixed_size()))
+            return
+        if self.size == None:
+            f.write('        uint32_t length = readValue<uint32_t>(offset);\n')
+            f.write('        offset += 4;\n')
+            count = 'length'
+        else:
+            count = str(self.size)
+        f.write('        for( uint32_t i = 0; i < %s; i++)\n' % count)
+        f.write('          offset += %s;\n' % c.view_size('offset'))
+
+    def size_constant(self):
+        if self.size == None:
+            return '4'
+        c = self.cls(self.name, self.type, self.bytes)
+        if c.size_fixed() == 'true':
+            return str(self.size * int(c.size_constant()))
+        return '%d * %s' % (self.size, c.size_constant())
+
+    def size_fixed(self):
+        if self.size == None:
+            return 'false'
+        return self.cls(self.name, self.type, self.bytes).size_fixed()
+
+    def serialized_length(self, f):
+        c = self.cls(self.name, self.type, self.bytes)
+        if self.size == None:
+            count = 'this->%s_length' % self.name
+            if c.size_fixed() == 'true':
+                f.write('      length += 4 + %s * %s;\n' % (count, c.size_constant()))
+                return
+            f.write('      length += 4;\n')
+        else:
+            count = str(self.size)
+        indent = '      '
+        if c.size_fixed() != 'false':
+            # elements which may all be the same length, known at compile time
+            f.write('      if (%s)\n' % c.size_fixed())
+            f.write('        length += %s * %s;\n' % (count, c.size_constant()))
+            f.write('      else\n')
+            indent += '  '
+        f.write('%sfor( uint32_t i = 0; i < %s; i++)\n' % (indent, count))
+        f.write('%s  length += %s;\n' % (indent, c.length_expr('this->%s[i]' % self.name)))
 
 #####################################################################
 # Messages
 
+def return_string(value):
+    """ The body of a function returning a string literal, which is kept in
+        flash when generating with flash_strings. """
+    if FLASH_STRINGS:
+        return 'static const char s[] ROSSERIAL_PROGMEM = "%s"; return s;' % value
+    return 'return "%s";' % value
+
 class Message:
     """ Parses message definitions into something we can export. """
     global ROS_TO_EMBEDDED_TYPES
+    global ARRAY_CAPACITIES
+    global QUANTIZATION
+    global FLASH_STRINGS
 
     def __init__(self, name, package, definition, md5):
 
@@ -325,6 +683,10 @@ class Message:
                 code_type = ROS_TO_EMBEDDED_TYPES[type_name][0]
                 size = ROS_TO_EMBEDDED_TYPES[type_name][1]
                 cls = ROS_TO_EMBEDDED_TYPES[type_name][2]
+                quantization = QUANTIZATION.get(self.package+"/"+self.name, {}).get(name)
+                if quantization != None and type_name in ('float32', 'float64'):
+                    cls = quantized_type(quantization)
+                    size = cls.wire_bytes
                 for include in ROS_TO_EMBEDDED_TYPES[type_name][3]:
                     if include not in self.includes:
                         self.includes.append(include)
@@ -337,28 +699,99 @@ class Message:
                 code_type = type_package + "::" + type_name
                 size = 0
             if type_array:
-                self.data.append( ArrayDataType(name, code_type, size, cls, type_array_size ) )
+                capacity = None
+                if type_array_size == None:
+                    capacity = ARRAY_CAPACITIES.get(self.package+"/"+self.name, {}).get(name)
+                self.data.append( ArrayDataType(name, code_type, size, cls, type_array_size, capacity ) )
             else:
                 self.data.append( cls(name, code_type, size) )
 
+    def _plain_fields(self):
+        """ The members to copy if every field is an integer, float or time, or a
+            fixed-size array of integers or floats, converted as every byte of
+            its C type and so stored exactly as on the wire on little-endian
+            targets; None otherwise. """
+        fields = list()
+        for d in self.data:
+            if isinstance(d, TimeDataType):
+                fields += [d.sec.name, d.nsec.name]
+            elif isinstance(d, ArrayDataType) and d.size != None and d.is_bulk():
+                fields.append(d.name)
+            elif d.__class__ is PrimitiveDataType and d.type != 'bool' and d.native():
+                fields.append(d.name)
+            else:
+                return None
+        return fields
+
+    def _write_plain(self, f, copy, write_fields):
+        """ Writes the fields copied one memcpy each, if this message's can be,
+            guarded so that big-endian targets fall back to swapping bytes. """
+        fields = self._plain_fields()
+        if not fields:
+            write_fields()
+            return
+        f.write('#if ROSSERIAL_LITTLE_ENDIAN\n')
+        for name in fields:
+            f.write('      %s\n' % (copy % (name, name)))
+            f.write('      offset += sizeof(this->%s);\n' % name)
+        f.write('#else\n')
+        write_fields()
+        f.write('#endif\n')
+
     def _write_serializer(self, f):
                 # serializer
         f.write('    virtual int serialize(unsigned char *outbuffer) const\n')
         f.write('    {\n')
         f.write('      int offset = 0;\n')
-        for d in self.data:
-            d.serialize(f)
+        def write_fields():
+            for d in self.data:
+                d.serialize(f)
+        self._write_plain(f, 'memcpy(outbuffer + offset, &this->%s, sizeof(this->%s));', write_fields)
         f.write('      return offset;\n');
         f.write('    }\n')
         f.write('\n')
 
+    def _write_sizes(self, f):
+        fixed = [d.size_fixed() for d in self.data if d.size_fixed() != 'true']
+        if 'false' in fixed:
+            fixed = ['false']
+        f.write('    static const bool SERIALIZED_SIZE_FIXED = %s;\n' % (' && '.join(fixed) or 'true'))
+        f.write('    static const uint32_t SERIALIZED_SIZE = %s;\n' % (' + '.join([d.size_constant() for d in self.data]) or '0'))
+        # the st_ copies deserialize() builds each array element in, here and
+        # in the messages fields are, which sizeof() the message counts too
+        temporaries = list()
+        for d in self.data:
+            if isinstance(d, ArrayDataType) and d.size == None:
+                temporaries.append('sizeof(_%s_type)' % d.name)
+            elif isinstance(d, ArrayDataType) and d.cls is MessageDataType:
+                temporaries.append('%d * %s::TEMPORARIES_SIZE' % (d.size, d.type))
+            elif d.__class__ is MessageDataType:
+                temporaries.append('%s::TEMPORARIES_SIZE' % d.type)
+        f.write('    static const uint32_t TEMPORARIES_SIZE = %s;\n' % (' + '.join(temporaries) or '0'))
+        f.write('\n')
+
+    def _write_serialized_length(self, f):
+        # fields of a length known here are counted up front
+        known = [int(d.size_constant()) for d in self.data if d.size_fixed() == 'true']
+        f.write('    virtual uint32_t serializedLength() const\n')
+        f.write('    {\n')
+        f.write('      uint32_t length = %d;\n' % sum(known))
+        for d in self.data:
+            if d.size_fixed() != 'true':
+                d.serialized_length(f)
+        f.write('      return length;\n')
+        f.write('    }\n')
+        f.write('\n')
+
     def _write_deserializer(self, f):
         # deserializer
         f.write('    virtual int deserialize(unsigned char *inbuffer)\n')
         f.write('    {\n')
         f.write('      int offset = 0;\n')
-        for d in self.data:
-            d.deserialize(f)
+        def write_fields():
+            for d in self.data:
+                d.deserialize(f)
+        self._write_plain(f, 'memcpy(&this->%s, inbuffer + offset, sizeof(this->%s));', write_fields)
         f.write('     return offset;\n');
         f.write('    }\n')
         f.write('\n')
@@ -368,6 +801,12 @@ class Message:
         f.write('#include <string.h>\n')
         f.write('#include <stdlib.h>\n')
         f.write('#include "ros/msg.h"\n')
+        f.write('#include "ros/message_view.h"\n')
+        if FLASH_STRINGS:
+            f.write('\n')
+            f.write('#ifndef ROSSERIAL_FLASH_STRINGS\n')
+            f.write('#define ROSSERIAL_FLASH_STRINGS\n')
+            f.write('#endif\n')
 
     def _write_msg_includes(self,f):
         for i in self.includes:
@@ -389,22 +828,62 @@ class Message:
         f.write('\n')
 
     def _write_getType(self, f):
-        f.write('    const char * getType(){ return "%s/%s"; };\n'%(self.package, self.name))
+        f.write('    const char * getType(){ %s };\n' % return_string('%s/%s' % (self.package, self.name)))
 
     def _write_getMD5(self, f):
-        f.write('    const char * getMD5(){ return "%s"; };\n'%self.md5)
+        f.write('    const char * getMD5(){ %s };\n' % return_string(self.md5))
+
+    def _write_view(self, f):
+        # a View reads fields in place from a serialized message, finding each
+        # by stepping over the ones before it
+        f.write('    class View : public ros::MessageView\n')
+        f.write('    {\n')
+        f.write('      public:\n')
+        f.write('      explicit View(const uint8_t * data) : ros::MessageView(data) {}\n')
+        for d in self.data:
+            d.view_accessor(f)
+        f.write('      uint32_t serializedLength() const\n')
+        f.write('      {\n')
+        if self.data:
+            f.write('        uint32_t offset = %s_offset();\n' % self.data[-1].name)
+            self.data[-1].view_skip(f)
+            f.write('        return offset;\n')
+        else:
+            f.write('        return 0;\n')
+        f.write('      }\n')
+        f.write('  ')
+        self._write_getType(f)
+        f.write('  ')
+        self._write_getMD5(f)
+        f.write('\n')
+        f.write('      private:\n')
+        for i in range(len(self.data)):
+            f.write('      uint32_t %s_offset() const\n' % self.data[i].name)
+            f.write('      {\n')
+            if i == 0:
+                f.write('        return 0;\n')
+            else:
+                f.write('        uint32_t offset = %s_offset();\n' % self.data[i-1].name)
+                self.data[i-1].view_skip(f)
+                f.write('        return offset;\n')
+            f.write('      }\n')
+        f.write('    };\n')
 
     def _write_impl(self, f):
         f.write('  class %s : public ros::Msg\n' % self.name)
         f.write('  {\n')
         f.write('    public:\n')
         self._write_data(f)
+        self._write_sizes(f)
         self._write_constructor(f)
         self._write_serializer(f)
         self._write_deserializer(f)
+        self._write_serialized_length(f)
         self._write_getType(f)
         self._write_getMD5(f)
         f.write('\n')
+        self._write_view(f)
+        f.write('\n')
         f.write('  };\n')
 
     def make_header(self, f):
@@ -462,7 +941,7 @@ class Service:
         f.write('namespace %s\n' % self.package)
         f.write('{\n')
         f.write('\n')
-        f.write('static const char %s[] = "%s/%s";\n'%(self.name.upper(), self.package, self.name))
+        f.write('static const char %s[] %s= "%s/%s";\n'%(self.name.upper(), 'ROSSERIAL_PROGMEM ' if FLASH_STRINGS else '', self.package, self.name))
 
         def write_type(out, name):
             out.write('    const char * getType(){ return %s; };\n'%(name))
@@ -490,7 +969,9 @@ class Service:
 #####################################################################
 # Make a Library
 
-def MakeLibrary(package, output_path, rospack):
+def MakeLibrary(package, output_path, rospack, wanted=None):
+    """ Generates the package's messages and services, or only those named in
+        wanted, if given, as package/Type. """
     pkg_dir = rospack.get_path(package)
 
     # find the messages in this package
@@ -500,7 +981,7 @@ def MakeLibrary(package, output_path, rospack):
         sys.stdout.write('  Messages:')
         sys.stdout.write('\n    ')
         for f in os.listdir(pkg_dir+"/msg"):
-            if f.endswith(".msg"):
+            if f.endswith(".msg") and (wanted == None or package+"/"+f[0:-4] in wanted):
                 msg_file = pkg_dir + "/msg/" + f
                 # add to list of messages
                 print('%s,'%f[0:-4], end='')
@@ -522,7 +1003,7 @@ def MakeLibrary(package, output_path, rospack):
         sys.stdout.write('  Services:')
         sys.stdout.write('\n    ')
         for f in os.listdir(pkg_dir+"/srv"):
-            if f.endswith(".srv"):
+            if f.endswith(".srv") and (wanted == None or package+"/"+f[0:-4] in wanted):
                 srv_file = pkg_dir + "/srv/" + f
                 # add to list of messages
                 print('%s,'%f[0:-4], end='')
@@ -543,26 +1024,298 @@ def MakeLibrary(package, output_path, rospack):
     # generate for each message
     output_path = output_path + "/" + package
     for msg in messages:
-        if not os.path.exists(output_path):
-            os.makedirs(output_path)
-        header = open(output_path + "/" + msg.name + ".h", "w")
+        header = StringIO()
         msg.make_header(header)
-        header.close()
-
-def rosserial_generate(rospack, path, mapping):
+        write_if_changed(output_path + "/" + msg.name + ".h", header.getvalue())
+
+def write_if_changed(filename, data):
+    """ Writes a generated file, leaving it alone if it already says the same,
+        so that its mtime doesn't set off a rebuild of everything using it. """
+    if not isinstance(data, bytes):
+        data = data.encode('utf-8')
+    if os.path.exists(filename):
+        with open(filename, "rb") as f:
+            if f.read() == data:
+                return
+    elif not os.path.exists(os.path.dirname(filename)):
+        os.makedirs(os.path.dirname(filename))
+    with open(filename, "wb") as f:
+        f.write(data)
+
+def copy_if_changed(src, dst):
+    """ Copies a file as write_if_changed() writes one. """
+    with open(src, "rb") as f:
+        write_if_changed(dst, f.read())
+    shutil.copymode(src, dst)
+
+def rosserial_copy_tree(src, dst):
+    """ Copies a platform's ros_lib files into the library, as shutil.copytree
+        does, but into a library already there too, touching only what has
+        changed. """
+    for root, dirs, files in os.walk(src):
+        for f in files:
+            copy_if_changed(os.path.join(root, f), os.path.join(dst, os.path.relpath(root, src), f))
+
+# the types ros_lib itself uses
+LIBRARY_TYPES = ['rosserial_msgs/Log', 'rosserial_msgs/RequestParam', 'rosserial_msgs/TopicInfo',
+                 'std_msgs/Time', 'tf/tfMessage']
+
+def find_type(rospack, name):
+    """ The definition file of a message or service, such as std_msgs/String,
+        or None if there's no such type. """
+    try:
+        package, type_name = name.split("/")
+        pkg_dir = rospack.get_path(package)
+    except Exception:
+        return None
+    for kind in ["msg", "srv"]:
+        filename = "%s/%s/%s.%s" % (pkg_dir, kind, type_name, kind)
+        if os.path.exists(filename):
+            return filename
+    return None
+
+def type_closure(rospack, roots):
+    """ The messages and services in roots, with every message their fields are
+        made of, and so on, as package/Type. """
+    wanted = set()
+    todo = list(roots)
+    while todo:
+        name = todo.pop()
+        if name in wanted:
+            continue
+        filename = find_type(rospack, name)
+        if filename == None:
+            continue
+        wanted.add(name)
+        package, type_name = name.split("/")
+        definition = open(filename).readlines()
+        if filename.endswith(".srv"):
+            srv = Service(type_name, package, definition, None, None)
+            todo.extend(srv.req.includes + srv.resp.includes)
+        else:
+            todo.extend(Message(type_name, package, definition, None).includes)
+    return wanted
+
+# bytes in RAM of the types fields are stored as, for estimate_footprint
+C_TYPE_BYTES = {
+    'bool' : 1, 'int8_t' : 1, 'uint8_t' : 1, 'int16_t' : 2, 'uint16_t' : 2,
+    'int32_t' : 4, 'uint32_t' : 4, 'int64_t' : 8, 'uint64_t' : 8,
+    'float' : 4, 'double' : 8, 'ros::Time' : 8, 'ros::Duration' : 8,
+}
+
+def estimate_footprint(rospack, msg, pointer_bytes, known):
+    """ The bytes a parsed Message takes in RAM, and how many of those are the
+        st_ copies its arrays' elements are deserialized into, as (total,
+        temporaries), added up from its fields and those of the messages they
+        are, without the compiler's padding. known holds the nested messages
+        done already, by package/Type. """
+    def element(d):
+        cls = d.cls if isinstance(d, ArrayDataType) else d.__class__
+        if cls is MessageDataType:
+            name = d.type.replace("::", "/")
+            if name not in known:
+                known[name] = (0, 0)    # a type made of itself would never end
+                filename = find_type(rospack, name)
+                if filename != None:
+                    package, type_name = name.split("/")
+                    nested = Message(type_name, package, open(filename).readlines(), None)
+                    known[name] = estimate_footprint(rospack, nested, pointer_bytes, known)
+            return known[name]
+        if cls is StringDataType:
+            return (pointer_bytes, 0)
+        return (C_TYPE_BYTES.get(d.type, getattr(d, 'bytes', 0)), 0)
+    total = 0
+    temporaries = 0
+    for d in msg.data:
+        size, nested = element(d)
+        if not isinstance(d, ArrayDataType):
+            total += size
+            temporaries += nested
+        elif d.size != None:
+            total += d.size * size
+            temporaries += d.size * nested
+        else:
+            # length, st_ copy, pointer and any storage given by a capacity
+            total += 4 + size + pointer_bytes + (d.capacity or 0) * size
+            temporaries += size + (d.capacity or 0) * nested
+    return (total, temporaries)
+
+def write_footprint(rospack, names, pointer_bytes, filename):
+    """ Writes a summary of the RAM each of the messages and services in names
+        takes, largest first, for sizing buffers against a board's budget
+        before building for it. The sizes are estimates, short of sizeof() by
+        any padding; each generated message's sizeof() and TEMPORARIES_SIZE
+        are the exact figures, for static_assert()s. """
+    known = dict()
+    rows = list()
+    for name in sorted(names):
+        definition = find_type(rospack, name)
+        if definition == None:
+            continue
+        package, type_name = name.split("/")
+        if definition.endswith(".srv"):
+            srv = Service(type_name, package, open(definition).readlines(), None, None)
+            parts = [(name + "Request", srv.req), (name + "Response", srv.resp)]
+        else:
+            parts = [(name, Message(type_name, package, open(definition).readlines(), None))]
+        for part, msg in parts:
+            rows.append((part,) + estimate_footprint(rospack, msg, pointer_bytes, known))
+    rows.sort(key=lambda row: -row[1])
+    report = StringIO()
+    report.write('# RAM per message in bytes, with %d-byte pointers, not counting padding\n' % pointer_bytes)
+    report.write('# %-54s %8s %12s\n' % ('type', 'total', 'temporaries'))
+    for name, total, temporaries in rows:
+        report.write('  %-54s %8d %12d\n' % (name, total, temporaries))
+    write_if_changed(filename, report.getvalue())
+
+def scan_includes(paths):
+    """ The package/Type headers included by the C and C++ sources in paths,
+        which may be files or directories to search, for generating only the
+        types a firmware uses. Includes which aren't messages are left for
+        type_closure() to drop. """
+    include = re.compile(r'#\s*include\s*[<"]([A-Za-z0-9_]+/[A-Za-z0-9_]+)\.h[>"]')
+    sources = ('.c', '.cc', '.cpp', '.cxx', '.h', '.hh', '.hpp', '.ino', '.pde')
+    files = list()
+    for path in paths:
+        if os.path.isdir(path):
+            for root, dirs, names in os.walk(path):
+                files += [os.path.join(root, n) for n in names if n.endswith(sources)]
+        else:
+            files.append(path)
+    types = set()
+    for filename in files:
+        types.update(include.findall(open(filename).read()))
+    return types
+
+def load_array_capacities(filename):
+    """ Reads the capacities to give variable-length arrays, from a YAML file
+        listing the maximum number of elements per field of each message:
+
+          sensor_msgs/LaserScan:
+            ranges: 360
+            intensities: 0
+
+        Messages and services which aren't listed keep allocating their arrays
+        on the heap. Service requests and responses are listed as, for example,
+        rosserial_msgs/RequestParamResponse. """
+    import yaml
+    capacities = yaml.safe_load(open(filename))
+    if capacities is None:
+        return dict()
+    for msg, fields in capacities.items():
+        for field, capacity in fields.items():
+            if not isinstance(capacity, int) or capacity < 0:
+                raise Exception("Bad array capacity for %s/%s: %s" % (msg, field, capacity))
+    return capacities
+
+def load_quantization(filename):
+    """ Reads the float fields to send as fixed point, from a YAML file giving
+        each one's scale, offset (default 0) and size in bits, 8, 16 or 32:
+
+          sensor_msgs/BatteryState:
+            voltage: {scale: 0.001, bits: 16}
+            temperature: {scale: 0.5, offset: -40, bits: 8}
+
+        Such a field is sent as (value - offset) / scale, rounded and clamped
+        to a signed integer, with the least integer standing for NaN. The
+        server and serial_node must be given the same file, as their
+        ~quantization parameter, to convert them back. """
+    import yaml
+    quantization = yaml.safe_load(open(filename))
+    if quantization is None:
+        return dict()
+    for msg, fields in quantization.items():
+        for field, q in fields.items():
+            if not isinstance(q, dict) or q.get('bits') not in (8, 16, 32) or not q.get('scale'):
+                raise Exception("Bad quantization for %s/%s: %s" % (msg, field, q))
+    return quantization
+
+def make_package(package):
+    """ Generates a package's messages with the settings rosserial_generate made,
+        giving back what was printed meanwhile, and the error if it failed. """
+    stdout = sys.stdout
+    sys.stdout = StringIO()
+    error = None
+    try:
+        MakeLibrary(package, GENERATE_PATH, GENERATE_ROSPACK, GENERATE_WANTED)
+    except Exception as e:
+        error = str(e)
+        print('[%s]: Unable to build messages: %s\n' % (package, error))
+        print(traceback.format_exc())
+    output = sys.stdout.getvalue()
+    sys.stdout = stdout
+    return package, output, error
+
+def rosserial_generate(rospack, path, mapping, array_capacities=None, flash_strings=False, jobs=None, roots=None, quantization=None,
+                       footprint=None, pointer_bytes=None, shared_serializers=None):
     # horrible hack -- make this die
     global ROS_TO_EMBEDDED_TYPES
     ROS_TO_EMBEDDED_TYPES = mapping
 
-    # gimme messages
+    # on AVR, keep each message's type and MD5 sum in flash rather than RAM;
+    # see ros/flash_string.h
+    global FLASH_STRINGS
+    FLASH_STRINGS = flash_strings
+
+    # have fields of 2, 4 and 8 bytes serialized by calls to the functions in
+    # ros::Msg rather than byte by byte in each message, for smaller code on
+    # targets short of flash; also by setting ROSSERIAL_SHARED_SERIALIZERS
+    global SHARED_SERIALIZERS
+    if shared_serializers == None:
+        shared_serializers = os.environ.get('ROSSERIAL_SHARED_SERIALIZERS', '') not in ('', '0')
+    SHARED_SERIALIZERS = shared_serializers
+
+    # arrays can also be given fixed storage without changing each platform's
+    # make_libraries, by pointing ROSSERIAL_ARRAY_CAPACITIES at the YAML file
+    global ARRAY_CAPACITIES
+    if array_capacities == None and os.environ.get('ROSSERIAL_ARRAY_CAPACITIES'):
+        array_capacities = load_array_capacities(os.environ['ROSSERIAL_ARRAY_CAPACITIES'])
+    ARRAY_CAPACITIES = array_capacities or dict()
+
+    # and float fields sent as fixed point, by ROSSERIAL_QUANTIZATION
+    global QUANTIZATION
+    if quantization == None and os.environ.get('ROSSERIAL_QUANTIZATION'):
+        quantization = load_quantization(os.environ['ROSSERIAL_QUANTIZATION'])
+    QUANTIZATION = quantization or dict()
+
+    # only generate the types in roots, and those they're made of, if given;
+    # likewise ROSSERIAL_MESSAGES lists types, and ROSSERIAL_SOURCES the
+    # firmware sources whose includes say which are used, separated by spaces
+    global GENERATE_WANTED
+    GENERATE_WANTED = None
+    scanned = list()
+    if roots == None and (os.environ.get('ROSSERIAL_MESSAGES') or os.environ.get('ROSSERIAL_SOURCES')):
+        roots = os.environ.get('ROSSERIAL_MESSAGES', '').split()
+        scanned = list(scan_includes(os.environ.get('ROSSERIAL_SOURCES', '').split()))
+    if roots != None:
+        for name in roots:
+            if find_type(rospack, name) == None:
+                print('*** Warning, no such message or service: %s ***' % name)
+        GENERATE_WANTED = type_closure(rospack, list(roots) + scanned + LIBRARY_TYPES)
+        print('Generating %d messages and services\n' % len(GENERATE_WANTED))
+
+    # gimme messages, several packages at a time if ROSSERIAL_GENERATE_JOBS
+    # asks for it; the workers are forked once the settings above are made
+    global GENERATE_ROSPACK, GENERATE_PATH
+    GENERATE_ROSPACK = rospack
+    GENERATE_PATH = path
+    if jobs == None:
+        jobs = int(os.environ.get('ROSSERIAL_GENERATE_JOBS', 1))
+    packages = sorted(rospack.list())
+    if GENERATE_WANTED != None:
+        packages = [p for p in packages if p in set(n.split("/")[0] for n in GENERATE_WANTED)]
+    if jobs > 1:
+        pool = multiprocessing.Pool(jobs)
+        results = pool.map(make_package, packages)
+        pool.close()
+        pool.join()
+    else:
+        results = map(make_package, packages)
     failed = []
-    for p in sorted(rospack.list()):
-        try:
-            MakeLibrary(p, path, rospack)
-        except Exception as e:
-            failed.append(p + " ("+str(e)+")")
-            print('[%s]: Unable to build messages: %s\n' % (p, str(e)))
-            print(traceback.format_exc())
+    for p, output, error in results:
+        sys.stdout.write(output)
+        if error:
+            failed.append(p + " ("+error+")")
     print('\n')
     if len(failed) > 0:
         print('*** Warning, failed to generate libraries for the following packages: ***')
@@ -571,12 +1324,45 @@ def rosserial_generate(rospack, path, mapping):
         raise Exception("Failed to generate libraries for: " + str(failed))
     print('\n')
 
+    # and a summary of the RAM each type takes, if ROSSERIAL_FOOTPRINT names
+    # a file for it; ROSSERIAL_POINTER_BYTES is 2 on AVR
+    if footprint == None:
+        footprint = os.environ.get('ROSSERIAL_FOOTPRINT')
+    if footprint:
+        if pointer_bytes == None:
+            pointer_bytes = int(os.environ.get('ROSSERIAL_POINTER_BYTES', 4))
+        names = GENERATE_WANTED
+        if names == None:
+            names = list()
+            for p in packages:
+                for kind in ["msg", "srv"]:
+                    d = "%s/%s" % (rospack.get_path(p), kind)
+                    if os.path.isdir(d):
+                        names += [p + "/" + f[0:-4] for f in os.listdir(d) if f.endswith("." + kind)]
+        write_footprint(rospack, names, pointer_bytes, footprint)
+        print('Footprint summary written to %s\n' % footprint)
+
 def rosserial_client_copy_files(rospack, path):
-    os.makedirs(path+"/ros")
-    os.makedirs(path+"/tf")
     files = ['duration.cpp',
              'time.cpp',
+             'ros/bonded_hardware.h',
+             'ros/clock_sync.h',
+             'ros/deferred_log.h',
+             'ros/delta_encoder.h',
              'ros/duration.h',
+             'ros/flash_string.h',
+             'ros/hardware_async_write.h',
+             'ros/hardware_baud.h',
+             'ros/hardware_clock.h',
+             'ros/hardware_flush.h',
+             'ros/hardware_lock.h',
+             'ros/hardware_multicast.h',
+             'ros/hardware_reader.h',
+             'ros/link_stats.h',
+             'ros/link_stats_diagnostics.h',
+             'ros/lz4_compressor.h',
+             'ros/message_view.h',
+             'ros/message_writer.h',
              'ros/msg.h',
              'ros/node_handle.h',
              'ros/publisher.h',
@@ -584,9 +1370,10 @@ def rosserial_client_copy_files(rospack, path):
              'ros/service_server.h',
              'ros/subscriber.h',
              'ros/time.h',
+             'ros/tx_queue.h',
              'tf/tf.h',
              'tf/transform_broadcaster.h']
     mydir = rospack.get_path("rosserial_client")
     for f in files:
-        shutil.copy(mydir+"/src/ros_lib/"+f, path+f)
+        copy_if_changed(mydir+"/src/ros_lib/"+f, path+f)
 
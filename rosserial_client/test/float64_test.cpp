@@ -38,6 +38,40 @@ TEST_F(TestFloat64, testRoundTrip)
 }
 
 
+TEST_F(TestFloat64, testArrayRoundTrip)
+{
+  float floats[num_cases];
+  for (int i = 0; i < num_cases; i++)
+    floats[i] = cases[i];
+
+  unsigned char array[8 * num_cases];
+  EXPECT_EQ(8 * num_cases, ros::Msg::serializeAvrFloat64Array(array, floats, num_cases));
+  for (int i = 0; i < num_cases; i++)
+  {
+    memcpy(buffer, array + 8 * i, sizeof(buffer));
+    EXPECT_FLOAT_EQ(cases[i], val);
+  }
+
+  float ret[num_cases];
+  EXPECT_EQ(8 * num_cases, ros::Msg::deserializeAvrFloat64Array(array, ret, num_cases));
+  for (int i = 0; i < num_cases; i++)
+    EXPECT_FLOAT_EQ(cases[i], ret[i]);
+}
+
+
+TEST_F(TestFloat64, testOutOfRange)
+{
+  float ret = 1;
+  val = 1e-300;
+  ros::Msg::deserializeAvrFloat64(buffer, &ret);
+  EXPECT_EQ(0.0f, ret);
+
+  val = -1e300;
+  ros::Msg::deserializeAvrFloat64(buffer, &ret);
+  EXPECT_LT(ret, -3.4e38f);
+}
+
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -49,6 +49,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
+#include <poll.h>
 #include <assert.h>
 
 #define DEFAULT_PORTNUM 11411
@@ -189,16 +190,53 @@ int elCommRead(int fd)
   return rv;
 }
 
+int elCommReadBytes(int fd, uint8_t* data, int length)
+{
+  int rv;
+  rv = read(fd, data, length); // read as many bytes as are waiting, up to length
+  if (rv < 0)
+  {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      perror("elCommReadBytes() error:");
+  }
+
+  // return the number of bytes read, or -1 or 0 if we read nothing
+  return rv;
+}
+
+int elCommWait(int fd, int timeout_ms)
+{
+  struct pollfd pfd;
+  int rv;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  rv = poll(&pfd, 1, timeout_ms); // sleep until there is something to read
+  if (rv < 0 && errno != EINTR)
+    perror("elCommWait() error:");
+
+  // return 1 if the fd is readable, 0 on timeout
+  return rv > 0;
+}
+
 int elCommWrite(int fd, uint8_t* data, int len)
 {
   int rv;
   int length = len;
   int totalsent = 0;
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
   while (totalsent < length)
   {
-    rv = write(fd, data + totalsent, length);
+    rv = write(fd, data + totalsent, length - totalsent);
     if (rv < 0)
-      perror("write(): error writing - trying again - ");
+    {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        poll(&pfd, 1, -1); // wait for room in the output buffer rather than spinning
+      else if (errno != EINTR)
+        perror("write(): error writing - trying again - ");
+    }
     else
       totalsent += rv;
   }
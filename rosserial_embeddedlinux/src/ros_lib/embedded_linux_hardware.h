@@ -40,6 +40,8 @@
 #ifdef BUILD_LIBROSSERIALEMBEDDEDLINUX
 extern "C" int elCommInit(char *portName, int baud);
 extern "C" int elCommRead(int fd);
+extern "C" int elCommReadBytes(int fd, uint8_t* data, int length);
+extern "C" int elCommWait(int fd, int timeout_ms);
 extern "C" elCommWrite(int fd, uint8_t* data, int length);
 #endif
 
@@ -63,6 +65,8 @@ public:
   {
     strncpy(portName, pn, 30);
     baud_ = baud;
+    timeout_ = 0;
+    rx_head_ = rx_tail_ = 0;
   }
 
   EmbeddedLinuxHardware()
@@ -74,6 +78,8 @@ public:
       strncpy(portName, envPortName, 29);
     portName[29] = '\0'; // in case user gave us too long a port name
     baud_ = 57600;
+    timeout_ = 0;
+    rx_head_ = rx_tail_ = 0;
   }
 
   void setBaud(long baud)
@@ -86,6 +92,17 @@ public:
     return baud_;
   }
 
+  /**
+   * Sets how long, in milliseconds, read() may sleep in poll() waiting for
+   * data when none is buffered. The default of 0 never blocks, which leaves
+   * a loop around spinOnce() spinning flat out; a few milliseconds lets the
+   * process sleep between messages at the cost of that much added latency.
+   */
+  void setTimeout(int timeout_ms)
+  {
+    timeout_ = timeout_ms;
+  }
+
   void init()
   {
     fd = elCommInit(portName, baud_);
@@ -114,8 +131,27 @@ public:
 
   int read()
   {
-    int c = elCommRead(fd);
-    return c;
+    // Hand back buffered bytes one at a time, refilling the buffer with one
+    // large read() once it has been drained.
+    if (rx_head_ == rx_tail_ && fill() <= 0)
+      return -1;
+    return rx_buffer_[rx_head_++];
+  }
+
+  int read(uint8_t* data, int length)
+  {
+    if (rx_head_ == rx_tail_)
+    {
+      if (!wait())
+        return -1;
+      return elCommReadBytes(fd, data, length);
+    }
+    int count = rx_tail_ - rx_head_;
+    if (count > length)
+      count = length;
+    memcpy(data, rx_buffer_ + rx_head_, count);
+    rx_head_ += count;
+    return count;
   }
 
   void write(uint8_t* data, int length)
@@ -142,6 +178,13 @@ public:
     return ((seconds) * 1000 + nseconds / 1000000.0) + 0.5;
   }
 
+  unsigned long time_us()
+  {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1000000UL + (end.tv_nsec - start.tv_nsec) / 1000;
+  }
+
 #elif __MACH__
   void initTime()
   {
@@ -155,12 +198,38 @@ public:
     uint64_t elapsed = mach_absolute_time() - start;
     return elapsed * sTimebaseInfo.numer / (sTimebaseInfo.denom * 1000000);
   }
+
+  unsigned long time_us()
+  {
+    uint64_t elapsed = mach_absolute_time() - start;
+    return elapsed * sTimebaseInfo.numer / (sTimebaseInfo.denom * 1000);
+  }
 #endif
 
 protected:
+  bool wait()
+  {
+    return timeout_ <= 0 || elCommWait(fd, timeout_);
+  }
+
+  int fill()
+  {
+    if (!wait())
+      return 0;
+    int rv = elCommReadBytes(fd, rx_buffer_, sizeof(rx_buffer_));
+    rx_head_ = 0;
+    rx_tail_ = rv > 0 ? rv : 0;
+    return rv;
+  }
+
   int fd;
   char portName[30];
   long baud_;
+  int timeout_;
+
+  uint8_t rx_buffer_[512];
+  int rx_head_;
+  int rx_tail_;
 
 #ifdef __linux__
   struct timespec start;
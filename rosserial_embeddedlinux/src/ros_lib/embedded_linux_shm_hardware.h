@@ -0,0 +1,319 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROS_EMBEDDED_LINUX_SHM_HARDWARE_H_
+#define ROS_EMBEDDED_LINUX_SHM_HARDWARE_H_
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "embedded_linux_hardware.h"
+
+#define DEFAULT_SHM_SOCKET "/tmp/rosserial_shm"
+
+/*
+ * The memory shared with rosserial_server's shm_node, laid out as its ShmHeader
+ * and ShmCursor are, in rosserial_server/shm_stream.h, where the rings and the
+ * handshake around waking each other are described; the two must agree.
+ */
+struct EmbeddedLinuxShmCursor
+{
+  volatile uint32_t value;
+  uint8_t padding[60];
+};
+
+struct EmbeddedLinuxShmHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint8_t padding[52];
+  EmbeddedLinuxShmCursor to_server_head;
+  EmbeddedLinuxShmCursor to_server_tail;
+  EmbeddedLinuxShmCursor to_client_head;
+  EmbeddedLinuxShmCursor to_client_tail;
+  EmbeddedLinuxShmCursor client_waiting;
+  EmbeddedLinuxShmCursor server_waiting;
+};
+
+/*
+ * Talks to a rosserial_server shm_node on the same host through rings in shared
+ * memory rather than a serial port or socket, so that frames cost a copy each
+ * way and, while traffic keeps both sides busy, no system calls at all. The Unix
+ * socket the node listens on is named to the constructor, or by ROSSERIAL_SHM,
+ * and is only used to receive the memory and the eventfds which wake either
+ * side; it is held open so that the node sees when this process goes away.
+ *
+ *   ros::NodeHandle_<EmbeddedLinuxShmHardware> nh;
+ *
+ * setTimeout() bounds how long read() sleeps for data, as for the serial port.
+ */
+class EmbeddedLinuxShmHardware : public EmbeddedLinuxHardware
+{
+public:
+  EmbeddedLinuxShmHardware(const char *socket_path)
+  {
+    setup(socket_path);
+  }
+
+  EmbeddedLinuxShmHardware()
+  {
+    const char *envSocket = getenv("ROSSERIAL_SHM");
+    setup(envSocket != NULL ? envSocket : DEFAULT_SHM_SOCKET);
+  }
+
+  ~EmbeddedLinuxShmHardware()
+  {
+    // Closing the socket is what tells the server we've gone.
+    if (header_ != NULL)
+      munmap(header_, sizeof(EmbeddedLinuxShmHeader) + 2 * header_->capacity);
+    if (socket_fd_ >= 0)
+      close(socket_fd_);
+    if (server_wake_fd_ >= 0)
+      close(server_wake_fd_);
+    if (client_wake_fd_ >= 0)
+      close(client_wake_fd_);
+  }
+
+  void init()
+  {
+    if (!connectShm())
+    {
+      std::cout << "Exiting" << std::endl;
+      exit(-1);
+    }
+    std::cout << "EmbeddedLinuxShmHardware.h: mapped shared memory successfully\n";
+
+    initTime();
+  }
+
+  void init(const char *socket_path)
+  {
+    setup(socket_path);
+    init();
+  }
+
+  int read()
+  {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int read(uint8_t* data, int length)
+  {
+    int count = readRing(data, length);
+    if (count == 0 && timeout_ > 0)
+      count = waitFor(&EmbeddedLinuxShmHardware::readRing, data, length, timeout_);
+    if (count > 0)
+      wakeServer();
+    return count > 0 ? count : -1;
+  }
+
+  void write(uint8_t* data, int length)
+  {
+    while (length > 0)
+    {
+      int count = writeRing(data, length);
+      // The server is behind; wait for it to make room, but not forever, as it
+      // may have gone.
+      if (count == 0 && (count = waitFor(&EmbeddedLinuxShmHardware::writeRing, data, length, 1000)) == 0)
+        return;
+      wakeServer();
+      data += count;
+      length -= count;
+    }
+  }
+
+protected:
+  void setup(const char *socket_path)
+  {
+    strncpy(socketPath, socket_path, sizeof(socketPath) - 1);
+    socketPath[sizeof(socketPath) - 1] = '\0';
+    header_ = NULL;
+    socket_fd_ = server_wake_fd_ = client_wake_fd_ = -1;
+  }
+
+  bool connectShm()
+  {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    socket_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd_ < 0 || connect(socket_fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+      std::cout << "Unable to connect to " << socketPath << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    // One byte, carrying the shared memory and the server's and our eventfds.
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg;
+    if (recvmsg(socket_fd_, &msg, MSG_CMSG_CLOEXEC) != 1 || (cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+        cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    {
+      std::cout << "No shared memory from " << socketPath << std::endl;
+      return false;
+    }
+    int fds[3];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    server_wake_fd_ = fds[1];
+    client_wake_fd_ = fds[2];
+
+    struct stat st;
+    void *mapping = MAP_FAILED;
+    if (fstat(fds[0], &st) == 0 && st.st_size >= (off_t)sizeof(EmbeddedLinuxShmHeader))
+      mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (mapping == MAP_FAILED)
+    {
+      std::cout << "Unable to map shared memory: " << strerror(errno) << std::endl;
+      return false;
+    }
+    header_ = (EmbeddedLinuxShmHeader*)mapping;
+    if (header_->magic != 0x4d485352 || header_->version != 1 ||
+        (off_t)(sizeof(EmbeddedLinuxShmHeader) + 2 * header_->capacity) > st.st_size)
+    {
+      std::cout << "Shared memory from " << socketPath << " is not one this client understands" << std::endl;
+      return false;
+    }
+    to_server_ = (uint8_t*)(header_ + 1);
+    to_client_ = to_server_ + header_->capacity;
+    return true;
+  }
+
+  int readRing(uint8_t* data, int length)
+  {
+    uint32_t head = header_->to_client_head.value;
+    __sync_synchronize();
+    uint32_t tail = header_->to_client_tail.value;
+    uint32_t capacity = header_->capacity;
+    uint32_t count = head - tail;
+    if (count > (uint32_t)length)
+      count = length;
+    uint32_t start = tail & (capacity - 1);
+    uint32_t first = count < capacity - start ? count : capacity - start;
+    memcpy(data, to_client_ + start, first);
+    memcpy(data + first, to_client_, count - first);
+    __sync_synchronize();
+    header_->to_client_tail.value = tail + count;
+    return count;
+  }
+
+  int writeRing(uint8_t* data, int length)
+  {
+    uint32_t tail = header_->to_server_tail.value;
+    __sync_synchronize();
+    uint32_t head = header_->to_server_head.value;
+    uint32_t capacity = header_->capacity;
+    uint32_t count = capacity - (head - tail);
+    if (count > (uint32_t)length)
+      count = length;
+    uint32_t start = head & (capacity - 1);
+    uint32_t first = count < capacity - start ? count : capacity - start;
+    memcpy(to_server_ + start, data, first);
+    memcpy(to_server_, data + first, count - first);
+    __sync_synchronize();
+    header_->to_server_head.value = head + count;
+    return count;
+  }
+
+  void wakeServer()
+  {
+    __sync_synchronize();
+    if (header_->server_waiting.value)
+    {
+      header_->server_waiting.value = 0;
+      uint64_t one = 1;
+      if (::write(server_wake_fd_, &one, sizeof(one)) < 0)
+        return;
+    }
+  }
+
+  /*
+   * Retries a ring operation each time the server wakes us, until it moves
+   * something or timeout_ms passes. A wakeup may be left over from an earlier
+   * wait which was satisfied without sleeping, so one isn't taken to mean there
+   * is anything to do.
+   */
+  int waitFor(int (EmbeddedLinuxShmHardware::*op)(uint8_t*, int), uint8_t* data, int length, int timeout_ms)
+  {
+    unsigned long deadline = time() + timeout_ms;
+    while (true)
+    {
+      header_->client_waiting.value = 1;
+      __sync_synchronize();
+      int count = (this->*op)(data, length);
+      long remaining = (long)(deadline - time());
+      if (count > 0 || remaining <= 0)
+      {
+        header_->client_waiting.value = 0;
+        return count;
+      }
+      struct pollfd pfd = { client_wake_fd_, POLLIN, 0 };
+      if (poll(&pfd, 1, remaining) > 0)
+      {
+        uint64_t wakeups;
+        if (::read(client_wake_fd_, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN)
+          return 0;
+      }
+    }
+  }
+
+  char socketPath[108];
+  EmbeddedLinuxShmHeader *header_;
+  uint8_t *to_server_;
+  uint8_t *to_client_;
+  int socket_fd_;
+  int server_wake_fd_;
+  int client_wake_fd_;
+};
+
+#endif
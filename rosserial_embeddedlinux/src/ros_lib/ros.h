@@ -43,10 +43,17 @@
 
 #include "ros/node_handle.h"
 #include "embedded_linux_hardware.h"
+#ifdef __linux__
+#include "embedded_linux_shm_hardware.h"
+#endif
 
 namespace ros
 {
 typedef NodeHandle_<EmbeddedLinuxHardware> NodeHandle;
+#ifdef __linux__
+// For a client on the same host as rosserial_server's shm_node.
+typedef NodeHandle_<EmbeddedLinuxShmHardware> ShmNodeHandle;
+#endif
 }
 
 #endif
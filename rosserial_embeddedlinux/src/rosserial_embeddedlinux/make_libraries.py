@@ -84,9 +84,9 @@ rospack = rospkg.RosPack()
 
 # copy ros_lib stuff in
 rosserial_arduino_dir = rospack.get_path(THIS_PACKAGE)
-shutil.copytree(rosserial_arduino_dir+"/src/ros_lib", path+"/ros_lib")
+rosserial_copy_tree(rosserial_arduino_dir+"/src/ros_lib", path+"/ros_lib")
 rosserial_client_copy_files(rospack, path+"/ros_lib/")
-shutil.copytree(rosserial_arduino_dir+"/src/examples", path+"/examples")
+rosserial_copy_tree(rosserial_arduino_dir+"/src/examples", path+"/examples")
 
 # generate messages
 rosserial_generate(rospack, path+"/ros_lib", ROS_TO_EMBEDDED_TYPES)
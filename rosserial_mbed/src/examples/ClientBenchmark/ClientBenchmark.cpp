@@ -0,0 +1,122 @@
+/*
+ * rosserial Client Benchmark
+ *
+ * Measures what spinOnce() costs per byte received, and what publish() costs
+ * per message, for messages of the sizes rosrun rosserial_client
+ * client_benchmark sends. The driver streams std_msgs/UInt8MultiArray
+ * messages of a size to benchmark/downlink, then sends the size on
+ * benchmark/command; the program then publishes messages of that size on
+ * benchmark/uplink, timing each, and reports on benchmark/result:
+ *
+ *   [size, ticks per second, CPU Hz, bytes received, ticks spinning on them,
+ *    messages published, ticks publishing, most ticks for one publish]
+ *
+ * Ticks are CPU cycles from the DWT cycle counter on cores which have one
+ * (Cortex-M3 and up), and microseconds otherwise.
+ */
+#define ROSSERIAL_LINK_STATS
+#include "mbed.h"
+#include <ros.h>
+#include <std_msgs/UInt16.h>
+#include <std_msgs/UInt8MultiArray.h>
+#include <std_msgs/UInt32MultiArray.h>
+
+#define MAX_SIZE 512
+#define PUBLISH_COUNT 50
+
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+static void startTicks() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+static uint32_t ticks() { return DWT->CYCCNT; }
+static uint32_t ticksPerSecond() { return SystemCoreClock; }
+#else
+Timer timer;
+static void startTicks() { timer.start(); }
+static uint32_t ticks() { return timer.read_us(); }
+static uint32_t ticksPerSecond() { return 1000000UL; }
+#endif
+
+ros::NodeHandle nh;
+
+uint8_t payload[MAX_SIZE];
+std_msgs::UInt8MultiArray uplink_msg;
+ros::Publisher uplink_pub("benchmark/uplink", &uplink_msg);
+
+uint32_t result[8];
+std_msgs::UInt32MultiArray result_msg;
+ros::Publisher result_pub("benchmark/result", &result_msg);
+
+uint16_t run_size = 0;
+bool run_pending = false;
+uint32_t spin_bytes = 0;
+uint32_t spin_ticks = 0;
+
+void commandCb(const std_msgs::UInt16& msg) {
+    run_size = msg.data < MAX_SIZE ? msg.data : MAX_SIZE;
+    run_pending = true;
+}
+
+void downlinkCb(const std_msgs::UInt8MultiArray& msg) {
+}
+
+ros::Subscriber<std_msgs::UInt16> command_sub("benchmark/command", commandCb);
+ros::Subscriber<std_msgs::UInt8MultiArray> downlink_sub("benchmark/downlink", downlinkCb);
+
+void run() {
+    uplink_msg.data = payload;
+    uplink_msg.data_length = run_size;
+    uint32_t total = 0, most = 0;
+    for (int i = 0; i < PUBLISH_COUNT; i++) {
+        payload[0] = i;
+        uint32_t start = ticks();
+        uplink_pub.publish(&uplink_msg);
+        uint32_t taken = ticks() - start;
+        total += taken;
+        if (taken > most)
+            most = taken;
+    }
+
+    result[0] = run_size;
+    result[1] = ticksPerSecond();
+    result[2] = SystemCoreClock;
+    result[3] = spin_bytes;
+    result[4] = spin_ticks;
+    result[5] = PUBLISH_COUNT;
+    result[6] = total;
+    result[7] = most;
+    result_msg.data = result;
+    result_msg.data_length = 8;
+    result_pub.publish(&result_msg);
+    spin_bytes = 0;
+    spin_ticks = 0;
+}
+
+int main() {
+    startTicks();
+    nh.initNode();
+    nh.advertise(uplink_pub);
+    nh.advertise(result_pub);
+    nh.subscribe(command_sub);
+    nh.subscribe(downlink_sub);
+
+    while (1) {
+        // Only spins which took bytes in count towards the cost per byte.
+        uint32_t bytes = nh.getLinkStats().rx_bytes;
+        uint32_t start = ticks();
+        nh.spinOnce();
+        uint32_t taken = ticks() - start;
+        bytes = nh.getLinkStats().rx_bytes - bytes;
+        if (bytes > 0) {
+            spin_bytes += bytes;
+            spin_ticks += taken;
+        }
+
+        if (run_pending) {
+            run_pending = false;
+            run();
+        }
+    }
+}
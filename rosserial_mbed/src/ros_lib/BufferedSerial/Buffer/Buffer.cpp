@@ -26,8 +26,13 @@
 template <class T>
 Buffer<T>::Buffer(uint32_t size)
 {
-    _buf = new T [size];
-    _size = size;
+    // a power of two size lets the indexes wrap with a mask
+    _size = 1;
+    while (_size < size) {
+        _size <<= 1;
+    }
+    _mask = _size - 1;
+    _buf = new T [_size];
     clear();
     
     return;
@@ -65,10 +65,11 @@ private:
     volatile uint32_t   _wloc;
     volatile uint32_t   _rloc;
     uint32_t            _size;
+    uint32_t            _mask;
 
 public:
     /** Create a Buffer and allocate memory for it
-     *  @param size The size of the buffer
+     *  @param size The size of the buffer, rounded up to a power of two
      */
     Buffer(uint32_t size = 0x100);
     
@@ -91,6 +92,25 @@ public:
      */
     T get(void);
     
+    /** Add several data elements into the buffer
+     *  @param data The elements to add to the buffer
+     *  @param length How many elements to add, at most getSize()-1
+     *  @return The number of elements added
+     */
+    uint32_t put(const T *data, uint32_t length);
+    
+    /** Remove several data elements from the buffer
+     *  @param data Where to copy the oldest elements in the buffer to
+     *  @param length The most elements to remove
+     *  @return The number of elements removed
+     */
+    uint32_t get(T *data, uint32_t length);
+    
+    /** Determine how much is readable in the buffer
+     *  @return The number of elements that can be read
+     */
+    uint32_t count(void);
+    
     /** Get the address to the head of the buffer
      *  @return The address of element 0 in the buffer
      */
@@ -130,8 +150,8 @@ public:
 template <class T>
 inline void Buffer<T>::put(T data)
 {
-    _buf[_wloc++] = data;
-    _wloc %= (_size-1);
+    _buf[_wloc] = data;
+    _wloc = (_wloc + 1) & _mask;
     
     return;
 }
@@ -139,12 +159,54 @@ inline void Buffer<T>::put(T data)
 template <class T>
 inline T Buffer<T>::get(void)
 {
-    T data_pos = _buf[_rloc++];
-    _rloc %= (_size-1);
+    T data_pos = _buf[_rloc];
+    _rloc = (_rloc + 1) & _mask;
     
     return data_pos;
 }
 
+template <class T>
+inline uint32_t Buffer<T>::put(const T *data, uint32_t length)
+{
+    if (length > _mask) {
+        length = _mask;
+    }
+    // copy in at most two pieces, around the end of the buffer
+    uint32_t first = _size - _wloc;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&_buf[_wloc], data, first * sizeof(T));
+    memcpy(&_buf[0], data + first, (length - first) * sizeof(T));
+    _wloc = (_wloc + length) & _mask;
+    
+    return length;
+}
+
+template <class T>
+inline uint32_t Buffer<T>::get(T *data, uint32_t length)
+{
+    uint32_t n = count();
+    if (length > n) {
+        length = n;
+    }
+    uint32_t first = _size - _rloc;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(data, &_buf[_rloc], first * sizeof(T));
+    memcpy(data + first, &_buf[0], (length - first) * sizeof(T));
+    _rloc = (_rloc + length) & _mask;
+    
+    return length;
+}
+
+template <class T>
+inline uint32_t Buffer<T>::count(void)
+{
+    return (_wloc - _rloc) & _mask;
+}
+
 template <class T>
 inline T *Buffer<T>::head(void)
 {
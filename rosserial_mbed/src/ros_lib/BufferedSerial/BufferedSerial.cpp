@@ -29,6 +29,11 @@ BufferedSerial::BufferedSerial(PinName tx, PinName rx, uint32_t buf_size, uint32
     RawSerial::attach(this, &BufferedSerial::rxIrq, Serial::RxIrq);
     this->_buf_size = buf_size;
     this->_tx_multiple = tx_multiple;   
+#ifdef BUFFEREDSERIAL_DMA
+    _tx_dma = new uint8_t [buf_size];
+    _tx_dma_busy = false;
+    RawSerial::set_dma_usage_tx(DMA_USAGE_ALWAYS);
+#endif
     return;
 }
 
@@ -36,6 +41,10 @@ BufferedSerial::~BufferedSerial(void)
 {
     RawSerial::attach(NULL, RawSerial::RxIrq);
     RawSerial::attach(NULL, RawSerial::TxIrq);
+#ifdef BUFFEREDSERIAL_DMA
+    RawSerial::abort_write();
+    delete [] _tx_dma;
+#endif
 
     return;
 }
@@ -105,9 +114,11 @@ ssize_t BufferedSerial::write(const void *s, size_t length)
     if (s != NULL && length > 0) {
         const char* ptr = (const char*)s;
         const char* end = ptr + length;
+        uint32_t max = _txbuf.getSize() - 1;
     
         while (ptr != end) {
-            _txbuf = *(ptr++);
+            uint32_t n = (end - ptr < max) ? end - ptr : max;
+            ptr += _txbuf.put(ptr, n);
         }
         BufferedSerial::prime();
     
@@ -116,11 +127,20 @@ ssize_t BufferedSerial::write(const void *s, size_t length)
     return 0;
 }
 
+ssize_t BufferedSerial::read(void *s, size_t length)
+{
+    if (s != NULL && length > 0) {
+        return _rxbuf.get((char*)s, length);
+    }
+    return 0;
+}
+
 
 void BufferedSerial::rxIrq(void)
 {
-    // read from the peripheral and make sure something is available
-    if(serial_readable(&_serial)) {
+    // read from the peripheral while something is available, so that a
+    // hardware fifo is emptied in one interrupt
+    while(serial_readable(&_serial)) {
         _rxbuf = serial_getc(&_serial); // if so load them into a buffer
     }
 
@@ -143,6 +163,40 @@ void BufferedSerial::txIrq(void)
     return;
 }
 
+#ifdef BUFFEREDSERIAL_DMA
+void BufferedSerial::txDmaStart(void)
+{
+    // hand the oldest part of the software fifo to the peripheral in one go
+    int length = _txbuf.get((char*)_tx_dma, _buf_size);
+    if (length > 0) {
+        _tx_dma_busy = true;
+        RawSerial::write(_tx_dma, length, callback(this, &BufferedSerial::txDmaDone));
+    } else {
+        _tx_dma_busy = false;
+    }
+
+    return;
+}
+
+void BufferedSerial::txDmaDone(int events)
+{
+    BufferedSerial::txDmaStart();
+
+    return;
+}
+
+void BufferedSerial::prime(void)
+{
+    // if already busy then the completion callback will pick this up
+    core_util_critical_section_enter();
+    if (!_tx_dma_busy) {
+        BufferedSerial::txDmaStart();
+    }
+    core_util_critical_section_exit();
+
+    return;
+}
+#else
 void BufferedSerial::prime(void)
 {
     // if already busy then the irq will pick this up
@@ -154,5 +208,5 @@ void BufferedSerial::prime(void)
 
     return;
 }
-
+#endif
 
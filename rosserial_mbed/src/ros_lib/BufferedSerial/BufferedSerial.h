@@ -27,6 +27,12 @@
 #include "mbed.h"
 #include "Buffer.h"
 
+// Define BUFFEREDSERIAL_DMA to send through the asynchronous serial API,
+// which uses DMA on targets that support it, instead of the TX interrupt.
+#if defined(BUFFEREDSERIAL_DMA) && !DEVICE_SERIAL_ASYNCH
+#error "BUFFEREDSERIAL_DMA needs a target with DEVICE_SERIAL_ASYNCH"
+#endif
+
 /** A serial port (UART) for communication with other serial devices
  *
  * Can be used for Full Duplex communication, or Simplex by specifying
@@ -75,6 +81,13 @@ private:
     Buffer <char> _txbuf;
     uint32_t      _buf_size;
     uint32_t      _tx_multiple;
+#ifdef BUFFEREDSERIAL_DMA
+    uint8_t      *_tx_dma;
+    volatile bool _tx_dma_busy;
+
+    void txDmaStart(void);
+    void txDmaDone(int events);
+#endif
  
     void rxIrq(void);
     void txIrq(void);
@@ -135,6 +148,13 @@ public:
      *  @return The number of bytes written to the Serial Port Buffer
      */
     virtual ssize_t write(const void *s, std::size_t length);
+    
+    /** Read data from the Buffered Serial Port
+     *  @param s A pointer to copy received data to
+     *  @param length The most data to copy
+     *  @return The number of bytes copied, 0 if none were waiting
+     */
+    virtual ssize_t read(void *s, std::size_t length);
 };
 
 #endif
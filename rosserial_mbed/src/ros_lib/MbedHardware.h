@@ -32,6 +32,12 @@ class MbedHardware {
 
     int getBaud(){return baud_;}
 
+    // used by NodeHandle_ to switch rates with the server
+    void changeBaud(long baud){
+        baud_ = baud;
+        iostream.baud(baud_);
+    }
+
     void init(){
         iostream.baud(baud_);
     }
@@ -43,12 +49,16 @@ class MbedHardware {
             return -1;
         }
     };
+    // read up to length bytes at once, returning how many were waiting
+    int read(uint8_t* data, int length){
+        return iostream.read(data, length);
+    }
     void write(uint8_t* data, int length) {
-        for (int i=0; i<length; i++)
-             iostream.putc(data[i]);
+        iostream.write(data, length);
     }
 
     unsigned long time(){return t.read_ms();}
+    unsigned long time_us(){return t.read_us();}
 
 protected:
     BufferedSerial iostream;
@@ -39,10 +39,18 @@ up message definitions and hash strings which would not have been
 known to it at compile time, allowing it to fully advertise topics
 originating from microcontrollers.
 
-This allows rosserial_server to be distributed in binary form. """
+This allows rosserial_server to be distributed in binary form.
 
+Types listed in the ~prewarm parameter are loaded as the node starts, so
+that the first lookup of each doesn't wait on a module import; "all"
+loads every message type installed. The messages_info service answers for
+many types at once, for a server setting up many topics. """
+
+import rosmsg
+import rospkg
 import rospy
-from rosserial_msgs.srv import RequestMessageInfo
+from rosserial_msgs.srv import RequestMessageInfo, RequestMessageInfoResponse
+from rosserial_msgs.srv import RequestMessagesInfo
 from rosserial_msgs.srv import RequestServiceInfo
 from rosserial_python import load_message
 from rosserial_python import load_service
@@ -55,19 +63,49 @@ class MessageInfoService(object):
     rospy.loginfo("rosserial message_info_service node")
     self.message_cache = {}
     self.service_cache = {}
+    self._prewarm(rospy.get_param("~prewarm", []))
     self.service = rospy.Service("message_info", RequestMessageInfo, self._message_info_cb)
+    self.messagesInfoService = rospy.Service("messages_info", RequestMessagesInfo, self._messages_info_cb)
     self.serviceInfoService = rospy.Service("service_info", RequestServiceInfo, self._service_info_cb)
 
-  def _message_info_cb(self, req):
-    package_message = tuple(req.type.split("/"))
+  def _prewarm(self, types):
+    if types == "all":
+      rospack = rospkg.RosPack()
+      types = [t for package, _ in rosmsg.iterate_packages(rospack, rosmsg.MODE_MSG)
+               for t in rosmsg.list_types(package, rospack=rospack)]
+    for t in types:
+      try:
+        self._lookup(t)
+      except Exception as e:
+        rospy.logwarn("Couldn't load %s ahead of time: %s" % (t, e))
+    if types:
+      rospy.loginfo("Loaded %d message types ahead of time." % len(self.message_cache))
+
+  def _lookup(self, message_type):
+    package_message = tuple(message_type.split("/"))
     if not self.message_cache.has_key(package_message):
-      rospy.loginfo("Loading module to return info on %s/%s." % package_message)
+      rospy.logdebug("Loading module to return info on %s/%s." % package_message)
       msg = load_message(*package_message)
       self.message_cache[package_message] = (msg._md5sum, msg._full_text)
-    else:
-      rospy.loginfo("Returning info from cache on %s/%s." % package_message)
     return self.message_cache[package_message]
 
+  def _message_info_cb(self, req):
+    rospy.loginfo("Returning info on %s." % req.type)
+    return RequestMessageInfoResponse(*self._lookup(req.type))
+
+  def _messages_info_cb(self, req):
+    rospy.loginfo("Returning info on %d message types." % len(req.types))
+    md5s, definitions = [], []
+    for t in req.types:
+      try:
+        md5, definition = self._lookup(t)
+      except Exception as e:
+        rospy.logwarn("Couldn't load %s: %s" % (t, e))
+        md5, definition = "", ""
+      md5s.append(md5)
+      definitions.append(definition)
+    return md5s, definitions
+
   def _service_info_cb(self, req):
     rospy.logdebug("req.service is %s" % req.service)
     package_service = tuple(req.service.split("/"))
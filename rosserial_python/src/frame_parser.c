@@ -0,0 +1,441 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * rosserial_python._frame_parser: splits the bytes read from a rosserial
+ * client into frames, for SerialClient, which uses it in place of its
+ * PythonFrameParser when it has been built.
+ *
+ *   parser = FrameParser()
+ *   for topic_id, msg, valid, crc16, cobs in parser.feed(data):
+ *       ...
+ *
+ * feed() takes whatever has been read, of any length, and returns the frames
+ * completed by it, keeping any partial frame for the next call. valid is
+ * whether the frame's checksum, or CRC, matched; crc16 and cobs say how the
+ * frame was sent, so that frames to the client can be sent the same way.
+ * Bytes skipped in finding frames aren't returned, but are counted in the
+ * parser's protocol_errors, header_errors and cobs_errors, for SerialClient
+ * to report.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+
+/* Frames are bytes, which are str in Python 2. */
+#if PY_MAJOR_VERSION >= 3
+#define BYTES_FORMAT "y#"
+#else
+#define BYTES_FORMAT "s#"
+#endif
+
+#define PROTOCOL_VER2 0xfe
+#define PROTOCOL_VER2_CRC16 0xfd
+
+/* Sync flag, version, length, length checksum and topic id. */
+#define HEADER_BYTES 7
+
+/* The longest COBS frame there can be, for a body of 0xffff bytes. */
+#define MAX_COBS_BYTES (0xffff + HEADER_BYTES + 2 + (0xffff + HEADER_BYTES + 2) / 254 + 1)
+
+static unsigned short crc16_table[256];
+
+static void init_crc16_table(void)
+{
+  int i, bit;
+  for (i = 0; i < 256; i++)
+  {
+    unsigned short crc = i << 8;
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    crc16_table[i] = crc;
+  }
+}
+
+/* CRC-16/CCITT-FALSE, as in SerialClient.crc16. */
+static unsigned short crc16(const unsigned char* data, Py_ssize_t length)
+{
+  unsigned short crc = 0xffff;
+  Py_ssize_t i;
+  for (i = 0; i < length; i++)
+  {
+    crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ data[i]];
+  }
+  return crc;
+}
+
+static unsigned char checksum(const unsigned char* data, Py_ssize_t length)
+{
+  unsigned int sum = 0;
+  Py_ssize_t i;
+  for (i = 0; i < length; i++)
+  {
+    sum += data[i];
+  }
+  return sum & 0xff;
+}
+
+/* Decodes COBS in place, returning the decoded length, or -1 if it's damaged. */
+static Py_ssize_t cobs_decode(unsigned char* data, Py_ssize_t length)
+{
+  Py_ssize_t in = 0, out = 0;
+  while (in < length)
+  {
+    unsigned char code = data[in];
+    if (code == 0 || in + code > length)
+    {
+      return -1;
+    }
+    memmove(data + out, data + in + 1, code - 1);
+    out += code - 1;
+    in += code;
+    if (code != 0xff && in < length)
+    {
+      data[out++] = 0;
+    }
+  }
+  return out;
+}
+
+typedef struct
+{
+  PyObject_HEAD
+  unsigned char* buffer;
+  Py_ssize_t length;
+  Py_ssize_t capacity;
+  unsigned long protocol_errors;
+  unsigned long header_errors;
+  unsigned long cobs_errors;
+} FrameParser;
+
+/*
+ * Checks a decoded frame, which starts at its sync flag and is exactly as long
+ * as its header says, and appends it to frames. Returns -1 if Python fails.
+ */
+static int append_frame(PyObject* frames, const unsigned char* frame, Py_ssize_t body_length, int cobs)
+{
+  int crc = frame[1] == PROTOCOL_VER2_CRC16;
+  const unsigned char* body = frame + HEADER_BYTES;
+  int valid;
+  PyObject* item;
+
+  if (crc)
+  {
+    valid = crc16(frame + 5, body_length + 2) == (body[body_length] | (body[body_length + 1] << 8));
+  }
+  else
+  {
+    valid = checksum(frame + 5, body_length + 3) == 0xff;
+  }
+  item = Py_BuildValue("(i" BYTES_FORMAT "NNN)", frame[5] | (frame[6] << 8), (const char*) body, body_length,
+                       PyBool_FromLong(valid), PyBool_FromLong(crc), PyBool_FromLong(cobs));
+  if (item == NULL)
+  {
+    return -1;
+  }
+  if (PyList_Append(frames, item) < 0)
+  {
+    Py_DECREF(item);
+    return -1;
+  }
+  Py_DECREF(item);
+  return 0;
+}
+
+/*
+ * Looks for one frame at pos, which is at a 0xff or a 0x00. Returns how many bytes
+ * to move on by, or zero if a frame there needs more bytes than there are yet, or
+ * -1 if Python fails.
+ */
+static Py_ssize_t parse_at(FrameParser* self, Py_ssize_t pos, PyObject* frames)
+{
+  unsigned char* data = self->buffer + pos;
+  Py_ssize_t available = self->length - pos;
+
+  if (data[0] == 0xff)
+  {
+    Py_ssize_t body_length, frame_length;
+    if (available < 2)
+    {
+      return 0;
+    }
+    if (data[1] != PROTOCOL_VER2 && data[1] != PROTOCOL_VER2_CRC16)
+    {
+      self->protocol_errors++;
+      return 1;
+    }
+    if (available < HEADER_BYTES)
+    {
+      return 0;
+    }
+    if (checksum(data + 2, 3) != 0xff)
+    {
+      self->header_errors++;
+      return 1;
+    }
+    body_length = data[2] | (data[3] << 8);
+    frame_length = HEADER_BYTES + body_length + (data[1] == PROTOCOL_VER2_CRC16 ? 2 : 1);
+    if (available < frame_length)
+    {
+      return 0;
+    }
+    return append_frame(frames, data, body_length, 0) < 0 ? -1 : frame_length;
+  }
+  else
+  {
+    /* A zero starts a COBS encoded frame where one follows; every frame starts
+     * with 0xff, so its encoding starts with a code of at least 2, then 0xff.
+     * Otherwise it's the zero closing the last one, or noise. */
+    unsigned char* end;
+    Py_ssize_t encoded_length, frame_length;
+    if (available < 3)
+    {
+      return 0;
+    }
+    if (data[1] < 2 || data[2] != 0xff)
+    {
+      return 1;
+    }
+    end = memchr(data + 1, 0, available - 1);
+    if (end == NULL)
+    {
+      if (available > MAX_COBS_BYTES)
+      {
+        self->cobs_errors++;
+        return 1;
+      }
+      return 0;
+    }
+
+    /* Decoded in place, then moved on from up to the closing zero, which is left
+     * to be skipped, or taken as the opening zero of the next frame. */
+    encoded_length = end - (data + 1);
+    frame_length = cobs_decode(data + 1, encoded_length);
+    if (frame_length < HEADER_BYTES + 1 ||
+        (data[2] != PROTOCOL_VER2 && data[2] != PROTOCOL_VER2_CRC16) ||
+        checksum(data + 3, 3) != 0xff ||
+        frame_length != HEADER_BYTES + (data[3] | (data[4] << 8)) + (data[2] == PROTOCOL_VER2_CRC16 ? 2 : 1))
+    {
+      self->cobs_errors++;
+      return 1 + encoded_length;
+    }
+    return append_frame(frames, data + 1, data[3] | (data[4] << 8), 1) < 0 ? -1 : 1 + encoded_length;
+  }
+}
+
+static PyObject* FrameParser_feed(FrameParser* self, PyObject* args)
+{
+  const char* data;
+  Py_ssize_t data_length, pos = 0;
+  PyObject* frames;
+
+  if (!PyArg_ParseTuple(args, BYTES_FORMAT ":feed", &data, &data_length))
+  {
+    return NULL;
+  }
+
+  if (self->length + data_length > self->capacity)
+  {
+    Py_ssize_t capacity = self->capacity ? self->capacity : 4096;
+    unsigned char* buffer;
+    while (capacity < self->length + data_length)
+    {
+      capacity *= 2;
+    }
+    buffer = PyMem_Realloc(self->buffer, capacity);
+    if (buffer == NULL)
+    {
+      return PyErr_NoMemory();
+    }
+    self->buffer = buffer;
+    self->capacity = capacity;
+  }
+  memcpy(self->buffer + self->length, data, data_length);
+  self->length += data_length;
+
+  frames = PyList_New(0);
+  if (frames == NULL)
+  {
+    return NULL;
+  }
+  while (pos < self->length)
+  {
+    Py_ssize_t step;
+    unsigned char* next = self->buffer + pos;
+    /* Hunt for the next sync flag, or zero. */
+    while (next < self->buffer + self->length && *next != 0xff && *next != 0)
+    {
+      next++;
+    }
+    pos = next - self->buffer;
+    if (pos == self->length)
+    {
+      break;
+    }
+    step = parse_at(self, pos, frames);
+    if (step < 0)
+    {
+      Py_DECREF(frames);
+      return NULL;
+    }
+    if (step == 0)
+    {
+      break;
+    }
+    pos += step;
+  }
+
+  memmove(self->buffer, self->buffer + pos, self->length - pos);
+  self->length -= pos;
+  return frames;
+}
+
+static PyObject* FrameParser_reset(FrameParser* self, PyObject* unused)
+{
+  self->length = 0;
+  Py_RETURN_NONE;
+}
+
+static PyObject* FrameParser_counter(unsigned long value)
+{
+  return PyLong_FromUnsignedLong(value);
+}
+
+static PyObject* FrameParser_get_protocol_errors(FrameParser* self, void* closure)
+{
+  return FrameParser_counter(self->protocol_errors);
+}
+
+static PyObject* FrameParser_get_header_errors(FrameParser* self, void* closure)
+{
+  return FrameParser_counter(self->header_errors);
+}
+
+static PyObject* FrameParser_get_cobs_errors(FrameParser* self, void* closure)
+{
+  return FrameParser_counter(self->cobs_errors);
+}
+
+static PyObject* FrameParser_get_buffered(FrameParser* self, void* closure)
+{
+  return PyLong_FromSsize_t(self->length);
+}
+
+static void FrameParser_dealloc(FrameParser* self)
+{
+  PyMem_Free(self->buffer);
+  Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static PyMethodDef FrameParser_methods[] =
+{
+  { "feed", (PyCFunction) FrameParser_feed, METH_VARARGS,
+    "feed(data) -> [(topic_id, msg, valid, crc16, cobs), ...]\n\n"
+    "Adds bytes read from the client, and returns the frames they complete." },
+  { "reset", (PyCFunction) FrameParser_reset, METH_NOARGS,
+    "Discards any partial frame." },
+  { NULL }
+};
+
+static PyGetSetDef FrameParser_getset[] =
+{
+  { "protocol_errors", (getter) FrameParser_get_protocol_errors, NULL,
+    "Sync flags followed by an unknown protocol version.", NULL },
+  { "header_errors", (getter) FrameParser_get_header_errors, NULL,
+    "Frame headers whose length checksum was wrong.", NULL },
+  { "cobs_errors", (getter) FrameParser_get_cobs_errors, NULL,
+    "COBS encoded frames which were damaged or too long.", NULL },
+  { "buffered", (getter) FrameParser_get_buffered, NULL,
+    "Bytes of a partial frame, kept for the next feed().", NULL },
+  { NULL }
+};
+
+static PyTypeObject FrameParserType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "rosserial_python._frame_parser.FrameParser",
+  sizeof(FrameParser),
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef frame_parser_module =
+{
+  PyModuleDef_HEAD_INIT, "_frame_parser", "Splits the bytes from a rosserial client into frames.", -1, NULL
+};
+#endif
+
+static PyObject* init_module(void)
+{
+  PyObject* module;
+
+  init_crc16_table();
+  FrameParserType.tp_flags = Py_TPFLAGS_DEFAULT;
+  FrameParserType.tp_doc = "Splits the bytes read from a rosserial client into frames.";
+  FrameParserType.tp_new = PyType_GenericNew;
+  FrameParserType.tp_dealloc = (destructor) FrameParser_dealloc;
+  FrameParserType.tp_methods = FrameParser_methods;
+  FrameParserType.tp_getset = FrameParser_getset;
+  if (PyType_Ready(&FrameParserType) < 0)
+  {
+    return NULL;
+  }
+
+#if PY_MAJOR_VERSION >= 3
+  module = PyModule_Create(&frame_parser_module);
+#else
+  module = Py_InitModule3("_frame_parser", NULL, "Splits the bytes from a rosserial client into frames.");
+#endif
+  if (module == NULL)
+  {
+    return NULL;
+  }
+  Py_INCREF(&FrameParserType);
+  PyModule_AddObject(module, "FrameParser", (PyObject*) &FrameParserType);
+  return module;
+}
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC PyInit__frame_parser(void)
+{
+  return init_module();
+}
+#else
+PyMODINIT_FUNC init_frame_parser(void)
+{
+  init_module();
+}
+#endif
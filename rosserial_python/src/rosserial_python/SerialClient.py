@@ -35,17 +35,19 @@
 
 __author__ = "mferguson@willowgarage.com (Michael Ferguson)"
 
+import collections
 import imp
 import threading
 import sys
 import multiprocessing
 import StringIO
 import errno
+import re
 import signal
 import socket
 import struct
 import time
-from Queue import Queue
+from Queue import Queue, Empty
 
 from serial import Serial, SerialException, SerialTimeoutException
 
@@ -57,10 +59,391 @@ from rosserial_msgs.srv import RequestParamRequest, RequestParamResponse
 
 import diagnostic_msgs.msg
 
+# The frame parser built from src/frame_parser.c, where there was a compiler
+# and the Python headers to build it with, which splits what's read into frames
+# far faster than PythonFrameParser below.
+try:
+    from rosserial_python._frame_parser import FrameParser
+except ImportError:
+    FrameParser = None
+
 ERROR_MISMATCHED_PROTOCOL = "Mismatched protocol version in packet: lost sync or rosserial_python is from different ros release than the rosserial client"
 ERROR_NO_SYNC = "no sync with device"
 ERROR_PACKET_FAILED = "Packet Failed : Failed to read msg data"
 
+# Bits in the body of the request for topics, telling the client what this
+# server can do beyond the plain protocol.
+FEATURE_BATCH = 0x01
+FEATURE_CRC16 = 0x02
+FEATURE_COBS = 0x04
+FEATURE_COMPRESSION = 0x08
+FEATURE_PARAM_BATCH = 0x20
+FEATURE_LOG_DEFERRED = 0x40
+# And in the second byte of it, which older clients ignore.
+FEATURE2_SEQUENCE = 0x01
+FEATURE2_DELTA = 0x02
+# The byte which starts each message on a delta encoded topic.
+DELTA_ENCODED = 0x80
+DELTA_KEYFRAME_MASK = 0x7f
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for bit in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xffff)
+    return table
+
+CRC16_TABLE = _crc16_table()
+
+def crc16(data, crc=0xffff):
+    """ CRC-16/CCITT-FALSE of a string, which frames marked with protocol version
+    0xfd carry over their topic id and body in place of the 8-bit checksum. """
+    for c in data:
+        crc = ((crc << 8) & 0xffff) ^ CRC16_TABLE[(crc >> 8) ^ ord(c)]
+    return crc
+
+def cobs_encode(data):
+    """ COBS encoding of a string, which has no zeros in it, so that frames sent
+    with a zero either side can be found again straight after a byte is lost. """
+    out = []
+    i = 0
+    while True:
+        zero = data.find('\x00', i, i + 254)
+        run = (zero if zero >= 0 else min(len(data), i + 254)) - i
+        out.append(chr(run + 1) + data[i:i + run])
+        i += run
+        if i == len(data):
+            break
+        if run < 254:
+            i += 1
+    return ''.join(out)
+
+def cobs_decode(data):
+    """ Decodes a COBS encoded string, returning None if it is damaged. """
+    out = []
+    i = 0
+    while i < len(data):
+        code = ord(data[i])
+        if code == 0 or i + code > len(data):
+            return None
+        out.append(data[i + 1:i + code])
+        i += code
+        if code != 0xff and i < len(data):
+            out.append('\x00')
+    return ''.join(out)
+
+def lz4_decompress(data, length):
+    """ Decodes an LZ4 block, returning None unless it makes exactly length bytes. """
+    out = bytearray()
+    i = 0
+    def read_length(i, n):
+        while True:
+            if i >= len(data):
+                raise IndexError
+            n += ord(data[i])
+            i += 1
+            if data[i - 1] != '\xff':
+                return i, n
+    try:
+        while i < len(data):
+            token = ord(data[i])
+            i += 1
+            literals = token >> 4
+            if literals == 15:
+                i, literals = read_length(i, literals)
+            if i + literals > len(data):
+                return None
+            out += data[i:i + literals]
+            i += literals
+            # the last sequence is literals only
+            if i == len(data):
+                break
+            offset = ord(data[i]) | (ord(data[i + 1]) << 8)
+            i += 2
+            match = token & 15
+            if match == 15:
+                i, match = read_length(i, match)
+            if offset == 0 or offset > len(out):
+                return None
+            # byte by byte, as a match may overlap the bytes it is producing
+            start = len(out) - offset
+            for j in range(match + 4):
+                out.append(out[start + j])
+            if len(out) > length:
+                return None
+    except IndexError:
+        return None
+    return str(out) if len(out) == length else None
+
+def delta_decode(keyframe, data, length):
+    """ Rebuilds a message from the bytes in which it differs from keyframe: runs
+    of a count of bytes the same, a count of bytes which differ, and those bytes,
+    the rest being the keyframe's. Returns None unless it makes exactly length
+    bytes. """
+    out = []
+    i = o = 0
+    while i < len(data):
+        if i + 2 > len(data):
+            return None
+        same, differ = ord(data[i]), ord(data[i + 1])
+        i += 2
+        if (same and o + same > len(keyframe)) or i + differ > len(data):
+            return None
+        out.append(keyframe[o:o + same])
+        out.append(data[i:i + differ])
+        i += differ
+        o += same + differ
+    out.append(keyframe[o:length])
+    msg = ''.join(out)
+    return msg if len(msg) == length else None
+
+_BUILTIN_SIZES = {'bool': 1, 'int8': 1, 'uint8': 1, 'byte': 1, 'char': 1, 'int16': 2, 'uint16': 2,
+                  'int32': 4, 'uint32': 4, 'float32': 4, 'int64': 8, 'uint64': 8, 'float64': 8,
+                  'time': 8, 'duration': 8}
+
+def load_quantization(param):
+    """ The float fields the device's library was generated to send as fixed
+    point, by type, from the same dictionary make_library was given; types may
+    also be given a level down, under their package, as rosparam stores them. """
+    types = {}
+    for key, fields in param.items():
+        if '/' in key:
+            types[key] = fields
+        else:
+            for name, type_fields in fields.items():
+                types[key + '/' + name] = type_fields
+    return types
+
+def quantized_layout(message, quantization):
+    """ How to convert messages of a type between their standard serialization
+    and the device's, as a list of (array, kind, argument) for each field, where
+    array is None, 0 for variable length or the length; or None if no field of it
+    or of the types it's made of is quantized. """
+    found = []
+    def fields_of(cls):
+        quantized = quantization.get(cls._type, {})
+        layout = []
+        for name, ty in zip(cls.__slots__, cls._slot_types):
+            array = None
+            if '[' in ty:
+                array = int(ty[ty.index('[') + 1:-1] or 0)
+                ty = ty[:ty.index('[')]
+            if ty in ('float32', 'float64') and name in quantized:
+                found.append(name)
+                layout.append((array, 'q', (_BUILTIN_SIZES[ty], quantized[name])))
+            elif ty in _BUILTIN_SIZES:
+                layout.append((array, 'f', _BUILTIN_SIZES[ty]))
+            elif ty == 'string':
+                layout.append((array, 's', None))
+            else:
+                package, name = ty.split('/')
+                layout.append((array, 'm', fields_of(load_message(package, name))))
+        return layout
+    layout = fields_of(message)
+    return layout if found else None
+
+def quantize(value, q):
+    """ The integer a float is sent as, as the device's serializeQuantized gives
+    it: rounded, clamped, with the least integer for NaN. """
+    top = (1 << (q['bits'] - 1)) - 1
+    scaled = (value - q.get('offset', 0)) / float(q['scale'])
+    if scaled != scaled:
+        return -top - 1
+    if scaled >= top:
+        return top
+    if scaled <= -top:
+        return -top
+    return int(scaled - 0.5 if scaled < 0 else scaled + 0.5)
+
+def unquantize(data, q):
+    n = 0
+    for i, c in enumerate(data):
+        n |= ord(c) << (8 * i)
+    if n & (1 << (q['bits'] - 1)):
+        n -= 1 << q['bits']
+    if n == -(1 << (q['bits'] - 1)):
+        return float('nan')
+    return n * q['scale'] + q.get('offset', 0)
+
+def quantize_convert(layout, data, expanding):
+    """ Converts a message as the device sends it to its standard serialization,
+    if expanding, or the other way; None if it doesn't match the layout. """
+    out = []
+    def walk(layout, i):
+        for array, kind, arg in layout:
+            count = 1
+            if array == 0:
+                count, = struct.unpack('<I', data[i:i + 4])
+                out.append(data[i:i + 4])
+                i += 4
+            elif array:
+                count = array
+            if kind == 'm' and not arg:
+                continue
+            for _ in xrange(count):
+                i = element(kind, arg, i)
+        return i
+    def element(kind, arg, i):
+        if kind == 'm':
+            return walk(arg, i)
+        if kind == 'q':
+            float_size, q = arg
+            fmt = '<f' if float_size == 4 else '<d'
+            size = q['bits'] // 8
+            if expanding:
+                if i + size > len(data):
+                    raise IndexError
+                out.append(struct.pack(fmt, unquantize(data[i:i + size], q)))
+                return i + size
+            value, = struct.unpack(fmt, data[i:i + float_size])
+            out.append(struct.pack('<i', quantize(value, q))[:size])
+            return i + float_size
+        size = arg
+        if kind == 's':
+            size = 4 + struct.unpack('<I', data[i:i + 4])[0]
+        if i + size > len(data):
+            raise IndexError
+        out.append(data[i:i + size])
+        return i + size
+    try:
+        if walk(layout, 0) != len(data):
+            return None
+    except (IndexError, struct.error):
+        return None
+    return ''.join(out)
+
+def log_id(format):
+    """ The id firmware logs a format string by, as make_log_dictionary gives it:
+    the FNV-1a hash of the string. """
+    h = 0x811c9dc5
+    for c in bytearray(format.encode('utf-8') if isinstance(format, unicode) else format):
+        h = ((h ^ c) * 0x01000193) & 0xffffffff
+    return h
+
+_LENGTH_MODIFIER = re.compile(r'%%|(%[-+ #0]*[0-9]*(?:\.[0-9]*)?)[hlLqjzt]+')
+
+def expand_log(format, args):
+    """ Format a deferred log message with the arguments the device sent, as
+    printf would, or as near as Python's % comes to it. """
+    try:
+        return _LENGTH_MODIFIER.sub(lambda m: m.group(1) or m.group(0), format) % tuple(args)
+    except (TypeError, ValueError):
+        return "%s %s" % (format, " ".join(str(a) for a in args))
+
+def readTopicInfo(data):
+    """ Deserialize a TopicInfo, allowing for clients from before it had flags,
+    which leave them off the end; any extra byte is ignored. """
+    msg = TopicInfo()
+    msg.deserialize(data + '\x00')
+    return msg
+
+class PythonFrameParser(object):
+    """
+        Splits the bytes read from a client into frames, as the native FrameParser
+        does, for where it hasn't been built. feed() takes whatever has been read
+        and returns a (topic_id, msg, valid, crc16, cobs) tuple for each frame that
+        completes, keeping any partial frame for the next call.
+    """
+
+    HEADER_BYTES = 7
+    MAX_COBS_BYTES = 0xffff + 9 + (0xffff + 9) / 254 + 1
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.protocol_errors = 0
+        self.header_errors = 0
+        self.cobs_errors = 0
+
+    @property
+    def buffered(self):
+        return len(self.buffer)
+
+    def reset(self):
+        del self.buffer[:]
+
+    def feed(self, data):
+        buf = self.buffer
+        buf.extend(data)
+        frames = []
+        pos = 0
+        # Where the next sync flag and zero are, found again only once passed.
+        next_flag = next_zero = -1
+        while pos < len(buf):
+            if 0 <= next_flag < pos or next_flag == -1:
+                next_flag = buf.find('\xff', pos)
+            if 0 <= next_zero < pos or next_zero == -1:
+                next_zero = buf.find('\x00', pos)
+            if next_flag < 0 and next_zero < 0:
+                pos = len(buf)
+                break
+            pos = min(i for i in (next_flag, next_zero) if i >= 0)
+            step = self.parseAt(pos, frames)
+            if step == 0:
+                break
+            pos += step
+        del buf[:pos]
+        return frames
+
+    def parseAt(self, pos, frames):
+        """ Looks for one frame at pos, which is at a 0xff or a 0x00, returning how
+        many bytes to move on by, or zero if it needs more bytes than there are. """
+        buf = self.buffer
+        available = len(buf) - pos
+        if buf[pos] == 0xff:
+            if available < 2:
+                return 0
+            if buf[pos + 1] not in (0xfe, 0xfd):
+                self.protocol_errors += 1
+                return 1
+            if available < self.HEADER_BYTES:
+                return 0
+            if sum(buf[pos + 2:pos + 5]) % 256 != 255:
+                self.header_errors += 1
+                return 1
+            body_length = buf[pos + 2] | (buf[pos + 3] << 8)
+            length = self.HEADER_BYTES + body_length + (2 if buf[pos + 1] == 0xfd else 1)
+            if available < length:
+                return 0
+            self.appendFrame(frames, str(buf[pos:pos + length]), False)
+            return length
+
+        # A zero starts a COBS encoded frame where one follows; every frame starts
+        # with 0xff, so its encoding starts with a code of at least 2, then 0xff.
+        # Otherwise it's the zero closing the last one, or noise.
+        if available < 3:
+            return 0
+        if buf[pos + 1] < 2 or buf[pos + 2] != 0xff:
+            return 1
+        end = buf.find('\x00', pos + 1)
+        if end < 0:
+            if available > self.MAX_COBS_BYTES:
+                self.cobs_errors += 1
+                return 1
+            return 0
+        # Moved on from up to the closing zero, which is left to be skipped, or
+        # taken as the opening zero of the next frame.
+        frame = cobs_decode(str(buf[pos + 1:end]))
+        if (frame is None or len(frame) < self.HEADER_BYTES + 1 or frame[1] not in ('\xfe', '\xfd') or
+                sum(map(ord, frame[2:5])) % 256 != 255 or
+                len(frame) != self.HEADER_BYTES + struct.unpack("<H", frame[2:4])[0] + (2 if frame[1] == '\xfd' else 1)):
+            self.cobs_errors += 1
+        else:
+            self.appendFrame(frames, frame, True)
+        return end - pos
+
+    def appendFrame(self, frames, frame, cobs):
+        crc = frame[1] == '\xfd'
+        topic_id, = struct.unpack("<H", frame[5:7])
+        if crc:
+            msg = frame[7:-2]
+            valid = crc16(frame[5:-2]) == struct.unpack("<H", frame[-2:])[0]
+        else:
+            msg = frame[7:-1]
+            valid = sum(bytearray(frame[5:])) % 256 == 255
+        frames.append((topic_id, msg, valid, crc, cobs))
+
 def load_pkg_module(package, directory):
     #check if its in the python path
     path = sys.path
@@ -89,26 +472,43 @@ def load_service(package,service):
     mres = getattr(s, service+"Response")
     return srv,mreq,mres
 
+_raw_messages = dict()
+
+def raw_message(message):
+    """ A message class standing in for message, under its type, md5sum and
+    definition, which carries the serialized message in _buff as it is, so
+    that it can be passed on without being deserialized and serialized again. """
+    if message not in _raw_messages:
+        _raw_messages[message] = type('Raw' + message.__name__, (rospy.AnyMsg,), {
+            '_type': message._type, '_md5sum': message._md5sum, '_full_text': message._full_text})
+    return _raw_messages[message]
+
 class Publisher:
     """
         Publisher forwards messages from the serial device to ROS.
     """
-    def __init__(self, topic_info):
-        """ Create a new publisher. """
+    def __init__(self, topic_info, passthrough=False):
+        """ Create a new publisher. With passthrough, messages are published as
+        the device serialized them. """
         self.topic = topic_info.topic_name
 
         # find message type
         package, message = topic_info.message_type.split('/')
         self.message = load_message(package, message)
         if self.message._md5sum == topic_info.md5sum:
-            self.publisher = rospy.Publisher(self.topic, self.message, queue_size=10)
+            self.raw = raw_message(self.message) if passthrough else None
+            self.publisher = rospy.Publisher(self.topic, self.raw or self.message, queue_size=10)
         else:
             raise Exception('Checksum does not match: ' + self.message._md5sum + ',' + topic_info.md5sum)
 
     def handlePacket(self, data):
         """ Forward message to ROS network. """
-        m = self.message()
-        m.deserialize(data)
+        if self.raw:
+            m = self.raw()
+            m._buff = data
+        else:
+            m = self.message()
+            m.deserialize(data)
         self.publisher.publish(m)
 
 
@@ -117,22 +517,53 @@ class Subscriber:
         Subscriber forwards messages from ROS to the serial device.
     """
 
-    def __init__(self, topic_info, parent):
+    def __init__(self, topic_info, parent, passthrough=False):
+        """ Create a new subscriber. With passthrough, messages are sent on as
+        they arrived, serialized, from their publishers. """
         self.topic = topic_info.topic_name
         self.id = topic_info.topic_id
         self.parent = parent
+        # The number of the next message sent, if the client counts those lost.
+        self.sequence = 0 if topic_info.flags & TopicInfo.FLAG_SEQUENCED else None
+        # The latest message, kept to send again when the device syncs anew.
+        self.last = None
 
         # find message type
         package, message = topic_info.message_type.split('/')
         self.message = load_message(package, message)
         if self.message._md5sum == topic_info.md5sum:
-            self.subscriber = rospy.Subscriber(self.topic, self.message, self.callback)
+            self.raw = raw_message(self.message) if passthrough else None
+            # how to pack the quantized fields of its type, if it has any
+            self.layout = quantized_layout(self.message, parent.quantization) if parent.quantization else None
+            self.subscriber = rospy.Subscriber(self.topic, self.raw or self.message, self.callback)
         else:
             raise Exception('Checksum does not match: ' + self.message._md5sum + ',' + topic_info.md5sum)
 
     def callback(self, msg):
         """ Forward message to serial device. """
+        self.last = msg
+        prefix = ''
+        if self.sequence is not None:
+            prefix = chr(self.sequence)
+            self.sequence = (self.sequence + 1) & 0xff
+        if self.layout:
+            if self.raw:
+                data = msg._buff
+            else:
+                data_buffer = StringIO.StringIO()
+                msg.serialize(data_buffer)
+                data = data_buffer.getvalue()
+            data = quantize_convert(self.layout, data, False)
+            if data is None:
+                rospy.logwarn("Dropping a message for %s which doesn't match its type" % self.topic)
+                return
+            self.parent.send(self.id, prefix + data)
+            return
+        if self.raw:
+            self.parent.send(self.id, prefix + msg._buff)
+            return
         data_buffer = StringIO.StringIO()
+        data_buffer.write(prefix)
         msg.serialize(data_buffer)
         self.parent.send(self.id, data_buffer.getvalue())
 
@@ -156,30 +587,77 @@ class ServiceServer:
         self.mreq = getattr(s, service+"Request")
         self.mres = getattr(s, service+"Response")
         srv = getattr(s, service)
-        self.service = rospy.Service(self.topic, srv, self.callback)
 
-        # response message
-        self.data = None
+        # Requests waiting on a response, oldest first, which the device answers
+        # in the order they were sent.
+        self.pending = collections.deque()
+        self.pending_lock = threading.Lock()
+        self.service = rospy.Service(self.topic, srv, self.callback)
 
     def unregister(self):
         rospy.loginfo("Removing service: %s", self.topic)
         self.service.shutdown()
 
     def callback(self, req):
-        """ Forward request to serial device. """
+        """ Forward request to serial device, and wait for its response. Each
+        call runs in a thread of its own, so several can be outstanding. """
         data_buffer = StringIO.StringIO()
         req.serialize(data_buffer)
-        self.response = None
-        if self.parent.send(self.id, data_buffer.getvalue()) >= 0:
-            while self.response is None:
-                pass
-        return self.response
+        data = data_buffer.getvalue()
+        if self.parent.buffer_in > 0 and len(data) > self.parent.buffer_in:
+            raise rospy.ServiceException("Request is larger than the device's buffer")
+
+        pending = PendingRequest()
+        # Queued and sent together, so that requests are answered in this order.
+        with self.pending_lock:
+            self.pending.append(pending)
+            self.parent.send(self.id, data)
+        # Python 2 polls in waiting with a timeout, so the wait has none, and a timer
+        # ends it instead.
+        timer = threading.Timer(self.parent.service_timeout, pending.timeout)
+        timer.daemon = True
+        timer.start()
+        pending.done.wait()
+        timer.cancel()
+        if pending.timed_out:
+            # Left in place, so that a late response is matched to it and dropped.
+            raise rospy.ServiceException("No response from the device to %s within %g s" %
+                                         (self.topic, self.parent.service_timeout))
+        if pending.response is None:
+            raise rospy.ServiceException("The device was reset before responding to %s" % self.topic)
+        return pending.response
 
     def handlePacket(self, data):
         """ Forward response to ROS network. """
         r = self.mres()
         r.deserialize(data)
-        self.response = r
+        with self.pending_lock:
+            if not self.pending:
+                rospy.logwarn("Response on %s with no request waiting for it" % self.topic)
+                return
+            pending = self.pending.popleft()
+        pending.response = r
+        pending.done.set()
+
+    def reset(self):
+        """ Give up on the requests waiting, whose responses won't come now. """
+        with self.pending_lock:
+            while self.pending:
+                self.pending.popleft().done.set()
+
+
+class PendingRequest(object):
+    """ A request to a device's service server, waiting for its response. """
+
+    def __init__(self):
+        self.done = threading.Event()
+        self.response = None
+        self.timed_out = False
+
+    def timeout(self):
+        if self.response is None and not self.done.is_set():
+            self.timed_out = True
+            self.done.set()
 
 
 class ServiceClient:
@@ -224,6 +702,7 @@ class RosSerialServer:
         print "Fork_server is: ", fork_server
         self.tcp_portnum = tcp_portnum
         self.fork_server = fork_server
+        self.read_timeout = 1.0
 
     def listen(self):
         self.serversocket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
@@ -239,6 +718,11 @@ class RosSerialServer:
 
             #now do something with the clientsocket
             rospy.loginfo("Established a socket connection from %s on port %s" % (address))
+            # Frames are small, and shouldn't wait to be coalesced with the next ones.
+            clientsocket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            # Reads give up after a while, as a serial port's do, so that the run
+            # loop can notice a client which has gone quiet.
+            clientsocket.settimeout(self.read_timeout)
             self.socket = clientsocket
             self.isConnected = True
 
@@ -299,15 +783,18 @@ class RosSerialServer:
             return self.msg
 
         while len(self.msg) < rqsted_length:
-            chunk = self.socket.recv(rqsted_length - len(self.msg))
+            try:
+                chunk = self.socket.recv(rqsted_length - len(self.msg))
+            except socket.timeout:
+                return self.msg
             if chunk == '':
                 raise RuntimeError("RosSerialServer.read() socket connection broken")
             self.msg = self.msg + chunk
         return self.msg
 
     def inWaiting(self):
-        try: # the caller checks just for <1, so we'll peek at just one byte
-            chunk = self.socket.recv(1, socket.MSG_DONTWAIT|socket.MSG_PEEK)
+        try: # peek at what's there, so that it can all be read at once
+            chunk = self.socket.recv(4096, socket.MSG_DONTWAIT|socket.MSG_PEEK)
             if chunk == '':
                 raise RuntimeError("RosSerialServer.inWaiting() socket connection broken")
             return len(chunk)
@@ -321,13 +808,15 @@ class SerialClient(object):
         ServiceServer responds to requests from the serial device.
     """
 
-    def __init__(self, port=None, baud=57600, timeout=5.0, fix_pyserial_for_test=False):
-        """ Initialize node, connect to bus, attempt to negotiate topics. """
+    def __init__(self, port=None, baud=57600, timeout=5.0, fix_pyserial_for_test=False, write_queue=None):
+        """ Initialize node, connect to bus, attempt to negotiate topics. What is
+        to be written goes on write_queue, if given, for the caller to write with
+        framesFor() and _write(); otherwise run() writes it from a thread of its own. """
 
         self.read_lock = threading.RLock()
 
         self.write_lock = threading.RLock()
-        self.write_queue = Queue()
+        self.write_queue = write_queue if write_queue is not None else Queue()
         self.write_thread = None
 
         self.lastsync = rospy.Time(0)
@@ -336,6 +825,34 @@ class SerialClient(object):
         self.last_read = rospy.Time(0)
         self.last_write = rospy.Time(0)
         self.timeout = timeout
+        # How long a ROS service call waits for the device's service server to respond.
+        self.service_timeout = rospy.get_param('~service_timeout', 10.0)
+        # Format strings of deferred log messages, by the id the device sends.
+        self.log_formats = dict((log_id(f), f) for f in rospy.get_param('~log_dictionary', {}).values())
+        # Whether messages are passed between the device and ROS as they were
+        # serialized, rather than deserialized and serialized again on the way.
+        self.passthrough = rospy.get_param('~passthrough', True)
+        # Whether the client is asked to number the messages on its topics, and
+        # the messages sent to it are numbered, so that those lost are counted.
+        self.sequence_numbers = rospy.get_param('~sequence_numbers', False)
+        # Of the topics the client numbers, by id: the number expected next, and
+        # counts of the messages lost and reordered.
+        self.sequences = {}
+        # Of the topics the client delta encodes, by id: the number of the last
+        # keyframe, and its bytes.
+        self.keyframes = {}
+        # Float fields the device's library sends as fixed point, by type.
+        self.quantization = load_quantization(rospy.get_param('~quantization', {}))
+        # Topics the device publishes whose messages, where they start with a
+        # Header and the device left its stamp zero, are stamped with when they
+        # arrived, less their time on the link and ~receive_stamp_latency more;
+        # so a device which needs only coarse stamps can leave them to us.
+        self.receive_stamp_topics = set(rospy.resolve_name(t) for t in rospy.get_param('~receive_stamp_topics', []))
+        self.receive_stamp_latency = rospy.get_param('~receive_stamp_latency', 0.0)
+        # Topics the device subscribes to whose latest message is sent to it as
+        # soon as it sets up its subscriber again, so that a device which has
+        # reset has its configuration or mode without waiting on the next publish.
+        self.replay_last_topics = set(rospy.resolve_name(t) for t in rospy.get_param('~replay_last_topics', []))
         self.synced = False
         self.fix_pyserial_for_test = fix_pyserial_for_test
 
@@ -371,6 +888,13 @@ class SerialClient(object):
         self.protocol_ver1 = '\xff'
         self.protocol_ver2 = '\xfe'
         self.protocol_ver = self.protocol_ver2
+        # Frames from the client marked with this version end in a CRC-16 rather than
+        # a checksum. Once the client has sent one, frames to it are sent the same way.
+        self.protocol_ver2_crc16 = '\xfd'
+        self.client_crc16 = False
+        # Likewise, once the client has sent a COBS encoded frame, frames to it are
+        # encoded too.
+        self.client_cobs = False
 
         self.publishers = dict()  # id:Publishers
         self.subscribers = dict() # topic:Subscriber
@@ -392,6 +916,9 @@ class SerialClient(object):
         self.callbacks[TopicInfo.ID_PARAMETER_REQUEST] = self.handleParameterRequest
         self.callbacks[TopicInfo.ID_LOG] = self.handleLoggingRequest
         self.callbacks[TopicInfo.ID_TIME] = self.handleTimeRequest
+        self.callbacks[TopicInfo.ID_BATCH] = self.handleBatch
+        self.callbacks[TopicInfo.ID_PARAMETER_BATCH] = self.handleParameterBatch
+        self.callbacks[TopicInfo.ID_LOG_DEFERRED] = self.handleDeferredLog
 
         rospy.sleep(2.0)
         self.requestTopics()
@@ -399,6 +926,12 @@ class SerialClient(object):
 
         signal.signal(signal.SIGINT, self.txStopRequest)
 
+        if FrameParser is not None:
+            rospy.loginfo("Reading frames through the native frame parser.")
+            self.frame_parser = FrameParser()
+        else:
+            self.frame_parser = PythonFrameParser()
+
     def requestTopics(self):
         """ Determine topics to subscribe/publish. """
         rospy.loginfo('Requesting topics...')
@@ -408,8 +941,20 @@ class SerialClient(object):
             with self.read_lock:
                 self.port.flushInput()
 
-        # request topic sync
-        self.write_queue.put("\xff" + self.protocol_ver + "\x00\x00\xff\x00\x00\xff")
+        # request topic sync, saying that several messages may be packed into one
+        # frame, and that frames may carry a CRC; older clients ignore the body.
+        # Until the client answers with a CRC frame, it may be one which can't
+        # take them, so frames go out with a checksum, and unencoded, meanwhile.
+        self.client_crc16 = False
+        self.client_cobs = False
+        for srv in self.services.values():
+            if isinstance(srv, ServiceServer):
+                srv.reset()
+        features = [FEATURE_BATCH | FEATURE_CRC16 | FEATURE_COBS | FEATURE_COMPRESSION | FEATURE_PARAM_BATCH |
+                    FEATURE_LOG_DEFERRED,
+                    FEATURE2_DELTA | (FEATURE2_SEQUENCE if self.sequence_numbers else 0)]
+        self.write_queue.put("\xff" + self.protocol_ver + chr(len(features)) + "\x00" + chr(255 - len(features)) +
+                             "\x00\x00" + ''.join(chr(f) for f in features) + chr(255 - sum(features) % 256))
 
     def txStopRequest(self, signal, frame):
         """ send stop tx request to arduino when receive SIGINT(Ctrl-c)"""
@@ -423,26 +968,6 @@ class SerialClient(object):
         rospy.loginfo("Send tx stop request")
         sys.exit(0)
 
-    def tryRead(self, length):
-        try:
-            read_start = time.time()
-            bytes_remaining = length
-            result = bytearray()
-            while bytes_remaining != 0 and time.time() - read_start < self.timeout:
-                with self.read_lock:
-                    received = self.port.read(bytes_remaining)
-                if len(received) != 0:
-                    self.last_read = rospy.Time.now()
-                    result.extend(received)
-                    bytes_remaining -= len(received)
-
-            if bytes_remaining != 0:
-                raise IOError("Returned short (expected %d bytes, received %d instead)." % (length, length - bytes_remaining))
-
-            return bytes(result)
-        except Exception as e:
-            raise IOError("Serial Port read failure: %s" % e)
-
     def run(self):
         """ Forward recieved messages to appropriate publisher. """
 
@@ -453,108 +978,82 @@ class SerialClient(object):
             self.write_thread.start()
 
         # Handle reading.
-        data = ''
-        read_step = None
         while not rospy.is_shutdown():
-            if (rospy.Time.now() - self.lastsync).to_sec() > (self.timeout * 3):
-                if self.synced:
-                    rospy.logerr("Lost sync with device, restarting...")
-                else:
-                    rospy.logerr("Unable to sync with device; possible link problem or link software version mismatch such as hydro rosserial_python with groovy Arduino")
-                self.lastsync_lost = rospy.Time.now()
-                self.sendDiagnostics(diagnostic_msgs.msg.DiagnosticStatus.ERROR, ERROR_NO_SYNC)
-                self.requestTopics()
-                self.lastsync = rospy.Time.now()
+            self.checkSync()
 
-            # This try-block is here because we make multiple calls to read(). Any one of them can throw
-            # an IOError if there's a serial problem or timeout. In that scenario, a single handler at the
-            # bottom attempts to reconfigure the topics.
+            # A single handler here for any serial problem or timeout in reading
+            # attempts to reconfigure the topics.
             try:
-                with self.read_lock:
-                    if self.port.inWaiting() < 1:
-                        time.sleep(0.001)
-                        continue
-
-                # Find sync flag.
-                flag = [0, 0]
-                read_step = 'syncflag'
-                flag[0] = self.tryRead(1)
-                if (flag[0] != '\xff'):
-                    continue
-
-                # Find protocol version.
-                read_step = 'protocol'
-                flag[1] = self.tryRead(1)
-                if flag[1] != self.protocol_ver:
-                    self.sendDiagnostics(diagnostic_msgs.msg.DiagnosticStatus.ERROR, ERROR_MISMATCHED_PROTOCOL)
-                    rospy.logerr("Mismatched protocol version in packet (%s): lost sync or rosserial_python is from different ros release than the rosserial client" % repr(flag[1]))
-                    protocol_ver_msgs = {'\xff': 'Rev 0 (rosserial 0.4 and earlier)', '\xfe': 'Rev 1 (rosserial 0.5+)', '\xfd': 'Some future rosserial version'}
-                    if flag[1] in protocol_ver_msgs:
-                        found_ver_msg = 'Protocol version of client is ' + protocol_ver_msgs[flag[1]]
-                    else:
-                        found_ver_msg = "Protocol version of client is unrecognized"
-                    rospy.loginfo("%s, expected %s" % (found_ver_msg, protocol_ver_msgs[self.protocol_ver]))
-                    continue
-
-                # Read message length.
-                read_step = 'message length'
-                msg_len_bytes = self.tryRead(2)
-                msg_length, = struct.unpack("<h", msg_len_bytes)
-
-                # Read message length checksum.
-                read_step = 'message length checksum'
-                msg_len_chk = self.tryRead(1)
-                msg_len_checksum = sum(map(ord, msg_len_bytes)) + ord(msg_len_chk)
-
-                # Validate message length checksum.
-                if msg_len_checksum % 256 != 255:
-                    rospy.loginfo("wrong checksum for msg length, length %d" %(msg_length))
-                    rospy.loginfo("chk is %d" % ord(msg_len_chk))
-                    continue
-
-                # Read topic id (2 bytes)
-                read_step = 'topic id'
-                topic_id_header = self.tryRead(2)
-                topic_id, = struct.unpack("<h", topic_id_header)
-
-                # Read serialized message data.
-                read_step = 'data'
-                try:
-                    msg = self.tryRead(msg_length)
-                except IOError:
-                    self.sendDiagnostics(diagnostic_msgs.msg.DiagnosticStatus.ERROR, ERROR_PACKET_FAILED)
-                    rospy.loginfo("Packet Failed :  Failed to read msg data")
-                    rospy.loginfo("expected msg length is %d", msg_length)
-                    raise
-
-                # Reada checksum for topic id and msg
-                read_step = 'data checksum'
-                chk = self.tryRead(1)
-                checksum = sum(map(ord, topic_id_header) ) + sum(map(ord, msg)) + ord(chk)
-
-                # Validate checksum.
-                if checksum % 256 == 255:
-                    self.synced = True
-                    self.lastsync_success = rospy.Time.now()
-                    try:
-                        self.callbacks[topic_id](msg)
-                    except KeyError:
-                        rospy.logerr("Tried to publish before configured, topic id %d" % topic_id)
-                        self.requestTopics()
-                    rospy.sleep(0.001)
-                else:
-                    rospy.loginfo("wrong checksum for topic id and msg")
+                self.readFrames()
 
             except IOError as exc:
-                rospy.logwarn('Last read step: %s' % read_step)
                 rospy.logwarn('Run loop error: %s' % exc)
-                # One of the read calls had an issue. Just to be safe, request that the client
-                # reinitialize their topics.
+                # Just to be safe, request that the client reinitialize their topics.
                 with self.read_lock:
                     self.port.flushInput()
                 with self.write_lock:
                     self.port.flushOutput()
+                self.frame_parser.reset()
+                self.requestTopics()
+
+    def checkSync(self):
+        """ Ask for the topics again if the device hasn't synced for a while. """
+        if (rospy.Time.now() - self.lastsync).to_sec() > (self.timeout * 3):
+            if self.synced:
+                rospy.logerr("Lost sync with device, restarting...")
+            else:
+                rospy.logerr("Unable to sync with device; possible link problem or link software version mismatch such as hydro rosserial_python with groovy Arduino")
+            self.lastsync_lost = rospy.Time.now()
+            self.sendDiagnostics(diagnostic_msgs.msg.DiagnosticStatus.ERROR, ERROR_NO_SYNC)
+            self.requestTopics()
+            self.lastsync = rospy.Time.now()
+
+    def readFrames(self):
+        """ Read everything waiting, or wait up to the port's timeout for the next
+        byte, and hand on each frame that completes. """
+        try:
+            with self.read_lock:
+                data = self.port.read(self.port.inWaiting() or 1)
+        except Exception as e:
+            raise IOError("Serial Port read failure: %s" % e)
+        if len(data) == 0:
+            return
+        self.feed(data)
+
+    def feed(self, data):
+        """ Hand on each frame completed by data read from the device, for those
+        reading the device some other way than through run(). """
+        self.last_read = rospy.Time.now()
+        protocol_errors = self.frame_parser.protocol_errors
+        for topic_id, msg, valid, crc, cobs in self.frame_parser.feed(data):
+            if valid:
+                self.noteFrameFormat(crc, cobs)
+            self.handleFrame(topic_id, msg, valid)
+        if self.frame_parser.protocol_errors != protocol_errors:
+            self.sendDiagnostics(diagnostic_msgs.msg.DiagnosticStatus.ERROR, ERROR_MISMATCHED_PROTOCOL)
+            rospy.logerr("Mismatched protocol version in packet: lost sync or rosserial_python is from different ros release than the rosserial client")
+
+    def noteFrameFormat(self, crc, cobs):
+        """ Send frames to the client the way it sends them, once it's sent a good one. """
+        if crc and not self.client_crc16:
+            rospy.loginfo("Client sends CRC-16 frames; doing the same.")
+            self.client_crc16 = True
+        if cobs and not self.client_cobs:
+            rospy.loginfo("Client sends COBS frames; doing the same.")
+            self.client_cobs = True
+
+    def handleFrame(self, topic_id, msg, valid):
+        """ Hand on the body of a frame whose checksum, or CRC, has been checked. """
+        if valid:
+            self.synced = True
+            self.lastsync_success = rospy.Time.now()
+            try:
+                self.callbacks[topic_id](msg)
+            except KeyError:
+                rospy.logerr("Tried to publish before configured, topic id %d" % topic_id)
                 self.requestTopics()
+        else:
+            rospy.loginfo("wrong checksum for topic id and msg")
 
     def setPublishSize(self, bytes):
         if self.buffer_out < 0:
@@ -569,11 +1068,33 @@ class SerialClient(object):
     def setupPublisher(self, data):
         """ Register a new publisher. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
-            pub = Publisher(msg)
+            msg = readTopicInfo(data)
+            pub = Publisher(msg, self.passthrough)
             self.publishers[msg.topic_id] = pub
-            self.callbacks[msg.topic_id] = pub.handlePacket
+            handle = pub.handlePacket
+            if rospy.resolve_name(msg.topic_name) in self.receive_stamp_topics and pub.message._has_header:
+                rospy.loginfo("Stamping unstamped messages on %s as they arrive" % msg.topic_name)
+                handle = lambda data, handle=handle: self.handleReceiveStamp(handle, data)
+            layout = quantized_layout(pub.message, self.quantization) if self.quantization else None
+            if layout:
+                # quantized fields are expanded last, once the message is whole
+                rospy.loginfo("Client sends %s with quantized fields" % msg.topic_name)
+                handle = lambda data, handle=handle, layout=layout: self.handleQuantized(layout, handle, data)
+            if msg.flags & TopicInfo.FLAG_COMPRESSED:
+                rospy.loginfo("Client sends %s compressed" % msg.topic_name)
+                self.callbacks[msg.topic_id] = lambda data, handle=handle: self.handleCompressed(handle, data)
+            elif msg.flags & TopicInfo.FLAG_DELTA:
+                rospy.loginfo("Client sends %s delta encoded" % msg.topic_name)
+                self.keyframes[msg.topic_id] = (None, '')
+                self.callbacks[msg.topic_id] = lambda data, handle=handle, topic_id=msg.topic_id: \
+                    self.handleDelta(topic_id, handle, data)
+            else:
+                self.callbacks[msg.topic_id] = handle
+            if msg.flags & TopicInfo.FLAG_SEQUENCED:
+                # the sequence number comes ahead of anything else in the frame
+                self.sequences[msg.topic_id] = [None, 0, 0, msg.topic_name]
+                self.callbacks[msg.topic_id] = lambda data, handle=self.callbacks[msg.topic_id], topic_id=msg.topic_id: \
+                    self.handleSequenced(topic_id, handle, data)
             self.setPublishSize(msg.buffer_size)
             rospy.loginfo("Setup publisher on %s [%s]" % (msg.topic_name, msg.message_type) )
         except Exception as e:
@@ -582,28 +1103,32 @@ class SerialClient(object):
     def setupSubscriber(self, data):
         """ Register a new subscriber. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
+            msg = readTopicInfo(data)
             if not msg.topic_name in self.subscribers.keys():
-                sub = Subscriber(msg, self)
+                sub = Subscriber(msg, self, self.passthrough)
                 self.subscribers[msg.topic_name] = sub
                 self.setSubscribeSize(msg.buffer_size)
                 rospy.loginfo("Setup subscriber on %s [%s]" % (msg.topic_name, msg.message_type) )
             elif msg.message_type != self.subscribers[msg.topic_name].message._type:
                 old_message_type = self.subscribers[msg.topic_name].message._type
                 self.subscribers[msg.topic_name].unregister()
-                sub = Subscriber(msg, self)
+                sub = Subscriber(msg, self, self.passthrough)
                 self.subscribers[msg.topic_name] = sub
                 self.setSubscribeSize(msg.buffer_size)
                 rospy.loginfo("Change the message type of subscriber on %s from [%s] to [%s]" % (msg.topic_name, old_message_type, msg.message_type) )
+            else:
+                self.subscribers[msg.topic_name].sequence = 0 if msg.flags & TopicInfo.FLAG_SEQUENCED else None
+                sub = self.subscribers[msg.topic_name]
+                if rospy.resolve_name(msg.topic_name) in self.replay_last_topics and sub.last is not None:
+                    rospy.loginfo("Replaying the last message on %s" % msg.topic_name)
+                    sub.callback(sub.last)
         except Exception as e:
             rospy.logerr("Creation of subscriber failed: %s", e)
 
     def setupServiceServerPublisher(self, data):
         """ Register a new service server. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
+            msg = readTopicInfo(data)
             self.setPublishSize(msg.buffer_size)
             try:
                 srv = self.services[msg.topic_name]
@@ -621,8 +1146,7 @@ class SerialClient(object):
     def setupServiceServerSubscriber(self, data):
         """ Register a new service server. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
+            msg = readTopicInfo(data)
             self.setSubscribeSize(msg.buffer_size)
             try:
                 srv = self.services[msg.topic_name]
@@ -640,8 +1164,7 @@ class SerialClient(object):
     def setupServiceClientPublisher(self, data):
         """ Register a new service client. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
+            msg = readTopicInfo(data)
             self.setPublishSize(msg.buffer_size)
             try:
                 srv = self.services[msg.topic_name]
@@ -659,8 +1182,7 @@ class SerialClient(object):
     def setupServiceClientSubscriber(self, data):
         """ Register a new service client. """
         try:
-            msg = TopicInfo()
-            msg.deserialize(data)
+            msg = readTopicInfo(data)
             self.setSubscribeSize(msg.buffer_size)
             try:
                 srv = self.services[msg.topic_name]
@@ -675,8 +1197,89 @@ class SerialClient(object):
         except Exception as e:
             rospy.logerr("Creation of service client failed: %s", e)
 
+    def handleCompressed(self, handle, data):
+        """ Frames on topics the client compresses carry the length of the message,
+        then the message LZ4 compressed, or as it is if that would be no shorter. """
+        if len(data) < 2:
+            rospy.logwarn("Compressed message from the client too short")
+            return
+        length, = struct.unpack("<H", data[:2])
+        msg = data[2:] if len(data) - 2 == length else lz4_decompress(data[2:], length)
+        if msg is None:
+            rospy.logwarn("Dropping a compressed message from the client which doesn't decompress")
+            return
+        handle(msg)
+
+    def handleDelta(self, topic_id, handle, data):
+        """ Frames on topics the client delta encodes start with the number of a
+        keyframe. Either the message follows as it is, to be that keyframe, or,
+        with DELTA_ENCODED, its length, then how it differs from the keyframe. """
+        if len(data) < 1:
+            return
+        header = ord(data[0])
+        number = header & DELTA_KEYFRAME_MASK
+        if not header & DELTA_ENCODED:
+            self.keyframes[topic_id] = (number, data[1:])
+            handle(data[1:])
+            return
+        keyframe_number, keyframe = self.keyframes[topic_id]
+        if len(data) < 3 or keyframe_number != number:
+            rospy.logwarn("Dropping a delta from the client on a keyframe which didn't arrive")
+            return
+        length, = struct.unpack("<H", data[1:3])
+        msg = delta_decode(keyframe, data[3:], length)
+        if msg is None:
+            rospy.logwarn("Dropping a delta from the client which doesn't decode")
+            return
+        handle(msg)
+
+    def handleQuantized(self, layout, handle, data):
+        """ Messages of types with quantized fields are expanded to their standard
+        serialization before being published. """
+        msg = quantize_convert(layout, data, True)
+        if msg is None:
+            rospy.logwarn("Dropping a message from the client whose quantized fields don't match its type")
+            return
+        handle(msg)
+
+    def handleReceiveStamp(self, handle, data):
+        """ Fills in a zero Header stamp, which is the four bytes after its seq,
+        with the time the message arrived. """
+        if len(data) >= 12 and data[4:12] == '\x00' * 8:
+            latency = self.receive_stamp_latency
+            baudrate = getattr(self.port, 'baudrate', 0)
+            if baudrate:
+                # ten bits a byte, with the frame's eight bytes of overhead
+                latency += (len(data) + 8) * 10.0 / baudrate
+            received = rospy.Time.now() - rospy.Duration.from_sec(latency)
+            data = data[:4] + struct.pack('<II', received.secs, received.nsecs) + data[12:]
+        handle(data)
+
+    def handleSequenced(self, topic_id, handle, data):
+        """ Frames on topics the client numbers start with a byte counting the
+        messages it has sent on the topic, from which those lost are counted. """
+        if len(data) < 1:
+            return
+        sequence = ord(data[0])
+        counts = self.sequences[topic_id]
+        if counts[0] is not None:
+            skipped = (sequence - counts[0]) & 0xff
+            if skipped >= 256 - 32:
+                # a little way behind, so counted lost when it was skipped over
+                counts[2] += 1
+                counts[1] = max(counts[1] - 1, 0)
+                handle(data[1:])
+                return
+            counts[1] += skipped
+        counts[0] = (sequence + 1) & 0xff
+        handle(data[1:])
+
     def handleTimeRequest(self, data):
         """ Respond to device with system time. """
+        # A client waiting to be asked for its topics says so with an empty request.
+        if not data:
+            rospy.loginfo('Client is waiting to be configured.')
+            self.requestTopics()
         t = Time()
         t.data = rospy.Time.now()
         data_buffer = StringIO.StringIO()
@@ -688,52 +1291,134 @@ class SerialClient(object):
         """ Send parameters to device. Supports only simple datatypes and arrays of such. """
         req = RequestParamRequest()
         req.deserialize(data)
+        resp = self.lookupParameter(req.name)
+        if resp is None:
+            return
+        data_buffer = StringIO.StringIO()
+        resp.serialize(data_buffer)
+        self.send(TopicInfo.ID_PARAMETER_REQUEST, data_buffer.getvalue())
+
+    def handleParameterBatch(self, data):
+        """ Send several parameters to device in one frame. The request is a run of
+        names, each a 32-bit length and that many bytes; the answer a
+        RequestParamResponse for each in turn, empty for any that can't be sent. """
+        data_buffer = StringIO.StringIO()
+        offset = 0
+        while offset + 4 <= len(data):
+            length, = struct.unpack("<I", data[offset:offset + 4])
+            offset += 4
+            name = data[offset:offset + length]
+            offset += length
+            resp = self.lookupParameter(name)
+            if resp is None:
+                resp = RequestParamResponse()
+            resp.serialize(data_buffer)
+        self.send(TopicInfo.ID_PARAMETER_BATCH, data_buffer.getvalue())
+
+    def lookupParameter(self, name):
+        """ Fetch a parameter for the device as a RequestParamResponse, or None if it
+        doesn't exist or isn't a simple datatype or array of one. """
         resp = RequestParamResponse()
         try:
-            param = rospy.get_param(req.name)
+            param = rospy.get_param(name)
         except KeyError:
-            rospy.logerr("Parameter %s does not exist"%req.name)
-            return
+            rospy.logerr("Parameter %s does not exist"%name)
+            return None
 
         if param is None:
-            rospy.logerr("Parameter %s does not exist"%req.name)
-            return
+            rospy.logerr("Parameter %s does not exist"%name)
+            return None
 
         if isinstance(param, dict):
-            rospy.logerr("Cannot send param %s because it is a dictionary"%req.name)
-            return
+            rospy.logerr("Cannot send param %s because it is a dictionary"%name)
+            return None
         if not isinstance(param, list):
             param = [param]
         #check to make sure that all parameters in list are same type
         t = type(param[0])
         for p in param:
             if t!= type(p):
-                rospy.logerr('All Paramers in the list %s must be of the same type'%req.name)
-                return
+                rospy.logerr('All Paramers in the list %s must be of the same type'%name)
+                return None
         if t == int or t == bool:
             resp.ints = param
         if t == float:
             resp.floats =param
         if t == str:
             resp.strings = param
-        data_buffer = StringIO.StringIO()
-        resp.serialize(data_buffer)
-        self.send(TopicInfo.ID_PARAMETER_REQUEST, data_buffer.getvalue())
+        return resp
+
+    def handleBatch(self, data):
+        """ Hand on each of the messages packed into one frame. Each is a topic id
+        and a length, of two bytes each, followed by that many bytes of message. """
+        offset = 0
+        unconfigured = False
+        while offset + 4 <= len(data):
+            topic_id, length = struct.unpack("<HH", data[offset:offset + 4])
+            offset += 4
+            if offset + length > len(data):
+                rospy.logwarn("Message on topic id %d runs past the end of its batched frame" % topic_id)
+                break
+            if topic_id == TopicInfo.ID_BATCH:
+                rospy.logwarn("Ignoring a batched frame nested in another")
+            else:
+                # As for a frame of its own, a message on a topic not yet set up
+                # is dropped, without the rest of the batch.
+                try:
+                    callback = self.callbacks[topic_id]
+                except KeyError:
+                    rospy.logerr("Tried to publish before configured, topic id %d" % topic_id)
+                    unconfigured = True
+                else:
+                    callback(data[offset:offset + length])
+            offset += length
+        if unconfigured:
+            self.requestTopics()
 
     def handleLoggingRequest(self, data):
         """ Forward logging information from serial device into ROS. """
         msg = Log()
         msg.deserialize(data)
-        if msg.level == Log.ROSDEBUG:
-            rospy.logdebug(msg.msg)
-        elif msg.level == Log.INFO:
-            rospy.loginfo(msg.msg)
-        elif msg.level == Log.WARN:
-            rospy.logwarn(msg.msg)
-        elif msg.level == Log.ERROR:
-            rospy.logerr(msg.msg)
-        elif msg.level == Log.FATAL:
-            rospy.logfatal(msg.msg)
+        self.log(msg.level, msg.msg)
+
+    def handleDeferredLog(self, data):
+        """ Forward a log message the device left for us to format, from its level,
+        the id of its format string in ~log_dictionary and its arguments, each a
+        tag and a value. """
+        if len(data) < 5:
+            return
+        level, format_id = struct.unpack("<BI", data[:5])
+        args = []
+        offset = 5
+        while offset < len(data):
+            tag = data[offset]
+            offset += 1
+            if tag in "iuf" and offset + 4 <= len(data):
+                args.append(struct.unpack("<" + {"i": "i", "u": "I", "f": "f"}[tag], data[offset:offset + 4])[0])
+                offset += 4
+            elif tag == "s" and offset < len(data):
+                length = ord(data[offset])
+                args.append(data[offset + 1:offset + 1 + length])
+                offset += 1 + length
+            else:
+                break
+        format = self.log_formats.get(format_id)
+        if format is None:
+            self.log(level, "Log message 0x%08x, not in ~log_dictionary: %s" % (format_id, " ".join(str(a) for a in args)))
+        else:
+            self.log(level, expand_log(format, args))
+
+    def log(self, level, text):
+        if level == Log.ROSDEBUG:
+            rospy.logdebug(text)
+        elif level == Log.INFO:
+            rospy.loginfo(text)
+        elif level == Log.WARN:
+            rospy.logwarn(text)
+        elif level == Log.ERROR:
+            rospy.logerr(text)
+        elif level == Log.FATAL:
+            rospy.logfatal(text)
 
     def send(self, topic, msg):
         """
@@ -749,46 +1434,73 @@ class SerialClient(object):
             self.port.write(data)
             self.last_write = rospy.Time.now()
 
-    def _send(self, topic, msg):
+    def _frame(self, topic, msg):
         """
-        Send a message on a particular topic to the device.
+        Frame a message on a particular topic for the device, or return None if it's too large.
         """
         length = len(msg)
         if self.buffer_in > 0 and length > self.buffer_in:
             rospy.logerr("Message from ROS network dropped: message larger than buffer.\n%s" % msg)
-            return -1
+            return None
+
+        #modified frame : header(2 bytes) + msg_len(2 bytes) + msg_len_chk(1 byte) + topic_id(2 bytes) + msg(x bytes) + msg_topic_id_chk(1 byte)
+        # second byte of header is protocol version
+        msg_len_checksum = 255 - ( ((length&255) + (length>>8))%256 )
+        protocol_ver = self.protocol_ver2_crc16 if self.client_crc16 else self.protocol_ver
+        frame = bytearray(7 + length + (2 if self.client_crc16 else 1))
+        struct.pack_into("<BBHBH", frame, 0, 0xff, ord(protocol_ver), length, msg_len_checksum, topic)
+        frame[7:7 + length] = msg
+        if self.client_crc16:
+            struct.pack_into("<H", frame, 7 + length, crc16(msg, crc16(str(frame[5:7]))))
         else:
-            #modified frame : header(2 bytes) + msg_len(2 bytes) + msg_len_chk(1 byte) + topic_id(2 bytes) + msg(x bytes) + msg_topic_id_chk(1 byte)
-            # second byte of header is protocol version
-            msg_len_checksum = 255 - ( ((length&255) + (length>>8))%256 )
-            msg_checksum = 255 - ( ((topic&255) + (topic>>8) + sum([ord(x) for x in msg]))%256 )
-            data = "\xff" + self.protocol_ver  + chr(length&255) + chr(length>>8) + chr(msg_len_checksum) + chr(topic&255) + chr(topic>>8)
-            data = data + msg + chr(msg_checksum)
-            self._write(data)
-            return length
+            frame[-1] = 255 - sum(frame[5:-1]) % 256
+        if self.client_cobs:
+            return "\x00" + cobs_encode(str(frame)) + "\x00"
+        return str(frame)
 
     def processWriteQueue(self):
         """
         Main loop for the thread that processes outgoing data to write to the serial port.
         """
         while not rospy.is_shutdown():
-            if self.write_queue.empty():
-                time.sleep(0.01)
-            else:
-                data = self.write_queue.get()
+            # Wait for something to write, then take everything else already
+            # queued behind it, so that it all goes out in one write. The wait has
+            # no timeout, as Python 2 polls for one; this is a daemon thread, so
+            # doesn't hold up shutdown.
+            items = [self.write_queue.get()]
+            try:
                 while True:
-                    try:
-                        if isinstance(data, tuple):
-                            topic, msg = data
-                            self._send(topic, msg)
-                        elif isinstance(data, basestring):
-                            self._write(data)
-                        else:
-                            rospy.logerr("Trying to write invalid data type: %s" % type(data))
-                        break
-                    except SerialTimeoutException as exc:
-                        rospy.logerr('Write timeout: %s' % exc)
-                        time.sleep(1)
+                    items.append(self.write_queue.get_nowait())
+            except Empty:
+                pass
+
+            data = self.framesFor(items)
+            if not data:
+                continue
+
+            while True:
+                try:
+                    self._write(data)
+                    break
+                except SerialTimeoutException as exc:
+                    rospy.logerr('Write timeout: %s' % exc)
+                    time.sleep(1)
+
+    def framesFor(self, items):
+        """ The bytes to write for what was taken off the write queue: messages
+        framed, and anything else as it is. """
+        frames = []
+        for data in items:
+            if isinstance(data, tuple):
+                topic, msg = data
+                frame = self._frame(topic, msg)
+                if frame is not None:
+                    frames.append(frame)
+            elif isinstance(data, basestring):
+                frames.append(data)
+            else:
+                rospy.logerr("Trying to write invalid data type: %s" % type(data))
+        return ''.join(frames)
 
     def sendDiagnostics(self, level, msg_text):
         msg = diagnostic_msgs.msg.DiagnosticArray()
@@ -811,4 +1523,8 @@ class SerialClient(object):
         status.values[1].key="last sync lost"
         status.values[1].value=time.ctime(self.lastsync_lost.to_sec())
 
+        for topic_id, (_, lost, reordered, name) in sorted(self.sequences.items()):
+            status.values.append(diagnostic_msgs.msg.KeyValue(key="%s frames lost" % name, value=str(lost)))
+            status.values.append(diagnostic_msgs.msg.KeyValue(key="%s frames reordered" % name, value=str(reordered)))
+
         self.pub_diagnostics.publish(msg)
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+"""
+Tests SerialClient's handling of batched frames, each of which packs several
+messages, of a topic id and length and then the message, into one frame.
+"""
+import struct
+import unittest
+
+from rosserial_msgs.msg import TopicInfo
+from rosserial_python.SerialClient import SerialClient
+
+
+def batch(*messages):
+    return "".join(struct.pack("<HH", topic_id, len(msg)) + msg for topic_id, msg in messages)
+
+
+class TestHandleBatch(unittest.TestCase):
+    def setUp(self):
+        # Only the state handleBatch uses; there's no port to open.
+        self.client = SerialClient.__new__(SerialClient)
+        self.received = []
+        self.topics_requested = 0
+        self.client.callbacks = {
+            100: lambda msg: self.received.append((100, msg)),
+            101: lambda msg: self.received.append((101, msg)),
+        }
+        self.client.requestTopics = self.requestTopics
+
+    def requestTopics(self):
+        self.topics_requested += 1
+
+    def test_messages_handed_on_in_order(self):
+        self.client.handleBatch(batch((100, "ab"), (101, ""), (100, "c")))
+        self.assertEqual([(100, "ab"), (101, ""), (100, "c")], self.received)
+        self.assertEqual(0, self.topics_requested)
+
+    def test_unconfigured_topic_skipped(self):
+        """
+        a message on a topic id not yet set up is dropped without the others,
+        and the topics are asked for once
+        """
+        self.client.handleBatch(batch((100, "a"), (125, "x"), (126, "y"), (101, "b")))
+        self.assertEqual([(100, "a"), (101, "b")], self.received)
+        self.assertEqual(1, self.topics_requested)
+
+    def test_truncated_message_dropped(self):
+        data = batch((100, "a"), (101, "bcd"))
+        self.client.handleBatch(data[:-1])
+        self.assertEqual([(100, "a")], self.received)
+
+    def test_nested_batch_ignored(self):
+        self.client.handleBatch(batch((TopicInfo.ID_BATCH, batch((100, "a"))), (101, "b")))
+        self.assertEqual([(101, "b")], self.received)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -34,27 +34,186 @@
 #ifndef ROSSERIAL_SERVER_ASYNC_READ_BUFFER_H
 #define ROSSERIAL_SERVER_ASYNC_READ_BUFFER_H
 
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 #include <boost/function.hpp>
 
 #include <ros/ros.h>
 
+#include "rosserial_server/frame_parser.h"
+#include "rosserial_server/frame_trace.h"
+#include "rosserial_server/handler_allocator.h"
+#include "rosserial_server/lifeline.h"
+#include "rosserial_server/link_capture.h"
+#include "rosserial_server/mirrored_buffer.h"
+
 namespace rosserial_server
 {
 
+/**
+ * @brief Reads whatever a stream already has waiting into the buffer, without blocking, so
+ *        that AsyncReadBuffer can carry on inline rather than through a round trip of the
+ *        reactor. Returns the bytes read, or 0 with would_block when there are none waiting,
+ *        and operation_not_supported for streams which can't be read this way.
+ */
+template<typename Stream>
+inline size_t read_ready(Stream&, const boost::asio::mutable_buffer&, boost::system::error_code& error)
+{
+  error = boost::asio::error::operation_not_supported;
+  return 0;
+}
+
+template<typename Socket>
+inline size_t read_socket_ready(Socket& socket, const boost::asio::mutable_buffer& buffer,
+                                boost::system::error_code& error)
+{
+  // Async operations on the socket carry on as before in non-blocking mode.
+  if (!socket.non_blocking())
+  {
+    socket.non_blocking(true, error);
+    if (error)
+    {
+      return 0;
+    }
+  }
+  return socket.read_some(boost::asio::mutable_buffers_1(buffer), error);
+}
+
+inline size_t read_ready(boost::asio::ip::tcp::socket& socket, const boost::asio::mutable_buffer& buffer,
+                         boost::system::error_code& error)
+{
+  return read_socket_ready(socket, buffer, error);
+}
+
+inline size_t read_ready(boost::asio::local::stream_protocol::socket& socket,
+                         const boost::asio::mutable_buffer& buffer, boost::system::error_code& error)
+{
+  return read_socket_ready(socket, buffer, error);
+}
+
+/**
+ * @brief Serial ports are opened with O_NONBLOCK by asio, so can be read from directly.
+ */
+inline size_t read_ready(boost::asio::serial_port& port, const boost::asio::mutable_buffer& buffer,
+                         boost::system::error_code& error)
+{
+  ssize_t bytes = ::read(port.native_handle(), boost::asio::buffer_cast<void*>(buffer),
+                         boost::asio::buffer_size(buffer));
+  if (bytes > 0)
+  {
+    return bytes;
+  }
+  if (bytes == 0)
+  {
+    error = boost::asio::error::eof;
+  }
+  else if (errno == EAGAIN || errno == EWOULDBLOCK)
+  {
+    error = boost::asio::error::would_block;
+  }
+  else
+  {
+    error = boost::system::error_code(errno, boost::system::system_category());
+  }
+  return 0;
+}
+
 template<typename AsyncReadStream>
 class AsyncReadBuffer
 {
 public:
-  AsyncReadBuffer(AsyncReadStream& s, size_t capacity,
+  /**
+   * @brief All completion handlers, including the read success callbacks, are run
+   *        through the given strand, which should be the same one the owner uses.
+   *        The buffer holds at least capacity bytes, and possibly more, as it is
+   *        rounded up to whole pages when it can be mirrored.
+   */
+  AsyncReadBuffer(AsyncReadStream& s, boost::asio::io_service::strand& strand, size_t capacity,
                   boost::function<void(const boost::system::error_code&)> error_callback)
-       : stream_(s), read_requested_bytes_(0), error_callback_(error_callback) {
+       : stream_(s), strand_(strand), reserved_capacity_(0), read_requested_bytes_(0),
+         header_errors_(0), oversize_frames_(0), protocol_mismatches_(0), trace_(NULL), capture_(NULL),
+         last_read_stamp_(0), speculative_(speculative_default), lifeline_(NULL),
+         error_callback_(error_callback) {
     reset();
     mem_.resize(capacity);
     ROS_ASSERT_MSG(error_callback_, "Bad error callback passed to read buffer.");
   }
 
+  /**
+   * @brief Asks for the buffer to be able to hold at least this many bytes. It only ever
+   *        grows, and not right away, since callbacks may still be looking at its content;
+   *        the new memory is swapped in when the next read is commanded.
+   */
+  void reserve(size_t capacity)
+  {
+    reserved_capacity_ = std::max(reserved_capacity_, capacity);
+  }
+
+  size_t capacity() const
+  {
+    return mem_.size();
+  }
+
+  /**
+   * @brief Numbers of frames which frame mode has skipped, because of a bad length checksum
+   *        or because they could never fit in the buffer.
+   */
+  uint64_t header_errors() const { return header_errors_; }
+  uint64_t oversize_frames() const { return oversize_frames_; }
+
+  /**
+   * @brief Number of sync bytes frame mode has skipped because a protocol version other
+   *        than this one's followed them, as from a client built against another release.
+   *        The callback, if set, is run whenever a read turns up more of them.
+   */
+  uint64_t protocol_mismatches() const { return protocol_mismatches_; }
+
+  void set_protocol_mismatch_callback(boost::function<void()> callback)
+  {
+    protocol_mismatch_callback_ = callback;
+  }
+
+  /**
+   * @brief Whether, before going to the reactor for more bytes, to read what the stream
+   *        already has waiting, as read_ready() does. On by default, except with asio's
+   *        io_uring backend, where it would only add a syscall to each read; streams it
+   *        can't read turn it off by themselves, the first time it's tried.
+   */
+  void set_speculative(bool speculative)
+  {
+    speculative_ = speculative;
+  }
+
+  /**
+   * @brief Frames found in frame mode are recorded to the given trace, as of both the read
+   *        which completed them and the moment they were parsed.
+   */
+  void set_trace(FrameTrace* trace)
+  {
+    trace_ = trace;
+  }
+
+  /**
+   * @brief Every chunk of bytes read is appended to the given capture, as is the position
+   *        of each frame found in them in frame mode.
+   */
+  void set_capture(LinkCapture* capture)
+  {
+    capture_ = capture;
+  }
+
+  /**
+   * @brief The pending read, or post of a callback, holds the owner through its lifeline,
+   *        so that the buffer is still there when it completes.
+   */
+  void set_lifeline(const Lifeline* lifeline)
+  {
+    lifeline_ = lifeline;
+  }
+
   /**
    * @brief Commands a fixed number of bytes from the buffer. This may be fulfilled from existing
    *        buffer content, or following a hardware read if required.
@@ -67,6 +226,7 @@ public:
     ROS_ASSERT_MSG(callback, "Bad read success callback function.");
     read_success_callback_ = callback;
     read_requested_bytes_ = requested_bytes;
+    applyReserve();
 
     if (read_requested_bytes_ > mem_.size())
     {
@@ -82,22 +242,25 @@ public:
 
     if (transfer_bytes > 0)
     {
-      // If we don't have enough headroom in the buffer, we'll have to shift what's currently in there to make room.
-      if (bytesHeadroom() < transfer_bytes)
+      makeHeadroom(transfer_bytes);
+
+      size_t needed_bytes = transfer_bytes;
+      if (readReady(needed_bytes))
       {
-        memmove(&mem_[0], &mem_[read_index_], bytesAvailable());
-        write_index_ = bytesAvailable();
-        read_index_ = 0;
+        callSuccessCallback();
+        return;
       }
+      transfer_bytes = needed_bytes;
 
       // Initiate a read from hardware so that we have enough bytes to fill the user request.
       ROS_DEBUG_STREAM_NAMED("async_read", "Requesting transfer of at least " << transfer_bytes << " byte(s).");
       boost::asio::async_read(stream_,
-          boost::asio::buffer(&mem_[write_index_], bytesHeadroom()),
+          boost::asio::buffer(mem_.data() + write_index_, bytesHeadroom()),
           boost::asio::transfer_at_least(transfer_bytes),
-          boost::bind(&AsyncReadBuffer::callback, this,
-                      boost::asio::placeholders::error,
-                      boost::asio::placeholders::bytes_transferred));
+          strand_.wrap(make_custom_alloc_handler(handler_memory_, make_guarded_handler(guard(),
+                                                 boost::bind(&AsyncReadBuffer::callback, this,
+                                                             boost::asio::placeholders::error,
+                                                             boost::asio::placeholders::bytes_transferred)))));
     }
     else
     {
@@ -106,7 +269,281 @@ public:
     }
   }
 
+  /**
+   * @brief Frame mode. Rather than a fixed number of bytes, this commands every complete
+   *        frame the buffer holds, going to hardware only if it doesn't hold any. Bytes
+   *        which can't be part of a frame are skipped over, as are frames too large to
+   *        ever fit in the buffer.
+   *
+   * All the frames are handed to the callback together, as views into the buffer which
+   * remain valid until the next read or read_frames request.
+   */
+  void read_frames(boost::function<void(std::vector<Frame>&)> callback) {
+    ROS_ASSERT_MSG(read_requested_bytes_ == 0 && !read_frames_callback_,
+                   "Read operation already pending.");
+    ROS_ASSERT_MSG(callback, "Bad read frames callback function.");
+    read_frames_callback_ = callback;
+    applyReserve();
+    processFrames();
+  }
+
 private:
+  /**
+   * @brief Collects the complete frames at the front of the buffer. If there are any, they're
+   *        posted to the frames callback. Otherwise, enough is read from hardware to complete
+   *        the first frame, and this is called again once that arrives.
+   */
+  void processFrames()
+  {
+    size_t needed_bytes;
+    do
+    {
+      needed_bytes = collectFrames();
+      if (!frames_.empty())
+      {
+        ROS_DEBUG_STREAM_NAMED("async_read", "Invoking frames callback with " << frames_.size() << " frame(s).");
+        strand_.post(make_custom_alloc_handler(handler_memory_,
+            make_guarded_handler(guard(), boost::bind(&AsyncReadBuffer::callFramesCallback, this))));
+        return;
+      }
+
+      // Nothing complete in the buffer, so read enough to complete whatever partial frame is there.
+      if (bytesAvailable() == 0)
+      {
+        reset();
+      }
+      makeHeadroom(needed_bytes);
+    }
+    while (readReady(needed_bytes));
+
+    ROS_DEBUG_STREAM_NAMED("async_read", "Requesting transfer of at least " << needed_bytes << " byte(s) for frame.");
+    boost::asio::async_read(stream_,
+        boost::asio::buffer(mem_.data() + write_index_, bytesHeadroom()),
+        boost::asio::transfer_at_least(needed_bytes),
+        strand_.wrap(make_custom_alloc_handler(handler_memory_, make_guarded_handler(guard(),
+                                               boost::bind(&AsyncReadBuffer::callback, this,
+                                                           boost::asio::placeholders::error,
+                                                           boost::asio::placeholders::bytes_transferred)))));
+  }
+
+  /**
+   * @brief Parses the complete frames at the front of the buffer into frames_, returning the
+   *        number of bytes which must be read to complete the next one.
+   */
+  size_t collectFrames()
+  {
+    frames_.clear();
+    size_t needed_bytes = 0;
+    uint64_t protocol_mismatches = protocol_mismatches_;
+
+    while (true)
+    {
+      uint8_t* begin = mem_.data() + read_index_;
+      const uint8_t* sync = FrameParser::find_sync(begin, begin + bytesAvailable(), &protocol_mismatches_);
+      read_index_ += sync - begin;
+      wrapIndexes();
+
+      if (bytesAvailable() > 0 && mem_.data()[read_index_] == 0)
+      {
+        if (!processCobsFrame(needed_bytes))
+        {
+          break;
+        }
+        continue;
+      }
+
+      if (bytesAvailable() < FrameParser::header_bytes)
+      {
+        needed_bytes = FrameParser::header_bytes - bytesAvailable();
+        break;
+      }
+
+      uint16_t length, topic_id;
+      if (!FrameParser::parse_header(mem_.data() + read_index_, length, topic_id))
+      {
+        ROS_WARN_NAMED("async_read", "Bad message header length checksum. Dropping message from client.");
+        header_errors_++;
+        read_index_++;
+        wrapIndexes();
+        continue;
+      }
+
+      size_t frame_bytes = length + FrameParser::frame_overhead(mem_.data() + read_index_);
+      if (frame_bytes > mem_.size())
+      {
+        ROS_WARN_STREAM_NAMED("async_read", "Message of " << frame_bytes << " bytes on topic " << topic_id <<
+                              " exceeds buffer capacity of " << mem_.size() << ". Attempting to regain rx sync.");
+        oversize_frames_++;
+        read_index_++;
+        wrapIndexes();
+        continue;
+      }
+      if (bytesAvailable() < frame_bytes)
+      {
+        needed_bytes = frame_bytes - bytesAvailable();
+        break;
+      }
+
+      // The frame handed on is the body plus its trailing checksum or CRC bytes.
+      Frame frame = { topic_id, mem_.data() + read_index_ + FrameParser::header_bytes,
+                      static_cast<uint16_t>(frame_bytes - FrameParser::header_bytes),
+                      FrameParser::has_crc16(mem_.data() + read_index_), false };
+      frames_.push_back(frame);
+      frameFound(topic_id, frame_bytes);
+      read_index_ += frame_bytes;
+      wrapIndexes();
+    }
+
+    if (protocol_mismatches_ != protocol_mismatches && protocol_mismatch_callback_)
+    {
+      protocol_mismatch_callback_();
+    }
+    return needed_bytes;
+  }
+
+  /**
+   * @brief Reads what the stream already has waiting, inline, where that can be done without
+   *        blocking. Returns true if it brought in the needed bytes; otherwise, what did arrive
+   *        is taken off needed_bytes, leaving the rest to an async read. Errors are left for
+   *        that read to report, through the usual path.
+   */
+  bool readReady(size_t& needed_bytes)
+  {
+    if (!speculative_)
+    {
+      return false;
+    }
+    boost::system::error_code error;
+    size_t bytes = read_ready(stream_, boost::asio::buffer(mem_.data() + write_index_, bytesHeadroom()), error);
+    if (error == boost::asio::error::operation_not_supported)
+    {
+      speculative_ = false;
+    }
+    if (bytes == 0)
+    {
+      return false;
+    }
+    bytesReceived(bytes);
+    if (bytes >= needed_bytes)
+    {
+      return true;
+    }
+    needed_bytes -= bytes;
+    return false;
+  }
+
+  /**
+   * @brief Handles the zero at the front of the buffer, which may start a COBS frame running
+   *        up to the next zero. A complete one is decoded in place and collected, leaving its
+   *        closing zero to be looked at next, as it may open the next frame. Returns false,
+   *        setting needed_bytes, if more must be read to tell.
+   */
+  bool processCobsFrame(size_t& needed_bytes)
+  {
+    uint8_t* start = mem_.data() + read_index_;
+    size_t available = bytesAvailable();
+    if (available < 3)
+    {
+      needed_bytes = 3 - available;
+      return false;
+    }
+    if (!FrameParser::may_be_cobs(start + 1))
+    {
+      // A closing zero, or a plain frame's stray zero; either way, hunt on past it.
+      read_index_++;
+      wrapIndexes();
+      return true;
+    }
+
+    uint8_t* end = static_cast<uint8_t*>(memchr(start + 1, 0, available - 1));
+    if (!end)
+    {
+      if (available >= mem_.size())
+      {
+        ROS_WARN_STREAM_NAMED("async_read", "COBS frame exceeds buffer capacity of " << mem_.size() <<
+                              ". Attempting to regain rx sync.");
+        oversize_frames_++;
+        read_index_++;
+        wrapIndexes();
+        return true;
+      }
+      needed_bytes = 1;
+      return false;
+    }
+
+    uint8_t* plain = start + 1;
+    int decoded = FrameParser::cobs_decode(plain, end - plain);
+    uint16_t length, topic_id;
+    if (decoded < FrameParser::header_bytes || !FrameParser::parse_header(plain, length, topic_id) ||
+        static_cast<size_t>(decoded) != length + FrameParser::frame_overhead(plain))
+    {
+      ROS_WARN_NAMED("async_read", "Bad COBS frame. Dropping message from client.");
+      header_errors_++;
+      read_index_ += end - start;
+      wrapIndexes();
+      return true;
+    }
+
+    Frame frame = { topic_id, plain + FrameParser::header_bytes,
+                    static_cast<uint16_t>(decoded - FrameParser::header_bytes),
+                    FrameParser::has_crc16(plain), true };
+    frames_.push_back(frame);
+    // Its closing zero counts as part of it too.
+    frameFound(topic_id, end - start + 1);
+    read_index_ += end - start;
+    wrapIndexes();
+    return true;
+  }
+
+  /**
+   * @brief Records a frame of the given number of bytes starting at the read index.
+   */
+  void frameFound(uint16_t topic_id, size_t frame_bytes)
+  {
+    if (trace_)
+    {
+      trace_->record(FrameTrace::IN_READ, topic_id, last_read_stamp_);
+      trace_->record(FrameTrace::IN_PARSED, topic_id);
+    }
+    if (capture_ && capture_->enabled())
+    {
+      capture_->in_frame(capture_->in_bytes() - bytesAvailable(), frame_bytes, topic_id);
+    }
+  }
+
+  void callFramesCallback()
+  {
+    // Clear the pending callback before calling it, as it will likely request more frames.
+    boost::function<void(std::vector<Frame>&)> callback;
+    callback.swap(read_frames_callback_);
+    std::vector<Frame> frames;
+    frames.swap(frames_);
+    callback(frames);
+    // Hang onto the storage for next time, unless more frames have been collected already.
+    if (frames_.empty())
+    {
+      frames.clear();
+      frames_.swap(frames);
+    }
+  }
+
+  /**
+   * @brief Moves to a larger buffer if one has been reserved, carrying over what's unread.
+   */
+  void applyReserve()
+  {
+    if (reserved_capacity_ <= mem_.size())
+    {
+      return;
+    }
+    MirroredBuffer mem(reserved_capacity_);
+    memcpy(mem.data(), mem_.data() + read_index_, bytesAvailable());
+    write_index_ = bytesAvailable();
+    read_index_ = 0;
+    mem_.swap(mem);
+    ROS_DEBUG_STREAM_NAMED("async_read", "Read buffer grown to " << mem_.size() << " bytes.");
+  }
+
   void reset()
   {
     read_index_ = 0;
@@ -120,9 +557,42 @@ private:
 
   inline size_t bytesHeadroom()
   {
+    if (mem_.mirrored())
+    {
+      // Writes can carry on past the end of the buffer, into the mirror of its start.
+      return mem_.size() - bytesAvailable();
+    }
     return mem_.size() - write_index_;
   }
 
+  /**
+   * @brief Ensures there's room to write the given number of bytes after those already in the
+   *        buffer. A mirrored buffer always has room for anything which fits, but otherwise,
+   *        what's currently in there may have to be shifted back to the start.
+   */
+  void makeHeadroom(size_t bytes)
+  {
+    if (bytesHeadroom() < bytes)
+    {
+      memmove(mem_.data(), mem_.data() + read_index_, bytesAvailable());
+      write_index_ = bytesAvailable();
+      read_index_ = 0;
+    }
+  }
+
+  /**
+   * @brief Once reading has moved into the mirror, brings both indexes back down to the same
+   *        bytes in the first mapping, so that they never run past the end of the second.
+   */
+  inline void wrapIndexes()
+  {
+    if (mem_.mirrored() && read_index_ >= mem_.size())
+    {
+      read_index_ -= mem_.size();
+      write_index_ -= mem_.size();
+    }
+  }
+
   /**
    * @brief The internal callback which is called by the boost::asio::async_read invocation
    *        in the public read method above.
@@ -133,6 +603,7 @@ private:
     {
       read_requested_bytes_ = 0;
       read_success_callback_.clear();
+      read_frames_callback_.clear();
       ROS_DEBUG_STREAM_NAMED("async_read", "Read operation failed with: " << error);
 
       if (error == boost::asio::error::operation_aborted)
@@ -147,9 +618,34 @@ private:
       return;
     }
 
+    bytesReceived(bytes_transferred);
+    if (read_frames_callback_)
+    {
+      processFrames();
+    }
+    else
+    {
+      callSuccessCallback();
+    }
+  }
+
+  /**
+   * @brief Takes in the given number of bytes, just read into the buffer at the write index.
+   */
+  void bytesReceived(size_t bytes_transferred)
+  {
+    if (capture_ && capture_->enabled())
+    {
+      capture_->in_chunk(mem_.data() + write_index_, bytes_transferred);
+    }
     write_index_ += bytes_transferred;
+    if (trace_)
+    {
+      // The topic isn't known until the frame is parsed.
+      ROSSERIAL_SERVER_FRAME_PROBE(FrameTrace::IN_READ, 0);
+      last_read_stamp_ = trace_->enabled() ? ros::WallTime::now().toNSec() : 0;
+    }
     ROS_DEBUG_STREAM_NAMED("async_read", "Successfully read " << bytes_transferred << " byte(s), now " << bytesAvailable() << " available.");
-    callSuccessCallback();
   }
 
   /**
@@ -161,12 +657,14 @@ private:
     ROS_DEBUG_STREAM_NAMED("async_read", "Invoking success callback with buffer of requested size " <<
                            read_requested_bytes_ << " byte(s).");
 
-    ros::serialization::IStream stream(&mem_[read_index_], read_requested_bytes_);
+    ros::serialization::IStream stream(mem_.data() + read_index_, read_requested_bytes_);
     read_index_ += read_requested_bytes_;
+    wrapIndexes();
 
     // Post the callback rather than executing it here so, so that we have a chance to do the cleanup
     // below prior to it actually getting run, in the event that the callback queues up another read.
-    stream_.get_io_service().post(boost::bind(read_success_callback_, stream));
+    strand_.post(make_custom_alloc_handler(handler_memory_,
+        make_guarded_handler(guard(), boost::bind(read_success_callback_, stream))));
 
     // Resetting these values clears our state so that we know there isn't a callback pending.
     read_requested_bytes_ = 0;
@@ -179,8 +677,23 @@ private:
     }
   }
 
+  boost::shared_ptr<void> guard() const
+  {
+    return lifeline_ ? lifeline_->hold() : boost::shared_ptr<void>();
+  }
+
+#ifdef BOOST_ASIO_HAS_IO_URING
+  static const bool speculative_default = false;
+#else
+  static const bool speculative_default = true;
+#endif
+
   AsyncReadStream& stream_;
-  std::vector<uint8_t> mem_;
+  boost::asio::io_service::strand& strand_;
+  // For the one read, or post of a callback, which is ever outstanding.
+  HandlerMemory handler_memory_;
+  MirroredBuffer mem_;
+  size_t reserved_capacity_;
 
   size_t write_index_;
   size_t read_index_;
@@ -188,6 +701,18 @@ private:
 
   boost::function<void(ros::serialization::IStream&)> read_success_callback_;
   size_t read_requested_bytes_;
+
+  boost::function<void(std::vector<Frame>&)> read_frames_callback_;
+  std::vector<Frame> frames_;
+  uint64_t header_errors_;
+  uint64_t oversize_frames_;
+  uint64_t protocol_mismatches_;
+  boost::function<void()> protocol_mismatch_callback_;
+  FrameTrace* trace_;
+  LinkCapture* capture_;
+  uint64_t last_read_stamp_;
+  bool speculative_;
+  const Lifeline* lifeline_;
 };
 
 }  // namespace
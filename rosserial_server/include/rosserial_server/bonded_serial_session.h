@@ -0,0 +1,149 @@
+/**
+ *
+ *  \file
+ *  \brief      Session striped across several serial ports to one client.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_BONDED_SERIAL_SESSION_H
+#define ROSSERIAL_SERVER_BONDED_SERIAL_SESSION_H
+
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/bonded_stream.h"
+#include "rosserial_server/session.h"
+
+namespace rosserial_server
+{
+
+class BondedSerialSession : public Session<BondedStream>
+{
+public:
+  /**
+   * One client, on all of the given ports at the same baud rate. If any of them
+   * can't be opened, or fails later, they are all closed and tried again together.
+   */
+  BondedSerialSession(boost::asio::io_service& io_service, const std::vector<std::string>& ports, int baud)
+    : Session(io_service), ports_(ports), baud_(baud), timer_(io_service), failed_connection_attempts_(0)
+  {
+    std::string names;
+    for (size_t i = 0; i < ports_.size(); ++i)
+    {
+      names += (i > 0 ? "+" : "") + ports_[i];
+    }
+    ROS_INFO_STREAM("rosserial_server bonded session configured for " << names << " at " << baud << "bps each.");
+    set_hardware_id(names);
+    socket().set_strand(strand());
+
+    // No more than the client can take in one chunk, BONDED_HARDWARE_CHUNK.
+    int chunk_size;
+    ros::param::param<int>("~chunk_size", chunk_size, 32);
+    socket().set_chunk_size(chunk_size);
+
+    // How long a missing chunk is waited for, before the bytes after it are passed
+    // on without it. Must outlast the skew between the links.
+    double gap_timeout;
+    ros::param::param<double>("~gap_timeout", gap_timeout, 0.05);
+    socket().set_gap_timeout(boost::posix_time::microseconds(static_cast<int64_t>(gap_timeout * 1e6)));
+
+    // Ten bits on the wire for each byte, on every link, less each chunk's framing.
+    set_link_bandwidth(static_cast<size_t>(ports_.size() * (baud / 10.0) * socket().chunk_size() /
+                                           (socket().chunk_size() + BondedChunk::overhead)));
+
+    double sync_retry_interval;
+    ros::param::param<double>("~sync_retry_interval", sync_retry_interval, 0.1);
+    set_sync_retry_interval(boost::posix_time::microseconds(static_cast<int64_t>(sync_retry_interval * 1e6)));
+
+    check_connection();
+  }
+
+private:
+  void check_connection()
+  {
+    if (!is_active())
+    {
+      attempt_connection();
+    }
+
+    // Every two seconds, check again if the connection should be reinitialized,
+    // if the ROS node is still up.
+    if (ros::ok())
+    {
+      timer_.expires_from_now(boost::posix_time::milliseconds(2000));
+      timer_.async_wait(strand().wrap(boost::bind(&BondedSerialSession::check_connection, this)));
+    }
+  }
+
+  void attempt_connection()
+  {
+    ROS_DEBUG("Opening bonded serial ports.");
+    socket().close();
+
+    typedef boost::asio::serial_port_base serial;
+    for (size_t i = 0; i < ports_.size(); ++i)
+    {
+      BondedStream::Link& link = socket().add_link();
+      boost::system::error_code ec;
+      link.open(ports_[i], ec);
+      if (ec) {
+        failed_connection_attempts_++;
+        if (failed_connection_attempts_ == 1) {
+          ROS_ERROR_STREAM("Unable to open port " << ports_[i] << ": " << ec);
+        } else {
+          ROS_DEBUG_STREAM("Unable to open port " << ports_[i] << " (" << failed_connection_attempts_ << "): " << ec);
+        }
+        socket().close();
+        return;
+      }
+      link.set_option(serial::baud_rate(baud_));
+      link.set_option(serial::character_size(8));
+      link.set_option(serial::stop_bits(serial::stop_bits::one));
+      link.set_option(serial::parity(serial::parity::none));
+      link.set_option(serial::flow_control(serial::flow_control::none));
+    }
+    ROS_INFO_STREAM("Opened " << ports_.size() << " bonded ports.");
+    failed_connection_attempts_ = 0;
+
+    // Kick off the session.
+    start();
+  }
+
+  std::vector<std::string> ports_;
+  int baud_;
+  boost::asio::deadline_timer timer_;
+  int failed_connection_attempts_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_BONDED_SERIAL_SESSION_H
@@ -0,0 +1,608 @@
+/**
+ *
+ *  \file
+ *  \brief      Stream striped across several serial ports, in sequenced chunks.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_BONDED_STREAM_H
+#define ROSSERIAL_SERVER_BONDED_STREAM_H
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <boost/array.hpp>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/version.hpp>
+#include <stdint.h>
+
+#include <ros/ros.h>
+
+
+namespace rosserial_server
+{
+
+/**
+ * Each link carries the stream as chunks of up to 255 bytes of it, framed as
+ *   0xb5, sequence, length, bytes..., checksum
+ * with an 8-bit sequence number counting chunks across all the links, and a
+ * checksum on everything after the sync byte, made the way rosserial's own are.
+ * Which link a chunk goes on is the sender's business; the receiver puts them
+ * back in order. The client's half is ros::BondedHardware, in rosserial_client,
+ * and the two must agree on all of it.
+ */
+struct BondedChunk
+{
+  enum { sync = 0xb5, overhead = 4, max_length = 255 };
+};
+
+/**
+ * Presents several serial ports as one stream, for a Session<BondedStream>, so a
+ * client with more than one UART to spare gets their combined bandwidth.
+ *
+ * Written bytes are cut into chunks, each of which goes to the next link with
+ * room for it, so links which drain faster take more of them. Received chunks
+ * are held in a window of sequence numbers until the ones before them arrive.
+ * As each link delivers its chunks in order, one that every link has passed
+ * must have been lost, and is skipped at once; otherwise a gap is skipped once
+ * it has been waited on for the gap timeout. A lost chunk takes part of a frame
+ * with it, which the session's checksums then catch, as they would on one port.
+ */
+class BondedStream
+{
+public:
+  typedef boost::asio::serial_port Link;
+
+  explicit BondedStream(boost::asio::io_service& io_service)
+    : io_service_(io_service), strand_(NULL), gap_timer_(io_service), chunk_size_(64),
+      gap_timeout_(boost::posix_time::milliseconds(50)), next_link_(0), gap_pending_(false),
+      tx_sequence_(0)
+  {
+    reset_window();
+  }
+
+  ~BondedStream()
+  {
+    close();
+  }
+
+#if (BOOST_VERSION >= 106600)
+  typedef boost::asio::io_service::executor_type executor_type;
+
+  executor_type get_executor()
+  {
+    return io_service_.get_executor();
+  }
+#endif
+
+  boost::asio::io_service& get_io_service()
+  {
+    return io_service_;
+  }
+
+  /**
+   * The strand of the session reading from this stream, which the stream's own
+   * handlers must run on.
+   */
+  void set_strand(boost::asio::io_service::strand& strand)
+  {
+    strand_ = &strand;
+  }
+
+  /**
+   * The most bytes of the stream sent in one chunk, which must be no more than the
+   * client can take in one, BONDED_HARDWARE_CHUNK.
+   */
+  void set_chunk_size(size_t chunk_size)
+  {
+    chunk_size_ = std::max<size_t>(1, std::min<size_t>(chunk_size, BondedChunk::max_length));
+  }
+
+  size_t chunk_size() const
+  {
+    return chunk_size_;
+  }
+
+  void set_gap_timeout(boost::posix_time::time_duration gap_timeout)
+  {
+    gap_timeout_ = gap_timeout;
+  }
+
+  /**
+   * Adds a link, closed, for the session to open and configure. Once the first
+   * read is started, every link is read.
+   */
+  Link& add_link()
+  {
+    links_.push_back(LinkStatePtr(new LinkState(io_service_)));
+    return links_.back()->port;
+  }
+
+  size_t link_count() const
+  {
+    return links_.size();
+  }
+
+  bool is_open() const
+  {
+    return !links_.empty();
+  }
+
+  /**
+   * Closes every link and forgets them, so the session can add them afresh when it
+   * reconnects.
+   */
+  void close()
+  {
+    boost::system::error_code ec;
+    for (size_t i = 0; i < links_.size(); ++i)
+    {
+      links_[i]->closed = true;
+      links_[i]->port.close(ec);
+    }
+    links_.clear();
+    gap_timer_.cancel(ec);
+    gap_pending_ = false;
+    complete(read_handler_, boost::asio::error::operation_aborted, 0);
+    complete(write_handler_, boost::asio::error::operation_aborted, 0);
+    error_ = boost::system::error_code();
+    ready_.clear();
+    next_link_ = 0;
+    tx_sequence_ = 0;
+    reset_window();
+  }
+
+  template <typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
+  {
+    read_handler_ = handler;
+    read_op_ = boost::bind(&BondedStream::take_ready<MutableBufferSequence>, this, buffers);
+    for (size_t i = 0; i < links_.size(); ++i)
+    {
+      if (!links_[i]->reading)
+      {
+        read_link(links_[i]);
+      }
+    }
+    try_read();
+  }
+
+  template <typename ConstBufferSequence, typename WriteHandler>
+  void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler)
+  {
+    write_handler_ = handler;
+    write_op_ = boost::bind(&BondedStream::stripe<ConstBufferSequence>, this, buffers);
+    try_write();
+  }
+
+private:
+  typedef boost::function<void(const boost::system::error_code&, size_t)> Handler;
+
+  enum { window = 32 };
+
+  struct LinkState
+  {
+    explicit LinkState(boost::asio::io_service& io_service)
+      : port(io_service), closed(false), reading(false), writing(false), seen(false), last_sequence(0),
+        state(HUNT), length(0), received(0), sum(0)
+    {
+    }
+
+    enum ParseState { HUNT, SEQUENCE, LENGTH, PAYLOAD, CHECKSUM };
+
+    Link port;
+    bool closed;
+    bool reading;
+    bool writing;
+    // The sequence number of the last chunk this link delivered.
+    bool seen;
+    uint8_t last_sequence;
+    ParseState state;
+    uint8_t sequence;
+    uint8_t length;
+    size_t received;
+    uint8_t sum;
+    boost::array<uint8_t, BondedChunk::max_length> payload;
+    boost::array<uint8_t, 256> read_buffer;
+    // Chunks waiting for the write in flight, and that write.
+    std::vector<uint8_t> queued;
+    std::vector<uint8_t> in_flight;
+  };
+  typedef boost::shared_ptr<LinkState> LinkStatePtr;
+
+  void read_link(const LinkStatePtr& link)
+  {
+    link->reading = true;
+    link->port.async_read_some(boost::asio::buffer(link->read_buffer),
+        strand_->wrap(boost::bind(&BondedStream::read_cb, this, link,
+                         boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+  }
+
+  void read_cb(LinkStatePtr link, const boost::system::error_code& error, size_t bytes_transferred)
+  {
+    link->reading = false;
+    if (link->closed)
+    {
+      return;
+    }
+    if (error)
+    {
+      fail(error);
+      return;
+    }
+    for (size_t i = 0; i < bytes_transferred; ++i)
+    {
+      parse(*link, link->read_buffer[i]);
+    }
+    deliver();
+    read_link(link);
+  }
+
+  void parse(LinkState& link, uint8_t byte)
+  {
+    switch (link.state)
+    {
+      case LinkState::HUNT:
+        if (byte == BondedChunk::sync)
+        {
+          link.state = LinkState::SEQUENCE;
+        }
+        break;
+      case LinkState::SEQUENCE:
+        link.sequence = byte;
+        link.sum = byte;
+        link.state = LinkState::LENGTH;
+        break;
+      case LinkState::LENGTH:
+        link.length = byte;
+        link.sum += byte;
+        link.received = 0;
+        link.state = byte > 0 ? LinkState::PAYLOAD : LinkState::HUNT;
+        break;
+      case LinkState::PAYLOAD:
+        link.payload[link.received++] = byte;
+        link.sum += byte;
+        if (link.received == link.length)
+        {
+          link.state = LinkState::CHECKSUM;
+        }
+        break;
+      case LinkState::CHECKSUM:
+        link.state = LinkState::HUNT;
+        if (static_cast<uint8_t>(link.sum + byte) == 0xff)
+        {
+          link.seen = true;
+          link.last_sequence = link.sequence;
+          receive_chunk(link.sequence, link.payload.data(), link.length);
+        }
+        else
+        {
+          ROS_DEBUG_STREAM("Dropped a bonded chunk with a bad checksum.");
+        }
+        break;
+    }
+  }
+
+  /**
+   * Files a chunk in the window. One behind the window is a straggler from a gap
+   * already skipped, but a run of them, or one too far ahead, means the client has
+   * restarted its count, and the window starts again from it. The run itself is
+   * lost, as bytes are when a client resets on a single port, and the handshake's
+   * retries cover it the same way.
+   */
+  void receive_chunk(uint8_t sequence, const uint8_t* data, size_t length)
+  {
+    int8_t ahead = static_cast<int8_t>(sequence - expected_);
+    if (ahead < 0 && ahead > -window && ++stale_ <= links_.size())
+    {
+      return;
+    }
+    if (ahead < 0 || ahead >= window)
+    {
+      ROS_DEBUG_STREAM("Bonded stream restarted at chunk " << static_cast<int>(sequence) << ".");
+      reset_window();
+      expected_ = sequence;
+    }
+    stale_ = 0;
+    Slot& slot = slots_[sequence % window];
+    if (!slot.filled)
+    {
+      ++buffered_;
+    }
+    slot.filled = true;
+    slot.bytes.assign(data, data + length);
+  }
+
+  /**
+   * Moves whatever is in order to the bytes ready for the session, skipping gaps
+   * which can no longer be filled.
+   */
+  void deliver()
+  {
+    for (;;)
+    {
+      Slot& slot = slots_[expected_ % window];
+      if (slot.filled)
+      {
+        ready_.insert(ready_.end(), slot.bytes.begin(), slot.bytes.end());
+        slot.filled = false;
+        --buffered_;
+        ++expected_;
+        continue;
+      }
+      if (buffered_ > 0 && all_links_passed())
+      {
+        skip_gap();
+        continue;
+      }
+      break;
+    }
+
+    if (buffered_ > 0 && !gap_pending_)
+    {
+      gap_pending_ = true;
+      gap_sequence_ = expected_;
+      gap_timer_.expires_from_now(gap_timeout_);
+      gap_timer_.async_wait(strand_->wrap(boost::bind(&BondedStream::gap_cb, this,
+                                                      boost::asio::placeholders::error)));
+    }
+    try_read();
+  }
+
+  bool all_links_passed() const
+  {
+    for (size_t i = 0; i < links_.size(); ++i)
+    {
+      if (!links_[i]->seen || static_cast<int8_t>(links_[i]->last_sequence - expected_) <= 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void skip_gap()
+  {
+    uint8_t from = expected_;
+    while (!slots_[expected_ % window].filled)
+    {
+      ++expected_;
+    }
+    ROS_DEBUG_STREAM("Bonded stream skipped " << static_cast<int>(static_cast<uint8_t>(expected_ - from)) <<
+                     " lost chunks.");
+  }
+
+  void gap_cb(const boost::system::error_code& error)
+  {
+    if (error == boost::asio::error::operation_aborted)
+    {
+      return;
+    }
+    gap_pending_ = false;
+    if (buffered_ > 0 && expected_ == gap_sequence_)
+    {
+      skip_gap();
+    }
+    deliver();
+  }
+
+  void reset_window()
+  {
+    for (size_t i = 0; i < window; ++i)
+    {
+      slots_[i].filled = false;
+    }
+    expected_ = 0;
+    buffered_ = 0;
+    stale_ = 0;
+  }
+
+  template <typename MutableBufferSequence>
+  size_t take_ready(const MutableBufferSequence& buffers)
+  {
+    size_t count = std::min(ready_.size(), boost::asio::buffer_size(buffers));
+    std::copy(ready_.begin(), ready_.begin() + count, boost::asio::buffers_begin(buffers));
+    ready_.erase(ready_.begin(), ready_.begin() + count);
+    return count;
+  }
+
+  /**
+   * Cuts as much of the buffers into chunks as the links have room for, keeping at
+   * most one chunk queued behind each link's write in flight.
+   */
+  template <typename ConstBufferSequence>
+  size_t stripe(const ConstBufferSequence& buffers)
+  {
+    typedef boost::asio::buffers_iterator<ConstBufferSequence> Iterator;
+    Iterator position = boost::asio::buffers_begin(buffers);
+    Iterator end = boost::asio::buffers_end(buffers);
+    size_t count = 0;
+    while (position != end)
+    {
+      LinkStatePtr link = next_link();
+      if (!link)
+      {
+        break;
+      }
+      size_t length = std::min<size_t>(chunk_size_, end - position);
+      std::vector<uint8_t>& out = link->queued;
+      out.push_back(BondedChunk::sync);
+      out.push_back(tx_sequence_);
+      out.push_back(length);
+      uint8_t sum = tx_sequence_ + length;
+      for (size_t i = 0; i < length; ++i, ++position)
+      {
+        out.push_back(*position);
+        sum += *position;
+      }
+      out.push_back(0xff - sum);
+      ++tx_sequence_;
+      count += length;
+      write_link(link);
+    }
+    return count;
+  }
+
+  LinkStatePtr next_link()
+  {
+    for (size_t i = 0; i < links_.size(); ++i)
+    {
+      size_t index = (next_link_ + i) % links_.size();
+      if (links_[index]->queued.empty())
+      {
+        next_link_ = index + 1;
+        return links_[index];
+      }
+    }
+    return LinkStatePtr();
+  }
+
+  void write_link(const LinkStatePtr& link)
+  {
+    if (link->writing || link->queued.empty())
+    {
+      return;
+    }
+    link->writing = true;
+    link->in_flight.swap(link->queued);
+    boost::asio::async_write(link->port, boost::asio::buffer(link->in_flight),
+        strand_->wrap(boost::bind(&BondedStream::write_cb, this, link, boost::asio::placeholders::error)));
+  }
+
+  void write_cb(LinkStatePtr link, const boost::system::error_code& error)
+  {
+    link->writing = false;
+    if (link->closed)
+    {
+      return;
+    }
+    if (error)
+    {
+      fail(error);
+      return;
+    }
+    link->in_flight.clear();
+    write_link(link);
+    try_write();
+  }
+
+  void try_op(Handler& handler, boost::function<size_t()>& op)
+  {
+    if (!handler)
+    {
+      return;
+    }
+    if (error_ || links_.empty())
+    {
+      complete(handler, error_ ? error_ : boost::asio::error::eof, 0);
+      return;
+    }
+    size_t count = op();
+    if (count > 0)
+    {
+      complete(handler, boost::system::error_code(), count);
+    }
+  }
+
+  void try_read()
+  {
+    try_op(read_handler_, read_op_);
+  }
+
+  void try_write()
+  {
+    try_op(write_handler_, write_op_);
+  }
+
+  /**
+   * A link which fails takes the stream down with it, and the session reconnects
+   * them all.
+   */
+  void fail(const boost::system::error_code& error)
+  {
+    if (!error_)
+    {
+      error_ = error;
+    }
+    try_read();
+    try_write();
+  }
+
+  void complete(Handler& handler, const boost::system::error_code& error, size_t count)
+  {
+    if (handler)
+    {
+      if (strand_)
+      {
+        strand_->post(boost::bind(handler, error, count));
+      }
+      else
+      {
+        io_service_.post(boost::bind(handler, error, count));
+      }
+      handler.clear();
+    }
+  }
+
+  struct Slot
+  {
+    bool filled;
+    std::vector<uint8_t> bytes;
+  };
+
+  boost::asio::io_service& io_service_;
+  boost::asio::io_service::strand* strand_;
+  boost::asio::deadline_timer gap_timer_;
+  size_t chunk_size_;
+  boost::posix_time::time_duration gap_timeout_;
+  std::vector<LinkStatePtr> links_;
+  size_t next_link_;
+  boost::system::error_code error_;
+
+  // The receiving window, of chunks from expected_ onwards.
+  boost::array<Slot, window> slots_;
+  uint8_t expected_;
+  size_t buffered_;
+  size_t stale_;
+  bool gap_pending_;
+  uint8_t gap_sequence_;
+  std::deque<uint8_t> ready_;
+  uint8_t tx_sequence_;
+
+  Handler read_handler_;
+  Handler write_handler_;
+  boost::function<size_t()> read_op_;
+  boost::function<size_t()> write_op_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_BONDED_STREAM_H
@@ -0,0 +1,128 @@
+/**
+ *
+ *  \file
+ *  \brief      Free-list of outbound frame buffers, recycled by a Session.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_BUFFER_POOL_H
+#define ROSSERIAL_SERVER_BUFFER_POOL_H
+
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+
+namespace rosserial_server
+{
+
+typedef std::vector<uint8_t> Buffer;
+typedef boost::shared_ptr<Buffer> BufferPtr;
+
+/**
+ * Keeps buffers around after their write completes so that the next outbound
+ * frame can reuse one rather than going to the heap. Buffers are allocated with
+ * capacity for the largest frame negotiated so far, so once a session is
+ * up, resizing a recycled buffer for a new frame never reallocates.
+ *
+ * Not thread-safe; a pool belongs to a single Session.
+ */
+class BufferPool
+{
+public:
+  explicit BufferPool(size_t max_free = 16)
+    : buffer_size_(0), max_free_(max_free), hits_(0), misses_(0)
+  {
+  }
+
+  /**
+   * @brief Ensure that newly allocated buffers can hold a frame of at least this many bytes.
+   */
+  void reserve(size_t buffer_size)
+  {
+    if (buffer_size > buffer_size_)
+    {
+      buffer_size_ = buffer_size;
+    }
+  }
+
+  /**
+   * @brief Returns a buffer of exactly the requested length, recycled if possible.
+   */
+  BufferPtr acquire(size_t length)
+  {
+    BufferPtr buffer_ptr;
+    if (!free_.empty() && free_.back()->capacity() >= length)
+    {
+      buffer_ptr = free_.back();
+      free_.pop_back();
+      hits_++;
+    }
+    else
+    {
+      buffer_ptr.reset(new Buffer());
+      buffer_ptr->reserve(std::max(length, buffer_size_));
+      misses_++;
+    }
+    buffer_ptr->resize(length);
+    return buffer_ptr;
+  }
+
+  /**
+   * @brief Returns a buffer to the pool once nothing else refers to it.
+   */
+  void release(const BufferPtr& buffer_ptr)
+  {
+    // Buffers which are too small for current frames, or which something else is
+    // still holding onto, are simply left to be freed when the last reference drops.
+    if (buffer_ptr && buffer_ptr.unique() && free_.size() < max_free_ &&
+        buffer_ptr->capacity() >= buffer_size_)
+    {
+      free_.push_back(buffer_ptr);
+    }
+  }
+
+  void clear()
+  {
+    free_.clear();
+  }
+
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  std::vector<BufferPtr> free_;
+  size_t buffer_size_;
+  size_t max_free_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_BUFFER_POOL_H
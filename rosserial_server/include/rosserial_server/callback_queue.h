@@ -0,0 +1,110 @@
+/**
+ *
+ *  \file
+ *  \brief      CallbackQueue which services its callbacks from an io_service.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_CALLBACK_QUEUE_H
+#define ROSSERIAL_SERVER_CALLBACK_QUEUE_H
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/callback_queue.h>
+
+#include "rosserial_server/handler_allocator.h"
+#include "rosserial_server/lifeline.h"
+
+namespace rosserial_server
+{
+
+/**
+ * roscpp adds callbacks to this queue from its own threads. Rather than the
+ * owner having to poll for them, each addition posts a request to the owner's
+ * strand to call whatever is available, so ROS callbacks are still serialized
+ * with everything else the owner does, but run as soon as they arrive. Only one such request is outstanding at a
+ * time, and nothing at all is posted while the queue is idle.
+ */
+class AsioCallbackQueue : public ros::CallbackQueue
+{
+public:
+  /**
+   * Given its owner's lifeline, each dispatch holds the owner, so that one which
+   * is already posted finds the queue still there.
+   */
+  explicit AsioCallbackQueue(boost::asio::io_service::strand& strand, const Lifeline* lifeline = NULL)
+    : strand_(strand), lifeline_(lifeline), dispatch_posted_(false)
+  {
+  }
+
+  virtual void addCallback(const ros::CallbackInterfacePtr& callback, uint64_t owner_id = 0)
+  {
+    ros::CallbackQueue::addCallback(callback, owner_id);
+
+    boost::mutex::scoped_lock lock(dispatch_mutex_);
+    if (!dispatch_posted_)
+    {
+      boost::shared_ptr<void> guard;
+      if (lifeline_ && !lifeline_->hold(guard))
+      {
+        // The owner, and this queue with it, is on its way out.
+        return;
+      }
+      dispatch_posted_ = true;
+      strand_.post(make_custom_alloc_handler(dispatch_memory_,
+          make_guarded_handler(guard, boost::bind(&AsioCallbackQueue::dispatch, this))));
+    }
+  }
+
+private:
+  void dispatch()
+  {
+    {
+      // Clear the flag before calling, so that a callback added while these are
+      // running gets a dispatch of its own.
+      boost::mutex::scoped_lock lock(dispatch_mutex_);
+      dispatch_posted_ = false;
+    }
+    callAvailable();
+  }
+
+  boost::asio::io_service::strand& strand_;
+  const Lifeline* lifeline_;
+  boost::mutex dispatch_mutex_;
+  bool dispatch_posted_;
+  // Taken with dispatch_mutex_ held, and given back before the dispatch which
+  // clears dispatch_posted_ runs, so only one post at a time ever has it.
+  HandlerMemory dispatch_memory_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_CALLBACK_QUEUE_H
@@ -0,0 +1,96 @@
+/**
+ *
+ *  \file
+ *  \brief      Rebuilding of the delta encoded messages clients may send.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_DELTA_DECODER_H
+#define ROSSERIAL_SERVER_DELTA_DECODER_H
+
+#include <cstring>
+#include <stdint.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Rebuilds messages which clients which have been offered delta encoding send
+ * on some topics as the bytes in which they differ from a keyframe, an earlier
+ * message on the topic. The encoding is a run of pairs of counts, each of bytes
+ * the same as the keyframe's and then of bytes which differ, with the bytes
+ * which differ after the second. Bytes past the end of the keyframe all differ,
+ * and any past the last run are the keyframe's.
+ */
+class DeltaDecoder
+{
+public:
+  /**
+   * @brief Decodes [in, in + length) against the keyframe into exactly out_length
+   *        bytes at out. Returns false if the input is damaged, or doesn't decode
+   *        to that many bytes.
+   */
+  static bool decode(const uint8_t* keyframe, size_t keyframe_length, const uint8_t* in, size_t length,
+                     uint8_t* out, size_t out_length)
+  {
+    const uint8_t* end = in + length;
+    size_t o = 0;
+    while (in < end)
+    {
+      if (end - in < 2)
+      {
+        return false;
+      }
+      size_t same = in[0];
+      size_t differ = in[1];
+      in += 2;
+      if (same > (keyframe_length > o ? keyframe_length - o : 0) || differ > static_cast<size_t>(end - in) ||
+          o + same + differ > out_length)
+      {
+        return false;
+      }
+      memcpy(out + o, keyframe + o, same);
+      o += same;
+      memcpy(out + o, in, differ);
+      in += differ;
+      o += differ;
+    }
+    // The rest is the keyframe's.
+    if (out_length - o > (keyframe_length > o ? keyframe_length - o : 0))
+    {
+      return false;
+    }
+    memcpy(out + o, keyframe + o, out_length - o);
+    return true;
+  }
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_DELTA_DECODER_H
@@ -0,0 +1,203 @@
+/**
+ *
+ *  \file
+ *  \brief      A thread of its own on which a session publishes what its client sends.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef ROSSERIAL_SERVER_DISPATCH_PIPELINE_H
+#define ROSSERIAL_SERVER_DISPATCH_PIPELINE_H
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Takes the messages a session has framed and checked off its I/O thread, and
+ * hands each to its target's handle() on a thread of its own, so that a busy
+ * client's deserializing and publishing happen on another core from its reading.
+ *
+ * The messages pass through a ring of slots, with the session's strand the one
+ * producer and the pipeline's thread the one consumer, so that neither takes a
+ * lock while the other keeps up. Each slot keeps its bytes' capacity for the next
+ * message, so the ring doesn't allocate once every slot has held the largest.
+ * Messages are handled in the order they were pushed, which keeps each topic's
+ * in order. While the ring is full, push() waits for a slot, so that a client
+ * which outpaces its publishing is held back as it would be without the thread.
+ */
+template<class Target>
+class DispatchPipeline : boost::noncopyable
+{
+public:
+  typedef boost::shared_ptr<Target> TargetPtr;
+
+  explicit DispatchPipeline(size_t slots)
+    : slots_(slots > 0 ? slots : 1), head_(0), tail_(0), consumer_waiting_(false), producer_waiting_(false),
+      stopping_(false)
+  {
+    thread_ = boost::thread(boost::bind(&DispatchPipeline::run, this));
+  }
+
+  /**
+   * Handles the messages still in the ring, then stops the thread.
+   */
+  ~DispatchPipeline()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_one();
+    thread_.join();
+  }
+
+  /**
+   * Queues a copy of the message for target. Only to be called from one thread
+   * at a time, such as a session's strand.
+   */
+  void push(const TargetPtr& target, const uint8_t* data, uint32_t length)
+  {
+    size_t tail = tail_.load(boost::memory_order_relaxed);
+    if (tail - head_.load(boost::memory_order_acquire) == slots_.size())
+    {
+      wait_for_slot(tail);
+    }
+    Slot& slot = slots_[tail % slots_.size()];
+    slot.target = target;
+    slot.data.assign(data, data + length);
+    tail_.store(tail + 1, boost::memory_order_release);
+
+    // Pairs with the fence in run(): either the thread sees the new tail before
+    // it waits, or this sees that it is waiting.
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (consumer_waiting_.load(boost::memory_order_relaxed))
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      ready_.notify_one();
+    }
+  }
+
+  /**
+   * The messages pushed and not yet handled.
+   */
+  size_t pending() const
+  {
+    return tail_.load(boost::memory_order_acquire) - head_.load(boost::memory_order_acquire);
+  }
+
+private:
+  struct Slot
+  {
+    TargetPtr target;
+    std::vector<uint8_t> data;
+  };
+
+  void wait_for_slot(size_t tail)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    producer_waiting_.store(true, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    while (tail - head_.load(boost::memory_order_acquire) == slots_.size())
+    {
+      space_.wait(lock);
+    }
+    producer_waiting_.store(false, boost::memory_order_relaxed);
+  }
+
+  void run()
+  {
+    while (true)
+    {
+      size_t head = head_.load(boost::memory_order_relaxed);
+      if (head == tail_.load(boost::memory_order_acquire))
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        consumer_waiting_.store(true, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        while (head == tail_.load(boost::memory_order_acquire) && !stopping_)
+        {
+          ready_.wait(lock);
+        }
+        consumer_waiting_.store(false, boost::memory_order_relaxed);
+        if (head == tail_.load(boost::memory_order_acquire))
+        {
+          return;
+        }
+        continue;
+      }
+
+      Slot& slot = slots_[head % slots_.size()];
+      try
+      {
+        ros::serialization::IStream stream(slot.data.empty() ? NULL : &slot.data[0], slot.data.size());
+        slot.target->handle(stream);
+      }
+      catch (ros::serialization::StreamOverrunException&)
+      {
+        ROS_WARN("Buffer overrun when attempting to parse user message.");
+      }
+      // Let go of the target here, rather than when the slot is next used, so
+      // that a topic the session has dropped isn't kept around by the ring.
+      slot.target.reset();
+      head_.store(head + 1, boost::memory_order_release);
+
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      if (producer_waiting_.load(boost::memory_order_relaxed))
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        space_.notify_one();
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  boost::atomic<size_t> head_;
+  boost::atomic<size_t> tail_;
+  boost::atomic<bool> consumer_waiting_;
+  boost::atomic<bool> producer_waiting_;
+  bool stopping_;
+  boost::mutex mutex_;
+  boost::condition_variable ready_;
+  boost::condition_variable space_;
+  boost::thread thread_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_DISPATCH_PIPELINE_H
@@ -0,0 +1,101 @@
+/**
+ *
+ *  \file
+ *  \brief      Lookup from received topic ids to the handlers for them.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_DISPATCH_TABLE_H
+#define ROSSERIAL_SERVER_DISPATCH_TABLE_H
+
+#include <map>
+#include <vector>
+#include <boost/function.hpp>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Clients number their user topics consecutively from 100 upward, so those are
+ * looked up by index into a vector, which is what nearly every received frame needs. The handful of lower, protocol-level ids are kept in a map.
+ */
+class DispatchTable
+{
+public:
+  typedef boost::function<void(ros::serialization::IStream&)> Callback;
+
+  /**
+   * @brief Returns the slot for this id, creating an empty one if necessary.
+   */
+  Callback& operator[](uint16_t topic_id)
+  {
+    if (topic_id < first_dense_id)
+    {
+      return sparse_[topic_id];
+    }
+    size_t index = topic_id - first_dense_id;
+    if (index >= dense_.size())
+    {
+      dense_.resize(index + 1);
+    }
+    return dense_[index];
+  }
+
+  /**
+   * @brief Returns the handler for this id, or NULL if there isn't one.
+   */
+  const Callback* find(uint16_t topic_id) const
+  {
+    if (topic_id < first_dense_id)
+    {
+      std::map<uint16_t, Callback>::const_iterator it = sparse_.find(topic_id);
+      return it != sparse_.end() && it->second ? &it->second : NULL;
+    }
+    size_t index = topic_id - first_dense_id;
+    return index < dense_.size() && dense_[index] ? &dense_[index] : NULL;
+  }
+
+  void clear()
+  {
+    sparse_.clear();
+    dense_.clear();
+  }
+
+private:
+  enum { first_dense_id = 100 };
+
+  std::map<uint16_t, Callback> sparse_;
+  std::vector<Callback> dense_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_DISPATCH_TABLE_H
@@ -0,0 +1,298 @@
+/**
+ *
+ *  \file
+ *  \brief      Helpers for locating and validating rosserial frames in received bytes.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_FRAME_PARSER_H
+#define ROSSERIAL_SERVER_FRAME_PARSER_H
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace rosserial_server
+{
+
+/**
+ * A received frame, as a view into the buffer it was read into. The data is the
+ * message body followed by its checksum byte, or its two CRC bytes.
+ */
+struct Frame
+{
+  uint16_t topic_id;
+  uint8_t* data;
+  uint16_t length;
+  bool crc16;
+  bool cobs;
+};
+
+/**
+ * A frame on the wire is laid out as:
+ *
+ *   0xff 0xfe | length (2) | length checksum | topic id (2) | body (length) | checksum
+ *
+ * or, between a server and client which have agreed on it, with a CRC-16 of the
+ * topic id and body in place of the 8-bit checksum, which is much better at
+ * catching the burst errors a long or noisy cable makes:
+ *
+ *   0xff 0xfd | length (2) | length checksum | topic id (2) | body (length) | CRC (2)
+ *
+ * The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, starting from 0xffff), sent
+ * low byte first, like the other fields.
+ *
+ * Either kind of frame may also be sent COBS encoded, with a zero byte either
+ * side, so that a receiver which has lost its place can find the next frame at
+ * the next zero, rather than by hunting for the sync bytes.
+ *
+ * These functions deal in raw byte ranges so that callers can scan whatever they
+ * have buffered without stepping through it a byte at a time.
+ */
+class FrameParser
+{
+public:
+  enum { header_bytes = 7, overhead_bytes = 8, crc16_overhead_bytes = 9 };
+  enum { protocol_ver2 = 0xfe, protocol_ver2_crc16 = 0xfd };
+
+  /**
+   * @brief Returns the first position in [begin, end) at which a frame might start:
+   *        a 0xff followed by 0xfe or 0xfd, or a 0xff in the last position, whose partner
+   *        hasn't arrived yet, or the zero before a COBS frame. Returns end if there is
+   *        no such position. Each 0xff passed over with some other protocol version
+   *        after it is counted in mismatches, if given.
+   */
+  static const uint8_t* find_sync(const uint8_t* begin, const uint8_t* end, uint64_t* mismatches = NULL)
+  {
+    const uint8_t* zero = static_cast<const uint8_t*>(memchr(begin, 0, end - begin));
+    if (zero)
+    {
+      end = zero;
+    }
+    while (begin < end)
+    {
+      const uint8_t* p = static_cast<const uint8_t*>(memchr(begin, 0xff, end - begin));
+      if (!p)
+      {
+        break;
+      }
+      if (p + 1 == end || p[1] == protocol_ver2 || p[1] == protocol_ver2_crc16)
+      {
+        return p;
+      }
+      if (mismatches)
+      {
+        (*mismatches)++;
+      }
+      begin = p + 1;
+    }
+    return end;
+  }
+
+  /**
+   * @brief Checks the length checksum of a complete header, which must begin with
+   *        the sync bytes, and extracts the body length and topic id from it.
+   */
+  static bool parse_header(const uint8_t* header, uint16_t& length, uint16_t& topic_id)
+  {
+    length = header[2] | (header[3] << 8);
+    if (static_cast<uint8_t>(header[4] + checksum(length)) != 0xff)
+    {
+      return false;
+    }
+    topic_id = header[5] | (header[6] << 8);
+    return true;
+  }
+
+  /**
+   * @brief Whether the frame with this header ends in a CRC-16 rather than a checksum.
+   */
+  static bool has_crc16(const uint8_t* header)
+  {
+    return header[1] == protocol_ver2_crc16;
+  }
+
+  /**
+   * @brief Bytes the frame with this header occupies beyond its body.
+   */
+  static size_t frame_overhead(const uint8_t* header)
+  {
+    return has_crc16(header) ? crc16_overhead_bytes : overhead_bytes;
+  }
+
+  /**
+   * @brief CRC-16/CCITT-FALSE of the given range, a byte at a time from a table.
+   */
+  static uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xffff)
+  {
+    static const CrcTable table;
+    for (; length > 0; --length)
+    {
+      crc = (crc << 8) ^ table.entries[(crc >> 8) ^ *data++];
+    }
+    return crc;
+  }
+
+  /**
+   * @brief Sum of the bytes in the given range, modulo 256.
+   *
+   * Eight bytes are taken at a time, with alternate bytes added into separate 16-bit
+   * lanes of a 64-bit accumulator. The lanes are folded together before they can
+   * overflow, which frames within the session's buffer size never even reach.
+   */
+  static uint8_t checksum(const uint8_t* data, size_t length)
+  {
+    const uint64_t mask = 0x00ff00ff00ff00ffULL;
+    uint32_t sum = 0;
+    while (length >= 8)
+    {
+      // Each word adds at most 2 * 255 to a lane, so 128 words fit in 16 bits.
+      size_t words = std::min<size_t>(length / 8, 128);
+      uint64_t lanes = 0;
+      for (size_t i = 0; i < words; ++i, data += 8)
+      {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        lanes += (word & mask) + ((word >> 8) & mask);
+      }
+      sum += (lanes & 0xffff) + ((lanes >> 16) & 0xffff) + ((lanes >> 32) & 0xffff) + (lanes >> 48);
+      length -= words * 8;
+    }
+    for (; length > 0; --length)
+    {
+      sum += *data++;
+    }
+    return sum;
+  }
+
+  static uint8_t checksum(uint16_t val)
+  {
+    return (val >> 8) + val;
+  }
+
+  /**
+   * @brief Whether the bytes after a zero, of which at least two must be given, may
+   *        be a COBS frame. Every frame starts with 0xff, so its encoding starts with
+   *        a code byte of at least two, then 0xff; a plain frame right after the zero
+   *        ending a COBS one doesn't.
+   */
+  static bool may_be_cobs(const uint8_t* encoded)
+  {
+    return encoded[0] >= 2 && encoded[1] == 0xff;
+  }
+
+  /**
+   * @brief The most bytes the COBS encoding of length bytes can take, with its zeros.
+   */
+  static size_t max_cobs_bytes(size_t length)
+  {
+    return length + length / 254 + 3;
+  }
+
+  /**
+   * @brief Writes the COBS encoding of [data, data + length), between zeros, to out,
+   *        which must have room for max_cobs_bytes(length). Returns its length.
+   */
+  static size_t cobs_encode(const uint8_t* data, size_t length, uint8_t* out)
+  {
+    uint8_t* start = out;
+    *out++ = 0;
+    size_t i = 0;
+    while (true)
+    {
+      // A block is a code byte one more than the run of nonzero bytes after it, of
+      // up to 254; unless the block is full, it stands for a zero after the run.
+      const uint8_t* zero = static_cast<const uint8_t*>(memchr(data + i, 0, length - i));
+      size_t run = std::min<size_t>(zero ? zero - (data + i) : length - i, 254);
+      *out++ = run + 1;
+      memcpy(out, data + i, run);
+      out += run;
+      i += run;
+      if (i == length)
+      {
+        break;
+      }
+      if (run < 254)
+      {
+        i++;
+      }
+    }
+    *out++ = 0;
+    return out - start;
+  }
+
+  /**
+   * @brief Decodes the COBS encoding in [data, data + length), which holds no zeros,
+   *        in place. Returns the decoded length, or -1 if the encoding is damaged.
+   */
+  static int cobs_decode(uint8_t* data, size_t length)
+  {
+    uint8_t* out = data;
+    size_t i = 0;
+    while (i < length)
+    {
+      uint8_t code = data[i++];
+      size_t run = code - 1;
+      if (run > length - i)
+      {
+        return -1;
+      }
+      memmove(out, data + i, run);
+      out += run;
+      i += run;
+      if (code != 0xff && i < length)
+      {
+        *out++ = 0;
+      }
+    }
+    return out - data;
+  }
+
+private:
+  struct CrcTable
+  {
+    CrcTable()
+    {
+      for (int i = 0; i < 256; ++i)
+      {
+        uint16_t crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+          crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+        entries[i] = crc;
+      }
+    }
+    uint16_t entries[256];
+  };
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_FRAME_PARSER_H
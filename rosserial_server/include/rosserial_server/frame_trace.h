@@ -0,0 +1,167 @@
+/**
+ *
+ *  \file
+ *  \brief      Optional timestamping of frames as they pass through a Session.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_FRAME_TRACE_H
+#define ROSSERIAL_SERVER_FRAME_TRACE_H
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <ros/ros.h>
+
+#ifdef ROSSERIAL_SERVER_USDT
+#include <sys/sdt.h>
+#define ROSSERIAL_SERVER_FRAME_PROBE(stage, topic_id) DTRACE_PROBE2(rosserial_server, frame, stage, topic_id)
+#else
+#define ROSSERIAL_SERVER_FRAME_PROBE(stage, topic_id)
+#endif
+
+namespace rosserial_server
+{
+
+/**
+ * Records the moment each frame reaches each stage of handling, so that latency
+ * can be attributed to the link, the read buffer, or roscpp. Events go into a ring
+ * of fixed size, which holds the most recent ones and can be dumped to a file.
+ * With a capacity of zero, nothing is recorded.
+ *
+ * When built with ROSSERIAL_SERVER_USDT, every event also fires the USDT probe
+ * rosserial_server:frame, with the stage and topic id as arguments, whether or
+ * not the ring is enabled.
+ *
+ * Events for a given topic and direction are recorded in the order frames pass
+ * through, so a frame's events can be matched up across stages by counting.
+ */
+class FrameTrace
+{
+public:
+  enum Stage
+  {
+    IN_READ,        // Read from hardware completed, making the frame available. The USDT
+                    // probe for this fires with a topic id of zero, as none is known yet.
+    IN_PARSED,      // Frame found in the read buffer.
+    IN_DISPATCHED,  // Frame handed to its topic handler.
+    IN_HANDLED,     // Topic handler returned, ie. for a publisher, message published.
+    OUT_RECEIVED,   // Message arrived at a subscriber.
+    OUT_QUEUED,     // Frame serialized and queued to be written.
+    OUT_DROPPED,    // Frame dropped from a full write queue.
+    OUT_WRITTEN,    // Write containing the frame completed.
+    STAGE_COUNT
+  };
+
+  explicit FrameTrace(size_t capacity = 0)
+    : next_(0), wrapped_(false)
+  {
+    events_.resize(capacity);
+  }
+
+  void swap(FrameTrace& other)
+  {
+    events_.swap(other.events_);
+    std::swap(next_, other.next_);
+    std::swap(wrapped_, other.wrapped_);
+  }
+
+  bool enabled() const
+  {
+    return !events_.empty();
+  }
+
+  void record(Stage stage, uint16_t topic_id)
+  {
+    ROSSERIAL_SERVER_FRAME_PROBE(static_cast<int>(stage), topic_id);
+    if (enabled())
+    {
+      record(stage, topic_id, ros::WallTime::now().toNSec());
+    }
+  }
+
+  void record(Stage stage, uint16_t topic_id, uint64_t stamp)
+  {
+    if (!enabled()) return;
+    Event& event = events_[next_];
+    event.stamp = stamp;
+    event.topic_id = topic_id;
+    event.stage = stage;
+    if (++next_ == events_.size())
+    {
+      next_ = 0;
+      wrapped_ = true;
+    }
+  }
+
+  /**
+   * @brief Writes the recorded events, oldest first, one per line as
+   *        "<wall time, ns> <stage> <topic id>".
+   */
+  bool dump(const std::string& path) const
+  {
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+    size_t count = wrapped_ ? events_.size() : next_;
+    size_t start = wrapped_ ? next_ : 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+      const Event& event = events_[(start + i) % events_.size()];
+      file << event.stamp << " " << stage_name(event.stage) << " " << event.topic_id << "\n";
+    }
+    return !file.fail();
+  }
+
+  static const char* stage_name(Stage stage)
+  {
+    static const char* names[STAGE_COUNT] = {
+      "in_read", "in_parsed", "in_dispatched", "in_handled",
+      "out_received", "out_queued", "out_dropped", "out_written"
+    };
+    return stage < STAGE_COUNT ? names[stage] : "unknown";
+  }
+
+private:
+  struct Event
+  {
+    uint64_t stamp;
+    uint16_t topic_id;
+    Stage stage;
+  };
+
+  std::vector<Event> events_;
+  size_t next_;
+  bool wrapped_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_FRAME_TRACE_H
@@ -0,0 +1,148 @@
+/**
+ *
+ *  \file
+ *  \brief      Preallocated storage for a Session's recurring asio handlers.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_HANDLER_ALLOCATOR_H
+#define ROSSERIAL_SERVER_HANDLER_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+
+namespace rosserial_server
+{
+
+/**
+ * Storage for one asynchronous operation at a time, as for a read or write
+ * which is only ever in flight once and is started again from its own
+ * completion. asio frees an operation's memory before calling its handler, so
+ * the next operation gets the same storage, and the steady state never goes
+ * to the heap. Anything larger, or overlapping, falls back to it.
+ */
+class HandlerMemory : boost::noncopyable
+{
+public:
+  enum { size = 512 };
+
+  HandlerMemory() : in_use_(false), hits_(0), misses_(0) {}
+
+  void* allocate(std::size_t length)
+  {
+    if (!in_use_ && length <= sizeof(storage_))
+    {
+      in_use_ = true;
+      hits_++;
+      return storage_.address();
+    }
+    misses_++;
+    return ::operator new(length);
+  }
+
+  void deallocate(void* pointer)
+  {
+    if (pointer == storage_.address())
+    {
+      in_use_ = false;
+    }
+    else
+    {
+      ::operator delete(pointer);
+    }
+  }
+
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  boost::aligned_storage<size> storage_;
+  bool in_use_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+/**
+ * Wraps a handler so that asio allocates its operation from the given memory.
+ * Invocation is left to asio's defaults, so this goes inside strand_.wrap(),
+ * whose own hooks forward allocation on to it.
+ */
+template<typename Handler>
+class CustomAllocHandler
+{
+public:
+  CustomAllocHandler(HandlerMemory& memory, const Handler& handler)
+    : memory_(memory), handler_(handler)
+  {
+  }
+
+  friend void* asio_handler_allocate(std::size_t length, CustomAllocHandler<Handler>* this_handler)
+  {
+    return this_handler->memory_.allocate(length);
+  }
+
+  friend void asio_handler_deallocate(void* pointer, std::size_t, CustomAllocHandler<Handler>* this_handler)
+  {
+    this_handler->memory_.deallocate(pointer);
+  }
+
+  void operator()()
+  {
+    handler_();
+  }
+
+  template<typename Arg1>
+  void operator()(const Arg1& arg1)
+  {
+    handler_(arg1);
+  }
+
+  template<typename Arg1, typename Arg2>
+  void operator()(const Arg1& arg1, const Arg2& arg2)
+  {
+    handler_(arg1, arg2);
+  }
+
+private:
+  HandlerMemory& memory_;
+  Handler handler_;
+};
+
+template<typename Handler>
+inline CustomAllocHandler<Handler> make_custom_alloc_handler(HandlerMemory& memory, const Handler& handler)
+{
+  return CustomAllocHandler<Handler>(memory, handler);
+}
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_HANDLER_ALLOCATOR_H
@@ -0,0 +1,183 @@
+/**
+ *
+ *  \file
+ *  \brief      Threads running a node's io_service, with real-time options.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_IO_THREADS_H
+#define ROSSERIAL_SERVER_IO_THREADS_H
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * How the threads running a node's io_service are scheduled, so that the bridge
+ * isn't preempted by everything else on a loaded machine:
+ *
+ *   ~rt_priority   SCHED_FIFO priority for the I/O threads, 1-99, or 0 to leave
+ *                  them at normal priority (default 0)
+ *   ~cpu_affinity  CPU, or list of CPUs, to pin the I/O threads to (default none)
+ *   ~mlockall      lock the process's memory, current and future, so that it is
+ *                  never paged out from under the I/O threads (default false)
+ *
+ * Real-time priority and locking memory need CAP_SYS_NICE and CAP_IPC_LOCK, or
+ * rtprio and memlock limits in /etc/security/limits.conf. Any which can't be
+ * applied are warned about, and the node carries on without them.
+ *
+ * See the Session class for which parts of its hot path still allocate, since a
+ * thread at real-time priority can be held up by the allocator as by anything.
+ */
+struct IoThreadOptions
+{
+  IoThreadOptions() : rt_priority(0), lock_memory(false) {}
+
+  /**
+   * Reads the options from the node's private namespace, or from the given one,
+   * as for a nodelet.
+   */
+  static IoThreadOptions from_params(const ros::NodeHandle& nh = ros::NodeHandle("~"))
+  {
+    IoThreadOptions options;
+    nh.param<int>("rt_priority", options.rt_priority, 0);
+    nh.param<bool>("mlockall", options.lock_memory, false);
+    XmlRpc::XmlRpcValue cpus;
+    if (nh.getParam("cpu_affinity", cpus)) {
+      if (cpus.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+        options.cpus.push_back(static_cast<int>(cpus));
+      } else if (cpus.getType() == XmlRpc::XmlRpcValue::TypeArray) {
+        for (int i = 0; i < cpus.size(); ++i) {
+          if (cpus[i].getType() == XmlRpc::XmlRpcValue::TypeInt) {
+            options.cpus.push_back(static_cast<int>(cpus[i]));
+          } else {
+            ROS_WARN("Ignoring entry %d of ~cpu_affinity, which isn't a CPU number.", i);
+          }
+        }
+      } else {
+        ROS_WARN("The ~cpu_affinity parameter must be a CPU number or a list of them; ignoring it.");
+      }
+    }
+    return options;
+  }
+
+  int rt_priority;
+  std::vector<int> cpus;
+  bool lock_memory;
+};
+
+/**
+ * Applies the options which concern the calling thread.
+ */
+inline void apply_thread_options(const IoThreadOptions& options)
+{
+  if (options.rt_priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = options.rt_priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error) {
+      ROS_WARN("Unable to run I/O thread at SCHED_FIFO priority %d: %s", options.rt_priority, strerror(error));
+    }
+  }
+  if (!options.cpus.empty()) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t i = 0; i < options.cpus.size(); ++i) {
+      CPU_SET(options.cpus[i], &cpu_set);
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (error) {
+      ROS_WARN("Unable to pin I/O thread to the CPUs in ~cpu_affinity: %s", strerror(error));
+    }
+#else
+    ROS_WARN_ONCE("The ~cpu_affinity parameter is only supported on Linux; ignoring it.");
+#endif
+  }
+}
+
+/**
+ * Applies ~mlockall, which concerns the whole process.
+ */
+inline void lock_memory(const IoThreadOptions& options)
+{
+  if (options.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    ROS_WARN("Unable to lock this process's memory: %s", strerror(errno));
+  }
+}
+
+/**
+ * Runs io_service on the calling thread, once it is scheduled according to options.
+ */
+inline void run_io_thread(boost::asio::io_service* io_service, const IoThreadOptions& options)
+{
+  apply_thread_options(options);
+  io_service->run();
+}
+
+/**
+ * Runs io_service on the calling thread and threads - 1 more, each scheduled
+ * according to options, until it runs out of work.
+ */
+inline void run_io_service(boost::asio::io_service& io_service, int threads, const IoThreadOptions& options)
+{
+  lock_memory(options);
+  if (options.rt_priority > 0 || !options.cpus.empty()) {
+    ROS_INFO_STREAM("Running " << std::max(threads, 1) << " I/O thread(s) at priority " << options.rt_priority <<
+                    " on " << (options.cpus.empty() ? "any" : "the given") << " CPUs.");
+  }
+
+  // roscpp's own threads were started along with the sessions' node handles, and
+  // keep their ordinary scheduling; only the threads which run io_service take on
+  // the options.
+  boost::thread_group thread_pool;
+  for (int i = 1; i < threads; ++i)
+  {
+    thread_pool.create_thread(boost::bind(&run_io_thread, &io_service, options));
+  }
+  run_io_thread(&io_service, options);
+  thread_pool.join_all();
+}
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_IO_THREADS_H
@@ -0,0 +1,136 @@
+/**
+ *
+ *  \file
+ *  \brief      Keeps a session alive for the handlers which can outlive it.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_LIFELINE_H
+#define ROSSERIAL_SERVER_LIFELINE_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace rosserial_server
+{
+
+/**
+ * A session is either owned through a shared_ptr, as the servers' sessions are,
+ * or not at all, as when a node keeps one for as long as it runs. Anything which
+ * may still have to reach the session after it has stopped, such as a handler
+ * waiting on its socket or a service call on the pool, takes a hold on its
+ * lifeline first. For an owned session, the hold keeps it alive until the
+ * handler lets go; once the session is gone, there's nothing to hold.
+ */
+class Lifeline
+{
+public:
+  Lifeline() : owned_(false) {}
+
+  void attach(const boost::shared_ptr<void>& owner)
+  {
+    owner_ = owner;
+    owned_ = true;
+  }
+
+  /**
+   * Sets guard to a reference to the session's owner. Returns false if the
+   * session has already been destroyed. A session which isn't owned outlives
+   * its handlers anyway, so holding it always succeeds, with an empty guard.
+   */
+  bool hold(boost::shared_ptr<void>& guard) const
+  {
+    if (!owned_)
+    {
+      guard.reset();
+      return true;
+    }
+    guard = owner_.lock();
+    return static_cast<bool>(guard);
+  }
+
+  /**
+   * For the session's own handlers, which it only starts while it's alive.
+   */
+  boost::shared_ptr<void> hold() const
+  {
+    boost::shared_ptr<void> guard;
+    hold(guard);
+    return guard;
+  }
+
+private:
+  boost::weak_ptr<void> owner_;
+  bool owned_;
+};
+
+/**
+ * Wraps a handler with a hold on a session, which is released along with the
+ * handler. This goes inside make_custom_alloc_handler(), so that the session
+ * and its handler memory are still there when asio frees the operation.
+ */
+template<typename Handler>
+class GuardedHandler
+{
+public:
+  GuardedHandler(const boost::shared_ptr<void>& guard, const Handler& handler)
+    : guard_(guard), handler_(handler)
+  {
+  }
+
+  void operator()()
+  {
+    handler_();
+  }
+
+  template<typename Arg1>
+  void operator()(const Arg1& arg1)
+  {
+    handler_(arg1);
+  }
+
+  template<typename Arg1, typename Arg2>
+  void operator()(const Arg1& arg1, const Arg2& arg2)
+  {
+    handler_(arg1, arg2);
+  }
+
+private:
+  boost::shared_ptr<void> guard_;
+  Handler handler_;
+};
+
+template<typename Handler>
+inline GuardedHandler<Handler> make_guarded_handler(const boost::shared_ptr<void>& guard, const Handler& handler)
+{
+  return GuardedHandler<Handler>(guard, handler);
+}
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_LIFELINE_H
@@ -0,0 +1,175 @@
+/**
+ *
+ *  \file
+ *  \brief      Accounting for a session's use of the bandwidth of its link.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_LINK_BUDGET_H
+#define ROSSERIAL_SERVER_LINK_BUDGET_H
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Accounts for a Session's use of its link, where the link's capacity is known, as
+ * for a serial port at a given baud. Each direction of the link is taken to have
+ * the whole capacity, as a serial port does.
+ *
+ * Topics which are sent to the client at a limited rate commit a share of the
+ * outbound capacity as they are set up: the most their frames can take at that rate.
+ * Once more is committed than the link can carry, each further topic is warned about,
+ * or refused. What the link actually carries is measured as it goes, and both are
+ * reported against the capacity in the session's diagnostics, which is what to go by
+ * in picking baud rates and topic rates.
+ */
+class LinkBudget
+{
+public:
+  LinkBudget() : capacity_(0), reject_(false), committed_(0) {}
+
+  /**
+   * @brief Bytes a second the link carries each way, or zero if that's unknown, in
+   *        which case nothing is checked or reported.
+   */
+  void set_capacity(double bytes_per_second)
+  {
+    capacity_ = bytes_per_second;
+  }
+
+  double capacity() const
+  {
+    return capacity_;
+  }
+
+  /**
+   * @brief Whether a topic which would take the committed total past the capacity is
+   *        refused, rather than just warned about.
+   */
+  void set_reject(bool reject)
+  {
+    reject_ = reject;
+  }
+
+  /**
+   * @brief Commits bytes_per_second of the outbound capacity to a topic. Returns false,
+   *        committing nothing, if that is more than is left and such topics are refused.
+   */
+  bool commit(uint16_t topic_id, const std::string& topic_name, double bytes_per_second)
+  {
+    if (capacity_ <= 0)
+    {
+      return true;
+    }
+    double committed = committed_ - commitments_[topic_id] + bytes_per_second;
+    if (committed > capacity_)
+    {
+      if (reject_)
+      {
+        ROS_ERROR_STREAM("Not sending topic " << topic_name << " to the client, as the " << bytes_per_second <<
+                         " bytes/s it may take would commit " << committed << " bytes/s of a link which carries " <<
+                         capacity_ << ".");
+        commitments_.erase(topic_id);
+        return false;
+      }
+      ROS_WARN_STREAM("Topic " << topic_name << " may take " << bytes_per_second << " bytes/s, which commits " <<
+                      committed << " bytes/s of a link which carries " << capacity_ <<
+                      ". Frames to the client will be delayed and dropped at full rate.");
+    }
+    commitments_[topic_id] = bytes_per_second;
+    committed_ = committed;
+    return true;
+  }
+
+  void clear()
+  {
+    commitments_.clear();
+    committed_ = 0;
+  }
+
+  /**
+   * @brief Adds the link's capacity and headroom to a status, given the bytes a second
+   *        measured going each way, and warns when either direction is nearly full.
+   */
+  void report(diagnostic_msgs::DiagnosticStatus& status, double in_rate, double out_rate) const
+  {
+    if (capacity_ <= 0)
+    {
+      return;
+    }
+    add(status, "Link capacity (bytes/s)", capacity_);
+    add(status, "Link committed out (bytes/s)", committed_);
+    add(status, "Link headroom in (bytes/s)", capacity_ - in_rate);
+    add(status, "Link headroom out (bytes/s)", capacity_ - out_rate);
+    add(status, "Link uncommitted out (bytes/s)", capacity_ - committed_);
+    if (std::max(in_rate, out_rate) > capacity_ * saturation)
+    {
+      if (status.level < diagnostic_msgs::DiagnosticStatus::WARN)
+      {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      }
+      status.message += ", link nearly saturated";
+    }
+  }
+
+private:
+  // The share of the capacity in use past which the link is reported as saturated.
+  static const double saturation;
+
+  template<typename T>
+  static void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const T& value)
+  {
+    std::ostringstream value_str;
+    value_str << value;
+    diagnostic_msgs::KeyValue kv;
+    kv.key = key;
+    kv.value = value_str.str();
+    status.values.push_back(kv);
+  }
+
+  double capacity_;
+  bool reject_;
+  std::map<uint16_t, double> commitments_;
+  double committed_;
+};
+
+const double LinkBudget::saturation = 0.9;
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_LINK_BUDGET_H
@@ -0,0 +1,253 @@
+/**
+ *
+ *  \file
+ *  \brief      Recording and reading back the raw bytes of a link, for replay.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_LINK_CAPTURE_H
+#define ROSSERIAL_SERVER_LINK_CAPTURE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Appends what goes over a link to a file, exactly as it was read or written:
+ * every chunk of bytes, stamped with the wall time it arrived or was queued at,
+ * followed by an index record for each frame found in or built from them. The
+ * replay_capture tool feeds a capture back into a Session, so that changes to
+ * parsing and dispatch can be measured against real traffic.
+ *
+ * The file is a fixed header, then records, each a Record followed by its data,
+ * padded to a multiple of eight bytes, so a mapped capture can be walked in place.
+ * Everything is in host byte order. Each direction's bytes are numbered from zero,
+ * and records give the number of the first one they cover, so a frame's record
+ * locates it among the chunks even when it straddles several.
+ */
+class LinkCapture : boost::noncopyable
+{
+public:
+  enum Type
+  {
+    SESSION_START,  // The session (re)started, and both directions begin again at zero.
+    IN_CHUNK,       // Bytes read from the client, as one read returned them.
+    OUT_CHUNK,      // Bytes of a frame for the client, as queued to be written.
+    IN_FRAME,       // A frame found in the bytes from the client; no data.
+    OUT_FRAME,      // A frame for the client; no data.
+    TYPE_COUNT
+  };
+
+  struct Record
+  {
+    uint64_t stamp;     // Wall time, ns.
+    uint64_t offset;    // Number of the first byte covered, in its direction.
+    uint32_t length;    // Bytes covered, which for chunks follow the record.
+    uint16_t topic_id;  // Frames only.
+    uint8_t type;
+    uint8_t reserved;
+  };
+
+  static const char* magic() { return "RSLCAP01"; }
+  enum { magic_bytes = 8, alignment = 8 };
+
+  LinkCapture() : file_(NULL), in_bytes_(0), out_bytes_(0) {}
+
+  ~LinkCapture()
+  {
+    close();
+  }
+
+  /**
+   * @brief Starts appending to the given file, writing the header if it's new.
+   */
+  bool open(const std::string& path)
+  {
+    close();
+    file_ = fopen(path.c_str(), "ab");
+    if (!file_) return false;
+    if (ftell(file_) == 0) fwrite(magic(), 1, magic_bytes, file_);
+    return !ferror(file_);
+  }
+
+  void close()
+  {
+    if (file_) fclose(file_);
+    file_ = NULL;
+  }
+
+  bool enabled() const
+  {
+    return file_ != NULL;
+  }
+
+  void flush()
+  {
+    if (file_) fflush(file_);
+  }
+
+  /**
+   * @brief Numbers of the next bytes to be captured in each direction.
+   */
+  uint64_t in_bytes() const { return in_bytes_; }
+  uint64_t out_bytes() const { return out_bytes_; }
+
+  void session_start()
+  {
+    in_bytes_ = out_bytes_ = 0;
+    append(SESSION_START, 0, 0, 0, NULL);
+  }
+
+  void in_chunk(const uint8_t* data, size_t length)
+  {
+    append(IN_CHUNK, in_bytes_, length, 0, data);
+    in_bytes_ += length;
+  }
+
+  /**
+   * @brief An inbound frame of the given length, starting at the byte numbered offset.
+   */
+  void in_frame(uint64_t offset, size_t length, uint16_t topic_id)
+  {
+    append(IN_FRAME, offset, length, topic_id, NULL);
+  }
+
+  /**
+   * @brief An outbound frame, which is captured as a chunk of its own.
+   */
+  void out_frame(const uint8_t* data, size_t length, uint16_t topic_id)
+  {
+    append(OUT_CHUNK, out_bytes_, length, 0, data);
+    append(OUT_FRAME, out_bytes_, length, topic_id, NULL);
+    out_bytes_ += length;
+  }
+
+  static size_t padded(size_t length)
+  {
+    return (length + alignment - 1) / alignment * alignment;
+  }
+
+private:
+  void append(Type type, uint64_t offset, size_t length, uint16_t topic_id, const uint8_t* data)
+  {
+    if (!file_) return;
+    Record record = { static_cast<uint64_t>(ros::WallTime::now().toNSec()), offset,
+                      static_cast<uint32_t>(length), topic_id, static_cast<uint8_t>(type), 0 };
+    fwrite(&record, sizeof(record), 1, file_);
+    if (data)
+    {
+      static const uint8_t padding[alignment] = { 0 };
+      fwrite(data, 1, length, file_);
+      fwrite(padding, 1, padded(length) - length, file_);
+    }
+  }
+
+  FILE* file_;
+  uint64_t in_bytes_;
+  uint64_t out_bytes_;
+};
+
+/**
+ * A capture written by LinkCapture, mapped read-only, to be walked a record at a time.
+ */
+class LinkCaptureReader : boost::noncopyable
+{
+public:
+  LinkCaptureReader() : data_(NULL), size_(0), next_(0) {}
+
+  ~LinkCaptureReader()
+  {
+    if (data_) munmap(data_, size_);
+  }
+
+  bool open(const std::string& path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= LinkCapture::magic_bytes)
+    {
+      void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+      {
+        data_ = static_cast<uint8_t*>(data);
+        size_ = st.st_size;
+      }
+    }
+    ::close(fd);
+    if (!data_ || memcmp(data_, LinkCapture::magic(), LinkCapture::magic_bytes) != 0) return false;
+    rewind();
+    return true;
+  }
+
+  void rewind()
+  {
+    next_ = LinkCapture::magic_bytes;
+  }
+
+  /**
+   * @brief The next record, and its data if it has any, or false at the end of the
+   *        capture. A record cut short, as by the server being killed mid-write,
+   *        ends it.
+   */
+  bool next(const LinkCapture::Record*& record, const uint8_t*& data)
+  {
+    if (size_ - next_ < sizeof(LinkCapture::Record)) return false;
+    const LinkCapture::Record* r = reinterpret_cast<const LinkCapture::Record*>(data_ + next_);
+    size_t bytes = sizeof(LinkCapture::Record);
+    if (r->type == LinkCapture::IN_CHUNK || r->type == LinkCapture::OUT_CHUNK)
+    {
+      bytes += LinkCapture::padded(r->length);
+    }
+    if (size_ - next_ < bytes) return false;
+    record = r;
+    data = data_ + next_ + sizeof(LinkCapture::Record);
+    next_ += bytes;
+    return true;
+  }
+
+private:
+  uint8_t* data_;
+  size_t size_;
+  size_t next_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_LINK_CAPTURE_H
@@ -0,0 +1,249 @@
+/**
+ *
+ *  \file
+ *  \brief      Expanding the deferred log messages of clients.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_LOG_DICTIONARY_H
+#define ROSSERIAL_SERVER_LOG_DICTIONARY_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * The format strings of the deferred log messages clients send on
+ * TopicInfo::ID_LOG_DEFERRED, by their ids, for formatting the messages here
+ * rather than on the client. They come from the same dictionary of names to
+ * format strings from which make_log_dictionary generates the firmware's
+ * ids, loaded as a parameter.
+ */
+class LogDictionary
+{
+public:
+  /**
+   * @brief The id of a format string: its FNV-1a hash, as make_log_dictionary
+   *        gives it.
+   */
+  static uint32_t id(const std::string& format)
+  {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < format.size(); i++) {
+      h = (h ^ static_cast<uint8_t>(format[i])) * 16777619u;
+    }
+    return h;
+  }
+
+  /**
+   * @brief Takes the format strings from a dictionary of names to them,
+   *        returning false if it's anything else.
+   */
+  bool load(XmlRpc::XmlRpcValue& dictionary)
+  {
+    if (dictionary.getType() != XmlRpc::XmlRpcValue::TypeStruct) {
+      return false;
+    }
+    for (XmlRpc::XmlRpcValue::iterator it = dictionary.begin(); it != dictionary.end(); ++it) {
+      if (it->second.getType() != XmlRpc::XmlRpcValue::TypeString) {
+        ROS_WARN_STREAM("Ignoring log message " << it->first << ", whose format isn't a string.");
+        continue;
+      }
+      const std::string& format = it->second;
+      formats_[id(format)] = format;
+    }
+    return true;
+  }
+
+  size_t size() const
+  {
+    return formats_.size();
+  }
+
+  /**
+   * @brief Formats the message in the body of a deferred log frame: its level,
+   *        the 32-bit id of its format string, then its arguments, each a tag
+   *        and a value. Returns false if it's too short to have an id.
+   */
+  bool expand(const uint8_t* data, size_t length, uint8_t& level, std::string& text) const
+  {
+    if (length < 5) {
+      return false;
+    }
+    level = data[0];
+    uint32_t format_id = read32(data + 1);
+
+    std::vector<Argument> args;
+    size_t offset = 5;
+    while (offset < length) {
+      Argument arg;
+      arg.tag = data[offset++];
+      if ((arg.tag == 'i' || arg.tag == 'u' || arg.tag == 'f') && offset + 4 <= length) {
+        arg.bits = read32(data + offset);
+        offset += 4;
+      } else if (arg.tag == 's' && offset < length) {
+        size_t n = std::min<size_t>(data[offset], length - offset - 1);
+        arg.text.assign(reinterpret_cast<const char*>(data + offset + 1), n);
+        offset += 1 + n;
+      } else {
+        break;
+      }
+      args.push_back(arg);
+    }
+
+    std::map<uint32_t, std::string>::const_iterator it = formats_.find(format_id);
+    if (it != formats_.end()) {
+      text = format(it->second, args);
+    } else {
+      char id_text[11];
+      snprintf(id_text, sizeof(id_text), "0x%08x", format_id);
+      text = std::string("Log message ") + id_text + ", not in ~log_dictionary:";
+      for (size_t i = 0; i < args.size(); i++) {
+        text += " " + args[i].as_string();
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Argument
+  {
+    Argument() : tag(0), bits(0) {}
+
+    long long as_integer() const
+    {
+      if (tag == 'i') return static_cast<int32_t>(bits);
+      if (tag == 'f') return static_cast<long long>(as_float());
+      if (tag == 's') return 0;
+      return bits;
+    }
+
+    double as_float() const
+    {
+      if (tag != 'f') return static_cast<double>(as_integer());
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+
+    std::string as_string() const
+    {
+      if (tag == 's') return text;
+      std::ostringstream ss;
+      if (tag == 'f') ss << as_float(); else ss << as_integer();
+      return ss.str();
+    }
+
+    uint8_t tag;
+    uint32_t bits;
+    std::string text;
+  };
+
+  static uint32_t read32(const uint8_t* data)
+  {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+  }
+
+  template<typename T>
+  static std::string print(const std::string& spec, T value)
+  {
+    int n = snprintf(NULL, 0, spec.c_str(), value);
+    if (n <= 0) return "";
+    std::vector<char> buffer(n + 1);
+    snprintf(&buffer[0], buffer.size(), spec.c_str(), value);
+    return std::string(&buffer[0], n);
+  }
+
+  // As printf would, taking each argument as whichever of an integer, a float
+  // or a string its conversion asks for. Length modifiers are skipped, since
+  // the arguments carry their own sizes, and conversions with no argument left
+  // are copied through as they are.
+  static std::string format(const std::string& format, const std::vector<Argument>& args)
+  {
+    std::string out;
+    size_t next = 0;
+    for (size_t i = 0; i < format.size(); i++) {
+      if (format[i] != '%') {
+        out += format[i];
+        continue;
+      }
+      if (i + 1 < format.size() && format[i + 1] == '%') {
+        out += '%';
+        i++;
+        continue;
+      }
+      size_t end = format.find_first_not_of("-+ #0", i + 1);
+      end = format.find_first_not_of("0123456789", end);
+      if (end != std::string::npos && format[end] == '.') {
+        end = format.find_first_not_of("0123456789", end + 1);
+      }
+      std::string spec = format.substr(i, end == std::string::npos ? std::string::npos : end - i);
+      end = format.find_first_not_of("hlLqjzt", end);
+      if (end == std::string::npos || next >= args.size() ||
+          std::strchr("diouxXceEfFgGaAs", format[end]) == NULL) {
+        out += format.substr(i, end == std::string::npos ? std::string::npos : end + 1 - i);
+        if (end == std::string::npos) break;
+        i = end;
+        continue;
+      }
+
+      char conversion = format[end];
+      const Argument& arg = args[next++];
+      if (conversion == 'd' || conversion == 'i') {
+        out += print(spec + "lld", arg.as_integer());
+      } else if (std::strchr("ouxX", conversion)) {
+        out += print(spec + "ll" + conversion, static_cast<unsigned long long>(
+            arg.tag == 'f' ? arg.as_integer() : static_cast<long long>(arg.bits)));
+      } else if (conversion == 'c') {
+        out += print(spec + "c", static_cast<int>(arg.as_integer()));
+      } else if (conversion == 's') {
+        out += print(spec + "s", arg.as_string().c_str());
+      } else {
+        out += print(spec + conversion, arg.as_float());
+      }
+      i = end;
+    }
+    return out;
+  }
+
+  std::map<uint32_t, std::string> formats_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_LOG_DICTIONARY_H
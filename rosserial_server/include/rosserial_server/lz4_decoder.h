@@ -0,0 +1,124 @@
+/**
+ *
+ *  \file
+ *  \brief      Decompression of the LZ4 compressed messages clients may send.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_LZ4_DECODER_H
+#define ROSSERIAL_SERVER_LZ4_DECODER_H
+
+#include <cstring>
+#include <stdint.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Decodes the LZ4 block format, which clients which have been offered
+ * compression may send messages on some topics in, to save link bandwidth.
+ */
+class Lz4Decoder
+{
+public:
+  /**
+   * @brief Decompresses [in, in + length) into exactly out_length bytes at out. Returns
+   *        false if the input is damaged, or doesn't decompress to that many bytes.
+   */
+  static bool decompress(const uint8_t* in, size_t length, uint8_t* out, size_t out_length)
+  {
+    const uint8_t* end = in + length;
+    size_t o = 0;
+    while (in < end)
+    {
+      uint8_t token = *in++;
+      size_t literals = token >> 4;
+      if (literals == 15 && !read_length(in, end, literals))
+      {
+        return false;
+      }
+      if (literals > static_cast<size_t>(end - in) || literals > out_length - o)
+      {
+        return false;
+      }
+      memcpy(out + o, in, literals);
+      in += literals;
+      o += literals;
+
+      // The last sequence is literals only.
+      if (in == end)
+      {
+        break;
+      }
+      if (end - in < 2)
+      {
+        return false;
+      }
+      size_t offset = in[0] | (in[1] << 8);
+      in += 2;
+      size_t match = token & 15;
+      if ((match == 15 && !read_length(in, end, match)) || offset == 0 || offset > o)
+      {
+        return false;
+      }
+      match += 4;
+      if (match > out_length - o)
+      {
+        return false;
+      }
+      // Byte by byte, as a match may overlap the bytes it is producing.
+      for (const uint8_t* from = out + o - offset; match > 0; match--)
+      {
+        out[o++] = *from++;
+      }
+    }
+    return o == out_length;
+  }
+
+private:
+  static bool read_length(const uint8_t*& in, const uint8_t* end, size_t& length)
+  {
+    uint8_t byte;
+    do
+    {
+      if (in == end)
+      {
+        return false;
+      }
+      byte = *in++;
+      length += byte;
+    }
+    while (byte == 255);
+    return true;
+  }
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_LZ4_DECODER_H
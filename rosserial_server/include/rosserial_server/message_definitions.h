@@ -0,0 +1,317 @@
+/**
+ *
+ *  \file
+ *  \brief      Message and service definitions resolved from the .msg and .srv files on disk.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_MESSAGE_DEFINITIONS_H
+#define ROSSERIAL_SERVER_MESSAGE_DEFINITIONS_H
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <rosserial_msgs/RequestServiceInfo.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Works out the MD5 sums and full definitions which the message_info and
+ * service_info services give, straight from the .msg and .srv files found
+ * through ros::package, the way genmsg does. This saves waiting on another
+ * node, and the Python imports it does, for each type a client brings; those
+ * services are only called for types without their files installed.
+ */
+class MessageDefinitions : boost::noncopyable
+{
+public:
+  typedef rosserial_msgs::RequestServiceInfo::Response ServiceInfo;
+
+  static MessageDefinitions& instance()
+  {
+    static MessageDefinitions definitions;
+    return definitions;
+  }
+
+  bool lookup_message(const std::string& type, std::string& md5sum, std::string& definition)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    const Spec* spec = load_message(type);
+    if (!spec) return false;
+    md5sum = spec->md5sum;
+
+    // The type's own text, then that of each type it depends on, as it's first
+    // come across, depth first.
+    std::vector<std::string> depends;
+    std::set<std::string> seen;
+    all_depends(*spec, depends, seen);
+    definition = spec->text + "\n";
+    for (size_t i = 0; i < depends.size(); i++) {
+      definition += std::string(80, '=') + "\nMSG: " + depends[i] + "\n" + specs_[depends[i]].text + "\n";
+    }
+    definition.erase(definition.size() - 1);
+    return true;
+  }
+
+  bool lookup_service(const std::string& type, ServiceInfo& info)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::string package, name, text;
+    if (!split_type(type, package, name) || !read_file(package, "srv", name, text)) return false;
+
+    // Everything from a line starting ---, with comments taken out, is the response.
+    std::string parts[2];
+    int part = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = text.find('\n', start);
+      if (end == std::string::npos) end = text.size();
+      std::string line = text.substr(start, end - start);
+      line = trim(line.substr(0, line.find('#')));
+      if (line.compare(0, 3, "---") == 0) {
+        part = 1;
+      } else {
+        parts[part] += line + "\n";
+      }
+      start = end + 1;
+    }
+
+    Spec request, response;
+    if (!parse(parts[0], package, request) || !parse(parts[1], package, response)) return false;
+    info.request_md5 = md5(request.md5_text);
+    info.response_md5 = md5(response.md5_text);
+    info.service_md5 = md5(request.md5_text + response.md5_text);
+    return true;
+  }
+
+private:
+  struct Spec
+  {
+    std::string text;
+    std::string md5_text;
+    std::string md5sum;
+    std::vector<std::string> depends;
+  };
+
+  MessageDefinitions() {}
+
+  const Spec* load_message(const std::string& type)
+  {
+    std::map<std::string, Spec>::iterator it = specs_.find(type);
+    if (it != specs_.end()) return &it->second;
+
+    std::string package, name;
+    Spec spec;
+    if (!split_type(type, package, name) || !read_file(package, "msg", name, spec.text) ||
+        !parse(spec.text, package, spec)) {
+      return NULL;
+    }
+    spec.md5sum = md5(spec.md5_text);
+    return &(specs_[type] = spec);
+  }
+
+  void all_depends(const Spec& spec, std::vector<std::string>& depends, std::set<std::string>& seen)
+  {
+    for (size_t i = 0; i < spec.depends.size(); i++) {
+      if (seen.insert(spec.depends[i]).second) depends.push_back(spec.depends[i]);
+      all_depends(specs_[spec.depends[i]], depends, seen);
+    }
+  }
+
+  /**
+   * Fills in the text genmsg takes the MD5 sum of, and the types depended on, loading
+   * those as it goes. The text has the constants, then the fields, one to a line, with
+   * each field of a message type given as that type's MD5 sum.
+   */
+  bool parse(const std::string& text, const std::string& package, Spec& spec)
+  {
+    std::string constants, fields;
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = text.find('\n', start);
+      if (end == std::string::npos) end = text.size();
+      std::string line = text.substr(start, end - start);
+      start = end + 1;
+
+      std::string clean = trim(line.substr(0, line.find('#')));
+      if (clean.empty()) continue;
+      std::string field_type = clean.substr(0, clean.find_first_of(" \t"));
+      std::string rest = trim(clean.substr(field_type.size()));
+
+      if (clean.find('=') != std::string::npos) {
+        std::string constant_name, value;
+        if (field_type == "string") {
+          // A string constant is everything after the =, comment characters and all.
+          size_t equals = line.find('=');
+          size_t space = line.find(' ');
+          constant_name = trim(line.substr(space + 1, equals - space - 1));
+          value = trim(line.substr(equals + 1));
+        } else {
+          constant_name = trim(rest.substr(0, rest.find('=')));
+          value = trim(rest.substr(rest.find('=') + 1));
+        }
+        constants += field_type + " " + constant_name + "=" + value + "\n";
+        continue;
+      }
+
+      std::string base_type = field_type.substr(0, field_type.find('['));
+      if (is_builtin(base_type)) {
+        fields += field_type + " " + rest + "\n";
+        continue;
+      }
+      std::string depend = base_type == "Header" ? "std_msgs/Header" :
+          base_type.find('/') == std::string::npos ? package + "/" + base_type : base_type;
+      const Spec* depend_spec = load_message(depend);
+      if (!depend_spec) {
+        ROS_DEBUG_STREAM("Can't resolve " << depend << ", which " << package << " depends on.");
+        return false;
+      }
+      fields += depend_spec->md5sum + " " + rest + "\n";
+      spec.depends.push_back(depend);
+    }
+    spec.md5_text = trim(constants + fields);
+    return true;
+  }
+
+  static bool is_builtin(const std::string& type)
+  {
+    static const char* builtins[] = { "bool", "int8", "uint8", "int16", "uint16", "int32", "uint32",
+        "int64", "uint64", "float32", "float64", "string", "time", "duration", "char", "byte" };
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+      if (type == builtins[i]) return true;
+    }
+    return false;
+  }
+
+  static bool split_type(const std::string& type, std::string& package, std::string& name)
+  {
+    size_t slash = type.find('/');
+    if (slash == std::string::npos) return false;
+    package = type.substr(0, slash);
+    name = type.substr(slash + 1);
+    return true;
+  }
+
+  static bool read_file(const std::string& package, const std::string& kind, const std::string& name,
+                        std::string& text)
+  {
+    std::string path = ros::package::getPath(package);
+    if (path.empty()) return false;
+    path += "/" + kind + "/" + name + "." + kind;
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file) return false;
+    text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  static std::string trim(const std::string& str)
+  {
+    const char* whitespace = " \t\r\n";
+    size_t start = str.find_first_not_of(whitespace);
+    if (start == std::string::npos) return "";
+    return str.substr(start, str.find_last_not_of(whitespace) - start + 1);
+  }
+
+  /**
+   * MD5 of a string, in hex, as RFC 1321 has it.
+   */
+  static std::string md5(const std::string& data)
+  {
+    static const uint32_t k[64] = {
+      0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+      0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+      0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+      0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+      0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+      0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+      0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+      0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+    static const int r[64] = {
+      7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+      5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+      4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+      6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21 };
+
+    // Padded with a one bit, zeros, and the length in bits, to a whole number of blocks.
+    std::vector<uint8_t> message(data.begin(), data.end());
+    uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    message.push_back(0x80);
+    while (message.size() % 64 != 56) message.push_back(0);
+    for (int i = 0; i < 8; i++) message.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    for (size_t block = 0; block < message.size(); block += 64) {
+      uint32_t w[16];
+      for (int i = 0; i < 16; i++) {
+        const uint8_t* p = &message[block + i * 4];
+        w[i] = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+      }
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+      for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16) { f = (b & c) | (~b & d); g = i; }
+        else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+        else if (i < 48) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+        else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+        uint32_t rotate = a + f + k[i] + w[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (rotate << r[i]) | (rotate >> (32 - r[i]));
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    }
+
+    char hex[33];
+    for (int i = 0; i < 16; i++) {
+      snprintf(hex + i * 2, 3, "%02x", (h[i / 4] >> (8 * (i % 4))) & 0xff);
+    }
+    return std::string(hex, 32);
+  }
+
+  boost::mutex mutex_;
+  std::map<std::string, Spec> specs_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_MESSAGE_DEFINITIONS_H
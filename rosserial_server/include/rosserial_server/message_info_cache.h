@@ -0,0 +1,242 @@
+/**
+ *
+ *  \file
+ *  \brief      Process-wide cache of message and service definitions looked up for clients.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_MESSAGE_INFO_CACHE_H
+#define ROSSERIAL_SERVER_MESSAGE_INFO_CACHE_H
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <rosserial_msgs/RequestServiceInfo.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Publishers and service clients need information from the message_info and
+ * service_info services, which are slow to call and may not even be up yet. What
+ * they return doesn't change for a given type and md5sum, so it's remembered here
+ * for every session in the process, and a client which reconnects, or a second
+ * client with the same topics, doesn't go back to the services for it.
+ *
+ * The TopicInfo frames a client negotiated are kept too, under the fingerprint the
+ * client gave them, so that a client which comes back with the same fingerprint can
+ * have its topics set up again without sending them all over.
+ *
+ * If the ~message_info_cache parameter names a file, the cache is also loaded from
+ * and saved to it, so that the information survives restarts of this node.
+ */
+class MessageInfoCache : boost::noncopyable
+{
+public:
+  typedef rosserial_msgs::RequestServiceInfo::Response ServiceInfo;
+  // The setup frames of a topic set, each as the topic id it came on and its body.
+  typedef std::vector<std::pair<uint16_t, std::vector<uint8_t> > > TopicSet;
+
+  static MessageInfoCache& instance()
+  {
+    static MessageInfoCache cache;
+    return cache;
+  }
+
+  bool getDefinition(const std::string& type, const std::string& md5sum, std::string& definition)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<Key, std::string>::const_iterator it = definitions_.find(Key(type, md5sum));
+    if (it == definitions_.end()) return false;
+    definition = it->second;
+    return true;
+  }
+
+  void putDefinition(const std::string& type, const std::string& md5sum, const std::string& definition)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    definitions_[Key(type, md5sum)] = definition;
+    save();
+  }
+
+  bool getServiceInfo(const std::string& type, const std::string& md5sum, ServiceInfo& info)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<Key, ServiceInfo>::const_iterator it = services_.find(Key(type, md5sum));
+    if (it == services_.end()) return false;
+    info = it->second;
+    return true;
+  }
+
+  void putServiceInfo(const std::string& type, const std::string& md5sum, const ServiceInfo& info)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    services_[Key(type, md5sum)] = info;
+    save();
+  }
+
+  bool getTopicSet(uint32_t fingerprint, TopicSet& topics)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<uint32_t, TopicSet>::const_iterator it = topic_sets_.find(fingerprint);
+    if (it == topic_sets_.end()) return false;
+    topics = it->second;
+    return true;
+  }
+
+  void putTopicSet(uint32_t fingerprint, const TopicSet& topics)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    topic_sets_[fingerprint] = topics;
+    save();
+  }
+
+private:
+  typedef std::pair<std::string, std::string> Key;
+  enum { message_record_fields = 4, service_record_fields = 6 };
+
+  MessageInfoCache()
+  {
+    ros::param::param<std::string>("~message_info_cache", path_, "");
+    load();
+  }
+
+  /**
+   * The file holds a single serialized std::vector<std::string>, in which each record
+   * is a kind field ("msg" or "srv") followed by a fixed number of fields for that kind,
+   * or "set", the fingerprint and the number of frames, followed by the topic id and
+   * body of each.
+   */
+  void load()
+  {
+    if (path_.empty()) return;
+
+    std::ifstream file(path_.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+      ROS_DEBUG_STREAM("No message info cache at " << path_ << " yet.");
+      return;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::vector<std::string> fields;
+    try {
+      ros::serialization::IStream stream(bytes.empty() ? NULL : &bytes[0], bytes.size());
+      ros::serialization::deserialize(stream, fields);
+    } catch(ros::serialization::StreamOverrunException e) {
+      ROS_WARN_STREAM("Message info cache at " << path_ << " is corrupt, ignoring it.");
+      return;
+    }
+
+    for (size_t i = 0; i < fields.size(); ) {
+      if (fields[i] == "msg" && i + message_record_fields <= fields.size()) {
+        definitions_[Key(fields[i + 1], fields[i + 2])] = fields[i + 3];
+        i += message_record_fields;
+      } else if (fields[i] == "srv" && i + service_record_fields <= fields.size()) {
+        ServiceInfo& info = services_[Key(fields[i + 1], fields[i + 2])];
+        info.service_md5 = fields[i + 3];
+        info.request_md5 = fields[i + 4];
+        info.response_md5 = fields[i + 5];
+        i += service_record_fields;
+      } else if (fields[i] == "set" && i + 3 <= fields.size() &&
+                 i + 3 + 2 * strtoul(fields[i + 2].c_str(), NULL, 10) <= fields.size()) {
+        TopicSet& topics = topic_sets_[strtoul(fields[i + 1].c_str(), NULL, 10)];
+        size_t count = strtoul(fields[i + 2].c_str(), NULL, 10);
+        i += 3;
+        for (size_t j = 0; j < count; j++, i += 2) {
+          topics.push_back(std::make_pair(static_cast<uint16_t>(strtoul(fields[i].c_str(), NULL, 10)),
+                                          std::vector<uint8_t>(fields[i + 1].begin(), fields[i + 1].end())));
+        }
+      } else {
+        ROS_WARN_STREAM("Message info cache at " << path_ << " has an unrecognized record, ignoring the rest.");
+        break;
+      }
+    }
+    ROS_INFO_STREAM("Loaded " << definitions_.size() << " message and " << services_.size() <<
+                    " service definitions, and " << topic_sets_.size() << " topic sets, from " << path_);
+  }
+
+  void save()
+  {
+    if (path_.empty()) return;
+
+    std::vector<std::string> fields;
+    for (std::map<Key, std::string>::const_iterator it = definitions_.begin(); it != definitions_.end(); ++it) {
+      fields.push_back("msg");
+      fields.push_back(it->first.first);
+      fields.push_back(it->first.second);
+      fields.push_back(it->second);
+    }
+    for (std::map<Key, ServiceInfo>::const_iterator it = services_.begin(); it != services_.end(); ++it) {
+      fields.push_back("srv");
+      fields.push_back(it->first.first);
+      fields.push_back(it->first.second);
+      fields.push_back(it->second.service_md5);
+      fields.push_back(it->second.request_md5);
+      fields.push_back(it->second.response_md5);
+    }
+    for (std::map<uint32_t, TopicSet>::const_iterator it = topic_sets_.begin(); it != topic_sets_.end(); ++it) {
+      fields.push_back("set");
+      fields.push_back(boost::lexical_cast<std::string>(it->first));
+      fields.push_back(boost::lexical_cast<std::string>(it->second.size()));
+      for (TopicSet::const_iterator topic = it->second.begin(); topic != it->second.end(); ++topic) {
+        fields.push_back(boost::lexical_cast<std::string>(topic->first));
+        fields.push_back(std::string(topic->second.begin(), topic->second.end()));
+      }
+    }
+
+    std::vector<uint8_t> bytes(ros::serialization::serializationLength(fields));
+    ros::serialization::OStream stream(bytes.empty() ? NULL : &bytes[0], bytes.size());
+    ros::serialization::serialize(stream, fields);
+
+    std::ofstream file(path_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.empty() ? NULL : &bytes[0]), bytes.size());
+    if (!file) {
+      ROS_WARN_STREAM_ONCE("Unable to write message info cache to " << path_);
+    }
+  }
+
+  boost::mutex mutex_;
+  std::string path_;
+  std::map<Key, std::string> definitions_;
+  std::map<Key, ServiceInfo> services_;
+  std::map<uint32_t, TopicSet> topic_sets_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_MESSAGE_INFO_CACHE_H
@@ -0,0 +1,179 @@
+/**
+ *
+ *  \file
+ *  \brief      Receive memory which is mapped twice, back to back, so that it wraps.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_MIRRORED_BUFFER_H
+#define ROSSERIAL_SERVER_MIRRORED_BUFFER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * The same pages of memory are mapped at data() and again at data() + size(), so
+ * any run of up to size() bytes starting within the first mapping is contiguous,
+ * however it straddles the end. A ring buffer on top of this never has to split
+ * a read, nor shift its contents back to the start to make room.
+ *
+ * The size is rounded up to a whole number of pages. If the mapping can't be set
+ * up, this falls back to ordinary memory of the requested size, and mirrored()
+ * returns false, in which case the owner must compact the buffer itself.
+ */
+class MirroredBuffer : boost::noncopyable
+{
+public:
+  explicit MirroredBuffer(size_t capacity = 0)
+    : data_(NULL), size_(0), mirrored_(false)
+  {
+    resize(capacity);
+  }
+
+  ~MirroredBuffer()
+  {
+    unmap();
+  }
+
+  /**
+   * @brief Replaces the memory with a fresh buffer of at least the given size; existing
+   *        content is not preserved.
+   */
+  void resize(size_t capacity)
+  {
+    unmap();
+    fallback_.clear();
+    if (capacity == 0)
+    {
+      return;
+    }
+
+    if (!map(capacity))
+    {
+      ROS_DEBUG("Unable to map mirrored read buffer, using a compacting one instead.");
+      fallback_.resize(capacity);
+      data_ = &fallback_[0];
+      size_ = capacity;
+      mirrored_ = false;
+    }
+  }
+
+  void swap(MirroredBuffer& other)
+  {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mirrored_, other.mirrored_);
+    fallback_.swap(other.fallback_);
+  }
+
+  uint8_t* data() { return data_; }
+  size_t size() const { return size_; }
+  bool mirrored() const { return mirrored_; }
+
+private:
+  bool map(size_t capacity)
+  {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (capacity + page - 1) / page * page;
+
+    // The file only exists to give the two mappings something to share; it's
+    // unlinked right away, and goes when the mappings do.
+    const char* dir = getenv("TMPDIR");
+    std::string path_template = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : (dir ? dir : "/tmp");
+    path_template += "/rosserial_server_XXXXXX";
+    std::vector<char> path(path_template.begin(), path_template.end());
+    path.push_back('\0');
+
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+    {
+      return false;
+    }
+    unlink(&path[0]);
+
+    bool ok = false;
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+    {
+      // Reserve the whole range first, so that nothing else can land in the second half.
+      base = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (base != MAP_FAILED)
+    {
+      uint8_t* first = static_cast<uint8_t*>(base);
+      ok = mmap(first, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == first &&
+           mmap(first + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == first + size;
+      if (!ok)
+      {
+        munmap(base, size * 2);
+      }
+    }
+    close(fd);
+
+    if (ok)
+    {
+      data_ = static_cast<uint8_t*>(base);
+      size_ = size;
+      mirrored_ = true;
+    }
+    return ok;
+  }
+
+  void unmap()
+  {
+    if (mirrored_)
+    {
+      munmap(data_, size_ * 2);
+    }
+    data_ = NULL;
+    size_ = 0;
+    mirrored_ = false;
+  }
+
+  uint8_t* data_;
+  size_t size_;
+  bool mirrored_;
+  std::vector<uint8_t> fallback_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_MIRRORED_BUFFER_H
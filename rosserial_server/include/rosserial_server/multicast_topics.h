@@ -0,0 +1,250 @@
+/**
+ *
+ *  \file
+ *  \brief      Sending topics once to a multicast group for many clients.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_MULTICAST_TOPICS_H
+#define ROSSERIAL_SERVER_MULTICAST_TOPICS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <rosserial_msgs/TopicInfo.h>
+#include <topic_tools/shape_shifter.h>
+
+#include "rosserial_server/callback_queue.h"
+#include "rosserial_server/frame_parser.h"
+
+namespace rosserial_server
+{
+
+class MulticastTopics;
+typedef boost::shared_ptr<MulticastTopics> MulticastTopicsPtr;
+
+/**
+ * Subscribes once to each of the topics listed in ~multicast_topics, and sends
+ * each message on them as one datagram to a multicast group, for every client
+ * which has joined the topic to read there, rather than serializing and writing
+ * it once per session. Each topic has an id of its own in the group,
+ * multicast_id_base and up, which the frames in the datagrams are sent on; the
+ * session tells its client which, and where the group is, as the client
+ * subscribes. Nothing is sent on a topic while no client has joined it.
+ */
+class MulticastTopics
+{
+public:
+  enum { multicast_id_base = 0x8000 };
+
+  /**
+   * Reads ~multicast_topics, a list of topic names, along with ~multicast_group
+   * (default 239.255.11.41), ~multicast_port (default 11412) and ~multicast_ttl
+   * (default 1, the local network). Returns null where there are no topics.
+   */
+  static MulticastTopicsPtr from_params(boost::asio::io_service& io_service)
+  {
+    std::vector<std::string> topics;
+    ros::param::get("~multicast_topics", topics);
+    if (topics.empty())
+    {
+      return MulticastTopicsPtr();
+    }
+    std::string group;
+    int port, ttl;
+    ros::param::param<std::string>("~multicast_group", group, "239.255.11.41");
+    ros::param::param<int>("~multicast_port", port, 11412);
+    ros::param::param<int>("~multicast_ttl", ttl, 1);
+    boost::system::error_code ec;
+    boost::asio::ip::address_v4 address = boost::asio::ip::address_v4::from_string(group, ec);
+    if (ec || !address.is_multicast())
+    {
+      ROS_ERROR_STREAM("~multicast_group " << group << " isn't an IPv4 multicast address; "
+                       "topics will be sent to each client directly.");
+      return MulticastTopicsPtr();
+    }
+    MulticastTopicsPtr multicast(new MulticastTopics(io_service,
+        boost::asio::ip::udp::endpoint(address, port), ttl));
+    for (size_t i = 0; i < topics.size(); ++i)
+    {
+      multicast->add(topics[i]);
+    }
+    ROS_INFO_STREAM("Sending " << topics.size() << " topics to clients through multicast group "
+                    << multicast->group());
+    return multicast;
+  }
+
+  MulticastTopics(boost::asio::io_service& io_service, const boost::asio::ip::udp::endpoint& group, int ttl)
+    : strand_(io_service), ros_callback_queue_(strand_), socket_(io_service), group_(group)
+  {
+    socket_.open(group.protocol());
+    socket_.set_option(boost::asio::ip::multicast::hops(ttl));
+    nh_.setCallbackQueue(&ros_callback_queue_);
+  }
+
+  ~MulticastTopics()
+  {
+    ros_callback_queue_.clear();
+  }
+
+  /**
+   * Adds a topic which clients may join, by its name as the node resolves it.
+   */
+  void add(const std::string& topic_name)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::string resolved = nh_.resolveName(topic_name);
+    if (topics_.count(resolved) == 0)
+    {
+      Topic& topic = topics_[resolved];
+      topic.id = multicast_id_base + topics_.size() - 1;
+      topic.members = 0;
+      topic.buffer_size = 0;
+    }
+  }
+
+  /**
+   * Joins a client's subscriber to the group for its topic, the name resolved,
+   * subscribing to it for the group on first use. Returns the id the topic is
+   * sent on in the group, or 0 where it isn't sent there, or the client's type
+   * doesn't match the one the group was set up for.
+   */
+  uint16_t join(const std::string& resolved_name, const rosserial_msgs::TopicInfo& topic_info)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<std::string, Topic>::iterator it = topics_.find(resolved_name);
+    if (it == topics_.end())
+    {
+      return 0;
+    }
+    Topic& topic = it->second;
+    if (!topic.md5.empty() && topic.md5 != topic_info.md5sum)
+    {
+      ROS_WARN_STREAM("Client subscribing to " << resolved_name << " as " << topic_info.message_type
+                      << " doesn't match the type it is sent to the multicast group as; sending it directly.");
+      return 0;
+    }
+    if (topic.md5.empty())
+    {
+      topic.md5 = topic_info.md5sum;
+      topic.subscriber = nh_.subscribe<topic_tools::ShapeShifter>(resolved_name, 1,
+          boost::bind(&MulticastTopics::handle, this, _1, resolved_name));
+    }
+    // A message goes to the group only if every client taking it there can
+    // take one that size.
+    if (topic.members == 0 || topic_info.buffer_size < topic.buffer_size)
+    {
+      topic.buffer_size = topic_info.buffer_size;
+    }
+    topic.members++;
+    return topic.id;
+  }
+
+  void leave(const std::string& resolved_name)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<std::string, Topic>::iterator it = topics_.find(resolved_name);
+    if (it != topics_.end() && it->second.members > 0)
+    {
+      it->second.members--;
+    }
+  }
+
+  const boost::asio::ip::udp::endpoint& group() const
+  {
+    return group_;
+  }
+
+private:
+  struct Topic
+  {
+    uint16_t id;
+    std::string md5;
+    ros::Subscriber subscriber;
+    int members;
+    int32_t buffer_size;
+  };
+
+  /**
+   * Runs on the strand: builds the message's frame once, and sends it to the
+   * group for all the clients which have joined the topic.
+   */
+  void handle(const topic_tools::ShapeShifter::ConstPtr& msg, const std::string& resolved_name)
+  {
+    uint16_t id;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      Topic& topic = topics_[resolved_name];
+      if (topic.members == 0 || msg->size() > static_cast<uint32_t>(topic.buffer_size))
+      {
+        return;
+      }
+      id = topic.id;
+    }
+
+    uint32_t length = msg->size();
+    frame_.resize(length + FrameParser::overhead_bytes);
+    frame_[0] = 0xff;
+    frame_[1] = FrameParser::protocol_ver2;
+    frame_[2] = length & 0xff;
+    frame_[3] = length >> 8;
+    frame_[4] = 255 - FrameParser::checksum(static_cast<uint16_t>(length));
+    frame_[5] = id & 0xff;
+    frame_[6] = id >> 8;
+    ros::serialization::OStream stream(&frame_[FrameParser::header_bytes], length);
+    msg->write(stream);
+    frame_.back() = 255 - FrameParser::checksum(&frame_[5], length + 2);
+
+    boost::system::error_code ec;
+    socket_.send_to(boost::asio::buffer(frame_), group_, 0, ec);
+    if (ec)
+    {
+      ROS_WARN_STREAM_THROTTLE(1, "Unable to send to multicast group " << group_ << ": " << ec.message());
+    }
+  }
+
+  boost::asio::io_service::strand strand_;
+  AsioCallbackQueue ros_callback_queue_;
+  ros::NodeHandle nh_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::ip::udp::endpoint group_;
+  boost::mutex mutex_;
+  std::map<std::string, Topic> topics_;
+  std::vector<uint8_t> frame_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_MULTICAST_TOPICS_H
@@ -0,0 +1,430 @@
+/**
+ *
+ *  \file
+ *  \brief      Converting float fields clients send as fixed point.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_QUANTIZATION_H
+#define ROSSERIAL_SERVER_QUANTIZATION_H
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * The conversion of messages of one type between their standard serialization
+ * and the one a client uses, in which some float fields, of the type or of those
+ * it's made of, are quantized. Made by Quantization::layout().
+ */
+class QuantizedLayout
+{
+public:
+  struct Quantized
+  {
+    double scale;
+    double offset;
+    size_t bytes;
+  };
+
+  /**
+   * @brief Converts a message as the client sends it into its standard
+   *        serialization. Returns false if it's damaged.
+   */
+  bool expand(const uint8_t* in, size_t length, std::vector<uint8_t>& out) const
+  {
+    return convert(in, length, out, true);
+  }
+
+  /**
+   * @brief Converts a message in its standard serialization into what the
+   *        client expects. Returns false if it's damaged.
+   */
+  bool pack(const uint8_t* in, size_t length, std::vector<uint8_t>& out) const
+  {
+    return convert(in, length, out, false);
+  }
+
+  /**
+   * @brief The integer a float is sent as, as the client's serializeQuantized
+   *        gives it: rounded, clamped, with the least integer for NaN.
+   */
+  static int32_t quantize(double value, const Quantized& q)
+  {
+    int32_t max = q.bytes >= 4 ? 0x7fffffff : static_cast<int32_t>((1u << (8 * q.bytes - 1)) - 1);
+    double scaled = (value - q.offset) / q.scale;
+    if (std::isnan(scaled)) return -max - 1;
+    if (scaled >= max) return max;
+    if (scaled <= -max) return -max;
+    return static_cast<int32_t>(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  }
+
+  static double unquantize(const uint8_t* data, const Quantized& q)
+  {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < q.bytes; i++) {
+      bits |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+    uint32_t sign = 1u << (8 * q.bytes - 1);
+    if (q.bytes < 4 && (bits & sign)) {
+      bits |= ~(sign - 1);
+    }
+    if (bits == ~(sign - 1)) {
+      return NAN;
+    }
+    return static_cast<int32_t>(bits) * q.scale + q.offset;
+  }
+
+private:
+  friend class Quantization;
+
+  enum Kind { kind_fixed, kind_string, kind_message, kind_quantized };
+
+  struct Field
+  {
+    Kind kind;
+    size_t size;       // of a fixed field, or of the float a quantized one stands for
+    int array;         // -1 if it's not an array, 0 if it's a variable-length one
+    size_t type;       // index in types_ of a message field's type
+    Quantized quantized;
+  };
+
+  bool convert(const uint8_t* in, size_t length, std::vector<uint8_t>& out, bool expanding) const
+  {
+    out.clear();
+    const uint8_t* end = in + length;
+    return walk(0, in, end, out, expanding) && in == end;
+  }
+
+  bool walk(size_t type, const uint8_t*& in, const uint8_t* end, std::vector<uint8_t>& out, bool expanding) const
+  {
+    const std::vector<Field>& fields = types_[type];
+    for (size_t i = 0; i < fields.size(); i++) {
+      const Field& field = fields[i];
+      uint32_t count = 1;
+      if (field.array == 0) {
+        if (end - in < 4) return false;
+        std::memcpy(&count, in, 4);
+        out.insert(out.end(), in, in + 4);
+        in += 4;
+      } else if (field.array > 0) {
+        count = field.array;
+      }
+      if (field.kind == kind_message && types_[field.type].empty()) {
+        continue;
+      }
+      for (uint32_t j = 0; j < count; j++) {
+        if (!element(field, in, end, out, expanding)) return false;
+      }
+    }
+    return true;
+  }
+
+  bool element(const Field& field, const uint8_t*& in, const uint8_t* end, std::vector<uint8_t>& out,
+               bool expanding) const
+  {
+    size_t size = field.size;
+    switch (field.kind) {
+    case kind_message:
+      return walk(field.type, in, end, out, expanding);
+    case kind_string: {
+      if (end - in < 4) return false;
+      uint32_t string_length;
+      std::memcpy(&string_length, in, 4);
+      if (static_cast<size_t>(end - in) - 4 < string_length) return false;
+      size = 4 + string_length;
+      break;
+    }
+    case kind_quantized:
+      if (expanding) {
+        if (static_cast<size_t>(end - in) < field.quantized.bytes) return false;
+        double value = unquantize(in, field.quantized);
+        in += field.quantized.bytes;
+        append_float(value, field.size, out);
+      } else {
+        if (static_cast<size_t>(end - in) < field.size) return false;
+        double value = read_float(in, field.size);
+        in += field.size;
+        uint32_t bits = static_cast<uint32_t>(quantize(value, field.quantized));
+        for (size_t i = 0; i < field.quantized.bytes; i++) {
+          out.push_back((bits >> (8 * i)) & 0xff);
+        }
+      }
+      return true;
+    case kind_fixed:
+      break;
+    }
+    if (static_cast<size_t>(end - in) < size) return false;
+    out.insert(out.end(), in, in + size);
+    in += size;
+    return true;
+  }
+
+  static double read_float(const uint8_t* data, size_t size)
+  {
+    if (size == 4) {
+      float value;
+      std::memcpy(&value, data, 4);
+      return value;
+    }
+    double value;
+    std::memcpy(&value, data, 8);
+    return value;
+  }
+
+  static void append_float(double value, size_t size, std::vector<uint8_t>& out)
+  {
+    uint8_t bytes[8];
+    if (size == 4) {
+      float f = static_cast<float>(value);
+      std::memcpy(bytes, &f, 4);
+    } else {
+      std::memcpy(bytes, &value, 8);
+    }
+    out.insert(out.end(), bytes, bytes + size);
+  }
+
+  // The fields of the message's type, first, and of each type it's made of.
+  std::vector<std::vector<Field> > types_;
+};
+
+typedef boost::shared_ptr<QuantizedLayout> QuantizedLayoutPtr;
+
+/**
+ * Float fields which clients' libraries were generated to send as fixed-point
+ * integers of fewer bytes, from the same YAML file of them make_library was
+ * given, loaded as a parameter:
+ *
+ *   sensor_msgs/BatteryState:
+ *     voltage: {scale: 0.001, bits: 16}
+ *
+ * Messages of the types with such fields, or made of types with them, are
+ * converted to and from their standard serialization as they pass through.
+ */
+class Quantization
+{
+public:
+  /**
+   * @brief Takes the fields from a dictionary of types to them, returning false
+   *        if it's anything else. Types may also be given a level down, under
+   *        their package, as rosparam may store them.
+   */
+  bool load(XmlRpc::XmlRpcValue& dictionary)
+  {
+    if (dictionary.getType() != XmlRpc::XmlRpcValue::TypeStruct) {
+      return false;
+    }
+    for (XmlRpc::XmlRpcValue::iterator it = dictionary.begin(); it != dictionary.end(); ++it) {
+      if (it->second.getType() != XmlRpc::XmlRpcValue::TypeStruct) {
+        ROS_WARN_STREAM("Ignoring quantization of " << it->first << ", which isn't a dictionary.");
+        continue;
+      }
+      if (it->first.find('/') != std::string::npos) {
+        load_type(it->first, it->second);
+        continue;
+      }
+      for (XmlRpc::XmlRpcValue::iterator type = it->second.begin(); type != it->second.end(); ++type) {
+        if (type->second.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+          load_type(it->first + "/" + type->first, type->second);
+        }
+      }
+    }
+    return true;
+  }
+
+  bool empty() const
+  {
+    return fields_.empty();
+  }
+
+  /**
+   * @brief How to convert messages of a type, given its full definition, as
+   *        gendeps gives it; none if no field of it or of a type it's made of
+   *        is quantized.
+   */
+  QuantizedLayoutPtr layout(const std::string& type, const std::string& definition) const
+  {
+    std::map<std::string, std::string> texts;
+    split_definition(type, definition, texts);
+    QuantizedLayoutPtr layout(new QuantizedLayout);
+    std::map<std::string, size_t> indices;
+    bool quantized = false;
+    if (!add_type(type, texts, *layout, indices, quantized)) {
+      ROS_WARN_STREAM("Can't convert quantized fields of " << type << ", whose definition is incomplete.");
+      return QuantizedLayoutPtr();
+    }
+    return quantized ? layout : QuantizedLayoutPtr();
+  }
+
+private:
+  void load_type(const std::string& type, XmlRpc::XmlRpcValue& fields)
+  {
+    for (XmlRpc::XmlRpcValue::iterator it = fields.begin(); it != fields.end(); ++it) {
+      XmlRpc::XmlRpcValue& field = it->second;
+      QuantizedLayout::Quantized quantized;
+      if (field.getType() != XmlRpc::XmlRpcValue::TypeStruct || !field.hasMember("scale") ||
+          !field.hasMember("bits") || field["bits"].getType() != XmlRpc::XmlRpcValue::TypeInt ||
+          !number(field["scale"], quantized.scale) || quantized.scale == 0) {
+        ROS_WARN_STREAM("Ignoring quantization of " << type << "/" << it->first << ", which has no scale or bits.");
+        continue;
+      }
+      int bits = field["bits"];
+      quantized.offset = 0;
+      if ((bits != 8 && bits != 16 && bits != 32) ||
+          (field.hasMember("offset") && !number(field["offset"], quantized.offset))) {
+        ROS_WARN_STREAM("Ignoring quantization of " << type << "/" << it->first << ", whose bits or offset are bad.");
+        continue;
+      }
+      quantized.bytes = bits / 8;
+      fields_[type][it->first] = quantized;
+    }
+  }
+
+  static bool number(XmlRpc::XmlRpcValue& value, double& out)
+  {
+    if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+      out = static_cast<double>(value);
+    } else if (value.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+      out = static_cast<int>(value);
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // The definition of the type, and after it each of those it's made of, under
+  // a line of ='s and then one naming it.
+  static void split_definition(const std::string& type, const std::string& definition,
+                               std::map<std::string, std::string>& texts)
+  {
+    std::istringstream lines(definition);
+    std::string line;
+    std::string current = type;
+    while (std::getline(lines, line)) {
+      if (line.compare(0, 3, "===") == 0) {
+        continue;
+      }
+      if (line.compare(0, 5, "MSG: ") == 0) {
+        current = line.substr(5);
+        size_t end = current.find_last_not_of(" \t\r");
+        current.erase(end == std::string::npos ? 0 : end + 1);
+        continue;
+      }
+      texts[current] += line + "\n";
+    }
+  }
+
+  static size_t builtin_size(const std::string& type)
+  {
+    if (type == "bool" || type == "int8" || type == "uint8" || type == "byte" || type == "char") return 1;
+    if (type == "int16" || type == "uint16") return 2;
+    if (type == "int32" || type == "uint32" || type == "float32") return 4;
+    if (type == "int64" || type == "uint64" || type == "float64" || type == "time" || type == "duration") return 8;
+    return 0;
+  }
+
+  // Adds the fields of a type, after those it's made of, to the layout, noting
+  // whether any of them is quantized.
+  bool add_type(const std::string& type, const std::map<std::string, std::string>& texts,
+                QuantizedLayout& layout, std::map<std::string, size_t>& indices, bool& quantized) const
+  {
+    std::map<std::string, std::string>::const_iterator text = texts.find(type);
+    if (text == texts.end()) {
+      return false;
+    }
+    size_t index = layout.types_.size();
+    indices[type] = index;
+    layout.types_.push_back(std::vector<QuantizedLayout::Field>());
+    std::map<std::string, std::map<std::string, QuantizedLayout::Quantized> >::const_iterator type_fields =
+        fields_.find(type);
+    std::string package = type.substr(0, type.find('/'));
+
+    std::istringstream lines(text->second);
+    std::string line;
+    while (std::getline(lines, line)) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream words(line);
+      std::string field_type, name;
+      if (!(words >> field_type >> name) || line.find('=') != std::string::npos) {
+        continue;
+      }
+      QuantizedLayout::Field field;
+      field.array = -1;
+      field.type = 0;
+      size_t bracket = field_type.find('[');
+      if (bracket != std::string::npos) {
+        field.array = std::atoi(field_type.c_str() + bracket + 1);
+        field_type.erase(bracket);
+      }
+      field.size = builtin_size(field_type);
+      if (field.size) {
+        field.kind = QuantizedLayout::kind_fixed;
+        if (type_fields != fields_.end() && (field_type == "float32" || field_type == "float64") &&
+            type_fields->second.count(name)) {
+          field.kind = QuantizedLayout::kind_quantized;
+          field.quantized = type_fields->second.find(name)->second;
+          quantized = true;
+        }
+      } else if (field_type == "string") {
+        field.kind = QuantizedLayout::kind_string;
+      } else {
+        if (field_type == "Header") {
+          field_type = "std_msgs/Header";
+        } else if (field_type.find('/') == std::string::npos) {
+          field_type = package + "/" + field_type;
+        }
+        field.kind = QuantizedLayout::kind_message;
+        if (!indices.count(field_type) && !add_type(field_type, texts, layout, indices, quantized)) {
+          return false;
+        }
+        field.type = indices[field_type];
+      }
+      layout.types_[index].push_back(field);
+    }
+    return true;
+  }
+
+  // By type, then field name.
+  std::map<std::string, std::map<std::string, QuantizedLayout::Quantized> > fields_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_QUANTIZATION_H
@@ -0,0 +1,164 @@
+/**
+ *
+ *  \file
+ *  \brief      Message type which lets roscpp serialize bytes owned by
+ *              someone else, such as a session's read buffer.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_RAW_MESSAGE_H
+#define ROSSERIAL_SERVER_RAW_MESSAGE_H
+
+#include <string>
+
+#include <ros/ros.h>
+#include <ros/message_traits.h>
+#include <ros/serialization.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Like topic_tools::ShapeShifter, this takes on whatever type it is morphed
+ * into, but rather than copying the serialized message into a buffer of its
+ * own, it only borrows a pointer to bytes which belong to someone else.
+ *
+ * This is intended to be passed by reference to ros::Publisher::publish, which
+ * serializes synchronously; the lent bytes need only stay valid for the duration
+ * of that call. That way, a frame received from the client is copied exactly
+ * once, from the session's read buffer into roscpp's outgoing buffer.
+ */
+class RawMessage
+{
+public:
+  RawMessage() : data_(NULL), length_(0)
+  {
+  }
+
+  void morph(const std::string& md5sum, const std::string& datatype,
+             const std::string& definition)
+  {
+    md5sum_ = md5sum;
+    datatype_ = datatype;
+    definition_ = definition;
+  }
+
+  /**
+   * @brief Point this message at serialized bytes owned by the caller.
+   */
+  void lend(const uint8_t* data, uint32_t length)
+  {
+    data_ = data;
+    length_ = length;
+  }
+
+  /**
+   * @brief Forget the lent bytes, so that nothing refers to them once the owner reuses them.
+   */
+  void release()
+  {
+    data_ = NULL;
+    length_ = 0;
+  }
+
+  ros::AdvertiseOptions advertiseOptions(const std::string& topic, uint32_t queue_size) const
+  {
+    return ros::AdvertiseOptions(topic, queue_size, md5sum_, datatype_, definition_);
+  }
+
+  const std::string& getMD5Sum() const { return md5sum_; }
+  const std::string& getDataType() const { return datatype_; }
+  const std::string& getMessageDefinition() const { return definition_; }
+  const uint8_t* data() const { return data_; }
+  uint32_t size() const { return length_; }
+
+private:
+  std::string md5sum_;
+  std::string datatype_;
+  std::string definition_;
+  const uint8_t* data_;
+  uint32_t length_;
+};
+
+}  // namespace
+
+namespace ros
+{
+namespace message_traits
+{
+
+template <> struct IsMessage<rosserial_server::RawMessage> : TrueType { };
+template <> struct IsMessage<const rosserial_server::RawMessage> : TrueType { };
+
+template<>
+struct MD5Sum<rosserial_server::RawMessage>
+{
+  static const char* value(const rosserial_server::RawMessage& m) { return m.getMD5Sum().c_str(); }
+  static const char* value() { return "*"; }
+};
+
+template<>
+struct DataType<rosserial_server::RawMessage>
+{
+  static const char* value(const rosserial_server::RawMessage& m) { return m.getDataType().c_str(); }
+  static const char* value() { return "*"; }
+};
+
+template<>
+struct Definition<rosserial_server::RawMessage>
+{
+  static const char* value(const rosserial_server::RawMessage& m) { return m.getMessageDefinition().c_str(); }
+};
+
+}  // namespace message_traits
+
+namespace serialization
+{
+
+template<>
+struct Serializer<rosserial_server::RawMessage>
+{
+  template<typename Stream>
+  inline static void write(Stream& stream, const rosserial_server::RawMessage& m)
+  {
+    if (m.size() > 0)
+    {
+      memcpy(stream.advance(m.size()), m.data(), m.size());
+    }
+  }
+
+  inline static uint32_t serializedLength(const rosserial_server::RawMessage& m)
+  {
+    return m.size();
+  }
+};
+
+}  // namespace serialization
+}  // namespace ros
+
+#endif  // ROSSERIAL_SERVER_RAW_MESSAGE_H
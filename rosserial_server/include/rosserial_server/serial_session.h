@@ -35,9 +35,21 @@
 #define ROSSERIAL_SERVER_SERIAL_SESSION_H
 
 #include <iostream>
+#include <vector>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
+#ifdef __linux__
+#include <fstream>
+#include <limits.h>
+#include <linux/serial.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
 #include <ros/ros.h>
 
 #include "rosserial_server/session.h"
@@ -48,12 +60,98 @@ namespace rosserial_server
 class SerialSession : public Session<boost::asio::serial_port>
 {
 public:
-  SerialSession(boost::asio::io_service& io_service, std::string port, int baud)
+  /**
+   * With a namespace given, the client's topics and services go in it, and the
+   * list of topics it is required to have is read from the <ns>/require
+   * parameter, within the node's private namespace, rather than ~require.
+   *
+   * Unless connect_now is false, the port is opened, and the session started on
+   * it, straight away; otherwise not until connect() is called, so that the
+   * session may be set up first.
+   */
+  SerialSession(boost::asio::io_service& io_service, std::string port, int baud, std::string ns = "",
+                bool connect_now = true)
     : Session(io_service), port_(port), baud_(baud), timer_(io_service)
+#ifdef __linux__
+      , hotplug_(io_service), port_dir_wd_(-1)
+#endif
   {
-    ROS_INFO_STREAM("rosserial_server session configured for " << port_ << " at " << baud << "bps.");
+    if (ns.empty()) {
+      ROS_INFO_STREAM("rosserial_server session configured for " << port_ << " at " << baud << "bps.");
+    } else {
+      ROS_INFO_STREAM("rosserial_server session configured for " << port_ << " at " << baud << "bps, in " << ns);
+      set_namespace(ns);
+      std::string relative_ns = ns.substr(std::min(ns.find_first_not_of('/'), ns.size()));
+      set_require_param("~" + relative_ns + "/require");
+    }
+    set_hardware_id(port_);
+    // Ten bits on the wire for each byte, with the start and stop bits.
+    set_link_bandwidth(baud / 10);
+
+    // A client which has just been plugged in, or has reset, may still be booting
+    // when the port opens, so it is asked for its topics every ~sync_retry_interval
+    // seconds until it answers, rather than once.
+    double sync_retry_interval;
+    ros::param::param<double>("~sync_retry_interval", sync_retry_interval, 0.1);
+    set_sync_retry_interval(boost::posix_time::microseconds(static_cast<int64_t>(sync_retry_interval * 1e6)));
 
+    // Hardware flow control is worth turning on at high baud rates, where the
+    // client may otherwise be overrun; ~flow_control is none, hardware or software.
+    std::string flow_control;
+    ros::param::param<std::string>("~flow_control", flow_control, "none");
+    typedef boost::asio::serial_port_base serial;
+    if (flow_control == "hardware") {
+      flow_control_ = serial::flow_control::hardware;
+    } else if (flow_control == "software") {
+      flow_control_ = serial::flow_control::software;
+    } else {
+      if (flow_control != "none") {
+        ROS_WARN_STREAM("Unknown ~flow_control " << flow_control << ", using none.");
+      }
+      flow_control_ = serial::flow_control::none;
+    }
+
+    // With ~low_latency set, the driver is asked to hand over bytes as they arrive,
+    // rather than batching them up, and for FTDI adapters their latency timer is
+    // set to ~latency_timer milliseconds. Costs some CPU at high data rates.
+    ros::param::param<bool>("~low_latency", low_latency_, false);
+    ros::param::param<int>("~latency_timer", latency_timer_, 1);
+
+    // Rates the link may be raised to once the client has synced, if it offers
+    // them too, such as [115200, 230400, 460800, 921600]. The port always opens
+    // at ~baud, which the client must start at.
+    XmlRpc::XmlRpcValue baud_rates;
+    if (ros::param::get("~baud_rates", baud_rates)) {
+      std::vector<uint32_t> rates;
+      if (baud_rates.getType() == XmlRpc::XmlRpcValue::TypeArray) {
+        for (int i = 0; i < baud_rates.size(); ++i) {
+          if (baud_rates[i].getType() == XmlRpc::XmlRpcValue::TypeInt) {
+            rates.push_back(static_cast<int>(baud_rates[i]));
+          }
+        }
+      }
+      if (rates.empty()) {
+        ROS_WARN("Ignoring ~baud_rates, which should be a list of baud rates.");
+      } else {
+        set_baud_switch(baud, rates, boost::bind(&SerialSession::set_baud, this, _1));
+      }
+    }
+
+    ros::param::param<bool>("~hotplug", hotplug_enabled_, true);
     failed_connection_attempts_ = 0;
+    if (connect_now) {
+      connect();
+    }
+  }
+
+  /**
+   * Opens the port, starting the session on it, and keeps it open from then on.
+   */
+  void connect()
+  {
+    if (hotplug_enabled_) {
+      watch_hotplug();
+    }
     check_connection();
   }
 
@@ -65,15 +163,87 @@ private:
       attempt_connection();
     }
 
-    // Every second, check again if the connection should be reinitialized,
-    // if the ROS node is still up.
+    // Every two seconds, check again if the connection should be reinitialized,
+    // if the ROS node is still up. With hotplug events, this is only a fallback.
     if (ros::ok())
     {
       timer_.expires_from_now(boost::posix_time::milliseconds(2000));
-      timer_.async_wait(boost::bind(&SerialSession::check_connection, this));
+      timer_.async_wait(strand().wrap(boost::bind(&SerialSession::check_connection, this)));
+    }
+  }
+
+#ifdef __linux__
+  /**
+   * Watches /dev, and the directory the port is in if that's elsewhere, such as
+   * /dev/serial/by-id, so that the port is reopened as soon as udev recreates it,
+   * rather than on the next poll. If inotify isn't available, polling carries on
+   * alone.
+   */
+  void watch_hotplug()
+  {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+      ROS_WARN_STREAM("Unable to watch for " << port_ << " being plugged in, falling back to polling.");
+      return;
+    }
+    hotplug_.assign(fd);
+    inotify_add_watch(fd, "/dev", hotplug_events);
+    watch_port_dir();
+    read_hotplug();
+  }
+
+  void watch_port_dir()
+  {
+    std::string dir = port_.substr(0, port_.rfind('/'));
+    if (port_dir_wd_ < 0 && !dir.empty() && dir != "/dev") {
+      port_dir_wd_ = inotify_add_watch(hotplug_.native_handle(), dir.c_str(), hotplug_events);
     }
   }
 
+  void read_hotplug()
+  {
+    hotplug_.async_read_some(boost::asio::buffer(hotplug_buffer_),
+        strand().wrap(boost::bind(&SerialSession::hotplug_cb, this,
+                                  boost::asio::placeholders::error,
+                                  boost::asio::placeholders::bytes_transferred)));
+  }
+
+  void hotplug_cb(const boost::system::error_code& error, size_t bytes_transferred)
+  {
+    if (error) {
+      if (error != boost::asio::error::operation_aborted) {
+        ROS_WARN_STREAM("Lost hotplug events for " << port_ << ", falling back to polling: " << error);
+      }
+      return;
+    }
+
+    for (size_t offset = 0; offset + sizeof(inotify_event) <= bytes_transferred;) {
+      const inotify_event* event = reinterpret_cast<const inotify_event*>(&hotplug_buffer_[offset]);
+      if (event->wd == port_dir_wd_ && (event->mask & IN_IGNORED)) {
+        // The directory went away with the last device in it, as /dev/serial/by-id does.
+        port_dir_wd_ = -1;
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+
+    // Whatever changed, try the port again if it isn't open. A device node usually
+    // appears before udev has set its permissions and links, so this may take a few
+    // events to succeed.
+    watch_port_dir();
+    if (!is_active() && ros::ok()) {
+      ROS_DEBUG_STREAM("Device change seen, trying " << port_ << " again.");
+      attempt_connection();
+    }
+    read_hotplug();
+  }
+
+  enum { hotplug_events = IN_CREATE | IN_ATTRIB | IN_MOVED_TO };
+#else
+  void watch_hotplug()
+  {
+  }
+#endif
+
   void attempt_connection()
   {
     ROS_DEBUG("Opening serial port.");
@@ -97,16 +267,90 @@ private:
     socket().set_option(serial::character_size(8));
     socket().set_option(serial::stop_bits(serial::stop_bits::one));
     socket().set_option(serial::parity(serial::parity::none));
-    socket().set_option(serial::flow_control(serial::flow_control::none));
+    socket().set_option(serial::flow_control(flow_control_));
+    if (low_latency_) {
+      set_low_latency();
+    }
 
     // Kick off the session.
     start();
   }
 
+  void set_baud(uint32_t baud)
+  {
+#ifdef __linux__
+    // Let what's been written go out at the old rate.
+    tcdrain(socket().native_handle());
+#endif
+    boost::system::error_code ec;
+    socket().set_option(boost::asio::serial_port_base::baud_rate(baud), ec);
+    if (ec) {
+      ROS_WARN_STREAM("Unable to set " << port_ << " to " << baud << "bps: " << ec);
+    }
+  }
+
+#ifdef __linux__
+  void set_low_latency()
+  {
+    int fd = socket().native_handle();
+
+    // Reads return as soon as there's a byte, with no inter-byte timer.
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      tio.c_cc[VMIN] = 1;
+      tio.c_cc[VTIME] = 0;
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    struct serial_struct serial_info;
+    if (ioctl(fd, TIOCGSERIAL, &serial_info) == 0) {
+      serial_info.flags |= ASYNC_LOW_LATENCY;
+      if (ioctl(fd, TIOCSSERIAL, &serial_info) != 0) {
+        ROS_WARN_STREAM("Unable to set " << port_ << " to low latency mode.");
+      }
+    } else {
+      ROS_DEBUG_STREAM(port_ << " has no low latency mode.");
+    }
+
+    // FTDI adapters hold on to received bytes for up to their latency timer, 16 ms
+    // by default, which can only be changed through sysfs. Writing it usually needs
+    // a udev rule to make it writable by the user the node runs as.
+    char device[PATH_MAX];
+    if (latency_timer_ > 0 && realpath(port_.c_str(), device)) {
+      std::string name(device);
+      std::string path = "/sys/bus/usb-serial/devices/" + name.substr(name.rfind('/') + 1) + "/latency_timer";
+      if (access(path.c_str(), F_OK) == 0) {
+        std::ofstream latency_timer(path.c_str());
+        latency_timer << latency_timer_ << std::endl;
+        if (!latency_timer) {
+          ROS_WARN_STREAM("Unable to set the latency timer of " << port_ << " through " << path);
+        } else {
+          ROS_INFO_STREAM("Set the latency timer of " << port_ << " to " << latency_timer_ << " ms.");
+        }
+      }
+    }
+  }
+#else
+  void set_low_latency()
+  {
+    ROS_WARN_ONCE("~low_latency is only supported on Linux.");
+  }
+#endif
+
   std::string port_;
   int baud_;
+  boost::asio::serial_port_base::flow_control::type flow_control_;
+  bool low_latency_;
+  int latency_timer_;
   boost::asio::deadline_timer timer_;
   int failed_connection_attempts_;
+  bool hotplug_enabled_;
+#ifdef __linux__
+  boost::asio::posix::stream_descriptor hotplug_;
+  char hotplug_buffer_[16 * (sizeof(inotify_event) + NAME_MAX + 1)]
+    __attribute__((aligned(__alignof__(inotify_event))));
+  int port_dir_wd_;
+#endif
 };
 
 }  // namespace
@@ -0,0 +1,107 @@
+/**
+ *
+ *  \file
+ *  \brief      Worker threads on which service calls are made on behalf of clients.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_SERVICE_CALL_POOL_H
+#define ROSSERIAL_SERVER_SERVICE_CALL_POOL_H
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+
+namespace rosserial_server
+{
+
+/**
+ * A ros::ServiceClient call blocks until the service responds, which can't be
+ * allowed to happen on a session's own thread, as nothing would be read from the
+ * client in the meantime. Calls are instead run on this pool's threads, and the
+ * handler which makes the call is responsible for posting the response back to
+ * wherever it needs to go.
+ */
+class ServiceCallPool : boost::noncopyable
+{
+public:
+  explicit ServiceCallPool(int threads)
+    : work_(new boost::asio::io_service::work(io_service_))
+  {
+    for (int i = 0; i < threads; ++i)
+    {
+      threads_.create_thread(boost::bind(&boost::asio::io_service::run, &io_service_));
+    }
+  }
+
+  ~ServiceCallPool()
+  {
+    work_.reset();
+    io_service_.stop();
+    threads_.join_all();
+  }
+
+  template<typename Handler>
+  void post(Handler handler)
+  {
+    io_service_.post(handler);
+  }
+
+  /**
+   * @brief Returns the pool shared by every session in this process, creating it
+   *        with the given number of threads the first time it is asked for.
+   */
+  static boost::shared_ptr<ServiceCallPool> shared(int threads)
+  {
+    static boost::mutex mutex;
+    static boost::shared_ptr<ServiceCallPool> pool;
+
+    boost::mutex::scoped_lock lock(mutex);
+    if (!pool)
+    {
+      ROS_DEBUG("Starting %d thread(s) for service calls.", threads);
+      pool.reset(new ServiceCallPool(threads));
+    }
+    return pool;
+  }
+
+private:
+  boost::asio::io_service io_service_;
+  boost::scoped_ptr<boost::asio::io_service::work> work_;
+  boost::thread_group threads_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_SERVICE_CALL_POOL_H
@@ -35,56 +35,351 @@
 #ifndef ROSSERIAL_SERVER_SESSION_H
 #define ROSSERIAL_SERVER_SESSION_H
 
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <set>
+#include <sstream>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
+#include <boost/circular_buffer.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <unistd.h>
 
-#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <rosserial_msgs/TopicInfo.h>
 #include <rosserial_msgs/Log.h>
+#include <rosserial_msgs/RequestParam.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Empty.h>
 #include <topic_tools/shape_shifter.h>
 #include <std_msgs/Time.h>
 
 #include "rosserial_server/async_read_buffer.h"
+#include "rosserial_server/buffer_pool.h"
+#include "rosserial_server/callback_queue.h"
+#include "rosserial_server/delta_decoder.h"
+#include "rosserial_server/dispatch_pipeline.h"
+#include "rosserial_server/dispatch_table.h"
+#include "rosserial_server/frame_parser.h"
+#include "rosserial_server/frame_trace.h"
+#include "rosserial_server/handler_allocator.h"
+#include "rosserial_server/lifeline.h"
+#include "rosserial_server/link_budget.h"
+#include "rosserial_server/link_capture.h"
+#include "rosserial_server/log_dictionary.h"
+#include "rosserial_server/lz4_decoder.h"
+#include "rosserial_server/message_info_cache.h"
+#include "rosserial_server/multicast_topics.h"
+#include "rosserial_server/quantization.h"
+#include "rosserial_server/session_stats.h"
 #include "rosserial_server/topic_handlers.h"
 
 namespace rosserial_server
 {
 
-typedef std::vector<uint8_t> Buffer;
-typedef boost::shared_ptr<Buffer> BufferPtr;
-
+/**
+ * A session with one client. For running it at real-time priority (see
+ * io_threads.h), these are the heap allocations left on its hot path, once it
+ * has set up the client's topics:
+ *
+ *  - Frames from the client are parsed in place in the read buffer, which only
+ *    grows when a topic with a larger buffer_size is set up. The list of frames
+ *    handed over from each read is reused.
+ *  - Publishing a message from the client lends its bytes to roscpp, which
+ *    allocates the serialized message it queues for each of its subscribers.
+ *    Sessions in a nodelet, which publish shared messages, allocate a
+ *    ShapeShifter and copy the message into it; typed publishers allocate for
+ *    the message's variable-length fields. With ~dispatch_thread, the message
+ *    is first copied into a slot of the dispatch pipeline, which only allocates
+ *    while the slot is smaller than any message it has held.
+ *  - Messages for the client arrive from roscpp in a ShapeShifter it allocated.
+ *    The frame they are serialized into comes from buffer_pool_, which only
+ *    allocates while more frames are in flight than it keeps, or when one is
+ *    larger than any negotiated so far.
+ *  - The write queues are rings, and the list of buffers for each write is
+ *    reused, so neither allocates once they've grown to the most frames queued.
+ *  - The reads, writes and posts which recur with every frame each have a
+ *    HandlerMemory of their own, so asio doesn't allocate their operations.
+ *    Adding a ROS callback to the session's queue allocates in roscpp.
+ *  - Service calls allocate their request and response on every call, as do
+ *    control messages such as parameter requests, baud changes and log messages.
+ *    Time requests are serialized straight into a pooled frame.
+ */
 template<typename Socket>
 class Session : boost::noncopyable
 {
 public:
-  Session(boost::asio::io_service& io_service)
-    : socket_(io_service),
+  enum { default_read_buffer_size = 1023 };
+
+  /**
+   * The read buffer holds at least read_buffer_size bytes, which bounds the largest
+   * frame that can be received from the client. If the ~max_frame_bytes parameter is
+   * set, the buffer is made that large up front, and never grows past it.
+   * Otherwise, it grows to fit the largest buffer_size the client gives for the
+   * topics it sends on, up to the most which the 16-bit length field can describe.
+   */
+  Session(boost::asio::io_service& io_service, size_t read_buffer_size = default_read_buffer_size)
+    : io_service_(io_service),
+      socket_(io_service),
+      strand_(io_service),
       sync_timer_(io_service),
       require_check_timer_(io_service),
-      ros_spin_timer_(io_service),
-      async_read_buffer_(socket_, buffer_max,
+      stats_timer_(io_service),
+      baud_timer_(io_service),
+      park_timer_(io_service),
+      async_read_buffer_(socket_, strand_, read_buffer_size,
                          boost::bind(&Session::read_failed, this,
-                                     boost::asio::placeholders::error))
+                                     boost::asio::placeholders::error)),
+      ros_callback_queue_(strand_, &lifeline_)
   {
-    active_ = false;
+    // ROS callbacks are dispatched onto the session's strand as they arrive,
+    // rather than being polled for, to avoid a concurrency nightmare.
+    nh_.setCallbackQueue(&ros_callback_queue_);
 
-    timeout_interval_ = boost::posix_time::milliseconds(5000);
-    attempt_interval_ = boost::posix_time::milliseconds(1000);
+    active_ = false;
+    datagram_input_ = false;
+    datagram_header_errors_ = 0;
+    shared_publish_ = false;
+    client_crc16_ = false;
+    client_cobs_ = false;
+    recording_topics_ = false;
+    recording_fingerprint_ = 0;
+    client_configured_ = false;
+    baud_initial_ = 0;
+    baud_state_ = baud_idle;
+
+    // The session ends after ~sync_timeout seconds without a time request from the
+    // client, or ~sync_attempt_interval seconds without an answer to the request for
+    // its topics when it starts.
+    double sync_timeout, sync_attempt_interval;
+    ros::param::param<double>("~sync_timeout", sync_timeout, 5.0);
+    ros::param::param<double>("~sync_attempt_interval", sync_attempt_interval, 1.0);
+    set_sync_timeout_interval(boost::posix_time::microseconds(static_cast<int64_t>(sync_timeout * 1e6)));
+    set_sync_attempt_interval(boost::posix_time::microseconds(static_cast<int64_t>(sync_attempt_interval * 1e6)));
+    topics_request_holdoff_ = boost::posix_time::milliseconds(250);
     require_check_interval_ = boost::posix_time::milliseconds(1000);
-    ros_spin_interval_ = boost::posix_time::milliseconds(10);
     require_param_name_ = "~require";
 
-    nh_.setCallbackQueue(&ros_callback_queue_);
+    write_in_progress_ = false;
+    write_flush_posted_ = false;
+    // Each topic may have ~write_queue_depth frames waiting to go out, or as many
+    // as given for it in the ~write_queue_depths dictionary, before its oldest is
+    // dropped to make way.
+    int write_queue_depth;
+    ros::param::param<int>("~write_queue_depth", write_queue_depth, 10);
+    set_write_queue_depth(write_queue_depth);
+    XmlRpc::XmlRpcValue write_queue_depths;
+    if (ros::param::get("~write_queue_depths", write_queue_depths)) {
+      if (write_queue_depths.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_write_queue_depths(write_queue_depths, "");
+      } else {
+        ROS_WARN("Ignoring ~write_queue_depths, which should be a dictionary of topic names to depths.");
+      }
+    }
+
+    // Frames for the topics named in the ~priorities/high list go out ahead of all
+    // others, and those in ~priorities/low behind them, so that a large message
+    // doesn't hold up a small urgent one. On a link of known bandwidth, each write
+    // takes only about ~write_slice seconds' worth of frames, so that a frame
+    // queued meanwhile waits for no more than that behind lower priority ones.
+    ros::param::param<double>("~write_slice", write_slice_, 0.01);
+    read_priorities("~priorities/high", priority_high);
+    read_priorities("~priorities/low", priority_low);
+
+    // Once the frames waiting to go out, and those being written, come to
+    // ~write_high_watermark bytes, the link is overloaded until they're back down
+    // to ~write_low_watermark, and meanwhile each topic's new frames are dropped by
+    // its policy: "oldest", the default, drops the topic's oldest waiting frame to
+    // make way for the new one, or the new one if none of the topic's are waiting;
+    // "newest" drops the new one; and "never" queues it regardless. ~drop_policy
+    // sets the default, and ~drop_policies is a dictionary of topic names to theirs.
+    // A high watermark of zero, the default, is half a second's worth of a link of
+    // known bandwidth, and no limit otherwise; the low watermark defaults to half
+    // the high one. The protocol's own frames are never dropped.
+    ros::param::param<int>("~write_high_watermark", write_high_watermark_, 0);
+    ros::param::param<int>("~write_low_watermark", write_low_watermark_, 0);
+    std::string drop_policy;
+    ros::param::param<std::string>("~drop_policy", drop_policy, "oldest");
+    default_drop_policy_ = parse_drop_policy(drop_policy, "~drop_policy");
+    XmlRpc::XmlRpcValue drop_policies;
+    if (ros::param::get("~drop_policies", drop_policies)) {
+      if (drop_policies.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_drop_policies(drop_policies, "");
+      } else {
+        ROS_WARN("Ignoring ~drop_policies, which should be a dictionary of topic names to policies.");
+      }
+    }
+    queued_bytes_ = 0;
+    overloaded_ = false;
+
+    // Messages on each topic the client subscribes to go to it no more than
+    // ~max_rate times a second, or as given for the topic in the ~max_rates
+    // dictionary, keeping only the latest of any which come in faster. Zero, the
+    // default, sends every message as it arrives.
+    ros::param::param<double>("~max_rate", default_max_rate_, 0);
+    XmlRpc::XmlRpcValue max_rates;
+    if (ros::param::get("~max_rates", max_rates)) {
+      if (max_rates.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_max_rates(max_rates, "");
+      } else {
+        ROS_WARN("Ignoring ~max_rates, which should be a dictionary of topic names to rates.");
+      }
+    }
+
+    // The ROS side of each topic: roscpp's queue for it holds ~queue_size messages
+    // (default 1), and a topic the client subscribes to asks its publishers for
+    // TCP_NODELAY with ~tcp_nodelay, or for UDPROS, falling back to TCPROS, with
+    // ~udp (both default false). Any of these can be given for one topic in the
+    // ~topic_options dictionary, as {imu: {queue_size: 50}, cmd_vel: {tcp_nodelay: true}}.
+    // With ~receive_stamp (default false), a message from the client which starts
+    // with a Header, and has a zero stamp, is stamped with the time it arrived,
+    // less the time its frame took to cross the link at the link's rate, and
+    // ~receive_stamp_latency seconds more (default 0) for the rest of the way;
+    // so a client which needs only coarse stamps can leave them, and the time
+    // sync, to the server. With ~replay_last (default false), the latest message on
+    // a topic the client subscribes to is sent as soon as it sets up its
+    // subscriber, so that after a reset it has its configuration or mode at once.
+    ros::param::param<int>("~queue_size", default_topic_options_.queue_size, 1);
+    ros::param::param<bool>("~tcp_nodelay", default_topic_options_.tcp_nodelay, false);
+    ros::param::param<bool>("~udp", default_topic_options_.udp, false);
+    ros::param::param<bool>("~receive_stamp", default_topic_options_.receive_stamp, false);
+    ros::param::param<bool>("~replay_last", default_topic_options_.replay_last, false);
+    ros::param::param<double>("~receive_stamp_latency", receive_stamp_latency_, 0.0);
+    XmlRpc::XmlRpcValue topic_options;
+    if (ros::param::get("~topic_options", topic_options)) {
+      if (topic_options.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_topic_options(topic_options, "");
+      } else {
+        ROS_WARN("Ignoring ~topic_options, which should be a dictionary of topic names to options.");
+      }
+    }
+
+    // With ~reconnect_grace seconds (default 0), the ROS publishers, subscribers and
+    // service clients of a client which loses sync are kept that long, and taken up
+    // again by the client's topics of the same name, type and md5sum when it comes
+    // back, so that the rest of the ROS graph doesn't see them go and reconnect to
+    // them. The TCP and UDP servers keep the stopped session that long too, for a
+    // client which comes back over a new connection.
+    ros::param::param<double>("~reconnect_grace", reconnect_grace_, 0.0);
+
+    // With ~pause_unsubscribed (default false), the client is told to stop sending a
+    // topic while nothing on the ROS side subscribes to it, and to start again once
+    // something does. Clients which predate this simply keep sending.
+    ros::param::param<bool>("~pause_unsubscribed", pause_unsubscribed_, false);
+
+    // With ~sequence_numbers (default false), the client is asked to number the
+    // messages of each of its topics, and this server numbers the ones it sends,
+    // so that frames lost on the link show up per topic in the diagnostics rather
+    // than just as a topic going quiet. It costs a byte per message.
+    ros::param::param<bool>("~sequence_numbers", sequence_numbers_, false);
+
+    // Format strings of the client's deferred log messages, as a dictionary of
+    // names to them: the one make_log_dictionary generated the client's ids from.
+    XmlRpc::XmlRpcValue log_dictionary;
+    if (ros::param::get("~log_dictionary", log_dictionary) && !log_dictionary_.load(log_dictionary)) {
+      ROS_WARN("Ignoring ~log_dictionary, which should be a dictionary of names to format strings.");
+    }
+
+    // Float fields the client's library was generated to send as fixed point, as
+    // the same dictionary of types to fields make_library was given.
+    XmlRpc::XmlRpcValue quantization;
+    if (ros::param::get("~quantization", quantization) && !quantization_.load(quantization)) {
+      ROS_WARN("Ignoring ~quantization, which should be a dictionary of message types to fields.");
+    }
+
+    // On a link of known bandwidth, rate limited topics are checked as they're set
+    // up against what's left of it, assuming their messages fill their buffers.
+    // With ~link_admission "warn", the default, a topic past the link's capacity is
+    // warned about; with "reject", it isn't sent to the client at all.
+    std::string link_admission;
+    ros::param::param<std::string>("~link_admission", link_admission, "warn");
+    if (link_admission != "warn" && link_admission != "reject") {
+      ROS_WARN_STREAM("Unknown ~link_admission " << link_admission << ", which should be warn or reject.");
+    }
+    link_budget_.set_reject(link_admission == "reject");
+
+    // Statistics are published as diagnostics every ~stats_interval seconds, or not at all if zero.
+    double stats_interval;
+    ros::param::param<double>("~stats_interval", stats_interval, 1.0);
+    if (stats_interval > 0) {
+      stats_interval_ = boost::posix_time::microseconds(static_cast<int64_t>(stats_interval * 1e6));
+      diagnostics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    }
+    static int session_count = 0;
+    std::ostringstream stats_name;
+    stats_name << ros::this_node::getName() << ": session " << ++session_count;
+    stats_name_ = stats_name.str();
+
+    // With ~trace_frames set, the most recent that many stage events are kept, and
+    // are dumped to ~trace_file when the session stops, or on a call to the
+    // session_N/dump_trace service.
+    int trace_frames;
+    ros::param::param<int>("~trace_frames", trace_frames, 0);
+    if (trace_frames > 0) {
+      std::ostringstream trace_file;
+      trace_file << "/tmp/rosserial_server_trace_" << getpid() << "_" << session_count << ".txt";
+      ros::param::param<std::string>("~trace_file", trace_file_, trace_file.str());
+      FrameTrace(trace_frames).swap(trace_);
+
+      // Through nh_, so that the call is answered on the strand, as trace_ is written.
+      std::ostringstream service_name;
+      service_name << ros::this_node::getName() << "/session_" << session_count << "/dump_trace";
+      dump_trace_server_ = nh_.advertiseService(service_name.str(), &Session::dump_trace, this);
+    }
+    async_read_buffer_.set_trace(&trace_);
+
+    // With ~capture set, every byte read from and queued for the client is appended
+    // to ~capture_file, along with where each frame lies in them, for the
+    // replay_capture tool to play back.
+    bool capture;
+    ros::param::param<bool>("~capture", capture, false);
+    if (capture) {
+      std::ostringstream capture_file;
+      capture_file << "/tmp/rosserial_server_capture_" << getpid() << "_" << session_count << ".rslcap";
+      std::string capture_path;
+      ros::param::param<std::string>("~capture_file", capture_path, capture_file.str());
+      if (capture_.open(capture_path)) {
+        ROS_INFO_STREAM("Capturing link to " << capture_path);
+      } else {
+        ROS_WARN_STREAM("Unable to open " << capture_path << " to capture the link to.");
+      }
+    }
+    async_read_buffer_.set_capture(&capture_);
+    async_read_buffer_.set_protocol_mismatch_callback(boost::bind(&Session::protocol_mismatch, this));
+    async_read_buffer_.set_lifeline(&lifeline_);
+
+    int max_frame_bytes;
+    ros::param::param<int>("~max_frame_bytes", max_frame_bytes, 0);
+    if (max_frame_bytes > 0) {
+      max_read_buffer_size_ = max_frame_bytes;
+      async_read_buffer_.reserve(max_read_buffer_size_);
+    } else {
+      max_read_buffer_size_ = max_negotiated_read_buffer_size;
+    }
+
+    // Service calls are made from a pool of worker threads shared by all sessions,
+    // so that a slow service doesn't hold up reading from the client. Setting
+    // ~service_threads to zero makes calls synchronously instead.
+    int service_threads;
+    ros::param::param<int>("~service_threads", service_threads, 1);
+    if (service_threads > 0) {
+      service_call_pool_ = ServiceCallPool::shared(service_threads);
+    }
 
-    // Intermittent callback to service ROS callbacks. To avoid polling like this,
-    // CallbackQueue could in the future be extended with a scheme to monitor for
-    // callbacks on another thread, and then queue them up to be executed on this one.
-    ros_spin_timer_.expires_from_now(ros_spin_interval_);
-    ros_spin_timer_.async_wait(boost::bind(&Session::ros_spin_timeout, this,
-                                           boost::asio::placeholders::error));
+    // With ~dispatch_thread (default false), the session's strand only reads, frames
+    // and checks what the client sends, and the messages on its topics are handed,
+    // in order, to a thread of the session's own to be published, through a ring
+    // of ~dispatch_queue_size slots (default 256); so that a single busy client can
+    // use a second core. Control messages and service calls stay on the strand.
+    bool dispatch_thread;
+    ros::param::param<bool>("~dispatch_thread", dispatch_thread, false);
+    if (dispatch_thread) {
+      int dispatch_queue_size;
+      ros::param::param<int>("~dispatch_queue_size", dispatch_queue_size, 256);
+      dispatch_pipeline_.reset(new DispatchPipeline<Publisher>(dispatch_queue_size > 0 ? dispatch_queue_size : 1));
+    }
   }
 
   Socket& socket()
@@ -92,6 +387,16 @@ public:
     return socket_;
   }
 
+  /**
+   * Every handler belonging to this session runs through this strand, so a
+   * session's state is only ever touched by one thread at a time, even when
+   * several threads are running the io_service.
+   */
+  boost::asio::io_service::strand& strand()
+  {
+    return strand_;
+  }
+
   void start()
   {
     ROS_DEBUG("Starting session.");
@@ -106,12 +411,34 @@ public:
         = boost::bind(&Session::setup_service_client_subscriber, this, _1);
     callbacks_[rosserial_msgs::TopicInfo::ID_LOG]
         = boost::bind(&Session::handle_log, this, _1);
+    callbacks_[rosserial_msgs::TopicInfo::ID_LOG_DEFERRED]
+        = boost::bind(&Session::handle_log_deferred, this, _1);
+    callbacks_[rosserial_msgs::TopicInfo::ID_PARAMETER_REQUEST]
+        = boost::bind(&Session::handle_parameter_request, this, _1);
+    callbacks_[rosserial_msgs::TopicInfo::ID_PARAMETER_BATCH]
+        = boost::bind(&Session::handle_parameter_batch, this, _1);
     callbacks_[rosserial_msgs::TopicInfo::ID_TIME]
         = boost::bind(&Session::handle_time, this, _1);
+    callbacks_[rosserial_msgs::TopicInfo::ID_TOPIC_FINGERPRINT]
+        = boost::bind(&Session::handle_topic_fingerprint, this, _1);
+    callbacks_[rosserial_msgs::TopicInfo::ID_BAUD]
+        = boost::bind(&Session::handle_baud, this, _1);
+
+    // The port has just been opened at its initial rate, and the client starts
+    // at its own.
+    baud_current_ = baud_initial_;
+    baud_state_ = baud_idle;
+    baud_offered_.clear();
+    baud_failed_.clear();
 
     active_ = true;
+    stats_.reset();
+    capture_.session_start();
+    set_stats_timeout();
     attempt_sync();
-    read_sync_header();
+    if (!datagram_input_) {
+      read_frames();
+    }
   }
 
   void stop()
@@ -122,17 +449,60 @@ public:
     // Abort active session timer callbacks, if present.
     sync_timer_.cancel();
     require_check_timer_.cancel();
+    stats_timer_.cancel();
+    baud_timer_.cancel();
 
     // Reset the state of the session, dropping any publishers or subscribers
-    // we currently know about from this client.
+    // we currently know about from this client, or keeping them for a while.
+    park_handlers();
     callbacks_.clear();
     subscribers_.clear();
+    while (!multicast_joined_.empty()) {
+      leave_multicast(multicast_joined_.begin()->first);
+    }
     publishers_.clear();
+    for (std::map<std::string, ServiceClientPtr>::iterator it = services_.begin(); it != services_.end(); ++it) {
+      it->second->detach();
+    }
     services_.clear();
 
+    // Discard frames which haven't been handed to the socket yet. Anything already
+    // in flight is released by write_completion_cb when the socket reports back.
+    for (int priority = 0; priority < priority_classes; priority++) {
+      WriteQueue& queue = write_queues_[priority];
+      for (typename WriteQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+        buffer_pool_.release(it->buffer_ptr);
+      }
+      queue.clear();
+    }
+    topic_queues_.clear();
+    queued_bytes_ = 0;
+    for (typename WriteQueue::iterator it = writing_frames_.begin(); it != writing_frames_.end(); ++it) {
+      queued_bytes_ += frame_size(*it);
+    }
+    overloaded_ = false;
+    topic_drop_policies_.clear();
+    recording_topics_ = false;
+    recorded_topics_.clear();
+    pending_publishers_.clear();
+    client_configured_ = false;
+    link_budget_.clear();
+
     // Close the socket.
     socket_.close();
     active_ = false;
+
+    if (trace_.enabled()) {
+      dump_trace_to_file();
+    }
+    capture_.flush();
+
+    ROS_DEBUG_STREAM("Session stopped; write buffer pool hits: " << buffer_pool_.hits() <<
+                     ", misses: " << buffer_pool_.misses());
+
+    if (stop_callback_) {
+      stop_callback_();
+    }
   }
 
   bool is_active()
@@ -140,6 +510,16 @@ public:
     return active_;
   }
 
+  /**
+   * How long, after stopping, the session keeps its client's handlers for the client
+   * to come back to; a server may hand it a returning client's new connection within
+   * that time. Zero if it doesn't keep them.
+   */
+  double reconnect_grace() const
+  {
+    return reconnect_grace_;
+  }
+
   /**
    * This is to set the name of the required topics parameter from the
    * default of ~require. You might want to do this to avoid a conflict
@@ -151,110 +531,353 @@ public:
     require_param_name_ = param_name;
   }
 
-private:
   /**
-   * Periodic function which handles calling ROS callbacks, executed on the same
-   * io_service thread to avoid a concurrency nightmare.
+   * Puts the topics and services set up for the client in the given namespace,
+   * rather than the node's own, so that several sessions in one process can each
+   * have their own. Must be called before start().
    */
-  void ros_spin_timeout(const boost::system::error_code& error) {
-    ros_callback_queue_.callAvailable();
+  void set_namespace(const std::string& ns)
+  {
+    nh_ = ros::NodeHandle(ns);
+    nh_.setCallbackQueue(&ros_callback_queue_);
+  }
 
-    if (ros::ok())
-    {
-      // Call again next interval.
-      ros_spin_timer_.expires_from_now(ros_spin_interval_);
-      ros_spin_timer_.async_wait(boost::bind(&Session::ros_spin_timeout, this,
-                                             boost::asio::placeholders::error));
+  /**
+   * Publishes each message from the client as a message of its own, for
+   * subscribers in the same process to have without a copy through loopback.
+   * Only worthwhile where there are such subscribers, as in a nodelet manager.
+   */
+  void set_shared_publish(bool shared)
+  {
+    shared_publish_ = shared;
+  }
+
+  /**
+   * Called, on the session's strand, each time the session stops, whether because
+   * the client went away, lost sync, or stop() was called.
+   */
+  void set_stop_callback(const boost::function<void()>& callback)
+  {
+    stop_callback_ = callback;
+  }
+
+  /**
+   * For a session owned through a shared_ptr, as by a server, call this with it
+   * before start(). Handlers which can run after the session has stopped then
+   * keep it alive until they're done, rather than reaching into a deleted session.
+   */
+  void set_owner(const boost::shared_ptr<void>& owner)
+  {
+    lifeline_.attach(owner);
+  }
+
+  /**
+   * For a socket whose own handlers must hold the session as its handlers do.
+   */
+  const Lifeline& lifeline() const
+  {
+    return lifeline_;
+  }
+
+  /**
+   * Identifies the link to the client, such as a port or address, in the diagnostics
+   * this session publishes.
+   */
+  void set_hardware_id(const std::string& hardware_id)
+  {
+    hardware_id_ = hardware_id;
+  }
+
+  /**
+   * Maximum number of frames which may be waiting to go out for any one topic.
+   * When a topic exceeds it, its oldest waiting frame is dropped, so that a slow
+   * link sees the most recent data rather than an ever-growing backlog. A depth
+   * of zero means unlimited. Defaults to the ~write_queue_depth parameter, and
+   * is overridden for the topics named in ~write_queue_depths.
+   */
+  void set_write_queue_depth(int depth)
+  {
+    write_queue_depth_ = depth > 0 ? depth : 0;
+  }
+
+  /**
+   * The link's capacity in bytes a second, where it is known, as for a serial port,
+   * for pacing writes to by ~write_slice and budgeting topics against. Zero, the
+   * default, means unknown, and each write takes everything that's queued.
+   */
+  void set_link_bandwidth(size_t bytes_per_second)
+  {
+    link_budget_.set_capacity(bytes_per_second);
+  }
+
+  /**
+   * Lets the session raise the rate of a serial link once the client has synced,
+   * to the highest of rates which the client also offers and which carries a
+   * test burst intact, and lower it again if errors rise past ~baud_error_limit
+   * a second. The callback switches the port to the rate it is given, once what
+   * has been written to it has gone out. The port is opened at initial, and the
+   * session falls back to it by stopping, if need be. Must be set before start().
+   */
+  void set_baud_switch(uint32_t initial, const std::vector<uint32_t>& rates,
+                       const boost::function<void(uint32_t)>& callback)
+  {
+    baud_initial_ = initial;
+    baud_rates_ = rates;
+    baud_switch_ = callback;
+    ros::param::param<int>("~baud_error_limit", baud_error_limit_, 5);
+    double probe_timeout;
+    ros::param::param<double>("~baud_probe_timeout", probe_timeout, 0.5);
+    baud_probe_timeout_ = boost::posix_time::microseconds(static_cast<int64_t>(probe_timeout * 1e6));
+  }
+
+  /**
+   * For a datagram transport, where the client sends only whole frames in each
+   * datagram, the session can be fed its datagrams through receive_datagram()
+   * instead of reading the socket as a byte stream. Must be set before start().
+   */
+  void set_datagram_input(bool datagram_input)
+  {
+    datagram_input_ = datagram_input;
+  }
+
+  /**
+   * Offers the client the topics which multicast sends to its group, for all
+   * the sessions sharing it at once. Clients which can read from the group take
+   * those topics from there, and nothing is written for them here.
+   */
+  void set_multicast(const MulticastTopicsPtr& multicast)
+  {
+    multicast_ = multicast;
+  }
+
+  /**
+   * Takes the topics the client subscribes to from subscriptions shared with the
+   * other sessions given the same registry, each message serialized once for
+   * them all. Where the frame needs nothing of this session's but its header and
+   * checksum, it is written straight from the shared bytes, gathered between
+   * them. Only for sockets which write a gathered buffer list as one stream of
+   * bytes, so not for UDP, which sends each buffer as a datagram.
+   */
+  void set_shared_subscriptions(const SharedSubscriptionsPtr& shared_subscriptions)
+  {
+    shared_subscriptions_ = shared_subscriptions;
+  }
+
+  /**
+   * Handles the frames in one datagram from the client. The datagram is parsed on
+   * its own, without the resynchronization a byte stream needs, so one which is
+   * damaged or cut short costs only the frames in it, and never those after it.
+   * Must be called on the session's strand.
+   */
+  void receive_datagram(uint8_t* data, size_t length)
+  {
+    if (!active_) {
+      return;
+    }
+    uint64_t stamp = trace_.enabled() ? ros::WallTime::now().toNSec() : 0;
+    datagram_frames_.clear();
+    uint8_t* start = data;
+    uint8_t* end = data + length;
+    uint64_t capture_offset = capture_.in_bytes();
+    capture_.in_chunk(data, length);
+    while (data < end) {
+      uint16_t frame_length, topic_id;
+      if (end - data >= 2 && data[0] == 0xff &&
+          data[1] != FrameParser::protocol_ver2 && data[1] != FrameParser::protocol_ver2_crc16) {
+        ROS_WARN_THROTTLE(1, "Frame in datagram from client has protocol version 0x%02x. Dropping the rest of it.",
+                          data[1]);
+        datagram_header_errors_++;
+        protocol_mismatch();
+        break;
+      }
+      if (end - data < FrameParser::header_bytes || data[0] != 0xff ||
+          !FrameParser::parse_header(data, frame_length, topic_id)) {
+        ROS_WARN_THROTTLE(1, "Bad frame header in datagram from client. Dropping the rest of it.");
+        datagram_header_errors_++;
+        break;
+      }
+      size_t frame_bytes = frame_length + FrameParser::frame_overhead(data);
+      if (frame_bytes > static_cast<size_t>(end - data)) {
+        ROS_WARN_THROTTLE(1, "Frame on topic %d runs past the end of its datagram. Dropping it.", topic_id);
+        datagram_header_errors_++;
+        break;
+      }
+      Frame frame = { topic_id, data + FrameParser::header_bytes,
+                      static_cast<uint16_t>(frame_bytes - FrameParser::header_bytes), FrameParser::has_crc16(data),
+                      false };
+      datagram_frames_.push_back(frame);
+      trace_.record(FrameTrace::IN_READ, topic_id, stamp);
+      trace_.record(FrameTrace::IN_PARSED, topic_id);
+      capture_.in_frame(capture_offset + (data - start), frame_bytes, topic_id);
+      data += frame_bytes;
     }
+    handle_frames(datagram_frames_);
+  }
+
+  /**
+   * While waiting for the client to answer after the session starts, send it the
+   * request for its topics again this often, rather than only once, so that a
+   * client which is still booting when the link comes up is picked up as soon as
+   * it is ready, instead of when the attempt times out. Zero, the default, sends
+   * the request once.
+   */
+  void set_sync_retry_interval(const boost::posix_time::time_duration& interval)
+  {
+    sync_retry_interval_ = interval;
+  }
+
+  /**
+   * How long the session carries on without hearing a time request from the client,
+   * which it sends every few seconds, before giving up on it, and how long it waits
+   * for an answer to the request for topics it sends when it starts. These override
+   * the ~sync_timeout and ~sync_attempt_interval parameters, and take effect the next
+   * time the sync timer is set.
+   */
+  void set_sync_timeout_interval(const boost::posix_time::time_duration& interval)
+  {
+    timeout_interval_ = interval;
+  }
+
+  void set_sync_attempt_interval(const boost::posix_time::time_duration& interval)
+  {
+    attempt_interval_ = interval;
   }
 
+private:
   //// RECEIVING MESSAGES ////
   // TODO: Total message timeout, implement primarily in ReadBuffer.
 
-  void read_sync_header() {
-    async_read_buffer_.read(1, boost::bind(&Session::read_sync_first, this, _1));
+  void read_frames() {
+    async_read_buffer_.read_frames(boost::bind(&Session::read_frames_cb, this, _1));
   }
 
-  void read_sync_first(ros::serialization::IStream& stream) {
-    uint8_t sync;
-    stream >> sync;
-    if (sync == 0xff) {
-      async_read_buffer_.read(1, boost::bind(&Session::read_sync_second, this, _1));
-    } else {
-      read_sync_header();
+  /**
+   * Called with every complete frame the read buffer had on hand, which after a
+   * burst from the client may be many, all handled here in a single pass.
+   */
+  void read_frames_cb(std::vector<Frame>& frames) {
+    if (handle_frames(frames)) {
+      // Kickoff next message read.
+      read_frames();
     }
   }
 
-  void read_sync_second(ros::serialization::IStream& stream) {
-    uint8_t sync;
-    stream >> sync;
-    if (sync == 0xfe) {
-      async_read_buffer_.read(5, boost::bind(&Session::read_id_length, this, _1));
-    } else {
-      read_sync_header();
+  /**
+   * Returns false if a handler stopped the session, in which case the rest of the
+   * frames were stale, and have been dropped.
+   */
+  bool handle_frames(std::vector<Frame>& frames) {
+    for (std::vector<Frame>::iterator it = frames.begin(); it != frames.end(); ++it) {
+      ROS_DEBUG("Received message header with length %d and topic_id=%d", it->length - 1, it->topic_id);
+      read_body(*it);
+      if (!active_) {
+        return false;
+      }
     }
+    return true;
   }
 
-  void read_id_length(ros::serialization::IStream& stream) {
-    uint16_t topic_id, length;
-    uint8_t length_checksum;
+  void read_body(const Frame& frame) {
+    uint16_t topic_id = frame.topic_id;
+    ROS_DEBUG("Received body of length %d for message on topic %d.", frame.length, topic_id);
 
-    // Check header checksum byte for length field.
-    stream >> length >> length_checksum;
-    if (length_checksum + checksum(length) != 0xff) {
-      uint8_t csl = checksum(length);
-      ROS_WARN("Bad message header length checksum. Dropping message from client. T%d L%d C%d %d", topic_id, length, length_checksum, csl);
-      read_sync_header();
-      return;
+    // The CRC covers the topic id too, which sits just ahead of the body.
+    bool valid;
+    uint32_t body_length = frame.length - (frame.crc16 ? 2 : 1);
+    if (frame.crc16) {
+      uint16_t crc = frame.data[body_length] | (frame.data[body_length + 1] << 8);
+      valid = FrameParser::crc16(frame.data - 2, body_length + 2) == crc;
     } else {
-      stream >> topic_id;
+      valid = static_cast<uint8_t>(FrameParser::checksum(frame.data, frame.length) + checksum(topic_id)) == 0xff;
     }
-    ROS_DEBUG("Received message header with length %d and topic_id=%d", length, topic_id);
 
-    // Read message length + checksum byte.
-    async_read_buffer_.read(length + 1, boost::bind(&Session::read_body, this,
-                                                    _1, topic_id));
+    if (!valid) {
+      ROS_WARN("Rejecting message on topicId=%d, length=%d with bad %s.", topic_id, body_length,
+               frame.crc16 ? "CRC" : "checksum");
+      stats_.checksum_error();
+      return;
+    }
+    if (frame.crc16 && !client_crc16_) {
+      ROS_DEBUG("Client sends CRC-16 frames; doing the same.");
+      client_crc16_ = true;
+    }
+    if (frame.cobs && !client_cobs_) {
+      ROS_DEBUG("Client sends COBS frames; doing the same.");
+      client_cobs_ = true;
+    }
+    if (topic_id == rosserial_msgs::TopicInfo::ID_BATCH) {
+      read_batch(frame.data, body_length);
+    } else {
+      // Hand on only the message body, so that handlers which pass the bytes
+      // through verbatim don't pick up the trailing checksum.
+      dispatch(topic_id, frame.data, body_length);
+    }
   }
 
-  void read_body(ros::serialization::IStream& stream, uint16_t topic_id) {
-    ROS_DEBUG("Received body of length %d for message on topic %d.", stream.getLength(), topic_id);
-
-    ros::serialization::IStream checksum_stream(stream.getData(), stream.getLength());
-    uint8_t msg_checksum = checksum(checksum_stream) + checksum(topic_id);
+  /**
+   * Unpacks the messages from a frame which the client packed several into, in
+   * response to feature_batch in the request for topics. Each is a 16-bit topic
+   * id and 16-bit length, followed by that many bytes of message.
+   */
+  void read_batch(uint8_t* data, uint32_t length) {
+    uint8_t* end = data + length;
+    while (data < end) {
+      if (end - data < 4) {
+        ROS_WARN_THROTTLE(1, "Batched frame from client has %d stray bytes at its end.", static_cast<int>(end - data));
+        break;
+      }
+      uint16_t topic_id = data[0] | (data[1] << 8);
+      uint16_t message_length = data[2] | (data[3] << 8);
+      data += 4;
+      if (message_length > end - data) {
+        ROS_WARN_THROTTLE(1, "Message on topic %d runs past the end of its batched frame. Dropping it.", topic_id);
+        break;
+      }
+      trace_.record(FrameTrace::IN_PARSED, topic_id);
+      dispatch(topic_id, data, message_length);
+      data += message_length;
+      if (!active_) {
+        break;
+      }
+    }
+  }
 
-    if (msg_checksum != 0xff) {
-      ROS_WARN("Rejecting message on topicId=%d, length=%d with bad checksum.", topic_id, stream.getLength());
-    } else {
-      if (callbacks_.count(topic_id) == 1) {
-        try {
-          callbacks_[topic_id](stream);
-        } catch(ros::serialization::StreamOverrunException e) {
-          if (topic_id < 100) {
-            ROS_ERROR("Buffer overrun when attempting to parse setup message.");
-            ROS_ERROR_ONCE("Is this firmware from a pre-Groovy rosserial?");
-          } else {
-            ROS_WARN("Buffer overrun when attempting to parse user message.");
-          }
+  void dispatch(uint16_t topic_id, uint8_t* data, uint32_t length) {
+    const DispatchTable::Callback* callback = callbacks_.find(topic_id);
+    if (is_topic_setup(topic_id)) {
+      client_configured_ = true;
+      if (recording_topics_) {
+        recorded_topics_.push_back(std::make_pair(topic_id, std::vector<uint8_t>(data, data + length)));
+      }
+    }
+    if (callback) {
+      stats_.frame_received(topic_id, length);
+      try {
+        ros::serialization::IStream body_stream(data, length);
+        trace_.record(FrameTrace::IN_DISPATCHED, topic_id);
+        (*callback)(body_stream);
+        trace_.record(FrameTrace::IN_HANDLED, topic_id);
+      } catch(ros::serialization::StreamOverrunException e) {
+        if (topic_id < 100) {
+          ROS_ERROR("Buffer overrun when attempting to parse setup message.");
+          ROS_ERROR_ONCE("Is this firmware from a pre-Groovy rosserial?");
+        } else {
+          ROS_WARN("Buffer overrun when attempting to parse user message.");
         }
-      } else {
-        ROS_WARN("Received message with unrecognized topicId (%d).", topic_id);
-        // TODO: Resynchronize on multiples?
       }
+    } else {
+      ROS_WARN("Received message with unrecognized topicId (%d).", topic_id);
+      stats_.unknown_topic();
+      // TODO: Resynchronize on multiples?
     }
-
-    // Kickoff next message read.
-    read_sync_header();
   }
 
   void read_failed(const boost::system::error_code& error) {
-    if (error == boost::system::errc::no_buffer_space) {
-      // No worries. Begin syncing on a new message.
-      ROS_WARN("Overrun on receive buffer. Attempting to regain rx sync.");
-      read_sync_header();
-    } else if (error) {
+    if (error) {
       // When some other read error has occurred, stop the session, which destroys
       // all known publishers and subscribers.
       ROS_WARN_STREAM("Socket asio error, closing socket: " << error);
+      stats_.read_error();
       stop();
     }
   }
@@ -262,90 +885,730 @@ private:
   //// SENDING MESSAGES ////
 
   void write_message(Buffer& message, const uint16_t topic_id) {
-    uint8_t overhead_bytes = 8;
-    uint16_t length = overhead_bytes + message.size();
-    BufferPtr buffer_ptr(new Buffer(length));
-
-    uint8_t msg_checksum;
-    ros::serialization::IStream checksum_stream(message.size() > 0 ? &message[0] : NULL, message.size());
-
-    ros::serialization::OStream stream(&buffer_ptr->at(0), buffer_ptr->size());
-    uint8_t msg_len_checksum = 255 - checksum(message.size());
-    stream << (uint16_t)0xfeff << (uint16_t)message.size() << msg_len_checksum << topic_id;
-    msg_checksum = 255 - (checksum(checksum_stream) + checksum(topic_id));
+    BufferPtr buffer_ptr = begin_frame(message.size(), topic_id);
+    if (!buffer_ptr) {
+      return;
+    }
+    if (!message.empty()) {
+      memcpy(&buffer_ptr->at(FrameParser::header_bytes), &message[0], message.size());
+    }
+    end_frame(buffer_ptr, message.size(), topic_id);
+  }
 
-    memcpy(stream.advance(message.size()), &message[0], message.size());
-    stream << msg_checksum;
+  /**
+   * As write_message, but serializes msg straight into the frame, rather than
+   * into a buffer of its own to be copied in.
+   */
+  template<class M>
+  void write_serialized(const M& msg, const uint16_t topic_id) {
+    uint32_t length = ros::serialization::serializationLength(msg);
+    BufferPtr buffer_ptr = begin_frame(length, topic_id);
+    if (!buffer_ptr) {
+      return;
+    }
+    ros::serialization::OStream stream(buffer_ptr->data() + FrameParser::header_bytes, length);
+    ros::serialization::serialize(stream, msg);
+    end_frame(buffer_ptr, length, topic_id);
+  }
 
-    ROS_DEBUG_NAMED("async_write", "Sending buffer of %d bytes to client.", length);
-    boost::asio::async_write(socket_, boost::asio::buffer(*buffer_ptr),
-          boost::bind(&Session::write_completion_cb, this, boost::asio::placeholders::error, buffer_ptr));
+  /**
+   * As write_serialized, for a topic the client has asked to have numbered: the
+   * message goes after a byte counting the messages sent on the topic.
+   */
+  template<class M>
+  void write_sequenced(const M& msg, const uint16_t topic_id) {
+    uint32_t length = ros::serialization::serializationLength(msg);
+    BufferPtr buffer_ptr = begin_frame(length + 1, topic_id);
+    if (!buffer_ptr) {
+      return;
+    }
+    uint8_t* body = buffer_ptr->data() + FrameParser::header_bytes;
+    *body = out_sequences_[topic_id]++;
+    ros::serialization::OStream stream(body + 1, length);
+    ros::serialization::serialize(stream, msg);
+    end_frame(buffer_ptr, length + 1, topic_id);
   }
 
-  void write_completion_cb(const boost::system::error_code& error,
-                           BufferPtr buffer_ptr) {
-    if (error) {
-      if (error == boost::system::errc::io_error) {
-        ROS_WARN_THROTTLE(1, "Socket write operation returned IO error.");
-      } else if (error == boost::system::errc::no_such_device) {
-        ROS_WARN_THROTTLE(1, "Socket write operation returned no device.");
+  /**
+   * As write_serialized, for a topic which may have quantized fields: they're
+   * packed as the client expects them once the message is serialized. Whether
+   * its type has any is worked out from the first message on the topic.
+   */
+  void write_quantized(const topic_tools::ShapeShifter& msg, const uint16_t topic_id, bool sequenced) {
+    std::map<uint16_t, QuantizedLayoutPtr>::iterator layout = out_layouts_.find(topic_id);
+    if (layout == out_layouts_.end()) {
+      layout = out_layouts_.insert(std::make_pair(topic_id,
+          quantization_.layout(msg.getDataType(), msg.getMessageDefinition()))).first;
+    }
+    if (!layout->second) {
+      if (sequenced) {
+        write_sequenced(msg, topic_id);
       } else {
-        ROS_WARN_STREAM_THROTTLE(1, "Unknown error returned during write operation: " << error);
+        write_serialized(msg, topic_id);
       }
-      stop();
+      return;
     }
-    // Buffer is destructed when this function exits and buffer_ptr goes out of scope.
-  }
-
-  //// SYNC WATCHDOG ////
-  void attempt_sync() {
-    request_topics();
-    set_sync_timeout(attempt_interval_);
+    uint32_t length = ros::serialization::serializationLength(msg);
+    quantize_in_.resize(length);
+    ros::serialization::OStream stream(quantize_in_.data(), length);
+    ros::serialization::serialize(stream, msg);
+    if (!layout->second->pack(quantize_in_.data(), length, quantize_out_)) {
+      ROS_WARN_THROTTLE(1, "Dropping a message for topic %d, which doesn't match its type's definition.", topic_id);
+      return;
+    }
+    size_t sequence_bytes = sequenced ? 1 : 0;
+    BufferPtr buffer_ptr = begin_frame(quantize_out_.size() + sequence_bytes, topic_id);
+    if (!buffer_ptr) {
+      return;
+    }
+    uint8_t* body = buffer_ptr->data() + FrameParser::header_bytes;
+    if (sequenced) {
+      *body = out_sequences_[topic_id]++;
+    }
+    std::memcpy(body + sequence_bytes, quantize_out_.data(), quantize_out_.size());
+    end_frame(buffer_ptr, quantize_out_.size() + sequence_bytes, topic_id);
   }
 
-  void set_sync_timeout(const boost::posix_time::time_duration& interval) {
-    if (ros::ok())
-    {
-      sync_timer_.cancel();
-      sync_timer_.expires_from_now(interval);
-      sync_timer_.async_wait(boost::bind(&Session::sync_timeout, this,
-            boost::asio::placeholders::error));
+  /**
+   * Sends a message serialized once for every session taking the topic. The
+   * frame's header and checksum go in a buffer of their own, and the shared
+   * bytes are written from where they are, between them; only a frame to be
+   * COBS encoded, or captured, is copied whole.
+   */
+  void write_shared(const SharedPayloadPtr& payload, const uint16_t topic_id) {
+    size_t length = payload->bytes.size();
+    if (client_cobs_ || capture_.enabled()) {
+      BufferPtr buffer_ptr = begin_frame(length, topic_id);
+      if (!buffer_ptr) {
+        return;
+      }
+      std::copy(payload->bytes.begin(), payload->bytes.end(), buffer_ptr->begin() + FrameParser::header_bytes);
+      end_frame(buffer_ptr, length, topic_id);
+      return;
+    }
+    BufferPtr buffer_ptr = begin_frame(0, topic_id);
+    if (!buffer_ptr) {
+      return;
+    }
+    ros::serialization::OStream stream(&buffer_ptr->at(0), buffer_ptr->size());
+    uint8_t protocol_ver = client_crc16_ ? FrameParser::protocol_ver2_crc16 : FrameParser::protocol_ver2;
+    stream << (uint8_t)0xff << protocol_ver << (uint16_t)length << (uint8_t)(255 - checksum(length)) << topic_id;
+    if (client_crc16_) {
+      uint16_t crc = FrameParser::crc16(&buffer_ptr->at(FrameParser::header_bytes - 2), 2);
+      stream << FrameParser::crc16(payload->bytes.data(), length, crc);
+    } else {
+      stream << (uint8_t)(255 - (payload->checksum + checksum(topic_id)));
     }
+    enqueue_frame(topic_id, buffer_ptr, payload);
   }
 
-  void sync_timeout(const boost::system::error_code& error) {
-    if (error != boost::asio::error::operation_aborted) {
-      ROS_DEBUG("Sync with device lost.");
-      stop();
+  /**
+   * A buffer for a frame of length bytes of message, which goes in after the
+   * header, or none if the session has stopped.
+   */
+  BufferPtr begin_frame(size_t length, const uint16_t topic_id) {
+    if (!active_) {
+      // Can happen when a service response comes back after the session has stopped.
+      ROS_DEBUG("Dropping message for topic %d, as the session is not active.", topic_id);
+      return BufferPtr();
     }
+    // Frames go out with a CRC once the client has shown it can take them, by
+    // sending one of its own.
+    return buffer_pool_.acquire((client_crc16_ ? FrameParser::crc16_overhead_bytes : FrameParser::overhead_bytes) +
+                                length);
   }
 
-  //// HELPERS ////
-  void request_topics() {
-    std::vector<uint8_t> message(0);
-    ROS_DEBUG("Sending request topics message for VER2 protocol.");
-    write_message(message, rosserial_msgs::TopicInfo::ID_PUBLISHER);
+  /**
+   * Fills in the header and checksum around the message in a frame from
+   * begin_frame, and queues it.
+   */
+  void end_frame(BufferPtr buffer_ptr, size_t message_length, const uint16_t topic_id) {
+    uint16_t length = buffer_ptr->size();
+    ros::serialization::OStream stream(&buffer_ptr->at(0), buffer_ptr->size());
+    uint8_t msg_len_checksum = 255 - checksum(message_length);
+    uint8_t protocol_ver = client_crc16_ ? FrameParser::protocol_ver2_crc16 : FrameParser::protocol_ver2;
+    stream << (uint8_t)0xff << protocol_ver << (uint16_t)message_length << msg_len_checksum << topic_id;
+    const uint8_t* message = stream.advance(message_length);
 
-    // Set timer for future point at which to verify the subscribers and publishers
-    // created by the client against the expected set given in the parameters.
-    require_check_timer_.expires_from_now(require_check_interval_);
-    require_check_timer_.async_wait(boost::bind(&Session::required_topics_check, this,
-          boost::asio::placeholders::error));
-  }
+    if (client_crc16_) {
+      stream << FrameParser::crc16(&buffer_ptr->at(FrameParser::header_bytes - 2), message_length + 2);
+    } else {
+      uint8_t msg_checksum = 255 - (FrameParser::checksum(message, message_length) + checksum(topic_id));
+      stream << msg_checksum;
+    }
 
-  void required_topics_check(const boost::system::error_code& error) {
-    if (error != boost::asio::error::operation_aborted) {
-      if (ros::param::has(require_param_name_)) {
-        if (!check_set(require_param_name_ + "/publishers", publishers_) ||
-            !check_set(require_param_name_ + "/subscribers", subscribers_)) {
-          ROS_WARN("Connected client failed to establish the publishers and subscribers dictated by require parameter. Re-requesting topics.");
-          request_topics();
-        }
-      }
+    // Likewise COBS, which lets the client find the next frame straight after losing
+    // a byte, at the cost of a few bytes per frame.
+    if (client_cobs_) {
+      BufferPtr encoded_ptr = buffer_pool_.acquire(FrameParser::max_cobs_bytes(length));
+      encoded_ptr->resize(FrameParser::cobs_encode(&buffer_ptr->at(0), length, &encoded_ptr->at(0)));
+      buffer_pool_.release(buffer_ptr);
+      buffer_ptr = encoded_ptr;
     }
+
+    capture_.out_frame(&buffer_ptr->at(0), buffer_ptr->size(), topic_id);
+    enqueue_frame(topic_id, buffer_ptr);
   }
 
-  template<typename M>
+  /**
+   * Frames aren't written individually; they're queued, and every frame which
+   * is queued during the same io_service turn goes out in a single gathered
+   * write. Only one write is ever in flight, and frames which arrive while it
+   * is are picked up by the next one. There is a queue for each priority class,
+   * and each write takes from the higher ones first.
+   */
+  void enqueue_frame(const uint16_t topic_id, const BufferPtr& buffer_ptr,
+                     const SharedPayloadPtr& payload = SharedPayloadPtr()) {
+    QueuedFrame frame = { topic_id, buffer_ptr, payload };
+    size_t size = frame_size(frame);
+    TopicQueue& topic_queue = topic_queue_for(topic_id);
+    WriteQueue& queue = write_queues_[topic_queue.priority];
+    if (topic_queue.depth > 0 && topic_queue.waiting >= topic_queue.depth) {
+      ROS_DEBUG_NAMED("async_write", "Write queue full for topic %d, dropping oldest frame.", topic_id);
+      drop_oldest_frame(topic_id);
+    }
+    if (!admit_frame(topic_id, size)) {
+      ROS_DEBUG_NAMED("async_write", "Link overloaded, dropping new frame for topic %d.", topic_id);
+      stats_.watermark_drop(topic_id);
+      trace_.record(FrameTrace::OUT_DROPPED, topic_id);
+      buffer_pool_.release(buffer_ptr);
+      return;
+    }
+    stats_.frame_queued(topic_id, size);
+    trace_.record(FrameTrace::OUT_QUEUED, topic_id);
+    push_frame(queue, frame);
+    topic_queue.waiting++;
+    queued_bytes_ += size;
+
+    if (!write_in_progress_ && !write_flush_posted_) {
+      write_flush_posted_ = true;
+      strand_.post(make_custom_alloc_handler(flush_handler_memory_,
+          make_guarded_handler(lifeline_.hold(), boost::bind(&Session::flush_write_queue, this))));
+    }
+  }
+
+  /**
+   * The write queues are rings, which only allocate when one grows past the most
+   * frames it has held before.
+   */
+  template<typename Queue>
+  static void push_frame(Queue& queue, const typename Queue::value_type& frame) {
+    if (queue.full()) {
+      queue.set_capacity(std::max<size_t>(16, queue.capacity() * 2));
+    }
+    queue.push_back(frame);
+  }
+
+  /**
+   * Drops the topic's oldest frame from its write queue, returning false if it
+   * has none waiting.
+   */
+  bool drop_oldest_frame(const uint16_t topic_id) {
+    TopicQueue& topic_queue = topic_queue_for(topic_id);
+    if (topic_queue.waiting == 0) {
+      return false;
+    }
+    WriteQueue& queue = write_queues_[topic_queue.priority];
+    for (typename WriteQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+      if (it->topic_id == topic_id) {
+        stats_.write_queue_drop(topic_id);
+        trace_.record(FrameTrace::OUT_DROPPED, topic_id);
+        queued_bytes_ -= frame_size(*it);
+        buffer_pool_.release(it->buffer_ptr);
+        queue.erase(it);
+        topic_queue.waiting--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Whether a new frame of length bytes may be queued for the topic: always,
+   * until the high watermark is reached, and after that, as the topic's drop
+   * policy says, until the low one is.
+   */
+  bool admit_frame(const uint16_t topic_id, size_t length) {
+    size_t high = write_high_watermark_ > 0 ? write_high_watermark_ : link_budget_.capacity() / 2;
+    if (high == 0 || topic_id < 100 || (!overloaded_ && queued_bytes_ + length < high)) {
+      return true;
+    }
+    if (!overloaded_) {
+      overloaded_ = true;
+      stats_.overloaded();
+      ROS_WARN_STREAM_THROTTLE(1, "Link to client is overloaded, with " << queued_bytes_ <<
+                               " bytes waiting to be written; dropping frames.");
+    }
+    int policy = default_drop_policy_;
+    std::map<uint16_t, int>::const_iterator it = topic_drop_policies_.find(topic_id);
+    if (it != topic_drop_policies_.end()) {
+      policy = it->second;
+    }
+    return policy == drop_never || (policy == drop_oldest && drop_oldest_frame(topic_id));
+  }
+
+  /**
+   * Ends an overload once the bytes waiting are down to the low watermark.
+   */
+  void check_low_watermark() {
+    size_t high = write_high_watermark_ > 0 ? write_high_watermark_ : link_budget_.capacity() / 2;
+    size_t low = write_low_watermark_ > 0 ? write_low_watermark_ : high / 2;
+    if (overloaded_ && queued_bytes_ <= low) {
+      overloaded_ = false;
+      ROS_DEBUG_NAMED("async_write", "Link to client no longer overloaded.");
+    }
+  }
+
+  void flush_write_queue() {
+    write_flush_posted_ = false;
+    if (write_in_progress_) {
+      return;
+    }
+
+    // With the link's bandwidth known, take whole frames, highest priority first,
+    // until there's a slice's worth; a large low priority frame is only ever held
+    // up behind, or holds up, one slice.
+    size_t slice = static_cast<size_t>(link_budget_.capacity() * write_slice_);
+    std::vector<boost::asio::const_buffer>& buffers = write_buffers_;
+    buffers.clear();
+    size_t length = 0;
+    for (int priority = 0; priority < priority_classes; priority++) {
+      WriteQueue& queue = write_queues_[priority];
+      while (!queue.empty()) {
+        QueuedFrame& frame = queue.front();
+        size_t size = frame_size(frame);
+        if (slice > 0 && length > 0 && length + size > slice) {
+          // Lower priority frames mustn't go ahead of this one.
+          priority = priority_classes;
+          break;
+        }
+        if (frame.payload) {
+          // The header, the shared message, then the checksum after the header.
+          buffers.push_back(boost::asio::buffer(&frame.buffer_ptr->at(0), FrameParser::header_bytes));
+          buffers.push_back(boost::asio::buffer(frame.payload->bytes));
+          buffers.push_back(boost::asio::buffer(&frame.buffer_ptr->at(FrameParser::header_bytes),
+                                                frame.buffer_ptr->size() - FrameParser::header_bytes));
+        } else {
+          buffers.push_back(boost::asio::buffer(*frame.buffer_ptr));
+        }
+        length += size;
+        push_frame(writing_frames_, frame);
+        topic_queues_[frame.topic_id].waiting--;
+        queue.pop_front();
+      }
+    }
+    if (buffers.empty()) {
+      return;
+    }
+
+    ROS_DEBUG_NAMED("async_write", "Sending %d frames totalling %d bytes to client.",
+                    static_cast<int>(buffers.size()), static_cast<int>(length));
+    write_in_progress_ = true;
+    boost::asio::async_write(socket_, BufferListRef(buffers), transfer_whole_frames(),
+          strand_.wrap(make_custom_alloc_handler(write_handler_memory_, make_guarded_handler(lifeline_.hold(),
+              boost::bind(&Session::write_completion_cb, this, boost::asio::placeholders::error)))));
+  }
+
+  /**
+   * The list of buffers for a write, by reference, so that asio doesn't copy the
+   * list into each write operation. The list is left alone until the write completes.
+   */
+  struct BufferListRef {
+    typedef boost::asio::const_buffer value_type;
+    typedef std::vector<boost::asio::const_buffer>::const_iterator const_iterator;
+    explicit BufferListRef(const std::vector<boost::asio::const_buffer>& buffers) : buffers_(&buffers) {}
+    const_iterator begin() const { return buffers_->begin(); }
+    const_iterator end() const { return buffers_->end(); }
+    const std::vector<boost::asio::const_buffer>* buffers_;
+  };
+
+  /**
+   * Lets each write to the socket take every frame that's left, rather than stopping
+   * at asio's default of 64KB, which could part a frame across two of the datagrams
+   * a UDP stream sends them in.
+   */
+  struct transfer_whole_frames {
+    size_t operator()(const boost::system::error_code& error, size_t) const {
+      return error ? 0 : std::numeric_limits<size_t>::max();
+    }
+  };
+
+  void write_completion_cb(const boost::system::error_code& error) {
+    write_in_progress_ = false;
+
+    // Hand the buffers back for the next outbound frames to use.
+    bool baud_written = false;
+    for (typename WriteQueue::iterator it = writing_frames_.begin(); it != writing_frames_.end(); ++it) {
+      if (!error) trace_.record(FrameTrace::OUT_WRITTEN, it->topic_id);
+      baud_written = baud_written || it->topic_id == rosserial_msgs::TopicInfo::ID_BAUD;
+      queued_bytes_ -= frame_size(*it);
+      buffer_pool_.release(it->buffer_ptr);
+    }
+    writing_frames_.clear();
+    check_low_watermark();
+
+    if (error) {
+      stats_.write_error();
+      if (error == boost::system::errc::io_error) {
+        ROS_WARN_THROTTLE(1, "Socket write operation returned IO error.");
+      } else if (error == boost::system::errc::no_such_device) {
+        ROS_WARN_THROTTLE(1, "Socket write operation returned no device.");
+      } else {
+        ROS_WARN_STREAM_THROTTLE(1, "Unknown error returned during write operation: " << error);
+      }
+      stop();
+      return;
+    }
+
+    stats_.write_completed();
+
+    // The request to switch rates has gone, so the port follows it.
+    if (baud_written && baud_state_ == baud_switching) {
+      switch_baud();
+    }
+
+    // Anything queued while that write was in progress goes out now.
+    flush_write_queue();
+  }
+
+  //// SYNC WATCHDOG ////
+  void attempt_sync() {
+    request_topics();
+    if (sync_retry_interval_ > boost::posix_time::time_duration() && sync_retry_interval_ < attempt_interval_) {
+      sync_attempt_deadline_ = boost::posix_time::microsec_clock::universal_time() + attempt_interval_;
+      set_sync_retry_timeout(sync_retry_interval_);
+    } else {
+      set_sync_timeout(attempt_interval_);
+    }
+  }
+
+  // Hearing from the client calls set_sync_timeout, which cancels any retry still
+  // pending, so these only carry on for as long as it stays quiet. Frames handled
+  // after the session has stopped don't arm them again, as that would keep it alive.
+  void set_sync_retry_timeout(const boost::posix_time::time_duration& interval) {
+    if (active_ && ros::ok())
+    {
+      sync_timer_.cancel();
+      sync_timer_.expires_from_now(interval);
+      sync_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+          boost::bind(&Session::sync_retry_timeout, this, boost::asio::placeholders::error))));
+    }
+  }
+
+  void sync_retry_timeout(const boost::system::error_code& error) {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    boost::posix_time::time_duration remaining =
+      sync_attempt_deadline_ - boost::posix_time::microsec_clock::universal_time();
+    if (remaining <= boost::posix_time::time_duration()) {
+      sync_timeout(error);
+      return;
+    }
+    ROS_DEBUG("No response from device yet, requesting topics again.");
+    request_topics();
+    set_sync_retry_timeout(std::min(sync_retry_interval_, remaining));
+  }
+
+  void set_sync_timeout(const boost::posix_time::time_duration& interval) {
+    if (active_ && ros::ok())
+    {
+      sync_timer_.cancel();
+      sync_timer_.expires_from_now(interval);
+      sync_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+          boost::bind(&Session::sync_timeout, this, boost::asio::placeholders::error))));
+    }
+  }
+
+  void sync_timeout(const boost::system::error_code& error) {
+    if (error != boost::asio::error::operation_aborted) {
+      ROS_DEBUG("Sync with device lost.");
+      stop();
+    }
+  }
+
+  /**
+   * Asks a client which this session hasn't set up for its topics right away, rather
+   * than waiting for the sync timer, once it is heard from. The client answers a
+   * request with a time request before its topics, so none goes out for a short
+   * while after the last, which it may still be answering.
+   */
+  void request_topics_now(const char* reason) {
+    if (client_configured_ ||
+        boost::posix_time::microsec_clock::universal_time() - topics_requested_at_ < topics_request_holdoff_) {
+      return;
+    }
+    ROS_DEBUG("%s, so requesting topics now.", reason);
+    request_topics();
+  }
+
+  // Called on the strand when the read buffer skips frames from another protocol
+  // version, which most likely come from a client booting with stale settings, or
+  // one which is built against an older release and can't be set up.
+  void protocol_mismatch() {
+    if (client_configured_) {
+      return;
+    }
+    ROS_WARN_THROTTLE(5, "Frames from the client have the wrong protocol version. Is its firmware "
+                      "built against a different rosserial release?");
+    request_topics_now("Heard from the client with the wrong protocol version");
+  }
+
+  //// BAUD RATE NEGOTIATION ////
+
+  /**
+   * The client offers the rates it can switch to once it has sent its topics, and
+   * sends back the probes sent to it at a new rate; see FEATURE_BAUD in the
+   * client's node_handle.h.
+   */
+  void handle_baud(ros::serialization::IStream& stream) {
+    uint8_t op;
+    stream >> op;
+    if (op == baud_offer) {
+      uint8_t count;
+      stream >> count;
+      baud_offered_.clear();
+      for (int i = 0; i < count && stream.getLength() >= 4; i++) {
+        uint32_t rate;
+        stream >> rate;
+        baud_offered_.push_back(rate);
+      }
+      if (baud_state_ == baud_idle) {
+        raise_baud();
+      }
+    } else if (op == baud_probe && baud_state_ == baud_probing) {
+      uint8_t index;
+      stream >> index;
+      for (int i = 0; i < baud_probe_bytes; i++) {
+        if (stream.getLength() == 0 || *stream.advance(1) != probe_byte(index, i)) {
+          return;
+        }
+      }
+      if (++baud_echoes_ == baud_probes) {
+        confirm_baud();
+      }
+    }
+  }
+
+  /**
+   * Of the rates both ends have and which haven't failed, the highest above the
+   * current one, or below it when lower, or zero if there is none.
+   */
+  uint32_t pick_baud(bool lower) {
+    uint32_t best = 0;
+    for (size_t i = 0; i < baud_rates_.size(); i++) {
+      uint32_t rate = baud_rates_[i];
+      bool wanted = lower ? rate < baud_current_ : rate > baud_current_;
+      if (wanted && rate > best && !baud_failed_.count(rate) &&
+          std::find(baud_offered_.begin(), baud_offered_.end(), rate) != baud_offered_.end()) {
+        best = rate;
+      }
+    }
+    return best;
+  }
+
+  void raise_baud() {
+    uint32_t rate = pick_baud(false);
+    if (rate > 0) {
+      begin_baud_switch(rate);
+    }
+  }
+
+  void begin_baud_switch(uint32_t rate) {
+    ROS_DEBUG("Asking the client to switch from %u to %u bps.", baud_current_, rate);
+    baud_previous_ = baud_current_;
+    baud_target_ = rate;
+    baud_state_ = baud_switching;
+    std::vector<uint8_t> message(9);
+    message[0] = baud_switch;
+    for (int i = 0; i < 4; i++) {
+      message[1 + i] = (rate >> (8 * i)) & 0xff;
+      message[5 + i] = (baud_previous_ >> (8 * i)) & 0xff;
+    }
+    write_message(message, rosserial_msgs::TopicInfo::ID_BAUD);
+  }
+
+  void set_baud(uint32_t rate) {
+    baud_switch_(rate);
+    baud_current_ = rate;
+    set_link_bandwidth(rate / 10);
+  }
+
+  // The client switches as it reads the request, so the probes wait a moment for
+  // it to have done so, in case the port holds on to the request's last bytes.
+  void switch_baud() {
+    set_baud(baud_target_);
+    baud_state_ = baud_settling;
+    set_baud_timeout(boost::posix_time::milliseconds(static_cast<long>(baud_settle_ms)));
+  }
+
+  void send_baud_probes() {
+    baud_state_ = baud_probing;
+    baud_echoes_ = 0;
+    for (int index = 0; index < baud_probes; index++) {
+      std::vector<uint8_t> message(2 + baud_probe_bytes);
+      message[0] = baud_probe;
+      message[1] = index;
+      for (int i = 0; i < baud_probe_bytes; i++) {
+        message[2 + i] = probe_byte(index, i);
+      }
+      write_message(message, rosserial_msgs::TopicInfo::ID_BAUD);
+    }
+    set_baud_timeout(baud_probe_timeout_);
+  }
+
+  // A spread of byte values, zero and 0xff among them.
+  static uint8_t probe_byte(int index, int i) {
+    return static_cast<uint8_t>((index * baud_probe_bytes + i) * 37);
+  }
+
+  void confirm_baud() {
+    ROS_INFO("Link to the client switched to %u bps.", baud_current_);
+    baud_state_ = baud_idle;
+    std::vector<uint8_t> message(5);
+    message[0] = baud_confirm;
+    for (int i = 0; i < 4; i++) {
+      message[1 + i] = (baud_current_ >> (8 * i)) & 0xff;
+    }
+    write_message(message, rosserial_msgs::TopicInfo::ID_BAUD);
+    baud_errors_ = link_errors();
+    set_baud_timeout(boost::posix_time::seconds(1));
+  }
+
+  uint64_t link_errors() {
+    return stats_.checksum_errors() + async_read_buffer_.header_errors();
+  }
+
+  void set_baud_timeout(const boost::posix_time::time_duration& interval) {
+    baud_timer_.expires_from_now(interval);
+    baud_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+        boost::bind(&Session::baud_timeout, this, boost::asio::placeholders::error))));
+  }
+
+  void baud_timeout(const boost::system::error_code& error) {
+    if (error == boost::asio::error::operation_aborted || !active_) {
+      return;
+    }
+    if (baud_state_ == baud_settling) {
+      send_baud_probes();
+    } else if (baud_state_ == baud_probing) {
+      // The client goes back too, once it has gone without a confirmation for a
+      // while, after which the next rate down can be tried. A rate which fails on
+      // the way down leaves nothing known to work but the initial one, which both
+      // ends go back to when the session restarts.
+      ROS_WARN("Only %d of %d probes came back from the client at %u bps.", baud_echoes_, baud_probes,
+               baud_current_);
+      baud_failed_.insert(baud_current_);
+      if (baud_failed_.count(baud_previous_)) {
+        stop();
+        return;
+      }
+      set_baud(baud_previous_);
+      baud_state_ = baud_backoff;
+      set_baud_timeout(boost::posix_time::milliseconds(static_cast<long>(baud_backoff_ms)));
+    } else if (baud_state_ == baud_backoff) {
+      baud_state_ = baud_idle;
+      raise_baud();
+    } else if (baud_state_ == baud_idle && baud_current_ != baud_initial_) {
+      // Once a second, check the raised rate is still holding up.
+      uint64_t errors = link_errors();
+      if (errors - baud_errors_ > static_cast<uint64_t>(baud_error_limit_)) {
+        ROS_WARN("%d errors in the last second at %u bps; lowering the rate.",
+                 static_cast<int>(errors - baud_errors_), baud_current_);
+        baud_failed_.insert(baud_current_);
+        uint32_t rate = pick_baud(true);
+        begin_baud_switch(rate > 0 ? rate : baud_initial_);
+        return;
+      }
+      baud_errors_ = errors;
+      set_baud_timeout(boost::posix_time::seconds(1));
+    }
+  }
+
+  //// STATISTICS ////
+  void set_stats_timeout() {
+    if (diagnostics_pub_) {
+      stats_timer_.expires_from_now(stats_interval_);
+      stats_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+          boost::bind(&Session::stats_timeout, this, boost::asio::placeholders::error))));
+    }
+  }
+
+  void stats_timeout(const boost::system::error_code& error) {
+    if (error == boost::asio::error::operation_aborted || !active_) {
+      return;
+    }
+
+    diagnostic_msgs::DiagnosticArray array;
+    array.header.stamp = ros::Time::now();
+    array.status.resize(1);
+    diagnostic_msgs::DiagnosticStatus& status = array.status[0];
+    status.name = stats_name_;
+    status.hardware_id = hardware_id_;
+    stats_.report(status, async_read_buffer_.header_errors() + datagram_header_errors_,
+                  async_read_buffer_.oversize_frames());
+    size_t frame_overhead = client_crc16_ ? FrameParser::crc16_overhead_bytes : FrameParser::overhead_bytes;
+    link_budget_.report(status, stats_.bytes_in_rate() + stats_.frames_in_rate() * frame_overhead,
+                        stats_.bytes_out_rate());
+    diagnostics_pub_.publish(array);
+
+    set_stats_timeout();
+  }
+
+  //// TRACING ////
+  bool dump_trace(std_srvs::Empty::Request&, std_srvs::Empty::Response&) {
+    return dump_trace_to_file();
+  }
+
+  bool dump_trace_to_file() {
+    if (!trace_.dump(trace_file_)) {
+      ROS_WARN_STREAM("Unable to write frame trace to " << trace_file_);
+      return false;
+    }
+    ROS_INFO_STREAM("Frame trace written to " << trace_file_);
+    return true;
+  }
+
+  //// HELPERS ////
+  void request_topics() {
+    // Older clients ignore the body of the request, and so never batch or send
+    // CRCs. Until the client answers with a CRC frame, it may have been replaced by
+    // one which can't take them, so frames go out with a checksum meanwhile, and
+    // unencoded.
+    std::vector<uint8_t> message(1, feature_batch | feature_crc16 | feature_cobs | feature_compression |
+                                    feature_topic_fingerprint | feature_param_batch |
+                                    feature_log_deferred | (baud_switch_ ? feature_baud : 0));
+    // Features past the first byte's worth go in a second.
+    message.push_back(feature2_delta | (sequence_numbers_ ? feature2_sequence : 0) |
+                      (multicast_ ? feature2_multicast : 0));
+    client_crc16_ = false;
+    client_cobs_ = false;
+    recording_topics_ = false;
+    client_configured_ = false;
+    topics_requested_at_ = boost::posix_time::microsec_clock::universal_time();
+    ROS_DEBUG("Sending request topics message for VER2 protocol.");
+    write_message(message, rosserial_msgs::TopicInfo::ID_PUBLISHER);
+
+    // Set timer for future point at which to verify the subscribers and publishers
+    // created by the client against the expected set given in the parameters.
+    require_check_timer_.expires_from_now(require_check_interval_);
+    require_check_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+        boost::bind(&Session::required_topics_check, this, boost::asio::placeholders::error))));
+  }
+
+  void required_topics_check(const boost::system::error_code& error) {
+    if (error != boost::asio::error::operation_aborted) {
+      if (ros::param::has(require_param_name_)) {
+        if (!check_set(require_param_name_ + "/publishers", publishers_) ||
+            !check_set(require_param_name_ + "/subscribers", subscribers_)) {
+          ROS_WARN("Connected client failed to establish the publishers and subscribers dictated by require parameter. Re-requesting topics.");
+          request_topics();
+        }
+      }
+    }
+  }
+
+  template<typename M>
   bool check_set(std::string param_name, M map) {
     XmlRpc::XmlRpcValue param_list;
     ros::param::get(param_name, param_list);
@@ -371,40 +1634,428 @@ private:
     return true;
   }
 
-  static uint8_t checksum(ros::serialization::IStream& stream) {
-    uint8_t sum = 0;
-    for (uint16_t i = 0; i < stream.getLength(); ++i) {
-      sum += stream.getData()[i];
+  static uint8_t checksum(uint16_t val) {
+    return FrameParser::checksum(val);
+  }
+
+  int parse_drop_policy(const std::string& name, const std::string& where) {
+    if (name == "newest") {
+      return drop_newest;
+    } else if (name == "never") {
+      return drop_never;
+    } else if (name != "oldest") {
+      ROS_WARN_STREAM("Unknown drop policy " << name << " in " << where << ", which should be oldest, newest or never.");
     }
-    return sum;
+    return drop_oldest;
   }
 
-  static uint8_t checksum(uint16_t val) {
-    return (val >> 8) + val;
+  /**
+   * As read_max_rates, for ~drop_policies.
+   */
+  void read_drop_policies(XmlRpc::XmlRpcValue& drop_policies, const std::string& prefix) {
+    for (XmlRpc::XmlRpcValue::iterator it = drop_policies.begin(); it != drop_policies.end(); ++it) {
+      std::string topic = prefix + it->first;
+      XmlRpc::XmlRpcValue& policy = it->second;
+      if (policy.getType() == XmlRpc::XmlRpcValue::TypeString) {
+        drop_policy_names_[topic] = parse_drop_policy(policy, "~drop_policies");
+      } else if (policy.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_drop_policies(policy, topic + "/");
+      } else {
+        ROS_WARN_STREAM("Ignoring ~drop_policies entry for " << topic << ", which isn't a policy name.");
+      }
+    }
+  }
+
+  void set_drop_policy(uint16_t topic_id, const std::string& topic_name) {
+    std::string resolved = nh_.resolveName(topic_name);
+    for (std::map<std::string, int>::const_iterator it = drop_policy_names_.begin();
+         it != drop_policy_names_.end(); ++it) {
+      if (nh_.resolveName(it->first) == resolved) {
+        topic_drop_policies_[topic_id] = it->second;
+        return;
+      }
+    }
+  }
+
+  void read_priorities(const std::string& param_name, int priority) {
+    XmlRpc::XmlRpcValue topics;
+    if (!ros::param::get(param_name, topics)) {
+      return;
+    }
+    if (topics.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      ROS_WARN_STREAM("Ignoring " << param_name << ", which should be a list of topic names.");
+      return;
+    }
+    for (int i = 0; i < topics.size(); ++i) {
+      if (topics[i].getType() == XmlRpc::XmlRpcValue::TypeString) {
+        priority_names_[std::string(topics[i])] = priority;
+      }
+    }
+  }
+
+  // Each topic's priority class, and how many of its frames are waiting in that
+  // class's queue out of the most which may be, by topic ID. These are looked up
+  // with every frame queued and written, so they're kept flat rather than in a map.
+  struct TopicQueue {
+    int priority;
+    size_t waiting;
+    size_t depth;
+  };
+
+  /**
+   * A topic's entry in topic_queues_, adding entries up to it the first time a
+   * topic ID is seen. Topics which aren't named in the ~priorities lists are of
+   * normal priority, other than the ones the protocol itself uses, such as time
+   * sync, which are high.
+   */
+  TopicQueue& topic_queue_for(uint16_t topic_id) {
+    if (topic_id >= topic_queues_.size()) {
+      size_t first = topic_queues_.size();
+      TopicQueue topic_queue = { priority_normal, 0, write_queue_depth_ };
+      topic_queues_.resize(topic_id + 1, topic_queue);
+      for (size_t id = first; id < topic_queues_.size() && id < 100; id++) {
+        topic_queues_[id].priority = priority_high;
+      }
+    }
+    return topic_queues_[topic_id];
+  }
+
+  /**
+   * Gives a topic the client subscribes to, or calls as a service, its priority
+   * and write queue depth, from the ~priorities lists and ~write_queue_depths.
+   */
+  void set_write_queue(uint16_t topic_id, const std::string& topic_name) {
+    TopicQueue& topic_queue = topic_queue_for(topic_id);
+    std::string resolved = nh_.resolveName(topic_name);
+    for (std::map<std::string, int>::const_iterator it = priority_names_.begin(); it != priority_names_.end(); ++it) {
+      if (nh_.resolveName(it->first) == resolved) {
+        ROS_DEBUG_STREAM("Sending topic " << topic_name << " at priority " << it->second << ".");
+        topic_queue.priority = it->second;
+        break;
+      }
+    }
+    for (std::map<std::string, int>::const_iterator it = write_queue_depth_names_.begin();
+         it != write_queue_depth_names_.end(); ++it) {
+      if (nh_.resolveName(it->first) == resolved) {
+        topic_queue.depth = it->second > 0 ? it->second : 0;
+        break;
+      }
+    }
+  }
+
+  /**
+   * As read_max_rates, for ~write_queue_depths.
+   */
+  void read_write_queue_depths(XmlRpc::XmlRpcValue& depths, const std::string& prefix) {
+    for (XmlRpc::XmlRpcValue::iterator it = depths.begin(); it != depths.end(); ++it) {
+      std::string topic = prefix + it->first;
+      XmlRpc::XmlRpcValue& depth = it->second;
+      if (depth.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+        write_queue_depth_names_[topic] = static_cast<int>(depth);
+      } else if (depth.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_write_queue_depths(depth, topic + "/");
+      } else {
+        ROS_WARN_STREAM("Ignoring ~write_queue_depths entry for " << topic << ", which isn't an integer.");
+      }
+    }
+  }
+
+  /**
+   * Topic names with slashes in come back from the parameter server as nested
+   * dictionaries, so their parts are joined up again here.
+   */
+  void read_max_rates(XmlRpc::XmlRpcValue& max_rates, const std::string& prefix) {
+    for (XmlRpc::XmlRpcValue::iterator it = max_rates.begin(); it != max_rates.end(); ++it) {
+      std::string topic = prefix + it->first;
+      XmlRpc::XmlRpcValue& rate = it->second;
+      if (rate.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+        max_rates_[topic] = static_cast<double>(rate);
+      } else if (rate.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+        max_rates_[topic] = static_cast<int>(rate);
+      } else if (rate.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+        read_max_rates(rate, topic + "/");
+      } else {
+        ROS_WARN_STREAM("Ignoring ~max_rates entry for " << topic << ", which isn't a number.");
+      }
+    }
+  }
+
+  /**
+   * The rate to limit a topic the client subscribes to to, matching ~max_rates
+   * entries to it by their resolved names.
+   */
+  double max_rate_for(const std::string& topic_name) {
+    std::string resolved = nh_.resolveName(topic_name);
+    for (std::map<std::string, double>::const_iterator it = max_rates_.begin(); it != max_rates_.end(); ++it) {
+      if (nh_.resolveName(it->first) == resolved) {
+        return it->second;
+      }
+    }
+    return default_max_rate_;
+  }
+
+  /**
+   * As read_max_rates, for ~topic_options; a dictionary with any of the options
+   * in is taken to be a topic's, and any other to be a level of its name.
+   */
+  void read_topic_options(XmlRpc::XmlRpcValue& topic_options, const std::string& prefix) {
+    for (XmlRpc::XmlRpcValue::iterator it = topic_options.begin(); it != topic_options.end(); ++it) {
+      std::string topic = prefix + it->first;
+      XmlRpc::XmlRpcValue& entry = it->second;
+      if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct) {
+        ROS_WARN_STREAM("Ignoring ~topic_options entry for " << topic << ", which isn't a dictionary.");
+      } else if (entry.hasMember("queue_size") || entry.hasMember("tcp_nodelay") || entry.hasMember("udp") ||
+                 entry.hasMember("receive_stamp") || entry.hasMember("replay_last")) {
+        TopicOptions options = default_topic_options_;
+        if (entry.hasMember("queue_size") && entry["queue_size"].getType() == XmlRpc::XmlRpcValue::TypeInt) {
+          options.queue_size = static_cast<int>(entry["queue_size"]);
+        }
+        if (entry.hasMember("tcp_nodelay") && entry["tcp_nodelay"].getType() == XmlRpc::XmlRpcValue::TypeBoolean) {
+          options.tcp_nodelay = static_cast<bool>(entry["tcp_nodelay"]);
+        }
+        if (entry.hasMember("udp") && entry["udp"].getType() == XmlRpc::XmlRpcValue::TypeBoolean) {
+          options.udp = static_cast<bool>(entry["udp"]);
+        }
+        if (entry.hasMember("receive_stamp") &&
+            entry["receive_stamp"].getType() == XmlRpc::XmlRpcValue::TypeBoolean) {
+          options.receive_stamp = static_cast<bool>(entry["receive_stamp"]);
+        }
+        if (entry.hasMember("replay_last") && entry["replay_last"].getType() == XmlRpc::XmlRpcValue::TypeBoolean) {
+          options.replay_last = static_cast<bool>(entry["replay_last"]);
+        }
+        topic_options_[topic] = options;
+      } else {
+        read_topic_options(entry, topic + "/");
+      }
+    }
+  }
+
+  /**
+   * The options for a topic, matching ~topic_options entries to it by their
+   * resolved names.
+   */
+  TopicOptions topic_options_for(const std::string& topic_name) {
+    std::string resolved = nh_.resolveName(topic_name);
+    for (std::map<std::string, TopicOptions>::const_iterator it = topic_options_.begin();
+         it != topic_options_.end(); ++it) {
+      if (nh_.resolveName(it->first) == resolved) {
+        return it->second;
+      }
+    }
+    return default_topic_options_;
+  }
+
+  /**
+   * Reads a TopicInfo, allowing for clients from before it had flags, which
+   * leave them off the end.
+   */
+  static void read_topic_info(ros::serialization::IStream& stream, rosserial_msgs::TopicInfo& topic_info) {
+    stream >> topic_info.topic_id >> topic_info.topic_name >> topic_info.message_type
+           >> topic_info.md5sum >> topic_info.buffer_size;
+    topic_info.flags = 0;
+    if (stream.getLength() > 0) {
+      stream >> topic_info.flags;
+    }
   }
 
   //// RECEIVED MESSAGE HANDLERS ////
 
+  /**
+   * A publisher whose message definition has to be looked up waits until the rest
+   * of the frames read with it have been handled, so that the definitions for all
+   * the topics a client sends together are looked up in one call.
+   */
   void setup_publisher(ros::serialization::IStream& stream) {
     rosserial_msgs::TopicInfo topic_info;
-    ros::serialization::Serializer<rosserial_msgs::TopicInfo>::read(stream, topic_info);
+    read_topic_info(stream, topic_info);
 
-    PublisherPtr pub(new Publisher(nh_, topic_info));
-    callbacks_[topic_info.topic_id] = boost::bind(&Publisher::handle, pub, _1);
+    std::string definition;
+    if (MessageInfoCache::instance().getDefinition(topic_info.message_type, topic_info.md5sum, definition)) {
+      create_publisher(topic_info);
+      return;
+    }
+    // Frames on the topic may follow before it is set up.
+    reserve_read_buffer(topic_info);
+    pending_publishers_.push_back(topic_info);
+    if (pending_publishers_.size() == 1) {
+      strand_.post(make_guarded_handler(lifeline_.hold(), boost::bind(&Session::create_pending_publishers, this)));
+    }
+  }
+
+  void create_pending_publishers() {
+    std::vector<rosserial_msgs::TopicInfo> topics;
+    topics.swap(pending_publishers_);
+    Publisher::prefetch_definitions(nh_, topics);
+    for (size_t i = 0; i < topics.size(); i++) {
+      create_publisher(topics[i]);
+    }
+  }
+
+  void create_publisher(const rosserial_msgs::TopicInfo& topic_info) {
+    TopicOptions options = topic_options_for(topic_info.topic_name);
+    PublisherPtr pub = unpark(parked_publishers_, topic_info);
+    if (!pub) {
+      pub.reset(new Publisher(nh_, topic_info, shared_publish_, options));
+    }
+    // Anything done to the message on its way in is done on the strand, where the
+    // session's state is, and only the publishing itself handed to the pipeline.
+    DispatchTable::Callback handler = dispatch_pipeline_ ?
+        DispatchTable::Callback(boost::bind(&Session::hand_off, this, pub, _1)) :
+        DispatchTable::Callback(boost::bind(&Publisher::handle, pub, _1));
+    if (options.receive_stamp && has_header(topic_info)) {
+      ROS_DEBUG("Stamping unstamped messages on topic %s as they arrive.", topic_info.topic_name.c_str());
+      handler = boost::bind(&Session::handle_receive_stamp, this, handler, _1);
+    }
+    std::string definition;
+    if (!quantization_.empty() &&
+        MessageInfoCache::instance().getDefinition(topic_info.message_type, topic_info.md5sum, definition)) {
+      // Quantized fields are expanded last, once the message is whole.
+      QuantizedLayoutPtr layout = quantization_.layout(topic_info.message_type, definition);
+      if (layout) {
+        ROS_DEBUG("Client sends topic %s with quantized fields.", topic_info.topic_name.c_str());
+        handler = boost::bind(&Session::handle_quantized, this, layout, handler, _1);
+      }
+    }
+    if (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_COMPRESSED) {
+      ROS_DEBUG("Client sends topic %s compressed.", topic_info.topic_name.c_str());
+      handler = boost::bind(&Session::handle_compressed, this, handler, _1);
+    }
+    if (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_DELTA) {
+      ROS_DEBUG("Client sends topic %s delta encoded.", topic_info.topic_name.c_str());
+      handler = boost::bind(&Session::handle_delta, this, topic_info.topic_id, handler, _1);
+      delta_keyframes_[topic_info.topic_id].number = -1;
+    }
+    if (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_SEQUENCED) {
+      // The sequence number comes ahead of anything else in the frame.
+      handler = boost::bind(&Session::handle_sequenced, this, topic_info.topic_id, handler, _1);
+      stats_.restart_sequence(topic_info.topic_id);
+    }
+    callbacks_[topic_info.topic_id] = handler;
     publishers_[topic_info.topic_id] = pub;
+    stats_.name_topic(topic_info.topic_id, topic_info.topic_name);
+    reserve_read_buffer(topic_info);
+    if (pause_unsubscribed_) {
+      pub->set_subscribed_callback(boost::bind(&Session::pause_topic, this, topic_info.topic_id, _1));
+    }
 
     set_sync_timeout(timeout_interval_);
   }
 
+  /**
+   * With pause_unsubscribed set, the client is asked to stop sending a topic while
+   * nothing subscribes to it, and to start again once something does.
+   */
+  void pause_topic(uint16_t topic_id, bool subscribed) {
+    ROS_DEBUG("Asking the client to %s topic %d.", subscribed ? "resume" : "pause", topic_id);
+    std::vector<uint8_t> message(3);
+    message[0] = topic_id & 0xff;
+    message[1] = topic_id >> 8;
+    message[2] = subscribed ? 0 : 1;
+    write_message(message, rosserial_msgs::TopicInfo::ID_TOPIC_PAUSE);
+  }
+
+  void hand_off(const PublisherPtr& pub, ros::serialization::IStream& stream) {
+    dispatch_pipeline_->push(pub, stream.getData(), stream.getLength());
+  }
+
   void setup_subscriber(ros::serialization::IStream& stream) {
     rosserial_msgs::TopicInfo topic_info;
-    ros::serialization::Serializer<rosserial_msgs::TopicInfo>::read(stream, topic_info);
+    read_topic_info(stream, topic_info);
+    leave_multicast(topic_info.topic_id);
+    if (join_multicast(topic_info)) {
+      return;
+    }
+
+    // Only a rate limited topic has a bound on what it may send.
+    double max_rate = max_rate_for(topic_info.topic_name);
+    if (max_rate > 0 && !link_budget_.commit(topic_info.topic_id, topic_info.topic_name,
+                                             max_rate * (topic_info.buffer_size + overhead_bytes))) {
+      return;
+    }
 
-    SubscriberPtr sub(new Subscriber(nh_, topic_info,
-        boost::bind(&Session::write_message, this, _1, topic_info.topic_id)));
+    boost::function<void(const topic_tools::ShapeShifter&)> write_fn =
+        boost::bind(&Session::write_serialized<topic_tools::ShapeShifter>, this, _1, topic_info.topic_id);
+    if (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_SEQUENCED) {
+      write_fn = boost::bind(&Session::write_sequenced<topic_tools::ShapeShifter>, this, _1, topic_info.topic_id);
+      out_sequences_[topic_info.topic_id] = 0;
+    }
+    if (!quantization_.empty()) {
+      write_fn = boost::bind(&Session::write_quantized, this, _1, topic_info.topic_id,
+                             (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_SEQUENCED) != 0);
+      out_layouts_.erase(topic_info.topic_id);
+    }
+    // A message from a shared subscription goes out as it is, unless it has to be
+    // numbered or quantized on its way.
+    boost::function<void(const SharedPayloadPtr&)> shared_write_fn;
+    if (!(topic_info.flags & rosserial_msgs::TopicInfo::FLAG_SEQUENCED) && quantization_.empty()) {
+      shared_write_fn = boost::bind(&Session::write_shared, this, _1, topic_info.topic_id);
+    }
+    SubscriberPtr sub = unpark(parked_subscribers_, topic_info);
+    if (sub) {
+      sub->reattach(write_fn, topic_info, shared_write_fn);
+    } else if (shared_subscriptions_) {
+      sub = Subscriber::shared(*shared_subscriptions_, strand_, lifeline_, nh_, topic_info, write_fn, shared_write_fn,
+                               trace_.enabled() ? &trace_ : NULL, topic_options_for(topic_info.topic_name));
+    } else {
+      sub.reset(new Subscriber(nh_, topic_info, write_fn, trace_.enabled() ? &trace_ : NULL,
+                               topic_options_for(topic_info.topic_name)));
+    }
+    if (max_rate > 0) {
+      ROS_DEBUG("Sending topic %s to the client at up to %g Hz.", topic_info.topic_name.c_str(), max_rate);
+      sub->set_max_rate(io_service_, strand_, max_rate);
+    }
     subscribers_[topic_info.topic_id] = sub;
+    set_write_queue(topic_info.topic_id, topic_info.topic_name);
+    set_drop_policy(topic_info.topic_id, topic_info.topic_name);
+    stats_.name_topic(topic_info.topic_id, topic_info.topic_name);
+    buffer_pool_.reserve(topic_info.buffer_size + overhead_bytes);
+    sub->replay_last();
+
+    set_sync_timeout(timeout_interval_);
+  }
 
+  /**
+   * Where the client can take the topic from the multicast group, and it is sent
+   * there, tells the client where to find it, in place of subscribing to it here.
+   * Quantized topics are always sent directly, since the group's frames aren't.
+   */
+  bool join_multicast(const rosserial_msgs::TopicInfo& topic_info) {
+    if (!multicast_ || !quantization_.empty() ||
+        !(topic_info.flags & rosserial_msgs::TopicInfo::FLAG_MULTICAST)) {
+      return false;
+    }
+    std::string resolved = nh_.resolveName(topic_info.topic_name);
+    uint16_t multicast_id = multicast_->join(resolved, topic_info);
+    if (multicast_id == 0) {
+      return false;
+    }
+    multicast_joined_[topic_info.topic_id] = resolved;
+    subscribers_.erase(topic_info.topic_id);
+
+    ROS_DEBUG_STREAM("Client takes " << resolved << " from multicast group " << multicast_->group());
+    const boost::asio::ip::udp::endpoint& group = multicast_->group();
+    boost::asio::ip::address_v4::bytes_type address = group.address().to_v4().to_bytes();
+    std::vector<uint8_t> message(10);
+    message[0] = topic_info.topic_id & 0xff;
+    message[1] = topic_info.topic_id >> 8;
+    message[2] = multicast_id & 0xff;
+    message[3] = multicast_id >> 8;
+    std::copy(address.begin(), address.end(), message.begin() + 4);
+    message[8] = group.port() & 0xff;
+    message[9] = group.port() >> 8;
+    write_message(message, rosserial_msgs::TopicInfo::ID_TOPIC_MULTICAST);
+
+    stats_.name_topic(topic_info.topic_id, topic_info.topic_name);
     set_sync_timeout(timeout_interval_);
+    return true;
+  }
+
+  void leave_multicast(uint16_t topic_id) {
+    std::map<uint16_t, std::string>::iterator it = multicast_joined_.find(topic_id);
+    if (it != multicast_joined_.end()) {
+      multicast_->leave(it->second);
+      multicast_joined_.erase(it);
+    }
   }
 
   // When the rosserial client creates a ServiceClient object (and/or when it registers that object with the NodeHandle)
@@ -415,15 +2066,18 @@ private:
 
   void setup_service_client_publisher(ros::serialization::IStream& stream) {
     rosserial_msgs::TopicInfo topic_info;
-    ros::serialization::Serializer<rosserial_msgs::TopicInfo>::read(stream, topic_info);
+    read_topic_info(stream, topic_info);
 
+    unpark_service(topic_info, true);
     if (!services_.count(topic_info.topic_name)) {
       ROS_DEBUG("Creating service client for topic %s",topic_info.topic_name.c_str());
       ServiceClientPtr srv(new ServiceClient(
-        nh_,topic_info,boost::bind(&Session::write_message, this, _1, _2)));
+        nh_,topic_info,boost::bind(&Session::write_message, this, _1, _2),
+        strand_, service_call_pool_, lifeline_));
       services_[topic_info.topic_name] = srv;
       callbacks_[topic_info.topic_id] = boost::bind(&ServiceClient::handle, srv, _1);
     }
+    reserve_read_buffer(topic_info);
     if (services_[topic_info.topic_name]->getRequestMessageMD5() != topic_info.md5sum) {
       ROS_WARN("Service client setup: Request message MD5 mismatch between rosserial client and ROS");
     } else {
@@ -435,17 +2089,21 @@ private:
 
   void setup_service_client_subscriber(ros::serialization::IStream& stream) {
     rosserial_msgs::TopicInfo topic_info;
-    ros::serialization::Serializer<rosserial_msgs::TopicInfo>::read(stream, topic_info);
+    read_topic_info(stream, topic_info);
 
+    unpark_service(topic_info, false);
     if (!services_.count(topic_info.topic_name)) {
       ROS_DEBUG("Creating service client for topic %s",topic_info.topic_name.c_str());
       ServiceClientPtr srv(new ServiceClient(
-        nh_,topic_info,boost::bind(&Session::write_message, this, _1, _2)));
+        nh_,topic_info,boost::bind(&Session::write_message, this, _1, _2),
+        strand_, service_call_pool_, lifeline_));
       services_[topic_info.topic_name] = srv;
       callbacks_[topic_info.topic_id] = boost::bind(&ServiceClient::handle, srv, _1);
     }
     // see above comment regarding the service client callback for why we set topic_id here
     services_[topic_info.topic_name]->setTopicId(topic_info.topic_id);
+    set_write_queue(topic_info.topic_id, topic_info.topic_name);
+    buffer_pool_.reserve(topic_info.buffer_size + overhead_bytes);
     if (services_[topic_info.topic_name]->getResponseMessageMD5() != topic_info.md5sum) {
       ROS_WARN("Service client setup: Response message MD5 mismatch between rosserial client and ROS");
     } else {
@@ -455,51 +2113,560 @@ private:
     set_sync_timeout(timeout_interval_);
   }
 
+  //// HANDLERS KEPT ACROSS RECONNECTS ////
+
+  static std::string park_key(const rosserial_msgs::TopicInfo& topic_info) {
+    return topic_info.topic_name + '\n' + topic_info.message_type + '\n' + topic_info.md5sum;
+  }
+
+  void park_handlers() {
+    if (reconnect_grace_ <= 0) {
+      return;
+    }
+    for (std::map<uint16_t, PublisherPtr>::iterator it = publishers_.begin(); it != publishers_.end(); ++it) {
+      it->second->park();
+      parked_publishers_[park_key(it->second->get_topic_info())] = it->second;
+    }
+    for (std::map<uint16_t, SubscriberPtr>::iterator it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+      it->second->park();
+      parked_subscribers_[park_key(it->second->get_topic_info())] = it->second;
+    }
+    // Service clients are detached by stop(), and keyed by name alone, as each is
+    // set up from two topics, one for the request and one for the response.
+    for (std::map<std::string, ServiceClientPtr>::iterator it = services_.begin(); it != services_.end(); ++it) {
+      parked_services_[it->first] = it->second;
+    }
+    if (parked_publishers_.empty() && parked_subscribers_.empty() && parked_services_.empty()) {
+      return;
+    }
+    ROS_DEBUG("Keeping %d publishers, %d subscribers and %d service clients for %g s, for the client to "
+              "come back to.", static_cast<int>(parked_publishers_.size()),
+              static_cast<int>(parked_subscribers_.size()), static_cast<int>(parked_services_.size()),
+              reconnect_grace_);
+    park_timer_.expires_from_now(boost::posix_time::microseconds(static_cast<int64_t>(reconnect_grace_ * 1e6)));
+    park_timer_.async_wait(strand_.wrap(make_guarded_handler(lifeline_.hold(),
+        boost::bind(&Session::drop_parked, this, boost::asio::placeholders::error))));
+  }
+
+  template<class HandlerPtr>
+  static HandlerPtr unpark(std::map<std::string, HandlerPtr>& parked, const rosserial_msgs::TopicInfo& topic_info) {
+    typename std::map<std::string, HandlerPtr>::iterator it = parked.find(park_key(topic_info));
+    if (it == parked.end()) {
+      return HandlerPtr();
+    }
+    HandlerPtr handler = it->second;
+    parked.erase(it);
+    return handler;
+  }
+
+  /**
+   * Takes up a service client kept from before the client reconnected, if it's for
+   * the same service, going by whichever of its two topics this is.
+   */
+  void unpark_service(const rosserial_msgs::TopicInfo& topic_info, bool request) {
+    std::map<std::string, ServiceClientPtr>::iterator it = parked_services_.find(topic_info.topic_name);
+    if (it == parked_services_.end()) {
+      return;
+    }
+    ServiceClientPtr srv = it->second;
+    parked_services_.erase(it);
+    if ((request ? srv->getRequestMessageMD5() : srv->getResponseMessageMD5()) != topic_info.md5sum) {
+      return;
+    }
+    srv->reattach(boost::bind(&Session::write_message, this, _1, _2));
+    services_[topic_info.topic_name] = srv;
+    callbacks_[topic_info.topic_id] = boost::bind(&ServiceClient::handle, srv, _1);
+  }
+
+  void drop_parked(const boost::system::error_code& error) {
+    if (error) {
+      return;
+    }
+    if (!parked_publishers_.empty() || !parked_subscribers_.empty() || !parked_services_.empty()) {
+      ROS_INFO("Dropping %d publishers, %d subscribers and %d service clients the client didn't come back to.",
+               static_cast<int>(parked_publishers_.size()), static_cast<int>(parked_subscribers_.size()),
+               static_cast<int>(parked_services_.size()));
+    }
+    parked_publishers_.clear();
+    parked_subscribers_.clear();
+    parked_services_.clear();
+  }
+
+  /**
+   * The client reports the size of the buffer it sends this topic from, so frames
+   * on it can be that long; make sure ours is big enough to receive them, COBS
+   * encoded or not, and with a sequence number ahead of the message if it has one.
+   */
+  void reserve_read_buffer(const rosserial_msgs::TopicInfo& topic_info) {
+    size_t sequence_bytes = (topic_info.flags & rosserial_msgs::TopicInfo::FLAG_SEQUENCED) ? 1 : 0;
+    size_t frame_bytes = FrameParser::max_cobs_bytes(topic_info.buffer_size + sequence_bytes + overhead_bytes);
+    if (frame_bytes <= async_read_buffer_.capacity()) {
+      return;
+    }
+    if (frame_bytes > max_read_buffer_size_) {
+      ROS_WARN_STREAM("Client sends topic " << topic_info.topic_name << " from a buffer of " <<
+                      topic_info.buffer_size << " bytes, but frames are limited to " << max_read_buffer_size_ <<
+                      " bytes. Larger messages on it will be dropped.");
+      frame_bytes = max_read_buffer_size_;
+    }
+    async_read_buffer_.reserve(frame_bytes);
+  }
+
+  /**
+   * Frames on topics the client compresses, in response to feature_compression,
+   * carry the 16-bit length of the message, then the message LZ4 compressed, or
+   * as it is when that would have been no shorter.
+   */
+  void handle_compressed(const DispatchTable::Callback& handler, ros::serialization::IStream& stream) {
+    uint16_t length;
+    stream >> length;
+    if (stream.getLength() == length) {
+      handler(stream);
+      return;
+    }
+    decompressed_.resize(length);
+    if (!Lz4Decoder::decompress(stream.getData(), stream.getLength(), decompressed_.data(), length)) {
+      ROS_WARN_THROTTLE(1, "Dropping a compressed message from the client which doesn't decompress.");
+      return;
+    }
+    ros::serialization::IStream decompressed_stream(decompressed_.data(), length);
+    handler(decompressed_stream);
+  }
+
+  /**
+   * Frames on topics the client delta encodes, in response to feature2_delta,
+   * start with the number of a keyframe. Either the message follows as it is, to
+   * be that keyframe, or, with delta_encoded set, its 16-bit length follows, then
+   * the message as it differs from the keyframe. Deltas on a keyframe which never
+   * arrived are dropped; the client sends a fresh one every so often.
+   */
+  void handle_delta(uint16_t topic_id, const DispatchTable::Callback& handler,
+                    ros::serialization::IStream& stream) {
+    uint8_t header;
+    stream >> header;
+    DeltaKeyframe& keyframe = delta_keyframes_[topic_id];
+    int number = header & delta_keyframe_mask;
+    if (!(header & delta_encoded)) {
+      keyframe.number = number;
+      keyframe.bytes.assign(stream.getData(), stream.getData() + stream.getLength());
+      handler(stream);
+      return;
+    }
+    uint16_t length;
+    stream >> length;
+    if (keyframe.number != number) {
+      ROS_WARN_THROTTLE(1, "Dropping a delta from the client on a keyframe which didn't arrive.");
+      return;
+    }
+    delta_decoded_.resize(length);
+    if (!DeltaDecoder::decode(keyframe.bytes.data(), keyframe.bytes.size(), stream.getData(), stream.getLength(),
+                              delta_decoded_.data(), length)) {
+      ROS_WARN_THROTTLE(1, "Dropping a delta from the client which doesn't decode.");
+      return;
+    }
+    ros::serialization::IStream decoded_stream(delta_decoded_.data(), length);
+    handler(decoded_stream);
+  }
+
+  /**
+   * Messages of types with quantized fields, from the client, which are expanded
+   * to their standard serialization for publishing.
+   */
+  void handle_quantized(const QuantizedLayoutPtr& layout, const DispatchTable::Callback& handler,
+                        ros::serialization::IStream& stream) {
+    if (!layout->expand(stream.getData(), stream.getLength(), expanded_)) {
+      ROS_WARN_THROTTLE(1, "Dropping a message from the client whose quantized fields don't match its type.");
+      return;
+    }
+    ros::serialization::IStream expanded_stream(expanded_.data(), expanded_.size());
+    handler(expanded_stream);
+  }
+
+  /**
+   * Messages from the client on a topic set to receive_stamp, whose Header's
+   * stamp is filled in, where the client left it zero, with the time the frame
+   * arrived, less its time crossing the link and ~receive_stamp_latency.
+   */
+  void handle_receive_stamp(const DispatchTable::Callback& handler, ros::serialization::IStream& stream) {
+    uint8_t* stamp = stream.getData() + 4;
+    if (stream.getLength() >= 12 && std::count(stamp, stamp + 8, 0) == 8) {
+      double latency = receive_stamp_latency_;
+      if (link_budget_.capacity() > 0) {
+        latency += (stream.getLength() + overhead_bytes) / link_budget_.capacity();
+      }
+      ros::Time received = ros::Time::now() - ros::Duration(latency);
+      ros::serialization::OStream out(stamp, 8);
+      out << received.sec << received.nsec;
+    }
+    handler(stream);
+  }
+
+  /**
+   * Whether the topic's messages start with a Header, by their definition.
+   */
+  static bool has_header(const rosserial_msgs::TopicInfo& topic_info) {
+    std::string md5sum, definition;
+    if (MessageInfoCache::instance().getDefinition(topic_info.message_type, topic_info.md5sum, definition) ||
+        (MessageDefinitions::instance().lookup_message(topic_info.message_type, md5sum, definition) &&
+         md5sum == topic_info.md5sum)) {
+      return starts_with_header(definition);
+    }
+    ROS_WARN_STREAM("Unable to tell whether " << topic_info.message_type << " has a Header; messages on "
+                    << topic_info.topic_name << " won't be stamped as they arrive.");
+    return false;
+  }
+
+  /**
+   * Frames on topics the client numbers, in response to feature2_sequence, start
+   * with a byte counting the messages the client has sent on the topic, from
+   * which those lost on the way are counted.
+   */
+  void handle_sequenced(uint16_t topic_id, const DispatchTable::Callback& handler,
+                        ros::serialization::IStream& stream) {
+    uint8_t sequence;
+    stream >> sequence;
+    stats_.sequence(topic_id, sequence);
+    handler(stream);
+  }
+
+  static bool is_topic_setup(uint16_t topic_id) {
+    return topic_id == rosserial_msgs::TopicInfo::ID_PUBLISHER ||
+           topic_id == rosserial_msgs::TopicInfo::ID_SUBSCRIBER ||
+           topic_id == rosserial_msgs::TopicInfo::ID_SERVICE_CLIENT + rosserial_msgs::TopicInfo::ID_PUBLISHER ||
+           topic_id == rosserial_msgs::TopicInfo::ID_SERVICE_CLIENT + rosserial_msgs::TopicInfo::ID_SUBSCRIBER;
+  }
+
+  /**
+   * A client answering feature_topic_fingerprint sends a hash of its topics, and a
+   * zero, before them. When they're the ones last sent with that hash, they're set up
+   * again from the cache, and the client is told so, and sends nothing more; otherwise
+   * the topics it then sends are recorded, until it sends the hash again with a one.
+   */
+  void handle_topic_fingerprint(ros::serialization::IStream& stream) {
+    uint32_t fingerprint;
+    uint8_t state;
+    stream >> fingerprint >> state;
+
+    if (state != 0) {
+      if (recording_topics_ && fingerprint == recording_fingerprint_) {
+        MessageInfoCache::instance().putTopicSet(fingerprint, recorded_topics_);
+      }
+      recording_topics_ = false;
+      recorded_topics_.clear();
+      return;
+    }
+
+    MessageInfoCache::TopicSet topics;
+    bool known = MessageInfoCache::instance().getTopicSet(fingerprint, topics);
+    recording_topics_ = !known;
+    recording_fingerprint_ = fingerprint;
+    recorded_topics_.clear();
+    if (known) {
+      ROS_DEBUG("Setting up the client's %d topics from the cache.", static_cast<int>(topics.size()));
+      for (MessageInfoCache::TopicSet::iterator it = topics.begin(); it != topics.end(); ++it) {
+        dispatch(it->first, it->second.empty() ? NULL : &it->second[0], it->second.size());
+      }
+    }
+
+    std::vector<uint8_t> answer(5);
+    for (int i = 0; i < 4; i++) {
+      answer[i] = (fingerprint >> (8 * i)) & 0xff;
+    }
+    answer[4] = known;
+    write_message(answer, rosserial_msgs::TopicInfo::ID_TOPIC_FINGERPRINT);
+  }
+
   void handle_log(ros::serialization::IStream& stream) {
     rosserial_msgs::Log l;
     ros::serialization::Serializer<rosserial_msgs::Log>::read(stream, l);
-    if(l.level == rosserial_msgs::Log::ROSDEBUG) ROS_DEBUG("%s", l.msg.c_str());
-    else if(l.level == rosserial_msgs::Log::INFO) ROS_INFO("%s", l.msg.c_str());
-    else if(l.level == rosserial_msgs::Log::WARN) ROS_WARN("%s", l.msg.c_str());
-    else if(l.level == rosserial_msgs::Log::ERROR) ROS_ERROR("%s", l.msg.c_str());
-    else if(l.level == rosserial_msgs::Log::FATAL) ROS_FATAL("%s", l.msg.c_str());
+    log(l.level, l.msg);
   }
 
-  void handle_time(ros::serialization::IStream& stream) {
-    std_msgs::Time time;
-    time.data = ros::Time::now();
+  void handle_log_deferred(ros::serialization::IStream& stream) {
+    uint8_t level;
+    std::string text;
+    if (log_dictionary_.expand(stream.getData(), stream.getLength(), level, text)) {
+      log(level, text);
+    }
+  }
+
+  static void log(uint8_t level, const std::string& text) {
+    if(level == rosserial_msgs::Log::ROSDEBUG) ROS_DEBUG("%s", text.c_str());
+    else if(level == rosserial_msgs::Log::INFO) ROS_INFO("%s", text.c_str());
+    else if(level == rosserial_msgs::Log::WARN) ROS_WARN("%s", text.c_str());
+    else if(level == rosserial_msgs::Log::ERROR) ROS_ERROR("%s", text.c_str());
+    else if(level == rosserial_msgs::Log::FATAL) ROS_FATAL("%s", text.c_str());
+  }
+
+  void handle_parameter_request(ros::serialization::IStream& stream) {
+    rosserial_msgs::RequestParamRequest req;
+    ros::serialization::Serializer<rosserial_msgs::RequestParamRequest>::read(stream, req);
+    rosserial_msgs::RequestParamResponse resp;
+    if (!lookup_parameter(req.name, resp)) {
+      // As from rosserial_python, no answer: the client gives up at its timeout.
+      return;
+    }
+
+    write_serialized(resp, rosserial_msgs::TopicInfo::ID_PARAMETER_REQUEST);
+  }
+
+  // A run of names, each a 32-bit length and that many bytes, answered with a
+  // RequestParamResponse for each in turn, empty for any that can't be sent.
+  void handle_parameter_batch(ros::serialization::IStream& stream) {
+    std::vector<rosserial_msgs::RequestParamResponse> resps;
+    size_t length = 0;
+    while (stream.getLength() >= 4) {
+      uint32_t name_length;
+      stream >> name_length;
+      if (name_length > stream.getLength()) {
+        ROS_WARN("Parameter name runs past the end of its batched request.");
+        break;
+      }
+      std::string name(reinterpret_cast<char*>(stream.advance(name_length)), name_length);
+      resps.push_back(rosserial_msgs::RequestParamResponse());
+      lookup_parameter(name, resps.back());
+      length += ros::serialization::serializationLength(resps.back());
+    }
 
-    size_t length = ros::serialization::serializationLength(time);
     std::vector<uint8_t> message(length);
+    if (length > 0) {
+      ros::serialization::OStream ostream(&message[0], length);
+      for (size_t i = 0; i < resps.size(); i++) {
+        ros::serialization::Serializer<rosserial_msgs::RequestParamResponse>::write(ostream, resps[i]);
+      }
+    }
+    write_message(message, rosserial_msgs::TopicInfo::ID_PARAMETER_BATCH);
+  }
+
+  // Fills in resp with a parameter, or an array of parameters all of the same
+  // type, which are all the client can take. Reads go through roscpp's cache,
+  // which subscribes to the parameter on the first read and is kept up to date
+  // by the master after that, so clients reconnecting, or several on one
+  // server, don't each cost a round trip to it.
+  static bool lookup_parameter(const std::string& name, rosserial_msgs::RequestParamResponse& resp) {
+    XmlRpc::XmlRpcValue param;
+    if (!ros::param::getCached(name, param)) {
+      ROS_ERROR("Parameter %s does not exist", name.c_str());
+      return false;
+    }
+    if (param.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+      ROS_ERROR("Cannot send param %s because it is a dictionary", name.c_str());
+      return false;
+    }
+    if (param.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+      XmlRpc::XmlRpcValue single = param;
+      param = XmlRpc::XmlRpcValue();
+      param[0] = single;
+    }
+    if (param.size() == 0) {
+      // An empty list, which the client accepts as any type of zero length.
+      return true;
+    }
+
+    XmlRpc::XmlRpcValue::Type type = param[0].getType();
+    for (int i = 0; i < param.size(); i++) {
+      if (param[i].getType() != type) {
+        ROS_ERROR("All Paramers in the list %s must be of the same type", name.c_str());
+        return false;
+      }
+    }
+    for (int i = 0; i < param.size(); i++) {
+      if (type == XmlRpc::XmlRpcValue::TypeInt) {
+        resp.ints.push_back(static_cast<int>(param[i]));
+      } else if (type == XmlRpc::XmlRpcValue::TypeBoolean) {
+        resp.ints.push_back(static_cast<bool>(param[i]) ? 1 : 0);
+      } else if (type == XmlRpc::XmlRpcValue::TypeDouble) {
+        resp.floats.push_back(static_cast<double>(param[i]));
+      } else if (type == XmlRpc::XmlRpcValue::TypeString) {
+        resp.strings.push_back(static_cast<std::string>(param[i]));
+      } else {
+        ROS_ERROR("Cannot send param %s because of its type", name.c_str());
+        return false;
+      }
+    }
+    return true;
+  }
 
-    ros::serialization::OStream ostream(&message[0], length);
-    ros::serialization::Serializer<std_msgs::Time>::write(ostream, time);
+  void handle_time(ros::serialization::IStream& stream) {
+    // A client waiting to be asked for its topics sends time requests with no body.
+    if (stream.getLength() == 0) {
+      client_configured_ = false;
+      request_topics_now("Client is waiting to be configured");
+    } else {
+      request_topics_now("Time request from a client this session hasn't set up");
+    }
 
-    write_message(message, rosserial_msgs::TopicInfo::ID_TIME);
+    std_msgs::Time time;
+    time.data = ros::Time::now();
+
+    write_serialized(time, rosserial_msgs::TopicInfo::ID_TIME);
 
     // The MCU requesting the time from the server is the sync notification. This
     // call moves the timeout forward.
     set_sync_timeout(timeout_interval_);
   }
 
+  boost::asio::io_service& io_service_;
   Socket socket_;
+  boost::asio::io_service::strand strand_;
   AsyncReadBuffer<Socket> async_read_buffer_;
-  enum { buffer_max = 1023 };
+  // The most a frame adds to its body, for sizing buffers.
+  enum { overhead_bytes = FrameParser::crc16_overhead_bytes };
+  enum { max_negotiated_read_buffer_size = 0xffff + overhead_bytes };
+
+  // Bits in the body of the request for topics, telling the client what this
+  // server can do beyond the plain protocol.
+  enum { feature_batch = 0x01, feature_crc16 = 0x02, feature_cobs = 0x04, feature_compression = 0x08,
+         feature_topic_fingerprint = 0x10, feature_param_batch = 0x20,
+         feature_log_deferred = 0x40, feature_baud = 0x80 };
+  // And in the second byte of it, which older clients ignore.
+  enum { feature2_sequence = 0x01, feature2_delta = 0x02, feature2_multicast = 0x04 };
+  // The byte which starts each message on a delta encoded topic.
+  enum { delta_encoded = 0x80, delta_keyframe_mask = 0x7f };
+
+  // Raising the link's rate after sync; see set_baud_switch().
+  enum { baud_offer, baud_switch, baud_probe, baud_confirm };
+  enum { baud_idle, baud_switching, baud_settling, baud_probing, baud_backoff };
+  enum { baud_probes = 4, baud_probe_bytes = 30, baud_settle_ms = 50 };
+  // Longer than the client waits for a confirmation before switching back.
+  enum { baud_backoff_ms = 1200 };
+  boost::function<void(uint32_t)> baud_switch_;
+  std::vector<uint32_t> baud_rates_;
+  std::vector<uint32_t> baud_offered_;
+  std::set<uint32_t> baud_failed_;
+  uint32_t baud_initial_;
+  uint32_t baud_current_;
+  uint32_t baud_previous_;
+  uint32_t baud_target_;
+  int baud_state_;
+  int baud_echoes_;
+  int baud_error_limit_;
+  uint64_t baud_errors_;
+  boost::posix_time::time_duration baud_probe_timeout_;
+  size_t max_read_buffer_size_;
   bool active_;
+  bool datagram_input_;
+  std::vector<Frame> datagram_frames_;
+  uint64_t datagram_header_errors_;
+  BufferPool buffer_pool_;
+  boost::shared_ptr<ServiceCallPool> service_call_pool_;
+  Lifeline lifeline_;
+
+  // A frame whose message is shared with other sessions has only its header and
+  // checksum in buffer_ptr, and goes out with the payload between them.
+  struct QueuedFrame {
+    uint16_t topic_id;
+    BufferPtr buffer_ptr;
+    SharedPayloadPtr payload;
+  };
+  static size_t frame_size(const QueuedFrame& frame) {
+    return frame.buffer_ptr->size() + (frame.payload ? frame.payload->bytes.size() : 0);
+  }
+  typedef boost::circular_buffer<QueuedFrame> WriteQueue;
+  enum { priority_high, priority_normal, priority_low, priority_classes };
+  WriteQueue write_queues_[priority_classes];
+  std::vector<TopicQueue> topic_queues_;
+  WriteQueue writing_frames_;
+  std::vector<boost::asio::const_buffer> write_buffers_;
+  HandlerMemory write_handler_memory_;
+  HandlerMemory flush_handler_memory_;
+  size_t write_queue_depth_;
+  LinkBudget link_budget_;
+  LogDictionary log_dictionary_;
+  double write_slice_;
+  std::map<std::string, int> priority_names_;
+  std::map<std::string, int> write_queue_depth_names_;
+  enum { drop_oldest, drop_newest, drop_never };
+  int write_high_watermark_;
+  int write_low_watermark_;
+  int default_drop_policy_;
+  std::map<std::string, int> drop_policy_names_;
+  std::map<uint16_t, int> topic_drop_policies_;
+  size_t queued_bytes_;
+  bool overloaded_;
+  double default_max_rate_;
+  std::map<std::string, double> max_rates_;
+  TopicOptions default_topic_options_;
+  std::map<std::string, TopicOptions> topic_options_;
+  bool write_in_progress_;
+  bool write_flush_posted_;
 
   ros::NodeHandle nh_;
-  ros::CallbackQueue ros_callback_queue_;
+  AsioCallbackQueue ros_callback_queue_;
+  // Declared after nh_, so that its thread is stopped before the node handle goes.
+  boost::scoped_ptr<DispatchPipeline<Publisher> > dispatch_pipeline_;
+  bool shared_publish_;
+  bool pause_unsubscribed_;
+  bool sequence_numbers_;
+  // The number of the next message to go out on each topic the client numbers.
+  std::map<uint16_t, uint8_t> out_sequences_;
+  bool client_crc16_;
+  bool client_cobs_;
+  // The setup frames the client has sent since giving a fingerprint the cache
+  // doesn't know, to be cached under it once the client says it's sent them all.
+  bool recording_topics_;
+  uint32_t recording_fingerprint_;
+  MessageInfoCache::TopicSet recorded_topics_;
+  // Publishers set up since the last frames were read, waiting on their definitions.
+  std::vector<rosserial_msgs::TopicInfo> pending_publishers_;
+  // Handlers of a client which lost sync, by topic name, type and md5sum, until
+  // ~reconnect_grace has passed.
+  double reconnect_grace_;
+  std::map<std::string, PublisherPtr> parked_publishers_;
+  std::map<std::string, SubscriberPtr> parked_subscribers_;
+  std::map<std::string, ServiceClientPtr> parked_services_;
+  // Set once the client has sent any of its topics since the last request for them.
+  bool client_configured_;
+  boost::posix_time::ptime topics_requested_at_;
+  boost::posix_time::time_duration topics_request_holdoff_;
+  // Each stage of decoding has a buffer of its own, as on a topic which is both delta
+  // encoded and compressed, the decoded delta is decompressed from one into the other.
+  std::vector<uint8_t> decompressed_;
+  std::vector<uint8_t> delta_decoded_;
+  // The last keyframe of each topic the client delta encodes, by the number the
+  // client gave it, or -1 before the first.
+  struct DeltaKeyframe {
+    DeltaKeyframe() : number(-1) {}
+    int number;
+    std::vector<uint8_t> bytes;
+  };
+  std::map<uint16_t, DeltaKeyframe> delta_keyframes_;
+  Quantization quantization_;
+  // Whether messages to each topic have quantized fields, once one has been sent.
+  std::map<uint16_t, QuantizedLayoutPtr> out_layouts_;
+  std::vector<uint8_t> expanded_;
+  std::vector<uint8_t> quantize_in_;
+  std::vector<uint8_t> quantize_out_;
+  double receive_stamp_latency_;
+  MulticastTopicsPtr multicast_;
+  SharedSubscriptionsPtr shared_subscriptions_;
+  // The topics the client takes from the multicast group, by their ids here.
+  std::map<uint16_t, std::string> multicast_joined_;
 
   boost::posix_time::time_duration timeout_interval_;
   boost::posix_time::time_duration attempt_interval_;
+  boost::posix_time::time_duration sync_retry_interval_;
+  boost::posix_time::ptime sync_attempt_deadline_;
   boost::posix_time::time_duration require_check_interval_;
-  boost::posix_time::time_duration ros_spin_interval_;
   boost::asio::deadline_timer sync_timer_;
   boost::asio::deadline_timer require_check_timer_;
-  boost::asio::deadline_timer ros_spin_timer_;
+  boost::asio::deadline_timer stats_timer_;
+  boost::asio::deadline_timer baud_timer_;
+  boost::asio::deadline_timer park_timer_;
+  boost::posix_time::time_duration stats_interval_;
   std::string require_param_name_;
 
-  std::map<uint16_t, boost::function<void(ros::serialization::IStream&)> > callbacks_;
+  SessionStats stats_;
+  FrameTrace trace_;
+  std::string trace_file_;
+  LinkCapture capture_;
+  ros::ServiceServer dump_trace_server_;
+  ros::Publisher diagnostics_pub_;
+  std::string stats_name_;
+  std::string hardware_id_;
+  boost::function<void()> stop_callback_;
+
+  DispatchTable callbacks_;
   std::map<uint16_t, PublisherPtr> publishers_;
   std::map<uint16_t, SubscriberPtr> subscribers_;
   std::map<std::string, ServiceClientPtr> services_;
@@ -0,0 +1,383 @@
+/**
+ *
+ *  \file
+ *  \brief      Traffic counters for a Session, reported as diagnostics.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_SESSION_STATS_H
+#define ROSSERIAL_SERVER_SESSION_STATS_H
+
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace rosserial_server
+{
+
+/**
+ * Counts what passes through a Session. Everything here is touched only from the
+ * session's strand, so the counters are plain integers, and recording an event is
+ * an increment or two; the formatting is all done in report(), which is called
+ * periodically.
+ *
+ * Frame, byte and error counts are totals since the session started. Rates and
+ * inter-arrival timings cover the period since the previous report.
+ */
+class SessionStats
+{
+public:
+  SessionStats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    frames_in_ = bytes_in_ = frames_out_ = bytes_out_ = 0;
+    checksum_errors_ = unknown_topics_ = read_errors_ = 0;
+    writes_ = write_errors_ = write_queue_drops_ = 0;
+    watermark_drops_ = overloads_ = 0;
+    lost_ = reordered_ = 0;
+    last_report_ = Snapshot();
+    last_report_time_ = ros::WallTime::now();
+    topics_.clear();
+    frames_in_rate_ = bytes_in_rate_ = bytes_out_rate_ = 0;
+  }
+
+  void name_topic(uint16_t topic_id, const std::string& name)
+  {
+    topics_[topic_id].name = name;
+  }
+
+  void frame_received(uint16_t topic_id, size_t length)
+  {
+    frames_in_++;
+    bytes_in_ += length;
+
+    TopicStats& topic = topics_[topic_id];
+    topic.frames_in++;
+    topic.bytes_in += length;
+
+    ros::WallTime now = ros::WallTime::now();
+    if (topic.frames_in > 1)
+    {
+      topic.add_gap((now - topic.last_arrival).toSec());
+    }
+    topic.last_arrival = now;
+  }
+
+  /**
+   * @brief Checks the sequence number of a message received on a numbered topic
+   *        against the one expected, counting the messages skipped over as lost,
+   *        and any which come back from a little way behind as reordered. Any
+   *        further behind is taken for a run of losses which wrapped around.
+   */
+  void sequence(uint16_t topic_id, uint8_t sequence)
+  {
+    TopicStats& topic = topics_[topic_id];
+    uint8_t skipped = sequence - topic.next_sequence;
+    if (!topic.sequenced)
+    {
+      topic.sequenced = true;
+    }
+    else if (skipped >= 256 - reorder_window)
+    {
+      // Behind the last one, so it was counted lost when it was skipped over.
+      topic.reordered++;
+      reordered_++;
+      if (topic.lost > 0)
+      {
+        topic.lost--;
+        lost_--;
+      }
+      return;
+    }
+    else
+    {
+      topic.lost += skipped;
+      lost_ += skipped;
+    }
+    topic.next_sequence = sequence + 1;
+  }
+
+  /**
+   * @brief Takes the next sequence number on a topic to start it afresh, as it
+   *        does each time the client sets the topic up.
+   */
+  void restart_sequence(uint16_t topic_id)
+  {
+    topics_[topic_id].sequenced = false;
+  }
+
+  void frame_queued(uint16_t topic_id, size_t length)
+  {
+    frames_out_++;
+    bytes_out_ += length;
+    TopicStats& topic = topics_[topic_id];
+    topic.frames_out++;
+    topic.bytes_out += length;
+  }
+
+  void write_queue_drop(uint16_t topic_id)
+  {
+    write_queue_drops_++;
+    topics_[topic_id].drops++;
+  }
+
+  void watermark_drop(uint16_t topic_id)
+  {
+    watermark_drops_++;
+    topics_[topic_id].drops++;
+  }
+
+  void overloaded() { overloads_++; }
+  void checksum_error() { checksum_errors_++; }
+  void unknown_topic() { unknown_topics_++; }
+  void read_error() { read_errors_++; }
+  void write_completed() { writes_++; }
+  void write_error() { write_errors_++; }
+
+  /**
+   * @brief Fills in the values of a status message, and begins a new reporting period.
+   *        Frames skipped by the read buffer, which it counts itself, are passed in.
+   */
+  void report(diagnostic_msgs::DiagnosticStatus& status, uint64_t header_errors, uint64_t oversize_frames)
+  {
+    ros::WallTime now = ros::WallTime::now();
+    double period = (now - last_report_time_).toSec();
+    if (period <= 0) period = 1.0;
+
+    Snapshot current;
+    current.frames_in = frames_in_;
+    current.frames_out = frames_out_;
+    current.bytes_in = bytes_in_;
+    current.bytes_out = bytes_out_;
+    current.errors = checksum_errors_ + unknown_topics_ + read_errors_ + write_errors_ + header_errors + oversize_frames;
+
+    std::ostringstream message;
+    message.precision(1);
+    message << std::fixed << (current.frames_in - last_report_.frames_in) / period << " frames/s in, "
+            << (current.frames_out - last_report_.frames_out) / period << " frames/s out";
+
+    status.level = current.errors > last_report_.errors ?
+        diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+    if (status.level != diagnostic_msgs::DiagnosticStatus::OK)
+    {
+      message << ", " << current.errors - last_report_.errors << " error(s)";
+    }
+    status.message = message.str();
+
+    add(status, "Frames received", frames_in_);
+    add(status, "Bytes received", bytes_in_);
+    add(status, "Frames sent", frames_out_);
+    add(status, "Bytes sent", bytes_out_);
+    frames_in_rate_ = (current.frames_in - last_report_.frames_in) / period;
+    bytes_in_rate_ = (bytes_in_ - last_report_.bytes_in) / period;
+    bytes_out_rate_ = (bytes_out_ - last_report_.bytes_out) / period;
+    add(status, "Bytes/s received", bytes_in_rate_);
+    add(status, "Bytes/s sent", bytes_out_rate_);
+    add(status, "Writes", writes_);
+    add(status, "Checksum errors", checksum_errors_);
+    add(status, "Header errors", header_errors);
+    add(status, "Oversize frames", oversize_frames);
+    add(status, "Unknown topic frames", unknown_topics_);
+    add(status, "Read errors", read_errors_);
+    add(status, "Write errors", write_errors_);
+    add(status, "Write queue drops", write_queue_drops_);
+    add(status, "Watermark drops", watermark_drops_);
+    add(status, "Overloads", overloads_);
+    add(status, "Frames lost", lost_);
+    add(status, "Frames reordered", reordered_);
+
+    for (std::map<uint16_t, TopicStats>::iterator it = topics_.begin(); it != topics_.end(); ++it)
+    {
+      it->second.report(status, it->first, period);
+    }
+
+    last_report_ = current;
+    last_report_time_ = now;
+  }
+
+  /**
+   * @brief Rates over the reporting period which report() last ended. Bytes received
+   *        are of frame bodies only, while bytes sent are of whole frames.
+   */
+  double frames_in_rate() const { return frames_in_rate_; }
+  double bytes_in_rate() const { return bytes_in_rate_; }
+  double bytes_out_rate() const { return bytes_out_rate_; }
+
+  uint64_t checksum_errors() const { return checksum_errors_; }
+
+private:
+  struct Snapshot
+  {
+    Snapshot() : frames_in(0), frames_out(0), bytes_in(0), bytes_out(0), errors(0) {}
+    uint64_t frames_in, frames_out, bytes_in, bytes_out, errors;
+  };
+
+  /**
+   * Upper bounds, in milliseconds, of all but the last inter-arrival histogram
+   * bucket; the last takes everything longer.
+   */
+  static const double* gap_buckets(size_t& count)
+  {
+    static const double buckets[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+    count = sizeof(buckets) / sizeof(buckets[0]);
+    return buckets;
+  }
+  enum { histogram_size = 11 };
+
+  // How far behind the next sequence number one may be and still be taken for
+  // a message which came late, rather than for most of a wrap of lost ones.
+  enum { reorder_window = 32 };
+
+  struct TopicStats
+  {
+    TopicStats() : frames_in(0), bytes_in(0), frames_out(0), bytes_out(0), drops(0),
+                   period_frames_in(0), period_frames_out(0),
+                   sequenced(false), next_sequence(0), lost(0), reordered(0)
+    {
+      reset_period();
+    }
+
+    void reset_period()
+    {
+      gaps = 0;
+      gap_mean = gap_m2 = gap_max = 0;
+      for (size_t i = 0; i < histogram_size; ++i) histogram[i] = 0;
+    }
+
+    void add_gap(double seconds)
+    {
+      // Running mean and variance, after Welford.
+      gaps++;
+      double delta = seconds - gap_mean;
+      gap_mean += delta / gaps;
+      gap_m2 += delta * (seconds - gap_mean);
+      if (seconds > gap_max) gap_max = seconds;
+
+      size_t count;
+      const double* buckets = gap_buckets(count);
+      size_t i = 0;
+      while (i < count && seconds * 1000 > buckets[i]) ++i;
+      histogram[i]++;
+    }
+
+    void report(diagnostic_msgs::DiagnosticStatus& status, uint16_t topic_id, double period)
+    {
+      std::ostringstream prefix;
+      prefix << "Topic " << topic_id;
+      if (!name.empty()) prefix << " (" << name << ")";
+      prefix << " ";
+
+      if (frames_in > 0)
+      {
+        add(status, prefix.str() + "frames received", frames_in);
+        add(status, prefix.str() + "rate in (Hz)", (frames_in - period_frames_in) / period);
+        if (sequenced)
+        {
+          add(status, prefix.str() + "frames lost", lost);
+          add(status, prefix.str() + "frames reordered", reordered);
+          add(status, prefix.str() + "loss (%)", 100.0 * lost / (frames_in + lost));
+        }
+        if (gaps > 0)
+        {
+          add(status, prefix.str() + "inter-arrival mean (ms)", gap_mean * 1000);
+          add(status, prefix.str() + "inter-arrival jitter (ms)", gaps > 1 ? std::sqrt(gap_m2 / (gaps - 1)) * 1000 : 0.0);
+          add(status, prefix.str() + "inter-arrival max (ms)", gap_max * 1000);
+
+          size_t count;
+          const double* buckets = gap_buckets(count);
+          std::ostringstream histogram_str;
+          for (size_t i = 0; i < histogram_size; ++i)
+          {
+            if (i > 0) histogram_str << " ";
+            if (i < count) histogram_str << "<" << buckets[i] << "ms:";
+            else histogram_str << ">" << buckets[count - 1] << "ms:";
+            histogram_str << histogram[i];
+          }
+          add(status, prefix.str() + "inter-arrival histogram", histogram_str.str());
+        }
+      }
+      if (frames_out > 0)
+      {
+        add(status, prefix.str() + "frames sent", frames_out);
+        add(status, prefix.str() + "rate out (Hz)", (frames_out - period_frames_out) / period);
+        add(status, prefix.str() + "write queue drops", drops);
+      }
+
+      period_frames_in = frames_in;
+      period_frames_out = frames_out;
+      reset_period();
+    }
+
+    std::string name;
+    uint64_t frames_in, bytes_in, frames_out, bytes_out, drops;
+    uint64_t period_frames_in, period_frames_out;
+    ros::WallTime last_arrival;
+    uint32_t gaps;
+    double gap_mean, gap_m2, gap_max;
+    uint32_t histogram[histogram_size];
+    // Of the numbers the client gives the messages on the topic, if it does.
+    bool sequenced;
+    uint8_t next_sequence;
+    uint64_t lost, reordered;
+  };
+
+  template<typename T>
+  static void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const T& value)
+  {
+    std::ostringstream value_str;
+    value_str << value;
+    diagnostic_msgs::KeyValue kv;
+    kv.key = key;
+    kv.value = value_str.str();
+    status.values.push_back(kv);
+  }
+
+  uint64_t frames_in_, bytes_in_, frames_out_, bytes_out_;
+  uint64_t checksum_errors_, unknown_topics_, read_errors_;
+  uint64_t writes_, write_errors_, write_queue_drops_;
+  uint64_t watermark_drops_, overloads_;
+  uint64_t lost_, reordered_;
+  Snapshot last_report_;
+  ros::WallTime last_report_time_;
+  std::map<uint16_t, TopicStats> topics_;
+  double frames_in_rate_, bytes_in_rate_, bytes_out_rate_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_SESSION_STATS_H
@@ -0,0 +1,223 @@
+/**
+ *
+ *  \file
+ *  \brief      One ROS subscription per topic, shared by every session.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_SHARED_SUBSCRIPTIONS_H
+#define ROSSERIAL_SERVER_SHARED_SUBSCRIPTIONS_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <topic_tools/shape_shifter.h>
+
+#include "rosserial_server/callback_queue.h"
+#include "rosserial_server/frame_parser.h"
+
+namespace rosserial_server
+{
+
+/**
+ * A message serialized once for all the sessions sending it, with the sum of
+ * its bytes for their checksums. Sessions write it as it is, between a header
+ * and checksum of their own.
+ */
+struct SharedPayload
+{
+  std::vector<uint8_t> bytes;
+  uint8_t checksum;
+};
+typedef boost::shared_ptr<const SharedPayload> SharedPayloadPtr;
+
+class SharedSubscriptions;
+typedef boost::shared_ptr<SharedSubscriptions> SharedSubscriptionsPtr;
+
+/**
+ * Subscribes once to each topic and type which any session's client subscribes
+ * to, rather than once for each session, and serializes each message once into
+ * a SharedPayload which every session subscribed to it is handed. So a server
+ * with many clients taking the same topic has one callback and one copy of each
+ * message, however many there are. Callbacks run on a strand of the registry's
+ * own; each member is called there, and must hand the message on to its own.
+ * The queue size and transport hints are those of the first member.
+ */
+class SharedSubscriptions : public boost::enable_shared_from_this<SharedSubscriptions>
+{
+public:
+  typedef boost::function<void(const topic_tools::ShapeShifter::ConstPtr&, const SharedPayloadPtr&)> Callback;
+
+  /**
+   * A session's place on a shared subscription, which it keeps for as long as
+   * it wants the messages.
+   */
+  class Membership
+  {
+  public:
+    Membership(const SharedSubscriptionsPtr& registry, const std::string& topic, const std::string& md5, int id)
+      : registry_(registry), topic_(topic), md5_(md5), id_(id)
+    {
+    }
+
+    ~Membership()
+    {
+      registry_->leave(topic_, md5_, id_);
+    }
+
+    const std::string& topic() const
+    {
+      return topic_;
+    }
+
+  private:
+    SharedSubscriptionsPtr registry_;
+    std::string topic_;
+    std::string md5_;
+    int id_;
+  };
+  typedef boost::shared_ptr<Membership> MembershipPtr;
+
+  explicit SharedSubscriptions(boost::asio::io_service& io_service)
+    : strand_(io_service), ros_callback_queue_(strand_), next_id_(0)
+  {
+    nh_.setCallbackQueue(&ros_callback_queue_);
+  }
+
+  ~SharedSubscriptions()
+  {
+    ros_callback_queue_.clear();
+  }
+
+  /**
+   * Calls callback with each message on the topic, its name resolved, of the
+   * type with the given md5sum, subscribing to it on first use, until the
+   * membership returned is dropped.
+   */
+  MembershipPtr join(const std::string& resolved_name, const std::string& message_type, const std::string& md5,
+                     int queue_size, const ros::TransportHints& transport_hints, const Callback& callback)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    Key key(resolved_name, md5);
+    Topic& topic = topics_[key];
+    if (topic.members.empty())
+    {
+      ros::SubscribeOptions opts;
+      opts.init<topic_tools::ShapeShifter>(resolved_name, queue_size,
+          boost::bind(&SharedSubscriptions::handle, this, _1, key));
+      opts.md5sum = md5;
+      opts.datatype = message_type;
+      opts.transport_hints = transport_hints;
+      topic.subscriber = nh_.subscribe(opts);
+    }
+    int id = next_id_++;
+    topic.members[id] = callback;
+    return MembershipPtr(new Membership(shared_from_this(), resolved_name, md5, id));
+  }
+
+private:
+  typedef std::pair<std::string, std::string> Key;
+
+  struct Topic
+  {
+    ros::Subscriber subscriber;
+    std::map<int, Callback> members;
+  };
+
+  void leave(const std::string& resolved_name, const std::string& md5, int id)
+  {
+    ros::Subscriber unused;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      std::map<Key, Topic>::iterator it = topics_.find(Key(resolved_name, md5));
+      if (it == topics_.end())
+      {
+        return;
+      }
+      it->second.members.erase(id);
+      if (it->second.members.empty())
+      {
+        unused = it->second.subscriber;
+        topics_.erase(it);
+      }
+    }
+    // Unsubscribing waits for a callback which is running, which may be waiting
+    // on the lock, so is left until it's released. One still queued finds the
+    // topic gone.
+    unused.shutdown();
+  }
+
+  /**
+   * Runs on the strand: serializes the message once, and hands it to every
+   * member.
+   */
+  void handle(const topic_tools::ShapeShifter::ConstPtr& msg, const Key& key)
+  {
+    boost::shared_ptr<SharedPayload> payload(new SharedPayload);
+    payload->bytes.resize(msg->size());
+    if (!payload->bytes.empty())
+    {
+      ros::serialization::OStream stream(&payload->bytes[0], payload->bytes.size());
+      msg->write(stream);
+    }
+    payload->checksum = FrameParser::checksum(payload->bytes.data(), payload->bytes.size());
+
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<Key, Topic>::iterator it = topics_.find(key);
+    if (it == topics_.end())
+    {
+      return;
+    }
+    for (std::map<int, Callback>::iterator member = it->second.members.begin();
+         member != it->second.members.end(); ++member)
+    {
+      member->second(msg, payload);
+    }
+  }
+
+  boost::asio::io_service::strand strand_;
+  AsioCallbackQueue ros_callback_queue_;
+  ros::NodeHandle nh_;
+  boost::mutex mutex_;
+  std::map<Key, Topic> topics_;
+  int next_id_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_SHARED_SUBSCRIPTIONS_H
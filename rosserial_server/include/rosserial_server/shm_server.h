@@ -0,0 +1,192 @@
+/**
+ *
+ *  \file
+ *  \brief      Server for rosserial clients on the same host, over shared memory.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_SHM_SERVER_H
+#define ROSSERIAL_SERVER_SHM_SERVER_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/session.h"
+#include "rosserial_server/shm_stream.h"
+
+
+namespace rosserial_server
+{
+
+using boost::asio::local::stream_protocol;
+
+/**
+ * Accepts connections from clients on the same host on a Unix socket, and runs a
+ * session for each over a pair of rings in memory shared with it; see ShmStream.
+ * Sessions are owned and deleted as by TcpServer.
+ *
+ * Parameters, from the node's private namespace:
+ *   ~max_sessions        clients to serve at once, beyond which more are refused;
+ *                        zero, the default, for no limit
+ *   ~shm_capacity        bytes in each direction's ring, rounded up to a power of
+ *                        two (default 65536)
+ */
+template< typename Session = rosserial_server::Session<ShmStream> >
+class ShmServer
+{
+public:
+  ShmServer(boost::asio::io_service& io_service, const std::string& path)
+    : io_service_(io_service),
+      strand_(io_service),
+      acceptor_(io_service),
+      path_(path),
+      accepted_(0)
+  {
+    ros::param::param<int>("~max_sessions", max_sessions_, 0);
+    int capacity;
+    ros::param::param<int>("~shm_capacity", capacity, 65536);
+    capacity_ = 256;
+    while (capacity_ < static_cast<uint32_t>(capacity) && capacity_ < (1u << 30))
+    {
+      capacity_ <<= 1;
+    }
+
+    // A socket left behind by a server which didn't exit cleanly would be in the way.
+    unlink(path_.c_str());
+    acceptor_.open(stream_protocol());
+    acceptor_.bind(stream_protocol::endpoint(path_));
+    acceptor_.listen();
+
+    start_accept();
+  }
+
+  ~ShmServer()
+  {
+    unlink(path_.c_str());
+  }
+
+  /**
+   * Called with each session as its client connects, before it starts, to
+   * configure it further; for instance, to put its topics in a namespace.
+   */
+  void set_session_setup(const boost::function<void(Session&)>& setup)
+  {
+    session_setup_ = setup;
+  }
+
+private:
+  typedef boost::shared_ptr<Session> SessionPtr;
+
+  void start_accept()
+  {
+    if (!next_session_)
+    {
+      next_session_.reset(new Session(io_service_));
+      next_session_->set_owner(next_session_);
+    }
+    acceptor_.async_accept(next_session_->socket(),
+        strand_.wrap(boost::bind(&ShmServer::handle_accept, this,
+          boost::asio::placeholders::error)));
+  }
+
+  void handle_accept(const boost::system::error_code& error)
+  {
+    if (error)
+    {
+      ROS_WARN_STREAM_THROTTLE(1, "Error accepting a shared memory client: " << error);
+      next_session_.reset();
+    }
+    else if (max_sessions_ > 0 && sessions_.size() >= static_cast<size_t>(max_sessions_))
+    {
+      ROS_WARN_STREAM_THROTTLE(1, "Refusing shared memory client, as " << max_sessions_ <<
+                               " sessions are already running.");
+      next_session_.reset();
+    }
+    else
+    {
+      ShmStream& stream = next_session_->socket();
+      stream.set_strand(next_session_->strand());
+      stream.set_lifeline(&next_session_->lifeline());
+      if (!stream.open_shared(capacity_))
+      {
+        next_session_.reset();
+        start_accept();
+        return;
+      }
+
+      // Unix sockets have no address to tell clients apart by, so they're numbered.
+      std::ostringstream hardware_id;
+      hardware_id << path_ << "#" << ++accepted_;
+      next_session_->set_hardware_id(hardware_id.str());
+      if (session_setup_)
+      {
+        session_setup_(*next_session_);
+      }
+
+      SessionPtr session = next_session_;
+      next_session_.reset();
+      sessions_[session.get()] = session;
+      session->set_stop_callback(strand_.wrap(boost::bind(&ShmServer::session_stopped, this, session.get())));
+
+      // The acceptor may be serviced by a different thread than the session.
+      session->strand().post(boost::bind(&Session::start, session));
+    }
+
+    start_accept();
+  }
+
+  void session_stopped(Session* session)
+  {
+    sessions_.erase(session);
+  }
+
+  boost::asio::io_service& io_service_;
+  boost::asio::io_service::strand strand_;
+  stream_protocol::acceptor acceptor_;
+  std::string path_;
+  SessionPtr next_session_;
+  std::map<Session*, SessionPtr> sessions_;
+
+  int max_sessions_;
+  uint32_t capacity_;
+  unsigned int accepted_;
+  boost::function<void(Session&)> session_setup_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_SHM_SERVER_H
@@ -0,0 +1,409 @@
+/**
+ *
+ *  \file
+ *  \brief      Shared memory stream to a client on the same host.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_SHM_STREAM_H
+#define ROSSERIAL_SERVER_SHM_STREAM_H
+
+#include <algorithm>
+#include <sstream>
+#include <boost/array.hpp>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/lifeline.h"
+
+namespace rosserial_server
+{
+
+/**
+ * The memory shared with a client, which it maps from the fd handed over when it
+ * connects: this header, then the ring of bytes it writes to the server, then the
+ * ring the server writes to it, each of capacity bytes, a power of two. The
+ * client's half is EmbeddedLinuxShmHardware, in rosserial_embeddedlinux, and the
+ * two must agree on all of it.
+ *
+ * Each ring has one writer and one reader. The writer copies bytes in and then
+ * advances head, the reader copies them out and then advances tail, and both
+ * run freely past the capacity, wrapping as 32-bit counters. Either side, before
+ * it sleeps waiting on the other, sets its waiting flag and looks again; after
+ * moving either cursor, each side wakes the other through its eventfd only if
+ * that flag is set, so busy traffic costs no system calls.
+ */
+struct ShmCursor
+{
+  volatile uint32_t value;
+  uint8_t padding[60];  // A cache line each, so the two sides don't contend.
+};
+
+struct ShmHeader
+{
+  enum { magic_value = 0x4d485352, version_value = 1 };  // "RSHM"
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint8_t padding[52];
+  ShmCursor to_server_head;
+  ShmCursor to_server_tail;
+  ShmCursor to_client_head;
+  ShmCursor to_client_tail;
+  ShmCursor client_waiting;
+  ShmCursor server_waiting;
+};
+
+/**
+ * Presents the rings as a stream, for a Session<ShmStream>. It is the Unix socket
+ * the client connected on, over which the memory and the two eventfds are handed
+ * to it, and which says when the client has gone; frames themselves never pass
+ * through it.
+ */
+class ShmStream : public boost::asio::local::stream_protocol::socket
+{
+public:
+  explicit ShmStream(boost::asio::io_service& io_service)
+    : boost::asio::local::stream_protocol::socket(io_service), io_service_(io_service), wake_(io_service),
+      strand_(NULL), lifeline_(NULL), header_(NULL), mapped_bytes_(0), client_wake_fd_(-1), wake_pending_(false), hung_up_(false)
+  {
+  }
+
+  ~ShmStream()
+  {
+    close();
+  }
+
+  /**
+   * The strand of the session reading from this stream, which the stream's own
+   * handlers must run on.
+   */
+  void set_strand(boost::asio::io_service::strand& strand)
+  {
+    strand_ = &strand;
+  }
+
+  /**
+   * The session's lifeline, which the stream's own handlers hold it through.
+   */
+  void set_lifeline(const Lifeline* lifeline)
+  {
+    lifeline_ = lifeline;
+  }
+
+  /**
+   * Sets up the memory, of capacity bytes each way, for the client which has just
+   * connected to this socket, and hands it over along with the eventfds.
+   */
+  bool open_shared(uint32_t capacity)
+  {
+    static int count = 0;
+    std::ostringstream name;
+    name << "/rosserial_shm_" << getpid() << "_" << ++count;
+    int shm_fd = shm_open(name.str().c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (shm_fd < 0)
+    {
+      ROS_WARN("Unable to create shared memory for a client: %s", strerror(errno));
+      return false;
+    }
+    // Nothing else needs to find it by name; the fd is all the client gets.
+    shm_unlink(name.str().c_str());
+
+    mapped_bytes_ = sizeof(ShmHeader) + 2 * capacity;
+    void* mapping = MAP_FAILED;
+    if (ftruncate(shm_fd, mapped_bytes_) == 0)
+    {
+      mapping = mmap(NULL, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    }
+    int server_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    client_wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mapping == MAP_FAILED || server_wake_fd < 0 || client_wake_fd_ < 0)
+    {
+      ROS_WARN("Unable to set up shared memory for a client: %s", strerror(errno));
+      ::close(shm_fd);
+      if (server_wake_fd >= 0) ::close(server_wake_fd);
+      mapped_bytes_ = 0;
+      return false;
+    }
+    header_ = static_cast<ShmHeader*>(mapping);
+    header_->magic = ShmHeader::magic_value;
+    header_->version = ShmHeader::version_value;
+    header_->capacity = capacity;
+    to_server_ = reinterpret_cast<uint8_t*>(header_ + 1);
+    to_client_ = to_server_ + capacity;
+    wake_.assign(server_wake_fd);
+
+    int fds[3] = { shm_fd, server_wake_fd, client_wake_fd_ };
+    bool sent = send_fds(fds, 3);
+    ::close(shm_fd);
+    if (!sent)
+    {
+      ROS_WARN("Unable to hand shared memory to a client: %s", strerror(errno));
+      return false;
+    }
+    wait_hangup();
+    return true;
+  }
+
+  void close()
+  {
+    boost::system::error_code ec;
+    wake_.close(ec);
+    if (client_wake_fd_ >= 0) ::close(client_wake_fd_);
+    client_wake_fd_ = -1;
+    if (header_) munmap(header_, mapped_bytes_);
+    header_ = NULL;
+    complete(read_handler_, boost::asio::error::operation_aborted, 0);
+    complete(write_handler_, boost::asio::error::operation_aborted, 0);
+    boost::asio::local::stream_protocol::socket::close(ec);
+  }
+
+  template <typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
+  {
+    read_handler_ = handler;
+    read_op_ = boost::bind(&ShmStream::read_ring<MutableBufferSequence>, this, buffers);
+    try_read();
+  }
+
+  template <typename ConstBufferSequence, typename WriteHandler>
+  void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler)
+  {
+    write_handler_ = handler;
+    write_op_ = boost::bind(&ShmStream::write_ring<ConstBufferSequence>, this, buffers);
+    try_write();
+  }
+
+private:
+  typedef boost::function<void(const boost::system::error_code&, size_t)> Handler;
+
+  bool send_fds(const int* fds, size_t count)
+  {
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    return sendmsg(native_handle(), &msg, MSG_NOSIGNAL) == 1;
+  }
+
+  template <typename MutableBufferSequence>
+  size_t read_ring(const MutableBufferSequence& buffers)
+  {
+    uint32_t head = header_->to_server_head.value;
+    __sync_synchronize();
+    uint32_t tail = header_->to_server_tail.value;
+    uint32_t capacity = header_->capacity;
+    size_t available = head - tail;
+    size_t start = tail & (capacity - 1);
+    size_t first = std::min<size_t>(available, capacity - start);
+    boost::array<boost::asio::const_buffer, 2> runs = {{
+      boost::asio::buffer(to_server_ + start, first), boost::asio::buffer(to_server_, available - first) }};
+    size_t count = boost::asio::buffer_copy(buffers, runs);
+    __sync_synchronize();
+    header_->to_server_tail.value = tail + count;
+    return count;
+  }
+
+  template <typename ConstBufferSequence>
+  size_t write_ring(const ConstBufferSequence& buffers)
+  {
+    uint32_t tail = header_->to_client_tail.value;
+    __sync_synchronize();
+    uint32_t head = header_->to_client_head.value;
+    uint32_t capacity = header_->capacity;
+    size_t space = capacity - (head - tail);
+    size_t start = head & (capacity - 1);
+    size_t first = std::min<size_t>(space, capacity - start);
+    boost::array<boost::asio::mutable_buffer, 2> runs = {{
+      boost::asio::buffer(to_client_ + start, first), boost::asio::buffer(to_client_, space - first) }};
+    size_t count = boost::asio::buffer_copy(runs, buffers);
+    __sync_synchronize();
+    header_->to_client_head.value = head + count;
+    return count;
+  }
+
+  /**
+   * Runs a pending read or write against its ring. If it can't make progress, it
+   * stays pending until the client wakes the server.
+   */
+  void try_op(Handler& handler, boost::function<size_t()>& op)
+  {
+    if (!handler)
+    {
+      return;
+    }
+    if (!header_ || hung_up_)
+    {
+      complete(handler, boost::asio::error::eof, 0);
+      return;
+    }
+    size_t count = op();
+    if (count == 0)
+    {
+      header_->server_waiting.value = 1;
+      __sync_synchronize();
+      count = op();
+    }
+    if (count == 0)
+    {
+      wait_wake();
+      return;
+    }
+    wake_client();
+    complete(handler, boost::system::error_code(), count);
+  }
+
+  void try_read()
+  {
+    try_op(read_handler_, read_op_);
+  }
+
+  void try_write()
+  {
+    try_op(write_handler_, write_op_);
+  }
+
+  void complete(Handler& handler, const boost::system::error_code& error, size_t count)
+  {
+    if (handler)
+    {
+      io_service_.post(boost::bind(handler, error, count));
+      handler.clear();
+    }
+  }
+
+  void wake_client()
+  {
+    __sync_synchronize();
+    if (header_->client_waiting.value)
+    {
+      header_->client_waiting.value = 0;
+      uint64_t one = 1;
+      if (::write(client_wake_fd_, &one, sizeof(one)) < 0)
+      {
+        ROS_DEBUG("Unable to wake shared memory client: %s", strerror(errno));
+      }
+    }
+  }
+
+  void wait_wake()
+  {
+    if (wake_pending_)
+    {
+      return;
+    }
+    wake_pending_ = true;
+    wake_.async_read_some(boost::asio::buffer(&wake_count_, sizeof(wake_count_)),
+        strand_->wrap(make_guarded_handler(guard(),
+            boost::bind(&ShmStream::wake_cb, this, boost::asio::placeholders::error))));
+  }
+
+  void wake_cb(const boost::system::error_code& error)
+  {
+    wake_pending_ = false;
+    if (error == boost::asio::error::operation_aborted)
+    {
+      return;
+    }
+    if (header_)
+    {
+      header_->server_waiting.value = 0;
+    }
+    try_read();
+    try_write();
+  }
+
+  /**
+   * The client never sends anything over the socket once it's connected, so its
+   * becoming readable means the client has closed it.
+   */
+  void wait_hangup()
+  {
+    async_receive(boost::asio::null_buffers(),
+        strand_->wrap(make_guarded_handler(guard(),
+            boost::bind(&ShmStream::hangup_cb, this, boost::asio::placeholders::error))));
+  }
+
+  void hangup_cb(const boost::system::error_code& error)
+  {
+    if (error == boost::asio::error::operation_aborted)
+    {
+      return;
+    }
+    ROS_DEBUG("Shared memory client hung up.");
+    hung_up_ = true;
+    try_read();
+    try_write();
+  }
+
+  boost::shared_ptr<void> guard() const
+  {
+    return lifeline_ ? lifeline_->hold() : boost::shared_ptr<void>();
+  }
+
+  boost::asio::io_service& io_service_;
+  boost::asio::posix::stream_descriptor wake_;
+  boost::asio::io_service::strand* strand_;
+  const Lifeline* lifeline_;
+  ShmHeader* header_;
+  size_t mapped_bytes_;
+  uint8_t* to_server_;
+  uint8_t* to_client_;
+  int client_wake_fd_;
+  uint64_t wake_count_;
+  bool wake_pending_;
+  bool hung_up_;
+  Handler read_handler_;
+  Handler write_handler_;
+  boost::function<size_t()> read_op_;
+  boost::function<size_t()> write_op_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_SHM_STREAM_H
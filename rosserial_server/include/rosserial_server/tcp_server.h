@@ -35,8 +35,20 @@
 #define ROSSERIAL_SERVER_TCP_SERVER_H
 
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+#include <unistd.h>
 
 #include <ros/ros.h>
 
@@ -48,43 +60,344 @@ namespace rosserial_server
 
 using boost::asio::ip::tcp;
 
-template< typename Session = rosserial_server::Session<tcp::socket> >
+/**
+ * Accepts TCP connections, and runs a session for each. The server holds each
+ * session for as long as it runs. Its handlers hold it too, through its lifeline,
+ * so once it has stopped, it's deleted as the last of them is called back.
+ *
+ * A session which keeps its handlers across reconnects, given ~reconnect_grace, is
+ * held for that long after it stops too, by its client's address. A connection from
+ * that address within the time is handed to it, rather than to a new session, so
+ * that the client can take up its publishers, subscribers and service clients again
+ * from a new connection. Clients on a Unix socket all share the socket's path.
+ *
+ * With a Protocol of boost::asio::local::stream_protocol, and a Session over its
+ * socket, it accepts connections on a Unix socket instead, for clients on the
+ * same host which needn't go through the loopback TCP stack, nor be given a
+ * port each. The tcp_ parameters don't apply to those.
+ *
+ * Parameters, from the node's private namespace:
+ *   ~max_sessions        connections to serve at once, beyond which more are refused;
+ *                        zero, the default, for no limit
+ *   ~tcp_nodelay         send small frames straight away, rather than waiting to
+ *                        coalesce them (default true)
+ *   ~tcp_keepalive       probe idle connections, so that ones to clients which have
+ *                        vanished are closed (default true)
+ *   ~tcp_keepalive_idle, ~tcp_keepalive_interval, ~tcp_keepalive_count
+ *                        on Linux, the seconds idle before probing, seconds between
+ *                        probes, and probes unanswered before the connection is
+ *                        dropped (defaults 10, 2 and 3)
+ *   ~tcp_rcvbuf, ~tcp_sndbuf
+ *                        sizes in bytes of the kernel's receive and send buffers for
+ *                        each connection, or zero, the default, to leave them be
+ *   ~tcp_quickack        on Linux, acknowledge the client's segments right away rather
+ *                        than delaying, so that a client waiting on the acks of small
+ *                        frames isn't held up (default false). The kernel may drop
+ *                        back to delayed acks later in a connection's life.
+ */
+template< typename Session = rosserial_server::Session<tcp::socket>, typename Protocol = tcp >
 class TcpServer
 {
 public:
   TcpServer(boost::asio::io_service& io_service, short port)
     : io_service_(io_service),
-      acceptor_(io_service, tcp::endpoint(tcp::v4(), port))
+      strand_(io_service),
+      acceptor_(io_service, tcp::endpoint(tcp::v4(), port)),
+      accepted_(0)
   {
-    start_accept();
+    init();
+  }
+
+  /**
+   * Listens on the given endpoint; for a Unix socket, its path, in place of any
+   * socket file which a server that didn't exit cleanly left there.
+   */
+  TcpServer(boost::asio::io_service& io_service, const typename Protocol::endpoint& endpoint)
+    : io_service_(io_service),
+      strand_(io_service),
+      acceptor_(io_service),
+      accepted_(0)
+  {
+    remove_socket_file(endpoint);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+    init();
+  }
+
+  ~TcpServer()
+  {
+    boost::system::error_code ec;
+    remove_socket_file(acceptor_.local_endpoint(ec));
+  }
+
+  /**
+   * Called with each session as its connection is accepted, before it starts, to
+   * configure it further; for instance, to put its topics in a namespace.
+   */
+  void set_session_setup(const boost::function<void(Session&)>& setup)
+  {
+    session_setup_ = setup;
   }
 
 private:
+  typedef boost::shared_ptr<Session> SessionPtr;
+
+  struct ParkedSession
+  {
+    SessionPtr session;
+    boost::shared_ptr<boost::asio::deadline_timer> timer;
+  };
+
+  void init()
+  {
+    ros::param::param<int>("~max_sessions", max_sessions_, 0);
+    ros::param::param<bool>("~tcp_nodelay", nodelay_, true);
+    ros::param::param<bool>("~tcp_keepalive", keepalive_, true);
+    ros::param::param<int>("~tcp_keepalive_idle", keepalive_idle_, 10);
+    ros::param::param<int>("~tcp_keepalive_interval", keepalive_interval_, 2);
+    ros::param::param<int>("~tcp_keepalive_count", keepalive_count_, 3);
+    ros::param::param<int>("~tcp_rcvbuf", rcvbuf_, 0);
+    ros::param::param<int>("~tcp_sndbuf", sndbuf_, 0);
+    ros::param::param<bool>("~tcp_quickack", quickack_, false);
+
+    start_accept();
+  }
+
   void start_accept()
   {
-    Session* new_session = new Session(io_service_);
-    acceptor_.async_accept(new_session->socket(),
-        boost::bind(&TcpServer::handle_accept, this, new_session,
-          boost::asio::placeholders::error));
+    if (!next_session_)
+    {
+      next_session_.reset(new Session(io_service_));
+      next_session_->set_owner(next_session_);
+    }
+    acceptor_.async_accept(next_session_->socket(),
+        strand_.wrap(boost::bind(&TcpServer::handle_accept, this,
+          boost::asio::placeholders::error)));
   }
 
-  void handle_accept(Session* new_session,
-      const boost::system::error_code& error)
+  void handle_accept(const boost::system::error_code& error)
   {
-    if (!error)
+    if (error)
     {
-      new_session->start();
+      ROS_WARN_STREAM_THROTTLE(1, "Error accepting a TCP connection: " << error);
+      next_session_.reset();
+    }
+    else if (max_sessions_ > 0 && sessions_.size() >= static_cast<size_t>(max_sessions_))
+    {
+      // The session is kept for the next connection, after this one is refused.
+      boost::system::error_code ec;
+      ROS_WARN_STREAM_THROTTLE(1, "Refusing connection from " << peer_name(next_session_->socket()) <<
+                               ", as " << max_sessions_ << " sessions are already running.");
+      next_session_->socket().close(ec);
     }
     else
     {
-      delete new_session;
+      std::string client = client_name(next_session_->socket());
+      SessionPtr session = unpark(client);
+      bool returning = static_cast<bool>(session);
+      if (!returning)
+      {
+        session = next_session_;
+        next_session_.reset();
+      }
+      configure_socket(session->socket());
+      session->set_hardware_id(peer_name(session->socket()));
+      // A returning client's session was set up when it first connected.
+      if (!returning && session_setup_)
+      {
+        session_setup_(*session);
+      }
+
+      sessions_[session.get()] = session;
+      clients_[session.get()] = client;
+      session->set_stop_callback(strand_.wrap(boost::bind(&TcpServer::session_stopped, this, session.get())));
+
+      // The acceptor may be serviced by a different thread than the session.
+      session->strand().post(boost::bind(&Session::start, session));
     }
 
     start_accept();
   }
 
+  void configure_socket(tcp::socket& socket)
+  {
+    boost::system::error_code ec;
+    socket.set_option(tcp::no_delay(nodelay_), ec);
+    if (!ec)
+    {
+      socket.set_option(boost::asio::socket_base::keep_alive(keepalive_), ec);
+    }
+    if (!ec && rcvbuf_ > 0)
+    {
+      socket.set_option(boost::asio::socket_base::receive_buffer_size(rcvbuf_), ec);
+    }
+    if (!ec && sndbuf_ > 0)
+    {
+      socket.set_option(boost::asio::socket_base::send_buffer_size(sndbuf_), ec);
+    }
+#ifdef __linux__
+    int fd = socket.native_handle();
+    if (keepalive_)
+    {
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepalive_idle_, sizeof(keepalive_idle_));
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepalive_interval_, sizeof(keepalive_interval_));
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &keepalive_count_, sizeof(keepalive_count_));
+    }
+    if (quickack_)
+    {
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    }
+#endif
+    if (ec)
+    {
+      ROS_WARN_STREAM("Unable to set options on TCP connection: " << ec);
+    }
+  }
+
+  /**
+   * The session parked for the client, if there is one, with the connection just
+   * accepted moved over to it. The session accepted into is kept for the next.
+   */
+  SessionPtr unpark(const std::string& client)
+  {
+    typename std::map<std::string, ParkedSession>::iterator it = parked_.find(client);
+    if (it == parked_.end())
+    {
+      return SessionPtr();
+    }
+    SessionPtr session = it->second.session;
+    parked_.erase(it);
+
+    boost::system::error_code ec;
+    typename Protocol::socket& accepted = next_session_->socket();
+    int fd = ::dup(accepted.native_handle());
+    if (fd >= 0)
+    {
+      session->socket().assign(accepted.local_endpoint(ec).protocol(), fd, ec);
+    }
+    if (fd < 0 || ec)
+    {
+      ROS_WARN_STREAM("Unable to hand the connection from " << client << " to its earlier session: " << ec);
+      if (fd >= 0)
+      {
+        ::close(fd);
+      }
+      return SessionPtr();
+    }
+    accepted.close(ec);
+    ROS_INFO_STREAM("Client at " << client << " is back, within its reconnect grace.");
+    return session;
+  }
+
+  std::string client_name(tcp::socket& socket)
+  {
+    boost::system::error_code ec;
+    return socket.remote_endpoint(ec).address().to_string();
+  }
+
+  std::string client_name(boost::asio::local::stream_protocol::socket& socket)
+  {
+    boost::system::error_code ec;
+    return socket.local_endpoint(ec).path();
+  }
+
+  /**
+   * Unix socket peers have no address of their own, so they're numbered.
+   */
+  std::string peer_name(tcp::socket& socket)
+  {
+    boost::system::error_code ec;
+    std::ostringstream name;
+    name << socket.remote_endpoint(ec);
+    return name.str();
+  }
+
+  std::string peer_name(boost::asio::local::stream_protocol::socket& socket)
+  {
+    boost::system::error_code ec;
+    std::ostringstream name;
+    name << socket.local_endpoint(ec).path() << "#" << ++accepted_;
+    return name.str();
+  }
+
+  void configure_socket(boost::asio::local::stream_protocol::socket& socket)
+  {
+  }
+
+  static void remove_socket_file(const tcp::endpoint& endpoint)
+  {
+  }
+
+  static void remove_socket_file(const boost::asio::local::stream_protocol::endpoint& endpoint)
+  {
+    if (!endpoint.path().empty())
+    {
+      unlink(endpoint.path().c_str());
+    }
+  }
+
+  /**
+   * Lets go of a session which has stopped, or parks it, if it keeps its handlers
+   * for its client to come back to. The handlers it still has outstanding keep it
+   * until they've been called back.
+   */
+  void session_stopped(Session* session)
+  {
+    SessionPtr stopped = sessions_[session];
+    std::string client = clients_[session];
+    sessions_.erase(session);
+    clients_.erase(session);
+    if (stopped->reconnect_grace() <= 0)
+    {
+      return;
+    }
+
+    // Any session already parked for the client is let go in favour of this one.
+    ParkedSession& parked = parked_[client];
+    parked.session = stopped;
+    parked.timer.reset(new boost::asio::deadline_timer(io_service_));
+    parked.timer->expires_from_now(
+        boost::posix_time::microseconds(static_cast<int64_t>(stopped->reconnect_grace() * 1e6)));
+    parked.timer->async_wait(strand_.wrap(boost::bind(&TcpServer::drop_parked, this, client, session,
+                                                      boost::asio::placeholders::error)));
+  }
+
+  void drop_parked(const std::string& client, Session* session, const boost::system::error_code& error)
+  {
+    if (error)
+    {
+      return;
+    }
+    typename std::map<std::string, ParkedSession>::iterator it = parked_.find(client);
+    if (it != parked_.end() && it->second.session.get() == session)
+    {
+      parked_.erase(it);
+    }
+  }
+
   boost::asio::io_service& io_service_;
-  tcp::acceptor acceptor_;
+  boost::asio::io_service::strand strand_;
+  typename Protocol::acceptor acceptor_;
+  SessionPtr next_session_;
+  std::map<Session*, SessionPtr> sessions_;
+  // The client each running session was accepted from, and the stopped sessions
+  // kept for clients to come back to.
+  std::map<Session*, std::string> clients_;
+  std::map<std::string, ParkedSession> parked_;
+  unsigned int accepted_;
+
+  int max_sessions_;
+  bool nodelay_;
+  bool keepalive_;
+  int keepalive_idle_;
+  int keepalive_interval_;
+  int keepalive_count_;
+  int rcvbuf_;
+  int sndbuf_;
+  bool quickack_;
+  boost::function<void(Session&)> session_setup_;
 };
 
 }  // namespace
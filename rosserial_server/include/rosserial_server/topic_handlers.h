@@ -35,18 +35,238 @@
 #ifndef ROSSERIAL_SERVER_TOPIC_HANDLERS_H
 #define ROSSERIAL_SERVER_TOPIC_HANDLERS_H
 
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+
 #include <ros/ros.h>
 #include <rosserial_msgs/TopicInfo.h>
 #include <rosserial_msgs/RequestMessageInfo.h>
+#include <rosserial_msgs/RequestMessagesInfo.h>
 #include <rosserial_msgs/RequestServiceInfo.h>
 #include <topic_tools/shape_shifter.h>
 
+#include "rosserial_server/frame_trace.h"
+#include "rosserial_server/lifeline.h"
+#include "rosserial_server/message_definitions.h"
+#include "rosserial_server/message_info_cache.h"
+#include "rosserial_server/raw_message.h"
+#include "rosserial_server/service_call_pool.h"
+#include "rosserial_server/shared_subscriptions.h"
+#include "rosserial_server/typed_publishers.h"
+
 namespace rosserial_server
 {
 
+/**
+ * How the ROS side of a topic is set up, as opposed to its leg over the link:
+ * the size of roscpp's queue for it, and for a topic the client subscribes to,
+ * whether its publishers are asked for TCP_NODELAY, or for UDPROS first. For a
+ * topic the client publishes, with receive_stamp, a message starting with a
+ * Header which the client left unstamped is stamped with when it arrived. For
+ * a topic the client subscribes to, with replay_last, the latest message on it
+ * is sent as soon as the client sets up its subscriber.
+ */
+struct TopicOptions {
+  TopicOptions() : queue_size(1), tcp_nodelay(false), udp(false), receive_stamp(false), replay_last(false) {}
+
+  ros::TransportHints transport_hints() const {
+    ros::TransportHints hints;
+    if (udp) {
+      hints.unreliable();
+    }
+    return hints.reliable().tcpNoDelay(tcp_nodelay);
+  }
+
+  int queue_size;
+  bool tcp_nodelay;
+  bool udp;
+  bool receive_stamp;
+  bool replay_last;
+};
+
+/**
+ * Whether messages of this definition start with a Header, where the stamp is
+ * then the four bytes of its seq in.
+ */
+inline bool starts_with_header(const std::string& definition) {
+  std::istringstream lines(definition);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::istringstream words(line.substr(0, line.find('#')));
+    std::string type, name;
+    std::string rest;
+    if (!(words >> type >> name) || name.find('=') != std::string::npos || (words >> rest && rest[0] == '=')) {
+      // Blank, a comment, or a constant.
+      continue;
+    }
+    return type == "Header" || type == "std_msgs/Header";
+  }
+  return false;
+}
+
 class Publisher {
 public:
-  Publisher(ros::NodeHandle& nh, const rosserial_msgs::TopicInfo& topic_info) {
+  /**
+   * A shared publisher hands roscpp a message of its own for each frame, rather
+   * than lending it the read buffer. Subscribers in the same process, such as
+   * nodelets in the same manager, then get the message without it going through
+   * a loopback socket; generic ones, which subscribe to ShapeShifter, get this
+   * very message without it being copied at all. Topics of the types listed
+   * in TypedPublishers are published as their concrete type instead, for typed
+   * subscribers to get that way.
+   */
+  Publisher(ros::NodeHandle& nh, const rosserial_msgs::TopicInfo& topic_info, bool shared = false,
+            const TopicOptions& options = TopicOptions())
+    : shared_(shared), subscribed_(true), tracked_(new int(0)), topic_info_(topic_info) {
+    // Status callbacks still queued once this publisher is gone are dropped.
+    ros::SubscriberStatusCallback status_cb = boost::bind(&Publisher::subscribers_changed, this);
+    if (shared_ && TypedPublishers::instance().advertise(nh, topic_info.topic_name, topic_info.message_type,
+                                                         topic_info.md5sum, options.queue_size, status_cb,
+                                                         tracked_, publisher_, typed_handler_)) {
+      return;
+    }
+
+    std::string definition;
+    if (!MessageInfoCache::instance().getDefinition(topic_info.message_type, topic_info.md5sum, definition)) {
+      definition = lookup_definition(nh, topic_info);
+    }
+
+    message_.morph(topic_info.md5sum, topic_info.message_type, definition);
+    ros::AdvertiseOptions opts = message_.advertiseOptions(topic_info.topic_name, options.queue_size);
+    opts.connect_cb = status_cb;
+    opts.disconnect_cb = status_cb;
+    opts.tracked_object = tracked_;
+    publisher_ = nh.advertise(opts);
+  }
+
+  /**
+   * Called, through the session's callback queue, with whether the topic has any
+   * subscribers, each time that changes, and straight away with how it starts out.
+   */
+  void set_subscribed_callback(const boost::function<void(bool)>& callback) {
+    subscribed_callback_ = callback;
+    bool subscribed = publisher_.getNumSubscribers() > 0;
+    subscribed_ = subscribed;
+    subscribed_callback_(subscribed);
+  }
+
+  void handle(ros::serialization::IStream stream) {
+    // A message already on its way when the client was told to pause the topic.
+    if (!subscribed_) {
+      return;
+    }
+    if (typed_handler_) {
+      typed_handler_(publisher_, stream);
+      return;
+    }
+    if (shared_) {
+      boost::shared_ptr<topic_tools::ShapeShifter> msg(new topic_tools::ShapeShifter);
+      msg->morph(message_.getMD5Sum(), message_.getDataType(), message_.getMessageDefinition(), "");
+      msg->read(stream);
+      publisher_.publish(msg);
+      return;
+    }
+
+    // The stream is a view into the session's read buffer, which is left alone until
+    // this handler returns. Publishing by reference serializes immediately, so the
+    // payload is copied once, straight into roscpp's outgoing buffer.
+    message_.lend(stream.getData(), stream.getLength());
+    publisher_.publish(message_);
+    message_.release();
+  }
+
+  std::string get_topic() {
+    return publisher_.getTopic();
+  }
+
+  const rosserial_msgs::TopicInfo& get_topic_info() const {
+    return topic_info_;
+  }
+
+  /**
+   * Keeps the topic advertised while the client it came from is gone, telling the
+   * session nothing more until it has a new subscribed callback.
+   */
+  void park() {
+    subscribed_callback_.clear();
+  }
+
+  /**
+   * Looks up, in one call to the messages_info service, the definitions of the
+   * topics' types which neither the cache nor the system knows, so that setting
+   * up their publishers doesn't take a call each. Where the service isn't up, as
+   * with an older message_info_service, they're left to be looked up one by one.
+   */
+  static void prefetch_definitions(ros::NodeHandle& nh, const std::vector<rosserial_msgs::TopicInfo>& topics) {
+    rosserial_msgs::RequestMessagesInfo info;
+    std::vector<std::string> md5sums;
+    for (size_t i = 0; i < topics.size(); i++) {
+      std::string md5sum, definition;
+      if (MessageInfoCache::instance().getDefinition(topics[i].message_type, topics[i].md5sum, definition) ||
+          MessageDefinitions::instance().lookup_message(topics[i].message_type, md5sum, definition) ||
+          std::find(info.request.types.begin(), info.request.types.end(), topics[i].message_type) !=
+          info.request.types.end()) {
+        continue;
+      }
+      info.request.types.push_back(topics[i].message_type);
+      md5sums.push_back(topics[i].md5sum);
+    }
+    if (info.request.types.size() < 2) {
+      return;
+    }
+
+    if (!messages_service_.isValid()) {
+      messages_service_ = nh.serviceClient<rosserial_msgs::RequestMessagesInfo>("messages_info");
+    }
+    if (!messages_service_.exists() || !messages_service_.call(info) ||
+        info.response.md5s.size() != md5sums.size() || info.response.definitions.size() != md5sums.size()) {
+      ROS_DEBUG("No answer from the messages_info service; looking up message types one at a time.");
+      return;
+    }
+    ROS_DEBUG("Looked up %d message types at once.", static_cast<int>(md5sums.size()));
+    for (size_t i = 0; i < md5sums.size(); i++) {
+      if (info.response.md5s[i].empty()) {
+        // Unknown to the service too; the lookup for the topic itself warns of it.
+        continue;
+      }
+      if (info.response.md5s[i] != md5sums[i]) {
+        ROS_WARN_STREAM("Message" << info.request.types[i]  << "MD5 sum from client does not match that in system. Will avoid using system's message definition.");
+        info.response.definitions[i] = "";
+      }
+      MessageInfoCache::instance().putDefinition(info.request.types[i], md5sums[i], info.response.definitions[i]);
+    }
+  }
+
+private:
+  void subscribers_changed() {
+    bool subscribed = publisher_.getNumSubscribers() > 0;
+    if (subscribed_callback_ && subscribed != subscribed_) {
+      subscribed_ = subscribed;
+      subscribed_callback_(subscribed);
+    }
+  }
+
+  static std::string lookup_definition(ros::NodeHandle& nh, const rosserial_msgs::TopicInfo& topic_info) {
+    std::string md5sum, definition;
+    if (MessageDefinitions::instance().lookup_message(topic_info.message_type, md5sum, definition)) {
+      if (md5sum != topic_info.md5sum) {
+        ROS_WARN_STREAM("Message" << topic_info.message_type  << "MD5 sum from client does not match that in system. Will avoid using system's message definition.");
+        definition = "";
+      }
+      MessageInfoCache::instance().putDefinition(topic_info.message_type, topic_info.md5sum, definition);
+      return definition;
+    }
+
     if (!message_service_.isValid()) {
       // lazy-initialize the service caller.
       message_service_ = nh.serviceClient<rosserial_msgs::RequestMessageInfo>("message_info");
@@ -62,91 +282,343 @@ public:
         ROS_WARN_STREAM("Message" << topic_info.message_type  << "MD5 sum from client does not match that in system. Will avoid using system's message definition.");
         info.response.definition = "";
       }
+      // Only a successful answer is remembered, so that a failed call is retried next time.
+      MessageInfoCache::instance().putDefinition(topic_info.message_type, topic_info.md5sum,
+                                                 info.response.definition);
     } else {
       ROS_WARN("Failed to call message_info service. Proceeding without full message definition.");
     }
+    return info.response.definition;
+  }
+
+  ros::Publisher publisher_;
+  RawMessage message_;
+  bool shared_;
+  TypedPublishers::Handler typed_handler_;
+  boost::function<void(bool)> subscribed_callback_;
+  // Set from the session's callback queue, but read by handle() on whichever
+  // thread the session publishes from.
+  boost::atomic<bool> subscribed_;
+  boost::shared_ptr<int> tracked_;
+  rosserial_msgs::TopicInfo topic_info_;
+
+  static ros::ServiceClient message_service_;
+  static ros::ServiceClient messages_service_;
+};
+
+ros::ServiceClient Publisher::message_service_;
+ros::ServiceClient Publisher::messages_service_;
+typedef boost::shared_ptr<Publisher> PublisherPtr;
+
+
+/**
+ * The latest message on each topic subscribed to with replay_last, by its resolved
+ * name and md5sum, kept for the life of the process so that a client which comes
+ * back, to this session or another, is sent it straight away rather than waiting
+ * on the topic's next publish, which for a configuration or mode may be never.
+ */
+class LastMessages : boost::noncopyable {
+public:
+  typedef boost::shared_ptr<topic_tools::ShapeShifter const> MessagePtr;
 
-    message_.morph(topic_info.md5sum, topic_info.message_type, info.response.definition, "false");
-    publisher_ = message_.advertise(nh, topic_info.topic_name, 1);
+  static LastMessages& instance() {
+    static LastMessages last_messages;
+    return last_messages;
   }
 
-  void handle(ros::serialization::IStream stream) {
-    ros::serialization::Serializer<topic_tools::ShapeShifter>::read(stream, message_);
-    publisher_.publish(message_);
+  void put(const std::string& topic, const std::string& md5sum, const MessagePtr& msg) {
+    boost::mutex::scoped_lock lock(mutex_);
+    messages_[Key(topic, md5sum)] = msg;
   }
 
-  std::string get_topic() {
-    return publisher_.getTopic();
+  MessagePtr get(const std::string& topic, const std::string& md5sum) {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map<Key, MessagePtr>::const_iterator it = messages_.find(Key(topic, md5sum));
+    return it == messages_.end() ? MessagePtr() : it->second;
   }
 
 private:
-  ros::Publisher publisher_;
-  topic_tools::ShapeShifter message_;
+  typedef std::pair<std::string, std::string> Key;
 
-  static ros::ServiceClient message_service_;
-};
+  LastMessages() {}
 
-ros::ServiceClient Publisher::message_service_;
-typedef boost::shared_ptr<Publisher> PublisherPtr;
+  boost::mutex mutex_;
+  std::map<Key, MessagePtr> messages_;
+};
 
 
-class Subscriber {
+class Subscriber : public boost::enable_shared_from_this<Subscriber> {
 public:
   Subscriber(ros::NodeHandle& nh, rosserial_msgs::TopicInfo& topic_info,
-      boost::function<void(std::vector<uint8_t>& buffer)> write_fn)
-    : write_fn_(write_fn) {
+      boost::function<void(const topic_tools::ShapeShifter& msg)> write_fn, FrameTrace* trace = NULL,
+      const TopicOptions& options = TopicOptions())
+    : write_fn_(write_fn), topic_id_(topic_info.topic_id), trace_(trace),
+      buffer_size_(topic_info.buffer_size > 0 ? topic_info.buffer_size : 0), topic_info_(topic_info),
+      parked_(false), replay_last_(options.replay_last) {
     ros::SubscribeOptions opts;
     opts.init<topic_tools::ShapeShifter>(
-        topic_info.topic_name, 1, boost::bind(&Subscriber::handle, this, _1));
+        topic_info.topic_name, options.queue_size, boost::bind(&Subscriber::handle, this, _1, SharedPayloadPtr()));
     opts.md5sum = topic_info.md5sum;
     opts.datatype = topic_info.message_type;
+    opts.transport_hints = options.transport_hints();
     subscriber_ = nh.subscribe(opts);
   }
 
+  /**
+   * As the constructor, but taking the topic's messages from a subscription
+   * shared with the other sessions in the process taking the same topic, through
+   * strand, the session's, holding the session through lifeline on the way. Each
+   * comes already serialized, and is handed to shared_write_fn, for the session
+   * to send without a copy of its own, or to write_fn where shared_write_fn is empty.
+   */
+  static boost::shared_ptr<Subscriber> shared(SharedSubscriptions& shared_subscriptions,
+      boost::asio::io_service::strand& strand, const Lifeline& lifeline,
+      ros::NodeHandle& nh, rosserial_msgs::TopicInfo& topic_info,
+      boost::function<void(const topic_tools::ShapeShifter& msg)> write_fn,
+      boost::function<void(const SharedPayloadPtr& payload)> shared_write_fn, FrameTrace* trace = NULL,
+      const TopicOptions& options = TopicOptions()) {
+    boost::shared_ptr<Subscriber> sub(new Subscriber(topic_info, write_fn, trace));
+    sub->shared_write_fn_ = shared_write_fn;
+    sub->replay_last_ = options.replay_last;
+    sub->membership_ = shared_subscriptions.join(nh.resolveName(topic_info.topic_name), topic_info.message_type,
+        topic_info.md5sum, options.queue_size, options.transport_hints(),
+        boost::bind(&Subscriber::post_shared, boost::weak_ptr<Subscriber>(sub), boost::ref(strand), lifeline, _1, _2));
+    return sub;
+  }
+
   std::string get_topic() {
-    return subscriber_.getTopic();
+    return membership_ ? membership_->topic() : subscriber_.getTopic();
+  }
+
+  const rosserial_msgs::TopicInfo& get_topic_info() const {
+    return topic_info_;
+  }
+
+  /**
+   * Stays subscribed while the client it came from is gone, dropping messages,
+   * until reattached to the client's topic of the same name and type.
+   */
+  void park() {
+    parked_ = true;
+  }
+
+  void reattach(boost::function<void(const topic_tools::ShapeShifter& msg)> write_fn,
+                const rosserial_msgs::TopicInfo& topic_info,
+                boost::function<void(const SharedPayloadPtr& payload)> shared_write_fn =
+                    boost::function<void(const SharedPayloadPtr& payload)>()) {
+    write_fn_ = write_fn;
+    shared_write_fn_ = shared_write_fn;
+    topic_id_ = topic_info.topic_id;
+    buffer_size_ = topic_info.buffer_size > 0 ? topic_info.buffer_size : 0;
+    topic_info_ = topic_info;
+    parked_ = false;
+  }
+
+  /**
+   * With replay_last, sends the client the latest message on the topic, if one
+   * has come in since the process started, ahead of any pacing.
+   */
+  void replay_last() {
+    if (!replay_last_) {
+      return;
+    }
+    LastMessages::MessagePtr msg = LastMessages::instance().get(get_topic(), topic_info_.md5sum);
+    if (msg && (buffer_size_ == 0 || msg->size() <= buffer_size_)) {
+      ROS_DEBUG_STREAM("Replaying the last message on " << get_topic() << " to the client.");
+      write(*msg, SharedPayloadPtr());
+    }
+  }
+
+  /**
+   * Sends messages on to the client no more than max_rate times a second, so that a
+   * fast publisher can't take more than its share of a slow link. A message which
+   * arrives too soon is held back until it may go, and replaced by any which comes
+   * in meanwhile, so that the client always gets the latest. Must be called from
+   * the strand that ROS callbacks for the subscription run on, which the timer's
+   * callbacks are run on too.
+   */
+  void set_max_rate(boost::asio::io_service& io_service, boost::asio::io_service::strand& strand, double max_rate) {
+    if (max_rate <= 0) {
+      pacing_timer_.reset();
+      return;
+    }
+    pacing_timer_.reset(new boost::asio::deadline_timer(io_service));
+    pacing_strand_ = &strand;
+    pacing_interval_ = boost::posix_time::microseconds(static_cast<int64_t>(1e6 / max_rate));
+    next_write_ = boost::posix_time::ptime(boost::posix_time::min_date_time);
+    flush_pending_ = false;
   }
 
 private:
-  void handle(const boost::shared_ptr<topic_tools::ShapeShifter const>& msg) {
-    size_t length = ros::serialization::serializationLength(*msg);
-    std::vector<uint8_t> buffer(length);
+  Subscriber(const rosserial_msgs::TopicInfo& topic_info,
+      boost::function<void(const topic_tools::ShapeShifter& msg)> write_fn, FrameTrace* trace)
+    : write_fn_(write_fn), topic_id_(topic_info.topic_id), trace_(trace),
+      buffer_size_(topic_info.buffer_size > 0 ? topic_info.buffer_size : 0), topic_info_(topic_info),
+      parked_(false), replay_last_(false) {
+  }
+
+  /**
+   * Runs on the shared subscription's strand, so hands the message over to the
+   * session's, as long as the subscriber is still there.
+   */
+  static void post_shared(const boost::weak_ptr<Subscriber>& weak, boost::asio::io_service::strand& strand,
+                          const Lifeline& lifeline, const boost::shared_ptr<topic_tools::ShapeShifter const>& msg,
+                          const SharedPayloadPtr& payload) {
+    // The strand is the session's, which may be on its way out.
+    boost::shared_ptr<void> guard;
+    if (!lifeline.hold(guard)) {
+      return;
+    }
+    strand.post(make_guarded_handler(guard, boost::bind(&Subscriber::deliver_shared, weak, msg, payload)));
+  }
+
+  static void deliver_shared(const boost::weak_ptr<Subscriber>& weak,
+                             const boost::shared_ptr<topic_tools::ShapeShifter const>& msg,
+                             const SharedPayloadPtr& payload) {
+    boost::shared_ptr<Subscriber> self = weak.lock();
+    if (self) {
+      self->handle(msg, payload);
+    }
+  }
+
+  void handle(const boost::shared_ptr<topic_tools::ShapeShifter const>& msg,
+              const SharedPayloadPtr& payload = SharedPayloadPtr()) {
+    // Kept while parked too, for when the client comes back.
+    if (replay_last_) {
+      LastMessages::instance().put(get_topic(), topic_info_.md5sum, msg);
+    }
+    if (parked_) {
+      return;
+    }
+    if (trace_) trace_->record(FrameTrace::OUT_RECEIVED, topic_id_);
+
+    // The client gives the largest message it can take on the topic, and would
+    // only throw a larger one away after it had crossed the link.
+    if (buffer_size_ > 0 && msg->size() > buffer_size_) {
+      ROS_WARN_STREAM_THROTTLE(10, "Dropping a message of " << msg->size() << " bytes on " << get_topic() <<
+                               ", which the client takes at most " << buffer_size_ << " bytes of.");
+      if (trace_) trace_->record(FrameTrace::OUT_DROPPED, topic_id_);
+      return;
+    }
+
+    if (!pacing_timer_) {
+      write(*msg, payload);
+      return;
+    }
+    if (pending_ && trace_) trace_->record(FrameTrace::OUT_DROPPED, topic_id_);
+    pending_ = msg;
+    pending_payload_ = payload;
+    if (flush_pending_) {
+      return;
+    }
+    if (boost::asio::deadline_timer::traits_type::now() >= next_write_) {
+      flush();
+      return;
+    }
+    flush_pending_ = true;
+    pacing_timer_->expires_at(next_write_);
+    pacing_timer_->async_wait(pacing_strand_->wrap(
+        boost::bind(&Subscriber::paced, boost::weak_ptr<Subscriber>(shared_from_this()),
+                    boost::asio::placeholders::error)));
+  }
+
+  /**
+   * The pacing timer holds only a weak reference, as the session may drop the
+   * subscriber while it is waiting.
+   */
+  static void paced(const boost::weak_ptr<Subscriber>& weak, const boost::system::error_code& error) {
+    boost::shared_ptr<Subscriber> self = weak.lock();
+    if (error || !self) {
+      return;
+    }
+    self->flush_pending_ = false;
+    self->flush();
+  }
 
-    ros::serialization::OStream ostream(&buffer[0], length);
-    ros::serialization::Serializer<topic_tools::ShapeShifter>::write(ostream, *msg);
+  void flush() {
+    boost::shared_ptr<topic_tools::ShapeShifter const> msg;
+    SharedPayloadPtr payload;
+    msg.swap(pending_);
+    payload.swap(pending_payload_);
+    next_write_ = boost::asio::deadline_timer::traits_type::now() + pacing_interval_;
+    write(*msg, payload);
+  }
 
-    write_fn_(buffer);
+  void write(const topic_tools::ShapeShifter& msg, const SharedPayloadPtr& payload) {
+    if (parked_) {
+      return;
+    }
+    if (payload && shared_write_fn_) {
+      shared_write_fn_(payload);
+      return;
+    }
+    // The session serializes the message straight into the frame it sends.
+    write_fn_(msg);
   }
 
   ros::Subscriber subscriber_;
-  boost::function<void(std::vector<uint8_t>& buffer)> write_fn_;
+  SharedSubscriptions::MembershipPtr membership_;
+  boost::function<void(const topic_tools::ShapeShifter& msg)> write_fn_;
+  boost::function<void(const SharedPayloadPtr& payload)> shared_write_fn_;
+  uint16_t topic_id_;
+  FrameTrace* trace_;
+  uint32_t buffer_size_;
+  rosserial_msgs::TopicInfo topic_info_;
+  bool parked_;
+  bool replay_last_;
+
+  boost::scoped_ptr<boost::asio::deadline_timer> pacing_timer_;
+  boost::asio::io_service::strand* pacing_strand_;
+  boost::posix_time::time_duration pacing_interval_;
+  boost::posix_time::ptime next_write_;
+  boost::shared_ptr<topic_tools::ShapeShifter const> pending_;
+  SharedPayloadPtr pending_payload_;
+  bool flush_pending_;
 };
 
 typedef boost::shared_ptr<Subscriber> SubscriberPtr;
 
-class ServiceClient {
+class ServiceClient : public boost::enable_shared_from_this<ServiceClient> {
 public:
+  /**
+   * When a call pool is given, service calls are made on its threads, and the
+   * responses are posted back through the strand to be written. Otherwise, calls
+   * are made synchronously from handle(). A call on the pool holds the session's
+   * lifeline while it posts its response, so the strand and write_fn are still
+   * there to take it.
+   */
   ServiceClient(ros::NodeHandle& nh, rosserial_msgs::TopicInfo& topic_info,
-      boost::function<void(std::vector<uint8_t>& buffer, const uint16_t topic_id)> write_fn)
-    : write_fn_(write_fn) {
+      boost::function<void(std::vector<uint8_t>& buffer, const uint16_t topic_id)> write_fn,
+      boost::asio::io_service::strand& strand,
+      boost::shared_ptr<ServiceCallPool> call_pool = boost::shared_ptr<ServiceCallPool>(),
+      const Lifeline& lifeline = Lifeline())
+    : write_fn_(write_fn), strand_(strand), call_pool_(call_pool), lifeline_(lifeline), generation_(0) {
     topic_id_ = -1;
-    if (!service_info_service_.isValid()) {
-      // lazy-initialize the service caller.
-      service_info_service_ = nh.serviceClient<rosserial_msgs::RequestServiceInfo>("service_info");
-      if (!service_info_service_.waitForExistence(ros::Duration(5.0))) {
-        ROS_WARN("Timed out waiting for service_info service to become available.");
-      }
-    }
-
     rosserial_msgs::RequestServiceInfo info;
-    info.request.service = topic_info.message_type;
-    ROS_DEBUG("Calling service_info service for topic name %s",topic_info.topic_name.c_str());
-    if (service_info_service_.call(info)) {
-      request_message_md5_ = info.response.request_md5;
-      response_message_md5_ = info.response.response_md5;
+    if (MessageInfoCache::instance().getServiceInfo(topic_info.message_type, topic_info.md5sum, info.response)) {
+      ROS_DEBUG("Using cached service info for topic name %s",topic_info.topic_name.c_str());
+    } else if (MessageDefinitions::instance().lookup_service(topic_info.message_type, info.response)) {
+      ROS_DEBUG("Resolved service info for topic name %s from its .srv file",topic_info.topic_name.c_str());
+      MessageInfoCache::instance().putServiceInfo(topic_info.message_type, topic_info.md5sum, info.response);
     } else {
-      ROS_WARN("Failed to call service_info service. The service client will be created with blank md5sum.");
+      if (!service_info_service_.isValid()) {
+        // lazy-initialize the service caller.
+        service_info_service_ = nh.serviceClient<rosserial_msgs::RequestServiceInfo>("service_info");
+        if (!service_info_service_.waitForExistence(ros::Duration(5.0))) {
+          ROS_WARN("Timed out waiting for service_info service to become available.");
+        }
+      }
+
+      info.request.service = topic_info.message_type;
+      ROS_DEBUG("Calling service_info service for topic name %s",topic_info.topic_name.c_str());
+      if (service_info_service_.call(info)) {
+        MessageInfoCache::instance().putServiceInfo(topic_info.message_type, topic_info.md5sum, info.response);
+      } else {
+        ROS_WARN("Failed to call service_info service. The service client will be created with blank md5sum.");
+      }
     }
+    request_message_md5_ = info.response.request_md5;
+    response_message_md5_ = info.response.response_md5;
     ros::ServiceClientOptions opts;
     opts.service = topic_info.topic_name;
     opts.md5sum = service_md5_ = info.response.service_md5;
@@ -154,8 +626,29 @@ public:
     service_client_ = nh.serviceClient(opts);
   }
   void setTopicId(uint16_t topic_id) {
+    if (topic_id != topic_id_) {
+      // Calls made under the old id answer a request the client has forgotten.
+      generation_++;
+    }
     topic_id_ = topic_id;
   }
+
+  /**
+   * Called from the strand when the session stops. Responses to calls still on
+   * the pool are dropped rather than written to the session.
+   */
+  void detach() {
+    generation_++;
+    write_fn_.clear();
+  }
+
+  /**
+   * Called from the strand when a session which kept this service client while its
+   * client was gone is restarted by that client, to write responses to it again.
+   */
+  void reattach(boost::function<void(std::vector<uint8_t>& buffer, const uint16_t topic_id)> write_fn) {
+    write_fn_ = write_fn;
+  }
   std::string getRequestMessageMD5() {
     return request_message_md5_;
   }
@@ -164,6 +657,16 @@ public:
   }
 
   void handle(ros::serialization::IStream stream) {
+    if (call_pool_) {
+      // The stream belongs to the session's read buffer, so the request has to be
+      // copied out of it before the call moves over to the pool.
+      boost::shared_ptr<topic_tools::ShapeShifter> request(new topic_tools::ShapeShifter);
+      ros::serialization::Serializer<topic_tools::ShapeShifter>::read(stream, *request);
+      call_pool_->post(boost::bind(&ServiceClient::call, shared_from_this(), request,
+                                   static_cast<uint32_t>(generation_)));
+      return;
+    }
+
     // deserialize request message
     ros::serialization::Serializer<topic_tools::ShapeShifter>::read(stream, request_message_);
 
@@ -174,13 +677,43 @@ public:
 
     // write service response over the wire
     size_t length = ros::serialization::serializationLength(response_message_);
-    std::vector<uint8_t> buffer(length);
-    ros::serialization::OStream ostream(&buffer[0], length);
+    buffer_.resize(length);
+    ros::serialization::OStream ostream(buffer_.data(), length);
     ros::serialization::Serializer<topic_tools::ShapeShifter>::write(ostream, response_message_);
-    write_fn_(buffer,topic_id_);
+    write_fn_(buffer_,topic_id_);
   }
 
 private:
+  /**
+   * Runs on a call pool thread. The response is serialized here, and then only
+   * its bytes go back to the session's strand to be written.
+   */
+  void call(boost::shared_ptr<topic_tools::ShapeShifter> request, uint32_t generation) {
+    topic_tools::ShapeShifter response;
+    service_client_.call(*request, response, service_md5_);
+
+    // The session may have stopped, or gone altogether, while the call was made.
+    boost::shared_ptr<void> guard;
+    if (generation != generation_ || !lifeline_.hold(guard)) {
+      ROS_DEBUG("Dropping the response from service %s; its client has gone.", service_client_.getService().c_str());
+      return;
+    }
+
+    size_t length = ros::serialization::serializationLength(response);
+    boost::shared_ptr<std::vector<uint8_t> > buffer(new std::vector<uint8_t>(length));
+    ros::serialization::OStream ostream(buffer->data(), length);
+    ros::serialization::Serializer<topic_tools::ShapeShifter>::write(ostream, response);
+    strand_.post(make_guarded_handler(guard,
+        boost::bind(&ServiceClient::write_response, shared_from_this(), buffer, generation)));
+  }
+
+  void write_response(boost::shared_ptr<std::vector<uint8_t> > buffer, uint32_t generation) {
+    if (generation != generation_ || !write_fn_) {
+      return;
+    }
+    write_fn_(*buffer, topic_id_);
+  }
+
   topic_tools::ShapeShifter request_message_;
   topic_tools::ShapeShifter response_message_;
   ros::ServiceClient service_client_;
@@ -190,6 +723,12 @@ private:
   std::string request_message_md5_;
   std::string response_message_md5_;
   uint16_t topic_id_;
+  std::vector<uint8_t> buffer_;
+  boost::asio::io_service::strand& strand_;
+  boost::shared_ptr<ServiceCallPool> call_pool_;
+  Lifeline lifeline_;
+  // Bumped on the strand whenever responses to earlier calls are no longer wanted.
+  boost::atomic<uint32_t> generation_;
 };
 
 ros::ServiceClient ServiceClient::service_info_service_;
@@ -0,0 +1,142 @@
+/**
+ *
+ *  \file
+ *  \brief      Publishers of the message types the server is built with, by their concrete type.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef ROSSERIAL_SERVER_TYPED_PUBLISHERS_H
+#define ROSSERIAL_SERVER_TYPED_PUBLISHERS_H
+
+#include <map>
+#include <string>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/Imu.h>
+
+namespace rosserial_server
+{
+
+/**
+ * The message types which the server is compiled against. A topic of one of
+ * these, whose md5sum matches, can be advertised as its concrete type, and each
+ * message from the client deserialized once and published by shared pointer, so
+ * that typed subscribers in the same process, such as nodelets in the same
+ * manager, are handed it without it being serialized or copied for them.
+ *
+ * Subscribers in other processes pay for this, as roscpp has to serialize the
+ * message again for them, so it is only used alongside shared publishing.
+ */
+class TypedPublishers : boost::noncopyable
+{
+public:
+  typedef boost::function<void(ros::Publisher&, ros::serialization::IStream&)> Handler;
+
+  static TypedPublishers& instance()
+  {
+    static TypedPublishers publishers;
+    return publishers;
+  }
+
+  /**
+   * Advertises the topic as its concrete type, and gives the handler to publish
+   * each message with, if it is one of the known types. Otherwise, returns false
+   * and leaves the topic to be advertised generically.
+   */
+  bool advertise(ros::NodeHandle& nh, const std::string& topic, const std::string& type,
+                 const std::string& md5sum, int queue_size, const ros::SubscriberStatusCallback& status_cb,
+                 const ros::VoidConstPtr& tracked_object, ros::Publisher& publisher, Handler& handler) const
+  {
+    std::map<std::string, Entry>::const_iterator it = entries_.find(type);
+    if (it == entries_.end() || it->second.md5sum != md5sum) return false;
+    publisher = it->second.advertise(nh, topic, queue_size, status_cb, tracked_object);
+    handler = it->second.handler;
+    return true;
+  }
+
+private:
+  struct Entry
+  {
+    std::string md5sum;
+    boost::function<ros::Publisher(ros::NodeHandle&, const std::string&, int,
+                                   const ros::SubscriberStatusCallback&,
+                                   const ros::VoidConstPtr&)> advertise;
+    Handler handler;
+  };
+
+  TypedPublishers()
+  {
+    add<geometry_msgs::Twist>();
+    add<nav_msgs::Odometry>();
+    add<sensor_msgs::Imu>();
+  }
+
+  template<class M>
+  void add()
+  {
+    Entry& entry = entries_[ros::message_traits::DataType<M>::value()];
+    entry.md5sum = ros::message_traits::MD5Sum<M>::value();
+    entry.advertise = &TypedPublishers::advertise_typed<M>;
+    entry.handler = &TypedPublishers::publish_typed<M>;
+  }
+
+  template<class M>
+  static ros::Publisher advertise_typed(ros::NodeHandle& nh, const std::string& topic, int queue_size,
+                                        const ros::SubscriberStatusCallback& status_cb,
+                                        const ros::VoidConstPtr& tracked_object)
+  {
+    return nh.advertise<M>(topic, queue_size, status_cb, status_cb, tracked_object);
+  }
+
+  template<class M>
+  static void publish_typed(ros::Publisher& publisher, ros::serialization::IStream& stream)
+  {
+    boost::shared_ptr<M> msg(new M);
+    try {
+      ros::serialization::deserialize(stream, *msg);
+    } catch (ros::serialization::StreamOverrunException& e) {
+      ROS_WARN_STREAM_THROTTLE(1, "Dropping a " << ros::message_traits::DataType<M>::value() <<
+                               " message on " << publisher.getTopic() << " which is too short.");
+      return;
+    }
+    publisher.publish(msg);
+  }
+
+  std::map<std::string, Entry> entries_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_TYPED_PUBLISHERS_H
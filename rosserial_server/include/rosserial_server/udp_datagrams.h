@@ -0,0 +1,505 @@
+/**
+ *
+ *  \file
+ *  \brief      Batched sending and receiving of datagrams, for the UDP
+ *              sessions.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_UDP_DATAGRAMS_H
+#define ROSSERIAL_SERVER_UDP_DATAGRAMS_H
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <sys/socket.h>
+
+#include <ros/ros.h>
+
+
+namespace rosserial_server
+{
+
+using boost::asio::ip::udp;
+
+typedef boost::shared_ptr<std::vector<uint8_t> > DatagramPtr;
+
+/**
+ * Receives as many datagrams as are waiting, up to batch_size, without blocking. On
+ * Linux this is one recvmmsg call, each datagram landing in its own slot of a buffer
+ * kept for the purpose; elsewhere it's one receive_from per datagram.
+ */
+class UdpReceiveBatch
+{
+public:
+  enum { batch_size = 16, max_datagram_bytes = 65536 };
+
+  UdpReceiveBatch() : slots_(batch_size * max_datagram_bytes), sizes_(batch_size), endpoints_(batch_size), count_(0)
+  {
+#ifdef __linux__
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+      iovecs_[i].iov_base = &slots_[i * max_datagram_bytes];
+      iovecs_[i].iov_len = max_datagram_bytes;
+    }
+#endif
+  }
+
+  /**
+   * Returns the number of datagrams received, which is zero when there were none
+   * waiting, or on an error, which is left in ec.
+   */
+  size_t receive(udp::socket& socket, boost::system::error_code& ec)
+  {
+    count_ = 0;
+    ec = boost::system::error_code();
+#ifdef __linux__
+    for (size_t i = 0; i < batch_size; ++i)
+    {
+      memset(&headers_[i], 0, sizeof(headers_[i]));
+      headers_[i].msg_hdr.msg_name = endpoints_[i].data();
+      headers_[i].msg_hdr.msg_namelen = endpoints_[i].capacity();
+      headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+      headers_[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received = recvmmsg(socket.native_handle(), headers_, batch_size, MSG_DONTWAIT, NULL);
+    if (received < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+      }
+      return 0;
+    }
+    for (int i = 0; i < received; ++i)
+    {
+      endpoints_[i].resize(headers_[i].msg_hdr.msg_namelen);
+      sizes_[i] = headers_[i].msg_len;
+      if (headers_[i].msg_hdr.msg_flags & MSG_TRUNC)
+      {
+        ROS_WARN_STREAM_THROTTLE(1, "Truncated datagram of more than " << max_datagram_bytes <<
+                                 " bytes from " << endpoints_[i]);
+      }
+    }
+    count_ = received;
+#else
+    bool non_blocking = socket.non_blocking();
+    socket.non_blocking(true);
+    while (count_ < batch_size)
+    {
+      sizes_[count_] = socket.receive_from(boost::asio::buffer(&slots_[count_ * max_datagram_bytes],
+                                                               max_datagram_bytes),
+                                           endpoints_[count_], 0, ec);
+      if (ec)
+      {
+        if (ec == boost::asio::error::would_block)
+        {
+          ec = boost::system::error_code();
+        }
+        break;
+      }
+      count_++;
+    }
+    socket.non_blocking(non_blocking);
+#endif
+    return count_;
+  }
+
+  uint8_t* data(size_t i)
+  {
+    return &slots_[i * max_datagram_bytes];
+  }
+
+  const uint8_t* data(size_t i) const
+  {
+    return &slots_[i * max_datagram_bytes];
+  }
+
+  size_t size(size_t i) const
+  {
+    return sizes_[i];
+  }
+
+  const udp::endpoint& endpoint(size_t i) const
+  {
+    return endpoints_[i];
+  }
+
+  DatagramPtr copy(size_t i) const
+  {
+    return DatagramPtr(new std::vector<uint8_t>(data(i), data(i) + size(i)));
+  }
+
+private:
+  std::vector<uint8_t> slots_;
+  std::vector<size_t> sizes_;
+  std::vector<udp::endpoint> endpoints_;
+  size_t count_;
+#ifdef __linux__
+  struct mmsghdr headers_[batch_size];
+  struct iovec iovecs_[batch_size];
+#endif
+};
+
+/**
+ * Gathers the buffers of a write into datagrams, as many whole buffers to each as
+ * fit in max_datagram_bytes, so that a frame the session writes in several
+ * buffers, as it does a shared message, isn't parted across datagrams unless the
+ * write is too large for one. The datagrams' iovecs point into the buffers, which
+ * aren't copied.
+ */
+class DatagramGather
+{
+public:
+  enum { max_iovecs = 128, max_datagram_bytes = 65507 };
+
+#ifdef __linux__
+  typedef struct mmsghdr Header;
+#else
+  // Only the msghdr of each is used where there's no sendmmsg.
+  struct Header
+  {
+    msghdr msg_hdr;
+  };
+#endif
+
+  DatagramGather() : count_(0), iovecs_used_(0)
+  {
+  }
+
+  /**
+   * Gathers from it as many buffers as there is room for, up to end, into
+   * datagrams addressed to the endpoint, and returns how many datagrams.
+   */
+  template <typename Iterator>
+  size_t gather(Iterator& it, const Iterator& end, const udp::endpoint& endpoint)
+  {
+    count_ = 0;
+    iovecs_used_ = 0;
+    size_t datagram_bytes = 0;
+    for (; it != end && iovecs_used_ < max_iovecs; ++it)
+    {
+      boost::asio::const_buffer buffer(*it);
+      size_t size = boost::asio::buffer_size(buffer);
+      if (count_ == 0 || (datagram_bytes > 0 && datagram_bytes + size > max_datagram_bytes))
+      {
+        msghdr& header = headers_[count_++].msg_hdr;
+        memset(&header, 0, sizeof(header));
+        header.msg_name = const_cast<void*>(static_cast<const void*>(endpoint.data()));
+        header.msg_namelen = endpoint.size();
+        header.msg_iov = &iovecs_[iovecs_used_];
+        datagram_bytes = 0;
+      }
+      iovecs_[iovecs_used_].iov_base = const_cast<void*>(boost::asio::buffer_cast<const void*>(buffer));
+      iovecs_[iovecs_used_].iov_len = size;
+      iovecs_used_++;
+      headers_[count_ - 1].msg_hdr.msg_iovlen++;
+      datagram_bytes += size;
+    }
+    return count_;
+  }
+
+  size_t bytes(size_t i) const
+  {
+    size_t total = 0;
+    const msghdr& header = headers_[i].msg_hdr;
+    for (size_t j = 0; j < header.msg_iovlen; ++j)
+    {
+      total += header.msg_iov[j].iov_len;
+    }
+    return total;
+  }
+
+  Header* headers()
+  {
+    return headers_;
+  }
+
+private:
+  Header headers_[max_iovecs];
+  struct iovec iovecs_[max_iovecs];
+  size_t count_;
+  size_t iovecs_used_;
+};
+
+/**
+ * Sends the buffers to the endpoint in as few datagrams as DatagramGather makes of
+ * them, so that every frame the session writes arrives whole. On Linux they go out
+ * in as few sendmmsg calls as will take them; elsewhere in one sendmsg each. Never
+ * waits: once the socket's send buffer is full, returns the bytes of the datagrams
+ * which went out, and if that's none of them, sets ec to would_block.
+ */
+template <typename ConstBufferSequence>
+size_t send_datagrams(udp::socket& socket, const udp::endpoint& endpoint,
+                      const ConstBufferSequence& buffers, boost::system::error_code& ec)
+{
+  ec = boost::system::error_code();
+  size_t bytes_sent = 0;
+  DatagramGather gather;
+  typename ConstBufferSequence::const_iterator it = buffers.begin();
+  while (it != buffers.end())
+  {
+    size_t count = gather.gather(it, buffers.end(), endpoint);
+    for (size_t sent = 0; sent < count;)
+    {
+#ifdef __linux__
+      int result = sendmmsg(socket.native_handle(), gather.headers() + sent, count - sent, MSG_DONTWAIT);
+#else
+      // Not asio's send_to, which waits for room itself on a blocking socket.
+      int result = ::sendmsg(socket.native_handle(), &gather.headers()[sent].msg_hdr, MSG_DONTWAIT) < 0 ? -1 : 1;
+#endif
+      if (result < 0)
+      {
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && bytes_sent > 0)
+        {
+          return bytes_sent;
+        }
+        ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+        // The two spellings of EAGAIN may differ, and callers look for asio's.
+        if (ec.value() == EAGAIN || ec.value() == EWOULDBLOCK)
+        {
+          ec = boost::asio::error::would_block;
+        }
+        return bytes_sent;
+      }
+      for (size_t i = sent; i < sent + result; ++i)
+      {
+        bytes_sent += gather.bytes(i);
+      }
+      sent += result;
+    }
+  }
+  return bytes_sent;
+}
+
+/**
+ * Waits for the socket to have room to send, without sending anything.
+ */
+template <typename Handler>
+void async_wait_writable(udp::socket& socket, Handler handler)
+{
+  socket.async_send(boost::asio::null_buffers(), handler);
+}
+
+template <typename Handler>
+void async_wait_writable(boost::asio::posix::stream_descriptor& descriptor, Handler handler)
+{
+  descriptor.async_write_some(boost::asio::null_buffers(), handler);
+}
+
+/**
+ * What's left of a write whose datagrams found the socket's send buffer full: waits
+ * on the waiter until the socket is writable again, then sends as many as will go,
+ * and calls the handler back with their bytes. Any left over are for the caller to
+ * write again, as asio's async_write does. Allocates and invokes as the handler does,
+ * so that the wait comes out of the session's handler memory, and on its strand.
+ */
+template <typename Waiter, typename ConstBufferSequence, typename WriteHandler>
+class SendDatagramsOp
+{
+public:
+  SendDatagramsOp(Waiter& waiter, udp::socket& socket, const udp::endpoint& endpoint,
+                  const ConstBufferSequence& buffers, const WriteHandler& handler)
+    : waiter_(&waiter), socket_(&socket), endpoint_(endpoint), buffers_(buffers), handler_(handler)
+  {
+  }
+
+  void operator()(const boost::system::error_code& error, size_t = 0)
+  {
+    boost::system::error_code ec = error;
+    size_t bytes_sent = 0;
+    if (!ec)
+    {
+      bytes_sent = send_datagrams(*socket_, endpoint_, buffers_, ec);
+    }
+    if (ec == boost::asio::error::would_block)
+    {
+      async_wait_writable(*waiter_, *this);
+      return;
+    }
+    handler_(ec, bytes_sent);
+  }
+
+  friend void* asio_handler_allocate(std::size_t length, SendDatagramsOp* this_handler)
+  {
+    return boost_asio_handler_alloc_helpers::allocate(length, this_handler->handler_);
+  }
+
+  friend void asio_handler_deallocate(void* pointer, std::size_t length, SendDatagramsOp* this_handler)
+  {
+    boost_asio_handler_alloc_helpers::deallocate(pointer, length, this_handler->handler_);
+  }
+
+  template <typename Function>
+  friend void asio_handler_invoke(Function& function, SendDatagramsOp* this_handler)
+  {
+    boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+  }
+
+  template <typename Function>
+  friend void asio_handler_invoke(const Function& function, SendDatagramsOp* this_handler)
+  {
+    boost_asio_handler_invoke_helpers::invoke(function, this_handler->handler_);
+  }
+
+private:
+  Waiter* waiter_;
+  udp::socket* socket_;
+  udp::endpoint endpoint_;
+  ConstBufferSequence buffers_;
+  WriteHandler handler_;
+};
+
+/**
+ * Sends the buffers as datagrams, as send_datagrams() does, for a stream's
+ * async_write_some. If the socket has no room for any of them, the rest of the write
+ * is left to a SendDatagramsOp, so that the thread calling this is never held up.
+ */
+template <typename Waiter, typename ConstBufferSequence, typename WriteHandler>
+void async_send_datagrams(boost::asio::io_service& io_service, Waiter& waiter, udp::socket& socket,
+                          const udp::endpoint& endpoint, const ConstBufferSequence& buffers,
+                          WriteHandler handler)
+{
+  boost::system::error_code ec;
+  size_t bytes_sent = send_datagrams(socket, endpoint, buffers, ec);
+  if (ec == boost::asio::error::would_block)
+  {
+    async_wait_writable(waiter, SendDatagramsOp<Waiter, ConstBufferSequence, WriteHandler>(
+        waiter, socket, endpoint, buffers, handler));
+    return;
+  }
+  io_service.post(boost::asio::detail::bind_handler(handler, ec, bytes_sent));
+}
+
+/**
+ * The datagrams received for a session, read back out as a byte stream, which is
+ * what its read buffer expects. A read takes from one datagram at a time, and any
+ * part of it which doesn't fit is kept for the next.
+ */
+class DatagramQueue
+{
+public:
+  explicit DatagramQueue(boost::asio::io_service& io_service) : io_service_(io_service), front_offset_(0)
+  {
+  }
+
+  bool empty() const
+  {
+    return datagrams_.empty();
+  }
+
+  /**
+   * Queues a datagram, completing the pending read if there is one.
+   */
+  void deliver(const DatagramPtr& datagram)
+  {
+    datagrams_.push_back(datagram);
+    if (read_copy_)
+    {
+      complete_read(boost::system::error_code());
+    }
+  }
+
+  /**
+   * Drops whatever hasn't been read, and aborts the pending read.
+   */
+  void clear()
+  {
+    datagrams_.clear();
+    front_offset_ = 0;
+    if (read_copy_)
+    {
+      complete_read(boost::asio::error::operation_aborted);
+    }
+  }
+
+  template <typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
+  {
+    read_copy_ = BufferCopy<MutableBufferSequence>(buffers);
+    read_handler_ = handler;
+    if (!datagrams_.empty())
+    {
+      complete_read(boost::system::error_code());
+    }
+  }
+
+private:
+  template <typename MutableBufferSequence>
+  struct BufferCopy
+  {
+    explicit BufferCopy(const MutableBufferSequence& buffers) : buffers_(buffers) {}
+
+    size_t operator()(const uint8_t* data, size_t length) const
+    {
+      return boost::asio::buffer_copy(buffers_, boost::asio::buffer(data, length));
+    }
+
+    MutableBufferSequence buffers_;
+  };
+
+  void complete_read(const boost::system::error_code& error)
+  {
+    size_t bytes_transferred = 0;
+    if (!error)
+    {
+      const std::vector<uint8_t>& front = *datagrams_.front();
+      size_t remaining = front.size() - front_offset_;
+      bytes_transferred = read_copy_(front.data() + front_offset_, remaining);
+      if (bytes_transferred < remaining)
+      {
+        front_offset_ += bytes_transferred;
+      }
+      else
+      {
+        datagrams_.pop_front();
+        front_offset_ = 0;
+      }
+    }
+    boost::function<void(const boost::system::error_code&, size_t)> handler;
+    handler.swap(read_handler_);
+    read_copy_.clear();
+    io_service_.post(boost::bind(handler, error, bytes_transferred));
+  }
+
+  boost::asio::io_service& io_service_;
+  std::deque<DatagramPtr> datagrams_;
+  size_t front_offset_;
+  boost::function<size_t(const uint8_t*, size_t)> read_copy_;
+  boost::function<void(const boost::system::error_code&, size_t)> read_handler_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_UDP_DATAGRAMS_H
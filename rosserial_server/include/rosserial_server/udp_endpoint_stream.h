@@ -0,0 +1,276 @@
+/**
+ *
+ *  \file
+ *  \brief      Adapter which presents one client of a shared UDP socket
+ *              as a stream, for the sessions of UdpServer.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_UDP_ENDPOINT_STREAM_H
+#define ROSSERIAL_SERVER_UDP_ENDPOINT_STREAM_H
+
+#include <unistd.h>
+#include <list>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/udp_datagrams.h"
+
+
+namespace rosserial_server
+{
+
+using boost::asio::ip::udp;
+
+/**
+ * Waits for room to send on a UDP socket shared by many sessions, for all of them,
+ * on one duplicate of the socket. asio mustn't have the socket itself waited on
+ * from sessions on other threads, and a duplicate for each client would cost a
+ * file descriptor apiece. Waits may be added and cancelled from any thread; each
+ * is posted back through its handler, so runs as the handler would.
+ */
+class SharedWriteWaiter : boost::noncopyable
+{
+public:
+  SharedWriteWaiter(boost::asio::io_service& io_service, udp::socket& socket)
+    : io_service_(io_service), descriptor_(io_service), waiting_(false)
+  {
+    boost::system::error_code ec;
+    int fd = ::dup(socket.native_handle());
+    if (fd >= 0)
+    {
+      descriptor_.assign(fd, ec);
+    }
+    if (fd < 0 || ec)
+    {
+      ROS_WARN("Unable to wait on the UDP socket, so writes to it will fail when it's full.");
+      if (fd >= 0) ::close(fd);
+    }
+  }
+
+  /**
+   * Calls the handler back once the socket is writable, unless owner's waits are
+   * cancelled first.
+   */
+  template <typename Handler>
+  void async_wait(const void* owner, const Handler& handler)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    waits_.push_back(Wait(owner, PostedHandler<Handler>(io_service_, handler)));
+    if (!waiting_)
+    {
+      waiting_ = true;
+      descriptor_.async_write_some(boost::asio::null_buffers(),
+          boost::bind(&SharedWriteWaiter::writable, this, boost::asio::placeholders::error));
+    }
+  }
+
+  /**
+   * Calls owner's waiting handlers back straight away, with operation_aborted.
+   */
+  void cancel(const void* owner)
+  {
+    Waits cancelled;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      for (Waits::iterator it = waits_.begin(); it != waits_.end();)
+      {
+        if (it->first == owner)
+        {
+          cancelled.splice(cancelled.end(), waits_, it++);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+    call(cancelled, boost::asio::error::operation_aborted);
+  }
+
+private:
+  template <typename Handler>
+  class PostedHandler
+  {
+  public:
+    PostedHandler(boost::asio::io_service& io_service, const Handler& handler)
+      : io_service_(&io_service), handler_(handler)
+    {
+    }
+
+    void operator()(const boost::system::error_code& error)
+    {
+      io_service_->post(boost::asio::detail::bind_handler(handler_, error));
+    }
+
+  private:
+    boost::asio::io_service* io_service_;
+    Handler handler_;
+  };
+
+  typedef std::pair<const void*, boost::function<void(const boost::system::error_code&)> > Wait;
+  typedef std::list<Wait> Waits;
+
+  void writable(const boost::system::error_code& error)
+  {
+    Waits ready;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      ready.swap(waits_);
+      waiting_ = false;
+    }
+    call(ready, error);
+  }
+
+  static void call(Waits& waits, const boost::system::error_code& error)
+  {
+    for (Waits::iterator it = waits.begin(); it != waits.end(); ++it)
+    {
+      it->second(error);
+    }
+  }
+
+  boost::asio::io_service& io_service_;
+  boost::asio::posix::stream_descriptor descriptor_;
+  boost::mutex mutex_;
+  Waits waits_;
+  bool waiting_;
+};
+
+/**
+ * One client's side of a UDP socket shared by many. Datagrams from the client are
+ * received by the owner of the socket and handed in through deliver(), and are read
+ * back out as a byte stream; writes go straight to the client's endpoint.
+ *
+ * All calls other than writes must come from the owning session's strand.
+ */
+class UdpEndpointStream
+{
+public:
+  explicit UdpEndpointStream(boost::asio::io_service& io_service)
+    : io_service_(io_service), socket_(NULL), writable_(NULL), datagrams_(io_service)
+  {
+  }
+
+  /**
+   * Writes go to the endpoint through the socket, and wait on the socket's
+   * waiter when it's full.
+   */
+  void attach(udp::socket& socket, SharedWriteWaiter& writable, const udp::endpoint& endpoint)
+  {
+    socket_ = &socket;
+    writable_ = &writable;
+    endpoint_ = endpoint;
+  }
+
+  const udp::endpoint& remote_endpoint() const
+  {
+    return endpoint_;
+  }
+
+  void deliver(const DatagramPtr& datagram)
+  {
+    datagrams_.deliver(datagram);
+  }
+
+  /**
+   * Drops whatever hasn't been read, and aborts the pending read, but leaves the
+   * stream usable, for when the session starts again.
+   */
+  void close()
+  {
+    datagrams_.clear();
+    if (writable_)
+    {
+      writable_->cancel(this);
+    }
+  }
+
+#if (BOOST_VERSION >= 106600)
+  typedef boost::asio::io_service::executor_type executor_type;
+
+  executor_type get_executor()
+  {
+    return io_service_.get_executor();
+  }
+#endif
+
+  boost::asio::io_service& get_io_service()
+  {
+    return io_service_;
+  }
+
+  template <typename MutableBufferSequence, typename ReadHandler>
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
+  {
+    datagrams_.async_read_some(buffers, handler);
+  }
+
+  /**
+   * Each write goes to the client in as few datagrams as send_datagrams() gathers
+   * it into, parting frames only where the write is too large for one. The socket
+   * is shared with other sessions, which may be on other threads, so when its send
+   * buffer is full the write waits for room on the SharedWriteWaiter.
+   */
+  template <typename ConstBufferSequence, typename WriteHandler>
+  void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler)
+  {
+    async_send_datagrams(io_service_, *this, *socket_, endpoint_, buffers, handler);
+  }
+
+  /**
+   * For async_wait_writable(), as the waiter of this stream's writes.
+   */
+  template <typename Handler>
+  void async_wait_writable(const Handler& handler)
+  {
+    writable_->async_wait(this, handler);
+  }
+
+private:
+  boost::asio::io_service& io_service_;
+  udp::socket* socket_;
+  SharedWriteWaiter* writable_;
+  udp::endpoint endpoint_;
+  DatagramQueue datagrams_;
+};
+
+template <typename Handler>
+void async_wait_writable(UdpEndpointStream& stream, Handler handler)
+{
+  stream.async_wait_writable(handler);
+}
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_UDP_ENDPOINT_STREAM_H
@@ -0,0 +1,318 @@
+/**
+ *
+ *  \file
+ *  \brief      Server which answers many UDP clients on a single socket,
+ *              with a session for each one.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#ifndef ROSSERIAL_SERVER_UDP_SERVER_H
+#define ROSSERIAL_SERVER_UDP_SERVER_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/session.h"
+#include "rosserial_server/udp_endpoint_stream.h"
+
+
+namespace rosserial_server
+{
+
+using boost::asio::ip::udp;
+
+/**
+ * Binds one UDP socket, and creates a session for each endpoint which datagrams
+ * arrive from, so that one process can serve many clients on one port. A session
+ * which hasn't heard from its client for client_timeout is stopped and dropped;
+ * should the client come back, it gets a new one. As with TcpServer, a dropped
+ * session is deleted once the last of its handlers, which hold it through its
+ * lifeline, has been called back.
+ *
+ * A session which keeps its handlers across reconnects, given ~reconnect_grace, is
+ * held for that long after it's dropped, by its client's address. The first datagram
+ * from that address within the time, from whatever port, takes it up again, rather
+ * than starting a new session, so that a client which has restarted can take up
+ * its publishers, subscribers and service clients again.
+ *
+ * With datagram_input, every datagram is taken to hold whole frames, and is parsed
+ * on its own, rather than being fed into the session's stream of bytes.
+ */
+template< typename Session = rosserial_server::Session<UdpEndpointStream> >
+class UdpServer
+{
+public:
+  UdpServer(boost::asio::io_service& io_service, const udp::endpoint& server_endpoint,
+            const boost::posix_time::time_duration& client_timeout, bool datagram_input = false)
+    : io_service_(io_service),
+      strand_(io_service),
+      socket_(io_service, server_endpoint),
+      writable_(io_service, socket_),
+      sweep_timer_(io_service),
+      client_timeout_(client_timeout),
+      datagram_input_(datagram_input)
+  {
+    receive();
+    sweep();
+  }
+
+  /**
+   * A session's pending read waits in its stream rather than in the io_service,
+   * so it is dropped here, once the io_service has stopped running, to let go of
+   * the session.
+   */
+  ~UdpServer()
+  {
+    for (typename std::map<udp::endpoint, Client>::iterator it = clients_.begin(); it != clients_.end(); ++it)
+    {
+      it->second.session->socket().close();
+    }
+    for (typename std::map<boost::asio::ip::address, Client>::iterator it = parked_.begin(); it != parked_.end(); ++it)
+    {
+      it->second.session->socket().close();
+    }
+  }
+
+  /**
+   * Called with each session as its client is first heard from, before it starts,
+   * to configure it further.
+   */
+  void set_session_setup(const boost::function<void(Session&)>& setup)
+  {
+    session_setup_ = setup;
+  }
+
+private:
+  typedef boost::shared_ptr<Session> SessionPtr;
+
+  // Of a parked session, last_heard is when it's to be let go.
+  struct Client
+  {
+    SessionPtr session;
+    boost::posix_time::ptime last_heard;
+  };
+
+  /**
+   * Waits for the socket to become readable, and then takes everything which has
+   * arrived, a batch at a time, so that many clients sending at once cost one wakeup
+   * rather than one per datagram.
+   */
+  void receive()
+  {
+    socket_.async_receive(boost::asio::null_buffers(),
+        strand_.wrap(boost::bind(&UdpServer::receive_cb, this, boost::asio::placeholders::error)));
+  }
+
+  void receive_cb(const boost::system::error_code& error)
+  {
+    if (error == boost::asio::error::operation_aborted)
+    {
+      return;
+    }
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    for (int batches = 0; batches < max_batches_per_wakeup; ++batches)
+    {
+      boost::system::error_code ec;
+      size_t count = batch_.receive(socket_, ec);
+      if (ec)
+      {
+        // Errors on an unconnected UDP socket, such as ICMP port unreachable from a
+        // client which has gone away, concern only that client.
+        ROS_DEBUG_STREAM("UDP receive error: " << ec);
+        continue;
+      }
+      for (size_t i = 0; i < count; ++i)
+      {
+        Client& client = client_for(batch_.endpoint(i));
+        client.last_heard = now;
+        client.session->strand().post(boost::bind(&UdpServer::deliver, client.session, batch_.copy(i),
+                                                  datagram_input_));
+      }
+      if (count < UdpReceiveBatch::batch_size)
+      {
+        break;
+      }
+    }
+    receive();
+  }
+
+  Client& client_for(const udp::endpoint& endpoint)
+  {
+    typename std::map<udp::endpoint, Client>::iterator it = clients_.find(endpoint);
+    if (it != clients_.end())
+    {
+      return it->second;
+    }
+
+    std::ostringstream hardware_id;
+    hardware_id << endpoint;
+    Client& client = clients_[endpoint];
+    typename std::map<boost::asio::ip::address, Client>::iterator parked = parked_.find(endpoint.address());
+    if (parked != parked_.end())
+    {
+      ROS_INFO_STREAM("UDP client is back at " << endpoint << ", within its reconnect grace.");
+      client.session = parked->second.session;
+      parked_.erase(parked);
+      // After the session has stopped, and before it's started again.
+      client.session->strand().post(boost::bind(&UdpServer::reattach, client.session, &socket_, &writable_,
+                                                endpoint, hardware_id.str()));
+      return client;
+    }
+
+    ROS_INFO_STREAM("New UDP client at " << endpoint);
+    client.session.reset(new Session(io_service_));
+    client.session->set_owner(client.session);
+    client.session->socket().attach(socket_, writable_, endpoint);
+    client.session->set_hardware_id(hardware_id.str());
+    client.session->set_datagram_input(datagram_input_);
+    if (session_setup_)
+    {
+      session_setup_(*client.session);
+    }
+    return client;
+  }
+
+  static void reattach(const SessionPtr& session, udp::socket* socket, SharedWriteWaiter* writable,
+                       const udp::endpoint& endpoint, const std::string& hardware_id)
+  {
+    session->socket().attach(*socket, *writable, endpoint);
+    session->set_hardware_id(hardware_id);
+  }
+
+  /**
+   * Runs on the session's strand. A session is started by the first datagram from
+   * its client, and again by the next one after it has lost sync.
+   */
+  static void deliver(const SessionPtr& session, const DatagramPtr& datagram, bool datagram_input)
+  {
+    if (!session->is_active())
+    {
+      session->start();
+    }
+    if (datagram_input)
+    {
+      if (!datagram->empty())
+      {
+        session->receive_datagram(&datagram->front(), datagram->size());
+      }
+    }
+    else
+    {
+      session->socket().deliver(datagram);
+    }
+  }
+
+  /**
+   * Once a second, stops and drops, or parks, the sessions whose clients have gone
+   * quiet, and lets go of those parked for longer than their grace.
+   */
+  void sweep()
+  {
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    typename std::map<udp::endpoint, Client>::iterator it = clients_.begin();
+    while (it != clients_.end())
+    {
+      if (now - it->second.last_heard > client_timeout_)
+      {
+        ROS_INFO_STREAM("UDP client at " << it->first << " timed out.");
+        SessionPtr& session = it->second.session;
+        session->strand().post(boost::bind(&UdpServer::retire, session));
+        if (session->reconnect_grace() > 0)
+        {
+          // Any session already parked for the address is let go in favour of this one.
+          Client& parked = parked_[it->first.address()];
+          parked.session = session;
+          parked.last_heard = now + boost::posix_time::microseconds(
+              static_cast<int64_t>(session->reconnect_grace() * 1e6));
+        }
+        clients_.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    typename std::map<boost::asio::ip::address, Client>::iterator parked = parked_.begin();
+    while (parked != parked_.end())
+    {
+      if (now > parked->second.last_heard)
+      {
+        parked_.erase(parked++);
+      }
+      else
+      {
+        ++parked;
+      }
+    }
+
+    if (ros::ok())
+    {
+      sweep_timer_.expires_from_now(boost::posix_time::seconds(1));
+      sweep_timer_.async_wait(strand_.wrap(boost::bind(&UdpServer::sweep, this)));
+    }
+  }
+
+  static void retire(const SessionPtr& session)
+  {
+    if (session->is_active())
+    {
+      session->stop();
+    }
+  }
+
+  // Bounds the time spent receiving before other handlers get a turn.
+  enum { max_batches_per_wakeup = 8 };
+
+  boost::asio::io_service& io_service_;
+  boost::asio::io_service::strand strand_;
+  udp::socket socket_;
+  // Where the sessions' writes wait when the socket is full.
+  SharedWriteWaiter writable_;
+  boost::asio::deadline_timer sweep_timer_;
+  boost::posix_time::time_duration client_timeout_;
+  bool datagram_input_;
+  UdpReceiveBatch batch_;
+  std::map<udp::endpoint, Client> clients_;
+  std::map<boost::asio::ip::address, Client> parked_;
+  boost::function<void(Session&)> session_setup_;
+};
+
+}  // namespace
+
+#endif  // ROSSERIAL_SERVER_UDP_SERVER_H
@@ -35,12 +35,14 @@
 #define ROSSERIAL_SERVER_UDP_SOCKET_SESSION_H
 
 #include <iostream>
+#include <sstream>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
 #include <ros/ros.h>
 
 #include "rosserial_server/session.h"
+#include "rosserial_server/udp_datagrams.h"
 #include "rosserial_server/udp_stream.h"
 
 
@@ -52,13 +54,25 @@ using boost::asio::ip::udp;
 class UdpSocketSession : public Session<UdpStream>
 {
 public:
+  /**
+   * With datagram_input, each datagram from the client is taken to hold whole frames,
+   * and is received in batches and parsed on its own, rather than being read as part
+   * of a stream of bytes.
+   */
   UdpSocketSession(boost::asio::io_service& io_service,
                    udp::endpoint server_endpoint,
-                   udp::endpoint client_endpoint)
+                   udp::endpoint client_endpoint,
+                   bool datagram_input = false)
     : Session(io_service), timer_(io_service),
-      server_endpoint_(server_endpoint), client_endpoint_(client_endpoint)
+      server_endpoint_(server_endpoint), client_endpoint_(client_endpoint),
+      datagram_input_(datagram_input)
   {
     ROS_INFO_STREAM("rosserial_server UDP session created between " << server_endpoint << " and " << client_endpoint);
+    std::ostringstream hardware_id;
+    hardware_id << client_endpoint;
+    set_hardware_id(hardware_id.str());
+    socket().set_strand(strand());
+    set_datagram_input(datagram_input_);
     check_connection();
   }
 
@@ -69,6 +83,10 @@ private:
     {
       socket().open(server_endpoint_, client_endpoint_);
       start();
+      if (datagram_input_)
+      {
+        receive_datagrams();
+      }
     }
 
     // Every second, check again if the connection should be reinitialized,
@@ -76,13 +94,45 @@ private:
     if (ros::ok())
     {
       timer_.expires_from_now(boost::posix_time::milliseconds(2000));
-      timer_.async_wait(boost::bind(&UdpSocketSession::check_connection, this));
+      timer_.async_wait(strand().wrap(boost::bind(&UdpSocketSession::check_connection, this)));
+    }
+  }
+
+  void receive_datagrams()
+  {
+    socket().async_receive(boost::asio::null_buffers(),
+        strand().wrap(boost::bind(&UdpSocketSession::receive_datagrams_cb, this,
+                                  boost::asio::placeholders::error)));
+  }
+
+  void receive_datagrams_cb(const boost::system::error_code& error)
+  {
+    if (error == boost::asio::error::operation_aborted || !is_active())
+    {
+      // The session stopped, and closed the socket; it's reopened by check_connection.
+      return;
+    }
+    boost::system::error_code ec;
+    size_t count = error ? 0 : batch_.receive(socket(), ec);
+    if (error || ec)
+    {
+      ROS_DEBUG_STREAM("UDP receive error: " << (error ? error : ec));
+    }
+    for (size_t i = 0; i < count && is_active(); ++i)
+    {
+      receive_datagram(batch_.data(i), batch_.size(i));
+    }
+    if (is_active())
+    {
+      receive_datagrams();
     }
   }
 
   boost::asio::deadline_timer timer_;
   udp::endpoint server_endpoint_;
   udp::endpoint client_endpoint_;
+  bool datagram_input_;
+  UdpReceiveBatch batch_;
 };
 
 }  // namespace
@@ -42,22 +42,33 @@
 #include <ros/ros.h>
 
 #include "rosserial_server/session.h"
+#include "rosserial_server/udp_datagrams.h"
 
 
 namespace rosserial_server
 {
 
 using boost::asio::ip::udp;
-using boost::asio::handler_type;
 
 
 class UdpStream : public udp::socket
 {
 public:
-  explicit UdpStream(boost::asio::io_service& io_service) : udp::socket(io_service)
+  explicit UdpStream(boost::asio::io_service& io_service)
+    : udp::socket(io_service), io_service_(io_service), datagrams_(io_service), strand_(NULL),
+      receive_pending_(false)
   {
   }
 
+  /**
+   * The strand of the session reading from this stream, which the stream's own
+   * handlers must run on, as they share its queue of received datagrams.
+   */
+  void set_strand(boost::asio::io_service::strand& strand)
+  {
+    strand_ = &strand;
+  }
+
   void open(udp::endpoint server_endpoint, udp::endpoint client_endpoint)
   {
     boost::system::error_code ec;
@@ -70,59 +81,76 @@ public:
     client_endpoint_ = client_endpoint;
   }
 
+  void close()
+  {
+    datagrams_.clear();
+    receive_pending_ = false;
+    udp::socket::close();
+  }
+
+  /**
+   * Each write goes to the client in as few datagrams as send_datagrams() gathers
+   * it into. When the socket's send buffer is full, the write waits asynchronously
+   * for room.
+   */
   template <typename ConstBufferSequence, typename WriteHandler>
-  BOOST_ASIO_INITFN_RESULT_TYPE(WriteHandler,
-      void (boost::system::error_code, std::size_t))
-  async_write_some(const ConstBufferSequence& buffers,
-      BOOST_ASIO_MOVE_ARG(WriteHandler) handler)
+  void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler)
   {
-    // If you get an error on the following line it means that your handler does
-    // not meet the documented type requirements for a WriteHandler.
-    BOOST_ASIO_WRITE_HANDLER_CHECK(WriteHandler, handler) type_check;
-#if (BOOST_VERSION >= 106600)
-    // See: http://www.boost.org/doc/libs/1_66_0/doc/html/boost_asio/net_ts.html
-    boost::asio::async_completion<WriteHandler,
-      void (boost::system::error_code, std::size_t)> init(handler);
-
-    this->get_service().async_send_to(
-        this->get_implementation(), buffers, client_endpoint_, 0,
-        init.completion_handler);
-
-    return init.result.get();
-#else
-    return this->get_service().async_send_to(
-        this->get_implementation(), buffers, client_endpoint_, 0,
-        BOOST_ASIO_MOVE_CAST(WriteHandler)(handler));
-#endif
+    async_send_datagrams(io_service_, *this, *this, client_endpoint_, buffers, handler);
   }
 
+  /**
+   * Reads are served from the datagrams already received, if there are any. If not,
+   * everything waiting on the socket is received in one go once it's readable.
+   */
   template <typename MutableBufferSequence, typename ReadHandler>
-  BOOST_ASIO_INITFN_RESULT_TYPE(ReadHandler,
-      void (boost::system::error_code, std::size_t))
-  async_read_some(const MutableBufferSequence& buffers,
-      BOOST_ASIO_MOVE_ARG(ReadHandler) handler)
+  void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler)
   {
-    // If you get an error on the following line it means that your handler does
-    // not meet the documented type requirements for a ReadHandler.
-    BOOST_ASIO_READ_HANDLER_CHECK(ReadHandler, handler) type_check;
-#if (BOOST_VERSION >= 106600)
-    // See: http://www.boost.org/doc/libs/1_66_0/doc/html/boost_asio/net_ts.html
-    boost::asio::async_completion<ReadHandler,
-      void (boost::system::error_code, std::size_t)> init(handler);
-
-    this->get_service().async_receive(this->get_implementation(),
-        buffers, 0, init.completion_handler);
-
-    return init.result.get();
-#else
-    return this->get_service().async_receive_from(
-        this->get_implementation(), buffers, client_endpoint_, 0,
-        BOOST_ASIO_MOVE_CAST(ReadHandler)(handler));
-#endif
+    datagrams_.async_read_some(buffers, handler);
+    if (datagrams_.empty() && !receive_pending_)
+    {
+      wait_readable();
+    }
   }
 
 private:
+  void wait_readable()
+  {
+    receive_pending_ = true;
+    async_receive(boost::asio::null_buffers(),
+        strand_->wrap(boost::bind(&UdpStream::receive_cb, this, boost::asio::placeholders::error)));
+  }
+
+  void receive_cb(const boost::system::error_code& error)
+  {
+    if (error == boost::asio::error::operation_aborted)
+    {
+      // Closed, which has already aborted the read waiting on the queue.
+      return;
+    }
+    receive_pending_ = false;
+    boost::system::error_code ec;
+    size_t count = error ? 0 : batch_.receive(*this, ec);
+    if (error || ec)
+    {
+      ROS_DEBUG_STREAM("UDP receive error: " << (error ? error : ec));
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+      datagrams_.deliver(batch_.copy(i));
+    }
+    if (datagrams_.empty())
+    {
+      wait_readable();
+    }
+  }
+
+  boost::asio::io_service& io_service_;
   udp::endpoint client_endpoint_;
+  DatagramQueue datagrams_;
+  UdpReceiveBatch batch_;
+  boost::asio::io_service::strand* strand_;
+  bool receive_pending_;
 };
 
 }  // namespace
@@ -0,0 +1,159 @@
+/**
+ *
+ *  \file
+ *  \brief      Nodelets which run the serial and socket servers inside a nodelet
+ *              manager.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include <algorithm>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include "rosserial_server/io_threads.h"
+#include "rosserial_server/serial_session.h"
+#include "rosserial_server/tcp_server.h"
+
+namespace rosserial_server
+{
+
+/**
+ * Runs an io_service for a nodelet's sessions on threads of its own, since
+ * onInit() mustn't block. The sessions publish shared messages, so that the
+ * other nodelets in the same manager get them without a loopback socket.
+ *
+ * The ~port and ~threads parameters, the I/O thread options in io_threads.h,
+ * and the ~require list, are read from the nodelet's private namespace, and the
+ * client's topics go in the nodelet's namespace. The sessions' other parameters
+ * are read from the manager's.
+ */
+class ServerNodelet : public nodelet::Nodelet
+{
+protected:
+  template<typename SessionType>
+  void setup_session(SessionType& session)
+  {
+    session.set_namespace(getNodeHandle().getNamespace());
+    session.set_require_param(getPrivateNodeHandle().resolveName("require"));
+    session.set_shared_publish(true);
+  }
+
+  void run()
+  {
+    int threads;
+    getPrivateNodeHandle().param<int>("threads", threads, 1);
+    IoThreadOptions options = IoThreadOptions::from_params(getPrivateNodeHandle());
+    lock_memory(options);
+    for (int i = 0; i < std::max(threads, 1); ++i)
+    {
+      threads_.create_thread(boost::bind(&run_io_thread, &io_service_, options));
+    }
+  }
+
+  // To be called from each subclass's destructor, so that no handler is still
+  // running when the sessions it belongs to are deleted.
+  void shutdown()
+  {
+    io_service_.stop();
+    threads_.join_all();
+  }
+
+  boost::asio::io_service io_service_;
+
+private:
+  boost::thread_group threads_;
+};
+
+/**
+ * Serves a rosserial client on ~port, at ~baud.
+ */
+class SerialNodelet : public ServerNodelet
+{
+public:
+  virtual ~SerialNodelet()
+  {
+    shutdown();
+  }
+
+private:
+  virtual void onInit()
+  {
+    std::string port;
+    int baud;
+    getPrivateNodeHandle().param<std::string>("port", port, "/dev/ttyACM0");
+    getPrivateNodeHandle().param<int>("baud", baud, 57600);
+
+    // Set up before the port opens, so the setup applies from the first sync.
+    session_.reset(new SerialSession(io_service_, port, baud, getNodeHandle().getNamespace(), false));
+    setup_session(*session_);
+    session_->connect();
+    run();
+  }
+
+  boost::scoped_ptr<SerialSession> session_;
+};
+
+/**
+ * Serves rosserial clients which connect to TCP ~port.
+ */
+class SocketNodelet : public ServerNodelet
+{
+public:
+  virtual ~SocketNodelet()
+  {
+    shutdown();
+  }
+
+private:
+  virtual void onInit()
+  {
+    int port;
+    getPrivateNodeHandle().param<int>("port", port, 11411);
+
+    server_.reset(new TcpServer<>(io_service_, port));
+    server_->set_session_setup(boost::bind(&SocketNodelet::setup_session<Session<tcp::socket> >, this, _1));
+    NODELET_INFO_STREAM("Listening for rosserial TCP connections on port " << port);
+    run();
+  }
+
+  boost::scoped_ptr<TcpServer<> > server_;
+};
+
+}  // namespace
+
+PLUGINLIB_EXPORT_CLASS(rosserial_server::SerialNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(rosserial_server::SocketNodelet, nodelet::Nodelet)
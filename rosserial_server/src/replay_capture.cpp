@@ -0,0 +1,150 @@
+/**
+ *
+ *  \file
+ *  \brief      Plays a link capture back into a session, for benchmarking.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/link_capture.h"
+#include "rosserial_server/session.h"
+
+typedef rosserial_server::Session<boost::asio::local::stream_protocol::socket> LocalSession;
+
+/**
+ * Writes the bytes the client sent, as captured, into the session's end of the
+ * socket pair, at the pace they came in, scaled by speed, or as fast as the
+ * session takes them when speed is zero. Then closes it, which ends the session.
+ */
+static void replay(rosserial_server::LinkCaptureReader& reader, int fd, double speed,
+                   uint64_t& bytes, uint64_t& frames, ros::WallTime& start)
+{
+  const rosserial_server::LinkCapture::Record* record;
+  const uint8_t* data;
+  uint64_t first_stamp = 0;
+  start = ros::WallTime::now();
+  while (reader.next(record, data))
+  {
+    if (record->type == rosserial_server::LinkCapture::IN_FRAME)
+    {
+      frames++;
+    }
+    if (record->type != rosserial_server::LinkCapture::IN_CHUNK)
+    {
+      continue;
+    }
+    if (speed > 0)
+    {
+      if (first_stamp == 0) first_stamp = record->stamp;
+      ros::WallTime due = start + ros::WallDuration((record->stamp - first_stamp) / 1e9 / speed);
+      ros::WallTime now = ros::WallTime::now();
+      if (due > now) (due - now).sleep();
+    }
+    for (uint32_t written = 0; written < record->length; )
+    {
+      // Without SIGPIPE, should the session have closed its end already.
+      ssize_t n = send(fd, data + written, record->length - written, MSG_NOSIGNAL);
+      if (n <= 0)
+      {
+        ROS_WARN("Session stopped taking the capture before its end.");
+        shutdown(fd, SHUT_WR);
+        return;
+      }
+      written += n;
+    }
+    bytes += record->length;
+  }
+  shutdown(fd, SHUT_WR);
+}
+
+/**
+ * Reads and throws away what the session sends, so that its writes never block.
+ */
+static void drain(int fd)
+{
+  char buffer[4096];
+  while (read(fd, buffer, sizeof(buffer)) > 0) {}
+}
+
+int main(int argc, char* argv[])
+{
+  ros::init(argc, argv, "rosserial_server_replay_capture");
+  if (argc < 2)
+  {
+    ROS_FATAL("Usage: replay_capture <capture file> [_speed:=1.0]");
+    return 1;
+  }
+
+  // Every session a capture holds is played into the one session, one after the
+  // other, as a client which restarts would be. A ~speed of 1 plays the capture
+  // back at the pace it was recorded, and 0 as fast as the session can take it.
+  double speed;
+  ros::param::param<double>("~speed", speed, 1.0);
+  rosserial_server::LinkCaptureReader reader;
+  if (!reader.open(argv[1]))
+  {
+    ROS_FATAL_STREAM("Unable to read a link capture from " << argv[1]);
+    return 1;
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+  {
+    ROS_FATAL("Unable to create a socket pair to replay into.");
+    return 1;
+  }
+  boost::asio::io_service io_service;
+  LocalSession session(io_service);
+  session.socket().assign(boost::asio::local::stream_protocol(), fds[0]);
+  session.set_stop_callback(boost::bind(&boost::asio::io_service::stop, &io_service));
+  session.start();
+
+  uint64_t bytes = 0, frames = 0;
+  ros::WallTime start;
+  boost::thread replay_thread(boost::bind(replay, boost::ref(reader), fds[1], speed,
+                                          boost::ref(bytes), boost::ref(frames), boost::ref(start)));
+  boost::thread drain_thread(boost::bind(drain, fds[1]));
+  io_service.run();
+  ros::WallDuration elapsed = ros::WallTime::now() - start;
+  replay_thread.join();
+  shutdown(fds[1], SHUT_RD);
+  drain_thread.join();
+  close(fds[1]);
+
+  ROS_INFO("Replayed %llu bytes in %llu frames in %.3f s: %.0f frames/s, %.0f bytes/s.",
+           (unsigned long long) bytes, (unsigned long long) frames, elapsed.toSec(),
+           frames / elapsed.toSec(), bytes / elapsed.toSec());
+  return 0;
+}
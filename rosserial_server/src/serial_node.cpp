@@ -33,24 +33,84 @@
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <ros/ros.h>
 
+#include "rosserial_server/io_threads.h"
 #include "rosserial_server/serial_session.h"
 
+typedef boost::shared_ptr<rosserial_server::SerialSession> SerialSessionPtr;
+
+/**
+ * Reads the ~ports parameter: a list of ports to serve from this one process,
+ * each of which is a dictionary like
+ *   { port: /dev/ttyACM0, baud: 115200, namespace: left_arm }
+ * where baud defaults to ~baud, and namespace to none.
+ */
+static bool add_sessions(boost::asio::io_service& io_service, XmlRpc::XmlRpcValue& ports, int default_baud,
+                         std::vector<SerialSessionPtr>& sessions)
+{
+  if (ports.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+    ROS_FATAL("The ~ports parameter must be a list.");
+    return false;
+  }
+  for (int i = 0; i < ports.size(); ++i) {
+    XmlRpc::XmlRpcValue& entry = ports[i];
+    if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !entry.hasMember("port") ||
+        entry["port"].getType() != XmlRpc::XmlRpcValue::TypeString) {
+      ROS_FATAL_STREAM("Entry " << i << " of ~ports must be a dictionary with a port name in it.");
+      return false;
+    }
+    std::string port = entry["port"];
+    int baud = default_baud;
+    if (entry.hasMember("baud")) {
+      if (entry["baud"].getType() != XmlRpc::XmlRpcValue::TypeInt) {
+        ROS_FATAL_STREAM("The baud rate for " << port << " in ~ports must be an integer.");
+        return false;
+      }
+      baud = entry["baud"];
+    }
+    std::string ns;
+    if (entry.hasMember("namespace")) {
+      if (entry["namespace"].getType() != XmlRpc::XmlRpcValue::TypeString) {
+        ROS_FATAL_STREAM("The namespace for " << port << " in ~ports must be a string.");
+        return false;
+      }
+      ns = static_cast<std::string>(entry["namespace"]);
+    }
+    sessions.push_back(SerialSessionPtr(new rosserial_server::SerialSession(io_service, port, baud, ns)));
+  }
+  return true;
+}
 
 int main(int argc, char* argv[])
 {
   ros::init(argc, argv, "rosserial_server_serial_node");
 
   std::string port;
-  int baud;
+  int baud, threads;
   ros::param::param<std::string>("~port", port, "/dev/ttyACM0");
   ros::param::param<int>("~baud", baud, 57600);
+  ros::param::param<int>("~threads", threads, 1);
 
+  rosserial_server::IoThreadOptions io_thread_options = rosserial_server::IoThreadOptions::from_params();
   boost::asio::io_service io_service;
-  rosserial_server::SerialSession serial_session(io_service, port, baud);
-  io_service.run();
+  std::vector<SerialSessionPtr> sessions;
+  XmlRpc::XmlRpcValue ports;
+  if (ros::param::get("~ports", ports)) {
+    // Many ports, sharing this node's connection to the master and its message
+    // definitions, and served by a shared pool of threads.
+    if (!add_sessions(io_service, ports, baud, sessions)) {
+      return 1;
+    }
+  } else {
+    sessions.push_back(SerialSessionPtr(new rosserial_server::SerialSession(io_service, port, baud)));
+  }
+
+  // Each session's handlers are serialized on its own strand, so additional threads
+  // let sessions run concurrently without any one of them seeing more than one.
+  rosserial_server::run_io_service(io_service, threads, io_thread_options);
   return 0;
 }
@@ -0,0 +1,63 @@
+/**
+ *
+ *  \file
+ *  \brief      Node which serves rosserial clients on the same host over shared memory.
+ *  \copyright  Copyright (c) 2026, rosserial contributors
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/io_threads.h"
+#include "rosserial_server/shm_server.h"
+
+
+int main(int argc, char* argv[])
+{
+  ros::init(argc, argv, "rosserial_server_shm_node");
+
+  std::string socket_path;
+  int threads;
+  ros::param::param<std::string>("~socket_path", socket_path, "/tmp/rosserial_shm");
+  ros::param::param<int>("~threads", threads, 1);
+
+  rosserial_server::IoThreadOptions io_thread_options = rosserial_server::IoThreadOptions::from_params();
+  boost::asio::io_service io_service;
+  rosserial_server::ShmServer<> shm_server(io_service, socket_path);
+
+  ROS_INFO_STREAM("Listening for rosserial shared memory clients on " << socket_path);
+
+  // As for the socket node, each session keeps to its own strand.
+  rosserial_server::run_io_service(io_service, threads, io_thread_options);
+  return 0;
+}
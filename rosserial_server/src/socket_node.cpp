@@ -37,20 +37,56 @@
 
 #include <ros/ros.h>
 
+#include "rosserial_server/io_threads.h"
+#include "rosserial_server/multicast_topics.h"
+#include "rosserial_server/shared_subscriptions.h"
 #include "rosserial_server/tcp_server.h"
 
+typedef rosserial_server::Session<boost::asio::ip::tcp::socket> TcpSession;
+
+static void setup_session(TcpSession& session, const rosserial_server::MulticastTopicsPtr& multicast,
+                          const rosserial_server::SharedSubscriptionsPtr& shared_subscriptions)
+{
+  if (multicast)
+  {
+    session.set_multicast(multicast);
+  }
+  if (shared_subscriptions)
+  {
+    session.set_shared_subscriptions(shared_subscriptions);
+  }
+}
 
 int main(int argc, char* argv[])
 {
   ros::init(argc, argv, "rosserial_server_socket_node");
 
-  int port;
+  int port, threads;
+  bool share_subscriptions;
   ros::param::param<int>("~port", port, 11411);
+  ros::param::param<int>("~threads", threads, 1);
+  // With many clients taking the same topics, subscribe to each once for all of
+  // them, and serialize each message once, rather than once per client.
+  ros::param::param<bool>("~share_subscriptions", share_subscriptions, false);
 
+  rosserial_server::IoThreadOptions io_thread_options = rosserial_server::IoThreadOptions::from_params();
   boost::asio::io_service io_service;
   rosserial_server::TcpServer<> tcp_server(io_service, port);
 
+  // Topics listed in ~multicast_topics go out once to a multicast group for the
+  // clients which can read from it, rather than once to each.
+  rosserial_server::MulticastTopicsPtr multicast = rosserial_server::MulticastTopics::from_params(io_service);
+  rosserial_server::SharedSubscriptionsPtr shared_subscriptions;
+  if (share_subscriptions)
+  {
+    shared_subscriptions.reset(new rosserial_server::SharedSubscriptions(io_service));
+  }
+  tcp_server.set_session_setup(boost::bind(&setup_session, _1, multicast, shared_subscriptions));
+
   ROS_INFO_STREAM("Listening for rosserial TCP connections on port " << port);
-  io_service.run();
+
+  // Each session's handlers are serialized on its own strand, so additional threads
+  // let sessions run concurrently without any one of them seeing more than one.
+  rosserial_server::run_io_service(io_service, threads, io_thread_options);
   return 0;
 }
@@ -37,6 +37,9 @@
 
 #include <ros/ros.h>
 
+#include "rosserial_server/io_threads.h"
+#include "rosserial_server/multicast_topics.h"
+#include "rosserial_server/udp_server.h"
 #include "rosserial_server/udp_socket_session.h"
 
 using boost::asio::ip::udp;
@@ -50,16 +53,50 @@ int main(int argc, char* argv[])
   int server_port;
   int client_port;
   std::string client_addr;
+  bool multi_client;
+  bool datagram_input;
   ros::param::param<int>("~server_port", server_port, 11411);
   ros::param::param<int>("~client_port", client_port, 11411);
   ros::param::param<std::string>("~client_addr", client_addr, "127.0.0.1");
+  ros::param::param<bool>("~multi_client", multi_client, false);
+  // For clients which only ever send whole frames in each datagram, every datagram
+  // can be parsed on its own, so that one lost or cut short doesn't throw the
+  // session out of sync.
+  ros::param::param<bool>("~datagram_input", datagram_input, false);
 
+  rosserial_server::IoThreadOptions io_thread_options = rosserial_server::IoThreadOptions::from_params();
   boost::asio::io_service io_service;
+  if (multi_client) {
+    // Any number of clients, each getting a session of its own as soon as its
+    // first datagram arrives, and dropped after ~client_timeout seconds of silence.
+    int threads;
+    double client_timeout;
+    ros::param::param<int>("~threads", threads, 1);
+    ros::param::param<double>("~client_timeout", client_timeout, 10.0);
+    rosserial_server::UdpServer<> udp_server(
+        io_service,
+        udp::endpoint(udp::v4(), server_port),
+        boost::posix_time::microseconds(static_cast<int64_t>(client_timeout * 1e6)),
+        datagram_input);
+    // Topics listed in ~multicast_topics go out once to a multicast group for
+    // the clients which can read from it, rather than once to each.
+    rosserial_server::MulticastTopicsPtr multicast = rosserial_server::MulticastTopics::from_params(io_service);
+    if (multicast) {
+      udp_server.set_session_setup(boost::bind(&rosserial_server::Session<rosserial_server::UdpEndpointStream>::set_multicast,
+                                               _1, multicast));
+    }
+    ROS_INFO_STREAM("Listening for rosserial UDP clients on port " << server_port);
+
+    rosserial_server::run_io_service(io_service, threads, io_thread_options);
+    return 0;
+  }
+
   rosserial_server::UdpSocketSession udp_socket_session(
       io_service,
       udp::endpoint(udp::v4(), server_port),
-      udp::endpoint(address::from_string(client_addr), client_port));
-  io_service.run();
+      udp::endpoint(address::from_string(client_addr), client_port),
+      datagram_input);
+  rosserial_server::run_io_service(io_service, 1, io_thread_options);
 
   return 0;
 }
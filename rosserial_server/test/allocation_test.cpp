@@ -0,0 +1,205 @@
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <gtest/gtest.h>
+
+#include "rosserial_server/async_read_buffer.h"
+#include "rosserial_server/buffer_pool.h"
+#include "rosserial_server/handler_allocator.h"
+
+/**
+ * Counts the heap allocations made while counting is switched on, so that the
+ * steady state of the hot path can be checked for them frame by frame.
+ */
+static bool counting = false;
+static size_t allocations = 0;
+
+void* operator new(std::size_t size)
+{
+  if (counting) allocations++;
+  void* pointer = std::malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void* pointer) throw()
+{
+  std::free(pointer);
+}
+
+class AllocationCounter
+{
+public:
+  AllocationCounter() { allocations = 0; counting = true; }
+  ~AllocationCounter() { counting = false; }
+  size_t count() const { return allocations; }
+};
+
+using rosserial_server::FrameParser;
+typedef boost::asio::local::stream_protocol::socket Socket;
+
+/**
+ * Reads frames continuously, the way a Session does.
+ */
+class FrameReader
+{
+public:
+  FrameReader(Socket& socket, boost::asio::io_service::strand& strand)
+    : buffer(socket, strand, 1024, boost::bind(&FrameReader::failed, this, _1)), frames(0), failures(0)
+  {
+  }
+
+  void read()
+  {
+    buffer.read_frames(boost::bind(&FrameReader::frames_cb, this, _1));
+  }
+
+  void frames_cb(std::vector<rosserial_server::Frame>& received)
+  {
+    frames += received.size();
+    read();
+  }
+
+  void failed(const boost::system::error_code&)
+  {
+    failures++;
+  }
+
+  rosserial_server::AsyncReadBuffer<Socket> buffer;
+  size_t frames;
+  size_t failures;
+};
+
+static std::vector<uint8_t> make_frame(uint16_t topic_id, size_t length)
+{
+  std::vector<uint8_t> frame(FrameParser::overhead_bytes + length, 0x55);
+  frame[0] = 0xff;
+  frame[1] = FrameParser::protocol_ver2;
+  frame[2] = length & 0xff;
+  frame[3] = length >> 8;
+  frame[4] = 255 - FrameParser::checksum(static_cast<uint16_t>(length));
+  frame[5] = topic_id & 0xff;
+  frame[6] = topic_id >> 8;
+  frame.back() = 255 - static_cast<uint8_t>(FrameParser::checksum(&frame[5], length + 2));
+  return frame;
+}
+
+class AllocationTest : public ::testing::Test
+{
+protected:
+  AllocationTest() : strand(io_service), client(io_service), server(io_service), reader(server, strand)
+  {
+    boost::asio::local::connect_pair(client, server);
+  }
+
+  // The reader's read is still pending, with its handler in the reader's
+  // HandlerMemory, so finish it while the reader is still there.
+  virtual void TearDown()
+  {
+    client.close();
+    server.close();
+    io_service.reset();
+    io_service.poll();
+  }
+
+  // Writes count frames from the client end, each read by the server end before
+  // the next is written.
+  void send_frames(const std::vector<uint8_t>& frame, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      boost::asio::write(client, boost::asio::buffer(frame));
+      size_t target = reader.frames + 1;
+      while (reader.frames < target && reader.failures == 0)
+      {
+        io_service.run_one();
+      }
+    }
+  }
+
+  boost::asio::io_service io_service;
+  boost::asio::io_service::strand strand;
+  Socket client;
+  Socket server;
+  FrameReader reader;
+};
+
+TEST_F(AllocationTest, read_path_allocates_nothing_per_frame)
+{
+  reader.read();
+  std::vector<uint8_t> frame = make_frame(125, 32);
+
+  // The first frames grow the reader's list of frames and asio's own state.
+  send_frames(frame, 100);
+
+  AllocationCounter counter;
+  send_frames(frame, 1000);
+  EXPECT_EQ(0u, counter.count()) << "Heap allocations while reading 1000 frames.";
+  EXPECT_EQ(0u, reader.failures);
+}
+
+TEST_F(AllocationTest, waiting_bytes_are_read_inline)
+{
+  std::vector<uint8_t> frame = make_frame(125, 32);
+  boost::asio::write(client, boost::asio::buffer(frame));
+
+  // The frame is already waiting, so the only handler to run is the posted frames callback.
+  reader.read();
+  io_service.poll_one();
+  EXPECT_EQ(1u, reader.frames);
+
+  // With nothing waiting, reading falls back to the reactor.
+  EXPECT_EQ(0u, io_service.poll());
+  boost::asio::write(client, boost::asio::buffer(frame));
+  while (reader.frames < 2 && reader.failures == 0)
+  {
+    io_service.run_one();
+  }
+  EXPECT_EQ(2u, reader.frames);
+  EXPECT_EQ(0u, reader.failures);
+}
+
+static void count_call(size_t* calls)
+{
+  (*calls)++;
+}
+
+TEST_F(AllocationTest, posted_handlers_use_their_handler_memory)
+{
+  rosserial_server::HandlerMemory memory;
+  size_t calls = 0;
+  AllocationCounter counter;
+  for (int i = 0; i < 1000; ++i)
+  {
+    strand.post(rosserial_server::make_custom_alloc_handler(memory, boost::bind(&count_call, &calls)));
+    io_service.poll();
+    io_service.reset();
+  }
+  EXPECT_EQ(1000u, calls);
+  EXPECT_EQ(0u, counter.count());
+  EXPECT_EQ(0u, memory.misses());
+}
+
+TEST_F(AllocationTest, buffer_pool_recycles_frames)
+{
+  rosserial_server::BufferPool pool;
+  pool.reserve(64);
+  pool.release(pool.acquire(64));
+
+  AllocationCounter counter;
+  for (int i = 0; i < 1000; ++i)
+  {
+    rosserial_server::BufferPtr buffer_ptr = pool.acquire(16 + i % 48);
+    pool.release(buffer_ptr);
+  }
+  EXPECT_EQ(0u, counter.count());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_server/delta_decoder.h"
+
+using rosserial_server::DeltaDecoder;
+
+/**
+ * Decodes a delta, given as the client's DeltaEncoder writes it, against a keyframe,
+ * to a message of the given length, or to "!" if it doesn't decode.
+ */
+static std::string decode(const std::string& keyframe, const std::vector<uint8_t>& delta, size_t length)
+{
+  std::vector<uint8_t> out(length);
+  if (!DeltaDecoder::decode(reinterpret_cast<const uint8_t*>(keyframe.data()), keyframe.size(),
+                            delta.data(), delta.size(), out.data(), out.size()))
+  {
+    return "!";
+  }
+  return std::string(out.begin(), out.end());
+}
+
+static std::vector<uint8_t> bytes(const char* text, size_t length)
+{
+  return std::vector<uint8_t>(text, text + length);
+}
+
+TEST(DeltaDecoderTest, same_as_keyframe)
+{
+  EXPECT_EQ("ABCDEFGH", decode("ABCDEFGH", std::vector<uint8_t>(), 8));
+}
+
+TEST(DeltaDecoderTest, runs_which_differ)
+{
+  // Two the same, one which differs, then four the same and the rest past the keyframe.
+  EXPECT_EQ("ABXDEFGHIJ", decode("ABCDEFGH", bytes("\x02\x01X\x05\x02IJ", 7), 10));
+  // Bytes after the last run are the keyframe's.
+  EXPECT_EQ("XBCDEFGH", decode("ABCDEFGH", bytes("\x00\x01X", 3), 8));
+  // A message may be shorter than its keyframe.
+  EXPECT_EQ("ABXD", decode("ABCDEFGH", bytes("\x02\x01X", 3), 4));
+}
+
+TEST(DeltaDecoderTest, long_runs)
+{
+  // Runs are at most 255, so longer ones are split, with empty runs between.
+  std::string keyframe(600, 'a');
+  std::string message = keyframe;
+  message[550] = 'b';
+  std::vector<uint8_t> delta = bytes("\xff\x00\xff\x00\x28\x01" "b", 7);
+  EXPECT_EQ(message, decode(keyframe, delta, message.size()));
+}
+
+TEST(DeltaDecoderTest, damaged)
+{
+  // A count without its partner.
+  EXPECT_EQ("!", decode("ABCDEFGH", bytes("\x02", 1), 8));
+  // More the same than the keyframe has.
+  EXPECT_EQ("!", decode("ABCD", bytes("\x05\x00", 2), 5));
+  // Fewer bytes which differ than counted.
+  EXPECT_EQ("!", decode("ABCDEFGH", bytes("\x02\x03XY", 4), 8));
+  // More than the message's length.
+  EXPECT_EQ("!", decode("ABCDEFGH", bytes("\x02\x03XYZ", 5), 4));
+  // A message longer than the runs and keyframe together.
+  EXPECT_EQ("!", decode("ABCD", bytes("\x02\x01X", 3), 6));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+
+#include "rosserial_server/dispatch_pipeline.h"
+
+/**
+ * Stands in for a Publisher, noting the messages it is handed and the thread
+ * they're handed over on.
+ */
+class Recorder
+{
+public:
+  Recorder() : overruns(0) {}
+
+  void handle(ros::serialization::IStream stream)
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    thread = boost::this_thread::get_id();
+    if (stream.getLength() == 0)
+    {
+      overruns++;
+      throw ros::serialization::StreamOverrunException("empty");
+    }
+    messages.push_back(std::vector<uint8_t>(stream.getData(), stream.getData() + stream.getLength()));
+  }
+
+  boost::mutex mutex;
+  boost::thread::id thread;
+  std::vector<std::vector<uint8_t> > messages;
+  int overruns;
+};
+
+typedef rosserial_server::DispatchPipeline<Recorder> Pipeline;
+
+TEST(DispatchPipeline, messages_are_handled_in_order_on_another_thread)
+{
+  boost::shared_ptr<Recorder> a(new Recorder), b(new Recorder);
+  {
+    // Fewer slots than messages, so that pushing has to wait on the thread.
+    Pipeline pipeline(4);
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+      uint8_t data[4] = { static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 0, 0 };
+      pipeline.push(i % 3 ? a : b, data, 2 + i % 3);
+    }
+  }
+
+  EXPECT_NE(boost::this_thread::get_id(), a->thread);
+  ASSERT_EQ(666u, a->messages.size());
+  ASSERT_EQ(334u, b->messages.size());
+  size_t next_a = 0, next_b = 0;
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    const std::vector<uint8_t>& message = i % 3 ? a->messages[next_a++] : b->messages[next_b++];
+    ASSERT_EQ(2 + i % 3, message.size());
+    EXPECT_EQ(i & 0xff, message[0]);
+    EXPECT_EQ(i >> 8, message[1]);
+  }
+}
+
+TEST(DispatchPipeline, overrun_message_is_dropped)
+{
+  boost::shared_ptr<Recorder> recorder(new Recorder);
+  {
+    Pipeline pipeline(8);
+    uint8_t data[1] = { 7 };
+    pipeline.push(recorder, data, 0);
+    pipeline.push(recorder, data, 1);
+  }
+  EXPECT_EQ(1, recorder->overruns);
+  ASSERT_EQ(1u, recorder->messages.size());
+  EXPECT_EQ(7, recorder->messages[0][0]);
+}
+
+TEST(DispatchPipeline, targets_are_let_go_once_handled)
+{
+  boost::shared_ptr<Recorder> recorder(new Recorder);
+  Pipeline pipeline(8);
+  uint8_t data[1] = { 1 };
+  pipeline.push(recorder, data, 1);
+  while (pipeline.pending() > 0)
+  {
+    boost::this_thread::yield();
+  }
+  EXPECT_TRUE(recorder.unique());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
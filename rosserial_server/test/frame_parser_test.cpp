@@ -0,0 +1,230 @@
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <gtest/gtest.h>
+
+#include "rosserial_server/async_read_buffer.h"
+#include "rosserial_server/frame_parser.h"
+
+using rosserial_server::Frame;
+using rosserial_server::FrameParser;
+typedef boost::asio::local::stream_protocol::socket Socket;
+
+/**
+ * A frame as a client lays it out, with an 8-bit checksum or a CRC-16, and COBS
+ * encoded if asked.
+ */
+static std::vector<uint8_t> make_frame(uint16_t topic_id, const std::vector<uint8_t>& body, bool crc16, bool cobs)
+{
+  std::vector<uint8_t> frame;
+  frame.push_back(0xff);
+  frame.push_back(crc16 ? FrameParser::protocol_ver2_crc16 : FrameParser::protocol_ver2);
+  frame.push_back(body.size() & 0xff);
+  frame.push_back(body.size() >> 8);
+  frame.push_back(0xff - FrameParser::checksum(static_cast<uint16_t>(body.size())));
+  frame.push_back(topic_id & 0xff);
+  frame.push_back(topic_id >> 8);
+  frame.insert(frame.end(), body.begin(), body.end());
+  if (crc16)
+  {
+    uint16_t crc = FrameParser::crc16(&frame[5], 2 + body.size());
+    frame.push_back(crc & 0xff);
+    frame.push_back(crc >> 8);
+  }
+  else
+  {
+    frame.push_back(0xff - FrameParser::checksum(&frame[5], 2 + body.size()));
+  }
+  if (!cobs)
+  {
+    return frame;
+  }
+  std::vector<uint8_t> encoded(FrameParser::max_cobs_bytes(frame.size()));
+  encoded.resize(FrameParser::cobs_encode(frame.data(), frame.size(), encoded.data()));
+  return encoded;
+}
+
+static std::vector<uint8_t> counting_bytes(size_t length, int zero_every)
+{
+  std::vector<uint8_t> data(length);
+  for (size_t i = 0; i < length; i++)
+  {
+    data[i] = (zero_every && i % zero_every == 0) ? 0 : 1 + i % 255;
+  }
+  return data;
+}
+
+TEST(FrameParserTest, checksum_matches_byte_sum)
+{
+  std::vector<uint8_t> data = counting_bytes(2000, 0);
+  for (size_t length = 0; length < data.size(); length += 7)
+  {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum += data[i];
+    EXPECT_EQ(sum, FrameParser::checksum(data.data(), length)) << "Length " << length;
+  }
+}
+
+TEST(FrameParserTest, crc16_check_value)
+{
+  const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+  EXPECT_EQ(0x29b1, FrameParser::crc16(check, sizeof(check)));
+  // Continuing from a partial CRC gives the same as all at once.
+  EXPECT_EQ(0x29b1, FrameParser::crc16(check + 4, 5, FrameParser::crc16(check, 4)));
+}
+
+TEST(FrameParserTest, find_sync)
+{
+  const uint8_t data[] = { 1, 0xff, 0xfc, 2, 0xff, 0xfd, 3, 0xff };
+  const uint8_t* end = data + sizeof(data);
+  uint64_t mismatches = 0;
+  EXPECT_EQ(data + 4, FrameParser::find_sync(data, end, &mismatches));
+  EXPECT_EQ(1u, mismatches);
+  // A 0xff at the end may be the start of a frame still arriving.
+  EXPECT_EQ(data + 7, FrameParser::find_sync(data + 5, end));
+  // With no 0xff at all, the end.
+  EXPECT_EQ(data + 7, FrameParser::find_sync(data + 5, data + 7));
+
+  const uint8_t cobs[] = { 1, 2, 0, 0xff, 0xfe };
+  EXPECT_EQ(cobs + 2, FrameParser::find_sync(cobs, cobs + sizeof(cobs)));
+}
+
+TEST(FrameParserTest, parse_header)
+{
+  std::vector<uint8_t> frame = make_frame(0x1234, counting_bytes(300, 0), false, false);
+  uint16_t length, topic_id;
+  ASSERT_TRUE(FrameParser::parse_header(frame.data(), length, topic_id));
+  EXPECT_EQ(300, length);
+  EXPECT_EQ(0x1234, topic_id);
+  EXPECT_FALSE(FrameParser::has_crc16(frame.data()));
+  EXPECT_EQ(static_cast<size_t>(FrameParser::overhead_bytes), FrameParser::frame_overhead(frame.data()));
+
+  frame[4]++;
+  EXPECT_FALSE(FrameParser::parse_header(frame.data(), length, topic_id));
+
+  frame = make_frame(7, counting_bytes(3, 0), true, false);
+  EXPECT_TRUE(FrameParser::has_crc16(frame.data()));
+  EXPECT_EQ(static_cast<size_t>(FrameParser::crc16_overhead_bytes), FrameParser::frame_overhead(frame.data()));
+}
+
+TEST(FrameParserTest, cobs_round_trip)
+{
+  // Runs either side of the 254 bytes a block holds, with and without zeros.
+  const size_t lengths[] = { 0, 1, 253, 254, 255, 508, 509, 1000 };
+  const int zero_every[] = { 0, 1, 3, 254, 255 };
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+  {
+    for (size_t z = 0; z < sizeof(zero_every) / sizeof(zero_every[0]); z++)
+    {
+      std::vector<uint8_t> data = counting_bytes(lengths[l], zero_every[z]);
+      std::vector<uint8_t> encoded(FrameParser::max_cobs_bytes(data.size()));
+      size_t encoded_length = FrameParser::cobs_encode(data.data(), data.size(), encoded.data());
+      ASSERT_LE(encoded_length, encoded.size());
+      EXPECT_EQ(0, encoded[0]);
+      EXPECT_EQ(0, encoded[encoded_length - 1]);
+      EXPECT_EQ(NULL, memchr(&encoded[1], 0, encoded_length - 2));
+
+      int decoded = FrameParser::cobs_decode(&encoded[1], encoded_length - 2);
+      ASSERT_EQ(static_cast<int>(data.size()), decoded)
+          << "Length " << lengths[l] << ", zero every " << zero_every[z];
+      EXPECT_TRUE(std::equal(data.begin(), data.end(), encoded.begin() + 1));
+    }
+  }
+}
+
+TEST(FrameParserTest, cobs_damaged)
+{
+  uint8_t overrun[] = { 5, 1, 2 };
+  EXPECT_EQ(-1, FrameParser::cobs_decode(overrun, sizeof(overrun)));
+
+  std::vector<uint8_t> frame = make_frame(100, counting_bytes(10, 0), false, true);
+  EXPECT_TRUE(FrameParser::may_be_cobs(&frame[1]));
+  std::vector<uint8_t> plain = make_frame(100, counting_bytes(10, 0), false, false);
+  EXPECT_FALSE(FrameParser::may_be_cobs(plain.data()));
+}
+
+/**
+ * Reads frames off a socket the way a Session does, keeping a copy of each.
+ */
+class FrameCollector
+{
+public:
+  FrameCollector(Socket& socket, boost::asio::io_service::strand& strand)
+    : buffer(socket, strand, 1024, boost::bind(&FrameCollector::failed, this, _1)), failures(0)
+  {
+  }
+
+  void read()
+  {
+    buffer.read_frames(boost::bind(&FrameCollector::frames_cb, this, _1));
+  }
+
+  void frames_cb(std::vector<Frame>& received)
+  {
+    for (size_t i = 0; i < received.size(); i++)
+    {
+      frames.push_back(received[i]);
+      bodies.push_back(std::vector<uint8_t>(received[i].data, received[i].data + received[i].length));
+    }
+    read();
+  }
+
+  void failed(const boost::system::error_code&)
+  {
+    failures++;
+  }
+
+  rosserial_server::AsyncReadBuffer<Socket> buffer;
+  std::vector<Frame> frames;
+  std::vector<std::vector<uint8_t> > bodies;
+  int failures;
+};
+
+TEST(FrameParserTest, mixed_frames_round_trip)
+{
+  boost::asio::io_service io_service;
+  boost::asio::io_service::strand strand(io_service);
+  Socket client(io_service), server(io_service);
+  boost::asio::local::connect_pair(client, server);
+
+  // Every combination of checksum and encoding, with noise between two of them.
+  std::vector<uint8_t> wire;
+  for (int i = 0; i < 4; i++)
+  {
+    std::vector<uint8_t> frame = make_frame(100 + i, counting_bytes(20 + i, i + 1), i & 1, i & 2);
+    wire.insert(wire.end(), frame.begin(), frame.end());
+    if (i == 1)
+    {
+      const uint8_t noise[] = { 0x12, 0xff, 0x00, 0x34 };
+      wire.insert(wire.end(), noise, noise + sizeof(noise));
+    }
+  }
+  boost::asio::write(client, boost::asio::buffer(wire));
+  client.close();
+
+  FrameCollector collector(server, strand);
+  collector.read();
+  io_service.run();
+
+  ASSERT_EQ(4u, collector.frames.size());
+  for (int i = 0; i < 4; i++)
+  {
+    const Frame& frame = collector.frames[i];
+    const std::vector<uint8_t>& body = collector.bodies[i];
+    EXPECT_EQ(100 + i, frame.topic_id);
+    EXPECT_EQ(static_cast<bool>(i & 1), frame.crc16);
+    EXPECT_EQ(static_cast<bool>(i & 2), frame.cobs);
+    // The body is handed on with its checksum or CRC still after it.
+    std::vector<uint8_t> expected = counting_bytes(20 + i, i + 1);
+    ASSERT_EQ(expected.size() + (frame.crc16 ? 2 : 1), body.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), body.begin()));
+  }
+  EXPECT_EQ(1, collector.failures);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
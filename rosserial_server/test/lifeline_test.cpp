@@ -0,0 +1,103 @@
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "rosserial_server/async_read_buffer.h"
+#include "rosserial_server/lifeline.h"
+
+typedef boost::asio::local::stream_protocol::socket Socket;
+
+/**
+ * Reads from a socket the way a session owned by a server does, holding itself
+ * through its lifeline for as long as a read is outstanding.
+ */
+class OwnedReader
+{
+public:
+  OwnedReader(boost::asio::io_service& io_service, bool& destroyed)
+    : socket(io_service), strand(io_service),
+      buffer(socket, strand, 1024, boost::bind(&OwnedReader::failed, this, _1)),
+      destroyed_(destroyed), failures(0)
+  {
+    buffer.set_lifeline(&lifeline);
+  }
+
+  ~OwnedReader()
+  {
+    destroyed_ = true;
+  }
+
+  void read()
+  {
+    buffer.read_frames(boost::bind(&OwnedReader::frames_cb, this, _1));
+  }
+
+  void frames_cb(std::vector<rosserial_server::Frame>&)
+  {
+    read();
+  }
+
+  void failed(const boost::system::error_code&)
+  {
+    failures++;
+  }
+
+  Socket socket;
+  boost::asio::io_service::strand strand;
+  rosserial_server::Lifeline lifeline;
+  rosserial_server::AsyncReadBuffer<Socket> buffer;
+  bool& destroyed_;
+  int failures;
+};
+
+TEST(LifelineTest, unowned_holds_nothing)
+{
+  rosserial_server::Lifeline lifeline;
+  boost::shared_ptr<void> guard(new int(0));
+  EXPECT_TRUE(lifeline.hold(guard));
+  EXPECT_FALSE(guard);
+}
+
+TEST(LifelineTest, hold_fails_once_owner_is_gone)
+{
+  rosserial_server::Lifeline lifeline;
+  boost::shared_ptr<int> owner(new int(0));
+  lifeline.attach(owner);
+
+  boost::shared_ptr<void> guard;
+  EXPECT_TRUE(lifeline.hold(guard));
+  EXPECT_EQ(owner.get(), guard.get());
+  guard.reset();
+
+  owner.reset();
+  EXPECT_FALSE(lifeline.hold(guard));
+  EXPECT_FALSE(guard);
+}
+
+TEST(LifelineTest, pending_read_keeps_owner_until_called_back)
+{
+  boost::asio::io_service io_service;
+  Socket client(io_service);
+  bool destroyed = false;
+  boost::shared_ptr<OwnedReader> reader(new OwnedReader(io_service, destroyed));
+  reader->lifeline.attach(reader);
+  boost::asio::local::connect_pair(client, reader->socket);
+
+  reader->read();
+  reader.reset();
+  io_service.poll();
+  EXPECT_FALSE(destroyed) << "Deleted with a read outstanding.";
+
+  // The client going away completes the read, which is the last to let go.
+  client.close();
+  io_service.run();
+  EXPECT_TRUE(destroyed);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_server/lz4_decoder.h"
+
+using rosserial_server::Lz4Decoder;
+
+/**
+ * Decompresses an LZ4 block to the given length, or to "!" if it doesn't.
+ */
+static std::string decompress(const std::vector<uint8_t>& block, size_t length)
+{
+  std::vector<uint8_t> out(length);
+  if (!Lz4Decoder::decompress(block.data(), block.size(), out.data(), out.size()))
+  {
+    return "!";
+  }
+  return std::string(out.begin(), out.end());
+}
+
+static std::vector<uint8_t> bytes(const char* text, size_t length)
+{
+  return std::vector<uint8_t>(text, text + length);
+}
+
+TEST(Lz4DecoderTest, literals_only)
+{
+  EXPECT_EQ("hello", decompress(bytes("\x50hello", 6), 5));
+  EXPECT_EQ("", decompress(bytes("\x00", 1), 0));
+}
+
+TEST(Lz4DecoderTest, matches)
+{
+  // Three literals, then nine bytes from three back, which overlap those they make.
+  EXPECT_EQ("abcabcabcabc", decompress(bytes("\x35" "abc\x03\x00\x00", 7), 12));
+  // A match from one back repeats the byte before it.
+  EXPECT_EQ("aaaaaaaaaaa", decompress(bytes("\x16" "a\x01\x00\x00", 5), 11));
+  // Literals after a match.
+  EXPECT_EQ("abababxyz", decompress(bytes("\x20" "ab\x02\x00\x30xyz", 9), 9));
+}
+
+TEST(Lz4DecoderTest, long_lengths)
+{
+  // 15 in the token, then bytes to add to it, ending with one under 255.
+  std::vector<uint8_t> block = bytes("\xf0\xff\x1e", 3);
+  std::string literals(300, 'q');
+  block.insert(block.end(), literals.begin(), literals.end());
+  EXPECT_EQ(literals, decompress(block, 300));
+
+  // A match of 4 + 15 + 255 + 1.
+  EXPECT_EQ(std::string(276, 'x'), decompress(bytes("\x1f" "x\x01\x00\xff\x01\x00", 7), 276));
+}
+
+TEST(Lz4DecoderTest, damaged)
+{
+  // Fewer literals than the token says.
+  EXPECT_EQ("!", decompress(bytes("\x50hell", 5), 5));
+  // A length which runs off the end.
+  EXPECT_EQ("!", decompress(bytes("\xf0\xff", 2), 300));
+  // An offset cut short, of zero, and from before the start.
+  EXPECT_EQ("!", decompress(bytes("\x10" "a\x01", 3), 5));
+  EXPECT_EQ("!", decompress(bytes("\x10" "a\x00\x00\x00", 5), 5));
+  EXPECT_EQ("!", decompress(bytes("\x10" "a\x02\x00\x00", 5), 5));
+  // More or less than the length expected.
+  EXPECT_EQ("!", decompress(bytes("\x50hello", 6), 4));
+  EXPECT_EQ("!", decompress(bytes("\x50hello", 6), 6));
+  EXPECT_EQ("!", decompress(bytes("\x16" "a\x01\x00\x00", 5), 8));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,54 @@
+#include <string>
+
+#include <gtest/gtest.h>
+#include <ros/message_traits.h>
+#include <sensor_msgs/Imu.h>
+
+#include "rosserial_server/message_definitions.h"
+
+using rosserial_server::MessageDefinitions;
+
+TEST(MessageDefinitionsTest, header)
+{
+  std::string md5sum, definition;
+  ASSERT_TRUE(MessageDefinitions::instance().lookup_message("std_msgs/Header", md5sum, definition));
+  EXPECT_EQ("2176decaecbce78abc3b96ef049fabed", md5sum);
+}
+
+TEST(MessageDefinitionsTest, imu_with_full_text)
+{
+  std::string md5sum, definition;
+  ASSERT_TRUE(MessageDefinitions::instance().lookup_message("sensor_msgs/Imu", md5sum, definition));
+  EXPECT_EQ("6a62c6daae103f4ff57a132d6f95cec2", md5sum);
+  // Nested types, and Header from another package, in the order genmsg gives them.
+  EXPECT_EQ(ros::message_traits::Definition<sensor_msgs::Imu>::value(), definition);
+}
+
+TEST(MessageDefinitionsTest, nav_sat_status_with_constants)
+{
+  std::string md5sum, definition;
+  ASSERT_TRUE(MessageDefinitions::instance().lookup_message("sensor_msgs/NavSatStatus", md5sum, definition));
+  EXPECT_EQ("331cdbddfa4bc96ffc3b9ad98900a54c", md5sum);
+}
+
+TEST(MessageDefinitionsTest, set_bool_service)
+{
+  MessageDefinitions::ServiceInfo info;
+  ASSERT_TRUE(MessageDefinitions::instance().lookup_service("std_srvs/SetBool", info));
+  EXPECT_EQ("09fb03525b03e7ea1fd3992bafd87e16", info.service_md5);
+  EXPECT_EQ("8b94c1b53db61fb6aed406028ad6332a", info.request_md5);
+  EXPECT_EQ("937c9679a518e3a18d831e57125ea522", info.response_md5);
+}
+
+TEST(MessageDefinitionsTest, unknown_type)
+{
+  std::string md5sum, definition;
+  EXPECT_FALSE(MessageDefinitions::instance().lookup_message("std_msgs/NoSuchType", md5sum, definition));
+  EXPECT_FALSE(MessageDefinitions::instance().lookup_message("NoPackage", md5sum, definition));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
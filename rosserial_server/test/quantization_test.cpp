@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+
+#include "rosserial_server/quantization.h"
+
+using rosserial_server::Quantization;
+using rosserial_server::QuantizedLayout;
+using rosserial_server::QuantizedLayoutPtr;
+
+// A type made of others, one of which has quantized fields, in full as gendeps gives it.
+static const char* pack_definition =
+    "Header header\n"
+    "Battery[2] batteries\n"
+    "float32 temperature\n"
+    "================================================================================\n"
+    "MSG: std_msgs/Header\n"
+    "uint32 seq\n"
+    "time stamp\n"
+    "string frame_id\n"
+    "================================================================================\n"
+    "MSG: test_msgs/Battery\n"
+    "uint8 CHARGING=1  # constants take no space\n"
+    "float32 voltage\n"
+    "float64[] cells\n"
+    "string name\n";
+
+/**
+ * Appends fields to a message in the standard serialization.
+ */
+class Writer
+{
+public:
+  template <typename T>
+  Writer& put(T value)
+  {
+    uint8_t raw[sizeof(T)];
+    memcpy(raw, &value, sizeof(T));
+    bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    return *this;
+  }
+
+  Writer& put(const std::string& value)
+  {
+    put<uint32_t>(value.size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    return *this;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+class QuantizationTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    // Scales which are powers of two, so that the values below survive exactly.
+    XmlRpc::XmlRpcValue fields;
+    fields["test_msgs/Battery"]["voltage"]["scale"] = 0.25;
+    fields["test_msgs/Battery"]["voltage"]["bits"] = 16;
+    fields["test_msgs"]["Battery"]["cells"]["scale"] = 0.5;
+    fields["test_msgs"]["Battery"]["cells"]["bits"] = 8;
+    fields["test_msgs"]["Battery"]["cells"]["offset"] = 3;
+    ASSERT_TRUE(quantization.load(fields));
+  }
+
+  static std::vector<uint8_t> standard_pack()
+  {
+    Writer message;
+    message.put<uint32_t>(7).put<uint32_t>(100).put<uint32_t>(200).put(std::string("base"));
+    message.put(12.5f).put<uint32_t>(2).put(3.5).put(5.0).put(std::string("left"));
+    message.put(-4.0f).put<uint32_t>(0).put(std::string(""));
+    message.put(21.75f);
+    return message.bytes;
+  }
+
+  Quantization quantization;
+};
+
+TEST_F(QuantizationTest, pack_and_expand)
+{
+  QuantizedLayoutPtr layout = quantization.layout("test_msgs/Pack", pack_definition);
+  ASSERT_TRUE(layout);
+
+  std::vector<uint8_t> standard = standard_pack();
+  std::vector<uint8_t> packed;
+  ASSERT_TRUE(layout->pack(standard.data(), standard.size(), packed));
+  // Each voltage takes two bytes rather than four, and each cell one rather than eight.
+  EXPECT_EQ(standard.size() - 2 * 2 - 2 * 7, packed.size());
+
+  Writer expected;
+  expected.put<uint32_t>(7).put<uint32_t>(100).put<uint32_t>(200).put(std::string("base"));
+  expected.put<int16_t>(50).put<uint32_t>(2).put<int8_t>(1).put<int8_t>(4).put(std::string("left"));
+  expected.put<int16_t>(-16).put<uint32_t>(0).put(std::string(""));
+  expected.put(21.75f);
+  EXPECT_EQ(expected.bytes, packed);
+
+  std::vector<uint8_t> expanded;
+  ASSERT_TRUE(layout->expand(packed.data(), packed.size(), expanded));
+  EXPECT_EQ(standard, expanded);
+}
+
+TEST_F(QuantizationTest, damaged)
+{
+  QuantizedLayoutPtr layout = quantization.layout("test_msgs/Pack", pack_definition);
+  ASSERT_TRUE(layout);
+  std::vector<uint8_t> standard = standard_pack();
+  std::vector<uint8_t> packed;
+  ASSERT_TRUE(layout->pack(standard.data(), standard.size(), packed));
+
+  std::vector<uint8_t> out;
+  // Cut short, and with bytes left over.
+  EXPECT_FALSE(layout->expand(packed.data(), packed.size() - 1, out));
+  packed.push_back(0);
+  EXPECT_FALSE(layout->expand(packed.data(), packed.size(), out));
+}
+
+TEST_F(QuantizationTest, no_layout)
+{
+  // Nothing of the type is quantized.
+  EXPECT_FALSE(quantization.layout("std_msgs/Header", "uint32 seq\ntime stamp\nstring frame_id\n"));
+  // A type it's made of is missing from the definition.
+  EXPECT_FALSE(quantization.layout("test_msgs/Pack", "Header header\nBattery[2] batteries\n"));
+}
+
+TEST(QuantizedLayoutTest, quantize)
+{
+  QuantizedLayout::Quantized q = { 0.1, 0, 1 };
+  EXPECT_EQ(12, QuantizedLayout::quantize(1.23, q));
+  EXPECT_EQ(-12, QuantizedLayout::quantize(-1.23, q));
+  EXPECT_EQ(13, QuantizedLayout::quantize(1.26, q));
+  // Clamped to the range, short of the least integer, which stands for NaN.
+  EXPECT_EQ(127, QuantizedLayout::quantize(100, q));
+  EXPECT_EQ(-127, QuantizedLayout::quantize(-100, q));
+  EXPECT_EQ(-128, QuantizedLayout::quantize(NAN, q));
+
+  uint8_t nan = 0x80;
+  EXPECT_TRUE(std::isnan(QuantizedLayout::unquantize(&nan, q)));
+  uint8_t negative = 0xf4;
+  EXPECT_NEAR(-1.2, QuantizedLayout::unquantize(&negative, q), 1e-9);
+
+  QuantizedLayout::Quantized offset = { 0.01, 100, 2 };
+  EXPECT_EQ(-2000, QuantizedLayout::quantize(80, offset));
+  uint8_t encoded[] = { 0x30, 0xf8 };
+  EXPECT_NEAR(80, QuantizedLayout::unquantize(encoded, offset), 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,162 @@
+#ifndef ROSSERIAL_TEST_BENCHMARK_H
+#define ROSSERIAL_TEST_BENCHMARK_H
+
+#include "ros/ros.h"
+#include "ros/network.h"
+#include "std_msgs/String.h"
+#include "xmlrpcpp/XmlRpcClient.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Measurement helpers shared by the benchmark and the load generator. Include
+ * after the rosserial client library, which must already have been pulled into
+ * the rosserial namespace along with rosserial/std_msgs/String.h.
+ */
+
+static const size_t kStampLength = 20;
+
+inline void fillPayload(std::string& payload, size_t size)
+{
+  char stamp[kStampLength + 1];
+  snprintf(stamp, sizeof(stamp), "%020llu", (unsigned long long) ros::WallTime::now().toNSec());
+  payload.assign(std::max(size, kStampLength), 'x');
+  payload.replace(0, kStampLength, stamp);
+}
+
+inline double latencySince(const char* payload)
+{
+  unsigned long long sent = strtoull(std::string(payload, kStampLength).c_str(), NULL, 10);
+  return (ros::WallTime::now().toNSec() - sent) / 1e9;
+}
+
+/**
+ * Collects the latency of each message received, from whichever thread
+ * receives it.
+ */
+class LatencyRecorder {
+public:
+  void record(double latency)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (latencies_.empty()) first_ = ros::WallTime::now();
+    last_ = ros::WallTime::now();
+    latencies_.push_back(latency);
+  }
+
+  size_t received()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return latencies_.size();
+  }
+
+  // Hands over the latencies recorded so far, sorted, and how long they took
+  // to arrive, and starts over.
+  void take(std::vector<double>& latencies, double& elapsed)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    latencies.swap(latencies_);
+    latencies_.clear();
+    std::sort(latencies.begin(), latencies.end());
+    elapsed = latencies.empty() ? 0 : (last_ - first_).toSec();
+  }
+
+  void rosserialCallback(const rosserial::std_msgs::String& msg)
+  {
+    record(latencySince(msg.data));
+  }
+
+  void roscppCallback(const std_msgs::String::ConstPtr& msg)
+  {
+    record(latencySince(msg->data.c_str()));
+  }
+
+private:
+  std::vector<double> latencies_;
+  ros::WallTime first_;
+  ros::WallTime last_;
+  boost::mutex mutex_;
+};
+
+/**
+ * CPU time used so far, by this process or by another one.
+ */
+class CpuClock {
+public:
+  explicit CpuClock(int pid) : pid_(pid) {}
+
+  double seconds() const
+  {
+    if (pid_ == 0) {
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+             (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+    // utime and stime are the 14th and 15th fields, after a command name
+    // in parentheses which may itself contain spaces.
+    std::ostringstream path;
+    path << "/proc/" << pid_ << "/stat";
+    std::ifstream stat(path.str().c_str());
+    std::string line;
+    std::getline(stat, line);
+    size_t end = line.rfind(')');
+    if (end == std::string::npos) return 0;
+    std::istringstream fields(line.substr(end + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; i++) {
+      if (i == 14) utime = strtoull(field.c_str(), NULL, 10);
+      if (i == 15) stime = strtoull(field.c_str(), NULL, 10);
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+  }
+
+  bool valid() const { return pid_ >= 0; }
+
+private:
+  int pid_;
+};
+
+/**
+ * Asks a node for its pid through the node API, returning -1 if it can't.
+ */
+inline int lookupPid(const std::string& node)
+{
+  XmlRpc::XmlRpcValue args, result, payload;
+  args[0] = ros::this_node::getName();
+  args[1] = node;
+  std::string host;
+  uint32_t port;
+  if (!ros::master::execute("lookupNode", args, result, payload, false) ||
+      !ros::network::splitURI(payload, host, port)) {
+    return -1;
+  }
+  XmlRpc::XmlRpcClient client(host.c_str(), port, "/");
+  XmlRpc::XmlRpcValue pid_args, pid_result;
+  pid_args[0] = ros::this_node::getName();
+  if (!client.execute("getPid", pid_args, pid_result) || pid_result.getType() != XmlRpc::XmlRpcValue::TypeArray ||
+      pid_result.size() != 3 || (int)pid_result[0] != 1) {
+    return -1;
+  }
+  return pid_result[2];
+}
+
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty()) return 0;
+  size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[index];
+}
+
+#endif  // ROSSERIAL_TEST_BENCHMARK_H
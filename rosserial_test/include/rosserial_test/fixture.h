@@ -72,7 +72,9 @@ public:
   int tcp_port;
 };
 
-class SingleClientFixture : public ::testing::Test {
+// The link to the server, for fixtures to add a client NodeHandle_ of their
+// own sizing to.
+class ClientLinkFixture : public ::testing::Test {
 protected:
   static void SetModeFromParam() {
     std::string mode;
@@ -95,10 +97,14 @@ protected:
     setup->TearDown();
   }
 
-  rosserial::ros::NodeHandle client_nh;
   ros::NodeHandle nh;
   static AbstractSetup* setup;
 };
-AbstractSetup* SingleClientFixture::setup = NULL;
+AbstractSetup* ClientLinkFixture::setup = NULL;
+
+class SingleClientFixture : public ClientLinkFixture {
+protected:
+  rosserial::ros::NodeHandle client_nh;
+};
 
 
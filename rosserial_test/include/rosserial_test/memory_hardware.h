@@ -0,0 +1,84 @@
+#ifndef ROSSERIAL_TEST_MEMORY_HARDWARE_H
+#define ROSSERIAL_TEST_MEMORY_HARDWARE_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Hardware for a client NodeHandle_ which reads the bytes a test puts in, and
+ * keeps those written, so that the client can be unit tested without a server.
+ * The clock moves on millis_per_read with each byte read.
+ */
+class MemoryHardware {
+public:
+  static std::vector<uint8_t> in;
+  static size_t position;
+  static std::vector<uint8_t> out;
+  static unsigned long millis;
+  static unsigned long millis_per_read;
+
+  static void reset() {
+    in.clear();
+    position = 0;
+    out.clear();
+    millis = 0;
+    millis_per_read = 0;
+  }
+
+  void init() {}
+  int read() {
+    if (position == in.size()) return -1;
+    millis += millis_per_read;
+    return in[position++];
+  }
+  void write(uint8_t* data, int length) {
+    out.insert(out.end(), data, data + length);
+  }
+  unsigned long time() {
+    return millis;
+  }
+};
+
+std::vector<uint8_t> MemoryHardware::in;
+size_t MemoryHardware::position = 0;
+std::vector<uint8_t> MemoryHardware::out;
+unsigned long MemoryHardware::millis = 0;
+unsigned long MemoryHardware::millis_per_read = 0;
+
+/**
+ * Appends a frame as the server sends it, with the 8-bit checksums.
+ */
+inline void appendFrame(std::vector<uint8_t>& stream, uint16_t topic_id, const std::vector<uint8_t>& body) {
+  uint16_t length = body.size();
+  stream.push_back(0xff);
+  stream.push_back(0xfe);
+  stream.push_back(length & 0xff);
+  stream.push_back(length >> 8);
+  stream.push_back(255 - ((length & 0xff) + (length >> 8)) % 256);
+  stream.push_back(topic_id & 0xff);
+  stream.push_back(topic_id >> 8);
+  stream.insert(stream.end(), body.begin(), body.end());
+  unsigned int sum = (topic_id & 0xff) + (topic_id >> 8);
+  for (size_t i = 0; i < body.size(); i++) sum += body[i];
+  stream.push_back(255 - sum % 256);
+}
+
+/**
+ * The frames a client wrote, as topic IDs and bodies, taking the 8-bit checksum
+ * framing it uses before the server offers it anything else.
+ */
+inline bool parseFrames(const std::vector<uint8_t>& stream, std::vector<uint16_t>& topic_ids,
+                        std::vector<std::vector<uint8_t> >& bodies) {
+  size_t i = 0;
+  while (i < stream.size()) {
+    if (stream.size() - i < 8 || stream[i] != 0xff || stream[i + 1] != 0xfe) return false;
+    uint16_t length = stream[i + 2] | (stream[i + 3] << 8);
+    if (stream.size() - i < 8u + length) return false;
+    topic_ids.push_back(stream[i + 5] | (stream[i + 6] << 8));
+    bodies.push_back(std::vector<uint8_t>(stream.begin() + i + 7, stream.begin() + i + 7 + length));
+    i += 8 + length;
+  }
+  return true;
+}
+
+#endif  // ROSSERIAL_TEST_MEMORY_HARDWARE_H
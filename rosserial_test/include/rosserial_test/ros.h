@@ -5,6 +5,8 @@
 #include "rosserial/duration.cpp"
 #include "rosserial/time.cpp"
 #include <iostream>
+#include <errno.h>
+#include <poll.h>
 
 class ClientComms {
 public:
@@ -16,6 +18,10 @@ public:
   // dependent on the passage of time.
   static unsigned long millis;
 
+  // How long write() waits for a full buffer to drain before it drops the
+  // rest of the frame.
+  static int write_timeout_ms;
+
   void init() {
   }
   int read() {
@@ -23,8 +29,31 @@ public:
     ssize_t ret = ::read(fd, &ch, 1);
     return ret == 1 ? ch : -1;
   }
+  // Lets spinOnce read in chunks rather than a byte per system call, so the
+  // harness keeps up when benchmarking.
+  int read(uint8_t* data, int length) {
+    return ::read(fd, data, length);
+  }
+  // The fd is non-blocking, so wait out a full pty or socket buffer rather
+  // than dropping the rest of the frame; but not for longer than
+  // write_timeout_ms without progress, so a peer which stops reading can't
+  // hang the test.
   void write(uint8_t* data, int length) {
-    ::write(fd, data, length);
+    int waited_ms = 0;
+    while (length > 0) {
+      ssize_t ret = ::write(fd, data, length);
+      if (ret > 0) {
+        data += ret;
+        length -= ret;
+        waited_ms = 0;
+      } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && waited_ms < write_timeout_ms) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        poll(&pfd, 1, 100);
+        waited_ms += 100;
+      } else {
+        return;
+      }
+    }
   }
   unsigned long time() {
     return millis;
@@ -33,6 +62,7 @@ public:
 
 int ClientComms::fd = -1;
 unsigned long ClientComms::millis = 0;
+int ClientComms::write_timeout_ms = 1000;
 
 namespace ros {
 typedef NodeHandle_<ClientComms, 5, 5, 200, 200> NodeHandle;
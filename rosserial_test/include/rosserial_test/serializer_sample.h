@@ -0,0 +1,22 @@
+#ifndef ROSSERIAL_TEST_SERIALIZER_SAMPLE_H
+#define ROSSERIAL_TEST_SERIALIZER_SAMPLE_H
+
+#include <stdint.h>
+
+/**
+ * A few messages with fields of each width, built by src/serializer_sample.cpp
+ * against the client library generated each way: with the fields serialized
+ * inline, and by the functions shared in ros::Msg.
+ */
+#define DECLARE_SERIALIZER_SAMPLE(ns) \
+  namespace ns { \
+    /* Serializes the sample messages back to back, returning their length. */ \
+    uint32_t serializeSample(unsigned char* buffer); \
+    /* Deserializes what serializeSample() wrote, and serializes it again. */ \
+    uint32_t reserializeSample(unsigned char* buffer, unsigned char* out); \
+  }
+
+DECLARE_SERIALIZER_SAMPLE(inline_serializers)
+DECLARE_SERIALIZER_SAMPLE(shared_serializers)
+
+#endif  // ROSSERIAL_TEST_SERIALIZER_SAMPLE_H
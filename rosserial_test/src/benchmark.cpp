@@ -0,0 +1,207 @@
+#include "ros/ros.h"
+#include "std_msgs/String.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+namespace rosserial {
+#include "rosserial_test/ros.h"
+#include "rosserial/std_msgs/String.h"
+}
+
+#include <gtest/gtest.h>
+#include "rosserial_test/benchmark.h"
+#include "rosserial_test/fixture.h"
+
+/**
+ * Throughput and latency of a rosserial server transport, in both directions,
+ * driven by the test client over the same serial pty or TCP socket the
+ * functional tests use. Run by hand with one of the test/benchmark_*.test
+ * launch files; parameters:
+ *
+ *   ~sizes        message payload sizes to run, in bytes (default [32, 256, 1024])
+ *   ~count        messages to send at each size (default 1000)
+ *   ~rate         messages per second to send at, or 0 for as fast as possible
+ *   ~server_node  the server node, whose CPU time is measured (default /rosserial_server)
+ *
+ * Each message carries the time it was sent in its first bytes, and latency is
+ * measured against the same clock when it comes out the other side.
+ */
+
+namespace rosserial {
+namespace ros {
+// Larger buffers than the functional tests need, to fit the larger sizes.
+typedef NodeHandle_<ClientComms, 5, 5, 4096, 4096> BenchmarkNodeHandle;
+}
+}
+
+static void report(const char* direction, size_t size, int sent, LatencyRecorder& recorder,
+                   double cpu_server, double cpu_harness)
+{
+  std::vector<double> sorted;
+  double elapsed;
+  recorder.take(sorted, elapsed);
+  size_t received = sorted.size();
+  double rate = (received > 1 && elapsed > 0) ? (received - 1) / elapsed : 0;
+
+  printf("%-14s %6zu bytes  sent %6d  received %6zu  %9.1f msgs/s  %11.0f bytes/s  "
+         "latency p50 %8.3f ms  p99 %8.3f ms  p99.9 %8.3f ms  "
+         "cpu/msg server %7.2f us  harness %7.2f us\n",
+         direction, size, sent, received, rate, rate * size,
+         percentile(sorted, 0.5) * 1e3, percentile(sorted, 0.99) * 1e3, percentile(sorted, 0.999) * 1e3,
+         received ? cpu_server / received * 1e6 : 0, received ? cpu_harness / received * 1e6 : 0);
+  fflush(stdout);
+}
+
+class BenchmarkFixture : public ClientLinkFixture {
+protected:
+  virtual void SetUp()
+  {
+    ClientLinkFixture::SetUp();
+
+    std::vector<int> sizes;
+    if (!ros::param::get("~sizes", sizes)) {
+      sizes.push_back(32);
+      sizes.push_back(256);
+      sizes.push_back(1024);
+    }
+    sizes_.assign(sizes.begin(), sizes.end());
+    ros::param::param<int>("~count", count_, 1000);
+    ros::param::param<double>("~rate", rate_, 0);
+    std::string server_node;
+    ros::param::param<std::string>("~server_node", server_node, "/rosserial_server");
+    server_pid_ = lookupPid(server_node);
+    if (server_pid_ < 0) {
+      ROS_WARN_STREAM("Can't find the pid of " << server_node << ", so its CPU time won't be reported.");
+    }
+  }
+
+  // Keeps the client's clock running and its link serviced.
+  void spinClient()
+  {
+    rosserial::ClientComms::millis = ros::WallTime::now().toNSec() / 1000000;
+    client_nh.spinOnce();
+  }
+
+  // Spins the client until it is connected, or gives up after timeout seconds.
+  bool connectClient(double timeout)
+  {
+    ros::WallTime end = ros::WallTime::now() + ros::WallDuration(timeout);
+    while (!client_nh.connected() && ros::WallTime::now() < end) {
+      spinClient();
+      ros::WallDuration(0.001).sleep();
+    }
+    return client_nh.connected();
+  }
+
+  // Spins the client until check returns true, or gives up after timeout seconds.
+  template<class Check>
+  bool spinClientUntil(Check check, double timeout)
+  {
+    ros::WallTime end = ros::WallTime::now() + ros::WallDuration(timeout);
+    while (!check() && ros::WallTime::now() < end) {
+      spinClient();
+      ros::WallDuration(0.0001).sleep();
+    }
+    return check();
+  }
+
+  // Sleeps, while spinning the client, until the next message is due.
+  void pace(const ros::WallTime& start, int sent)
+  {
+    if (rate_ <= 0) {
+      spinClient();
+      return;
+    }
+    ros::WallTime due = start + ros::WallDuration(sent / rate_);
+    do {
+      spinClient();
+    } while (ros::WallTime::now() < due);
+  }
+
+  rosserial::ros::BenchmarkNodeHandle client_nh;
+  std::vector<size_t> sizes_;
+  int count_;
+  double rate_;
+  int server_pid_;
+};
+
+/**
+ * Messages published by the rosserial client, received by a roscpp subscriber.
+ */
+TEST_F(BenchmarkFixture, client_to_server) {
+  rosserial::std_msgs::String client_msg;
+  rosserial::ros::Publisher client_pub("benchmark_up", &client_msg);
+  client_nh.advertise(client_pub);
+  client_nh.initNode();
+  ASSERT_TRUE(connectClient(10.0));
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  for (size_t i = 0; i < sizes_.size(); i++) {
+    LatencyRecorder recorder;
+    ros::Subscriber sub = nh.subscribe("benchmark_up", count_, &LatencyRecorder::roscppCallback, &recorder);
+    ASSERT_TRUE(spinClientUntil(boost::bind(&ros::Subscriber::getNumPublishers, &sub), 10.0));
+
+    CpuClock server_cpu(server_pid_), harness_cpu(0);
+    double server_start = server_cpu.seconds(), harness_start = harness_cpu.seconds();
+    std::string payload;
+    ros::WallTime start = ros::WallTime::now();
+    for (int sent = 0; sent < count_; sent++) {
+      pace(start, sent);
+      fillPayload(payload, sizes_[i]);
+      client_msg.data = payload.c_str();
+      client_pub.publish(&client_msg);
+    }
+    spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) >= (size_t)count_, 2.0);
+    report("client->server", sizes_[i], count_, recorder,
+           server_cpu.valid() ? server_cpu.seconds() - server_start : 0,
+           harness_cpu.seconds() - harness_start);
+    sub.shutdown();
+  }
+  spinner.stop();
+}
+
+/**
+ * Messages published by a roscpp publisher, received by a rosserial client
+ * subscriber.
+ */
+TEST_F(BenchmarkFixture, server_to_client) {
+  LatencyRecorder recorder;
+  rosserial::ros::Subscriber<rosserial::std_msgs::String, LatencyRecorder> client_sub(
+      "benchmark_down", &LatencyRecorder::rosserialCallback, &recorder);
+  client_nh.subscribe(client_sub);
+  client_nh.initNode();
+  ASSERT_TRUE(connectClient(10.0));
+
+  ros::Publisher pub = nh.advertise<std_msgs::String>("benchmark_down", count_);
+  ASSERT_TRUE(spinClientUntil(boost::bind(&ros::Publisher::getNumSubscribers, &pub), 10.0));
+
+  for (size_t i = 0; i < sizes_.size(); i++) {
+    CpuClock server_cpu(server_pid_), harness_cpu(0);
+    double server_start = server_cpu.seconds(), harness_start = harness_cpu.seconds();
+    std_msgs::String msg;
+    ros::WallTime start = ros::WallTime::now();
+    for (int sent = 0; sent < count_; sent++) {
+      pace(start, sent);
+      fillPayload(msg.data, sizes_[i]);
+      pub.publish(msg);
+    }
+    spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) >= (size_t)count_, 2.0);
+    report("server->client", sizes_[i], count_, recorder,
+           server_cpu.valid() ? server_cpu.seconds() - server_start : 0,
+           harness_cpu.seconds() - harness_start);
+  }
+}
+
+int main(int argc, char **argv){
+  ros::init(argc, argv, "test_benchmark");
+  ros::start();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,331 @@
+#include "ros/ros.h"
+#include "std_msgs/String.h"
+
+#include <sys/socket.h>
+#include <sys/fcntl.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+namespace rosserial {
+#include "rosserial_test/ros.h"
+#include "rosserial/std_msgs/String.h"
+}
+
+#include "rosserial_test/benchmark.h"
+
+/**
+ * Many virtual MCUs at once against one socket_node, udp_socket_node or
+ * unix_socket_node, for
+ * finding the number of clients or the message rate at which one server
+ * process saturates. Each virtual client is a NodeHandle of its own, on a
+ * socket of its own, publishing std_msgs/String messages which a roscpp
+ * subscriber per topic receives. Run by hand, with the server and
+ * message_info_service.py up, as:
+ *
+ *   rosrun rosserial_test rosserial_test_load_generator _clients:=100
+ *
+ * Parameters:
+ *
+ *   ~mode         tcp, udp for a udp_socket_node with ~multi_client set, or unix
+ *                 (default tcp)
+ *   ~host, ~port  the server (default 127.0.0.1, 11411)
+ *   ~socket_path  the server's Unix socket, in unix mode (default /tmp/rosserial.sock)
+ *   ~clients      virtual clients to run (default 10)
+ *   ~topics       topics each client publishes on (default 1)
+ *   ~rate         messages per second on each topic (default 10)
+ *   ~size         message payload size, in bytes (default 32)
+ *   ~groups       in place of the four above, a list of dictionaries with any of
+ *                 them, for a mix of clients, eg. [{clients: 90}, {clients: 10, rate: 100}]
+ *   ~duration     seconds to publish for, once every client is connected (default 10)
+ *   ~server_node  the server node, whose CPU time is measured (default /rosserial_server)
+ *
+ * All the clients are run from the one thread, taking turns with the static
+ * ClientComms::fd, so the harness itself may saturate first; its own CPU time
+ * is reported alongside the server's to tell.
+ */
+
+namespace rosserial {
+namespace ros {
+typedef NodeHandle_<ClientComms, 10, 1, 1024, 2048> LoadNodeHandle;
+}
+}
+
+struct GroupConfig {
+  int clients;
+  int topics;
+  double rate;
+  int size;
+};
+
+static void readGroup(XmlRpc::XmlRpcValue& value, GroupConfig& group)
+{
+  if (value.hasMember("clients")) group.clients = value["clients"];
+  if (value.hasMember("topics")) group.topics = value["topics"];
+  if (value.hasMember("rate")) group.rate = value["rate"].getType() == XmlRpc::XmlRpcValue::TypeInt ?
+                                            (int)value["rate"] : (double)value["rate"];
+  if (value.hasMember("size")) group.size = value["size"];
+}
+
+/**
+ * A virtual MCU: its NodeHandle, its socket, and the topics it publishes on,
+ * each of which has a roscpp subscriber recording latency for the client.
+ */
+class VirtualClient {
+public:
+  VirtualClient(int index, const GroupConfig& config)
+    : config_(config), fd_(-1), sent_(0), next_due_(0)
+  {
+    config_.topics = std::max(1, std::min(config_.topics, 10));
+    for (int i = 0; i < config_.topics; i++) {
+      std::ostringstream name;
+      name << "load/client_" << index << "/topic_" << i;
+      names_.push_back(name.str());
+    }
+    messages_.resize(config_.topics);
+    payloads_.resize(config_.topics);
+    for (int i = 0; i < config_.topics; i++) {
+      publishers_.push_back(new rosserial::ros::Publisher(names_[i].c_str(), &messages_[i]));
+      nh_.advertise(*publishers_[i]);
+    }
+  }
+
+  ~VirtualClient()
+  {
+    for (size_t i = 0; i < publishers_.size(); i++) delete publishers_[i];
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool connect(const struct sockaddr* addr, socklen_t length, int type)
+  {
+    fd_ = socket(addr->sa_family, type, 0);
+    if (fd_ < 0 || ::connect(fd_, addr, length) < 0) {
+      return false;
+    }
+    fcntl(fd_, F_SETFL, O_NONBLOCK);
+    select();
+    nh_.initNode();
+    return true;
+  }
+
+  void subscribe(ros::NodeHandle& nh)
+  {
+    for (int i = 0; i < config_.topics; i++) {
+      subscribers_.push_back(nh.subscribe(names_[i], 1000, &LatencyRecorder::roscppCallback, &recorder_));
+    }
+  }
+
+  bool subscribed()
+  {
+    for (size_t i = 0; i < subscribers_.size(); i++) {
+      if (subscribers_[i].getNumPublishers() == 0) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Publishes on every topic if a round of messages is due, and spins.
+   */
+  void run(const ros::WallTime& start, bool publishing)
+  {
+    select();
+    if (publishing && config_.rate > 0 && (ros::WallTime::now() - start).toSec() >= next_due_) {
+      for (int i = 0; i < config_.topics; i++) {
+        fillPayload(payloads_[i], config_.size);
+        messages_[i].data = payloads_[i].c_str();
+        publishers_[i]->publish(&messages_[i]);
+        sent_++;
+      }
+      next_due_ += 1.0 / config_.rate;
+    }
+    nh_.spinOnce();
+  }
+
+  bool connected() { select(); return nh_.connected(); }
+  int sent() const { return sent_; }
+  const GroupConfig& config() const { return config_; }
+  LatencyRecorder& recorder() { return recorder_; }
+
+  void shutdown()
+  {
+    for (size_t i = 0; i < subscribers_.size(); i++) subscribers_[i].shutdown();
+  }
+
+private:
+  // Points the client library's hardware at this client's socket.
+  void select()
+  {
+    rosserial::ClientComms::fd = fd_;
+    rosserial::ClientComms::millis = ros::WallTime::now().toNSec() / 1000000;
+  }
+
+  GroupConfig config_;
+  int fd_;
+  int sent_;
+  double next_due_;
+  rosserial::ros::LoadNodeHandle nh_;
+  std::vector<std::string> names_;
+  std::vector<rosserial::std_msgs::String> messages_;
+  std::vector<std::string> payloads_;
+  std::vector<rosserial::ros::Publisher*> publishers_;
+  std::vector<ros::Subscriber> subscribers_;
+  LatencyRecorder recorder_;
+};
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "rosserial_test_load_generator");
+  ros::NodeHandle nh;
+
+  std::string mode, host, socket_path, server_node;
+  int port;
+  double duration;
+  ros::param::param<std::string>("~mode", mode, "tcp");
+  ros::param::param<std::string>("~host", host, "127.0.0.1");
+  ros::param::param<int>("~port", port, 11411);
+  ros::param::param<std::string>("~socket_path", socket_path, "/tmp/rosserial.sock");
+  ros::param::param<double>("~duration", duration, 10.0);
+  ros::param::param<std::string>("~server_node", server_node, "/rosserial_server");
+  if (mode != "tcp" && mode != "udp" && mode != "unix") {
+    ROS_FATAL_STREAM("Mode " << mode << " specified other than 'tcp', 'udp' or 'unix'.");
+    return 1;
+  }
+
+  GroupConfig defaults;
+  ros::param::param<int>("~clients", defaults.clients, 10);
+  ros::param::param<int>("~topics", defaults.topics, 1);
+  ros::param::param<double>("~rate", defaults.rate, 10.0);
+  ros::param::param<int>("~size", defaults.size, 32);
+  std::vector<GroupConfig> groups;
+  XmlRpc::XmlRpcValue groups_param;
+  if (ros::param::get("~groups", groups_param) && groups_param.getType() == XmlRpc::XmlRpcValue::TypeArray) {
+    for (int i = 0; i < groups_param.size(); i++) {
+      GroupConfig group = defaults;
+      readGroup(groups_param[i], group);
+      groups.push_back(group);
+    }
+  } else {
+    groups.push_back(defaults);
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  struct sockaddr_un local_addr;
+  memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sun_family = AF_UNIX;
+  strncpy(local_addr.sun_path, socket_path.c_str(), sizeof(local_addr.sun_path) - 1);
+  std::ostringstream server;
+  if (mode == "unix") server << socket_path; else server << host << ":" << port;
+  if (mode != "unix" && inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+    ROS_FATAL_STREAM("Can't make out the address " << host);
+    return 1;
+  }
+
+  std::vector<VirtualClient*> clients;
+  for (size_t g = 0; g < groups.size(); g++) {
+    for (int i = 0; i < groups[g].clients; i++) {
+      VirtualClient* client = new VirtualClient(clients.size(), groups[g]);
+      clients.push_back(client);
+      bool connected = mode == "unix" ?
+          client->connect((struct sockaddr*)&local_addr, sizeof(local_addr), SOCK_STREAM) :
+          client->connect((struct sockaddr*)&addr, sizeof(addr), mode == "udp" ? SOCK_DGRAM : SOCK_STREAM);
+      if (!connected) {
+        ROS_FATAL_STREAM("Unable to connect client " << clients.size() << " to " << server.str());
+        return 1;
+      }
+      client->subscribe(nh);
+    }
+  }
+
+  ros::AsyncSpinner spinner(2);
+  spinner.start();
+  CpuClock server_cpu(lookupPid(server_node)), harness_cpu(0);
+  if (!server_cpu.valid()) {
+    ROS_WARN_STREAM("Can't find the pid of " << server_node << ", so its CPU time won't be reported.");
+  }
+
+  // Every client must be connected, and its topics flowing, before the clock starts.
+  ros::WallTime setup_start = ros::WallTime::now();
+  ros::WallTime deadline = setup_start + ros::WallDuration(10.0 + 0.05 * clients.size());
+  size_t ready = 0;
+  while (ready < clients.size() && ros::WallTime::now() < deadline) {
+    ready = 0;
+    for (size_t i = 0; i < clients.size(); i++) {
+      clients[i]->run(setup_start, false);
+      if (clients[i]->connected() && clients[i]->subscribed()) ready++;
+    }
+    ros::WallDuration(0.001).sleep();
+  }
+  if (ready < clients.size()) {
+    ROS_FATAL("Only %d of %d clients connected.", (int)ready, (int)clients.size());
+    return 1;
+  }
+  ROS_INFO("All %d clients connected in %.1f s; publishing for %.1f s.", (int)clients.size(),
+           (ros::WallTime::now() - setup_start).toSec(), duration);
+
+  double server_start = server_cpu.valid() ? server_cpu.seconds() : 0, harness_start = harness_cpu.seconds();
+  ros::WallTime start = ros::WallTime::now();
+  while ((ros::WallTime::now() - start).toSec() < duration) {
+    for (size_t i = 0; i < clients.size(); i++) {
+      clients[i]->run(start, true);
+    }
+    ros::WallDuration(0.0001).sleep();
+  }
+  // A moment longer, for those in flight to arrive.
+  ros::WallTime drain_end = ros::WallTime::now() + ros::WallDuration(1.0);
+  while (ros::WallTime::now() < drain_end) {
+    for (size_t i = 0; i < clients.size(); i++) {
+      clients[i]->run(start, false);
+    }
+    ros::WallDuration(0.001).sleep();
+  }
+  double elapsed = (ros::WallTime::now() - start).toSec();
+  double cpu_server = server_cpu.valid() ? server_cpu.seconds() - server_start : 0;
+  double cpu_harness = harness_cpu.seconds() - harness_start;
+  spinner.stop();
+
+  int sent = 0;
+  size_t received = 0, bytes = 0;
+  std::vector<double> all, p99s;
+  for (size_t i = 0; i < clients.size(); i++) {
+    std::vector<double> sorted;
+    double span;
+    clients[i]->recorder().take(sorted, span);
+    sent += clients[i]->sent();
+    received += sorted.size();
+    bytes += sorted.size() * clients[i]->config().size;
+    printf("client %4d  %2d topics at %7.1f Hz  sent %7d  received %7zu  "
+           "latency p50 %8.3f ms  p99 %8.3f ms  p99.9 %8.3f ms\n",
+           (int)i, clients[i]->config().topics, clients[i]->config().rate, clients[i]->sent(), sorted.size(),
+           percentile(sorted, 0.5) * 1e3, percentile(sorted, 0.99) * 1e3, percentile(sorted, 0.999) * 1e3);
+    all.insert(all.end(), sorted.begin(), sorted.end());
+    p99s.push_back(percentile(sorted, 0.99));
+    clients[i]->shutdown();
+  }
+  std::sort(all.begin(), all.end());
+  std::sort(p99s.begin(), p99s.end());
+
+  printf("%d clients  sent %d  received %zu (%.2f%%)  %9.1f msgs/s  %11.0f bytes/s\n",
+         (int)clients.size(), sent, received, sent ? 100.0 * received / sent : 0,
+         received / elapsed, bytes / elapsed);
+  printf("latency all p50 %8.3f ms  p99 %8.3f ms  p99.9 %8.3f ms  worst client p99 %8.3f ms\n",
+         percentile(all, 0.5) * 1e3, percentile(all, 0.99) * 1e3, percentile(all, 0.999) * 1e3,
+         p99s.empty() ? 0 : p99s.back() * 1e3);
+  printf("cpu server %5.1f%% of a core, %7.2f us/msg  harness %5.1f%% of a core, %7.2f us/msg\n",
+         100 * cpu_server / elapsed, received ? cpu_server / received * 1e6 : 0,
+         100 * cpu_harness / elapsed, received ? cpu_harness / received * 1e6 : 0);
+  fflush(stdout);
+
+  for (size_t i = 0; i < clients.size(); i++) delete clients[i];
+  return 0;
+}
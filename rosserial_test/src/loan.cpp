@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_test/memory_hardware.h"
+
+namespace rosserial {
+#include "rosserial/ros/node_handle.h"
+#include "rosserial/duration.cpp"
+#include "rosserial/time.cpp"
+#include "rosserial/std_msgs/UInt32.h"
+#include "rosserial/rosserial_msgs/RequestParam.h"
+}
+
+/**
+ * Frames sent while a Publisher's loan is out, which must be kept out of the
+ * loaned buffer or TX queue slot until the loan is published.
+ */
+class AsyncMemoryHardware : public MemoryHardware {
+public:
+  void writeAsync(uint8_t* data, int length) { write(data, length); }
+  bool writeDone() { return true; }
+};
+
+class QueuedMemoryHardware : public MemoryHardware {
+public:
+  int availableForWrite() { return 1024; }
+};
+
+typedef std::vector<uint16_t> TopicIds;
+typedef std::vector<std::vector<uint8_t> > Bodies;
+
+static std::vector<uint8_t> valueBody(uint32_t value)
+{
+  std::vector<uint8_t> body(4);
+  for (int i = 0; i < 4; i++) body[i] = (value >> (8 * i)) & 0xff;
+  return body;
+}
+
+template<class NodeHandle>
+class LoanTest : public ::testing::Test {
+protected:
+  LoanTest() : loaned("loaned", &msg), other("other", &msg) {}
+
+  virtual void SetUp() {
+    MemoryHardware::reset();
+    node_handle.initNode();
+    node_handle.advertise(loaned);
+    node_handle.advertise(other);
+    // Answer the server's topics request, so that user topics may publish.
+    appendFrame(MemoryHardware::in, rosserial::rosserial_msgs::TopicInfo::ID_PUBLISHER, std::vector<uint8_t>());
+    node_handle.spinOnce();
+    MemoryHardware::out.clear();
+  }
+
+  void sent(TopicIds& topic_ids, Bodies& bodies) {
+    ASSERT_TRUE(parseFrames(MemoryHardware::out, topic_ids, bodies));
+  }
+
+  NodeHandle node_handle;
+  rosserial::std_msgs::UInt32 msg;
+  rosserial::ros::Publisher loaned;
+  rosserial::ros::Publisher other;
+};
+
+typedef LoanTest<rosserial::ros::NodeHandle_<MemoryHardware, 2, 2, 64, 128> > SyncLoanTest;
+typedef LoanTest<rosserial::ros::NodeHandle_<AsyncMemoryHardware, 2, 2, 64, 128> > AsyncLoanTest;
+typedef LoanTest<rosserial::ros::NodeHandle_<QueuedMemoryHardware, 2, 2, 64, 128, 2> > QueuedLoanTest;
+
+TEST_F(SyncLoanTest, publish_during_loan_dropped) {
+  rosserial::ros::MessageWriter writer = loaned.loan();
+  writer.write((uint32_t) 1);
+  msg.data = 2;
+  EXPECT_EQ(-1, other.publish(&msg));
+  EXPECT_LT(0, loaned.publish(writer));
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(1u, topic_ids.size());
+  EXPECT_EQ(loaned.id_, topic_ids[0]);
+  EXPECT_EQ(valueBody(1), bodies[0]);
+}
+
+TEST_F(SyncLoanTest, second_loan_refused_without_abandoning_first) {
+  rosserial::ros::MessageWriter writer = loaned.loan();
+  rosserial::ros::MessageWriter second = other.loan();
+  EXPECT_FALSE(second.ok());
+  EXPECT_EQ(-1, other.publish(second));
+  writer.write((uint32_t) 1);
+  EXPECT_LT(0, loaned.publish(writer));
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(1u, topic_ids.size());
+  EXPECT_EQ(valueBody(1), bodies[0]);
+}
+
+TEST_F(AsyncLoanTest, publish_during_loan_sent_from_other_buffer) {
+  rosserial::ros::MessageWriter writer = loaned.loan();
+  writer.write((uint32_t) 1);
+  msg.data = 2;
+  EXPECT_LT(0, other.publish(&msg));
+  EXPECT_LT(0, loaned.publish(writer));
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(2u, topic_ids.size());
+  EXPECT_EQ(other.id_, topic_ids[0]);
+  EXPECT_EQ(valueBody(2), bodies[0]);
+  EXPECT_EQ(loaned.id_, topic_ids[1]);
+  EXPECT_EQ(valueBody(1), bodies[1]);
+}
+
+TEST_F(QueuedLoanTest, loaned_slot_kept_until_published) {
+  rosserial::ros::MessageWriter writer = loaned.loan();
+  writer.write((uint32_t) 1);
+  msg.data = 2;
+  EXPECT_EQ(-1, other.publish(&msg));
+  EXPECT_LT(0, loaned.publish(writer));
+  msg.data = 3;
+  EXPECT_LT(0, other.publish(&msg));
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(2u, topic_ids.size());
+  EXPECT_EQ(valueBody(1), bodies[0]);
+  EXPECT_EQ(valueBody(3), bodies[1]);
+}
+
+TEST_F(QueuedLoanTest, abandoned_loan_releases_slot) {
+  rosserial::ros::MessageWriter writer = loaned.loan();
+  for (int i = 0; i < 64; i++) writer.write((uint32_t) i);
+  EXPECT_FALSE(writer.ok());
+  EXPECT_EQ(-1, loaned.publish(writer));
+  msg.data = 2;
+  EXPECT_LT(0, other.publish(&msg));
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(1u, topic_ids.size());
+  EXPECT_EQ(valueBody(2), bodies[0]);
+}
+
+/**
+ * A service whose callback publishes while its response is on loan.
+ */
+static rosserial::ros::Publisher* service_side_pub = NULL;
+
+static void publishingService(const rosserial::rosserial_msgs::RequestParamRequest&, rosserial::ros::MessageWriter& res)
+{
+  rosserial::std_msgs::UInt32 side;
+  side.data = 9;
+  service_side_pub->publish(&side);
+  res.write((uint32_t) 1);
+  res.write((int32_t) 7);
+  res.write((uint32_t) 0);
+  res.write((uint32_t) 0);
+}
+
+TEST_F(SyncLoanTest, in_place_service_response_kept_from_callback_publish) {
+  typedef rosserial::ros::NodeHandle_<MemoryHardware, 2, 2, 64, 128> ServiceNodeHandle;
+  MemoryHardware::reset();
+  ServiceNodeHandle nh;
+  rosserial::ros::InPlaceServiceServer<rosserial::rosserial_msgs::RequestParamRequest,
+                                       rosserial::rosserial_msgs::RequestParamResponse> server("param", publishingService);
+  rosserial::ros::Publisher side("side", &msg);
+  nh.initNode();
+  nh.advertiseService(server);
+  nh.advertise(side);
+  service_side_pub = &side;
+  appendFrame(MemoryHardware::in, rosserial::rosserial_msgs::TopicInfo::ID_PUBLISHER, std::vector<uint8_t>());
+  nh.spinOnce();
+  MemoryHardware::out.clear();
+
+  std::vector<uint8_t> request = valueBody(1);
+  request.push_back('x');
+  appendFrame(MemoryHardware::in, 100, request);
+  nh.spinOnce();
+
+  TopicIds topic_ids;
+  Bodies bodies;
+  sent(topic_ids, bodies);
+  ASSERT_EQ(1u, topic_ids.size());
+  EXPECT_EQ(server.pub.id_, topic_ids[0]);
+  std::vector<uint8_t> response = valueBody(1);
+  std::vector<uint8_t> value = valueBody(7);
+  response.insert(response.end(), value.begin(), value.end());
+  response.resize(16, 0);
+  EXPECT_EQ(response, bodies[0]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,230 @@
+#include "ros/ros.h"
+#include "std_msgs/String.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+namespace rosserial {
+#include "rosserial_test/ros.h"
+#include "rosserial/std_msgs/String.h"
+}
+
+#include <gtest/gtest.h>
+#include "rosserial_test/benchmark.h"
+#include "rosserial_test/fixture.h"
+
+/**
+ * Performance budgets for a rosserial server transport, checked over the same
+ * serial pty or TCP socket the functional tests use, so that a change which
+ * makes the link markedly slower fails the suite rather than going unnoticed
+ * until someone runs the benchmark. Parameters:
+ *
+ *   ~size            message payload size, in bytes (default 32)
+ *   ~rate            messages per second for the round trip test (default 50)
+ *   ~count           messages to send in each test (default 500)
+ *   ~p99_budget_ms   round trip p99 latency must be below this (default 50)
+ *   ~min_throughput  messages per second each way must be at least this (default 200)
+ *
+ * The defaults are loose enough for a loaded build machine; tighten them in
+ * the launch file to catch smaller regressions on quieter hardware.
+ */
+
+class PerformanceFixture : public SingleClientFixture {
+protected:
+  virtual void SetUp()
+  {
+    SingleClientFixture::SetUp();
+    ros::param::param<int>("~size", size_, 32);
+    ros::param::param<double>("~rate", rate_, 50);
+    ros::param::param<int>("~count", count_, 500);
+    ros::param::param<double>("~p99_budget_ms", p99_budget_ms_, 50);
+    ros::param::param<double>("~min_throughput", min_throughput_, 200);
+  }
+
+  void spinClient()
+  {
+    rosserial::ClientComms::millis = ros::WallTime::now().toNSec() / 1000000;
+    client_nh.spinOnce();
+  }
+
+  template<class Check>
+  bool spinClientUntil(Check check, double timeout)
+  {
+    ros::WallTime end = ros::WallTime::now() + ros::WallDuration(timeout);
+    while (!check() && ros::WallTime::now() < end) {
+      spinClient();
+      ros::WallDuration(0.0001).sleep();
+    }
+    return check();
+  }
+
+  bool connected()
+  {
+    return client_nh.connected();
+  }
+
+  // Messages per second between the first and last arrivals.
+  static double throughput(const std::vector<double>& latencies, double elapsed)
+  {
+    return (latencies.size() > 1 && elapsed > 0) ? (latencies.size() - 1) / elapsed : 0;
+  }
+
+  int size_;
+  double rate_;
+  int count_;
+  double p99_budget_ms_;
+  double min_throughput_;
+};
+
+/**
+ * Echoes each message it receives back out on another topic.
+ */
+class Echo {
+public:
+  explicit Echo(ros::Publisher& pub) : pub_(pub) {}
+  void callback(const std_msgs::String::ConstPtr& msg) { pub_.publish(msg); }
+private:
+  ros::Publisher& pub_;
+};
+
+/**
+ * Messages published by the client at a steady rate, echoed back to it by a
+ * roscpp node; the p99 of the round trip must stay within budget.
+ */
+TEST_F(PerformanceFixture, round_trip_latency) {
+  rosserial::std_msgs::String client_msg;
+  rosserial::ros::Publisher client_pub("performance_ping", &client_msg);
+  LatencyRecorder recorder;
+  rosserial::ros::Subscriber<rosserial::std_msgs::String, LatencyRecorder> client_sub(
+      "performance_pong", &LatencyRecorder::rosserialCallback, &recorder);
+  client_nh.advertise(client_pub);
+  client_nh.subscribe(client_sub);
+  client_nh.initNode();
+  ASSERT_TRUE(spinClientUntil(boost::bind(&PerformanceFixture::connected, this), 10.0));
+
+  ros::Publisher pong = nh.advertise<std_msgs::String>("performance_pong", count_);
+  Echo echo(pong);
+  ros::Subscriber ping = nh.subscribe("performance_ping", count_, &Echo::callback, &echo);
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  // Ping until the first pong comes back, so that the measurement starts with
+  // the whole path set up.
+  std::string payload;
+  ros::WallTime give_up = ros::WallTime::now() + ros::WallDuration(10.0);
+  while (recorder.received() == 0 && ros::WallTime::now() < give_up) {
+    fillPayload(payload, size_);
+    client_msg.data = payload.c_str();
+    client_pub.publish(&client_msg);
+    spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) > 0, 0.1);
+  }
+  ASSERT_GT(recorder.received(), 0u);
+  // Let the pongs still in flight come back before starting over.
+  ros::WallTime settled = ros::WallTime::now() + ros::WallDuration(0.5);
+  while (ros::WallTime::now() < settled) {
+    spinClient();
+    ros::WallDuration(0.0001).sleep();
+  }
+  std::vector<double> latencies;
+  double elapsed;
+  recorder.take(latencies, elapsed);
+
+  ros::WallTime start = ros::WallTime::now();
+  for (int sent = 0; sent < count_; sent++) {
+    ros::WallTime due = start + ros::WallDuration(sent / rate_);
+    do {
+      spinClient();
+    } while (ros::WallTime::now() < due);
+    fillPayload(payload, size_);
+    client_msg.data = payload.c_str();
+    client_pub.publish(&client_msg);
+  }
+  spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) >= (size_t)count_, 2.0);
+  spinner.stop();
+
+  recorder.take(latencies, elapsed);
+  double p99_ms = percentile(latencies, 0.99) * 1e3;
+  ROS_INFO("Round trip at %.0f Hz: %zu of %d received, p50 %.3f ms, p99 %.3f ms",
+           rate_, latencies.size(), count_, percentile(latencies, 0.5) * 1e3, p99_ms);
+  // A few messages lost to a full queue shouldn't mask the latency figure,
+  // but most of them have to make it.
+  EXPECT_GE(latencies.size(), (size_t)count_ * 9 / 10);
+  EXPECT_LT(p99_ms, p99_budget_ms_);
+}
+
+/**
+ * Messages published by the client as fast as it can, received by a roscpp
+ * subscriber.
+ */
+TEST_F(PerformanceFixture, client_to_server_throughput) {
+  rosserial::std_msgs::String client_msg;
+  rosserial::ros::Publisher client_pub("performance_up", &client_msg);
+  client_nh.advertise(client_pub);
+  client_nh.initNode();
+  ASSERT_TRUE(spinClientUntil(boost::bind(&PerformanceFixture::connected, this), 10.0));
+
+  LatencyRecorder recorder;
+  ros::Subscriber sub = nh.subscribe("performance_up", count_, &LatencyRecorder::roscppCallback, &recorder);
+  ASSERT_TRUE(spinClientUntil(boost::bind(&ros::Subscriber::getNumPublishers, &sub), 10.0));
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  std::string payload;
+  for (int sent = 0; sent < count_; sent++) {
+    spinClient();
+    fillPayload(payload, size_);
+    client_msg.data = payload.c_str();
+    client_pub.publish(&client_msg);
+  }
+  spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) >= (size_t)count_, 2.0);
+  spinner.stop();
+
+  std::vector<double> latencies;
+  double elapsed;
+  recorder.take(latencies, elapsed);
+  double rate = throughput(latencies, elapsed);
+  ROS_INFO("Client to server: %zu of %d received, %.1f msgs/s", latencies.size(), count_, rate);
+  EXPECT_GE(latencies.size(), (size_t)count_ * 9 / 10);
+  EXPECT_GE(rate, min_throughput_);
+}
+
+/**
+ * Messages published by a roscpp publisher as fast as it can, received by the
+ * client.
+ */
+TEST_F(PerformanceFixture, server_to_client_throughput) {
+  LatencyRecorder recorder;
+  rosserial::ros::Subscriber<rosserial::std_msgs::String, LatencyRecorder> client_sub(
+      "performance_down", &LatencyRecorder::rosserialCallback, &recorder);
+  client_nh.subscribe(client_sub);
+  client_nh.initNode();
+  ASSERT_TRUE(spinClientUntil(boost::bind(&PerformanceFixture::connected, this), 10.0));
+
+  ros::Publisher pub = nh.advertise<std_msgs::String>("performance_down", count_);
+  ASSERT_TRUE(spinClientUntil(boost::bind(&ros::Publisher::getNumSubscribers, &pub), 10.0));
+
+  std_msgs::String msg;
+  for (int sent = 0; sent < count_; sent++) {
+    spinClient();
+    fillPayload(msg.data, size_);
+    pub.publish(msg);
+  }
+  spinClientUntil(boost::bind(&LatencyRecorder::received, &recorder) >= (size_t)count_, 2.0);
+
+  std::vector<double> latencies;
+  double elapsed;
+  recorder.take(latencies, elapsed);
+  double rate = throughput(latencies, elapsed);
+  ROS_INFO("Server to client: %zu of %d received, %.1f msgs/s", latencies.size(), count_, rate);
+  EXPECT_GE(latencies.size(), (size_t)count_ * 9 / 10);
+  EXPECT_GE(rate, min_throughput_);
+}
+
+int main(int argc, char **argv){
+  ros::init(argc, argv, "test_performance");
+  ros::start();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
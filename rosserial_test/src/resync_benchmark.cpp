@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+
+#include "rosserial_server/async_read_buffer.h"
+#include "rosserial_server/frame_parser.h"
+
+namespace rosserial {
+#include "rosserial/ros/node_handle.h"
+#include "rosserial/duration.cpp"
+#include "rosserial/time.cpp"
+}
+
+using rosserial_server::FrameParser;
+
+/**
+ * How well each of the frame parsers recovers from line noise: the client's
+ * NodeHandle_::spinOnce, and the server's AsyncReadBuffer, which Session reads
+ * through. A stream of frames is damaged by flipping bits, dropping bytes and
+ * inserting spurious 0xff 0xfe sync sequences, each of which is an error event,
+ * and fed to each parser in every framing: plain checksum, CRC-16, and COBS with
+ * either. Build and run by hand:
+ *
+ *   catkin_make rosserial_test_resync_benchmark
+ *   rosserial_test_resync_benchmark [-b bit error rate] [-d byte drop rate]
+ *       [-s spurious sync rate] [-n frames] [-l payload bytes] [-r baud]
+ *       [-w file prefix]
+ *
+ * For each, it reports the goodput, the share of frames delivered intact, the
+ * frames lost per error event, damaged frames which got through as good, and the
+ * time to resync: the time on the link from an error event to the end of the
+ * next frame which started after it and was delivered intact. Times are of the
+ * link at the given baud rate, so they don't depend on the machine; the parse
+ * rate is of this machine.
+ *
+ * With -w, each damaged stream is also written to <prefix>_<framing>.bin, with an
+ * index of its frames and errors in <prefix>_<framing>.idx, for the
+ * resync_benchmark_python script to feed to rosserial_python's frame parsers,
+ * which SerialClient.run reads through.
+ */
+
+struct NoiseConfig {
+  double bit_error_rate;
+  double drop_rate;
+  double sync_rate;
+  int frames;
+  int size;
+  double baud;
+};
+
+enum Framing { PLAIN, CRC16, COBS, COBS_CRC16, FRAMING_COUNT };
+static const char* framing_names[FRAMING_COUNT] = { "plain", "crc16", "cobs", "cobs_crc16" };
+
+static const uint16_t topic_id = 100;
+
+/**
+ * A deterministic generator, so that every parser sees the same damage.
+ */
+class Random {
+public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+  double uniform()
+  {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return (state_ >> 11) * (1.0 / 9007199254740992.0);
+  }
+private:
+  uint64_t state_;
+};
+
+/**
+ * The damaged stream, with where each frame ended up in it, and where each
+ * error event happened.
+ */
+struct NoisyStream {
+  std::vector<uint8_t> bytes;
+  std::vector<size_t> frame_start;
+  std::vector<size_t> frame_end;
+  std::vector<size_t> events;
+};
+
+// Each body is a serialized std_msgs/String of size characters: the frame's
+// sequence number in ten digits, then letters which depend on it.
+static void fillPayload(uint32_t seq, int size, uint8_t* chars)
+{
+  char digits[11];
+  snprintf(digits, sizeof(digits), "%010u", seq);
+  for (int i = 0; i < size; i++) {
+    chars[i] = i < 10 ? digits[i] : 'a' + (seq + i) % 26;
+  }
+}
+
+static bool checkBody(const uint8_t* body, size_t length, int size, uint32_t frames, uint32_t& seq)
+{
+  if (length != static_cast<size_t>(size) + 4) return false;
+  uint32_t string_length = body[0] | (body[1] << 8) | (body[2] << 16) | (body[3] << 24);
+  if (string_length != static_cast<uint32_t>(size)) return false;
+  seq = 0;
+  for (int i = 0; i < 10 && i < size; i++) {
+    if (body[4 + i] < '0' || body[4 + i] > '9') return false;
+    seq = seq * 10 + (body[4 + i] - '0');
+  }
+  if (seq >= frames) return false;
+  std::vector<uint8_t> expected(size);
+  fillPayload(seq, size, &expected[0]);
+  return memcmp(body + 4, &expected[0], size) == 0;
+}
+
+static void encodeFrame(uint32_t seq, int size, Framing framing, std::vector<uint8_t>& out)
+{
+  bool crc = framing == CRC16 || framing == COBS_CRC16;
+  uint16_t length = size + 4;
+  std::vector<uint8_t> frame(FrameParser::header_bytes + length + (crc ? 2 : 1));
+  frame[0] = 0xff;
+  frame[1] = crc ? FrameParser::protocol_ver2_crc16 : FrameParser::protocol_ver2;
+  frame[2] = length & 0xff;
+  frame[3] = length >> 8;
+  frame[4] = 255 - FrameParser::checksum(length);
+  frame[5] = topic_id & 0xff;
+  frame[6] = topic_id >> 8;
+  uint8_t* body = &frame[FrameParser::header_bytes];
+  body[0] = size & 0xff;
+  body[1] = (size >> 8) & 0xff;
+  body[2] = body[3] = 0;
+  fillPayload(seq, size, body + 4);
+  if (crc) {
+    uint16_t value = FrameParser::crc16(&frame[5], length + 2);
+    body[length] = value & 0xff;
+    body[length + 1] = value >> 8;
+  } else {
+    body[length] = 255 - (FrameParser::checksum(body, length) + FrameParser::checksum(topic_id));
+  }
+
+  if (framing == COBS || framing == COBS_CRC16) {
+    out.resize(FrameParser::max_cobs_bytes(frame.size()));
+    out.resize(FrameParser::cobs_encode(&frame[0], frame.size(), &out[0]));
+  } else {
+    out.swap(frame);
+  }
+}
+
+static void makeStream(const NoiseConfig& config, Framing framing, NoisyStream& stream)
+{
+  Random random(12345);
+  std::vector<uint8_t> frame;
+  for (int seq = 0; seq < config.frames; seq++) {
+    encodeFrame(seq, config.size, framing, frame);
+    stream.frame_start.push_back(stream.bytes.size());
+    for (size_t i = 0; i < frame.size(); i++) {
+      if (config.sync_rate > 0 && random.uniform() < config.sync_rate) {
+        stream.events.push_back(stream.bytes.size());
+        stream.bytes.push_back(0xff);
+        stream.bytes.push_back(FrameParser::protocol_ver2);
+      }
+      if (config.drop_rate > 0 && random.uniform() < config.drop_rate) {
+        stream.events.push_back(stream.bytes.size());
+        continue;
+      }
+      uint8_t byte = frame[i];
+      if (config.bit_error_rate > 0) {
+        for (int bit = 0; bit < 8; bit++) {
+          if (random.uniform() < config.bit_error_rate) byte ^= 1 << bit;
+        }
+        if (byte != frame[i]) stream.events.push_back(stream.bytes.size());
+      }
+      stream.bytes.push_back(byte);
+    }
+    stream.frame_end.push_back(stream.bytes.size());
+  }
+}
+
+struct Result {
+  std::vector<bool> delivered;
+  uint64_t good;
+  uint64_t undetected;
+  double seconds;
+};
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void deliver(Result& result, const uint8_t* body, size_t length, int size)
+{
+  uint32_t seq;
+  if (checkBody(body, length, size, result.delivered.size(), seq) && !result.delivered[seq]) {
+    result.delivered[seq] = true;
+    result.good++;
+  } else {
+    result.undetected++;
+  }
+}
+
+//// CLIENT ////
+
+/**
+ * Hands spinOnce the stream a UART's worth at a time, with a clock which runs at
+ * the link's byte rate.
+ */
+class StreamHardware {
+public:
+  static const NoisyStream* stream;
+  static size_t position;
+  static size_t limit;
+  static double byte_rate;
+
+  void init() {}
+  int read()
+  {
+    return position < limit ? stream->bytes[position++] : -1;
+  }
+  int read(uint8_t* data, int length)
+  {
+    int n = std::min<size_t>(length, limit - position);
+    memcpy(data, &stream->bytes[position], n);
+    position += n;
+    return n > 0 ? n : -1;
+  }
+  void write(uint8_t*, int) {}
+  unsigned long time()
+  {
+    return static_cast<unsigned long>(position * 1000 / byte_rate);
+  }
+};
+
+const NoisyStream* StreamHardware::stream = NULL;
+size_t StreamHardware::position = 0;
+size_t StreamHardware::limit = 0;
+double StreamHardware::byte_rate = 11520;
+
+/**
+ * Takes in the body as it is, without trusting its length field, which may have
+ * been damaged in a frame which got through as good.
+ */
+class RawMsg : public rosserial::ros::Msg {
+public:
+  RawMsg() : data(NULL) {}
+  virtual int serialize(unsigned char*) const { return 0; }
+  virtual int deserialize(unsigned char* inbuffer) { data = inbuffer; return 0; }
+  virtual const char* getType() { return "std_msgs/String"; }
+  virtual const char* getMD5() { return "992ce8a1687cec8c8bd883ec73ca41d1"; }
+  const unsigned char* data;
+};
+
+static Result* client_result = NULL;
+static int client_size = 0;
+
+static void clientCallback(const RawMsg& msg)
+{
+  // The length isn't handed on, so is taken to be right; checkBody checks the
+  // string length inside it, and the content, before reading any further.
+  deliver(*client_result, msg.data, client_size + 4, client_size);
+}
+
+static void runClient(const NoisyStream& stream, const NoiseConfig& config, Result& result)
+{
+  typedef rosserial::ros::NodeHandle_<StreamHardware, 1, 1, 1024, 256> ClientNodeHandle;
+  StreamHardware::stream = &stream;
+  StreamHardware::position = StreamHardware::limit = 0;
+  StreamHardware::byte_rate = config.baud / 10;
+  client_result = &result;
+  client_size = config.size;
+
+  ClientNodeHandle nh;
+  rosserial::ros::Subscriber<RawMsg> sub("noise", clientCallback);
+  nh.subscribe(sub);
+
+  double start = now();
+  while (StreamHardware::position < stream.bytes.size()) {
+    StreamHardware::limit = std::min(stream.bytes.size(), StreamHardware::limit + 64);
+    nh.spinOnce();
+  }
+  result.seconds = now() - start;
+}
+
+//// SERVER ////
+
+class ServerRun {
+public:
+  ServerRun(const NoisyStream& stream, const NoiseConfig& config, Result& result)
+    : stream_(stream), size_(config.size), result_(result), descriptor_(io_service_), strand_(io_service_),
+      buffer_(descriptor_, strand_, 1023, boost::bind(&ServerRun::error, this, _1))
+  {
+    if (pipe(fds_) != 0) {
+      perror("pipe");
+      exit(1);
+    }
+    descriptor_.assign(fds_[0]);
+  }
+
+  void run()
+  {
+    double start = now();
+    boost::thread writer(boost::bind(&ServerRun::write, this));
+    buffer_.read_frames(boost::bind(&ServerRun::frames, this, _1));
+    io_service_.run();
+    writer.join();
+    result_.seconds = now() - start;
+  }
+
+private:
+  // A chunk at a time, as a serial port's reads would bring it in.
+  void write()
+  {
+    for (size_t i = 0; i < stream_.bytes.size(); i += 64) {
+      size_t length = std::min<size_t>(64, stream_.bytes.size() - i);
+      if (::write(fds_[1], &stream_.bytes[i], length) != static_cast<ssize_t>(length)) break;
+    }
+    close(fds_[1]);
+  }
+
+  // Checked as Session::handle_frame does, before looking at the body.
+  void frames(std::vector<rosserial_server::Frame>& frames)
+  {
+    for (size_t i = 0; i < frames.size(); i++) {
+      const rosserial_server::Frame& frame = frames[i];
+      if (frame.topic_id != topic_id) continue;
+      uint32_t body_length = frame.length - (frame.crc16 ? 2 : 1);
+      bool valid;
+      if (frame.crc16) {
+        uint16_t crc = frame.data[body_length] | (frame.data[body_length + 1] << 8);
+        valid = FrameParser::crc16(frame.data - 2, body_length + 2) == crc;
+      } else {
+        valid = static_cast<uint8_t>(FrameParser::checksum(frame.data, frame.length) +
+                                     FrameParser::checksum(frame.topic_id)) == 0xff;
+      }
+      if (valid) deliver(result_, frame.data, body_length, size_);
+    }
+    buffer_.read_frames(boost::bind(&ServerRun::frames, this, _1));
+  }
+
+  void error(const boost::system::error_code&)
+  {
+    io_service_.stop();
+  }
+
+  const NoisyStream& stream_;
+  int size_;
+  Result& result_;
+  int fds_[2];
+  boost::asio::io_service io_service_;
+  boost::asio::posix::stream_descriptor descriptor_;
+  boost::asio::io_service::strand strand_;
+  rosserial_server::AsyncReadBuffer<boost::asio::posix::stream_descriptor> buffer_;
+};
+
+//// REPORT ////
+
+static void report(const char* parser, Framing framing, const NoisyStream& stream, const NoiseConfig& config,
+                   const Result& result)
+{
+  double byte_rate = config.baud / 10;
+  double link_seconds = stream.bytes.size() / byte_rate;
+  uint64_t lost = config.frames - result.good;
+
+  // For each error event, the end of the first intact frame which started after it.
+  std::vector<double> resync;
+  size_t frame = 0;
+  for (size_t i = 0; i < stream.events.size(); i++) {
+    while (frame < stream.frame_start.size() &&
+           (stream.frame_start[frame] <= stream.events[i] || !result.delivered[frame])) {
+      frame++;
+    }
+    if (frame == stream.frame_start.size()) break;
+    resync.push_back((stream.frame_end[frame] - stream.events[i]) / byte_rate);
+  }
+  std::sort(resync.begin(), resync.end());
+  double mean = 0;
+  for (size_t i = 0; i < resync.size(); i++) mean += resync[i];
+  if (!resync.empty()) mean /= resync.size();
+  double p99 = resync.empty() ? 0 : resync[std::min(resync.size() - 1, (size_t)(0.99 * resync.size()))];
+
+  printf("%-7s %-10s  events %6zu  delivered %6.2f%%  goodput %9.0f B/s  lost/event %6.3f  "
+         "undetected %4llu  resync mean %8.3f ms  p99 %8.3f ms  parse %7.1f MB/s\n",
+         parser, framing_names[framing], stream.events.size(), 100.0 * result.good / config.frames,
+         result.good * config.size / link_seconds, stream.events.empty() ? 0.0 : (double)lost / stream.events.size(),
+         (unsigned long long)result.undetected, mean * 1e3, p99 * 1e3,
+         result.seconds > 0 ? stream.bytes.size() / result.seconds / 1e6 : 0);
+  fflush(stdout);
+}
+
+static void writeStream(const std::string& prefix, Framing framing, const NoisyStream& stream,
+                        const NoiseConfig& config)
+{
+  std::string base = prefix + "_" + framing_names[framing];
+  std::ofstream bin((base + ".bin").c_str(), std::ios::binary | std::ios::trunc);
+  bin.write(reinterpret_cast<const char*>(&stream.bytes[0]), stream.bytes.size());
+  std::ofstream idx((base + ".idx").c_str(), std::ios::trunc);
+  idx << "frames " << config.frames << " size " << config.size << " baud " << config.baud << "\n";
+  for (size_t i = 0; i < stream.frame_start.size(); i++) {
+    idx << "f " << stream.frame_start[i] << " " << stream.frame_end[i] << "\n";
+  }
+  for (size_t i = 0; i < stream.events.size(); i++) {
+    idx << "e " << stream.events[i] << "\n";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  NoiseConfig config = { 1e-5, 0, 0, 20000, 32, 115200 };
+  std::string prefix;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:d:s:n:l:r:w:")) != -1) {
+    switch (opt) {
+      case 'b': config.bit_error_rate = atof(optarg); break;
+      case 'd': config.drop_rate = atof(optarg); break;
+      case 's': config.sync_rate = atof(optarg); break;
+      case 'n': config.frames = atoi(optarg); break;
+      case 'l': config.size = std::max(10, std::min(atoi(optarg), 1000)); break;
+      case 'r': config.baud = atof(optarg); break;
+      case 'w': prefix = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bit error rate] [-d byte drop rate] [-s spurious sync rate] "
+                "[-n frames] [-l payload bytes] [-r baud] [-w file prefix]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  // The server's warnings about every bad frame would swamp the results.
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Fatal)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+
+  printf("%d frames of %d bytes at %.0f baud; bit error rate %g, drop rate %g, spurious sync rate %g\n",
+         config.frames, config.size, config.baud, config.bit_error_rate, config.drop_rate, config.sync_rate);
+  for (int framing = 0; framing < FRAMING_COUNT; framing++) {
+    NoisyStream stream;
+    makeStream(config, static_cast<Framing>(framing), stream);
+    if (!prefix.empty()) writeStream(prefix, static_cast<Framing>(framing), stream, config);
+
+    Result client = { std::vector<bool>(config.frames), 0, 0, 0 };
+    runClient(stream, config, client);
+    report("client", static_cast<Framing>(framing), stream, config, client);
+
+    Result server = { std::vector<bool>(config.frames), 0, 0, 0 };
+    ServerRun(stream, config, server).run();
+    report("server", static_cast<Framing>(framing), stream, config, server);
+  }
+  return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "rosserial_embeddedlinux/std_msgs/String.h"
+#include "rosserial_embeddedlinux/sensor_msgs/Imu.h"
+#include "rosserial_embeddedlinux/sensor_msgs/JointState.h"
+#include "rosserial_embeddedlinux/sensor_msgs/LaserScan.h"
+#include "rosserial_embeddedlinux/tf/tfMessage.h"
+
+/**
+ * Time taken by the generated serialize() and deserialize() of a few
+ * representative messages, for comparing make_library.py output before and
+ * after a change. Build and run by hand:
+ *
+ *   catkin_make rosserial_test_serialize_benchmark
+ *   rosserial_test_serialize_benchmark [min seconds per measurement]
+ *
+ * It only uses the generated client library and the standard library, so
+ * needs no ROS master. That library is generated with rosserial_embeddedlinux's
+ * type map, so float64 fields are the full doubles a real target serializes.
+ * The rosserial_test_serializer_sizes target reports the code size of the same
+ * messages' serializers.
+ */
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Stops the compiler from optimizing away work whose result is unused.
+static volatile uint32_t sink;
+
+static uint32_t checksum(const unsigned char* buffer, int length)
+{
+  uint32_t sum = 0;
+  for (int i = 0; i < length; i += 16) sum += buffer[i];
+  return sum;
+}
+
+/**
+ * Runs op in batches, doubling the batch size until one takes at least
+ * min_seconds, and returns the time per call in nanoseconds.
+ */
+template<class Op>
+static double nsPerOp(Op op, double min_seconds)
+{
+  for (long iterations = 16; ; iterations *= 2) {
+    double start = now();
+    for (long i = 0; i < iterations; i++) op();
+    double seconds = now() - start;
+    if (seconds >= min_seconds) return seconds * 1e9 / iterations;
+  }
+}
+
+template<class Msg>
+class SerializeOp {
+public:
+  SerializeOp(const Msg& msg, unsigned char* buffer) : msg_(msg), buffer_(buffer) {}
+  void operator()() { sink += msg_.serialize(buffer_); }
+private:
+  const Msg& msg_;
+  unsigned char* buffer_;
+};
+
+// Deserializing NUL-terminates strings in place, which clobbers the input,
+// so each pass starts from a fresh copy of it.
+class CopyOp {
+public:
+  CopyOp(const std::vector<unsigned char>& input, unsigned char* buffer) : input_(input), buffer_(buffer) {}
+  void operator()() { memcpy(buffer_, &input_[0], input_.size()); sink += buffer_[0]; }
+private:
+  const std::vector<unsigned char>& input_;
+  unsigned char* buffer_;
+};
+
+template<class Msg>
+class DeserializeOp {
+public:
+  DeserializeOp(Msg& msg, const std::vector<unsigned char>& input, unsigned char* buffer)
+    : msg_(msg), copy_(input, buffer), buffer_(buffer) {}
+  void operator()() { copy_(); sink += msg_.deserialize(buffer_); }
+private:
+  Msg& msg_;
+  CopyOp copy_;
+  unsigned char* buffer_;
+};
+
+template<class Msg>
+static void benchmark(const char* name, const Msg& msg, double min_seconds)
+{
+  std::vector<unsigned char> buffer(1 << 16);
+  int length = msg.serialize(&buffer[0]);
+  sink += checksum(&buffer[0], length);
+
+  // Deserializing into a message of its own, which keeps any arrays it
+  // allocates on the first pass.
+  Msg copy;
+  std::vector<unsigned char> input(buffer.begin(), buffer.begin() + length);
+  DeserializeOp<Msg>(copy, input, &buffer[0])();
+
+  double serialize_ns = nsPerOp(SerializeOp<Msg>(msg, &buffer[0]), min_seconds);
+  double copy_ns = nsPerOp(CopyOp(input, &buffer[0]), min_seconds);
+  double deserialize_ns = std::max(nsPerOp(DeserializeOp<Msg>(copy, input, &buffer[0]), min_seconds) - copy_ns, 0.0);
+  printf("%-24s %6d bytes  serialize %9.1f ns/op %8.1f MB/s  deserialize %9.1f ns/op %8.1f MB/s\n",
+         name, length, serialize_ns, length / serialize_ns * 1e3, deserialize_ns, length / deserialize_ns * 1e3);
+}
+
+static void fillHeader(std_msgs::Header& header, const char* frame_id)
+{
+  header.seq = 42;
+  header.stamp.sec = 1500000000;
+  header.stamp.nsec = 123456789;
+  header.frame_id = frame_id;
+}
+
+int main(int argc, char** argv)
+{
+  double min_seconds = argc > 1 ? atof(argv[1]) : 0.2;
+
+  std::string text(64, 'x');
+  std_msgs::String string_msg;
+  string_msg.data = text.c_str();
+  benchmark("std_msgs/String", string_msg, min_seconds);
+
+  sensor_msgs::Imu imu;
+  fillHeader(imu.header, "imu_link");
+  imu.orientation.w = 1.0;
+  imu.angular_velocity.z = 0.25;
+  imu.linear_acceleration.z = 9.81;
+  for (int i = 0; i < 9; i++) {
+    imu.orientation_covariance[i] = imu.angular_velocity_covariance[i] =
+      imu.linear_acceleration_covariance[i] = (i % 4 == 0) ? 0.01 : 0.0;
+  }
+  benchmark("sensor_msgs/Imu", imu, min_seconds);
+
+  sensor_msgs::LaserScan scan;
+  fillHeader(scan.header, "laser");
+  scan.angle_min = -3.14159f;
+  scan.angle_max = 3.14159f;
+  scan.angle_increment = 2 * 3.14159f / 360;
+  scan.range_max = 30.0f;
+  std::vector<float> ranges(360), intensities(360);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    ranges[i] = 1.0f + i / 100.0f;
+    intensities[i] = 100.0f;
+  }
+  scan.ranges_length = ranges.size();
+  scan.ranges = &ranges[0];
+  scan.intensities_length = intensities.size();
+  scan.intensities = &intensities[0];
+  benchmark("sensor_msgs/LaserScan", scan, min_seconds);
+
+  const int joints = 6;
+  const char* names[joints] = { "shoulder_pan", "shoulder_lift", "elbow", "wrist_1", "wrist_2", "wrist_3" };
+  sensor_msgs::JointState::_position_type position[joints], velocity[joints], effort[joints];
+  for (int i = 0; i < joints; i++) {
+    position[i] = i * 0.1;
+    velocity[i] = i * 0.01;
+    effort[i] = i;
+  }
+  sensor_msgs::JointState joint_state;
+  fillHeader(joint_state.header, "base_link");
+  joint_state.name_length = joints;
+  joint_state.name = const_cast<char**>(names);
+  joint_state.position_length = joint_state.velocity_length = joint_state.effort_length = joints;
+  joint_state.position = position;
+  joint_state.velocity = velocity;
+  joint_state.effort = effort;
+  benchmark("sensor_msgs/JointState", joint_state, min_seconds);
+
+  const int frames = 4;
+  const char* parents[frames] = { "map", "odom", "base_link", "base_link" };
+  const char* children[frames] = { "odom", "base_link", "laser", "imu_link" };
+  geometry_msgs::TransformStamped transforms[frames];
+  for (int i = 0; i < frames; i++) {
+    fillHeader(transforms[i].header, parents[i]);
+    transforms[i].child_frame_id = children[i];
+    transforms[i].transform.translation.x = i;
+    transforms[i].transform.rotation.w = 1.0;
+  }
+  tf::tfMessage tf_msg;
+  tf_msg.transforms_length = frames;
+  tf_msg.transforms = transforms;
+  benchmark("tf/tfMessage", tf_msg, min_seconds);
+
+  return 0;
+}
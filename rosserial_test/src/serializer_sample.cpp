@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rosserial_test/serializer_sample.h"
+
+// Built against the library generated to serialize inline, and included
+// by serializer_sample_shared.cpp to build against the other.
+#ifndef SAMPLE_NAMESPACE
+#define SAMPLE_NAMESPACE inline_serializers
+namespace inline_serializers {
+#include "rosserial/sensor_msgs/NavSatFix.h"
+#include "rosserial/std_msgs/Int16MultiArray.h"
+#include "rosserial/std_msgs/Int64MultiArray.h"
+#include "rosserial/std_msgs/UInt64.h"
+}
+#endif
+
+namespace SAMPLE_NAMESPACE {
+
+uint32_t serializeSample(unsigned char* buffer)
+{
+  sensor_msgs::NavSatFix fix;
+  fix.header.seq = 0x01020304;
+  fix.header.stamp.sec = 1700000000;
+  fix.header.stamp.nsec = 123456789;
+  fix.header.frame_id = "gps";
+  fix.status.status = -1;
+  fix.status.service = 0x0102;
+  fix.latitude = 51.5;
+  fix.longitude = -0.125;
+  fix.altitude = 12.25;
+  for (int i = 0; i < 9; i++) fix.position_covariance[i] = i * 0.5;
+  fix.position_covariance_type = 2;
+
+  std_msgs::MultiArrayDimension dim;
+  dim.label = "x";
+  dim.size = 3;
+  dim.stride = 3;
+  int64_t wide_data[3] = { -2, 0x0102030405060708LL, 5 };
+  std_msgs::Int64MultiArray wide;
+  wide.layout.dim_length = 1;
+  wide.layout.dim = &dim;
+  wide.layout.data_offset = 1;
+  wide.data_length = 3;
+  wide.data = wide_data;
+
+  int16_t narrow_data[2] = { -300, 7 };
+  std_msgs::Int16MultiArray narrow;
+  narrow.data_length = 2;
+  narrow.data = narrow_data;
+
+  std_msgs::UInt64 value;
+  value.data = 0x1122334455667788ULL;
+
+  uint32_t offset = fix.serialize(buffer);
+  offset += wide.serialize(buffer + offset);
+  offset += narrow.serialize(buffer + offset);
+  offset += value.serialize(buffer + offset);
+  return offset;
+}
+
+uint32_t reserializeSample(unsigned char* buffer, unsigned char* out)
+{
+  sensor_msgs::NavSatFix fix;
+  std_msgs::Int64MultiArray wide;
+  std_msgs::Int16MultiArray narrow;
+  std_msgs::UInt64 value;
+  uint32_t offset = fix.deserialize(buffer);
+  offset += wide.deserialize(buffer + offset);
+  offset += narrow.deserialize(buffer + offset);
+  value.deserialize(buffer + offset);
+
+  offset = fix.serialize(out);
+  offset += wide.serialize(out + offset);
+  offset += narrow.serialize(out + offset);
+  offset += value.serialize(out + offset);
+
+  // Messages don't free the arrays they deserialize into.
+  free(wide.layout.dim);
+  free(wide.data);
+  free(narrow.data);
+  return offset;
+}
+}
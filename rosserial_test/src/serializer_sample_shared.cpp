@@ -0,0 +1,16 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The sample, built against the library generated with shared_serializers.
+#define SAMPLE_NAMESPACE shared_serializers
+namespace shared_serializers {
+#include "rosserial_shared/sensor_msgs/NavSatFix.h"
+#include "rosserial_shared/std_msgs/Int16MultiArray.h"
+#include "rosserial_shared/std_msgs/Int64MultiArray.h"
+#include "rosserial_shared/std_msgs/UInt64.h"
+}
+
+#include "serializer_sample.cpp"
@@ -0,0 +1,25 @@
+/**
+ * Compiled once per message by the rosserial_test_serializer_sizes target,
+ * with SIZE_PACKAGE and SIZE_MESSAGE naming the message, so that the size of
+ * each resulting library is that of one message's generated serialize() and
+ * deserialize(), along with whatever of its nested messages they inline.
+ */
+
+#define SIZE_STRINGIFY(x) #x
+#define SIZE_HEADER(package, message) SIZE_STRINGIFY(rosserial/package/message.h)
+#include SIZE_HEADER(SIZE_PACKAGE, SIZE_MESSAGE)
+
+typedef SIZE_PACKAGE::SIZE_MESSAGE Message;
+
+// The calls are qualified so that they aren't virtual, which would leave the
+// inline definitions unused and so not emitted.
+
+int serializeMessage(const Message& msg, unsigned char* buffer)
+{
+  return msg.Message::serialize(buffer);
+}
+
+int deserializeMessage(Message& msg, unsigned char* buffer)
+{
+  return msg.Message::deserialize(buffer);
+}
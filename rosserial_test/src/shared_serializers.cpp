@@ -0,0 +1,48 @@
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_test/serializer_sample.h"
+
+/**
+ * Messages generated with shared_serializers send the same bytes as those
+ * serialized inline, and read back what either sends.
+ */
+static std::vector<unsigned char> serialized(uint32_t (*serialize)(unsigned char*))
+{
+  // Fields the type map converts fewer bytes of than they take leave the
+  // rest as they were, so start from the same.
+  std::vector<unsigned char> buffer(1024, 0);
+  buffer.resize(serialize(&buffer[0]));
+  return buffer;
+}
+
+static std::vector<unsigned char> reserialized(uint32_t (*reserialize)(unsigned char*, unsigned char*),
+                                               std::vector<unsigned char> buffer)
+{
+  std::vector<unsigned char> out(1024, 0);
+  out.resize(reserialize(&buffer[0], &out[0]));
+  return out;
+}
+
+TEST(SharedSerializers, same_bytes_as_inline)
+{
+  std::vector<unsigned char> inline_bytes = serialized(inline_serializers::serializeSample);
+  std::vector<unsigned char> shared_bytes = serialized(shared_serializers::serializeSample);
+  EXPECT_LT(0u, inline_bytes.size());
+  EXPECT_EQ(inline_bytes, shared_bytes);
+}
+
+TEST(SharedSerializers, round_trip)
+{
+  std::vector<unsigned char> bytes = serialized(inline_serializers::serializeSample);
+  EXPECT_EQ(bytes, reserialized(inline_serializers::reserializeSample, bytes));
+  EXPECT_EQ(bytes, reserialized(shared_serializers::reserializeSample, bytes));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_test/memory_hardware.h"
+
+namespace rosserial {
+#include "rosserial/ros/node_handle.h"
+#include "rosserial/duration.cpp"
+#include "rosserial/time.cpp"
+#include "rosserial/std_msgs/UInt32.h"
+}
+
+/**
+ * Subscriber callbacks which spin again, as ServiceClient::call() does, while
+ * NodeHandle_ holds received frames in more than one slot.
+ */
+typedef rosserial::ros::NodeHandle_<MemoryHardware, 2, 2, 64, 128, 0, 2> HeldFramesNodeHandle;
+
+static HeldFramesNodeHandle* nh = NULL;
+static std::vector<uint32_t> received;
+static uint32_t spin_on = 0;
+
+static void spinningCallback(const rosserial::std_msgs::UInt32& msg)
+{
+  received.push_back(msg.data);
+  if (msg.data == spin_on) {
+    nh->spinOnce();
+  }
+}
+
+static void appendValue(uint32_t value)
+{
+  std::vector<uint8_t> body(4);
+  for (int i = 0; i < 4; i++) body[i] = (value >> (8 * i)) & 0xff;
+  appendFrame(MemoryHardware::in, 100, body);
+}
+
+class SpinReentryTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    MemoryHardware::reset();
+    received.clear();
+    spin_on = 0;
+    nh = &node_handle;
+    node_handle.initNode();
+    node_handle.subscribe(sub);
+  }
+
+  SpinReentryTest() : sub("values", spinningCallback) {}
+
+  HeldFramesNodeHandle node_handle;
+  rosserial::ros::Subscriber<rosserial::std_msgs::UInt32> sub;
+};
+
+TEST_F(SpinReentryTest, frames_dispatched_once_in_order) {
+  // Two frames fill both slots; the callback for the first spins, and finds the
+  // third and fourth.
+  for (uint32_t value = 1; value <= 4; value++) appendValue(value);
+  spin_on = 1;
+  node_handle.spinOnce();
+
+  std::vector<uint32_t> expected;
+  for (uint32_t value = 1; value <= 4; value++) expected.push_back(value);
+  EXPECT_EQ(expected, received);
+}
+
+TEST_F(SpinReentryTest, spin_from_last_held_frame) {
+  // The callback for the second frame spins with none held, and receives the
+  // next two; the fifth waits for the next spin.
+  for (uint32_t value = 1; value <= 5; value++) appendValue(value);
+  spin_on = 2;
+  node_handle.spinOnce();
+
+  std::vector<uint32_t> expected;
+  for (uint32_t value = 1; value <= 4; value++) expected.push_back(value);
+  EXPECT_EQ(expected, received);
+
+  node_handle.spinOnce();
+  expected.push_back(5);
+  EXPECT_EQ(expected, received);
+}
+
+TEST_F(SpinReentryTest, partial_frame_carried_through_nested_spin) {
+  appendValue(1);
+  appendValue(2);
+  appendValue(3);
+  // The third frame arrives in two parts, the second once the callback spins.
+  size_t cut = MemoryHardware::in.size() - 5;
+  std::vector<uint8_t> rest(MemoryHardware::in.begin() + cut, MemoryHardware::in.end());
+  MemoryHardware::in.resize(cut);
+  spin_on = 2;
+
+  node_handle.spinOnce(2);
+  EXPECT_EQ(2u, received.size());
+  MemoryHardware::in.insert(MemoryHardware::in.end(), rest.begin(), rest.end());
+  node_handle.spinOnce();
+
+  std::vector<uint32_t> expected;
+  for (uint32_t value = 1; value <= 3; value++) expected.push_back(value);
+  EXPECT_EQ(expected, received);
+}
+
+TEST_F(SpinReentryTest, held_frames_dispatched_on_timeout) {
+  // One frame, then line noise for longer than the spin may take.
+  appendValue(1);
+  MemoryHardware::in.insert(MemoryHardware::in.end(), 40, 0x55);
+  MemoryHardware::millis_per_read = 1;
+  node_handle.setSpinTimeout(20);
+  EXPECT_EQ(rosserial::ros::SPIN_TIMEOUT, node_handle.spinOnce());
+  EXPECT_EQ(1u, received.size());
+}
+
+TEST_F(SpinReentryTest, held_frames_dispatched_before_topics_request) {
+  appendValue(1);
+  appendFrame(MemoryHardware::in, rosserial::rosserial_msgs::TopicInfo::ID_PUBLISHER, std::vector<uint8_t>());
+  appendValue(2);
+  EXPECT_EQ(rosserial::ros::SPIN_ERR, node_handle.spinOnce());
+  EXPECT_EQ(1u, received.size());
+  node_handle.spinOnce();
+  EXPECT_EQ(2u, received.size());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "rosserial_test/memory_hardware.h"
+
+namespace rosserial {
+#include "rosserial/ros/node_handle.h"
+#include "rosserial/duration.cpp"
+#include "rosserial/time.cpp"
+#include "rosserial/std_msgs/UInt32.h"
+}
+
+/**
+ * A NodeHandle_ given its subscribers at compile time, which calls them back
+ * directly, alongside one subscribed as usual.
+ */
+static std::vector<uint32_t> first_received;
+static std::vector<uint32_t> second_received;
+static std::vector<uint32_t> other_received;
+
+static void firstCallback(const rosserial::std_msgs::UInt32& msg) { first_received.push_back(msg.data); }
+static void secondCallback(const rosserial::std_msgs::UInt32& msg) { second_received.push_back(msg.data); }
+static void otherCallback(const rosserial::std_msgs::UInt32& msg) { other_received.push_back(msg.data); }
+
+typedef rosserial::ros::Subscriber<rosserial::std_msgs::UInt32> UInt32Subscriber;
+UInt32Subscriber first_sub("first", firstCallback);
+UInt32Subscriber second_sub("second", secondCallback);
+UInt32Subscriber other_sub("other", otherCallback);
+
+typedef rosserial::ros::StaticSubscriber<UInt32Subscriber, &first_sub,
+        rosserial::ros::StaticSubscriber<UInt32Subscriber, &second_sub> > Subscribers;
+typedef rosserial::ros::NodeHandle_<MemoryHardware, Subscribers::COUNT + 1, 1, 64, 128,
+                                    0, 1, 0, 0, 0, Subscribers> StaticNodeHandle;
+
+static void appendValue(uint16_t topic_id, uint32_t value)
+{
+  std::vector<uint8_t> body(4);
+  for (int i = 0; i < 4; i++) body[i] = (value >> (8 * i)) & 0xff;
+  appendFrame(MemoryHardware::in, topic_id, body);
+}
+
+TEST(StaticSubscribers, count)
+{
+  EXPECT_EQ(2, Subscribers::COUNT);
+  EXPECT_EQ(0, rosserial::ros::DynamicSubscribers::COUNT);
+}
+
+TEST(StaticSubscribers, frames_reach_their_subscribers)
+{
+  MemoryHardware::reset();
+  StaticNodeHandle nh;
+  nh.initNode();
+  // Subscribed in a different order from the list, and with one not on it.
+  nh.subscribe(second_sub);
+  nh.subscribe(other_sub);
+  nh.subscribe(first_sub);
+
+  appendValue(first_sub.id_, 1);
+  appendValue(second_sub.id_, 2);
+  appendValue(other_sub.id_, 3);
+  appendValue(first_sub.id_, 4);
+  for (int i = 0; i < 4; i++) nh.spinOnce();
+
+  ASSERT_EQ(2u, first_received.size());
+  EXPECT_EQ(1u, first_received[0]);
+  EXPECT_EQ(4u, first_received[1]);
+  ASSERT_EQ(1u, second_received.size());
+  EXPECT_EQ(2u, second_received[0]);
+  ASSERT_EQ(1u, other_received.size());
+  EXPECT_EQ(3u, other_received[0]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -30,6 +30,15 @@
 
 tRingBufObject rxBuffer;
 tRingBufObject txBuffer;
+
+#ifdef USE_UART_DMA
+#include <driverlib/udma.h>
+
+// uDMA requires its channel control table to be 1024 byte aligned.
+tDMAControlTable psDMAControlTable[64] __attribute__((aligned(1024)));
+volatile uint32_t g_ui32txDMALength = 0;
+volatile bool g_btxDMAAsync = false;
+#endif
 #endif
 
 volatile uint32_t g_ui32milliseconds = 0;
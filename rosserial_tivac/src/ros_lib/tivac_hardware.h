@@ -28,6 +28,8 @@
 // * 2 LEDs if desired
 // * One UART port, interrupt driven transfers
 // * Two RingBuffers of TX_BUFFER_SIZE and RX_BUFFER_SIZE
+// * With USE_UART_DMA, two uDMA channels and the UART FIFOs instead of one
+//   interrupt per character
 // * Systick Interrupt handler
 //
 //*****************************************************************************
@@ -50,6 +52,10 @@ extern "C"
   #include <driverlib/pin_map.h>
   #include <driverlib/uart.h>
   #include <utils/ringbuf.h>
+#ifdef USE_UART_DMA
+  #include <inc/hw_uart.h>
+  #include <driverlib/udma.h>
+#endif
 }
 
 #define SYSTICKHZ  1000UL
@@ -75,8 +81,22 @@ extern "C"
 #define ROSSERIAL_BAUDRATE 57600
 #endif
 
+#ifdef USE_UART_DMA
+// The receive buffer is split in two halves that uDMA fills in ping-pong mode,
+// and one uDMA transfer moves at most 1024 items.
+#if (RX_BUFFER_SIZE % 2) || (RX_BUFFER_SIZE > 2048)
+#error "With USE_UART_DMA, RX_BUFFER_SIZE must be even and at most 2048"
+#endif
+#define UART_DMA_MAX_TRANSFER 1024
+#endif
+
 extern tRingBufObject rxBuffer;
 extern tRingBufObject txBuffer;
+#ifdef USE_UART_DMA
+extern tDMAControlTable psDMAControlTable[64];
+extern volatile uint32_t g_ui32txDMALength;
+extern volatile bool g_btxDMAAsync;
+#endif
 extern volatile uint32_t g_ui32milliseconds;
 extern volatile uint32_t g_ui32heartbeat;
 
@@ -123,17 +143,56 @@ class TivaCHardware
       // Configure UART0
       MAP_UARTConfigSetExpClk(UART0_BASE, this->ui32SysClkFreq, ROSSERIAL_BAUDRATE,
           (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE));
-      // Supposedely MCU resets with FIFO 1 byte depth. Just making sure.
-      MAP_UARTFIFODisable(UART0_BASE);
       // UART buffers to transmit and receive
       RingBufInit(&rxBuffer, this->ui8rxBufferData, RX_BUFFER_SIZE);
       RingBufInit(&txBuffer, this->ui8txBufferData, TX_BUFFER_SIZE);
+#ifdef USE_UART_DMA
+      // Let uDMA empty and fill the FIFOs, half of them at a time.
+      MAP_UARTFIFOEnable(UART0_BASE);
+      MAP_UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+
+      MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+      MAP_uDMAEnable();
+      MAP_uDMAControlBaseSet(psDMAControlTable);
+
+      // RX runs forever, in ping-pong mode over both halves of rxBuffer.
+      // Single requests are left enabled, so each character is moved out of
+      // the FIFO as soon as it arrives, and read() finds it by asking uDMA
+      // how far it got into the current half. That serves the purpose of
+      // idle-line detection without waiting for the RX timeout.
+      MAP_uDMAChannelAttributeDisable(UDMA_CHANNEL_UART0RX, UDMA_ATTR_ALL);
+      MAP_uDMAChannelControlSet(UDMA_CHANNEL_UART0RX | UDMA_PRI_SELECT,
+          UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4);
+      MAP_uDMAChannelControlSet(UDMA_CHANNEL_UART0RX | UDMA_ALT_SELECT,
+          UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4);
+      TivaCHardware::startRxDMA(UDMA_PRI_SELECT);
+      TivaCHardware::startRxDMA(UDMA_ALT_SELECT);
+      MAP_uDMAChannelEnable(UDMA_CHANNEL_UART0RX);
+
+      // TX sends whatever is contiguous in txBuffer in one basic transfer.
+      MAP_uDMAChannelAttributeDisable(UDMA_CHANNEL_UART0TX, UDMA_ATTR_ALL);
+      MAP_uDMAChannelControlSet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT,
+          UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+      g_ui32txDMALength = 0;
+
+      MAP_UARTDMAEnable(UART0_BASE, UART_DMA_RX | UART_DMA_TX);
+
+      // Interrupt only when a transfer completes
+      UARTIntRegister(UART0_BASE, TivaCHardware::UARTIntHandler);
+      MAP_IntEnable(INT_UART0);
+#ifdef TM4C1294XL
+      MAP_UARTIntEnable(UART0_BASE, UART_INT_DMARX | UART_INT_DMATX);
+#endif
+#else
+      // Supposedely MCU resets with FIFO 1 byte depth. Just making sure.
+      MAP_UARTFIFODisable(UART0_BASE);
 
       // Enable RX and TX interrupt
       UARTIntRegister(UART0_BASE, TivaCHardware::UARTIntHandler);
       MAP_IntEnable(INT_UART0);
       MAP_UARTTxIntModeSet(UART0_BASE, UART_TXINT_MODE_EOT);
       MAP_UARTIntEnable(UART0_BASE, UART_INT_RX | UART_INT_TX);
+#endif
 
       // Enable processor interrupts.
       MAP_IntMasterEnable();
@@ -142,6 +201,10 @@ class TivaCHardware
     // read a byte from the serial port. -1 = failure
     int read()
     {
+#ifdef USE_UART_DMA
+      // uDMA is the writer of rxBuffer, so catch up with it first.
+      rxBuffer.ui32WriteIndex = TivaCHardware::rxDMAPosition();
+#endif
       if (!RingBufEmpty(&rxBuffer))
         return RingBufReadOne(&rxBuffer);
       else
@@ -151,6 +214,15 @@ class TivaCHardware
     // write data to the connection to ROS
     void write(uint8_t* data, int length)
     {
+#ifdef USE_UART_DMA
+      RingBufWrite(&txBuffer, data, length);
+      // Start sending, unless a transfer is already running, in which case the
+      // interrupt handler will pick these bytes up once it is done.
+      MAP_IntDisable(INT_UART0);
+      if (g_ui32txDMALength == 0)
+        TivaCHardware::startTxDMA();
+      MAP_IntEnable(INT_UART0);
+#else
       // Trigger sending buffer, if not already sending
       if (RingBufEmpty(&txBuffer))
       {
@@ -161,18 +233,132 @@ class TivaCHardware
       {
         RingBufWrite(&txBuffer, data, length);
       }        
+#endif
+    }
+
+#ifdef USE_UART_DMA
+    // Sends a frame by uDMA straight from the caller's buffer, which is left
+    // alone until writeDone(), once txBuffer has gone out ahead of it. Bytes
+    // written meanwhile queue up in txBuffer behind it.
+    void writeAsync(uint8_t* data, int length)
+    {
+      if (length > UART_DMA_MAX_TRANSFER)
+      {
+        write(data, length);
+        return;
+      }
+      while (g_ui32txDMALength != 0)
+        ;
+      MAP_IntDisable(INT_UART0);
+      g_btxDMAAsync = true;
+      g_ui32txDMALength = length;
+      MAP_uDMAChannelTransferSet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+          data, (void *)(UART0_BASE + UART_O_DR), length);
+      MAP_uDMAChannelEnable(UDMA_CHANNEL_UART0TX);
+      MAP_IntEnable(INT_UART0);
     }
 
+    bool writeDone()
+    {
+      return !g_btxDMAAsync;
+    }
+#endif
+
     // returns milliseconds since start of program
     uint32_t time()
     {
       return g_ui32milliseconds;
     }
 
+    // returns microseconds since start of program, from how far SysTick has
+    // counted down through the current millisecond
+    uint32_t time_us()
+    {
+      uint32_t ms, ticks;
+      do
+      {
+        ms = g_ui32milliseconds;
+        ticks = MAP_SysTickValueGet();
+      }
+      while (ms != g_ui32milliseconds);
+      uint32_t period = this->ui32SysClkFreq / SYSTICKHZ;
+      return ms * 1000UL + (period - 1 - ticks) * 1000UL / period;
+    }
+
     // UART buffer structures
     uint8_t ui8rxBufferData[RX_BUFFER_SIZE];
     uint8_t ui8txBufferData[TX_BUFFER_SIZE];
 
+#ifdef USE_UART_DMA
+    // Points one half of rxBuffer's uDMA ping-pong transfer at its half again.
+    static void startRxDMA(uint32_t ui32Half)
+    {
+      uint32_t ui32HalfSize = RX_BUFFER_SIZE / 2;
+      uint8_t* pui8Dst = rxBuffer.pui8Buf + (ui32Half == UDMA_ALT_SELECT ? ui32HalfSize : 0);
+      MAP_uDMAChannelTransferSet(UDMA_CHANNEL_UART0RX | ui32Half, UDMA_MODE_PINGPONG,
+          (void *)(UART0_BASE + UART_O_DR), pui8Dst, ui32HalfSize);
+    }
+
+    // Index in rxBuffer that uDMA will write the next received byte to.
+    static uint32_t rxDMAPosition()
+    {
+      uint32_t ui32Alt, ui32Remaining;
+      // Retry if uDMA switched halves while we were looking.
+      do
+      {
+        ui32Alt = MAP_uDMAChannelAttributeGet(UDMA_CHANNEL_UART0RX) & UDMA_ATTR_ALTSELECT;
+        ui32Remaining = MAP_uDMAChannelSizeGet(UDMA_CHANNEL_UART0RX |
+            (ui32Alt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT));
+      }
+      while (ui32Alt != (MAP_uDMAChannelAttributeGet(UDMA_CHANNEL_UART0RX) & UDMA_ATTR_ALTSELECT));
+      uint32_t ui32End = ui32Alt ? RX_BUFFER_SIZE : RX_BUFFER_SIZE / 2;
+      return (ui32End - ui32Remaining) % RX_BUFFER_SIZE;
+    }
+
+    // Sends the bytes at the start of txBuffer that are contiguous in memory.
+    // Must not race with UARTIntHandler.
+    static void startTxDMA()
+    {
+      uint32_t ui32Length = RingBufContigUsed(&txBuffer);
+      if (ui32Length > UART_DMA_MAX_TRANSFER)
+        ui32Length = UART_DMA_MAX_TRANSFER;
+      g_ui32txDMALength = ui32Length;
+      if (ui32Length == 0)
+        return;
+      MAP_uDMAChannelTransferSet(UDMA_CHANNEL_UART0TX | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+          txBuffer.pui8Buf + txBuffer.ui32ReadIndex, (void *)(UART0_BASE + UART_O_DR), ui32Length);
+      MAP_uDMAChannelEnable(UDMA_CHANNEL_UART0TX);
+    }
+
+    // UART interrupt handler, with uDMA.
+    // When a receive half fills up, rearm it while uDMA writes to the other one.
+    // When a send completes, move on to whatever has been queued since.
+    static void UARTIntHandler()
+    {
+      uint32_t ui32Status;
+      ui32Status = MAP_UARTIntStatus(UART0_BASE, true);
+      MAP_UARTIntClear(UART0_BASE, ui32Status);
+
+      if (MAP_uDMAChannelModeGet(UDMA_CHANNEL_UART0RX | UDMA_PRI_SELECT) == UDMA_MODE_STOP)
+        TivaCHardware::startRxDMA(UDMA_PRI_SELECT);
+      if (MAP_uDMAChannelModeGet(UDMA_CHANNEL_UART0RX | UDMA_ALT_SELECT) == UDMA_MODE_STOP)
+        TivaCHardware::startRxDMA(UDMA_ALT_SELECT);
+
+      if (g_ui32txDMALength && !MAP_uDMAChannelIsEnabled(UDMA_CHANNEL_UART0TX))
+      {
+        if (g_btxDMAAsync)
+          g_btxDMAAsync = false;
+        else
+          RingBufAdvanceRead(&txBuffer, g_ui32txDMALength);
+        TivaCHardware::startTxDMA();
+      }
+
+#ifdef LED_COMM
+      // Blink the LED to show a transfer is occuring.
+      MAP_GPIOPinWrite(LED_PORT, LED2, MAP_GPIOPinRead(LED_PORT, LED2)^LED2);
+#endif
+    }
+#else
     // UARD interrupt handler
     // For each received byte, pushes it into the buffer.
     // For each transmitted byte, read the next available from the buffer.
@@ -200,6 +386,7 @@ class TivaCHardware
       MAP_GPIOPinWrite(LED_PORT, LED2, MAP_GPIOPinRead(LED_PORT, LED2)^LED2);
 #endif
     }
+#endif
 
     // Timing variables and System Tick interrupt handler.
     static void SystickIntHandler()
@@ -37,6 +37,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 extern "C"
 {
   #include <inc/hw_types.h>
@@ -59,6 +60,18 @@ extern "C"
 
 #define SYSTICKHZ  1000UL
 
+// Written bytes are gathered into whole bulk packets before they are handed to
+// the USB stack, which otherwise sends whatever it has, however little, in each
+// packet. A partial packet goes out as spinOnce() returns, or once it is
+// TIVAC_USB_FLUSH_MS old, checked whenever the node handle reads; 0 sends it
+// at the next read.
+#ifndef TIVAC_USB_PACKET_SIZE
+#define TIVAC_USB_PACKET_SIZE 64
+#endif
+#ifndef TIVAC_USB_FLUSH_MS
+#define TIVAC_USB_FLUSH_MS 1
+#endif
+
 #ifdef TM4C123GXL
 #define LED1        GPIO_PIN_3  // Green LED
 #define LED2        GPIO_PIN_2  // Blue LED
@@ -82,7 +95,7 @@ extern volatile uint32_t g_ui32heartbeat;
 class TivaCHardware
 {
   public:
-    TivaCHardware() {}
+    TivaCHardware() : tx_length_(0), tx_stamp_(0) {}
 
     void init()
     {
@@ -144,6 +157,7 @@ class TivaCHardware
     // read a byte from the serial port. -1 = failure
     int read()
     {
+      flushStale();
       uint8_t ui8ReadData;
       if (USBBufferRead(&g_sRxBuffer, &ui8ReadData, 1) == 1)
       {
@@ -157,6 +171,20 @@ class TivaCHardware
         return -1;
     }
 
+    // read up to length bytes at once, for the node handle to drain the
+    // receive buffer a chunk at a time. -1 = nothing to read
+    int read(uint8_t* data, int length)
+    {
+      flushStale();
+      uint32_t count = USBBufferRead(&g_sRxBuffer, data, length);
+      if (count == 0)
+        return -1;
+#ifdef LED_COMM
+      MAP_GPIOPinWrite(LED_PORT, LED2, MAP_GPIOPinRead(LED_PORT, LED2)^LED2);
+#endif
+      return count;
+    }
+
     // write data to the connection to ROS
     void write(uint8_t* data, int length)
     {
@@ -164,9 +192,42 @@ class TivaCHardware
       // Blink the LED to show a character transfer is occuring.
       MAP_GPIOPinWrite(LED_PORT, LED2, MAP_GPIOPinRead(LED_PORT, LED2)^LED2);
 #endif
-      // Let's assume for now all length is available for storage in the buffer.
-      // Otherwise must use: USBBufferSpaceAvailable
-      USBBufferWrite(&g_sTxBuffer, data, length);
+      while (length > 0)
+      {
+        int count = TIVAC_USB_PACKET_SIZE - this->tx_length_;
+        if (count > length)
+          count = length;
+        if (this->tx_length_ == 0)
+          this->tx_stamp_ = g_ui32milliseconds;
+        memcpy(this->tx_packet_ + this->tx_length_, data, count);
+        this->tx_length_ += count;
+        data += count;
+        length -= count;
+        if (this->tx_length_ == TIVAC_USB_PACKET_SIZE)
+        {
+          flush();
+          // As before, what doesn't fit in the transmit buffer is dropped.
+          if (this->tx_length_ == TIVAC_USB_PACKET_SIZE)
+            return;
+        }
+      }
+    }
+
+    // hands the partial packet being gathered to the USB stack now
+    void flush()
+    {
+      if (this->tx_length_ == 0)
+        return;
+      int written = USBBufferWrite(&g_sTxBuffer, this->tx_packet_, this->tx_length_);
+      this->tx_length_ -= written;
+      memmove(this->tx_packet_, this->tx_packet_ + written, this->tx_length_);
+    }
+
+    // bytes which can be written without any being dropped, for a transmit queue
+    int availableForWrite()
+    {
+      int space = USBBufferSpaceAvailable(&g_sTxBuffer) - this->tx_length_;
+      return space > 0 ? space : 0;
     }
 
     // returns milliseconds since start of program
@@ -175,6 +236,21 @@ class TivaCHardware
       return g_ui32milliseconds;
     }
 
+    // returns microseconds since start of program, from how far SysTick has
+    // counted down through the current millisecond
+    uint32_t time_us()
+    {
+      uint32_t ms, ticks;
+      do
+      {
+        ms = g_ui32milliseconds;
+        ticks = MAP_SysTickValueGet();
+      }
+      while (ms != g_ui32milliseconds);
+      uint32_t period = this->ui32SysClkFreq / SYSTICKHZ;
+      return ms * 1000UL + (period - 1 - ticks) * 1000UL / period;
+    }
+
     // Timing variables and System Tick interrupt handler.
     static void SystickIntHandler()
     {
@@ -206,5 +282,16 @@ class TivaCHardware
       }
       MAP_SysCtlDelay(this->ui32SysClkFreq/3/SYSTICKHZ * ms);
     }
+
+  private:
+    void flushStale()
+    {
+      if (this->tx_length_ > 0 && g_ui32milliseconds - this->tx_stamp_ >= TIVAC_USB_FLUSH_MS)
+        flush();
+    }
+
+    uint8_t tx_packet_[TIVAC_USB_PACKET_SIZE];
+    int tx_length_;
+    uint32_t tx_stamp_;
 };
 #endif  // ROS_LIB_TIVAC_HARDWARE_USB_H
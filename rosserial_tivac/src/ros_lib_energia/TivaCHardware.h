@@ -78,6 +78,7 @@ class TivaCHardware {
     }
 
     unsigned long time(){return millis();}
+    unsigned long time_us(){return micros();}
 
   protected:
     SERIAL_CLASS* iostream;
@@ -125,7 +125,7 @@ endfunction()
 # Generates targets based on options and definitions
 function(GENERATE_TIVAC_FIRMWARE)
   message(STATUS "[TIVAC] Generating firmware ${CMAKE_PROJECT_NAME}")
-  set(options USB)
+  set(options USB DMA)
   set(oneValueArgs BOARD STARTUP DEVICE_SILICON DEVICE_SERIAL)
   set(multiValueArgs SRCS INCS LIBS)
   cmake_parse_arguments(INPUT "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
@@ -155,6 +155,8 @@ function(GENERATE_TIVAC_FIRMWARE)
     list(APPEND OTHER_LIBS usblib)
     list(APPEND OTHER_SRCS ${ROS_LIB_DIR}/usb_serial_structs.c)
     add_dependencies(usblib build_usblib)
+  elseif(INPUT_DMA)
+    add_definitions(-DUSE_UART_DMA)
   endif()
   
   if(INPUT_STARTUP)
@@ -51,18 +51,28 @@ class CortexHardware {
 
     // read a byte from the serial port. -1 = failure
     int read() {
-      if(fcount(stdin) != 0) {
+      if(vexrosavailable() != 0) {
         int c = vexrosreadchar();
         return c;
       }
       return -1;
     }
 
-    // write data to the connection to ROS
-    void write(uint8_t* data, int length) {
-      for(int i = 0; i < length; i++) {
-        vexroswritechar(data[i]);
+    // read up to length bytes from the serial port, returning how many.
+    // NodeHandle takes its input through this, a chunk per call into the
+    // driver rather than a byte; only what has arrived is asked for, so
+    // that it never blocks.
+    int read(uint8_t* data, int length) {
+      int available = vexrosavailable();
+      if(available <= 0) {
+        return -1;
       }
+      return vexrosreadbytes(data, available < length ? available : length);
+    }
+
+    // write data to the connection to ROS, a whole frame per call into the driver.
+    void write(uint8_t* data, int length) {
+      vexroswritebytes(data, length);
     }
 
     // returns milliseconds since start of program
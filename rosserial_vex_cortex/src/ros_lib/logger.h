@@ -29,6 +29,11 @@
 #define vexroswritechar(ch) fputc(ch, VEXROS_ROSSERIAL_OUTPUT_SERIAL)
 #define vexrosreadchar() fgetc(VEXROS_ROSSERIAL_INPUT_SERIAL)
 
+// bulk versions of the above, each one call into the UART driver however many bytes.
+#define vexroswritebytes(data, length) fwrite(data, 1, length, VEXROS_ROSSERIAL_OUTPUT_SERIAL)
+#define vexrosreadbytes(data, length) fread(data, 1, length, VEXROS_ROSSERIAL_INPUT_SERIAL)
+#define vexrosavailable() fcount(VEXROS_ROSSERIAL_INPUT_SERIAL)
+
 // will only print if debug mode is on (see top of this file).
 #define vexroslogdebug(fmtstr, ...) { \
   if(DEBUG_MODE) { \
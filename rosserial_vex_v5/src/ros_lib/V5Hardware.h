@@ -36,15 +36,18 @@
 #define _ROSSERIAL_VEX_V5_V5_HARDWARE_H_
 
 #include "main.h"
-#include "ros_lib/rosserial_vex_v5/utils/RingBuf.h"
+#include "ros_lib/rosserial_vex_v5/utils/SpscRingBuf.h"
 
-// for the mutex.
+// for fdctl.
 #include "pros/apix.h"
 
 #define SERIAL_CLASS int
-#define ROSVEX_BUFFER_INPUT_SIZE 32
+#ifndef ROSVEX_BUFFER_INPUT_SIZE
+#define ROSVEX_BUFFER_INPUT_SIZE 512
+#endif
+#define ROSVEX_READ_CHUNK_SIZE 64
 
-using RB = RingBufCPP<char, ROSVEX_BUFFER_INPUT_SIZE>;
+using RB = SpscRingBuf<uint8_t, ROSVEX_BUFFER_INPUT_SIZE>;
 
 // load the serial reading into a buffer.
 inline void vexRosBufferInput(void* arg) {
@@ -53,17 +56,37 @@ inline void vexRosBufferInput(void* arg) {
   RB* inputBuffer = (RB*) arglist[0];
   __FILE* streamOut = (__FILE*) arglist[1];
 
-  int readcount = 0;
+  uint8_t chunk[ROSVEX_READ_CHUNK_SIZE];
   while(1) {
-    char c =  fgetc(streamOut);
-    inputBuffer->add(c);
+    // block for one byte, then take whatever else has already arrived with it.
+    int c = fgetc(streamOut);
+    if (c == EOF) {
+      pros::delay(1);
+      continue;
+    }
+    chunk[0] = c;
+    uint32_t length = 1;
+    int32_t available = fdctl(fileno(streamOut), DEVCTL_FIONREAD, NULL);
+    if (available > 0) {
+      uint32_t wanted = (available < ROSVEX_READ_CHUNK_SIZE - 1) ? available : ROSVEX_READ_CHUNK_SIZE - 1;
+      length += fread(chunk + 1, 1, wanted, streamOut);
+    }
+
+    // wait for the node handle to make room rather than dropping bytes.
+    uint32_t pushed = 0;
+    while (true) {
+      pushed += inputBuffer->push(chunk + pushed, length - pushed);
+      if (pushed == length)
+        break;
+      pros::delay(1);
+    }
   }
 }
 
 class V5Hardware {
 
   public:
-    V5Hardware(): rosvexMutex(), inputBuffer(rosvexMutex), failCount(), successCount() {
+    V5Hardware(): inputBuffer(), failCount(), successCount() {
     }
 
     // any initialization code necessary to use the serial port
@@ -83,21 +106,24 @@ class V5Hardware {
 
     // read a byte from the serial port. -1 = failure
     int read() {
-      char c;
+      uint8_t c;
       // pull serial reading out of the buffer.
-      if(inputBuffer.pull(&c)) {
-        char sucmsg[16];
+      if(inputBuffer.pull(&c, 1)) {
         return c;
       }
 
       return -1;
     }
 
+    // read up to length bytes from the serial port, returning how many.
+    int read(uint8_t* data, int length) {
+      return inputBuffer.pull(data, length);
+    }
+
     // write data to the connection to ROS
     void write(uint8_t* data, int length) {
-      for(int i = 0; i < length; i++) {
-        vexroswritechar(data[i]);
-      }
+      fwrite(data, 1, length, rosFile);
+      fflush(rosFile);
     }
     // returns milliseconds since start of program
     unsigned long time() {
@@ -106,16 +132,9 @@ class V5Hardware {
   private:
     int failCount;
     int successCount;
-    pros::Mutex rosvexMutex;
     __FILE * rosFile;
     RB inputBuffer;
 
-    // writing helper.
-    void vexroswritechar(uint8_t data) {
-      fputc(data, rosFile);
-      fflush(rosFile);
-    }
-    
     // reading helper.
     char vexrosreadchar() {
       return fgetc(rosFile);
@@ -0,0 +1,105 @@
+/* 
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2026, rosserial contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *  * Neither the name of Willow Garage, Inc. nor the names of its
+ *    contributors may be used to endorse or promote prducts derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROSSERIAL_VEX_V5_SPSC_RING_BUF_H_
+#define _ROSSERIAL_VEX_V5_SPSC_RING_BUF_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// A ring buffer with one task adding to it and one other task taking from it,
+// which needs no lock: only the producer moves head_, and only the consumer
+// moves tail_. Both count up forever, and are masked down to an index, so
+// SIZE must be a power of two.
+template <typename Type, uint32_t SIZE>
+class SpscRingBuf {
+  static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two");
+
+  public:
+    SpscRingBuf(): head_(0), tail_(0) {}
+
+    // Adds up to length elements, returning how many fit. Producer only.
+    uint32_t push(const Type* data, uint32_t length) {
+      uint32_t head = head_.load(std::memory_order_relaxed);
+      uint32_t room = SIZE - (head - tail_.load(std::memory_order_acquire));
+      if (length > room)
+        length = room;
+      copyIn(head, data, length);
+      head_.store(head + length, std::memory_order_release);
+      return length;
+    }
+
+    // Takes up to length elements, returning how many there were. Consumer only.
+    uint32_t pull(Type* data, uint32_t length) {
+      uint32_t tail = tail_.load(std::memory_order_relaxed);
+      uint32_t used = head_.load(std::memory_order_acquire) - tail;
+      if (length > used)
+        length = used;
+      copyOut(tail, data, length);
+      tail_.store(tail + length, std::memory_order_release);
+      return length;
+    }
+
+    uint32_t size() const {
+      return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    uint32_t room() const {
+      return SIZE - size();
+    }
+
+  private:
+    // The ring wraps at most once within length elements, so each copy is
+    // done in at most two pieces.
+    void copyIn(uint32_t position, const Type* data, uint32_t length) {
+      uint32_t index = position & (SIZE - 1);
+      uint32_t first = (SIZE - index < length) ? SIZE - index : length;
+      memcpy(buf_ + index, data, first * sizeof(Type));
+      memcpy(buf_, data + first, (length - first) * sizeof(Type));
+    }
+
+    void copyOut(uint32_t position, Type* data, uint32_t length) const {
+      uint32_t index = position & (SIZE - 1);
+      uint32_t first = (SIZE - index < length) ? SIZE - index : length;
+      memcpy(data, buf_ + index, first * sizeof(Type));
+      memcpy(data + first, buf_, (length - first) * sizeof(Type));
+    }
+
+    Type buf_[SIZE];
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+};
+
+#endif
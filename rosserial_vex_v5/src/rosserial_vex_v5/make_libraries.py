@@ -83,7 +83,7 @@ rospack = rospkg.RosPack()
 
 # copy ros_lib stuff in
 rosserial_vex_v5_dir = rospack.get_path(THIS_PACKAGE)
-shutil.copytree(rosserial_vex_v5_dir+"/src/ros_lib", path+"/ros_lib")
+rosserial_copy_tree(rosserial_vex_v5_dir+"/src/ros_lib", path+"/ros_lib")
 rosserial_client_copy_files(rospack, path+"/ros_lib/")
 
 # generate messages
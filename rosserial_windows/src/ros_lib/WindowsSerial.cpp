@@ -0,0 +1,416 @@
+/**
+Software License Agreement (BSD)
+
+\file      WindowsSerial.cpp
+\copyright Copyright (c) 2026, rosserial contributors, All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the 
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "WindowsSerial.h"
+#include <string>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define DEFAULT_BAUD 57600
+
+// Frames queued while a write is in flight beyond this many bytes make write()
+// wait for it, rather than queue without bound on a link which can't keep up.
+#define MAX_QUEUED_BYTES 65536
+
+using std::string;
+
+
+class WindowsSerialImpl
+{
+
+public:
+
+  WindowsSerialImpl () : port (INVALID_HANDLE_VALUE), rx_head (0), rx_tail (0), rx_pending (false),
+                         tx_pending (false), wait_pending (false)
+  {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency (&frequency);
+    counts_per_second = frequency.QuadPart;
+    ZeroMemory (&rx_overlapped, sizeof (rx_overlapped));
+    ZeroMemory (&tx_overlapped, sizeof (tx_overlapped));
+    ZeroMemory (&wait_overlapped, sizeof (wait_overlapped));
+  }
+
+  ~WindowsSerialImpl ()
+  {
+    close ();
+  }
+
+  void init (char *port_name)
+  {
+    // split off the baud rate if given
+    string name = port_name;
+    int c = name.find_last_of (':');
+    DWORD baud = (c < 0) ? DEFAULT_BAUD : strtoul (name.substr (c + 1).c_str (), NULL, 10);
+    if (c >= 0)
+    {
+      name = name.substr (0, c);
+    }
+    // COM10 and above can only be opened by their device path
+    if (name.compare (0, 4, "\\\\.\\") != 0)
+    {
+      name = "\\\\.\\" + name;
+    }
+
+    port = CreateFileA (name.c_str (), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING,
+                        FILE_FLAG_OVERLAPPED, NULL);
+    if (INVALID_HANDLE_VALUE == port)
+    {
+      std::cerr << "Could not open " << name << " (" << GetLastError () << ")" << std::endl;
+      return;
+    }
+
+    DCB dcb;
+    ZeroMemory (&dcb, sizeof (dcb));
+    dcb.DCBlength = sizeof (dcb);
+    GetCommState (port, &dcb);
+    dcb.BaudRate = baud;
+    dcb.ByteSize = 8;
+    dcb.Parity = NOPARITY;
+    dcb.StopBits = ONESTOPBIT;
+    dcb.fBinary = TRUE;
+    dcb.fParity = FALSE;
+    dcb.fOutxCtsFlow = FALSE;
+    dcb.fOutxDsrFlow = FALSE;
+    dcb.fDtrControl = DTR_CONTROL_ENABLE;
+    dcb.fRtsControl = RTS_CONTROL_ENABLE;
+    dcb.fOutX = FALSE;
+    dcb.fInX = FALSE;
+    dcb.fAbortOnError = FALSE;
+    if (!SetCommState (port, &dcb))
+    {
+      std::cerr << "Could not configure " << name << " (" << GetLastError () << ")" << std::endl;
+      close ();
+      return;
+    }
+
+    // A read returns at once with whatever the driver has, rather than waiting
+    // for its buffer to fill or for the line to go quiet; waitForData is there
+    // for blocking until something arrives.
+    COMMTIMEOUTS timeouts;
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = 0;
+    timeouts.ReadTotalTimeoutConstant = 0;
+    timeouts.WriteTotalTimeoutMultiplier = 0;
+    timeouts.WriteTotalTimeoutConstant = 0;
+    SetCommTimeouts (port, &timeouts);
+    // Room in the driver for bursts at high baud rates between reads.
+    SetupComm (port, 65536, 65536);
+    SetCommMask (port, EV_RXCHAR);
+    PurgeComm (port, PURGE_RXCLEAR | PURGE_TXCLEAR);
+
+    rx_overlapped.hEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+    tx_overlapped.hEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+    wait_overlapped.hEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+  }
+
+  int read ()
+  {
+    // Serve single bytes out of the receive buffer, topping it up with one
+    // large read when it runs dry rather than making a call per byte.
+    if (rx_head == rx_tail)
+    {
+      int result = receive (rx_buffer, sizeof (rx_buffer));
+      if (result <= 0)
+      {
+        return -1;
+      }
+      rx_head = 0;
+      rx_tail = result;
+    }
+    return rx_buffer[rx_head++];
+  }
+
+  int read (unsigned char *data, int length)
+  {
+    // Anything left over from a single-byte read() goes first.
+    if (rx_head != rx_tail)
+    {
+      int count = rx_tail - rx_head;
+      if (count > length)
+      {
+        count = length;
+      }
+      memcpy (data, rx_buffer + rx_head, count);
+      rx_head += count;
+      return count;
+    }
+    int result = receive (rx_buffer, sizeof (rx_buffer));
+    if (result <= 0)
+    {
+      return -1;
+    }
+    rx_head = 0;
+    rx_tail = result;
+    return read (data, length);
+  }
+
+  void write (const unsigned char *data, int length)
+  {
+    if (INVALID_HANDLE_VALUE == port)
+    {
+      return;
+    }
+    if (tx_queue.size () + length > MAX_QUEUED_BYTES)
+    {
+      finish_write (true);
+    }
+    tx_queue.insert (tx_queue.end (), data, data + length);
+    pump_writes ();
+  }
+
+  unsigned long time ()
+  {
+    // The performance counter is monotonic and sub-microsecond, unlike the
+    // wall clock, which wraps at midnight and ticks only every 10-16ms.
+    LARGE_INTEGER now;
+    QueryPerformanceCounter (&now);
+    LONGLONG seconds = now.QuadPart / counts_per_second;
+    LONGLONG remainder = now.QuadPart % counts_per_second;
+    return (unsigned long) (seconds * 1000 + remainder * 1000 / counts_per_second);
+  }
+
+  void waitForData (unsigned long timeout_ms)
+  {
+    pump_writes ();
+    if (INVALID_HANDLE_VALUE == port || rx_head != rx_tail)
+    {
+      return;
+    }
+    COMSTAT status;
+    DWORD errors;
+    if (ClearCommError (port, &errors, &status) && status.cbInQue > 0)
+    {
+      return;
+    }
+    if (!wait_pending)
+    {
+      ResetEvent (wait_overlapped.hEvent);
+      if (WaitCommEvent (port, &wait_mask, &wait_overlapped))
+      {
+        return;
+      }
+      if (ERROR_IO_PENDING != GetLastError ())
+      {
+        Sleep (timeout_ms);
+        return;
+      }
+      wait_pending = true;
+    }
+    // The wait carries over to the next call if nothing arrives in time.
+    if (WAIT_OBJECT_0 == WaitForSingleObject (wait_overlapped.hEvent, timeout_ms))
+    {
+      wait_pending = false;
+    }
+  }
+
+protected:
+  /**
+   * Helper which reads up to length bytes of what has arrived, without
+   * waiting for more. Queued writes are started first, so that they go out
+   * even while the application only reads.
+   * @returns the number of bytes read, or -1 on error
+   */
+  int receive (unsigned char *data, int length)
+  {
+    if (INVALID_HANDLE_VALUE == port)
+    {
+      return -1;
+    }
+    pump_writes ();
+    DWORD count = 0;
+    if (!rx_pending)
+    {
+      ResetEvent (rx_overlapped.hEvent);
+      if (ReadFile (port, data, length, &count, &rx_overlapped))
+      {
+        return count;
+      }
+      if (ERROR_IO_PENDING != GetLastError ())
+      {
+        std::cerr << "Read failed with error " << GetLastError () << std::endl;
+        ClearCommError (port, NULL, NULL);
+        return -1;
+      }
+      rx_pending = true;
+    }
+    // With the timeouts set in init, the driver completes the read at once, so
+    // this only waits in the rare case it hasn't yet; the read goes on into the
+    // same buffer, so the next call picks it up.
+    if (!GetOverlappedResult (port, &rx_overlapped, &count, FALSE))
+    {
+      if (ERROR_IO_INCOMPLETE == GetLastError ())
+      {
+        return 0;
+      }
+      rx_pending = false;
+      std::cerr << "Read failed with error " << GetLastError () << std::endl;
+      ClearCommError (port, NULL, NULL);
+      return -1;
+    }
+    rx_pending = false;
+    return count;
+  }
+
+  /**
+   * Helper which starts writing the queued frames, in one WriteFile, once the
+   * previous one has completed.
+   */
+  void pump_writes ()
+  {
+    if (!finish_write (false) || tx_queue.empty ())
+    {
+      return;
+    }
+    // The frames in flight must stay put until the write completes, so they
+    // move to a buffer of their own and the queue starts afresh.
+    tx_flight.swap (tx_queue);
+    tx_queue.clear ();
+    ResetEvent (tx_overlapped.hEvent);
+    if (!WriteFile (port, &tx_flight[0], (DWORD) tx_flight.size (), NULL, &tx_overlapped) &&
+        ERROR_IO_PENDING != GetLastError ())
+    {
+      std::cerr << "Write failed with error " << GetLastError () << std::endl;
+      ClearCommError (port, NULL, NULL);
+      return;
+    }
+    tx_pending = true;
+  }
+
+  /**
+   * Helper which checks for, or with wait blocks until, the completion of the
+   * write in flight.
+   * @returns whether no write is in flight any more
+   */
+  bool finish_write (bool wait)
+  {
+    if (!tx_pending)
+    {
+      return true;
+    }
+    DWORD written;
+    if (!GetOverlappedResult (port, &tx_overlapped, &written, wait ? TRUE : FALSE))
+    {
+      if (ERROR_IO_INCOMPLETE == GetLastError ())
+      {
+        return false;
+      }
+      std::cerr << "Write failed with error " << GetLastError () << std::endl;
+      ClearCommError (port, NULL, NULL);
+    }
+    tx_pending = false;
+    return true;
+  }
+
+  void close ()
+  {
+    if (INVALID_HANDLE_VALUE == port)
+    {
+      return;
+    }
+    finish_write (true);
+    // Cancel the read or wait outstanding, and let it complete, before the
+    // buffers and events it uses go away.
+    CancelIo (port);
+    DWORD count;
+    if (rx_pending)
+    {
+      GetOverlappedResult (port, &rx_overlapped, &count, TRUE);
+    }
+    if (wait_pending)
+    {
+      GetOverlappedResult (port, &wait_overlapped, &count, TRUE);
+    }
+    CloseHandle (port);
+    port = INVALID_HANDLE_VALUE;
+    CloseHandle (rx_overlapped.hEvent);
+    CloseHandle (tx_overlapped.hEvent);
+    CloseHandle (wait_overlapped.hEvent);
+  }
+
+private:
+  HANDLE port;
+  LONGLONG counts_per_second;
+
+  // Bytes received but not yet handed to the caller.
+  unsigned char rx_buffer[4096];
+  int rx_head;
+  int rx_tail;
+  OVERLAPPED rx_overlapped;
+  bool rx_pending;
+
+  // The frames being written, which must outlive their WriteFile, and those
+  // queued behind them.
+  std::vector<unsigned char> tx_flight;
+  std::vector<unsigned char> tx_queue;
+  OVERLAPPED tx_overlapped;
+  bool tx_pending;
+
+  OVERLAPPED wait_overlapped;
+  DWORD wait_mask;
+  bool wait_pending;
+};
+
+WindowsSerial::WindowsSerial ()
+{
+  impl = new WindowsSerialImpl ();
+}
+
+WindowsSerial::~WindowsSerial ()
+{
+  delete impl;
+}
+
+void WindowsSerial::init (char *port_name)
+{
+  impl->init (port_name);
+}
+
+int WindowsSerial::read ()
+{
+  return impl->read ();
+}
+
+int WindowsSerial::read (unsigned char *data, int length)
+{
+  return impl->read (data, length);
+}
+
+void WindowsSerial::write (const unsigned char *data, int length)
+{
+  impl->write (data, length);
+}
+
+unsigned long WindowsSerial::time ()
+{
+  return impl->time ();
+}
+
+void WindowsSerial::waitForData (unsigned long timeout_ms)
+{
+  impl->waitForData (timeout_ms);
+}
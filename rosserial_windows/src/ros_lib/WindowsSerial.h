@@ -0,0 +1,69 @@
+/**
+Software License Agreement (BSD)
+
+\file      WindowsSerial.h
+\copyright Copyright (c) 2026, rosserial contributors, All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+   following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the 
+   following disclaimer in the documentation and/or other materials provided with the distribution.
+ * Neither the name of Clearpath Robotics nor the names of its contributors may be used to endorse or promote
+   products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WAR-
+RANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, IN-
+DIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ROS_WINDOWS_SERIAL_H_
+#define ROS_WINDOWS_SERIAL_H_
+
+// forward declaration of the implementation class, which keeps windows.h out
+// of the ROS libraries, as WindowsSocket's does
+class WindowsSerialImpl;
+
+// Hardware for a client on a COM port. Reads are overlapped, and pull in
+// whatever has arrived up to a large buffer without waiting for more, so
+// read() costs a system call only when the buffer runs dry. write() queues
+// the frame and returns; frames written while an earlier WriteFile is still
+// in flight go out together in the next one. Build with ROSSERIAL_WINDOWS_SERIAL
+// defined to have ros.h make this the NodeHandle's hardware.
+
+class WindowsSerial
+{
+public:
+  WindowsSerial ();
+  ~WindowsSerial ();
+
+  // port_name is the COM port, optionally followed by the baud rate,
+  // as in "COM3" or "COM12:115200"; the default rate is 57600.
+  void init (char *port_name);
+
+  int read ();
+
+  int read (unsigned char *data, int length);
+
+  void write (const unsigned char *data, int length);
+
+  unsigned long time ();
+
+  // Blocks until there is data to read or timeout_ms has passed, for
+  // NodeHandle_::spinTask.
+  void waitForData (unsigned long timeout_ms);
+
+private:
+    // the port is closed with the last of it, so it isn't copied
+    WindowsSerial (const WindowsSerial &);
+    WindowsSerial & operator= (const WindowsSerial &);
+
+    WindowsSerialImpl * impl;
+};
+
+#endif
@@ -26,6 +26,8 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #include "WindowsSocket.h"
 #include <string>
 #include <iostream>
+#include <vector>
+#include <string.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
@@ -43,8 +45,28 @@ class WindowsSocketImpl
 
 public:
 
-  WindowsSocketImpl () : mySocket (INVALID_SOCKET)
-  { }
+  WindowsSocketImpl () : mySocket (INVALID_SOCKET), rx_head (0), rx_tail (0)
+  {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency (&frequency);
+    counts_per_second = frequency.QuadPart;
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+    ZeroMemory (&tx_overlapped, sizeof (tx_overlapped));
+    tx_overlapped.hEvent = WSA_INVALID_EVENT;
+    tx_pending = false;
+#endif
+  }
+
+  ~WindowsSocketImpl ()
+  {
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+    wait_for_send ();
+    if (WSA_INVALID_EVENT != tx_overlapped.hEvent)
+    {
+      WSACloseEvent (tx_overlapped.hEvent);
+    }
+#endif
+  }
 
   void init (char *server_hostname)
   {
@@ -57,6 +79,10 @@ public:
       return;
     }
 
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+    tx_overlapped.hEvent = WSACreateEvent ();
+#endif
+
     struct addrinfo *servers = get_server_addr (server_hostname);
 
     if (NULL == servers)
@@ -78,26 +104,63 @@ public:
 
   int read ()
   {
-    char data;
-    int result = recv (mySocket, &data, 1, 0);
-    if (result < 0)
+    // Serve single bytes out of the receive buffer, topping it up with one
+    // large recv when it runs dry rather than making a Winsock call per byte.
+    if (rx_head == rx_tail)
     {
-      if (WSAEWOULDBLOCK != WSAGetLastError())
+      int result = receive (rx_buffer, sizeof (rx_buffer));
+      if (result < 0)
       {
-        std::cerr << "Failed to receive data from server " << WSAGetLastError() << std::endl;
+        return -1;
       }
-      return -1;
+      rx_head = 0;
+      rx_tail = result;
     }
-    else if (result == 0)
+    return rx_buffer[rx_head++];
+  }
+
+  int read (unsigned char *data, int length)
+  {
+    // Anything left over from a single-byte read() goes first.
+    if (rx_head != rx_tail)
     {
-      std::cerr << "Connection to server closed" << std::endl;
-      return -1;
+      int count = rx_tail - rx_head;
+      if (count > length)
+      {
+        count = length;
+      }
+      memcpy (data, rx_buffer + rx_head, count);
+      rx_head += count;
+      return count;
     }
-    return (unsigned char) data;
+    return receive (data, length);
   }
 
   void write (const unsigned char *data, int length)
   {
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+    // Hand the frame to Winsock and return without waiting for it to go out;
+    // only the next write blocks, and only if this one is still in flight.
+    wait_for_send ();
+    if (INVALID_SOCKET == mySocket)
+    {
+      return;
+    }
+    tx_buffer.assign (data, data + length);
+    WSABUF wsa_buffer;
+    wsa_buffer.len = (ULONG) tx_buffer.size ();
+    wsa_buffer.buf = (char *) &tx_buffer[0];
+    int result = WSASend (mySocket, &wsa_buffer, 1, NULL, 0, &tx_overlapped, NULL);
+    if (SOCKET_ERROR == result && WSA_IO_PENDING != WSAGetLastError ())
+    {
+      std::cerr << "Send failed with error " << WSAGetLastError () << std::endl;
+      closesocket (mySocket);
+      mySocket = INVALID_SOCKET;
+      WSACleanup ();
+      return;
+    }
+    tx_pending = true;
+#else
     int result = send (mySocket, (const char *) data, length, 0);
     if (SOCKET_ERROR == result)
     {
@@ -105,20 +168,66 @@ public:
       closesocket (mySocket);
       WSACleanup ();
     }
+#endif
   }
 
   unsigned long time ()
   {
-    SYSTEMTIME st_now;
-    GetSystemTime (&st_now);
-    unsigned long millis = st_now.wHour * 3600000 +
-                           st_now.wMinute * 60000 + 
-                           st_now.wSecond * 1000 + 
-                           st_now.wMilliseconds;
-    return millis;
+    // The performance counter is monotonic and sub-microsecond, unlike the
+    // wall clock, which wraps at midnight and ticks only every 10-16ms.
+    LARGE_INTEGER now;
+    QueryPerformanceCounter (&now);
+    LONGLONG seconds = now.QuadPart / counts_per_second;
+    LONGLONG remainder = now.QuadPart % counts_per_second;
+    return (unsigned long) (seconds * 1000 + remainder * 1000 / counts_per_second);
   }
 
 protected:
+  /**
+   * Helper which receives up to length bytes from the server.
+   * @returns the number of bytes received, or -1 if none were available
+   */
+  int receive (unsigned char *data, int length)
+  {
+    int result = recv (mySocket, (char *) data, length, 0);
+    if (result < 0)
+    {
+      if (WSAEWOULDBLOCK != WSAGetLastError())
+      {
+        std::cerr << "Failed to receive data from server " << WSAGetLastError() << std::endl;
+      }
+      return -1;
+    }
+    else if (result == 0)
+    {
+      std::cerr << "Connection to server closed" << std::endl;
+      return -1;
+    }
+    return result;
+  }
+
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+  /**
+   * Helper to block until the previous overlapped send has completed.
+   */
+  void wait_for_send ()
+  {
+    if (!tx_pending)
+    {
+      return;
+    }
+    tx_pending = false;
+    DWORD sent, flags;
+    if (!WSAGetOverlappedResult (mySocket, &tx_overlapped, &sent, TRUE, &flags))
+    {
+      std::cerr << "Send failed with error " << WSAGetLastError () << std::endl;
+      closesocket (mySocket);
+      mySocket = INVALID_SOCKET;
+      WSACleanup ();
+    }
+  }
+#endif
+
         /**
 	* Helper to get the addrinfo for the server based on a string hostname.
 	* NB: you can just pass in a const char* and C++ will automatically
@@ -196,6 +305,19 @@ protected:
 
 private:
   SOCKET mySocket;
+  LONGLONG counts_per_second;
+
+  // Bytes received but not yet handed to the caller.
+  unsigned char rx_buffer[4096];
+  int rx_head;
+  int rx_tail;
+
+#ifdef ROSSERIAL_WINDOWS_OVERLAPPED_SEND
+  // The single frame which may be in flight, and must outlive its WSASend.
+  std::vector<unsigned char> tx_buffer;
+  WSAOVERLAPPED tx_overlapped;
+  bool tx_pending;
+#endif
 };
 
 WindowsSocket::WindowsSocket ()
@@ -213,6 +335,11 @@ int WindowsSocket::read ()
   return impl->read ();
 }
 
+int WindowsSocket::read (unsigned char *data, int length)
+{
+  return impl->read (data, length);
+}
+
 void WindowsSocket::write (const unsigned char *data, int length)
 {
   impl->write (data, length);
@@ -31,6 +31,11 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 // windows specific crud. It gets in the way of the ROS libraries.
 class WindowsSocketImpl;
 
+// Received bytes are buffered internally, so read() costs a Winsock call only
+// when the buffer runs dry. Define ROSSERIAL_WINDOWS_OVERLAPPED_SEND when
+// building this file to have write() queue each frame with an overlapped
+// WSASend and return immediately, instead of blocking in send().
+
 class WindowsSocket
 {
 public:
@@ -40,6 +45,8 @@ public:
 
   int read ();
 
+  int read (unsigned char *data, int length);
+
   void write (const unsigned char *data, int length);
 
   unsigned long time ();
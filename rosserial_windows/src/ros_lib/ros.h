@@ -26,12 +26,25 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 #ifndef _ROS_H_
 #define _ROS_H_
 
-#include "WindowsSocket.h"
 #include "ros/node_handle.h"
 
+// Clients on a COM port rather than a socket are built with
+// ROSSERIAL_WINDOWS_SERIAL defined, and WindowsSerial.cpp in place of
+// WindowsSocket.cpp.
+#ifdef ROSSERIAL_WINDOWS_SERIAL
+#include "WindowsSerial.h"
+
+namespace ros
+{
+typedef NodeHandle_<WindowsSerial> NodeHandle;
+}
+#else
+#include "WindowsSocket.h"
+
 namespace ros
 {
 typedef NodeHandle_<WindowsSocket> NodeHandle;
 }
+#endif
 
 #endif
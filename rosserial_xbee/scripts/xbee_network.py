@@ -43,55 +43,110 @@ import threading
 import sys
 import time
 import struct
+from Queue import Queue, Empty
 
-client_ports=  {}
 clients = {}
 
 debug = False;
 
-import threading
-
 
-class FakeSerial():
+class RemotePort():
+	"""
+	The port a SerialClient writes to one remote radio through. What the radio
+	sends is fed to its client by the one thread reading the coordinator, so
+	there is never anything here to read.
+	"""
 	def __init__(self, id, xbee):
-		self.rxdata =''
 		self.xbee  = xbee
 		self.id = id
-		self.lock = threading.Lock()
 		self.timeout = 0.1
-		
+
 	def read(self, size = 1):
-		t= 0
-		counts = self.timeout/0.01
-		#print "s%d   %s"%(size, self.rxdata)
-		while( ( len(self.rxdata) < size ) and  (not rospy.is_shutdown()) ):
-			time.sleep(0.01)
-			t = t +1
-			if (t >  counts):
-				return ''
-			
-		with (self.lock):
-			out = self.rxdata[:size]
-			self.rxdata = self.rxdata[size:]
-			
-		#print "fake out " , out
-		return out
-		
+		return ''
+
 	def write(self, data):
 		if (debug):
 			print "Sending ", [d for d in data]
 		self.xbee.send('tx', frame_id='0', options="\x01", dest_addr=self.id,data=data)
-		
-	def putData(self, data):
-		with (self.lock):
-			self.rxdata = self.rxdata+data
-	
+
 	def flushInput(self):
-		self.rxdata = ''
+		pass
+
+	def flushOutput(self):
+		pass
 
 	# Returns the number of bytes available to be read
-        def inWaiting(self):
-            return len(self.rxdata)
+	def inWaiting(self):
+		return 0
+
+
+class ClientQueue():
+	"""
+	Puts what one SerialClient has to write on the queue that all of them
+	share, along with which remote it is for.
+	"""
+	def __init__(self, id, queue):
+		self.id = id
+		self.queue = queue
+
+	def put(self, item):
+		self.queue.put((self.id, item))
+
+
+def write_frames(queue, max_payload, flush_delay):
+	"""
+	The one thread writing to the coordinator: takes whatever the clients have
+	queued, and sends it a remote at a time. Frames for a remote are packed
+	together into API frames of up to max_payload bytes, waiting up to
+	flush_delay after the first for more to fill one, so that several small
+	frames share the API overhead and a single radio transaction.
+	"""
+	while True:
+		order = []
+		pending = {}
+		def add(item):
+			xid, data = item
+			if xid not in pending:
+				order.append(xid)
+				pending[xid] = ''
+			pending[xid] += clients[xid].framesFor([data])
+			while len(pending[xid]) >= max_payload:
+				clients[xid]._write(pending[xid][:max_payload])
+				pending[xid] = pending[xid][max_payload:]
+
+		add(queue.get())
+		deadline = time.time() + flush_delay
+		while True:
+			remaining = deadline - time.time()
+			try:
+				if remaining > 0:
+					add(queue.get(True, remaining))
+				else:
+					add(queue.get_nowait())
+			except Empty:
+				break
+		for xid in order:
+			if pending[xid]:
+				clients[xid]._write(pending[xid])
+
+
+def read_frames(xbee):
+	"""
+	The one thread reading from the coordinator: hands the data of each API
+	frame received straight to the client for the remote it came from.
+	"""
+	while not rospy.is_shutdown():
+		msg = xbee.wait_read_frame()
+		if (debug):
+			print "Received " , msg
+
+		if  msg['id'] == 'rx':
+			src = msg['source_addr']
+			data = msg['rf_data']
+			try:
+				clients[src].feed(data)
+			except KeyError as e:
+				print "Rcv ID corrupted"
 
 if __name__== '__main__':
 	print "RosSerial Xbee Network"
@@ -107,6 +162,10 @@ This program connects to rosserial xbee nodes.  The program must be called
 like :
 
 ./xbee_network.py <xbee_serial_port> ID1 [ ID2 ID3 ....] 
+
+Frames for a remote are packed into API frames of up to ~max_payload bytes
+(default 100, the most an 802.15.4 radio takes), collected for up to
+~flush_delay seconds (default 0.005).
 """
 		exit()
 	else :
@@ -116,43 +175,37 @@ like :
 	print "Contacting Xbees : " , network_ids
 
 		
-	# Open serial port
-	ser = serial.Serial(xbee_port, 57600, timeout=0.01)
+	# Open serial port; reads wait on it for up to the timeout, so that the
+	# reader notices shutdown.
+	ser = serial.Serial(xbee_port, 57600, timeout=0.1)
 	ser.flush()
 	ser.flushInput()
 	ser.flushOutput()
 	time.sleep(1)
 	# Create API object
 	xbee = XBee(ser, escaped= True)
-	
+
+	# Every client writes through the one queue and writer, and is fed by the
+	# one reader, so the threads don't grow with the number of remotes.
+	write_queue = Queue()
+	max_payload = rospy.get_param('~max_payload', 100)
+	flush_delay = rospy.get_param('~flush_delay', 0.005)
 	for xid in network_ids:
-		client_ports[xid] = FakeSerial(xid, xbee)
-		time.sleep(.2)
-		clients[xid] = SerialClient(client_ports[xid])
-		 
-	threads = [ threading.Thread(target=c.run) for c in clients.values()]
-	
+		clients[xid] = SerialClient(RemotePort(xid, xbee), write_queue=ClientQueue(xid, write_queue))
+
+	threads = [ threading.Thread(target=write_frames, args=(write_queue, max_payload, flush_delay)),
+	            threading.Thread(target=read_frames, args=(xbee,)) ]
 	for t in threads:
-		t.deamon =True 
+		t.daemon = True
 		t.start()
 
-	while not rospy.is_shutdown():
-		try:
-			msg = xbee.wait_read_frame()
-			if (debug):
-				print "Received " , msg
-	
-			if  msg['id'] == 'rx':
-				src = msg['source_addr']
-				data = msg['rf_data']
-				try:
-					client_ports[src].putData(data)
-				except KeyError as e:
-					print "Rcv ID corrupted"
-		except KeyboardInterrupt:
-			break
+	try:
+		while not rospy.is_shutdown():
+			for c in clients.values():
+				c.checkSync()
+			rospy.sleep(0.5)
+	except (KeyboardInterrupt, rospy.ROSInterruptException):
+		pass
 	ser.close()
 	
 	print "Quiting the Sensor Network"
-
-
@@ -117,8 +117,7 @@ class XBeeBase(threading.Thread):
                 if self._callback and not self._thread_continue:
                     raise ThreadQuitException
                 
-                while (  self.serial.inWaiting() <1):
-                    time.sleep(0.01)
+                # blocks until a byte comes, or the port's timeout passes
                 byte = self.serial.read()
                 if byte =='':
                     continue 